@@ -1,46 +1,214 @@
+/* Python bindings for reading the chain in bulk. Build with make_py.sh.
+
+     chain = libbitcoin.open_flat_file_storage("/var/lib/bitcoin")
+     for batch in libbitcoin.scan_transactions(chain, 0, 200000):
+         arrays = libbitcoin.transaction_arrays(batch)
+         total += arrays["output_values"].sum()
+
+   Nothing is wrapped an object at a time. Blocks come back as wire form
+   bytes and transactions as one bytes object per column, ready for
+   numpy.frombuffer(). The interpreter lock is let go while storage is
+   fetching and while batches are parsed and laid out, so other Python
+   threads carry on meanwhile. C++ exceptions, such as a store refusing
+   the credentials given, come back as RuntimeError. One scanner should
+   only be used from one thread at a time. */
 %module libbitcoin
 %include <std_string.i>
+%include <std_shared_ptr.i>
 
-#if (SWIG_VERSION >= 0x020000)
-  /* shared_ptr library only available in swig 2
-     but we could backport if needed */
-  %include <std_shared_ptr.i>
+%shared_ptr(libbitcoin::storage)
 
-  %shared_ptr(boost::asio::io_service)
-  %shared_ptr(boost::asio::io_service::work)
-  %shared_ptr(libbitcoin::net::peer)
-  %shared_ptr(libbitcoin::net::dialect)
-  %shared_ptr(libbitcoin::net::original_dialect)
-#endif
-
-/* Headers and declarations for our output c++ program */
 %{
+#include <functional>
+
+#include <bitcoin/chain_scanner.hpp>
+#include <bitcoin/dialect.hpp>
+#include <bitcoin/storage/caching_storage.hpp>
+#include <bitcoin/storage/flat_file_storage.hpp>
+#include <bitcoin/storage/postgresql_storage.hpp>
+#include <bitcoin/util/thread_pool.hpp>
+
+using namespace libbitcoin;
+
+template <typename Container>
+static PyObject* bytes_from(const Container& data)
+{
+    return PyBytes_FromStringAndSize(
+        reinterpret_cast<const char*>(data.data()),
+        data.size() * sizeof(typename Container::value_type));
+}
+
+static PyObject* raise_error(const std::error_code& ec)
+{
+    PyErr_SetString(PyExc_IOError, ec.message().c_str());
+    return nullptr;
+}
+
+/* Runs work with the interpreter lock let go. Anything it throws is
+   caught before the lock is taken back, then raised as RuntimeError. */
+static bool without_lock(const std::function<void ()>& work)
+{
+    bool failed = false;
+    std::string error;
+    Py_BEGIN_ALLOW_THREADS
+    try
+    {
+        work();
+    }
+    catch (const std::exception& ex)
+    {
+        failed = true;
+        error = ex.what();
+    }
+    Py_END_ALLOW_THREADS
+    if (failed)
+        PyErr_SetString(PyExc_RuntimeError, error.c_str());
+    return !failed;
+}
+%}
+
+/* Opening a store loads its index, so it runs without the lock too */
+%exception {
+    if (!without_lock([&]() { $action }))
+        SWIG_fail;
+}
 
-#if defined(SWIGRUBY)
-        #undef _ /* nice one ruby.. */
-#endif
+namespace libbitcoin {
 
-#include "net/messages.h"
-#include "net/delegator.h"
-#include "net/peer.h"
-#include "net/dialects/original.h"
+/* Only ever handed back to the scanner */
+class storage
+{
+private:
+    storage();
+};
 
-using std::shared_ptr;
-using boost::asio::io_service;
-using boost::asio::ip::tcp;
-using namespace libbitcoin::net;
+%inline %{
+libbitcoin::storage_ptr open_flat_file_storage(const std::string& directory,
+    size_t number_readers=4)
+{
+    return std::make_shared<flat_file_storage>(directory, number_readers);
+}
+
+libbitcoin::storage_ptr open_postgresql_storage(const std::string& database,
+    const std::string& user, const std::string& password,
+    size_t number_readers=4)
+{
+    return std::make_shared<postgresql_storage>(
+        database, user, password, number_readers);
+}
 %}
 
-/* Found this on internets, not sure it will be useful */
-%ignore boost::noncopyable;
-namespace boost {
-    class noncopyable {};
+class chain_scanner
+{
+public:
+    bool done() const;
+    size_t position() const;
+};
+
+/* Starting a scanner also waits on storage, so it shares the %exception
+   above. Its other methods come after the feature is switched off. */
+%extend chain_scanner {
+    /* parse_threads of 0 picks one per core */
+    chain_scanner(libbitcoin::storage_ptr chain, size_t begin, size_t end,
+        size_t batch_size=500, size_t parse_threads=0)
+    {
+        return new libbitcoin::chain_scanner(chain, begin, end,
+            batch_size, std::make_shared<thread_pool>(parse_threads));
+    }
+}
+
+/* The methods below handle the lock themselves, since they build
+   Python objects once the work is done */
+%exception;
+
+%extend chain_scanner {
+    /* A list of block payloads in wire form, empty once done */
+    PyObject* next_blocks()
+    {
+        message::block_list blocks;
+        std::vector<data_chunk> payloads;
+        std::error_code ec;
+        const bool finished = without_lock([&]()
+            {
+                ec = $self->next_blocks(blocks);
+                for (const message::block& block: blocks)
+                    payloads.push_back(block.raw_payload ?
+                        *block.raw_payload :
+                        original_dialect().to_network(block, false));
+            });
+        if (!finished)
+            return nullptr;
+        if (ec)
+            return raise_error(ec);
+        PyObject* list = PyList_New(payloads.size());
+        for (size_t i = 0; i < payloads.size(); ++i)
+            PyList_SET_ITEM(list, i, bytes_from(payloads[i]));
+        return list;
+    }
+
+    /* A dict of column name to bytes, laid out as transaction_columns,
+       with no rows once done */
+    PyObject* next_transactions()
+    {
+        transaction_columns columns;
+        std::error_code ec;
+        if (!without_lock([&]() { ec = $self->next_transactions(columns); }))
+            return nullptr;
+        if (ec)
+            return raise_error(ec);
+        PyObject* result = PyDict_New();
+        const auto set_column =
+            [result](const char* name, PyObject* column)
+            {
+                PyDict_SetItemString(result, name, column);
+                Py_DECREF(column);
+            };
+        set_column("depths", bytes_from(columns.depths));
+        set_column("positions", bytes_from(columns.positions));
+        set_column("versions", bytes_from(columns.versions));
+        set_column("locktimes", bytes_from(columns.locktimes));
+        set_column("input_counts", bytes_from(columns.input_counts));
+        set_column("output_counts", bytes_from(columns.output_counts));
+        set_column("output_values", bytes_from(columns.output_values));
+        set_column("hashes", bytes_from(columns.hashes));
+        set_column("raw", bytes_from(columns.raw));
+        set_column("raw_offsets", bytes_from(columns.raw_offsets));
+        return result;
+    }
+}
+
+} // libbitcoin
+
+%pythoncode %{
+# numpy types of the columns from chain_scanner.next_transactions()
+TRANSACTION_DTYPES = {
+    "depths": "=u4", "positions": "=u4",
+    "versions": "=u4", "locktimes": "=u4",
+    "input_counts": "=u4", "output_counts": "=u4",
+    "output_values": "=u8", "hashes": "S32",
+    "raw": "u1", "raw_offsets": "=u8",
 }
 
-/* Header files we want to wrap */
-%include "net/dialect.h"
-%include "net/messages.h"
-%include "net/peer.h"
-%include "net/dialects/original.h"
-%include "net/delegator.h"
+def transaction_arrays(columns):
+    """Views the columns as numpy arrays without copying them."""
+    import numpy
+    return dict((name, numpy.frombuffer(data, TRANSACTION_DTYPES[name]))
+        for name, data in columns.items())
+
+def scan_blocks(chain, begin, end, batch_size=500, parse_threads=0):
+    """Yields lists of wire form blocks from depth begin up to end."""
+    scanner = chain_scanner(chain, begin, end, batch_size, parse_threads)
+    while not scanner.done():
+        batch = scanner.next_blocks()
+        if batch:
+            yield batch
+
+def scan_transactions(chain, begin, end, batch_size=500, parse_threads=0):
+    """Yields transaction columns a batch of blocks at a time."""
+    scanner = chain_scanner(chain, begin, end, batch_size, parse_threads)
+    while not scanner.done():
+        batch = scanner.next_transactions()
+        if batch["depths"]:
+            yield batch
+%}
 
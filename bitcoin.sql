@@ -5,7 +5,7 @@
 DROP DOMAIN IF EXISTS amount_type CASCADE;
 CREATE DOMAIN amount_type AS NUMERIC(16, 8) CHECK (VALUE < 21000000 AND VALUE >= 0);
 DROP DOMAIN IF EXISTS hash_type CASCADE;
-CREATE DOMAIN hash_type AS VARCHAR(95);  -- 32*3 because "aa 0f ca ..."
+CREATE DOMAIN hash_type AS BYTEA CHECK (octet_length(VALUE) = 32);
 DROP DOMAIN IF EXISTS address_type CASCADE;
 CREATE DOMAIN address_type AS VARCHAR(110);
 
@@ -50,6 +50,8 @@ $$ LANGUAGE plpgsql;
 -- BLOCKS
 ---------------------------------------------------------------------------
 
+DROP TABLE IF EXISTS block_undo;
+DROP TABLE IF EXISTS raw_blocks;
 DROP TABLE IF EXISTS blocks;
 DROP SEQUENCE IF EXISTS blocks_block_id_sequence;
 DROP SEQUENCE IF EXISTS blocks_space_sequence;
@@ -58,7 +60,7 @@ DROP TYPE IF EXISTS block_status_type;
 CREATE SEQUENCE blocks_block_id_sequence;
 CREATE SEQUENCE blocks_space_sequence;
 -- Space 0 is always reserved for the main chain.
--- Other spaces contain orphan chains
+-- Other spaces contain side and orphan chains
 
 CREATE TYPE block_status_type AS ENUM (
     'orphan',
@@ -74,6 +76,8 @@ CREATE TABLE blocks (
     span_right INT NOT NULL,
     version BIGINT NOT NULL,
     prev_block_hash hash_type NOT NULL,
+    -- Set once the block joins the main chain
+    prev_block_id INT,
     merkle hash_type NOT NULL,
     when_created TIMESTAMP NOT NULL,
     bits_head INT NOT NULL,
@@ -81,7 +85,13 @@ CREATE TABLE blocks (
     accum_diff difficulty_type NOT NULL,
     nonce BIGINT NOT NULL,
     when_found TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
-    block_status block_status_type NOT NULL DEFAULT 'orphan'
+    block_status block_status_type NOT NULL DEFAULT 'orphan',
+    -- Passed every check, scripts included. Kept when a reorganisation
+    -- takes the block off the main chain, since what it spends and
+    -- where it sits cannot change, so coming back only connects it.
+    validated BOOLEAN NOT NULL DEFAULT FALSE,
+    -- Only the header and unspent outputs are left
+    pruned BOOLEAN NOT NULL DEFAULT FALSE
 );
 
 -- Genesis block
@@ -101,14 +111,14 @@ INSERT INTO blocks (
     nonce,
     block_status
 ) VALUES (
-    '00 00 00 00 00 19 d6 68 9c 08 5a e1 65 83 1e 93 4f f7 63 ae 46 a2 a6 c1 72 b3 f1 b6 0a 8c e2 6f',
+    decode('000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f', 'hex'),
     0,
     0,
     0,
     0,
     1,
-    '00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00',
-    '4a 5e 1e 4b aa b8 9f 3a 32 51 8a 88 c3 1b c8 7f 61 8f 76 67 3e 2c c7 7a b2 12 7b 7a fd ed a3 3b',
+    decode('0000000000000000000000000000000000000000000000000000000000000000', 'hex'),
+    decode('4a5e1e4baab89f3a32518a88c31bc87f618f76673e2cc77ab2127b7afdeda33b', 'hex'),
     TO_TIMESTAMP(1231006505),
     29,
     65535,
@@ -121,6 +131,22 @@ CREATE INDEX ON blocks USING btree (block_hash);
 CREATE INDEX ON blocks (space);
 CREATE INDEX ON blocks (depth);
 
+-- Payloads as received, served to peers without serializing again.
+-- Kept apart so reading the parsed columns never drags them along.
+CREATE TABLE raw_blocks (
+    block_id INT NOT NULL PRIMARY KEY
+        REFERENCES blocks (block_id) ON DELETE CASCADE,
+    payload BYTEA NOT NULL
+);
+
+-- Outputs each verified block spent, in the compress_undo() form, so a
+-- reorganisation puts them back without looking each one up
+CREATE TABLE block_undo (
+    block_id INT NOT NULL PRIMARY KEY
+        REFERENCES blocks (block_id) ON DELETE CASCADE,
+    undo BYTEA NOT NULL
+);
+
 ---------------------------------------------------------------------------
 -- INVENTORY QUEUE
 ---------------------------------------------------------------------------
@@ -182,10 +208,12 @@ CREATE TABLE outputs (
     output_id INT NOT NULL DEFAULT NEXTVAL('outputs_output_id_sequence') PRIMARY KEY,
     transaction_id INT NOT NULL,
     index_in_parent BIGINT NOT NULL,
-    script_id INT NOT NULL,
+    script BYTEA NOT NULL,
     value amount_type NOT NULL,
     output_type output_transaction_type NOT NULL,
-    address address_type
+    address address_type,
+    -- Written back from the in memory unspent output set
+    spent BOOLEAN NOT NULL DEFAULT FALSE
 );
 
 CREATE INDEX ON outputs (transaction_id);
@@ -194,7 +222,7 @@ CREATE TABLE inputs (
     input_id INT NOT NULL DEFAULT NEXTVAL('inputs_input_id_sequence') PRIMARY KEY,
     transaction_id INT NOT NULL,
     index_in_parent INT NOT NULL,
-    script_id INT NOT NULL,
+    script BYTEA NOT NULL,
     previous_output_id INT,
     previous_output_hash hash_type NOT NULL,
     previous_output_index BIGINT NOT NULL,
@@ -209,35 +237,39 @@ CREATE INDEX ON inputs (previous_output_id);
 -- SCRIPTS
 ---------------------------------------------------------------------------
 
--- use sequence for script_id
-
+-- Scripts are kept serialized in inputs.script and outputs.script.
+-- Clear out the old one row per operation layout.
 DROP TABLE IF EXISTS operations;
 DROP SEQUENCE IF EXISTS operations_script_id_sequence;
 DROP SEQUENCE IF EXISTS script_sequence;
 DROP TYPE IF EXISTS opcode_type;
 DROP TYPE IF EXISTS parent_ident_type;
 
-CREATE SEQUENCE operations_script_id_sequence;
-CREATE SEQUENCE script_sequence;
-
-CREATE TYPE opcode_type AS ENUM (
-    'special',
-    'pushdata1',
-    'pushdata2',
-    'pushdata4',
-    'dup',
-    'hash160',
-    'equalverify',
-    'checksig'
+---------------------------------------------------------------------------
+-- ADDRESS INDEX
+---------------------------------------------------------------------------
+
+DROP TABLE IF EXISTS address_outputs;
+DROP TABLE IF EXISTS address_index_cursor;
+
+-- Filled behind the main chain by the address indexer, which is off
+-- unless asked for
+CREATE TABLE address_outputs (
+    pubkey_hash BYTEA NOT NULL CHECK (octet_length(pubkey_hash) = 20),
+    output_id INT NOT NULL,
+    block_id INT NOT NULL,
+    depth INT NOT NULL
 );
-CREATE TYPE parent_ident_type AS ENUM ('input', 'output');
 
-CREATE TABLE operations (
-    operation_id INT NOT NULL DEFAULT NEXTVAL('operations_script_id_sequence') PRIMARY KEY,
-    script_id INT NOT NULL,
-    opcode opcode_type NOT NULL,
-    data varchar(255)
+CREATE INDEX ON address_outputs (pubkey_hash);
+-- Used for dropping what a reorganisation took off the main chain
+CREATE INDEX ON address_outputs (depth);
+
+-- The last main chain block indexed. A single row.
+CREATE TABLE address_index_cursor (
+    depth INT NOT NULL,
+    block_id INT
 );
 
-CREATE INDEX ON operations (script_id);
+INSERT INTO address_index_cursor (depth, block_id) VALUES (-1, NULL);
 
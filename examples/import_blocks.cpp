@@ -0,0 +1,75 @@
+// Loads a store from block files rather than from the network:
+//
+//   import-blocks [OPTIONS] --flat DIRECTORY FILE...
+//   import-blocks [OPTIONS] DBNAME DBUSER DBPASSWORD FILE...
+//
+//   --threads N   threads parsing and checking blocks, 0 for one per
+//                 core (0)
+//   --batch N     blocks parsed at a time (256)
+//
+// Files are read in the order given, such as blk00000.dat onwards from
+// the reference client's blocks directory.
+#include <cstdlib>
+#include <future>
+#include <iostream>
+
+#include <bitcoin/block_importer.hpp>
+#include <bitcoin/storage/flat_file_storage.hpp>
+#include <bitcoin/storage/postgresql_storage.hpp>
+#include <bitcoin/util/logger.hpp>
+#include <bitcoin/util/thread_pool.hpp>
+
+using namespace libbitcoin;
+
+int main(int argc, const char** argv)
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+    size_t number_threads = 0, batch_size = 256;
+    while (args.size() >= 2)
+    {
+        const size_t value = std::strtoul(args[1].c_str(), nullptr, 10);
+        if (args[0] == "--threads")
+            number_threads = value;
+        else if (args[0] == "--batch")
+            batch_size = value;
+        else
+            break;
+        args.erase(args.begin(), args.begin() + 2);
+    }
+    const bool flat = !args.empty() && args[0] == "--flat";
+    const size_t backend_args = flat ? 2 : 3;
+    if (args.size() <= backend_args)
+    {
+        log_info() << "import-blocks [OPTIONS] --flat [DIRECTORY] [FILE]...";
+        log_info() << "import-blocks [OPTIONS] [DBNAME] [DBUSER] "
+            "[DBPASSWORD] [FILE]...";
+        return -1;
+    }
+    storage_ptr backend;
+    if (flat)
+        backend.reset(new flat_file_storage(args[1]));
+    else
+        backend.reset(new postgresql_storage(args[0], args[1], args[2]));
+    const std::vector<std::string> paths(
+        args.begin() + backend_args, args.end());
+    thread_pool_ptr parse_pool =
+        std::make_shared<thread_pool>(number_threads);
+    block_importer_ptr importer =
+        std::make_shared<block_importer>(backend, parse_pool, batch_size);
+    std::promise<import_statistics> imported;
+    importer->import(paths,
+        [&](const std::error_code&, const import_statistics& statistics)
+        {
+            imported.set_value(statistics);
+        });
+    const import_statistics statistics = imported.get_future().get();
+    std::cout << "{\"files\": " << statistics.files
+        << ", \"blocks\": " << statistics.blocks
+        << ", \"stored\": " << statistics.stored
+        << ", \"duplicates\": " << statistics.duplicates
+        << ", \"rejected\": " << statistics.rejected
+        << ", \"bytes\": " << statistics.bytes << "}" << std::endl;
+    // Services hold themselves through their own threads
+    std::_Exit(0);
+}
+
@@ -1,145 +1,246 @@
+#include <csignal>
 #include <iostream>
 #include <functional>
+#include <future>
 #include <memory>
 
-#include <boost/asio.hpp>
-#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include <bitcoin/constants.hpp>
 #include <bitcoin/types.hpp>
 #include <bitcoin/kernel.hpp>
+#include <bitcoin/transaction_pool.hpp>
+#include <bitcoin/network/connection_manager.hpp>
 #include <bitcoin/network/network.hpp>
+#include <bitcoin/storage/caching_storage.hpp>
+#include <bitcoin/storage/flat_file_storage.hpp>
 #include <bitcoin/storage/postgresql_storage.hpp>
 #include <bitcoin/util/logger.hpp>
-#include <bitcoin/util/postbind.hpp>
+#include <bitcoin/util/memory_budget.hpp>
+#include <bitcoin/util/metrics.hpp>
+#include <bitcoin/util/metrics_server.hpp>
+#include <bitcoin/util/signature_cache.hpp>
+#include <bitcoin/util/thread_pool.hpp>
+#include <bitcoin/util/trace.hpp>
 
 using namespace libbitcoin;
 using std::placeholders::_1;
-using std::placeholders::_2;
-
-using boost::asio::deadline_timer;
-using boost::posix_time::seconds;
-typedef std::shared_ptr<deadline_timer> deadline_timer_ptr;
 
 class poller_application
   : public threaded_service,
     public std::enable_shared_from_this<poller_application>
 {
 public:
-    poller_application(std::string dbname, 
-            std::string dbuser, std::string dbpass);
-
-    void start(std::string hostname, unsigned int port);
+    // Every component runs its strand on executor. Without headers_first
+    // blocks are fetched through getblocks. A memory_bytes of 0 leaves
+    // each cache at its own default.
+    poller_application(storage_ptr backend, thread_pool_ptr executor,
+        bool headers_first, size_t memory_bytes=0);
+
+    // Seeds are only dialled until peers tell us of others
+    void add_seed(std::string hostname, unsigned int port);
+    void start();
+    // Writes the chain state snapshot, if the storage keeps one, and
+    // waits for it to finish
+    void stop();
+    // Shares the memory budget out again, if there is one
+    void rebalance_memory();
 private:
-    typedef std::vector<channel_handle> channels_list;
-
-    void handle_connect(std::error_code ec, channel_handle channel);
-    void reset_timer();
-
-    void fetch_locator(const boost::system::error_code& ec);
-    void request_blocks(std::error_code ec, message::block_locator locator);
+    void add_memory_users();
 
     kernel_ptr kernel_;
     network_ptr network_;
-    storage_ptr storage_;
-
-    deadline_timer_ptr poll_blocks_timer_;
-    channels_list channels_;
+    storage_ptr backend_, storage_;
+    transaction_pool_ptr transaction_pool_;
+    connection_manager_ptr connections_;
+    metrics_server_ptr metrics_;
+    std::unique_ptr<memory_budget> memory_;
 };
 
 typedef std::shared_ptr<poller_application> poller_application_ptr;
 
-poller_application::poller_application(std::string dbname, 
-        std::string dbuser, std::string dbpass)
-  : kernel_(new kernel)
+poller_application::poller_application(storage_ptr backend,
+    thread_pool_ptr executor, bool headers_first, size_t memory_bytes)
+  : threaded_service(executor), kernel_(new kernel(executor)),
+    backend_(backend)
 {
-    network_.reset(new network_impl(kernel_));
+    // The kernel fetches what it just stored, so keep that in memory
+    storage_ = std::make_shared<caching_storage>(backend_,
+        64 * 1024 * 1024, 16 * 1024 * 1024, executor);
+    network_.reset(new network_impl(kernel_, executor));
     kernel_->register_network(network_);
 
-    storage_.reset(new postgresql_storage(dbname, dbuser, dbpass));
     kernel_->register_storage(storage_);
+    transaction_pool_ = std::make_shared<transaction_pool>(
+        storage_, std::make_shared<thread_pool>(), 32 * 1024 * 1024,
+        executor);
+    kernel_->register_transaction_pool(transaction_pool_);
+    // The kernel keeps the download going by itself either way
+    if (headers_first)
+        kernel_->enable_headers_first();
+    else
+        kernel_->enable_getblocks_sync();
+    connections_ = std::make_shared<connection_manager>(
+        network_, "poller.peers", 8, executor);
+    kernel_->register_connection_manager(connections_);
+    metrics_ = std::make_shared<metrics_server>();
+    if (memory_bytes > 0)
+    {
+        memory_.reset(new memory_budget(memory_bytes));
+        add_memory_users();
+        rebalance_memory();
+    }
+}
 
-    poll_blocks_timer_.reset(new deadline_timer(*service()));
+// Both stores keep their headers and unspent outputs the same way
+template <typename Store>
+static bool add_store_memory(memory_budget& memory, storage_ptr backend)
+{
+    shared_ptr<Store> store = std::dynamic_pointer_cast<Store>(backend);
+    if (!store)
+        return false;
+    memory.add_fixed("headers", std::bind(&Store::headers_bytes, store));
+    memory.add("unspent", 4, std::bind(&Store::unspent_bytes, store),
+        std::bind(&Store::set_unspent_max_bytes, store, _1));
+    return true;
 }
 
-void poller_application::start(std::string hostname, unsigned int port)
+void poller_application::add_memory_users()
 {
-    network_->connect(hostname, port, 
-        postbind<std::error_code, channel_handle>(strand(), std::bind(
-            &poller_application::handle_connect, shared_from_this(), _1, _2)));
+    if (!add_store_memory<flat_file_storage>(*memory_, backend_))
+        add_store_memory<postgresql_storage>(*memory_, backend_);
+    gauge& queued_bytes = shared_metrics().get_gauge("network.queued_bytes");
+    memory_->add_fixed("send_queues",
+        [&queued_bytes]()
+        {
+            return static_cast<size_t>(std::max<int64_t>(
+                queued_bytes.value(), 0));
+        });
+    caching_storage_ptr cache =
+        std::static_pointer_cast<caching_storage>(storage_);
+    memory_->add("block_cache", 2,
+        [cache]()
+        {
+            return cache->statistics().block_bytes;
+        },
+        std::bind(&caching_storage::set_max_block_bytes, cache, _1));
+    memory_->add("output_cache", 1,
+        [cache]()
+        {
+            return cache->statistics().output_bytes;
+        },
+        std::bind(&caching_storage::set_max_output_bytes, cache, _1));
+    memory_->add("transaction_pool", 1,
+        std::bind(&transaction_pool::bytes, transaction_pool_),
+        std::bind(&transaction_pool::set_max_bytes, transaction_pool_, _1));
+    signature_cache& signatures = shared_signature_cache();
+    memory_->add("signature_cache", 1,
+        std::bind(&signature_cache::bytes, &signatures),
+        std::bind(&signature_cache::set_max_size, &signatures, _1));
 }
 
-void poller_application::handle_connect(
-    std::error_code ec, channel_handle channel)
+void poller_application::rebalance_memory()
 {
-    if (ec)
-    {
-        log_error() << "Connect: " << ec.message();
-        return;
-    }
-    reset_timer();
-    channels_.push_back(channel);
+    if (memory_)
+        memory_->rebalance();
 }
 
-void poller_application::reset_timer()
+void poller_application::add_seed(std::string hostname, unsigned int port)
 {
-    poll_blocks_timer_->cancel();
-    poll_blocks_timer_->expires_from_now(seconds(1));
-    poll_blocks_timer_->async_wait(
-        postbind<const boost::system::error_code>(strand(), std::bind(
-            &poller_application::fetch_locator, shared_from_this(), _1)));
+    connections_->add_seed(hostname, port);
 }
 
-void poller_application::fetch_locator(const boost::system::error_code& ec)
+void poller_application::start()
 {
-    if (ec)
-    {
-        log_error() << "Poll timer: " << ec.message();
-        return;
-    }
-    storage_->fetch_block_locator(
-        postbind<std::error_code, message::block_locator>(strand(), std::bind(
-            &poller_application::request_blocks, shared_from_this(), _1, _2)));
+    connections_->start();
+    // curl localhost:8334/metrics.json, or /trace.json for the spans
+    set_tracing(true);
+    metrics_->start();
 }
 
-void poller_application::request_blocks(
-        std::error_code ec, message::block_locator locator)
+void poller_application::stop()
 {
-    if (ec)
-    {
-        log_error() << "Block locator: " << ec.message();
+    connections_->stop();
+    metrics_->stop();
+    postgresql_storage_ptr postgresql =
+        std::dynamic_pointer_cast<postgresql_storage>(backend_);
+    if (!postgresql)
         return;
-    }
-    message::getblocks getblocks;
-    getblocks.locator_start_hashes = locator;
-    getblocks.hash_stop = null_hash;
-    // Do a broadcast
-    for (channel_handle channel: channels_)
-        network_->send(channel, getblocks);
-    reset_timer();
+    std::promise<std::error_code> snapshot_written;
+    postgresql->snapshot(
+        [&](const std::error_code& ec)
+        {
+            snapshot_written.set_value(ec);
+        });
+    std::error_code ec = snapshot_written.get_future().get();
+    if (ec)
+        log_error() << "Snapshot: " << ec.message();
+}
+
+static volatile std::sig_atomic_t stop_requested = 0;
+
+void request_stop(int)
+{
+    stop_requested = 1;
 }
 
 int main(int argc, const char** argv)
 {
-    if (argc < 5)
+    bool flat = false, headers_first = true;
+    size_t memory_bytes = 0;
+    int first_arg = 1;
+    for (; first_arg < argc && argv[first_arg][0] == '-'; ++first_arg)
+        if (std::string(argv[first_arg]) == "--flat")
+            flat = true;
+        else if (std::string(argv[first_arg]) == "--getblocks")
+            headers_first = false;
+        // One limit in megabytes for every cache
+        else if (std::string(argv[first_arg]) == "--memory" &&
+                first_arg + 1 < argc)
+            memory_bytes = boost::lexical_cast<size_t>(argv[++first_arg]) *
+                1024 * 1024;
+    const int first_host = first_arg + (flat ? 1 : 3);
+    if (argc <= first_host)
     {
-        log_info() << "poller [DBNAME] [DBUSER] [DBPASSWORD] [HOST:PORT] ...";
+        log_info() << "poller [--getblocks] [--memory MB] [DBNAME] [DBUSER] "
+            "[DBPASSWORD] [HOST:PORT] ...";
+        log_info() << "poller [--getblocks] [--memory MB] --flat [DIRECTORY] "
+            "[HOST:PORT] ...";
         return -1;
     }
-    std::string dbname = argv[1], dbuser = argv[2], dbpass = argv[3];
-    poller_application_ptr app(new poller_application(dbname, dbuser, dbpass));
-    for (int hosts_iter = 4; hosts_iter < argc; ++hosts_iter)
+    // One io thread per core shared by every component, rather than a
+    // thread each
+    thread_pool_ptr executor = std::make_shared<thread_pool>();
+    storage_ptr storage;
+    if (flat)
+        storage.reset(new flat_file_storage(argv[first_arg], 4, executor));
+    else
+        storage.reset(new postgresql_storage(argv[first_arg],
+            argv[first_arg + 1], argv[first_arg + 2], 4, "poller.snapshot",
+            executor));
+    poller_application_ptr app(new poller_application(storage, executor,
+        headers_first, memory_bytes));
+    for (int hosts_iter = first_host; hosts_iter < argc; ++hosts_iter)
     {
         std::vector<std::string> args;
         boost::split(args, argv[hosts_iter], boost::is_any_of(":"));
         if (args.size() == 1)
-            app->start(args[0], 8333);
+            app->add_seed(args[0], 8333);
         else
-            app->start(args[0], boost::lexical_cast<unsigned int>(args[1]));
+            app->add_seed(args[0],
+                boost::lexical_cast<unsigned int>(args[1]));
     }
-    while (true)
+    app->start();
+    std::signal(SIGINT, request_stop);
+    std::signal(SIGTERM, request_stop);
+    for (size_t seconds = 1; !stop_requested; ++seconds)
+    {
         sleep(1);
+        if (seconds % 10 == 0)
+            app->rebalance_memory();
+    }
+    app->stop();
     return 0;
 }
 
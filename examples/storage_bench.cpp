@@ -0,0 +1,433 @@
+// Drives a storage backend through the calls the node leans on and
+// prints one JSON object per workload with its latency percentiles:
+//
+//   storage-bench [OPTIONS] --flat DIRECTORY
+//   storage-bench [OPTIONS] DBNAME DBUSER DBPASSWORD
+//
+//   --cached          put a caching_storage in front of the backend
+//   --concurrency N   requests kept in flight at once (16)
+//   --queries N       requests per query workload (10000)
+//   --blocks N        synthetic blocks to store (1000)
+//   --transactions N  transactions in each synthetic block (10)
+//   --capture FILE    store the block messages of a sync-bench capture
+//                     instead, such as one written by sync-bench --export
+//
+// Synthetic blocks chain off the block at depth 0 but have no real proof
+// of work, so they are stored and indexed without ever connecting. Start
+// from an empty store so every workload sees the same data.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <random>
+
+#include <bitcoin/block.hpp>
+#include <bitcoin/constants.hpp>
+#include <bitcoin/dialect.hpp>
+#include <bitcoin/lazy_block.hpp>
+#include <bitcoin/storage/caching_storage.hpp>
+#include <bitcoin/storage/flat_file_storage.hpp>
+#include <bitcoin/storage/postgresql_storage.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/util/logger.hpp>
+#include <bitcoin/util/metrics.hpp>
+
+using namespace libbitcoin;
+
+typedef std::chrono::high_resolution_clock bench_clock;
+
+// Magic, command and length. A checksum follows for most commands.
+constexpr size_t message_header_size = 20;
+constexpr size_t checksum_size = 4;
+
+struct bench_options
+{
+    bool cached;
+    size_t concurrency, queries, blocks, transactions;
+    std::string capture_path;
+};
+
+typedef std::function<void (bool)> completion_handler;
+// Starts request number i and calls the handler once it is answered
+typedef std::function<void (size_t, completion_handler)> request_handler;
+
+// Keeps up to concurrency requests outstanding until total have been
+// answered. Latencies run from issuing a request to its handler.
+class workload_runner
+{
+public:
+    workload_runner(size_t total, size_t concurrency, request_handler issue)
+      : total_(total), concurrency_(std::max<size_t>(concurrency, 1)),
+        issue_(issue), issued_(0), finished_(0), errors_(0)
+    {
+    }
+
+    double run()
+    {
+        const bench_clock::time_point start = bench_clock::now();
+        const size_t initial = std::min(total_, concurrency_);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            issued_ = initial;
+        }
+        for (size_t i = 0; i < initial; ++i)
+            issue(i);
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (finished_ < total_)
+            done_.wait(lock);
+        return std::chrono::duration_cast<std::chrono::duration<double>>(
+            bench_clock::now() - start).count();
+    }
+
+    const latency_histogram& latencies() const
+    {
+        return latencies_;
+    }
+    size_t errors() const
+    {
+        return errors_;
+    }
+
+private:
+    void issue(size_t i)
+    {
+        const bench_clock::time_point start = bench_clock::now();
+        issue_(i, std::bind(&workload_runner::finish, this, start,
+            std::placeholders::_1));
+    }
+
+    void finish(bench_clock::time_point start, bool success)
+    {
+        latencies_.record(std::chrono::duration_cast<
+            std::chrono::microseconds>(bench_clock::now() - start).count());
+        size_t next = total_;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!success)
+                ++errors_;
+            ++finished_;
+            if (issued_ < total_)
+                next = issued_++;
+            else if (finished_ == total_)
+                done_.notify_all();
+        }
+        if (next < total_)
+            issue(next);
+    }
+
+    const size_t total_, concurrency_;
+    request_handler issue_;
+    latency_histogram latencies_;
+    std::mutex mutex_;
+    std::condition_variable done_;
+    size_t issued_, finished_, errors_;
+};
+
+void run_workload(const std::string& backend_name, const std::string& name,
+    const bench_options& options, size_t total, request_handler issue)
+{
+    if (total == 0)
+        return;
+    workload_runner runner(total, options.concurrency, issue);
+    const double seconds = runner.run();
+    const latency_histogram& latencies = runner.latencies();
+    std::cout << "{\"backend\":\"" << backend_name << "\""
+        << ",\"workload\":\"" << name << "\""
+        << ",\"requests\":" << total
+        << ",\"concurrency\":" << options.concurrency
+        << ",\"errors\":" << runner.errors()
+        << ",\"seconds\":" << seconds
+        << ",\"per_s\":" << total / std::max(seconds, 1e-9)
+        << ",\"p50_us\":" << latencies.percentile(0.5)
+        << ",\"p90_us\":" << latencies.percentile(0.9)
+        << ",\"p99_us\":" << latencies.percentile(0.99)
+        << ",\"max_us\":" << latencies.max()
+        << "}" << std::endl;
+}
+
+bool load_capture_blocks(const std::string& path,
+    std::vector<message::block_ptr>& blocks)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return false;
+    const data_chunk stream((std::istreambuf_iterator<char>(file)),
+        std::istreambuf_iterator<char>());
+    original_dialect dialect;
+    size_t position = 0;
+    while (position + message_header_size + checksum_size <= stream.size())
+    {
+        const data_chunk raw_header(stream.begin() + position,
+            stream.begin() + position + message_header_size);
+        const message::header header = dialect.header_from_network(raw_header);
+        if (!dialect.verify_header(header))
+            break;
+        position += message_header_size;
+        if (dialect.checksum_used(header))
+            position += checksum_size;
+        if (position + header.payload_length > stream.size())
+            break;
+        if (header.command == message::command_type::block)
+        {
+            lazy_block block(data_chunk(stream.begin() + position,
+                stream.begin() + position + header.payload_length));
+            if (!block.valid())
+                return false;
+            blocks.push_back(
+                std::make_shared<const message::block>(block.decode()));
+        }
+        position += header.payload_length;
+    }
+    return position == stream.size();
+}
+
+message::transaction synthetic_transaction(const hash_digest& previous,
+    uint32_t index, uint32_t salt)
+{
+    message::transaction tx;
+    tx.version = 1;
+    tx.locktime = salt;
+    message::transaction_input input;
+    input.hash = previous;
+    input.index = index;
+    input.input_script = parse_script(data_chunk{0x51});
+    input.sequence = 0xffffffff;
+    tx.inputs.push_back(input);
+    // Pay to public key hash, with the salt standing in for the hash
+    message::transaction_output output;
+    output.value = 50000;
+    data_chunk raw_script{0x76, 0xa9, 0x14};
+    raw_script.resize(raw_script.size() + 20, 0);
+    std::copy(reinterpret_cast<const uint8_t*>(&salt),
+        reinterpret_cast<const uint8_t*>(&salt) + sizeof(salt),
+        raw_script.begin() + 3);
+    raw_script.push_back(0x88);
+    raw_script.push_back(0xac);
+    output.output_script = parse_script(raw_script);
+    tx.outputs.push_back(output);
+    tx.outputs.push_back(output);
+    return tx;
+}
+
+// Each transaction spends the first output of the one in the same
+// place in the block before
+std::vector<message::block_ptr> synthetic_chain(const hash_digest& base,
+    size_t number_blocks, size_t number_transactions)
+{
+    std::vector<message::block_ptr> blocks;
+    hash_digest prev_block = base;
+    std::vector<hash_digest> previous(number_transactions, null_hash);
+    uint32_t salt = 0;
+    for (size_t height = 1; height <= number_blocks; ++height)
+    {
+        std::shared_ptr<message::block> block =
+            std::make_shared<message::block>();
+        block->version = 1;
+        block->prev_block = prev_block;
+        block->timestamp = 1231006505 + 600 * height;
+        block->bits = 0x1d00ffff;
+        block->nonce = 0;
+        for (size_t i = 0; i < number_transactions; ++i)
+        {
+            message::transaction tx = i == 0 ?
+                synthetic_transaction(null_hash, 0xffffffff, ++salt) :
+                synthetic_transaction(previous[i], 0, ++salt);
+            previous[i] = hash_transaction(tx);
+            block->transactions.push_back(tx);
+        }
+        block->merkle_root = generate_merkle_root(block->transactions);
+        prev_block = hash_block_header(*block);
+        blocks.push_back(block);
+    }
+    return blocks;
+}
+
+hash_digest fetch_base_hash(storage_ptr backend)
+{
+    std::promise<hash_digest> fetched;
+    backend->fetch_block_by_depth(0,
+        [&](const std::error_code& ec, const message::block& block)
+        {
+            fetched.set_value(ec ? null_hash : hash_block_header(block));
+        });
+    return fetched.get_future().get();
+}
+
+int run_bench(storage_ptr backend, const std::string& backend_name,
+    const bench_options& options)
+{
+    std::vector<message::block_ptr> blocks;
+    if (!options.capture_path.empty())
+    {
+        if (!load_capture_blocks(options.capture_path, blocks))
+        {
+            log_error() << "Unable to read capture " << options.capture_path;
+            return -1;
+        }
+    }
+    else
+    {
+        const hash_digest base_hash = fetch_base_hash(backend);
+        if (base_hash == null_hash)
+        {
+            log_error() << "Store has no block at depth 0 to build on";
+            return -1;
+        }
+        blocks = synthetic_chain(base_hash,
+            options.blocks, std::max<size_t>(options.transactions, 1));
+    }
+
+    std::vector<hash_digest> block_hashes;
+    std::vector<output_point> points;
+    for (message::block_ptr block: blocks)
+    {
+        block_hashes.push_back(hash_block_header(*block));
+        for (const message::transaction& tx: block->transactions)
+        {
+            const hash_digest tx_hash = hash_transaction(tx);
+            for (uint32_t i = 0; i < tx.outputs.size(); ++i)
+                points.push_back(output_point{tx_hash, i});
+        }
+    }
+
+    // Backends answer stores in the order they were made, so a block
+    // always follows its parent even with several in flight
+    std::atomic<size_t> stored_count(0);
+    run_workload(backend_name, "store_block", options, blocks.size(),
+        [&](size_t i, completion_handler handle_completion)
+        {
+            backend->store(blocks[i],
+                [&stored_count, handle_completion](const std::error_code& ec)
+                {
+                    if (!ec)
+                        ++stored_count;
+                    handle_completion(!ec);
+                });
+        });
+
+    // Each workload gets its own picks from the same seed
+    std::mt19937 random_points(1), random_depths(2), random_hashes(3);
+    std::vector<output_point> output_picks;
+    std::vector<size_t> depth_picks;
+    std::vector<hash_digest> hash_picks;
+    for (size_t i = 0; i < options.queries && !points.empty(); ++i)
+        output_picks.push_back(points[random_points() % points.size()]);
+    // Depth 0 was there before, the rest were just stored. A capture
+    // starting at genesis has that one turned away.
+    const size_t chain_size = stored_count + 1;
+    for (size_t i = 0; i < options.queries; ++i)
+        depth_picks.push_back(random_depths() % chain_size);
+    // Half of these are present, half are made up
+    for (size_t i = 0; i < options.queries && !block_hashes.empty(); ++i)
+    {
+        hash_digest block_hash =
+            block_hashes[random_hashes() % block_hashes.size()];
+        if (i % 2 == 1)
+            block_hash[0] ^= 0xff;
+        hash_picks.push_back(block_hash);
+    }
+
+    run_workload(backend_name, "fetch_output_by_hash", options,
+        output_picks.size(),
+        [&](size_t i, completion_handler handle_completion)
+        {
+            backend->fetch_output_by_hash(output_picks[i].hash,
+                output_picks[i].index,
+                [=](const std::error_code& ec,
+                    const message::transaction_output&)
+                {
+                    handle_completion(!ec);
+                });
+        });
+    run_workload(backend_name, "fetch_block_by_depth", options,
+        depth_picks.size(),
+        [&](size_t i, completion_handler handle_completion)
+        {
+            backend->fetch_block_by_depth(depth_picks[i],
+                [=](const std::error_code& ec, const message::block&)
+                {
+                    handle_completion(!ec);
+                });
+        });
+    // Not being there is an answer too, only errors count against it
+    run_workload(backend_name, "block_exists_by_hash", options,
+        hash_picks.size(),
+        [&](size_t i, completion_handler handle_completion)
+        {
+            backend->block_exists_by_hash(hash_picks[i],
+                [=](const std::error_code& ec, bool)
+                {
+                    handle_completion(!ec);
+                });
+        });
+    flush_log();
+    return 0;
+}
+
+int main(int argc, const char** argv)
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+    bench_options options{false, 16, 10000, 1000, 10, ""};
+    while (!args.empty())
+    {
+        if (args[0] == "--cached")
+        {
+            options.cached = true;
+            args.erase(args.begin());
+            continue;
+        }
+        if (args.size() < 2)
+            break;
+        const size_t value = std::strtoul(args[1].c_str(), nullptr, 10);
+        if (args[0] == "--concurrency")
+            options.concurrency = value;
+        else if (args[0] == "--queries")
+            options.queries = value;
+        else if (args[0] == "--blocks")
+            options.blocks = value;
+        else if (args[0] == "--transactions")
+            options.transactions = value;
+        else if (args[0] == "--capture")
+            options.capture_path = args[1];
+        else
+            break;
+        args.erase(args.begin(), args.begin() + 2);
+    }
+    const bool flat = !args.empty() && args[0] == "--flat";
+    if (args.size() != (flat ? 2u : 3u))
+    {
+        log_info() << "storage-bench [OPTIONS] --flat [DIRECTORY]";
+        log_info() << "storage-bench [OPTIONS] [DBNAME] [DBUSER] "
+            "[DBPASSWORD]";
+        return -1;
+    }
+    // Keep stdout to the results. Synthetic blocks failing to verify
+    // is expected.
+    set_log_level(logger_level::error);
+    storage_ptr backend;
+    std::string backend_name;
+    if (flat)
+    {
+        backend.reset(new flat_file_storage(args[1]));
+        backend_name = "flat";
+    }
+    else
+    {
+        backend.reset(new postgresql_storage(args[0], args[1], args[2]));
+        backend_name = "postgresql";
+    }
+    if (options.cached)
+    {
+        backend.reset(new caching_storage(backend));
+        backend_name = "cached_" + backend_name;
+    }
+    const int result = run_bench(backend, backend_name, options);
+    // Services hold themselves through their own threads
+    std::_Exit(result);
+}
+
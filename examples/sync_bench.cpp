@@ -0,0 +1,339 @@
+// Replays a capture of wire messages into a node at full speed and
+// reports how fast it took them in, as one JSON object:
+//
+//   sync-bench [--threads N] --flat DIRECTORY CAPTURE
+//   sync-bench [--threads N] DBNAME DBUSER DBPASSWORD CAPTURE
+//
+// --executor N runs the kernel, network and storage writer on one
+// shared pool of N threads instead of threads of their own, with N=1
+// putting everything on a single thread. --threads is then ignored.
+//
+// A capture is the messages a peer sent, back to back exactly as they
+// came off the socket. A fake peer on the loopback interface streams it
+// to a network_impl, so everything from channel_pimpl on runs as it
+// would against a real node. The peer does its own version handshake
+// first unless the capture already starts with one.
+//
+//   sync-bench --export COUNT --flat DIRECTORY CAPTURE
+//
+// writes the first COUNT main chain blocks of an existing store, synced
+// from real peers, out as a capture of block messages.
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <thread>
+
+#include <boost/asio.hpp>
+
+#include <bitcoin/dialect.hpp>
+#include <bitcoin/kernel.hpp>
+#include <bitcoin/lazy_block.hpp>
+#include <bitcoin/network/network.hpp>
+#include <bitcoin/storage/flat_file_storage.hpp>
+#include <bitcoin/storage/postgresql_storage.hpp>
+#include <bitcoin/util/logger.hpp>
+#include <bitcoin/util/metrics.hpp>
+#include <bitcoin/util/thread_pool.hpp>
+
+using namespace libbitcoin;
+
+typedef std::chrono::high_resolution_clock bench_clock;
+
+// Magic, command and length. A checksum follows for most commands.
+constexpr size_t message_header_size = 20;
+constexpr size_t checksum_size = 4;
+// Giving up once nothing has been stored for this long
+constexpr std::chrono::seconds stall_timeout(60);
+
+struct capture
+{
+    data_chunk stream;
+    size_t messages, blocks, transactions;
+    bool starts_with_version;
+};
+
+bool load_capture(const std::string& path, capture& replay)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return false;
+    replay.stream.assign(std::istreambuf_iterator<char>(file),
+        std::istreambuf_iterator<char>());
+    replay.messages = replay.blocks = replay.transactions = 0;
+    replay.starts_with_version = false;
+    original_dialect dialect;
+    size_t position = 0;
+    while (position + message_header_size + checksum_size <=
+        replay.stream.size())
+    {
+        const data_chunk raw_header(replay.stream.begin() + position,
+            replay.stream.begin() + position + message_header_size);
+        const message::header header = dialect.header_from_network(raw_header);
+        if (!dialect.verify_header(header))
+            break;
+        position += message_header_size;
+        if (dialect.checksum_used(header))
+            position += checksum_size;
+        if (position + header.payload_length > replay.stream.size())
+            break;
+        if (replay.messages == 0)
+            replay.starts_with_version =
+                header.command == message::command_type::version;
+        if (header.command == message::command_type::block)
+        {
+            lazy_block block(data_chunk(replay.stream.begin() + position,
+                replay.stream.begin() + position + header.payload_length));
+            if (block.valid())
+                replay.transactions += block.transactions_size();
+            ++replay.blocks;
+        }
+        position += header.payload_length;
+        ++replay.messages;
+    }
+    if (position != replay.stream.size())
+    {
+        log_error() << "Capture is cut off or damaged after "
+            << replay.messages << " messages";
+        return false;
+    }
+    return true;
+}
+
+// Accepts the node and streams the capture at it as fast as it reads,
+// throwing away whatever the node sends back
+class replay_peer
+{
+public:
+    explicit replay_peer(const capture& replay)
+      : replay_(replay), acceptor_(service_, tcp::endpoint(
+            boost::asio::ip::address_v4::loopback(), 0)),
+        socket_(service_)
+    {
+    }
+    ~replay_peer()
+    {
+        boost::system::error_code ec;
+        socket_.close(ec);
+        if (writer_.joinable())
+            writer_.join();
+        if (reader_.joinable())
+            reader_.join();
+    }
+
+    unsigned short port() const
+    {
+        return acceptor_.local_endpoint().port();
+    }
+
+    void start()
+    {
+        writer_ = std::thread(&replay_peer::run, this);
+    }
+
+private:
+    void run()
+    {
+        acceptor_.accept(socket_);
+        reader_ = std::thread(&replay_peer::discard, this);
+        original_dialect dialect;
+        boost::system::error_code ec;
+        if (!replay_.starts_with_version)
+        {
+            message::version version;
+            version.version = 31900;
+            version.services = 1;
+            version.timestamp = time(nullptr);
+            version.addr_me.services = version.addr_you.services = 1;
+            version.addr_me.ip_addr = version.addr_you.ip_addr =
+                message::ip_address{{0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                    0xff, 0xff, 127, 0, 0, 1}};
+            version.addr_me.port = version.addr_you.port = 8333;
+            version.nonce = 0x5eed;
+            version.start_height = 0;
+            boost::asio::write(socket_,
+                boost::asio::buffer(dialect.to_network(version)), ec);
+            boost::asio::write(socket_,
+                boost::asio::buffer(dialect.to_network(message::verack())),
+                ec);
+        }
+        boost::asio::write(socket_, boost::asio::buffer(replay_.stream), ec);
+        if (ec)
+            log_error() << "Replaying capture: " << ec.message();
+    }
+
+    void discard()
+    {
+        std::array<uint8_t, 4096> buffer;
+        boost::system::error_code ec;
+        while (!ec)
+            socket_.read_some(boost::asio::buffer(buffer), ec);
+    }
+
+    const capture& replay_;
+    io_service service_;
+    tcp::acceptor acceptor_;
+    tcp::socket socket_;
+    std::thread writer_, reader_;
+};
+
+size_t peak_rss_kilobytes()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // Kilobytes on Linux
+    return usage.ru_maxrss;
+}
+
+int run_replay(storage_ptr backend, const std::string& backend_name,
+    size_t number_threads, thread_pool_ptr executor, const capture& loaded)
+{
+    kernel_ptr kern(new kernel(executor));
+    network_ptr net(executor ? new network_impl(kern, executor) :
+        new network_impl(kern, number_threads));
+    kern->register_network(net);
+    kern->register_storage(backend);
+
+    // Rejected blocks, like ones the backend already has, still count
+    // as handled. The peer streams as soon as it accepts, so take the
+    // starting values before connecting.
+    counter& stored = shared_metrics().get_counter("kernel.blocks_stored");
+    counter& rejected = shared_metrics().get_counter("kernel.blocks_rejected");
+    const uint64_t stored_before = stored.value(),
+        rejected_before = rejected.value();
+    const bench_clock::time_point start = bench_clock::now();
+
+    replay_peer peer(loaded);
+    peer.start();
+    std::promise<std::error_code> connected;
+    net->connect("127.0.0.1", peer.port(),
+        [&](const std::error_code& ec, channel_handle)
+        {
+            connected.set_value(ec);
+        });
+    const std::error_code ec = connected.get_future().get();
+    if (ec)
+    {
+        log_error() << "Connecting to the replay: " << ec.message();
+        return -1;
+    }
+    uint64_t handled = 0;
+    bench_clock::time_point last_progress = start;
+    while (handled < loaded.blocks &&
+        bench_clock::now() - last_progress < stall_timeout)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        const uint64_t now_handled = stored.value() - stored_before +
+            rejected.value() - rejected_before;
+        if (now_handled != handled)
+            last_progress = bench_clock::now();
+        handled = now_handled;
+    }
+    const double seconds = std::chrono::duration_cast<
+        std::chrono::duration<double>>(last_progress - start).count();
+    const double rate_seconds = std::max(seconds, 1e-9);
+    // Blocks rejected by the backend have their transactions counted
+    // too, so only compare runs with the same starting store
+    std::cout << "{\"backend\":\"" << backend_name << "\""
+        << ",\"network_threads\":" << number_threads
+        << ",\"executor_threads\":" << (executor ? executor->size() : 0)
+        << ",\"complete\":" << (handled >= loaded.blocks ? "true" : "false")
+        << ",\"messages\":" << loaded.messages
+        << ",\"blocks\":" << handled
+        << ",\"blocks_stored\":" << stored.value() - stored_before
+        << ",\"transactions\":" << loaded.transactions
+        << ",\"seconds\":" << seconds
+        << ",\"blocks_per_s\":" << handled / rate_seconds
+        << ",\"transactions_per_s\":" << loaded.transactions / rate_seconds
+        << ",\"peak_rss_kb\":" << peak_rss_kilobytes()
+        << ",\"metrics\":" << shared_metrics().to_json()
+        << "}" << std::endl;
+    flush_log();
+    // Channels and services hold each other, so leave without unwinding
+    std::_Exit(handled >= loaded.blocks ? 0 : 1);
+}
+
+int export_capture(storage_ptr backend, size_t count,
+    const std::string& path)
+{
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+    original_dialect dialect;
+    for (size_t depth = 0; depth < count; ++depth)
+    {
+        std::promise<bool> fetched;
+        backend->fetch_block_by_depth(depth,
+            [&](const std::error_code& ec, const message::block& block)
+            {
+                if (!ec)
+                {
+                    const data_chunk raw = dialect.to_network(block, true);
+                    file.write(reinterpret_cast<const char*>(raw.data()),
+                        raw.size());
+                }
+                fetched.set_value(!ec);
+            });
+        if (!fetched.get_future().get())
+        {
+            log_info() << "Store ends at depth " << depth;
+            break;
+        }
+    }
+    return file.good() ? 0 : -1;
+}
+
+int main(int argc, const char** argv)
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+    size_t number_threads = 1, executor_threads = 0, export_count = 0;
+    while (args.size() >= 2 && (args[0] == "--threads" ||
+        args[0] == "--executor" || args[0] == "--export"))
+    {
+        const size_t value = std::strtoul(args[1].c_str(), nullptr, 10);
+        if (args[0] == "--threads")
+            number_threads = value;
+        else if (args[0] == "--executor")
+            executor_threads = std::max<size_t>(value, 1);
+        else
+            export_count = value;
+        args.erase(args.begin(), args.begin() + 2);
+    }
+    const bool flat = !args.empty() && args[0] == "--flat";
+    if (args.size() != (flat ? 3u : 4u))
+    {
+        log_info() << "sync-bench [--threads N] [--executor N] --flat "
+            "[DIRECTORY] [CAPTURE]";
+        log_info() << "sync-bench [--threads N] [--executor N] [DBNAME] "
+            "[DBUSER] [DBPASSWORD] [CAPTURE]";
+        log_info() << "sync-bench --export [COUNT] --flat [DIRECTORY] "
+            "[CAPTURE]";
+        return -1;
+    }
+    // Per message logging would be most of what gets timed, and stdout
+    // should carry only the result
+    set_log_level(logger_level::warning);
+    thread_pool_ptr executor;
+    if (executor_threads > 0)
+        executor = std::make_shared<thread_pool>(executor_threads);
+    storage_ptr backend;
+    if (flat)
+        backend.reset(new flat_file_storage(args[1], 4, executor));
+    else
+        backend.reset(new postgresql_storage(args[0], args[1], args[2], 4,
+            "", executor));
+    const std::string& capture_path = args.back();
+    if (export_count > 0)
+        return export_capture(backend, export_count, capture_path);
+
+    capture loaded;
+    if (!load_capture(capture_path, loaded))
+    {
+        log_error() << "Unable to read capture " << capture_path;
+        return -1;
+    }
+    return run_replay(backend, flat ? "flat" : "postgresql", number_threads,
+        executor, loaded);
+}
+
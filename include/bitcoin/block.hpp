@@ -7,6 +7,9 @@ namespace libbitcoin {
 
 hash_digest hash_block_header(const message::block& block);
 
+// Serialized size of the block payload without the message header
+size_t block_size(const message::block& block);
+
 } // libbitcoin
 
 #endif
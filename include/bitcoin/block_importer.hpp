@@ -0,0 +1,93 @@
+#ifndef LIBBITCOIN_BLOCK_IMPORTER_H
+#define LIBBITCOIN_BLOCK_IMPORTER_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <bitcoin/error.hpp>
+#include <bitcoin/storage/storage.hpp>
+#include <bitcoin/types.hpp>
+#include <bitcoin/util/mapped_file.hpp>
+#include <bitcoin/util/threaded_service.hpp>
+
+namespace libbitcoin {
+
+// A block payload within a block file
+struct block_record
+{
+    size_t offset, size;
+};
+
+typedef std::vector<block_record> block_record_list;
+
+// Scanning stops at the first bad magic, or a length past the end of
+// the file or over the block size limit
+block_record_list find_block_records(const byte* data, size_t size);
+
+struct import_statistics
+{
+    size_t files, blocks;
+    // Stored, stored before, and refused by the checks or by storage
+    size_t stored, duplicates, rejected;
+    uint64_t bytes;
+};
+
+// Loads blocks from files of magic, length and payload records laid
+// end to end, as the reference client's blkNNNNN.dat files are, to
+// bring up a node without downloading the chain from peers. Batches
+// are parsed and checked context free across parse_pool while storage
+// is still taking the batch before, and blocks go to storage in file
+// order. Anything after the last whole record of a file, such as the
+// zeros the reference client preallocates, is skipped.
+class block_importer
+  : public threaded_service,
+    public std::enable_shared_from_this<block_importer>
+{
+public:
+    typedef std::function<void (
+        const std::error_code&, const import_statistics&)> import_handler;
+
+    // The strand runs on executor when one is given
+    block_importer(storage_ptr chain, thread_pool_ptr parse_pool,
+        size_t batch_size=256, thread_pool_ptr executor=thread_pool_ptr());
+
+    // One import at a time. The handler runs once storage has answered
+    // for every block in every file.
+    void import(const std::vector<std::string>& paths,
+        import_handler handle_import);
+
+private:
+    void do_import(const std::vector<std::string>& paths,
+        import_handler handle_import);
+    // Parses and stores batches until two are with storage
+    void continue_import();
+    // False once every file is used up
+    bool next_batch();
+    bool open_next_file();
+    void handle_store(const std::error_code& ec);
+    void finish();
+
+    storage_ptr chain_;
+    thread_pool_ptr parse_pool_;
+    size_t batch_size_;
+
+    std::vector<std::string> paths_;
+    size_t next_path_;
+    mapped_file_ptr file_;
+    block_record_list records_;
+    size_t next_record_;
+    // Sent to storage and not answered yet
+    size_t outstanding_;
+    bool waiting_, input_done_;
+    import_statistics statistics_;
+    import_handler handle_import_;
+};
+
+typedef shared_ptr<block_importer> block_importer_ptr;
+
+} // libbitcoin
+
+#endif
+
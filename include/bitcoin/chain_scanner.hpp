@@ -0,0 +1,88 @@
+#ifndef LIBBITCOIN_CHAIN_SCANNER_H
+#define LIBBITCOIN_CHAIN_SCANNER_H
+
+#include <future>
+#include <system_error>
+#include <vector>
+
+#include <boost/utility.hpp>
+
+#include <bitcoin/messages.hpp>
+#include <bitcoin/storage/storage.hpp>
+#include <bitcoin/types.hpp>
+#include <bitcoin/util/thread_pool.hpp>
+
+namespace libbitcoin {
+
+// The transactions of a run of main chain blocks as columns, one row
+// per transaction in chain order, so analytics code takes a batch in
+// one go rather than an object at a time. Numbers are in host byte
+// order.
+struct transaction_columns
+{
+    // Block depth and place within the block
+    std::vector<uint32_t> depths, positions;
+    std::vector<uint32_t> versions, locktimes;
+    std::vector<uint32_t> input_counts, output_counts;
+    // Sum of the output values
+    std::vector<uint64_t> output_values;
+    // 32 bytes a row, as hash_transaction() gives them
+    data_chunk hashes;
+    // Every transaction in wire form back to back. Row i is from
+    // raw_offsets[i] up to raw_offsets[i + 1].
+    data_chunk raw;
+    std::vector<uint64_t> raw_offsets;
+};
+
+// Fills columns from blocks, the first of which is at first_depth.
+// Blocks are split across pool when one is given.
+void fill_transaction_columns(const message::block_list& blocks,
+    size_t first_depth, transaction_columns& columns,
+    thread_pool_ptr pool=thread_pool_ptr());
+
+// Walks the main chain from depth begin up to but not including end, a
+// batch of blocks per call, blocking until storage answers. For callers
+// without an event loop of their own such as the scripting bindings,
+// which let go of their interpreter lock around each call. The next
+// batch is fetched while the caller works through the last one.
+// Stops early at the top of the chain.
+class chain_scanner
+  : private boost::noncopyable
+{
+public:
+    chain_scanner(storage_ptr chain, size_t begin, size_t end,
+        size_t batch_size=500, thread_pool_ptr parse_pool=thread_pool_ptr());
+
+    bool done() const;
+    // Depth of the first block of the next batch
+    size_t position() const;
+
+    // Empty once done. A storage error ends the scan.
+    std::error_code next_blocks(message::block_list& blocks);
+    std::error_code next_transactions(transaction_columns& columns);
+
+private:
+    struct fetch_result
+    {
+        std::error_code ec;
+        message::block_list blocks;
+    };
+
+    void request();
+
+    storage_ptr chain_;
+    size_t next_, end_, batch_size_;
+    thread_pool_ptr parse_pool_;
+    // Covers next_ up to requested_end_. The handler shares the promise,
+    // so a fetch still out when the scanner goes away is harmless.
+    std::future<fetch_result> fetched_;
+    size_t requested_end_;
+    bool done_;
+};
+
+typedef shared_ptr<chain_scanner> chain_scanner_ptr;
+
+} // libbitcoin
+
+#endif
+
@@ -0,0 +1,87 @@
+#ifndef LIBBITCOIN_COMPACT_BLOCK_H
+#define LIBBITCOIN_COMPACT_BLOCK_H
+
+#include <unordered_map>
+#include <vector>
+
+#include <bitcoin/messages.hpp>
+#include <bitcoin/types.hpp>
+
+namespace libbitcoin {
+
+// Compact block relay, laid out as BIP 152. A block goes out as its
+// header and a 6 byte short id for each transaction, the receiver fills
+// them in from its transaction pool and asks only for what it lacks.
+
+constexpr uint64_t compact_block_version = 1;
+
+// SipHash-2-4 of a digest in its wire byte order
+uint64_t siphash_digest(uint64_t k0, uint64_t k1, const hash_digest& hash);
+
+// Short ids are keyed by the header and the sender's nonce, so nobody
+// can make transactions that collide ahead of time
+class short_id_key
+{
+public:
+    short_id_key(const message::block& header, uint64_t nonce);
+
+    // The low 48 bits of the keyed hash of the transaction
+    uint64_t operator()(const hash_digest& tx_hash) const;
+
+private:
+    uint64_t k0_, k1_;
+};
+
+// The coinbase goes whole, since nobody else can have it
+message::compact_block make_compact_block(const message::block& block,
+    uint64_t nonce);
+
+// Rebuilds a block from a compact_block and the transactions we have
+class partial_block
+{
+public:
+    explicit partial_block(const message::compact_block& compact);
+
+    // False if the positions do not add up or two short ids are the
+    // same, either of which means asking for the whole block. Check it
+    // before anything else.
+    bool valid() const;
+    const hash_digest& hash() const;
+
+    // Fills the slot with a matching short id, if any. A second match
+    // for the same slot leaves it to be asked for instead.
+    void offer(const hash_digest& tx_hash, const message::transaction& tx);
+    // Positions still empty, for a get_block_transactions
+    std::vector<uint32_t> missing() const;
+    // The missing transactions in the order missing() gave. False if
+    // there are not exactly that many.
+    bool fill(const message::transaction_list& transactions);
+    bool complete() const;
+
+    // Once complete. Its merkle root still has to be checked, since a
+    // short id collision gives the wrong transaction.
+    message::block block() const;
+
+private:
+    enum class slot_state
+    {
+        empty,
+        filled,
+        ambiguous
+    };
+
+    short_id_key key_;
+    message::block header_;
+    hash_digest hash_;
+    message::transaction_list transactions_;
+    std::vector<slot_state> states_;
+    // Short id to position
+    std::unordered_map<uint64_t, size_t> positions_;
+    size_t filled_;
+    bool valid_;
+};
+
+} // libbitcoin
+
+#endif
+
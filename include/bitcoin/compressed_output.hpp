@@ -0,0 +1,50 @@
+#ifndef LIBBITCOIN_COMPRESSED_OUTPUT_H
+#define LIBBITCOIN_COMPRESSED_OUTPUT_H
+
+#include <bitcoin/types.hpp>
+#include <bitcoin/utxo_set.hpp>
+
+namespace libbitcoin {
+
+// Compact forms for unspent outputs kept in memory or on disk, the same
+// as the reference client's chainstate. Standard pubkey hash and pubkey
+// scripts become a tag plus the hash or key, and amounts drop trailing
+// decimal zeros before going out as a base 128 varint.
+
+// Most significant group first, with 1 added to every group but the
+// last so each value has exactly one encoding
+void write_varint(data_chunk& out, uint64_t value);
+// False if it runs past the end or overflows
+bool read_varint(const data_view& in, size_t& position, uint64_t& value);
+
+// Round numbers of satoshis come out small
+uint64_t compress_amount(uint64_t value);
+uint64_t decompress_amount(uint64_t compressed);
+
+// raw_script is the save_script() form. Only scripts whose bytes match
+// a template exactly are shortened, so the original always comes back.
+void write_compressed_script(data_chunk& out, const data_chunk& raw_script);
+bool read_compressed_script(const data_view& in, size_t& position,
+    data_chunk& raw_script);
+
+void write_compressed_output(data_chunk& out, const unspent_output& output);
+bool read_compressed_output(const data_view& in, size_t& position,
+    unspent_output& output);
+
+data_chunk compress_output(const unspent_output& output);
+// False if compressed is not exactly one output
+bool decompress_output(const data_chunk& compressed, unspent_output& output);
+
+// What a block spent, in utxo_set::connect() order, for taking it off
+// the chain again without looking anything up. Points are left out
+// since the block's own inputs give them back.
+data_chunk compress_undo(const utxo_set::undo_list& undo);
+// False unless compressed holds exactly one output for each input of
+// the block
+bool decompress_undo(const message::block& block,
+    const data_chunk& compressed, utxo_set::undo_list& undo);
+
+} // libbitcoin
+
+#endif
+
@@ -2,8 +2,10 @@
 #define LIBBITCOIN_CONSTANTS_H
 
 #include <cstdint>
+#include <vector>
 
 #include <bitcoin/util/big_number.hpp>
+#include <bitcoin/util/uint256.hpp>
 
 namespace libbitcoin {
 
@@ -31,6 +33,29 @@ const hash_digest null_hash{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
                             0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
 
 big_number max_target();
+// The easiest target a block may claim
+constexpr uint256 proof_of_work_limit = uint256::from_compact(0x1d00ffff);
+
+// A block the main chain must have at this depth
+struct checkpoint
+{
+    size_t depth;
+    hash_digest hash;
+};
+typedef std::vector<checkpoint> checkpoint_list;
+
+// What the stores take on trust while connecting blocks
+struct chain_checkpoints
+{
+    // Lowest first
+    checkpoint_list checkpoints;
+    // Scripts are not run for this block or any block beneath it, once
+    // it is on the main header chain. null_hash runs every script.
+    hash_digest assume_valid;
+};
+
+// Mainnet checkpoints, assuming scripts below the last one are valid
+chain_checkpoints mainnet_checkpoints();
 
 } // libbitcoin
 
@@ -9,6 +9,15 @@
 
 namespace libbitcoin {
 
+// Looks up the null padded 12 byte command field through a perfect
+// hash checked at compile time. Unknown if nothing matches exactly.
+message::command_type decode_command(const uint8_t* field);
+const char* command_name(message::command_type command);
+
+// Payload readers, also used by lazy_block
+message::block read_block_header(deserializer& deserial);
+message::transaction read_transaction(deserializer& deserial);
+
 class dialect
 {
 public:
@@ -17,12 +26,27 @@ public:
     virtual data_chunk to_network(const message::verack& verack) const = 0;
     virtual data_chunk to_network(const message::getaddr& getaddr) const = 0;
     virtual data_chunk to_network(const message::getdata& getdata) const = 0;
+    virtual data_chunk to_network(const message::inv& inv) const = 0;
+    virtual data_chunk to_network(const message::addr& addr) const = 0;
     virtual data_chunk to_network(
             const message::getblocks& getblocks) const = 0;
+    virtual data_chunk to_network(
+            const message::getheaders& getheaders) const = 0;
     virtual data_chunk to_network(const message::block& block,
             bool include_header=true) const = 0;
     virtual data_chunk to_network(const message::transaction& tx,
             bool include_header=true) const = 0;
+    virtual data_chunk to_network(
+            const message::send_compact& send_compact) const = 0;
+    virtual data_chunk to_network(
+            const message::compact_block& compact) const = 0;
+    virtual data_chunk to_network(
+            const message::get_block_transactions& request) const = 0;
+    virtual data_chunk to_network(
+            const message::block_transactions& response) const = 0;
+    // Header to send ahead of a payload that is already serialized
+    virtual data_chunk header_to_network(message::command_type command,
+            const data_chunk& payload) const = 0;
 
     // Utilities
     virtual message::header header_from_network(
@@ -50,6 +74,10 @@ public:
             const message::header& header_msg,
             const data_chunk& stream, bool& ec) const = 0;
 
+    virtual message::getdata getdata_from_network(
+            const message::header& header_msg,
+            const data_chunk& stream, bool& ec) const = 0;
+
     virtual message::transaction transaction_from_network(
             const message::header& header_msg,
             const data_chunk& stream, bool& ec) const = 0;
@@ -57,6 +85,27 @@ public:
     virtual message::block block_from_network(
             const message::header& header_msg,
             const data_chunk& stream, bool& ec) const = 0;
+
+    virtual message::headers headers_from_network(
+            const message::header& header_msg,
+            const data_chunk& stream, bool& ec) const = 0;
+
+    virtual message::send_compact send_compact_from_network(
+            const message::header& header_msg,
+            const data_chunk& stream, bool& ec) const = 0;
+
+    virtual message::compact_block compact_block_from_network(
+            const message::header& header_msg,
+            const data_chunk& stream, bool& ec) const = 0;
+
+    virtual message::get_block_transactions
+        get_block_transactions_from_network(
+            const message::header& header_msg,
+            const data_chunk& stream, bool& ec) const = 0;
+
+    virtual message::block_transactions block_transactions_from_network(
+            const message::header& header_msg,
+            const data_chunk& stream, bool& ec) const = 0;
 };
 
 class original_dialect 
@@ -68,11 +117,21 @@ public:
     data_chunk to_network(const message::verack& verack) const;
     data_chunk to_network(const message::getaddr& getaddr) const;
     data_chunk to_network(const message::getdata& getdata) const;
+    data_chunk to_network(const message::inv& inv) const;
+    data_chunk to_network(const message::addr& addr) const;
     data_chunk to_network(const message::getblocks& getblocks) const;
+    data_chunk to_network(const message::getheaders& getheaders) const;
     data_chunk to_network(const message::block& block,
             bool include_header) const;
     data_chunk to_network(const message::transaction& tx,
             bool include_header) const;
+    data_chunk to_network(const message::send_compact& send_compact) const;
+    data_chunk to_network(const message::compact_block& compact) const;
+    data_chunk to_network(
+            const message::get_block_transactions& request) const;
+    data_chunk to_network(const message::block_transactions& response) const;
+    data_chunk header_to_network(message::command_type command,
+            const data_chunk& payload) const;
 
     // Create header/messages from stream
     message::header header_from_network(const data_chunk& stream) const;
@@ -96,6 +155,10 @@ public:
             const message::header&,
             const data_chunk& stream, bool& ec) const;
 
+    message::getdata getdata_from_network(
+            const message::header&,
+            const data_chunk& stream, bool& ec) const;
+
     message::transaction transaction_from_network(
             const message::header& header_msg,
             const data_chunk& stream, bool& ec) const;
@@ -103,6 +166,26 @@ public:
     message::block block_from_network(
             const message::header& header_msg,
             const data_chunk& stream, bool& ec) const;
+
+    message::headers headers_from_network(
+            const message::header& header_msg,
+            const data_chunk& stream, bool& ec) const;
+
+    message::send_compact send_compact_from_network(
+            const message::header& header_msg,
+            const data_chunk& stream, bool& ec) const;
+
+    message::compact_block compact_block_from_network(
+            const message::header& header_msg,
+            const data_chunk& stream, bool& ec) const;
+
+    message::get_block_transactions get_block_transactions_from_network(
+            const message::header& header_msg,
+            const data_chunk& stream, bool& ec) const;
+
+    message::block_transactions block_transactions_from_network(
+            const message::header& header_msg,
+            const data_chunk& stream, bool& ec) const;
 };
 
 } // libbitcoin
@@ -0,0 +1,107 @@
+#ifndef LIBBITCOIN_DOWNLOAD_SCHEDULER_H
+#define LIBBITCOIN_DOWNLOAD_SCHEDULER_H
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/utility.hpp>
+#include <map>
+#include <vector>
+
+#include <bitcoin/messages.hpp>
+#include <bitcoin/types.hpp>
+
+namespace libbitcoin {
+
+using boost::posix_time::ptime;
+using boost::posix_time::time_duration;
+
+// Spreads block body requests over peers by how fast each has been
+// answering. Better scored peers are offered work first, faster ones
+// are allowed more in
+// flight, peers sitting on a request too long lose all of theirs to the
+// others, and bodies are held back until they can be handed on in
+// height order. Not thread safe, callers keep it on one strand.
+class download_scheduler
+  : private boost::noncopyable
+{
+public:
+    typedef std::vector<std::pair<channel_handle, message::inv_list>>
+        request_list;
+
+    struct peer_statistics
+    {
+        // Smoothed blocks per second and request to arrival time
+        double throughput, latency, score;
+        size_t in_flight, capacity, received, stalls;
+    };
+
+    // Bodies more than this far past the lowest one still missing
+    // are not requested yet
+    static constexpr size_t reorder_window = 1024;
+    static constexpr size_t min_in_flight = 2;
+    static constexpr size_t max_in_flight = 128;
+
+    download_scheduler(header_sync_ptr headers);
+
+    void add_peer(channel_handle chandle);
+    // Its outstanding requests go back to be handed out again
+    void remove_peer(channel_handle chandle);
+
+    // From peer_score(). Peers are offered work highest score first,
+    // then fastest first.
+    void set_score(channel_handle chandle, double score);
+    // Tops up every peer below its capacity
+    void schedule(const ptime& now, request_list& requests);
+    // Adds every body now next in height order to ready. Blocks not
+    // on the best header chain pass straight through.
+    void received(channel_handle chandle, const ptime& now,
+        message::block_ptr block, std::vector<message::block_ptr>& ready);
+    // Another copy of a body already handed on. Only settles the
+    // request it answers.
+    void duplicate(channel_handle chandle, const ptime& now,
+        const hash_digest& block_hash);
+    // Takes back everything from peers whose oldest request has waited
+    // too long. Returns how many peers stalled. Bodies held back too
+    // long are added to ready.
+    size_t check_stalls(const ptime& now,
+        std::vector<message::block_ptr>& ready);
+
+    bool statistics(channel_handle chandle, peer_statistics& result) const;
+    // Depth of the next body to be handed on
+    size_t release_depth() const;
+
+private:
+    struct request
+    {
+        hash_digest hash;
+        ptime sent;
+    };
+
+    struct peer
+    {
+        double throughput, latency, score;
+        size_t received, stalls;
+        ptime last_arrival;
+        std::vector<request> requests;
+    };
+    typedef std::map<channel_handle, peer> peer_map;
+    typedef std::map<size_t, message::block_ptr> reorder_map;
+
+    size_t capacity(const peer& info) const;
+    time_duration stall_timeout(const peer& info) const;
+    void release_requests(peer& info);
+    void arrived(channel_handle chandle, const ptime& now,
+        const hash_digest& block_hash);
+    void release(const ptime& now, std::vector<message::block_ptr>& ready);
+
+    header_sync_ptr headers_;
+    peer_map peers_;
+    // Bodies waiting on a lower one
+    reorder_map reorder_;
+    size_t release_depth_;
+    ptime last_release_;
+};
+
+} // libbitcoin
+
+#endif
+
@@ -10,8 +10,19 @@ enum class error
     // storage errors
     object_doesnt_exist = 1,
     object_already_exists,
+    snapshot_failed,
+    write_failed,
+    unsupported_operation,
+    invalid_block,
+    block_pruned,
     // network errors
-    system_network_error
+    system_network_error,
+    // transaction pool errors
+    invalid_transaction,
+    double_spend,
+    input_not_found,
+    validate_inputs_failed,
+    pool_filled
 };
 
 class error_category_impl
@@ -0,0 +1,67 @@
+#ifndef LIBBITCOIN_GETBLOCKS_SYNC_H
+#define LIBBITCOIN_GETBLOCKS_SYNC_H
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/utility.hpp>
+#include <unordered_map>
+
+#include <bitcoin/messages.hpp>
+#include <bitcoin/types.hpp>
+#include <bitcoin/util/hash_key.hpp>
+
+namespace libbitcoin {
+
+using boost::posix_time::ptime;
+using boost::posix_time::time_duration;
+
+// Block download driven by getblocks for peers without headers-first.
+// The next getblocks goes out as soon as fewer than low_water of the
+// blocks announced in reply are still to arrive, rather than on a
+// timer, so the next inventory is in hand before the current one runs
+// out. Not thread safe, callers keep it on one strand.
+class getblocks_sync
+  : private boost::noncopyable
+{
+public:
+    // Most block hashes a peer announces for one getblocks
+    static constexpr size_t max_inventory = 500;
+
+    // Unanswered getblocks and announced blocks that never turn up are
+    // given up on after timeout
+    getblocks_sync(size_t low_water=max_inventory / 2,
+        const time_duration& timeout=boost::posix_time::seconds(30));
+
+    // True if a getblocks should be sent now, in which case it counts
+    // as sent until answered, failed or timed out
+    bool start_request(const ptime& now);
+    // stored is the locator of the stored chain. Announced blocks still
+    // to arrive are skipped by starting from the last of them.
+    message::getblocks make_request(
+        const message::block_locator& stored) const;
+    // It never went out, so another may be sent at once
+    void request_failed();
+
+    // Block hashes from an inv, in the order they were announced
+    void announced(const message::inv_list& block_invs, const ptime& now);
+    // Arrived, or found to be stored already
+    void received(const hash_digest& block_hash);
+
+    // Announced blocks still to arrive
+    size_t outstanding() const;
+
+private:
+    typedef std::unordered_map<hash_digest, ptime, hash_digest_hasher>
+        announced_map;
+
+    size_t low_water_;
+    time_duration timeout_;
+    bool request_pending_;
+    ptime request_sent_;
+    hash_digest last_announced_;
+    announced_map outstanding_;
+};
+
+} // libbitcoin
+
+#endif
+
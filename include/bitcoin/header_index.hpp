@@ -0,0 +1,92 @@
+#ifndef LIBBITCOIN_HEADER_INDEX_H
+#define LIBBITCOIN_HEADER_INDEX_H
+
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/utility.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <bitcoin/messages.hpp>
+#include <bitcoin/types.hpp>
+#include <bitcoin/util/hash_key.hpp>
+#include <bitcoin/util/uint256.hpp>
+
+namespace libbitcoin {
+
+// Every known block header linked into a tree by its previous hash.
+// Headers whose parent has not arrived wait until it does. The main chain
+// runs back from the linked header with the most accumulated work,
+// so locators and existence checks never need the database.
+class header_index
+  : private boost::noncopyable
+{
+public:
+    struct entry
+    {
+        hash_digest hash, prev_hash;
+        uint32_t bits;
+        // Null until the parent is known
+        const entry* prev;
+        // Only meaningful once linked back to the genesis block
+        size_t depth;
+        uint256 accumulated_work;
+        bool linked, verified;
+    };
+
+    header_index();
+
+    // False if the hash is already indexed
+    bool add(const hash_digest& hash, const hash_digest& prev_hash,
+        uint32_t bits, bool verified=false);
+
+    bool contains(const hash_digest& hash) const;
+    bool find(const hash_digest& hash, entry& result) const;
+
+    size_t size() const;
+    // Roughly what the index takes in memory
+    size_t bytes() const;
+    // Depth of the main chain tip, or 0 if empty
+    size_t top_depth() const;
+    bool main_chain_hash(size_t depth, hash_digest& hash) const;
+    // Sets depth if the header is on the main chain
+    bool is_main_chain(const hash_digest& hash, size_t& depth) const;
+    // Ten most recent main chain hashes, then exponentially further
+    // apart back to the genesis block
+    message::block_locator locator() const;
+
+    // Versioned and checksummed binary image of every header. The caller
+    // records how far into storage it reaches with last_block_id.
+    bool save(const std::string& path, uint64_t last_block_id) const;
+    // Maps the image into memory and replays it. Returns false, leaving
+    // the index empty, if the file is missing, from another version or
+    // fails its checksum.
+    bool load(const std::string& path, uint64_t& last_block_id);
+
+private:
+    typedef std::unordered_map<hash_digest, entry, hash_digest_hasher>
+        entry_map;
+    typedef std::unordered_multimap<hash_digest, entry*, hash_digest_hasher>
+        waiting_map;
+
+    // Callers hold the write lock
+    void link(entry& first);
+    void update_main_chain(const entry& tip);
+
+    mutable boost::shared_mutex mutex_;
+    entry_map entries_;
+    // Unlinked headers keyed by the parent they wait on
+    waiting_map waiting_;
+    std::vector<const entry*> main_chain_;
+};
+
+// Difficulty of a single block relative to the genesis target
+double block_difficulty(uint32_t bits);
+// Expected number of hashes to find a block at this target, or zero when
+// bits are out of range
+uint256 block_work(uint32_t bits);
+
+} // libbitcoin
+
+#endif
+
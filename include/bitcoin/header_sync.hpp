@@ -0,0 +1,68 @@
+#ifndef LIBBITCOIN_HEADER_SYNC_H
+#define LIBBITCOIN_HEADER_SYNC_H
+
+#include <boost/utility.hpp>
+#include <limits>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include <bitcoin/header_index.hpp>
+#include <bitcoin/messages.hpp>
+#include <bitcoin/types.hpp>
+#include <bitcoin/util/hash_key.hpp>
+
+namespace libbitcoin {
+
+// Headers-first download state. Header chains are checked and indexed
+// here before any block is asked for, then bodies are handed out along
+// the best header chain so nothing arrives without a known parent.
+class header_sync
+  : private boost::noncopyable
+{
+public:
+    // Most headers a peer sends in one reply
+    static constexpr size_t max_headers = 2000;
+
+    // start_hash is the tip of the chain already stored. Headers are
+    // indexed from there.
+    header_sync(const hash_digest& start_hash);
+
+    // Indexes every header in the batch. False if any fails its proof
+    // of work, in which case the sender should be dropped.
+    bool accept(const message::headers& packet);
+    // Where the next getheaders should start from
+    message::block_locator locator() const;
+    size_t top_depth() const;
+
+    // Up to count best chain blocks nobody has been asked for yet,
+    // lowest first and none past max_depth
+    message::inv_list next_requests(size_t count,
+        size_t max_depth=std::numeric_limits<size_t>::max());
+    // False if the block is not on the best header chain
+    bool main_chain_depth(const hash_digest& block_hash, size_t& depth) const;
+    void received(const hash_digest& block_hash);
+    // Handed out and received since, so another copy is not needed
+    bool have_body(const hash_digest& block_hash) const;
+    // Puts an unanswered request back for next_requests()
+    void request_failed(const message::inv_list& invs);
+    // Bodies asked for but not yet received
+    size_t outstanding() const;
+
+private:
+    typedef std::unordered_set<hash_digest, hash_digest_hasher> hash_set;
+
+    header_index index_;
+    mutable std::mutex mutex_;
+    // Depth on the best chain up to which every body was handed out
+    size_t requested_depth_;
+    // Handed out at some point, including those since received
+    hash_set requested_;
+    hash_set outstanding_;
+    std::vector<hash_digest> retry_;
+};
+
+} // libbitcoin
+
+#endif
+
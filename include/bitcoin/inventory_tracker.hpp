@@ -0,0 +1,68 @@
+#ifndef LIBBITCOIN_INVENTORY_TRACKER_H
+#define LIBBITCOIN_INVENTORY_TRACKER_H
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/utility.hpp>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <bitcoin/messages.hpp>
+#include <bitcoin/types.hpp>
+#include <bitcoin/util/hash_key.hpp>
+
+namespace libbitcoin {
+
+using boost::posix_time::ptime;
+using boost::posix_time::time_duration;
+
+// Remembers which inventory has already turned up and which is being
+// asked for, so an item announced by many peers is requested once.
+// Known hashes are kept in two generations and the older one dropped
+// when the newer fills, so memory stays bounded while recent items are
+// always remembered. Not thread safe, callers keep it on one strand.
+class inventory_tracker
+  : private boost::noncopyable
+{
+public:
+    inventory_tracker(const time_duration& timeout,
+        size_t known_capacity=100000);
+
+    // True if nobody has it in flight and it is not already known, in
+    // which case it is recorded as asked of chandle
+    bool request(const message::inv_vect& inv, channel_handle chandle,
+        const ptime& now);
+    // Arrived or otherwise dealt with. Never requested again while
+    // it is remembered.
+    void settle(const hash_digest& hash);
+    bool known(const hash_digest& hash) const;
+
+    // Forgets requests older than the timeout and adds them to expired,
+    // so they can be asked of someone else
+    void expire(const ptime& now, message::inv_list& expired);
+    // Whatever it was asked for can be requested again straight away
+    void remove_peer(channel_handle chandle);
+
+    size_t in_flight() const;
+
+private:
+    struct request_entry
+    {
+        message::inv_type type;
+        channel_handle chandle;
+        ptime sent;
+    };
+
+    typedef std::unordered_set<hash_digest, hash_digest_hasher> hash_set;
+    typedef std::unordered_map<hash_digest, request_entry, hash_digest_hasher>
+        request_map;
+
+    time_duration timeout_;
+    size_t generation_capacity_;
+    hash_set known_, previous_known_;
+    request_map requests_;
+};
+
+} // libbitcoin
+
+#endif
+
@@ -4,9 +4,17 @@
 #include <boost/asio.hpp>
 #include <boost/utility.hpp>
 #include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
 
+#include <bitcoin/inventory_tracker.hpp>
+#include <bitcoin/lazy_block.hpp>
 #include <bitcoin/messages.hpp>
+#include <bitcoin/network/peer_metrics.hpp>
+#include <bitcoin/peer_relay.hpp>
 #include <bitcoin/types.hpp>
+#include <bitcoin/util/hash_key.hpp>
 #include <bitcoin/util/threaded_service.hpp>
 
 namespace libbitcoin {
@@ -17,7 +25,8 @@ class kernel
     public std::enable_shared_from_this<kernel>
 {
 public:
-    kernel();
+    // Runs on its own thread, or on executor when one is shared
+    explicit kernel(thread_pool_ptr executor=thread_pool_ptr());
 
     void register_network(network_ptr net_comp);
     network_ptr get_network();
@@ -26,32 +35,172 @@ public:
     void send_failed(channel_handle chandle, const message::verack& message);
     void send_failed(channel_handle chandle, const message::getaddr& message);
     void send_failed(channel_handle chandle, const message::inv& message);
+    void send_failed(channel_handle chandle, const message::addr& message);
     void send_failed(channel_handle chandle, const message::getdata& message);
     void send_failed(channel_handle chandle, const message::getblocks& message);
+    void send_failed(channel_handle chandle,
+            const message::getheaders& message);
+    void send_failed(channel_handle chandle,
+            const message::send_compact& message);
+    void send_failed(channel_handle chandle,
+            const message::compact_block& message);
+    void send_failed(channel_handle chandle,
+            const message::get_block_transactions& message);
+    void send_failed(channel_handle chandle,
+            const message::block_transactions& message);
+    void send_failed(channel_handle chandle,
+            message::command_type command, data_chunk_ptr payload);
 
     bool recv_message(channel_handle chandle, const message::version& message);
     bool recv_message(channel_handle chandle, const message::verack& message);
     bool recv_message(channel_handle chandle, const message::addr& message);
     bool recv_message(channel_handle chandle, const message::inv& message);
-    bool recv_message(channel_handle chandle, const message::block& message);
+    bool recv_message(channel_handle chandle,
+            const message::getdata& message);
+    bool recv_message(channel_handle chandle,
+            const message::transaction& message);
+    bool recv_message(channel_handle chandle, lazy_block_ptr message);
+    bool recv_message(channel_handle chandle, message::block_ptr message);
+    bool recv_message(channel_handle chandle,
+            const message::headers& message);
+    bool recv_message(channel_handle chandle,
+            const message::send_compact& message);
+    bool recv_message(channel_handle chandle,
+            const message::compact_block& message);
+    bool recv_message(channel_handle chandle,
+            const message::get_block_transactions& message);
+    bool recv_message(channel_handle chandle,
+            const message::block_transactions& message);
 
     void handle_connect(channel_handle chandle);
 
     void register_storage(storage_ptr stor_comp);
     storage_ptr get_storage();
+    // Transactions are only fetched, relayed and served with a pool
+    void register_transaction_pool(transaction_pool_ptr pool);
+    // Addresses peers tell us about go in its book
+    void register_connection_manager(connection_manager_ptr connections);
+
+    // Download and check header chains first, then fetch bodies along
+    // the best one from every connected peer. Block invs only prompt
+    // a getheaders from then on.
+    void enable_headers_first();
+    // Without headers-first, ask a peer for the next stretch of blocks
+    // whenever those announced so far are running low, instead of
+    // polling with getblocks on a timer
+    void enable_getblocks_sync();
 
 private:
     void reset_inventory_poll();
+    // Inventory requests. These run on the kernel strand.
     void request_inventories(const boost::system::error_code& ec);
-    void accept_inventories(const std::error_code& ec, 
+    void retry_requests(channel_handle chandle,
+            const message::inv_list& invs);
+    void request_missing(const std::error_code& ec,
+            const std::vector<bool>& exists, const message::inv_list& invs,
+            channel_handle chandle);
+    void request_transactions(channel_handle chandle,
+            const message::inv_list& invs);
+    // Arrived from chandle, which has no need to hear of it again
+    void settle_inventory(channel_handle chandle, const hash_digest& hash);
+    // Stored blocks are sent on in their wire form
+    void serve_block(const std::error_code& ec, data_chunk_ptr raw_block,
+            channel_handle chandle);
+    // Their transactions leave the pool once storage accepts them
+    void store_block(message::block_ptr block);
+    void stored_block(const std::error_code& ec, message::block_ptr block);
+    void handle_transaction(const std::error_code& ec,
+            const message::inv_vect& tx_inv);
+
+    // Relay to peers. These run on the kernel strand.
+    void reset_relay_trickle();
+    // Sends whatever was announced since the last round
+    void trickle(const boost::system::error_code& ec);
+    void peer_announced(channel_handle chandle,
             const message::inv_list& invs);
-    void send_to_random(channel_handle chandle,
-            const message::getdata& request_message);
+    void handle_addresses(channel_handle chandle,
+            const std::vector<message::net_addr>& addresses);
+    void announce(const message::inv_vect& inv);
+
+    // Headers-first sync. These run on the kernel strand.
+    void start_headers_sync(const std::error_code& ec,
+            const message::block_locator& locator);
+    void add_peer(channel_handle chandle);
+    void remove_peer(channel_handle chandle);
+    void request_headers(channel_handle chandle);
+    void handle_headers(channel_handle chandle, size_t count);
+    void schedule_bodies();
+    void handle_body(channel_handle chandle, message::block_ptr block);
+    void handle_duplicate(channel_handle chandle,
+            const hash_digest& block_hash);
+    void reset_stall_check();
+    void check_stalls(const boost::system::error_code& ec);
+    void handle_metrics(const std::vector<peer_metrics>& metrics);
+
+    // Getblocks sync. These run on the kernel strand.
+    void start_getblocks_sync();
+    void continue_getblocks_sync();
+    void send_getblocks(const std::error_code& ec,
+            const message::block_locator& locator);
+    void getblocks_failed(channel_handle chandle);
+    void getblocks_announced(const message::inv_list& block_invs);
+    void getblocks_received(const hash_digest& block_hash);
+
+    // Compact blocks. These run on the kernel strand.
+    void add_compact_peer(channel_handle chandle);
+    // Single block announcements from peers that take compact blocks
+    // are asked for that way
+    void prefer_compact(channel_handle chandle, message::getdata& request);
+    void await_transactions(channel_handle chandle, partial_block_ptr block);
+    void handle_block_transactions(channel_handle chandle,
+            const message::block_transactions& response);
+    void request_whole_block(channel_handle chandle,
+            const hash_digest& block_hash);
+    // Goes down the block path from whichever thread has it. False if
+    // the peer sent something invalid.
+    bool finish_compact(channel_handle chandle, const partial_block& block);
+    void serve_compact_block(const std::error_code& ec,
+            data_chunk_ptr raw_block, channel_handle chandle);
+    void serve_block_transactions(const std::error_code& ec,
+            data_chunk_ptr raw_block, channel_handle chandle,
+            const std::vector<uint32_t>& indexes);
 
     network_ptr network_component_;
     storage_ptr storage_component_;
+    transaction_pool_ptr transaction_pool_;
+    connection_manager_ptr connection_manager_;
 
     deadline_timer_ptr poll_invs_timeout_;
+    // One request per announced item, whoever else announces it
+    inventory_tracker inventory_;
+    // Announcements are batched and only go to peers that lack them
+    deadline_timer_ptr relay_timer_;
+    peer_relay relay_;
+
+    bool headers_first_;
+    header_sync_ptr header_sync_;
+    download_scheduler_ptr scheduler_;
+    deadline_timer_ptr stall_timer_;
+    std::set<channel_handle> peers_;
+    // Peers with a getheaders outstanding
+    std::set<channel_handle> header_requests_;
+
+    getblocks_sync_ptr getblocks_sync_;
+    // Requests take turns around peers_ from here
+    channel_handle getblocks_peer_;
+
+    struct pending_compact
+    {
+        channel_handle chandle;
+        partial_block_ptr block;
+    };
+    typedef std::unordered_map<hash_digest, pending_compact,
+        hash_digest_hasher> pending_compact_map;
+
+    // Peers that sent us a send_compact
+    std::set<channel_handle> compact_peers_;
+    // Waiting on the transactions we lacked, by block hash
+    pending_compact_map pending_compacts_;
 };
 
 typedef shared_ptr<kernel> kernel_ptr;
@@ -0,0 +1,72 @@
+#ifndef LIBBITCOIN_LAZY_BLOCK_H
+#define LIBBITCOIN_LAZY_BLOCK_H
+
+#include <vector>
+
+#include <bitcoin/messages.hpp>
+#include <bitcoin/script.hpp>
+#include <bitcoin/types.hpp>
+#include <bitcoin/util/serializer.hpp>
+
+namespace libbitcoin {
+
+// Exactly one transaction and nothing after it. Decoding does not check
+// lengths, so payloads from the network are walked with this first.
+bool is_whole_transaction(const data_chunk& raw);
+// Checked against the end of raw first, so they fail rather than read
+// past it. deserial must be reading raw.
+bool read_count(deserializer& deserial, const data_chunk& raw,
+    uint64_t& count);
+bool skip_transaction(deserializer& deserial, const data_chunk& raw);
+
+// A block payload kept in its wire form. The 80 byte header is decoded
+// straight away and the transaction boundaries found in one pass, but
+// transactions and scripts are only decoded when asked for. Lets the
+// header decide whether the rest is worth parsing at all.
+class lazy_block
+{
+public:
+    // Takes the payload over. Check valid() before anything else.
+    explicit lazy_block(data_chunk&& raw);
+    // Shares a payload that is already held elsewhere
+    explicit lazy_block(data_chunk_ptr raw);
+
+    // False if the payload does not split into a header and exactly
+    // the number of transactions it claims
+    bool valid() const;
+    // Header fields with the transaction list left empty
+    const message::block& header() const;
+    hash_digest hash() const;
+    const data_chunk& raw() const;
+    data_chunk_ptr shared_raw() const;
+
+    size_t transactions_size() const;
+    // Wire bytes of one transaction
+    data_view transaction_data(size_t index) const;
+    message::transaction transaction(size_t index) const;
+    // One script without decoding the rest of its transaction. Empty
+    // if there is no such input or output.
+    script input_script(size_t index, size_t input_index) const;
+    script output_script(size_t index, size_t output_index) const;
+
+    // The whole block, as block_from_network() would give it, along
+    // with the payload it came from
+    message::block decode() const;
+
+private:
+    // Decodes the header and finds the transaction boundaries
+    void split();
+
+    data_chunk_ptr raw_;
+    message::block header_;
+    // Start of each transaction, then the end of the last one
+    std::vector<size_t> offsets_;
+    bool valid_;
+};
+
+typedef shared_ptr<const lazy_block> lazy_block_ptr;
+
+} // libbitcoin
+
+#endif
+
@@ -14,6 +14,67 @@ namespace message {
 
 typedef std::vector<hash_digest> block_locator;
 
+// Memoized hash carried by transaction and block. The fields of those
+// structs are public, so whoever modifies one after it was hashed must
+// call reset(). Copies carry the cached value along with the fields.
+class hash_cache
+{
+public:
+    hash_cache()
+      : valid_(false)
+    {
+    }
+
+    bool valid() const
+    {
+        return valid_;
+    }
+    const hash_digest& get() const
+    {
+        return hash_;
+    }
+    void set(const hash_digest& hash) const
+    {
+        hash_ = hash;
+        valid_ = true;
+    }
+    void reset()
+    {
+        valid_ = false;
+    }
+
+private:
+    mutable bool valid_;
+    mutable hash_digest hash_;
+};
+
+// Remembers that a block passed the checks needing nothing but the block
+// itself, so later stages skip them. The same rules as hash_cache apply.
+class check_cache
+{
+public:
+    check_cache()
+      : passed_(false)
+    {
+    }
+
+    bool passed() const
+    {
+        return passed_;
+    }
+    void set_passed() const
+    {
+        passed_ = true;
+    }
+    void reset()
+    {
+        passed_ = false;
+    }
+
+private:
+    mutable bool passed_;
+};
+
 typedef std::array<uint8_t, 16> ip_address;
 
 struct net_addr
@@ -29,6 +90,8 @@ enum class inv_type
     error,
     transaction,
     block,
+    // Answered with a compact_block rather than the whole block
+    compact_block,
     none
 };
 
@@ -40,10 +103,33 @@ struct inv_vect
 
 typedef std::vector<inv_vect> inv_list;
 
+// Decoded once from the 12 byte command field. See decode_command()
+enum class command_type
+{
+    unknown,
+    version,
+    verack,
+    addr,
+    inv,
+    getdata,
+    getblocks,
+    getheaders,
+    tx,
+    block,
+    headers,
+    getaddr,
+    ping,
+    alert,
+    sendcmpct,
+    cmpctblock,
+    getblocktxn,
+    blocktxn
+};
+
 struct header
 {
     uint32_t magic;
-    std::string command;
+    command_type command;
     uint32_t payload_length;
     // Ignored by version and verack commands
     uint32_t checksum;
@@ -77,6 +163,13 @@ struct getblocks
     hash_digest hash_stop;
 };
 
+// Same layout as getblocks, but answered with headers rather than invs
+struct getheaders
+{
+    block_locator locator_start_hashes;
+    hash_digest hash_stop;
+};
+
 struct transaction_input
 {
     hash_digest hash;
@@ -100,6 +193,7 @@ struct transaction
     uint32_t locktime;
     transaction_input_list inputs;
     transaction_output_list outputs;
+    hash_cache cached_hash;
 };
 typedef std::vector<transaction> transaction_list;
 
@@ -112,6 +206,66 @@ struct block
     uint32_t bits;
     uint32_t nonce;
     transaction_list transactions;
+    // Covers the 80 byte header only
+    hash_cache cached_hash;
+    // The payload as received, so it can be stored and served without
+    // serializing again. Null for blocks built locally. Like the hash,
+    // whoever modifies the block must reset it.
+    data_chunk_ptr raw_payload;
+    // Set by check_block_context_free()
+    check_cache context_checked;
+};
+// Parsed blocks are handed along the receive path by pointer
+typedef shared_ptr<const block> block_ptr;
+typedef std::vector<block> block_list;
+
+struct headers
+{
+    // Header fields only. The transaction lists are left empty.
+    std::vector<block> block_headers;
+};
+
+// Tells a peer we can take compact_block for blocks we ask it for
+struct send_compact
+{
+    // Whether to push new blocks unasked. Always false from us.
+    bool announce;
+    uint64_t version;
+};
+
+// Sent whole, unlike the rest, such as the coinbase
+struct prefilled_transaction
+{
+    // Position in the block
+    uint32_t index;
+    transaction tx;
+};
+
+// A block as its header and the short ids of its transactions, which
+// the receiver fills in from its own pool. See compact_block.hpp
+struct compact_block
+{
+    // Header fields only, like headers
+    block header;
+    uint64_t nonce;
+    // Low 48 bits used
+    std::vector<uint64_t> short_ids;
+    std::vector<prefilled_transaction> prefilled;
+};
+
+// The transactions of a compact_block that could not be filled in
+struct get_block_transactions
+{
+    hash_digest block_hash;
+    // Positions in the block, ascending
+    std::vector<uint32_t> indexes;
+};
+
+struct block_transactions
+{
+    hash_digest block_hash;
+    // In the order they were asked for
+    transaction_list transactions;
 };
 
 struct addr
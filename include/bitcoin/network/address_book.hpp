@@ -0,0 +1,83 @@
+#ifndef LIBBITCOIN_NET_ADDRESS_BOOK_H
+#define LIBBITCOIN_NET_ADDRESS_BOOK_H
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/utility.hpp>
+#include <array>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <bitcoin/messages.hpp>
+
+namespace libbitcoin {
+
+using boost::posix_time::ptime;
+
+// Addresses of peers we could connect to, learnt from addr messages.
+// Each remembers how often connecting to it failed in a row, and is
+// left alone for twice as long after every failure. Entries sit densely
+// in a vector with a hash index into it, like the channel_registry, so
+// picking one at random is cheap. Once full, the oldest of a few random
+// picks makes room. Not thread safe, callers keep it on one strand.
+class address_book
+  : private boost::noncopyable
+{
+public:
+    // Given up on after this many failures in a row
+    static constexpr uint8_t max_failures = 10;
+
+    explicit address_book(size_t max_addresses=20000);
+
+    // Known addresses only have their timestamp brought forward
+    void add(const message::net_addr& addr);
+    // A random address not in use and not waiting to be retried. It is
+    // in use from then on, until failed() or disconnected().
+    bool select(const ptime& now, message::net_addr& addr);
+    void connected(const message::net_addr& addr);
+    void failed(const message::net_addr& addr, const ptime& now);
+    void disconnected(const message::net_addr& addr, const ptime& now);
+
+    bool contains(const message::net_addr& addr) const;
+    size_t size() const;
+
+    // Versioned and checksummed, 31 bytes an address
+    bool save(const std::string& path) const;
+    // Returns false, leaving the book empty, if the file is missing,
+    // from another version or fails its checksum
+    bool load(const std::string& path);
+
+private:
+    typedef std::array<uint8_t, 18> address_key;
+
+    struct entry
+    {
+        message::net_addr addr;
+        uint8_t failures;
+        bool in_use;
+        ptime retry_after;
+    };
+
+    struct key_hasher
+    {
+        size_t operator()(const address_key& key) const;
+    };
+    typedef std::unordered_map<address_key, size_t, key_hasher> index_map;
+
+    static address_key key_of(const message::net_addr& addr);
+    entry* find(const message::net_addr& addr);
+    void insert(const entry& new_entry);
+    void erase(size_t position);
+    void evict();
+
+    size_t max_addresses_;
+    std::vector<entry> entries_;
+    index_map index_;
+    std::mt19937 random_;
+};
+
+} // libbitcoin
+
+#endif
+
@@ -0,0 +1,47 @@
+#ifndef LIBBITCOIN_NET_CHANNEL_REGISTRY_H
+#define LIBBITCOIN_NET_CHANNEL_REGISTRY_H
+
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/utility.hpp>
+#include <unordered_map>
+#include <vector>
+
+#include <bitcoin/network/types.hpp>
+
+namespace libbitcoin {
+
+// Connected channels by handle. Channels sit densely in a vector with
+// a hash index into it, so lookup, removal and picking one at random
+// are all constant time. Removal moves the last channel into the gap.
+// Safe to use from any thread.
+class channel_registry
+  : private boost::noncopyable
+{
+public:
+    // False if the handle is already taken
+    bool add(channel_handle chandle, channel_ptr channel_obj);
+    // Null if there is no such channel
+    channel_ptr find(channel_handle chandle) const;
+    // The removed channel, or null
+    channel_ptr remove(channel_handle chandle);
+
+    size_t size() const;
+    // Null if empty
+    channel_ptr random() const;
+    // Copy of every channel at the time of the call
+    channel_list all() const;
+
+private:
+    typedef std::unordered_map<channel_handle, size_t> index_map;
+
+    mutable boost::shared_mutex mutex_;
+    channel_list channels_;
+    // Handles of channels_ in the same order
+    std::vector<channel_handle> handles_;
+    index_map index_;
+};
+
+} // libbitcoin
+
+#endif
+
@@ -0,0 +1,84 @@
+#ifndef LIBBITCOIN_NET_CONNECTION_MANAGER_H
+#define LIBBITCOIN_NET_CONNECTION_MANAGER_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <bitcoin/messages.hpp>
+#include <bitcoin/network/address_book.hpp>
+#include <bitcoin/network/network.hpp>
+#include <bitcoin/types.hpp>
+#include <bitcoin/util/threaded_service.hpp>
+
+namespace libbitcoin {
+
+// Keeps a number of outbound connections open to peers picked from an
+// address_book, dialling several at once while slots are free. The
+// book learns from addr messages and from a getaddr sent to each new
+// peer, and is saved to a file now and then so the next start does not
+// need a seed. Seeds are only dialled while the book has nothing to
+// offer. Everything happens on our strand.
+class connection_manager
+  : public threaded_service,
+    public std::enable_shared_from_this<connection_manager>
+{
+public:
+    typedef std::vector<message::net_addr> address_list;
+
+    // Runs on executor when one is given
+    connection_manager(network_ptr net, const std::string& book_path,
+        size_t outbound_slots=8, thread_pool_ptr executor=thread_pool_ptr());
+
+    // Loads the book and starts filling slots
+    void start();
+    // Saves the book and stops dialling
+    void stop();
+
+    void add_seed(const std::string& hostname, unsigned short port);
+    void add_addresses(const address_list& addresses);
+
+private:
+    typedef std::pair<std::string, unsigned short> seed;
+    // Seeds never go in the book
+    struct outbound
+    {
+        bool from_book;
+        message::net_addr addr;
+    };
+    typedef std::map<channel_handle, outbound> outbound_map;
+
+    void do_start();
+    void do_stop();
+    void do_add_seed(const seed& new_seed);
+    void do_add_addresses(const address_list& addresses);
+
+    void reset_timer();
+    // Looks for departed peers every tick and saves the book less often
+    void check_slots(const boost::system::error_code& ec);
+    void handle_metrics(const network::metrics_list& metrics);
+    void fill_slots();
+    void handle_connect(const std::error_code& ec, channel_handle chandle,
+        const outbound& attempt);
+
+    network_ptr network_;
+    std::string book_path_;
+    size_t outbound_slots_;
+    address_book book_;
+    std::vector<seed> seeds_;
+    size_t next_seed_;
+    ptime next_seed_attempt_;
+    deadline_timer_ptr timer_;
+    size_t ticks_;
+    bool stopped_;
+    // Dialling, and connected
+    size_t pending_;
+    outbound_map outbound_;
+};
+
+} // libbitcoin
+
+#endif
+
@@ -5,9 +5,12 @@
 #include <boost/utility.hpp>
 #include <memory>
 #include <thread>
+#include <vector>
 
 #include <bitcoin/kernel.hpp>
 #include <bitcoin/messages.hpp>
+#include <bitcoin/network/channel_registry.hpp>
+#include <bitcoin/network/peer_metrics.hpp>
 #include <bitcoin/network/types.hpp>
 #include <bitcoin/error.hpp>
 
@@ -23,14 +26,19 @@ public:
     typedef std::function<void (
             const std::error_code&, channel_handle chandle)> connect_handler;
     typedef std::function<void (channel_handle)> accept_random_handle;
+    typedef std::vector<peer_metrics> metrics_list;
+    typedef std::function<void (const metrics_list&)> fetch_metrics_handler;
 
     virtual kernel_ptr kernel() const = 0;
-    virtual bool start_accept() = 0;
+    virtual bool start_accept(unsigned short port=8333) = 0;
     virtual void connect(std::string ip_addr, unsigned short port,
             connect_handler handle_connect) = 0;
     virtual size_t connection_count() const = 0;
+    // Faster peers are more likely to be picked
     virtual void get_random_handle(accept_random_handle accept_handler) = 0;
     virtual void disconnect(channel_handle handle) = 0;
+    // Every connected channel
+    virtual void fetch_metrics(fetch_metrics_handler handle_fetch) = 0;
 
     virtual void send(channel_handle chandle,
             const message::version& version) = 0;
@@ -40,8 +48,26 @@ public:
             const message::getaddr& getaddr) = 0;
     virtual void send(channel_handle chandle,
             const message::getdata& getdata) = 0;
+    virtual void send(channel_handle chandle,
+            const message::inv& inv) = 0;
+    virtual void send(channel_handle chandle,
+            const message::addr& addr) = 0;
     virtual void send(channel_handle chandle,
             const message::getblocks& getblocks) = 0;
+    virtual void send(channel_handle chandle,
+            const message::getheaders& getheaders) = 0;
+    virtual void send(channel_handle chandle,
+            const message::send_compact& send_compact) = 0;
+    virtual void send(channel_handle chandle,
+            const message::compact_block& compact) = 0;
+    virtual void send(channel_handle chandle,
+            const message::get_block_transactions& request) = 0;
+    virtual void send(channel_handle chandle,
+            const message::block_transactions& response) = 0;
+    // Sends payload bytes that are already serialized, such as a
+    // stored block, without copying them
+    virtual void send_raw(channel_handle chandle,
+            message::command_type command, data_chunk_ptr payload) = 0;
 
     virtual void set_ip_address(std::string ip_addr) = 0;
     virtual message::ip_address get_ip_address() const = 0;
@@ -53,21 +79,41 @@ class network_impl
     public std::enable_shared_from_this<network_impl>
 {
 public:
-    network_impl(kernel_ptr kern);
+    // Socket reads, checksums and parsing are spread over number_threads
+    // io threads with each channel kept to its own strand. 0 picks one
+    // per hardware core.
+    network_impl(kernel_ptr kern, size_t number_threads=0);
+    // The same, on the threads of an executor shared with other
+    // components
+    network_impl(kernel_ptr kern, thread_pool_ptr executor);
     ~network_impl();
     kernel_ptr kernel() const;
-    bool start_accept();
+    bool start_accept(unsigned short port=8333);
     void connect(std::string ip_addr, unsigned short port, 
             connect_handler handle_connect);
     size_t connection_count() const;
     void get_random_handle(accept_random_handle accept_handler);
     void disconnect(channel_handle chandle);  
+    void fetch_metrics(fetch_metrics_handler handle_fetch);
 
     void send(channel_handle chandle, const message::version& version);
     void send(channel_handle chandle, const message::verack& verack);
     void send(channel_handle chandle, const message::getaddr& getaddr);
     void send(channel_handle chandle, const message::getdata& getdata);
+    void send(channel_handle chandle, const message::inv& inv);
+    void send(channel_handle chandle, const message::addr& addr);
     void send(channel_handle chandle, const message::getblocks& getblocks);
+    void send(channel_handle chandle,
+            const message::getheaders& getheaders);
+    void send(channel_handle chandle,
+            const message::send_compact& send_compact);
+    void send(channel_handle chandle, const message::compact_block& compact);
+    void send(channel_handle chandle,
+            const message::get_block_transactions& request);
+    void send(channel_handle chandle,
+            const message::block_transactions& response);
+    void send_raw(channel_handle chandle,
+            message::command_type command, data_chunk_ptr payload);
 
     void set_ip_address(std::string ip_addr);
     message::ip_address get_ip_address() const;
@@ -76,7 +122,9 @@ private:
     typedef shared_ptr<tcp::socket> socket_ptr;
     typedef shared_ptr<tcp::acceptor> acceptor_ptr;
 
+    void initialize();
     void do_get_random_handle(accept_random_handle accept_handler);
+    void do_fetch_metrics(fetch_metrics_handler handle_fetch);
     void handle_connect(const boost::system::error_code& ec, 
             socket_ptr socket, std::string ip_addr, 
             connect_handler handle_connect);
@@ -88,7 +136,7 @@ private:
     acceptor_ptr acceptor_;
 
     dialect_ptr default_dialect_;
-    channel_list channels_;
+    channel_registry channels_;
 
     message::ip_address our_ip_address_;
 };
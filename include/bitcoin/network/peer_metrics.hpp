@@ -0,0 +1,41 @@
+#ifndef LIBBITCOIN_NET_PEER_METRICS_H
+#define LIBBITCOIN_NET_PEER_METRICS_H
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <cstdint>
+#include <map>
+
+#include <bitcoin/messages.hpp>
+#include <bitcoin/network/types.hpp>
+
+namespace libbitcoin {
+
+using boost::posix_time::ptime;
+
+// What a channel has seen of its peer so far
+struct peer_metrics
+{
+    channel_handle chandle;
+    ptime connected;
+    uint64_t bytes_received, bytes_sent;
+    std::map<message::command_type, uint64_t>
+        messages_received, messages_sent;
+    // Smoothed seconds from request to reply, negative until measured
+    double getdata_latency, getblocks_latency;
+    // When the oldest unanswered request went out, or not_a_date_time
+    ptime oldest_request;
+};
+
+// Higher is better. Bytes per second received, discounted by how long
+// requests take to be answered. Peers nothing is known about yet score
+// as if they answered in a second.
+double peer_score(const peer_metrics& metrics, const ptime& now);
+
+// True if a request has gone unanswered or replies are taking so long
+// that the connection is better spent on somebody else
+bool peer_too_slow(const peer_metrics& metrics, const ptime& now);
+
+} // libbitcoin
+
+#endif
+
@@ -1,20 +1,23 @@
 #ifndef LIBBITCOIN_NET_TYPES_H
 #define LIBBITCOIN_NET_TYPES_H
 
-#include <boost/ptr_container/ptr_vector.hpp>
 #include <memory>
+#include <vector>
 
 namespace libbitcoin {
 
 class network;
 class network_impl;
 class channel_pimpl;
+class connection_manager;
 
 using std::shared_ptr;
 
 typedef shared_ptr<network> network_ptr;
 typedef unsigned int channel_handle;
-typedef boost::ptr_vector<channel_pimpl> channel_list;
+typedef shared_ptr<channel_pimpl> channel_ptr;
+typedef std::vector<channel_ptr> channel_list;
+typedef shared_ptr<connection_manager> connection_manager_ptr;
 
 
 } // libbitcoin
@@ -0,0 +1,76 @@
+#ifndef LIBBITCOIN_PEER_RELAY_H
+#define LIBBITCOIN_PEER_RELAY_H
+
+#include <boost/utility.hpp>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <bitcoin/messages.hpp>
+#include <bitcoin/types.hpp>
+#include <bitcoin/util/rolling_bloom_filter.hpp>
+
+namespace libbitcoin {
+
+// What each peer is known to have seen, from announcing it to us or us
+// to it, and what is waiting to be announced. Announcements pile up
+// between calls to flush() and then go out as one message per peer,
+// leaving out whatever that peer already knows. Addresses only go to a
+// few peers each, as every peer passes them on again. Not thread safe,
+// callers keep it on one strand.
+class peer_relay
+  : private boost::noncopyable
+{
+public:
+    typedef std::vector<std::pair<channel_handle, message::inv>>
+        inv_batch_list;
+    typedef std::vector<std::pair<channel_handle, message::addr>>
+        addr_batch_list;
+
+    // Protocol limits on a single message
+    static constexpr size_t max_inv_batch = 50000;
+    static constexpr size_t max_addr_batch = 1000;
+
+    peer_relay(size_t known_inventory=40000, size_t known_addresses=5000,
+        size_t address_fanout=2);
+
+    void add_peer(channel_handle chandle);
+    void remove_peer(channel_handle chandle);
+    bool has_peer(channel_handle chandle) const;
+    size_t peer_count() const;
+
+    // It announced or sent us this. Unknown peers are ignored.
+    void mark_known(channel_handle chandle, const hash_digest& hash);
+    void mark_known(channel_handle chandle, const message::net_addr& addr);
+    bool knows(channel_handle chandle, const hash_digest& hash) const;
+    bool knows(channel_handle chandle, const message::net_addr& addr) const;
+
+    // Goes out at the next flush()
+    void announce(const message::inv_vect& inv);
+    void announce(const message::net_addr& addr);
+
+    // Empties the queues into batches for each peer, marking everything
+    // known to the peer it is sent to
+    void flush(inv_batch_list& invs, addr_batch_list& addrs);
+
+private:
+    struct peer_filters
+    {
+        peer_filters(size_t known_inventory, size_t known_addresses);
+
+        rolling_bloom_filter inventory, addresses;
+    };
+    typedef std::map<channel_handle, peer_filters> peer_map;
+
+    size_t known_inventory_, known_addresses_, address_fanout_;
+    peer_map peers_;
+    message::inv_list pending_invs_;
+    std::vector<message::net_addr> pending_addrs_;
+    std::mt19937 random_;
+};
+
+} // libbitcoin
+
+#endif
+
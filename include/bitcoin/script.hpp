@@ -11,6 +11,9 @@ namespace message {
     struct transaction;
 }
 
+class serializer;
+class signature_hash_template;
+
 enum class opcode
 {
     special = 1,
@@ -37,47 +40,98 @@ enum class transaction_type
 {
     normal,
     generate,
+    // [pubkey] checksig
+    pubkey,
+    // dup hash160 [pubkey hash] equalverify checksig
+    pubkey_hash,
     other
 };
 
+// Evaluation state for scripts. It lives apart from script so one parsed
+// script can be run from several threads at once, each thread with its
+// own context.
+class script_context
+{
+public:
+    script_context();
+
+    // Also forgets the signature hash template
+    void clear();
+    bool empty() const;
+    size_t size() const;
+
+    void push(data_chunk data);
+    data_chunk pop();
+    const data_chunk& top() const;
+
+    // Lets OP_CHECKSIG reuse one template for every input of a
+    // transaction. Borrowed, and null when there is none.
+    void set_sighash_template(const signature_hash_template* sighash);
+    const signature_hash_template* sighash_template() const;
+
+private:
+    // Cleared between runs but never shrunk, so a reused context
+    // stops allocating once it has seen a typical script.
+    std::vector<data_chunk> stack_;
+    const signature_hash_template* sighash_;
+};
+
+// A context owned by the calling thread, reused by every run on it
+script_context& thread_script_context();
+
 class script
 {
 public:
     void join(const script& other);
     void push_operation(operation oper);
-    bool run(const message::transaction& parent_tx, uint32_t input_index);
+    void reserve(size_t number_operations);
+    // Runs on thread_script_context() and expects an empty stack at the end
+    bool run(const message::transaction& parent_tx,
+        uint32_t input_index) const;
+    // Runs on top of whatever context already holds
+    bool evaluate(script_context& context,
+        const message::transaction& parent_tx, uint32_t input_index) const;
 
     std::string string_repr() const;
+    // Recognises the standard output templates
     transaction_type type() const;
 
     const operation_stack& operations() const;
 
 private:
-    typedef std::vector<data_chunk> data_stack;
+    bool op_dup(script_context& context) const;
+    bool op_hash160(script_context& context) const;
+    bool op_equalverify(script_context& context) const;
+    bool op_checksig(script_context& context,
+        const message::transaction& parent_tx, uint32_t input_index) const;
 
-    bool op_dup();
-    bool op_hash160();
-    bool op_equalverify();
-    bool op_checksig(const message::transaction& parent_tx, 
-            uint32_t input_index);
+    bool run_operation(const operation& op, script_context& context,
+        const message::transaction& parent_tx, uint32_t input_index) const;
 
-    bool run_operation(operation op, 
-            const message::transaction& parent_tx, uint32_t input_index);
-
-    bool matches_template(operation_stack templ) const;
-
-    data_chunk pop_stack();
+    bool matches_template(const operation_stack& templ) const;
 
     operation_stack operations_;
-    data_stack stack_;
 };
 
+// Runs input_script against the output script it spends. Standard
+// pay-to-pubkey and pay-to-pubkey-hash spends are checked directly
+// without going through the interpreter. sighash, when given, must have
+// been built from parent_tx.
+bool verify_input_script(const script& input_script,
+    const script& output_script, const message::transaction& parent_tx,
+    uint32_t input_index, const signature_hash_template* sighash=nullptr);
+
 std::string opcode_to_string(opcode code);
 opcode string_to_opcode(std::string code_repr);
 
 // TODO: Should be inside the dialect imlementation eventually
 script parse_script(const data_chunk& raw_script);
+script parse_script(const data_view& raw_script);
 data_chunk save_script(const script& scr);
+// Size of save_script() output, computed without serializing
+size_t script_size(const script& scr);
+// Length prefixed save_script() written straight into serial
+void write_script(serializer& serial, const script& scr);
 
 } // libbitcoin
 
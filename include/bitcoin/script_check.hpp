@@ -0,0 +1,55 @@
+#ifndef LIBBITCOIN_SCRIPT_CHECK_H
+#define LIBBITCOIN_SCRIPT_CHECK_H
+
+#include <functional>
+#include <vector>
+
+#include <bitcoin/messages.hpp>
+#include <bitcoin/script.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/types.hpp>
+
+namespace libbitcoin {
+
+// One input's script run against the output script it spends.
+// parent_tx is borrowed and must outlive the check. Checks on inputs of
+// the same transaction can share a sighash template built from it.
+struct script_check
+{
+    const message::transaction* parent_tx;
+    uint32_t input_index;
+    script output_script;
+    signature_hash_template_ptr sighash;
+};
+
+typedef std::vector<script_check> script_check_list;
+
+bool run_script_check(const script_check& check);
+
+// Spreads a block's script checks across a thread_pool. Workers claim
+// small batches from a shared cursor, so a worker stuck on expensive
+// scripts just claims fewer batches while the others drain the rest.
+// The first failure stops further claims.
+class script_check_queue
+{
+public:
+    typedef std::function<void (bool success)> completion_handler;
+
+    script_check_queue(thread_pool_ptr pool, size_t batch_size=8);
+
+    // handle_complete is called exactly once, by the last worker to
+    // finish, after which no check is touched again.
+    void async_run(script_check_list checks,
+        completion_handler handle_complete);
+    // Blocks until done. The calling thread works through checks too.
+    bool run(script_check_list checks);
+
+private:
+    thread_pool_ptr pool_;
+    size_t batch_size_;
+};
+
+} // libbitcoin
+
+#endif
+
@@ -0,0 +1,116 @@
+#ifndef LIBBITCOIN_STORAGE_CACHING_STORAGE_H
+#define LIBBITCOIN_STORAGE_CACHING_STORAGE_H
+
+#include <bitcoin/storage/storage.hpp>
+
+#include <cstdint>
+#include <mutex>
+
+#include <bitcoin/types.hpp>
+#include <bitcoin/utxo_set.hpp>
+#include <bitcoin/util/hash_key.hpp>
+#include <bitcoin/util/lru_cache.hpp>
+#include <bitcoin/util/threaded_service.hpp>
+
+namespace libbitcoin {
+
+struct cache_statistics
+{
+    uint64_t block_hits, block_misses, output_hits, output_misses;
+    size_t blocks, block_bytes, outputs, output_bytes;
+};
+
+// Fraction of lookups answered from memory, 0 before any
+double hit_rate(uint64_t hits, uint64_t misses);
+
+// Keeps recently stored and fetched blocks, parsed, and their outputs
+// in memory in front of another backend. Stores go through to the
+// backend and are cached once it accepts them, so a block is fetched
+// from memory right after it arrives. Fetches by depth and locators
+// follow the main chain and always go to the backend.
+class caching_storage
+  : public storage,
+    public threaded_service,
+    public std::enable_shared_from_this<caching_storage>
+{
+public:
+    // Hits are answered on a thread of our own, like any other backend,
+    // or on executor when one is shared
+    caching_storage(storage_ptr backend,
+            size_t max_block_bytes=64 * 1024 * 1024,
+            size_t max_output_bytes=16 * 1024 * 1024,
+            thread_pool_ptr executor=thread_pool_ptr());
+
+    void store(const message::inv& inv, store_handler handle_store);
+    void store(const message::transaction& transaction,
+            store_handler handle_store);
+    void store(message::block_ptr block, store_handler handle_store);
+
+    void fetch_inventories(fetch_handler_inventories handle_fetch);
+    void fetch_block_by_depth(size_t block_number,
+            fetch_handler_block handle_fetch);
+    void fetch_block_by_hash(hash_digest block_hash,
+            fetch_handler_block handle_fetch);
+    void fetch_raw_block_by_hash(hash_digest block_hash,
+            fetch_handler_raw_block handle_fetch);
+    void fetch_block_locator(fetch_handler_block_locator handle_fetch);
+    void fetch_output_by_hash(hash_digest transaction_hash, uint32_t index,
+            fetch_handler_output handle_fetch);
+    void fetch_blocks_by_depth_range(size_t begin, size_t end,
+            fetch_handler_blocks handle_fetch);
+    // Only the points missing from memory go to the backend
+    void fetch_outputs(const output_point_list& points,
+            fetch_handler_outputs handle_fetch);
+    // Spent flags are not cached so this always goes to the backend
+    void fetch_unspent_outputs(const output_point_list& points,
+            fetch_handler_outputs handle_fetch);
+    void fetch_outputs_by_pubkey_hash(const short_hash& pubkey_hash,
+            fetch_handler_address_outputs handle_fetch);
+
+    void block_exists_by_hash(hash_digest block_hash,
+            exists_handler handle_exists);
+    void blocks_exist(const hash_list& block_hashes,
+            exists_list_handler handle_exists);
+
+    cache_statistics statistics() const;
+    // The least recently used go first until each fits
+    void set_max_block_bytes(size_t max_block_bytes);
+    void set_max_output_bytes(size_t max_output_bytes);
+
+private:
+    typedef lru_cache<hash_digest, message::block_ptr, hash_digest_hasher>
+        block_cache;
+    typedef lru_cache<output_point, message::transaction_output,
+        output_point_hasher> output_cache;
+
+    void stored_block(const std::error_code& ec, message::block_ptr block,
+            store_handler handle_store);
+    void fetched_block(const std::error_code& ec,
+            const message::block& block, fetch_handler_block handle_fetch);
+    void fetched_output(const std::error_code& ec,
+            const message::transaction_output& output,
+            const output_point& point, fetch_handler_output handle_fetch);
+    void fetched_outputs(const std::error_code& ec,
+            const message::transaction_output_list& fetched,
+            const std::vector<size_t>& fetched_missing,
+            const output_point_list& points,
+            const message::transaction_output_list& outputs,
+            const std::vector<size_t>& positions,
+            fetch_handler_outputs handle_fetch);
+
+    // The block and every output it creates
+    void cache_block(message::block_ptr block);
+
+    storage_ptr backend_;
+    mutable std::mutex mutex_;
+    block_cache blocks_;
+    output_cache outputs_;
+    cache_statistics statistics_;
+};
+
+typedef shared_ptr<caching_storage> caching_storage_ptr;
+
+} // libbitcoin
+
+#endif
+
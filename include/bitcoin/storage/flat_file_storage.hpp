@@ -0,0 +1,223 @@
+#ifndef LIBBITCOIN_STORAGE_FLAT_FILE_STORAGE_H
+#define LIBBITCOIN_STORAGE_FLAT_FILE_STORAGE_H
+
+#include <bitcoin/storage/storage.hpp>
+
+#include <atomic>
+#include <boost/thread/shared_mutex.hpp>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <bitcoin/constants.hpp>
+#include <bitcoin/types.hpp>
+#include <bitcoin/utxo_set.hpp>
+#include <bitcoin/util/hash_key.hpp>
+#include <bitcoin/util/hash_map.hpp>
+#include <bitcoin/util/mapped_file.hpp>
+#include <bitcoin/util/threaded_service.hpp>
+
+namespace libbitcoin {
+
+// Blocks kept as received in append-only blkNNNNN.dat files, with
+// fixed size index records appended alongside them:
+//
+//   blocks.index        hash, previous hash, bits, file, offset, size
+//   transactions.index  hash, block record, offset and size in block
+//   spent.log           spent flag changes, each batch closed by the
+//                       tip of the chain they bring the outputs up to
+//
+// The indexes are mapped and replayed into memory at startup, records
+// past the last complete one are cut off. A block index record is only
+// written once its payload and transactions are, so a crash at worst
+// loses the last block. Reads copy straight out of mapped block files.
+class flat_file_storage
+  : public storage,
+    public threaded_service,
+    public std::enable_shared_from_this<flat_file_storage>
+{
+public:
+    // Creates the directory and stores the genesis block if it is new.
+    // Stores are ordered on one writer strand, which also verifies and
+    // connects main chain blocks. Fetches run on number_readers threads.
+    // The writer strand runs on executor when one is given.
+    flat_file_storage(const std::string& directory, size_t number_readers=4,
+        thread_pool_ptr executor=thread_pool_ptr());
+    ~flat_file_storage();
+
+    void store(const message::inv& inv, store_handler handle_store);
+    void store(const message::transaction& transaction,
+            store_handler handle_store);
+    void store(message::block_ptr block, store_handler handle_store);
+
+    void fetch_inventories(fetch_handler_inventories handle_fetch);
+    void fetch_block_by_depth(size_t block_number,
+            fetch_handler_block handle_fetch);
+    void fetch_block_by_hash(hash_digest block_hash,
+            fetch_handler_block handle_fetch);
+    void fetch_blocks_by_depth_range(size_t begin, size_t end,
+            fetch_handler_blocks handle_fetch);
+    void fetch_raw_block_by_hash(hash_digest block_hash,
+            fetch_handler_raw_block handle_fetch);
+    void fetch_block_locator(fetch_handler_block_locator handle_fetch);
+    void fetch_output_by_hash(hash_digest transaction_hash, uint32_t index,
+            fetch_handler_output handle_fetch);
+    void fetch_outputs(const output_point_list& points,
+            fetch_handler_outputs handle_fetch);
+    void fetch_unspent_outputs(const output_point_list& points,
+            fetch_handler_outputs handle_fetch);
+    void fetch_outputs_by_pubkey_hash(const short_hash& pubkey_hash,
+            fetch_handler_address_outputs handle_fetch);
+
+    void block_exists_by_hash(hash_digest block_hash,
+            exists_handler handle_exists);
+    void blocks_exist(const hash_list& block_hashes,
+            exists_list_handler handle_exists);
+
+    // Main chain blocks verified and connected, counting genesis
+    size_t connected_size() const;
+
+    // For a memory_budget. The unspent output set is safe to resize
+    // from any thread.
+    size_t unspent_bytes() const;
+    void set_unspent_max_bytes(size_t max_bytes);
+    size_t headers_bytes() const;
+
+    // Blocks connected from now on are held to these. Starts out with
+    // mainnet_checkpoints().
+    void set_checkpoints(const chain_checkpoints& checkpoints);
+
+private:
+    struct block_location
+    {
+        hash_digest hash;
+        uint32_t file;
+        // Start of the payload within the file
+        uint64_t offset;
+        uint32_t size;
+    };
+
+    struct transaction_location
+    {
+        // Index of the block's record in blocks.index
+        uint32_t block;
+        uint32_t offset, size;
+    };
+
+    // Block hash to its record in records_
+    typedef hash_flat_map<uint32_t> record_map;
+    // The same transaction can sit in blocks on both sides of a fork
+    typedef std::unordered_multimap<hash_digest, transaction_location,
+        hash_digest_hasher> transaction_map;
+    typedef std::unordered_set<output_point, output_point_hasher> point_set;
+
+    void do_store_block(message::block_ptr block,
+            store_handler handle_store);
+    void do_set_checkpoints(const chain_checkpoints& checkpoints);
+
+    void do_fetch_block_by_depth(size_t block_number,
+            fetch_handler_block handle_fetch);
+    void do_fetch_block_by_hash(hash_digest block_hash,
+            fetch_handler_block handle_fetch);
+    void do_fetch_blocks_by_depth_range(size_t begin, size_t end,
+            fetch_handler_blocks handle_fetch);
+    void do_fetch_raw_block_by_hash(hash_digest block_hash,
+            fetch_handler_raw_block handle_fetch);
+    void do_fetch_block_locator(fetch_handler_block_locator handle_fetch);
+    void do_fetch_output_by_hash(hash_digest transaction_hash, uint32_t index,
+            fetch_handler_output handle_fetch);
+    void do_fetch_outputs(const output_point_list& points,
+            fetch_handler_outputs handle_fetch);
+    void do_fetch_unspent_outputs(const output_point_list& points,
+            fetch_handler_outputs handle_fetch);
+
+    void do_block_exists_by_hash(hash_digest block_hash,
+            exists_handler handle_exists);
+    void do_blocks_exist(const hash_list& block_hashes,
+            exists_list_handler handle_exists);
+
+    std::string path(const std::string& name) const;
+    std::string block_file_path(uint32_t file) const;
+
+    // Startup replay of each index
+    void load_blocks();
+    void load_transactions();
+    void load_spent();
+    void open_files();
+
+    // Writer strand only
+    bool write_block(const hash_digest& block_hash,
+        const message::block& block);
+    bool append_block_payload(const data_chunk& payload,
+        block_location& location);
+    // Connects main chain blocks past the connected tip, after first
+    // stepping back to where it meets the main chain. latest saves
+    // reading back the block that was just written.
+    void organize(const message::block* latest);
+    void disconnect_top();
+    void write_tip();
+    // Buried beneath the assumed valid block on the main header chain
+    bool assumed_valid(size_t depth) const;
+
+    bool find_block(const hash_digest& block_hash,
+        block_location& location) const;
+    bool read_payload(const block_location& location, uint64_t offset,
+        size_t size, data_chunk& payload);
+    bool read_block(const hash_digest& block_hash, message::block& block);
+    bool load_transaction(const transaction_location& location,
+        message::transaction& tx);
+    bool read_output(const transaction_location& location, uint32_t index,
+        unspent_output& output);
+    std::vector<transaction_location> find_transaction(
+        const hash_digest& tx_hash) const;
+    // On the connected chain, so its outputs are spendable. Writer only.
+    bool is_connected(uint32_t record) const;
+
+    bool load_output(const output_point& point, unspent_output& output);
+    // Ignores the spent flag, for rebuilding what a block spent
+    bool load_spent_output(const output_point& point,
+        unspent_output& output);
+    void flush_spends(const utxo_set::change_list& changes);
+
+    std::string directory_;
+    // Answers locator and existence queries
+    header_index_ptr headers_;
+
+    // Guards records_, blocks_ and transactions_ against the writer
+    mutable boost::shared_mutex index_mutex_;
+    std::vector<block_location> records_;
+    record_map blocks_;
+    transaction_map transactions_;
+
+    // Mappings of the block files, replaced once reads run past them
+    std::mutex mappings_mutex_;
+    std::vector<mapped_file_ptr> mappings_;
+
+    // Writer strand only from here
+    int blocks_index_fd_, transactions_index_fd_, spent_log_fd_;
+    int block_file_fd_;
+    uint32_t block_file_;
+    uint64_t block_file_size_;
+
+    dialect_ptr dialect_;
+    thread_pool_ptr verify_pool_;
+    chain_checkpoints checkpoints_;
+    utxo_set_ptr unspent_;
+    point_set spent_;
+    // Hashes of the connected main chain blocks by depth
+    std::vector<hash_digest> connected_;
+    std::atomic<size_t> connected_size_;
+    hash_flat_set failed_;
+
+    // Declared last so they are joined first
+    thread_pool_ptr reader_threads_;
+};
+
+typedef shared_ptr<flat_file_storage> flat_file_storage_ptr;
+
+} // libbitcoin
+
+#endif
+
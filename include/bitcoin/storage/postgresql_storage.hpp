@@ -6,13 +6,33 @@
 #include <cppdb/frontend.h>
 #include <string>
 #include <mutex>
+#include <vector>
 
+#include <bitcoin/constants.hpp>
 #include <bitcoin/util/threaded_service.hpp>
 
 namespace libbitcoin {
 
 class postgresql_blockchain;
 typedef shared_ptr<postgresql_blockchain> postgresql_blockchain_ptr;
+class postgresql_reader_pool;
+typedef shared_ptr<postgresql_reader_pool> postgresql_reader_pool_ptr;
+class postgresql_pruner;
+typedef shared_ptr<postgresql_pruner> postgresql_pruner_ptr;
+class postgresql_address_indexer;
+typedef shared_ptr<postgresql_address_indexer> postgresql_address_indexer_ptr;
+
+// How stored blocks are being gathered into organize and verify runs
+struct organizer_statistics
+{
+    size_t batches, blocks, last_batch_size;
+    // Batch size and wait currently in force
+    size_t clearance;
+    double wait_seconds;
+    // Moving averages of the gap between stored blocks, and of what each
+    // block costs in organize() and verify()
+    double arrival_interval, organize_seconds, verify_seconds;
+};
 
 class postgresql_storage
   : public storage,
@@ -20,31 +40,82 @@ class postgresql_storage
     public std::enable_shared_from_this<postgresql_storage>
 {
 public:
+    // Stores are ordered on one writer strand. Fetches run side by side
+    // on number_readers threads, each with its own session.
+    // Given a snapshot_path, the header index is restored from it at
+    // startup and written back there every few thousand blocks.
+    // The writer strand runs on executor when one is given. Readers
+    // block on the database, so they keep threads of their own.
     postgresql_storage(std::string database, 
-            std::string user, std::string password);
+            std::string user, std::string password,
+            size_t number_readers=4, std::string snapshot_path="",
+            thread_pool_ptr executor=thread_pool_ptr());
 
     void store(const message::inv& inv, store_handler handle_store);
     void store(const message::transaction& transaction,
             store_handler handle_store);
-    void store(const message::block& block, store_handler handle_store);
+    void store(message::block_ptr block, store_handler handle_store);
 
     void fetch_inventories(fetch_handler_inventories handle_fetch);
     void fetch_block_by_depth(size_t block_number, 
             fetch_handler_block handle_fetch);
     void fetch_block_by_hash(hash_digest block_hash, 
             fetch_handler_block handle_fetch);
+    void fetch_blocks_by_depth_range(size_t begin, size_t end,
+            fetch_handler_blocks handle_fetch);
+    void fetch_raw_block_by_hash(hash_digest block_hash,
+            fetch_handler_raw_block handle_fetch);
     void fetch_block_locator(fetch_handler_block_locator handle_fetch);
     void fetch_output_by_hash(hash_digest transaction_hash, uint32_t index,
             fetch_handler_output handle_fetch);
+    void fetch_outputs(const output_point_list& points,
+            fetch_handler_outputs handle_fetch);
+    void fetch_unspent_outputs(const output_point_list& points,
+            fetch_handler_outputs handle_fetch);
+    // Needs set_address_index()
+    void fetch_outputs_by_pubkey_hash(const short_hash& pubkey_hash,
+            fetch_handler_address_outputs handle_fetch);
 
     void block_exists_by_hash(hash_digest block_hash,
             exists_handler handle_exists);
+    void blocks_exist(const hash_list& block_hashes,
+            exists_list_handler handle_exists);
+
+    // Writes the snapshot now, for instance before shutting down
+    void snapshot(store_handler handle_snapshot);
+
+    organizer_statistics statistics() const;
+
+    // For a memory_budget. The unspent output set is safe to resize
+    // from any thread.
+    size_t unspent_bytes() const;
+    void set_unspent_max_bytes(size_t max_bytes);
+    size_t headers_bytes() const;
+
+    // Blocks verified from now on are held to these. Starts out with
+    // mainnet_checkpoints().
+    void set_checkpoints(const chain_checkpoints& checkpoints);
+
+    // Deletes the transactions of main chain blocks more than
+    // keep_blocks beneath the verified tip, in the background. Headers
+    // and unspent outputs stay, and fetching those blocks gives
+    // error::block_pruned. Reorganisations cannot reach back further
+    // than keep_blocks. With a byte_budget, blocks are only pruned
+    // while the database is larger than that.
+    void set_pruning(size_t keep_blocks, uint64_t byte_budget=0);
+
+    // Indexes the outputs of main chain blocks by the pubkey hash they
+    // pay to, in the background and some way behind the verified tip,
+    // carrying on from wherever an earlier run stopped. Blocks pruned
+    // before they are indexed are missing their spent outputs.
+    // Call before fetch_outputs_by_pubkey_hash().
+    void set_address_index();
 
 private:
     void do_store_inv(const message::inv& inv, store_handler handle_store);
     void do_store_transaction(const message::transaction& transaction, 
             store_handler handle_store);
-    void do_store_block(const message::block& block,
+    void do_store_block(message::block_ptr block,
             store_handler handle_store);
 
     void do_fetch_inventories(fetch_handler_inventories handle_fetch);
@@ -52,27 +123,55 @@ private:
             fetch_handler_block handle_fetch);
     void do_fetch_block_by_hash(hash_digest block_hash, 
             fetch_handler_block handle_fetch);
+    void do_fetch_blocks_by_depth_range(size_t begin, size_t end,
+            fetch_handler_blocks handle_fetch);
+    void do_fetch_raw_block_by_hash(hash_digest block_hash,
+            fetch_handler_raw_block handle_fetch);
     void do_fetch_block_locator(fetch_handler_block_locator handle_fetch);
     void do_fetch_output_by_hash(hash_digest transaction_hash, uint32_t index,
             fetch_handler_output handle_fetch);
+    void do_fetch_outputs(const output_point_list& points,
+            fetch_handler_outputs handle_fetch);
+    void do_fetch_unspent_outputs(const output_point_list& points,
+            fetch_handler_outputs handle_fetch);
+    void do_fetch_outputs_by_pubkey_hash(const short_hash& pubkey_hash,
+            fetch_handler_address_outputs handle_fetch);
 
     void do_block_exists_by_hash(hash_digest block_hash,
             exists_handler handle_exists);
+    void do_blocks_exist(const hash_list& block_hashes,
+            exists_list_handler handle_exists);
+
+    void do_snapshot(store_handler handle_snapshot);
+    void do_set_checkpoints(const chain_checkpoints& checkpoints);
+
+    // Restores from the snapshot, then replays blocks stored after it
+    void load_headers();
+    bool write_snapshot();
 
     // ------------
 
-    void insert(operation oper, size_t script_id);
-    size_t insert_script(operation_stack operations);
-    void insert(const message::transaction_input& input,
-            size_t transaction_id, size_t index_in_parent);
-    void insert(const message::transaction_output& output,
-            size_t transaction_id, size_t index_in_parent);
-    size_t insert(const message::transaction& transaction);
+    // Writes the transactions with multi-row INSERTs and returns their ids
+    std::vector<size_t> insert_transactions(
+            const message::transaction_list& transactions);
 
     postgresql_blockchain_ptr blockchain_;
     cppdb::session sql_;
+    // Answers locator and existence queries without touching SQL
+    header_index_ptr headers_;
+    std::string snapshot_path_;
+    uint64_t last_block_id_;
+    size_t blocks_since_snapshot_;
+    std::string connect_string_;
+    postgresql_pruner_ptr pruner_;
+    postgresql_address_indexer_ptr address_indexer_;
+    // Declared before the threads so they are joined first
+    postgresql_reader_pool_ptr readers_;
+    thread_pool_ptr reader_threads_;
 };
 
+typedef shared_ptr<postgresql_storage> postgresql_storage_ptr;
+
 } // libbitcoin
 
 #endif
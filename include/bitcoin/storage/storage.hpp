@@ -3,12 +3,25 @@
 
 #include <boost/utility.hpp>
 #include <functional>
+#include <vector>
 
 #include <bitcoin/error.hpp>
 #include <bitcoin/messages.hpp>
+#include <bitcoin/utxo_set.hpp>
 
 namespace libbitcoin {
 
+// An output found through the address index
+struct address_output
+{
+    output_point point;
+    uint64_t value;
+    // Of the main chain block that created it
+    size_t depth;
+};
+
+typedef std::vector<address_output> address_output_list;
+
 class storage
   : private boost::noncopyable
 {
@@ -26,6 +39,9 @@ public:
         const std::error_code&, const message::block&)>
             fetch_handler_block;
 
+    typedef std::function<void (const std::error_code&, data_chunk_ptr)>
+            fetch_handler_raw_block;
+
     typedef std::function<void (
         const std::error_code&, const message::block_locator&)>
             fetch_handler_block_locator;
@@ -36,11 +52,29 @@ public:
 
     typedef std::function<void (const std::error_code&, bool)> exists_handler;
 
+    // Batches are answered in request order with one callback each
+    typedef std::vector<output_point> output_point_list;
+    typedef std::vector<hash_digest> hash_list;
+    // Outputs that were not found are left empty and their positions
+    // listed in missing
+    typedef std::function<void (const std::error_code&,
+        const message::transaction_output_list&,
+        const std::vector<size_t>& missing)> fetch_handler_outputs;
+    typedef std::function<void (
+        const std::error_code&, const message::block_list&)>
+            fetch_handler_blocks;
+    typedef std::function<void (
+        const std::error_code&, const std::vector<bool>&)>
+            exists_list_handler;
+    typedef std::function<void (
+        const std::error_code&, const address_output_list&)>
+            fetch_handler_address_outputs;
+
     virtual void store(const message::inv& inv,
             store_handler handle_store) = 0;
     virtual void store(const message::transaction& transaction,
             store_handler handle_store) = 0;
-    virtual void store(const message::block& block, 
+    virtual void store(message::block_ptr block,
             store_handler handle_store) = 0;
 
     virtual void fetch_inventories(
@@ -49,13 +83,32 @@ public:
             fetch_handler_block handle_fetch) = 0;
     virtual void fetch_block_by_hash(hash_digest block_hash,    
             fetch_handler_block handle_fetch) = 0;
+    // Main chain blocks from depth begin up to but not including end,
+    // cut short at the top of the chain
+    virtual void fetch_blocks_by_depth_range(size_t begin, size_t end,
+            fetch_handler_blocks handle_fetch) = 0;
+    // The block payload in wire form, ready to send as it is
+    virtual void fetch_raw_block_by_hash(hash_digest block_hash,
+            fetch_handler_raw_block handle_fetch) = 0;
     virtual void fetch_block_locator(
             fetch_handler_block_locator handle_fetch) = 0;
     virtual void fetch_output_by_hash(hash_digest transaction_hash, 
             uint32_t index, fetch_handler_output handle_fetch) = 0;
+    virtual void fetch_outputs(const output_point_list& points,
+            fetch_handler_outputs handle_fetch) = 0;
+    // Only outputs of connected blocks that nothing connected has spent
+    virtual void fetch_unspent_outputs(const output_point_list& points,
+            fetch_handler_outputs handle_fetch) = 0;
+    // Main chain outputs paying to the hash, spent or not, in chain
+    // order. Storages without an address index give
+    // error::unsupported_operation.
+    virtual void fetch_outputs_by_pubkey_hash(const short_hash& pubkey_hash,
+            fetch_handler_address_outputs handle_fetch) = 0;
 
     virtual void block_exists_by_hash(hash_digest block_hash,
             exists_handler handle_exists) = 0;
+    virtual void blocks_exist(const hash_list& block_hashes,
+            exists_list_handler handle_exists) = 0;
 };
 
 } // libbitcoin
@@ -2,6 +2,7 @@
 #define LIBBITCOIN_TRANSACTION_H
 
 #include <bitcoin/messages.hpp>
+#include <bitcoin/util/sha256.hpp>
 
 namespace libbitcoin {
 
@@ -10,7 +11,40 @@ hash_digest hash_transaction(const message::transaction& transaction);
 hash_digest hash_transaction(const message::transaction& transaction, 
         uint32_t hash_type_code);
 
+// Signature hashes for every input of one transaction. The transaction
+// is serialized once with every input script blank, and the digest for
+// an input hashes that with the script code put in its slot. The hash
+// state over the bytes ahead of each slot is kept, so the part before
+// the input being signed is never hashed again.
+class signature_hash_template
+{
+public:
+    explicit signature_hash_template(const message::transaction& tx);
+
+    // Same as hash_transaction(copy, hash_type_code) where copy has every
+    // input script cleared except input_index, which holds script_code.
+    hash_digest digest(uint32_t input_index, const script& script_code,
+        uint32_t hash_type_code) const;
+
+    size_t inputs_size() const;
+
+private:
+    data_chunk template_;
+    // Offset of the empty script's length byte for each input
+    std::vector<size_t> slots_;
+    // Hash of template_ up to each slot
+    std::vector<sha256_stream> prefixes_;
+};
+
+typedef shared_ptr<const signature_hash_template> signature_hash_template_ptr;
+
+// Serialized size in bytes. Used to presize buffers and check limits.
+size_t transaction_size(const message::transaction& tx);
+
 hash_digest generate_merkle_root(const message::transaction_list& transactions);
+// Spreads the wide lower levels of the tree across pool
+hash_digest generate_merkle_root(const message::transaction_list& transactions,
+    thread_pool& pool);
 
 std::string string_repr(const message::transaction& transaction);
 
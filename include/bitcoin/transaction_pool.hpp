@@ -0,0 +1,116 @@
+#ifndef LIBBITCOIN_TRANSACTION_POOL_H
+#define LIBBITCOIN_TRANSACTION_POOL_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <bitcoin/error.hpp>
+#include <bitcoin/messages.hpp>
+#include <bitcoin/script_check.hpp>
+#include <bitcoin/storage/storage.hpp>
+#include <bitcoin/types.hpp>
+#include <bitcoin/utxo_set.hpp>
+#include <bitcoin/util/hash_key.hpp>
+#include <bitcoin/util/threaded_service.hpp>
+
+namespace libbitcoin {
+
+// Unconfirmed transactions indexed by hash and by the outputs they
+// spend. Inputs come from the unspent outputs of storage or from other
+// transactions in the pool, and scripts run on a thread_pool. Past
+// max_bytes the lowest fee rate goes first, along with whatever spends
+// it. Changes happen on our strand while lookups work from any thread.
+class transaction_pool
+  : public threaded_service,
+    public std::enable_shared_from_this<transaction_pool>
+{
+public:
+    typedef std::function<void (const std::error_code&)> store_handler;
+    typedef std::function<void (const hash_digest&,
+        const message::transaction&)> visit_handler;
+
+    // Script checks go to verify_pool. The pool's own strand runs on
+    // executor when one is given.
+    transaction_pool(storage_ptr chain, thread_pool_ptr verify_pool,
+        size_t max_bytes=32 * 1024 * 1024,
+        thread_pool_ptr executor=thread_pool_ptr());
+
+    // The handler runs once the transaction is in the pool or refused
+    void store(const message::transaction& tx, store_handler handle_store);
+    // Drops the block's transactions and any that spent the same outputs
+    void remove_confirmed(message::block_ptr block);
+
+    bool exists(const hash_digest& tx_hash) const;
+    // Wire form, ready to answer a getdata. Null if we do not have it.
+    data_chunk_ptr fetch_raw(const hash_digest& tx_hash) const;
+    // Every transaction in no particular order, such as to fill in a
+    // compact block. The pool is locked meanwhile, so visit must not
+    // call back into it.
+    void for_each(visit_handler visit) const;
+
+    size_t size() const;
+    size_t bytes() const;
+    // Lowest fee rates go first until the pool fits
+    void set_max_bytes(size_t max_bytes);
+
+private:
+    typedef shared_ptr<const message::transaction> transaction_ptr;
+    typedef storage::hash_list hash_list;
+
+    struct entry
+    {
+        transaction_ptr tx;
+        data_chunk_ptr raw;
+        uint64_t fee;
+        size_t bytes;
+    };
+
+    typedef std::unordered_map<hash_digest, entry, hash_digest_hasher>
+        entry_map;
+    // Spent output to the pool transaction spending it
+    typedef std::unordered_map<output_point, hash_digest, output_point_hasher>
+        spend_map;
+    // Satoshis per kilobyte, lowest first
+    typedef std::set<std::pair<uint64_t, hash_digest>> rate_index;
+
+    // Stages of store(), all on the strand
+    void do_store(transaction_ptr tx, store_handler handle_store);
+    void checked_inputs(const std::error_code& ec,
+        const message::transaction_output_list& chain_outputs,
+        const std::vector<size_t>& missing, transaction_ptr tx,
+        const hash_digest& tx_hash,
+        const message::transaction_output_list& pool_outputs,
+        const std::vector<size_t>& positions, store_handler handle_store);
+    // parents are the pool transactions it spends, which must still
+    // be there
+    void checked_scripts(bool success, transaction_ptr tx,
+        const hash_digest& tx_hash, const hash_list& parents, uint64_t fee,
+        store_handler handle_store);
+    void do_remove_confirmed(message::block_ptr block);
+    void do_set_max_bytes(size_t max_bytes);
+
+    // Callers hold mutex_
+    bool conflicts(const message::transaction& tx) const;
+    void insert(const hash_digest& tx_hash, const entry& new_entry);
+    void erase(const hash_digest& tx_hash);
+    void erase_with_spenders(const hash_digest& tx_hash);
+    void enforce_limit();
+
+    storage_ptr chain_;
+    script_check_queue script_checks_;
+    size_t max_bytes_, bytes_;
+    entry_map entries_;
+    spend_map spends_;
+    rate_index rates_;
+    mutable std::mutex mutex_;
+};
+
+} // libbitcoin
+
+#endif
+
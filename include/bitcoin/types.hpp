@@ -10,6 +10,7 @@
 #include <vector>
 
 #include <bitcoin/network/types.hpp>
+#include <bitcoin/util/endian.hpp>
 
 namespace libbitcoin {
 
@@ -25,12 +26,28 @@ namespace net {
     class network;
 } // net
 class clock;
+class thread_pool;
+class utxo_set;
+class header_index;
+class header_sync;
+class download_scheduler;
+class getblocks_sync;
+class partial_block;
+class transaction_pool;
 
 typedef shared_ptr<dialect> dialect_ptr;
 typedef shared_ptr<storage> storage_ptr;
 typedef shared_ptr<kernel> kernel_ptr;
 typedef shared_ptr<network> network_ptr;
 typedef shared_ptr<clock> clock_ptr;
+typedef shared_ptr<thread_pool> thread_pool_ptr;
+typedef shared_ptr<utxo_set> utxo_set_ptr;
+typedef shared_ptr<header_index> header_index_ptr;
+typedef shared_ptr<header_sync> header_sync_ptr;
+typedef shared_ptr<download_scheduler> download_scheduler_ptr;
+typedef shared_ptr<getblocks_sync> getblocks_sync_ptr;
+typedef shared_ptr<partial_block> partial_block_ptr;
+typedef shared_ptr<transaction_pool> transaction_pool_ptr;
 
 typedef shared_ptr<io_service> service_ptr;
 typedef shared_ptr<io_service::work> work_ptr;
@@ -43,48 +60,78 @@ typedef std::array<uint8_t, 20> short_hash;
 
 typedef unsigned char byte;
 typedef std::vector<byte> data_chunk;
+// Immutable bytes handed around without copying, like a stored block
+typedef shared_ptr<const data_chunk> data_chunk_ptr;
 
 void extend_data(data_chunk& chunk, const data_chunk& other);
 
+// Non-owning view of a run of bytes inside some other buffer.
+// It is only valid while that buffer is alive and unmodified.
+class data_view
+{
+public:
+    data_view(const byte* begin, const byte* end)
+      : begin_(begin), end_(end)
+    {
+    }
+    explicit data_view(const data_chunk& chunk)
+      : begin_(chunk.data()), end_(chunk.data() + chunk.size())
+    {
+    }
+
+    const byte* begin() const
+    {
+        return begin_;
+    }
+    const byte* end() const
+    {
+        return end_;
+    }
+    size_t size() const
+    {
+        return end_ - begin_;
+    }
+    bool empty() const
+    {
+        return begin_ == end_;
+    }
+
+private:
+    const byte* begin_;
+    const byte* end_;
+};
+
+// Reads the first sizeof(T) bytes, big endian unless reverse is set
 template<typename T>
-T cast_chunk(data_chunk chunk, bool reverse=false)
+T cast_chunk(const data_chunk& chunk, bool reverse=false)
 {
-    #ifdef BOOST_LITTLE_ENDIAN
-        reverse = !reverse;
-    #elif BOOST_BIG_ENDIAN
-        // do nothing
-    #else
-        #error "Endian isn't defined!"
-    #endif
-
-    if (reverse)
-        std::reverse(chunk.begin(), chunk.end());
-
-    T val = 0;
-    for (size_t i = 0; i < sizeof(T); ++i)
-        val += static_cast<T>(chunk[i]) << (i*8);
-    return val;
+    return reverse ? from_little_endian<T>(chunk.data()) :
+        from_big_endian<T>(chunk.data());
 }
 
+// Little endian bytes of val
 template<typename T>
 data_chunk uncast_type(T val)
 {
-    data_chunk chunk;
-    for (size_t i = 0; i < sizeof(T); ++i)
-        chunk.push_back(reinterpret_cast<byte*>(&val)[i]);
+    data_chunk chunk(sizeof(T));
+    to_little_endian(chunk.data(), val);
     return chunk;
 }
 
+// Space separated byte pairs, for logs. See util/hex.hpp for plain hex.
 template<typename T>
-std::string hexlify(T data)
+std::string hexlify(const T& data)
 {
-    std::stringstream ss;
-    ss << std::hex;
-    for (int val: data)
-        ss << std::setw(2) << std::setfill('0') << val << ' ';
-    // Remove end ' '
-    std::string ret = ss.str();
-    ret.resize(ret.size() - 1);
+    const char digits[] = "0123456789abcdef";
+    std::string ret;
+    ret.reserve(3 * data.size());
+    for (byte val: data)
+    {
+        if (!ret.empty())
+            ret += ' ';
+        ret += digits[val >> 4];
+        ret += digits[val & 0x0f];
+    }
     return ret;
 }
 
@@ -1,20 +1,31 @@
 #ifndef LIBBITCOIN_ELLIPTIC_CURVE_KEY_H
 #define LIBBITCOIN_ELLIPTIC_CURVE_KEY_H
 
+#include <boost/utility.hpp>
 #include <openssl/ec.h>
+#include <list>
+#include <map>
+#include <mutex>
 #include <stdexcept>
+#include <vector>
 
 #include <bitcoin/types.hpp>
 
 namespace libbitcoin {
 
+// Built once with its precomputation and shared read only
+const EC_GROUP* secp256k1_group();
+
 class elliptic_curve_key
+  : private boost::noncopyable
 {
 public:
     elliptic_curve_key();
+    ~elliptic_curve_key();
 
-    bool set_public_key(data_chunk pubkey);
-    bool verify(hash_digest hash, data_chunk signature);
+    bool set_public_key(const data_chunk& pubkey);
+    // Only reads the key, so one key can verify from several threads
+    bool verify(hash_digest hash, const data_chunk& signature) const;
 
 private:
     bool initialize();
@@ -22,6 +33,45 @@ private:
     EC_KEY* key_;
 };
 
+typedef shared_ptr<elliptic_curve_key> elliptic_curve_key_ptr;
+
+// Parsed public keys by their raw bytes, so a key that signs many
+// inputs is only decoded once. Safe to share between threads. The
+// oldest entry is dropped once capacity is reached.
+class public_key_cache
+  : private boost::noncopyable
+{
+public:
+    explicit public_key_cache(size_t capacity=50000);
+
+    // Returns null when pubkey is not a valid point
+    elliptic_curve_key_ptr get(const data_chunk& pubkey);
+
+private:
+    typedef std::map<data_chunk, elliptic_curve_key_ptr> key_map;
+
+    const size_t capacity_;
+    std::mutex mutex_;
+    key_map keys_;
+    std::list<key_map::iterator> insertion_order_;
+};
+
+// Process wide cache used by script evaluation
+public_key_cache& shared_public_key_cache();
+
+struct signature_check
+{
+    hash_digest hash;
+    data_chunk signature;
+    data_chunk pubkey;
+};
+
+typedef std::vector<signature_check> signature_check_list;
+
+// One result per check, in order. Each distinct pubkey is parsed once.
+std::vector<bool> verify_signatures(const signature_check_list& checks,
+    public_key_cache& cache=shared_public_key_cache());
+
 } // libbitcoin
 
 #endif
@@ -0,0 +1,91 @@
+#ifndef LIBBITCOIN_ENDIAN_H
+#define LIBBITCOIN_ENDIAN_H
+
+#include <boost/detail/endian.hpp>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace libbitcoin {
+
+// Integers loaded from and stored to raw bytes in a fixed byte order.
+// The host order is known at compile time and the copy is a single
+// unaligned move, so each of these compiles to a mov, plus a bswap
+// when the orders differ.
+
+constexpr uint8_t byte_swap(uint8_t value)
+{
+    return value;
+}
+constexpr uint16_t byte_swap(uint16_t value)
+{
+    return static_cast<uint16_t>((value >> 8) | (value << 8));
+}
+constexpr uint32_t byte_swap(uint32_t value)
+{
+    return __builtin_bswap32(value);
+}
+constexpr uint64_t byte_swap(uint64_t value)
+{
+    return __builtin_bswap64(value);
+}
+
+#ifdef BOOST_LITTLE_ENDIAN
+    constexpr bool host_little_endian = true;
+#elif BOOST_BIG_ENDIAN
+    constexpr bool host_little_endian = false;
+#else
+    #error "Endian isn't defined!"
+#endif
+
+template <typename T>
+T load_host_order(const uint8_t* data)
+{
+    static_assert(std::is_integral<T>::value, "integers only");
+    typename std::make_unsigned<T>::type value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+template <typename T>
+T from_little_endian(const uint8_t* data)
+{
+    typedef typename std::make_unsigned<T>::type unsigned_type;
+    const unsigned_type value = load_host_order<unsigned_type>(data);
+    return host_little_endian ? value : byte_swap(value);
+}
+
+template <typename T>
+T from_big_endian(const uint8_t* data)
+{
+    typedef typename std::make_unsigned<T>::type unsigned_type;
+    const unsigned_type value = load_host_order<unsigned_type>(data);
+    return host_little_endian ? byte_swap(value) : value;
+}
+
+template <typename T>
+void to_little_endian(uint8_t* data, T value)
+{
+    static_assert(std::is_integral<T>::value, "integers only");
+    typedef typename std::make_unsigned<T>::type unsigned_type;
+    const unsigned_type ordered = host_little_endian ?
+        static_cast<unsigned_type>(value) :
+        byte_swap(static_cast<unsigned_type>(value));
+    std::memcpy(data, &ordered, sizeof(ordered));
+}
+
+template <typename T>
+void to_big_endian(uint8_t* data, T value)
+{
+    static_assert(std::is_integral<T>::value, "integers only");
+    typedef typename std::make_unsigned<T>::type unsigned_type;
+    const unsigned_type ordered = host_little_endian ?
+        byte_swap(static_cast<unsigned_type>(value)) :
+        static_cast<unsigned_type>(value);
+    std::memcpy(data, &ordered, sizeof(ordered));
+}
+
+} // libbitcoin
+
+#endif
+
@@ -0,0 +1,89 @@
+#ifndef LIBBITCOIN_HASH_KEY_H
+#define LIBBITCOIN_HASH_KEY_H
+
+#include <cstring>
+#include <random>
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+#include <bitcoin/types.hpp>
+
+namespace libbitcoin {
+
+// Random per process, so nobody can grind keys that collide in our
+// tables without seeing them
+inline uint64_t hash_key_salt()
+{
+    static const uint64_t salt =
+        (static_cast<uint64_t>(std::random_device()()) << 32) ^
+            std::random_device()();
+    return salt;
+}
+
+// Digests are already uniform, except that block hashes in display
+// order start with zero bytes, so the key comes from the last 8 bytes.
+// One multiply mixes in the salt and spreads it over the low bits
+// power of two tables index by.
+class hash_digest_hasher
+{
+public:
+    hash_digest_hasher()
+      : salt_(hash_key_salt())
+    {
+    }
+
+    size_t operator()(const hash_digest& hash) const
+    {
+        return mix(tail(hash));
+    }
+
+    // For keys built around a digest, like output points
+    static uint64_t tail(const hash_digest& hash)
+    {
+        uint64_t value;
+        std::memcpy(&value, hash.data() + hash.size() - sizeof(value),
+            sizeof(value));
+        return value;
+    }
+    size_t mix(uint64_t value) const
+    {
+        value = (value ^ salt_) * 0x9e3779b97f4a7c15;
+        return value ^ (value >> 32);
+    }
+
+private:
+    uint64_t salt_;
+};
+
+// Two unaligned 16 byte compares instead of a byte loop
+inline bool hash_digest_equal(const hash_digest& left,
+    const hash_digest& right)
+{
+#ifdef __SSE2__
+    const __m128i* left_words = reinterpret_cast<const __m128i*>(left.data());
+    const __m128i* right_words =
+        reinterpret_cast<const __m128i*>(right.data());
+    const __m128i low = _mm_cmpeq_epi8(_mm_loadu_si128(left_words),
+        _mm_loadu_si128(right_words));
+    const __m128i high = _mm_cmpeq_epi8(_mm_loadu_si128(left_words + 1),
+        _mm_loadu_si128(right_words + 1));
+    return _mm_movemask_epi8(_mm_and_si128(low, high)) == 0xffff;
+#else
+    return std::memcmp(left.data(), right.data(), left.size()) == 0;
+#endif
+}
+
+struct hash_digest_equal_to
+{
+    bool operator()(const hash_digest& left, const hash_digest& right) const
+    {
+        return hash_digest_equal(left, right);
+    }
+};
+
+} // libbitcoin
+
+#endif
+
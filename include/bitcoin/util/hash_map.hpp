@@ -0,0 +1,277 @@
+#ifndef LIBBITCOIN_HASH_MAP_H
+#define LIBBITCOIN_HASH_MAP_H
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <bitcoin/types.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/hash_key.hpp>
+
+namespace libbitcoin {
+
+// Open addressing map keyed by digest, with linear probing over a power
+// of two run of slots. Each slot has a control byte holding 7 bits of
+// the key's hash, so most probes that miss never touch the key itself.
+// Erasing shifts later entries back rather than leaving tombstones.
+// Values must be default constructible. Pointers returned are valid
+// until the next insert or erase. Not thread safe.
+template <typename Value>
+class hash_flat_map
+{
+public:
+    explicit hash_flat_map(size_t expected_size=0)
+      : size_(0)
+    {
+        reserve(expected_size);
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+    // Number of slots, full or not
+    size_t capacity() const
+    {
+        return control_.size();
+    }
+
+    void clear()
+    {
+        std::fill(control_.begin(), control_.end(), empty_slot);
+        std::fill(slots_.begin(), slots_.end(), slot());
+        size_ = 0;
+    }
+
+    // Room for this many without growing
+    void reserve(size_t expected_size)
+    {
+        if (expected_size == 0)
+            return;
+        size_t slots = minimum_slots;
+        while (slots * max_load_numerator <
+                expected_size * max_load_denominator)
+            slots *= 2;
+        if (slots > capacity())
+            rehash(slots);
+    }
+
+    Value* find(const hash_digest& key)
+    {
+        const size_t position = locate(key);
+        return position == npos ? nullptr : &slots_[position].value;
+    }
+    const Value* find(const hash_digest& key) const
+    {
+        const size_t position = locate(key);
+        return position == npos ? nullptr : &slots_[position].value;
+    }
+    bool contains(const hash_digest& key) const
+    {
+        return locate(key) != npos;
+    }
+
+    // Leaves any value already there alone. The bool says if the key
+    // is new.
+    std::pair<Value*, bool> insert(const hash_digest& key,
+        const Value& value)
+    {
+        if (capacity() == 0 || (size_ + 1) * max_load_denominator >
+                capacity() * max_load_numerator)
+            rehash(std::max(2 * capacity(), minimum_slots));
+        const size_t hash = hasher_(key);
+        const uint8_t tag = control_tag(hash);
+        const size_t mask = capacity() - 1;
+        for (size_t position = hash & mask;; position = (position + 1) & mask)
+        {
+            if (control_[position] == empty_slot)
+            {
+                control_[position] = tag;
+                slots_[position].key = key;
+                slots_[position].value = value;
+                ++size_;
+                return std::make_pair(&slots_[position].value, true);
+            }
+            if (control_[position] == tag &&
+                    hash_digest_equal(slots_[position].key, key))
+                return std::make_pair(&slots_[position].value, false);
+        }
+    }
+
+    Value& operator[](const hash_digest& key)
+    {
+        return *insert(key, Value()).first;
+    }
+
+    bool erase(const hash_digest& key)
+    {
+        size_t hole = locate(key);
+        if (hole == npos)
+            return false;
+        const size_t mask = capacity() - 1;
+        // Move back any entry that probed past the hole to get where it is
+        for (size_t position = (hole + 1) & mask;
+            control_[position] != empty_slot;
+            position = (position + 1) & mask)
+        {
+            const size_t home = hasher_(slots_[position].key) & mask;
+            if (((position - home) & mask) >= ((position - hole) & mask))
+            {
+                control_[hole] = control_[position];
+                slots_[hole] = std::move(slots_[position]);
+                hole = position;
+            }
+        }
+        control_[hole] = empty_slot;
+        slots_[hole] = slot();
+        --size_;
+        return true;
+    }
+
+    // The first key at or after a slot, wrapping around, for callers
+    // that want to drop an arbitrary entry. Must not be empty.
+    const hash_digest& key_near(size_t position) const
+    {
+        BITCOIN_ASSERT(!empty());
+        const size_t mask = capacity() - 1;
+        position &= mask;
+        while (control_[position] == empty_slot)
+            position = (position + 1) & mask;
+        return slots_[position].key;
+    }
+
+    // Calls visit(key, value) for each entry, in no particular order
+    template <typename Visitor>
+    void for_each(Visitor visit) const
+    {
+        for (size_t position = 0; position < capacity(); ++position)
+            if (control_[position] != empty_slot)
+                visit(slots_[position].key, slots_[position].value);
+    }
+
+private:
+    struct slot
+    {
+        hash_digest key;
+        Value value;
+    };
+
+    static constexpr uint8_t empty_slot = 0;
+    static constexpr size_t minimum_slots = 16;
+    // Full at seven eighths
+    static constexpr size_t max_load_numerator = 7;
+    static constexpr size_t max_load_denominator = 8;
+    static constexpr size_t npos = ~size_t(0);
+
+    // The top bit keeps it apart from empty_slot
+    static uint8_t control_tag(size_t hash)
+    {
+        return 0x80 | (hash >> (8 * sizeof(size_t) - 7));
+    }
+
+    size_t locate(const hash_digest& key) const
+    {
+        if (size_ == 0)
+            return npos;
+        const size_t hash = hasher_(key);
+        const uint8_t tag = control_tag(hash);
+        const size_t mask = capacity() - 1;
+        for (size_t position = hash & mask;; position = (position + 1) & mask)
+        {
+            if (control_[position] == empty_slot)
+                return npos;
+            if (control_[position] == tag &&
+                    hash_digest_equal(slots_[position].key, key))
+                return position;
+        }
+    }
+
+    void rehash(size_t slots)
+    {
+        std::vector<uint8_t> old_control(slots, empty_slot);
+        std::vector<slot> old_slots(slots);
+        old_control.swap(control_);
+        old_slots.swap(slots_);
+        size_ = 0;
+        for (size_t position = 0; position < old_control.size(); ++position)
+            if (old_control[position] != empty_slot)
+                insert(old_slots[position].key,
+                    std::move(old_slots[position].value));
+    }
+
+    hash_digest_hasher hasher_;
+    std::vector<uint8_t> control_;
+    std::vector<slot> slots_;
+    size_t size_;
+};
+
+template <typename Value>
+constexpr uint8_t hash_flat_map<Value>::empty_slot;
+template <typename Value>
+constexpr size_t hash_flat_map<Value>::minimum_slots;
+template <typename Value>
+constexpr size_t hash_flat_map<Value>::max_load_numerator;
+template <typename Value>
+constexpr size_t hash_flat_map<Value>::max_load_denominator;
+template <typename Value>
+constexpr size_t hash_flat_map<Value>::npos;
+
+// Keys alone, on the same table
+class hash_flat_set
+{
+public:
+    explicit hash_flat_set(size_t expected_size=0)
+      : map_(expected_size)
+    {
+    }
+
+    size_t size() const
+    {
+        return map_.size();
+    }
+    bool empty() const
+    {
+        return map_.empty();
+    }
+    void clear()
+    {
+        map_.clear();
+    }
+    void reserve(size_t expected_size)
+    {
+        map_.reserve(expected_size);
+    }
+    bool contains(const hash_digest& key) const
+    {
+        return map_.contains(key);
+    }
+    // False if it was already there
+    bool insert(const hash_digest& key)
+    {
+        return map_.insert(key, placeholder()).second;
+    }
+    bool erase(const hash_digest& key)
+    {
+        return map_.erase(key);
+    }
+    const hash_digest& key_near(size_t position) const
+    {
+        return map_.key_near(position);
+    }
+
+private:
+    struct placeholder
+    {
+    };
+    hash_flat_map<placeholder> map_;
+};
+
+} // libbitcoin
+
+#endif
+
@@ -0,0 +1,28 @@
+#ifndef LIBBITCOIN_HEX_H
+#define LIBBITCOIN_HEX_H
+
+#include <string>
+
+#include <bitcoin/types.hpp>
+
+namespace libbitcoin {
+
+// Lowercase hex without separators, two characters per byte.
+// Writes exactly 2 * size characters to out and no terminator.
+void encode_hex(const byte* data, size_t size, char* out);
+std::string encode_hex(const data_chunk& data);
+std::string encode_hex(const hash_digest& hash);
+
+// Either case is accepted. Reads 2 * size characters into size bytes and
+// returns false, leaving out partly written, on anything that is not a
+// hex digit.
+bool decode_hex(const char* hex, size_t size, byte* out);
+// False for an odd length too
+bool decode_hex(const std::string& hex, data_chunk& out);
+// Exactly 64 digits
+bool decode_hex(const std::string& hex, hash_digest& out);
+
+} // libbitcoin
+
+#endif
+
@@ -1,7 +1,17 @@
 #ifndef LIBBITCOIN_LOGGER_H
 #define LIBBITCOIN_LOGGER_H
 
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <sstream>
+#include <string>
+
+// Levels below this number are compiled out: 0 keeps everything from
+// debug up, 4 only fatal
+#ifndef LIBBITCOIN_LOG_LEVEL
+#define LIBBITCOIN_LOG_LEVEL 0
+#endif
 
 namespace libbitcoin {
 
@@ -14,29 +24,91 @@ enum class logger_level
     fatal
 };
 
+// Writes one finished message. Runs on the logging thread.
+typedef std::function<void (logger_level, const std::string&)>
+    log_sink_handler;
+
+extern std::atomic<int> log_threshold;
+
+// Both the compile time and the runtime thresholds must let it through
+inline bool log_enabled(logger_level level)
+{
+    return static_cast<int>(level) >= LIBBITCOIN_LOG_LEVEL &&
+        static_cast<int>(level) >= log_threshold.load(
+            std::memory_order_relaxed);
+}
+
+// Everything from debug up by default
+void set_log_level(logger_level level);
+// Errors and worse go to std::cerr and the rest to std::cout unless
+// another sink is set. A null handler restores that.
+void set_log_sink(log_sink_handler handle_message);
+// Waits for everything logged so far to reach the sink
+void flush_log();
+
+// Hand over a finished message. It goes on a lock free queue and a
+// background thread writes it out, so callers never wait on the sink.
+void log_message(logger_level level, const std::string& text);
+
+// Holds no stream at all for a level that is off, so nothing
+// streamed into it is ever formatted
 class logger_wrapper
 {
 public:
-    logger_wrapper(logger_level lev); 
-    logger_wrapper(const logger_wrapper& other);
-    ~logger_wrapper();
+    explicit logger_wrapper(logger_level level)
+      : stream_(log_enabled(level) ? new std::ostringstream : nullptr),
+        level_(level)
+    {
+    }
+    logger_wrapper(logger_wrapper&& other)
+      : stream_(std::move(other.stream_)), level_(other.level_)
+    {
+    }
+    ~logger_wrapper()
+    {
+        if (stream_)
+            log_message(level_, stream_->str());
+    }
 
     template <typename T>
-    logger_wrapper& operator<<(T const& value) 
+    logger_wrapper& operator<<(T const& value)
     {
-        stream << value;
+        if (stream_)
+            *stream_ << value;
         return *this;
     }
 private:
-    std::ostringstream stream;
-    logger_level lev_;
+    logger_wrapper(const logger_wrapper&) = delete;
+    void operator=(const logger_wrapper&) = delete;
+
+    std::unique_ptr<std::ostringstream> stream_;
+    logger_level level_;
 };
 
-logger_wrapper log_debug();
-logger_wrapper log_info();
-logger_wrapper log_warning();
-logger_wrapper log_error();
-logger_wrapper log_fatal();
+inline logger_wrapper log_debug()
+{
+    return logger_wrapper(logger_level::debug);
+}
+
+inline logger_wrapper log_info()
+{
+    return logger_wrapper(logger_level::info);
+}
+
+inline logger_wrapper log_warning()
+{
+    return logger_wrapper(logger_level::warning);
+}
+
+inline logger_wrapper log_error()
+{
+    return logger_wrapper(logger_level::error);
+}
+
+inline logger_wrapper log_fatal()
+{
+    return logger_wrapper(logger_level::fatal);
+}
 
 } // libbitcoin
 
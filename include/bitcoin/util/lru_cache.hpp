@@ -0,0 +1,99 @@
+#ifndef LIBBITCOIN_LRU_CACHE_H
+#define LIBBITCOIN_LRU_CACHE_H
+
+#include <boost/utility.hpp>
+#include <list>
+#include <unordered_map>
+
+namespace libbitcoin {
+
+// Values by key up to a budget in bytes, dropping the least recently
+// used first. Callers say what each value costs. Not thread safe.
+template <typename Key, typename Value, typename Hasher>
+class lru_cache
+  : private boost::noncopyable
+{
+public:
+    explicit lru_cache(size_t max_bytes)
+      : max_bytes_(max_bytes), bytes_(0)
+    {
+    }
+
+    // Copies the value out and makes it the most recent
+    bool find(const Key& key, Value& value)
+    {
+        auto it = index_.find(key);
+        if (it == index_.end())
+            return false;
+        entries_.splice(entries_.begin(), entries_, it->second);
+        value = it->second->value;
+        return true;
+    }
+
+    bool contains(const Key& key) const
+    {
+        return index_.count(key) > 0;
+    }
+
+    // Replaces any value already there. One bigger than the whole
+    // budget is not kept at all.
+    void insert(const Key& key, const Value& value, size_t bytes)
+    {
+        erase(key);
+        if (bytes > max_bytes_)
+            return;
+        entries_.push_front(entry{key, value, bytes});
+        index_[key] = entries_.begin();
+        bytes_ += bytes;
+        while (bytes_ > max_bytes_)
+            erase(entries_.back().key);
+    }
+
+    void erase(const Key& key)
+    {
+        auto it = index_.find(key);
+        if (it == index_.end())
+            return;
+        bytes_ -= it->second->bytes;
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+
+    size_t size() const
+    {
+        return index_.size();
+    }
+    size_t bytes() const
+    {
+        return bytes_;
+    }
+
+    // Drops the least recent until it fits
+    void set_max_bytes(size_t max_bytes)
+    {
+        max_bytes_ = max_bytes;
+        while (bytes_ > max_bytes_)
+            erase(entries_.back().key);
+    }
+
+private:
+    struct entry
+    {
+        Key key;
+        Value value;
+        size_t bytes;
+    };
+    // Most recent first
+    typedef std::list<entry> entry_list;
+    typedef std::unordered_map<Key, typename entry_list::iterator, Hasher>
+        index_map;
+
+    size_t max_bytes_, bytes_;
+    entry_list entries_;
+    index_map index_;
+};
+
+} // libbitcoin
+
+#endif
+
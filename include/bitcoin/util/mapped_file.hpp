@@ -0,0 +1,33 @@
+#ifndef LIBBITCOIN_MAPPED_FILE_H
+#define LIBBITCOIN_MAPPED_FILE_H
+
+#include <boost/utility.hpp>
+#include <string>
+
+#include <bitcoin/types.hpp>
+
+namespace libbitcoin {
+
+// Read-only mapping of a whole file as it was when opened, released
+// on destruction. Empty if the file is missing or empty.
+class mapped_file
+  : private boost::noncopyable
+{
+public:
+    explicit mapped_file(const std::string& path);
+    ~mapped_file();
+
+    const byte* data() const;
+    size_t size() const;
+
+private:
+    const byte* data_;
+    size_t size_;
+};
+
+typedef shared_ptr<mapped_file> mapped_file_ptr;
+
+} // libbitcoin
+
+#endif
+
@@ -0,0 +1,67 @@
+#ifndef LIBBITCOIN_MEMORY_BUDGET_H
+#define LIBBITCOIN_MEMORY_BUDGET_H
+
+#include <boost/utility.hpp>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace libbitcoin {
+
+// One memory limit for the process instead of one per cache. Users
+// register how to read what they hold and, if they can give it back,
+// how to take a new limit. rebalance() shares out the total by weight,
+// and what a user is not using is lent to the ones at their limits.
+// Users below their share may grow by a quarter each round. Usage and
+// limits are published as "memory.NAME.bytes" and "memory.NAME.limit"
+// gauges, fixed users having no limit, along with "memory.total.bytes"
+// and "memory.total.limit".
+class memory_budget
+  : private boost::noncopyable
+{
+public:
+    typedef std::function<size_t ()> usage_handler;
+    typedef std::function<void (size_t)> limit_handler;
+
+    explicit memory_budget(size_t total_bytes);
+
+    // Counted against the total before it is shared out, for memory
+    // that cannot be given back such as the header index
+    void add_fixed(const std::string& name, usage_handler usage);
+    // set_limit is called from rebalance() and must not call back into
+    // the budget
+    void add(const std::string& name, double weight, usage_handler usage,
+        limit_handler set_limit);
+    void remove(const std::string& name);
+
+    void set_total(size_t total_bytes);
+    size_t total() const;
+
+    void rebalance();
+    // As of the last rebalance(), or 0 for fixed and unknown users
+    size_t limit(const std::string& name) const;
+
+private:
+    struct user
+    {
+        std::string name;
+        double weight;
+        usage_handler usage;
+        // Empty for fixed users
+        limit_handler set_limit;
+        size_t limit;
+    };
+    typedef std::vector<user> user_list;
+
+    void publish(const std::string& name, size_t bytes, size_t limit);
+
+    size_t total_bytes_;
+    user_list users_;
+    mutable std::mutex mutex_;
+};
+
+} // libbitcoin
+
+#endif
+
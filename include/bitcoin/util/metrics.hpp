@@ -0,0 +1,110 @@
+#ifndef LIBBITCOIN_METRICS_H
+#define LIBBITCOIN_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace libbitcoin {
+
+// Everything here is safe to update from any thread. Updates are single
+// relaxed atomic operations, so instrumenting a hot path costs next to
+// nothing; readers may see one metric a moment ahead of another.
+
+class counter
+{
+public:
+    counter();
+    void add(uint64_t amount=1)
+    {
+        value_.fetch_add(amount, std::memory_order_relaxed);
+    }
+    uint64_t value() const;
+private:
+    std::atomic<uint64_t> value_;
+};
+
+class gauge
+{
+public:
+    gauge();
+    void set(int64_t value)
+    {
+        value_.store(value, std::memory_order_relaxed);
+    }
+    void add(int64_t amount)
+    {
+        value_.fetch_add(amount, std::memory_order_relaxed);
+    }
+    int64_t value() const;
+private:
+    std::atomic<int64_t> value_;
+};
+
+// Latencies in microseconds, bucketed HDR style: exact below 16 and
+// then 16 buckets per power of two, so any reading is within about 6%
+// of what was recorded whatever the range.
+class latency_histogram
+{
+public:
+    static constexpr size_t sub_buckets = 16;
+    static constexpr size_t bucket_count = sub_buckets * 61;
+
+    latency_histogram();
+    void record(uint64_t microseconds);
+
+    uint64_t count() const;
+    uint64_t sum() const;
+    uint64_t max() const;
+    // Highest value in the bucket holding the q-th quantile, 0 < q <= 1
+    uint64_t percentile(double q) const;
+private:
+    std::array<std::atomic<uint64_t>, bucket_count> buckets_;
+    std::atomic<uint64_t> count_, sum_, max_;
+};
+
+// Records the time from construction to destruction
+class scoped_timer
+{
+public:
+    explicit scoped_timer(latency_histogram& histogram);
+    ~scoped_timer();
+private:
+    typedef std::chrono::high_resolution_clock timer_clock;
+
+    latency_histogram& histogram_;
+    timer_clock::time_point start_;
+};
+
+// Metrics are created on first use and live as long as the registry,
+// so callers can hold on to the references. Names are dotted paths
+// like "storage.store_block".
+class metrics_registry
+{
+public:
+    counter& get_counter(const std::string& name);
+    gauge& get_gauge(const std::string& name);
+    latency_histogram& get_histogram(const std::string& name);
+
+    // One "name value" line per metric, histograms as several
+    std::string to_text() const;
+    std::string to_json() const;
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<counter>> counters_;
+    std::map<std::string, std::unique_ptr<gauge>> gauges_;
+    std::map<std::string, std::unique_ptr<latency_histogram>> histograms_;
+};
+
+// The process wide registry the library instruments itself into
+metrics_registry& shared_metrics();
+
+} // libbitcoin
+
+#endif
+
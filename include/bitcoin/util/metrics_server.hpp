@@ -0,0 +1,47 @@
+#ifndef LIBBITCOIN_METRICS_SERVER_H
+#define LIBBITCOIN_METRICS_SERVER_H
+
+#include <boost/asio/streambuf.hpp>
+#include <memory>
+
+#include <bitcoin/types.hpp>
+#include <bitcoin/util/metrics.hpp>
+#include <bitcoin/util/threaded_service.hpp>
+
+namespace libbitcoin {
+
+// Answers plain HTTP on the loopback interface with a snapshot of the
+// registry: GET /metrics.json for JSON and any other path for text.
+// GET /trace.json dumps the recorded trace spans.
+class metrics_server
+  : public threaded_service,
+    public std::enable_shared_from_this<metrics_server>
+{
+public:
+    explicit metrics_server(metrics_registry& registry=shared_metrics());
+    ~metrics_server();
+
+    bool start(unsigned short port=8334);
+    void stop();
+
+private:
+    typedef shared_ptr<tcp::acceptor> acceptor_ptr;
+    typedef shared_ptr<boost::asio::streambuf> streambuf_ptr;
+    typedef shared_ptr<std::string> string_ptr;
+
+    void accept();
+    void handle_accept(const boost::system::error_code& ec,
+        socket_ptr socket);
+    void handle_request(const boost::system::error_code& ec,
+        socket_ptr socket, streambuf_ptr request);
+
+    metrics_registry& registry_;
+    acceptor_ptr acceptor_;
+};
+
+typedef shared_ptr<metrics_server> metrics_server_ptr;
+
+} // libbitcoin
+
+#endif
+
@@ -0,0 +1,44 @@
+#ifndef LIBBITCOIN_ROLLING_BLOOM_FILTER_H
+#define LIBBITCOIN_ROLLING_BLOOM_FILTER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <bitcoin/types.hpp>
+
+namespace libbitcoin {
+
+// Approximate set of the most recent insertions in fixed memory. Bits
+// live in two generations and the older is dropped once the newer has
+// taken half the capacity, so at least capacity / 2 of the latest items
+// are always remembered. contains() is never wrong about those but may
+// be about others, at around false_positive_rate. The hashes are keyed
+// with a random tweak so peers cannot aim for collisions.
+class rolling_bloom_filter
+{
+public:
+    rolling_bloom_filter(size_t capacity,
+        double false_positive_rate=0.00001);
+
+    void insert(const uint8_t* data, size_t size);
+    void insert(const hash_digest& hash);
+    bool contains(const uint8_t* data, size_t size) const;
+    bool contains(const hash_digest& hash) const;
+
+    void clear();
+
+private:
+    typedef std::vector<uint64_t> bit_array;
+
+    bool set_in(const bit_array& bits, uint64_t first,
+        uint64_t second) const;
+
+    size_t generation_capacity_, bit_count_, hash_count_, inserted_;
+    uint64_t tweak_;
+    bit_array current_, previous_;
+};
+
+} // libbitcoin
+
+#endif
+
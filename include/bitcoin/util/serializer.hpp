@@ -13,25 +13,44 @@ namespace libbitcoin {
 class serializer
 {
 public:
+    serializer();
+    // Append to an existing buffer, keeping its allocated capacity.
+    // Lets callers recycle one buffer across many messages.
+    explicit serializer(data_chunk&& buffer);
+
+    // Preallocate room for size_hint more bytes to avoid regrowing.
+    void reserve(size_t size_hint);
+    size_t size() const;
+
     void write_byte(uint8_t v);
     void write_2_bytes(uint16_t v);
     void write_4_bytes(uint32_t v);
     void write_8_bytes(uint64_t v);
     void write_var_uint(uint64_t v);
     void write_data(const data_chunk& other_data);
-    void write_net_addr(message::net_addr addr);
-    void write_hash(hash_digest hash);
-    void write_command(std::string command);
+    void write_data(const byte* other_data, size_t size);
+    void write_net_addr(const message::net_addr& addr);
+    void write_hash(const hash_digest& hash);
+    void write_command(const std::string& command);
 
     data_chunk get_data() const;
+    // Hands the buffer over without copying. Leaves the serializer empty.
+    data_chunk release_data();
 private:
     data_chunk data_;
 };
 
+size_t variable_uint_size(uint64_t v);
+
+// Reads from a stream owned by the caller. Nothing is copied out except
+// by read_data(), so the stream must outlive the deserializer and any
+// data_view returned by read_view().
 class deserializer
 {
 public:
     deserializer(const data_chunk& stream);
+    // Start reading part way in
+    deserializer(const data_chunk& stream, size_t start);
 
     uint8_t read_byte();
     uint16_t read_2_bytes();
@@ -39,9 +58,16 @@ public:
     uint64_t read_8_bytes();
     uint64_t read_var_uint();
     data_chunk read_data(uint64_t n_bytes);
+    // Borrow the next n_bytes without copying them
+    data_view read_view(uint64_t n_bytes);
     message::net_addr read_net_addr();
     hash_digest read_hash();
     std::string read_fixed_len_str(size_t len);
+
+    // Offset of the next byte to be read
+    size_t position() const;
+    // Bytes consumed since an earlier position()
+    data_view view_from(size_t start) const;
 private:
     const data_chunk& stream_;
     size_t pointer_;
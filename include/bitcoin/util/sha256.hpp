@@ -11,8 +11,39 @@ namespace libbitcoin {
 constexpr size_t sha256_length = SHA256_DIGEST_LENGTH;
 
 hash_digest generate_sha256_hash(const data_chunk& chunk);
+hash_digest generate_sha256_hash(const data_view& view);
 uint32_t generate_sha256_checksum(const data_chunk& chunk);
 
+// SHA-256 fed a piece at a time. A copy carries the state along with
+// it, so the hash of a shared prefix can be kept and resumed from.
+class sha256_stream
+{
+public:
+    sha256_stream();
+
+    void update(const byte* data, size_t size);
+    void update(const data_chunk& data);
+    // Same as generate_sha256_hash() over everything written so far.
+    // The stream is left as it was.
+    hash_digest double_hash() const;
+
+private:
+    uint32_t state_[8];
+    // Bytes short of a full block, waiting for more
+    byte pending_[64];
+    uint64_t length_;
+};
+
+// Name of the backend picked for this CPU, e.g. "sha-ni" or "portable"
+const char* sha256_implementation();
+
+// Double SHA-256 of number_blocks consecutive 64 byte inputs, written as
+// consecutive 32 byte digests. Digests stay in OpenSSL (wire) byte order
+// and are not reversed. output may overlap input when output <= input,
+// which lets merkle levels be hashed in place.
+void generate_sha256d_64(byte* output, const byte* input,
+    size_t number_blocks);
+
 } // libbitcoin
 
 #endif
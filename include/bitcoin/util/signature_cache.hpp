@@ -0,0 +1,58 @@
+#ifndef LIBBITCOIN_SIGNATURE_CACHE_H
+#define LIBBITCOIN_SIGNATURE_CACHE_H
+
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/utility.hpp>
+#include <atomic>
+#include <random>
+
+#include <bitcoin/types.hpp>
+#include <bitcoin/util/hash_map.hpp>
+
+namespace libbitcoin {
+
+// Signatures that already verified, so a transaction seen once when
+// relayed and again in a block (or after a reorg) is not checked twice.
+// Only successes are stored. Entries are salted hashes of
+// (sighash, pubkey, signature), and a random one is dropped when full.
+class signature_cache
+  : private boost::noncopyable
+{
+public:
+    explicit signature_cache(size_t max_bytes=32 * 1024 * 1024);
+
+    void set_max_size(size_t max_bytes);
+
+    // Counts towards hits() or misses()
+    bool contains(const hash_digest& sighash, const data_chunk& pubkey,
+        const data_chunk& signature);
+    void add(const hash_digest& sighash, const data_chunk& pubkey,
+        const data_chunk& signature);
+
+    size_t size() const;
+    // What the entries take, as counted against max_bytes
+    size_t bytes() const;
+    size_t hits() const;
+    size_t misses() const;
+
+private:
+    hash_digest entry_key(const hash_digest& sighash,
+        const data_chunk& pubkey, const data_chunk& signature) const;
+    // Caller holds the write lock
+    void evict_random_entry();
+
+    mutable boost::shared_mutex mutex_;
+    hash_flat_set entries_;
+    size_t max_entries_;
+    hash_digest salt_;
+    std::mt19937 random_;
+    std::atomic<size_t> hits_, misses_;
+};
+
+// Process wide cache consulted by OP_CHECKSIG
+signature_cache& shared_signature_cache();
+
+} // libbitcoin
+
+#endif
+
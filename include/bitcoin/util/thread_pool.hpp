@@ -0,0 +1,45 @@
+#ifndef LIBBITCOIN_THREAD_POOL_H
+#define LIBBITCOIN_THREAD_POOL_H
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <bitcoin/types.hpp>
+
+namespace libbitcoin {
+
+// Fixed set of worker threads running one io_service. Unlike
+// threaded_service there is no strand, so posted work runs concurrently.
+class thread_pool
+{
+public:
+    typedef std::function<void (size_t begin, size_t end)> range_handler;
+
+    // 0 picks one thread per hardware core
+    explicit thread_pool(size_t number_threads=0);
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    void operator=(const thread_pool&) = delete;
+
+    size_t size() const;
+    service_ptr service();
+
+    // Splits [0, count) into contiguous ranges of at least min_range
+    // items and runs them across the workers. The calling thread takes a
+    // share too and returns once every range has completed, so it is
+    // safe to call from inside a worker.
+    void parallel_for(size_t count, size_t min_range,
+        range_handler handle_range);
+
+private:
+    service_ptr service_;
+    work_ptr work_;
+    std::vector<std::thread> runners_;
+};
+
+} // libbitcoin
+
+#endif
+
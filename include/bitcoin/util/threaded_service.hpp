@@ -2,6 +2,7 @@
 #define LIBBITCOIN_THREADED_SERVICE_H
 
 #include <thread>
+#include <vector>
 
 #include <bitcoin/types.hpp>
 
@@ -10,14 +11,25 @@ namespace libbitcoin {
 class threaded_service
 {
 protected:
-    threaded_service();
+    // Handlers on strand() never run concurrently, others may once
+    // there is more than one thread. 0 picks one per hardware core.
+    threaded_service(size_t number_threads=1);
+    // Runs on a thread_pool shared with other components instead of
+    // threads of its own. The strand is still ours alone, but handlers
+    // posted straight to service() can run on any of the pool's threads.
+    // A null executor means one thread of our own, as above.
+    explicit threaded_service(thread_pool_ptr executor);
     ~threaded_service();
     service_ptr service();
     strand_ptr strand();
 private:
+    void start(size_t number_threads);
+
+    // Null unless running on a shared pool
+    thread_pool_ptr executor_;
     service_ptr service_;
     strand_ptr strand_;
-    std::thread runner_;
+    std::vector<std::thread> runners_;
     work_ptr work_;
 };
 
@@ -0,0 +1,74 @@
+#ifndef LIBBITCOIN_TRACE_H
+#define LIBBITCOIN_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <bitcoin/types.hpp>
+
+namespace libbitcoin {
+
+// Spans follow one block through the pipeline stages. Tracing is off
+// by default and then a span costs a single relaxed load. Once on,
+// finished spans go into a ring buffer holding the newest
+// trace_capacity of them.
+
+constexpr size_t trace_capacity = 65536;
+
+extern std::atomic<bool> trace_active;
+
+inline bool tracing_enabled()
+{
+    return trace_active.load(std::memory_order_relaxed);
+}
+
+void set_tracing(bool enabled);
+
+struct trace_event
+{
+    // Always a string literal
+    const char* name;
+    // Zero for spans that are not about one block
+    hash_digest block_hash;
+    uint64_t thread;
+    // Microseconds since tracing first started
+    uint64_t start, duration;
+};
+
+typedef std::vector<trace_event> trace_event_list;
+
+// Records the time from construction to destruction. Spans started
+// while tracing is off are never recorded.
+class trace_span
+{
+public:
+    explicit trace_span(const char* name,
+        const hash_digest& block_hash=hash_digest());
+    ~trace_span();
+    // For stages that only learn the hash part way through
+    void set_block(const hash_digest& block_hash);
+private:
+    trace_span(const trace_span&) = delete;
+    void operator=(const trace_span&) = delete;
+
+    const char* name_;
+    hash_digest block_hash_;
+    bool active_;
+    uint64_t start_;
+};
+
+// Oldest first
+trace_event_list trace_events();
+void clear_trace();
+
+// Chrome trace event format, for chrome://tracing or Perfetto. Each
+// span is a complete event with its block hash as an argument.
+std::string trace_to_chrome_json();
+bool write_trace(const std::string& path);
+
+} // libbitcoin
+
+#endif
+
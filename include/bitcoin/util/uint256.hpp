@@ -0,0 +1,132 @@
+#ifndef LIBBITCOIN_UINT256_H
+#define LIBBITCOIN_UINT256_H
+
+#include <cstdint>
+
+#include <bitcoin/types.hpp>
+
+namespace libbitcoin {
+
+// Fixed width unsigned 256 bit integer for proof of work targets and
+// chain work. Arithmetic wraps like the built in unsigned types.
+class uint256
+{
+public:
+    constexpr uint256()
+      : words_{0, 0, 0, 0}
+    {
+    }
+    constexpr uint256(uint64_t value)
+      : words_{value, 0, 0, 0}
+    {
+    }
+    // Least significant word first
+    constexpr uint256(uint64_t word0, uint64_t word1,
+        uint64_t word2, uint64_t word3)
+      : words_{word0, word1, word2, word3}
+    {
+    }
+
+    // The target encoded in a block's bits. Negative and overflowing
+    // encodings are out of range and decode to zero.
+    static constexpr uint256 from_compact(uint32_t compact)
+    {
+        return compact_in_range(compact) ?
+            uint256(compact_word(compact, 0), compact_word(compact, 1),
+                compact_word(compact, 2), compact_word(compact, 3)) :
+            uint256();
+    }
+    // Hashes read as big endian numbers, in the order they are displayed
+    static uint256 from_hash(const hash_digest& hash);
+    hash_digest to_hash() const;
+
+    constexpr uint64_t word(size_t index) const
+    {
+        return words_[index];
+    }
+    constexpr bool is_zero() const
+    {
+        return (words_[0] | words_[1] | words_[2] | words_[3]) == 0;
+    }
+    // Position of the highest set bit plus one, or 0 for zero
+    size_t bit_length() const;
+
+    uint256& operator+=(const uint256& other);
+    uint256& operator-=(const uint256& other);
+    uint256& operator<<=(size_t shift);
+    uint256& operator>>=(size_t shift);
+    // Dividing by zero gives zero
+    uint256& operator/=(const uint256& divisor);
+
+    constexpr uint256 operator~() const
+    {
+        return uint256(~words_[0], ~words_[1], ~words_[2], ~words_[3]);
+    }
+
+    // Less than zero, zero or more than zero, from the top word down
+    static constexpr int compare(const uint256& left, const uint256& right,
+        size_t index=3)
+    {
+        return left.words_[index] != right.words_[index] ?
+            (left.words_[index] < right.words_[index] ? -1 : 1) :
+            (index == 0 ? 0 : compare(left, right, index - 1));
+    }
+
+private:
+    static constexpr bool compact_in_range(uint32_t compact)
+    {
+        // The sign bit is only allowed on a zero mantissa
+        return (compact & 0x007fffff) == 0 || ((compact & 0x00800000) == 0 &&
+            (compact >> 24) <= 34 &&
+            ((compact >> 24) <= 33 || (compact & 0x007fffff) <= 0xff) &&
+            ((compact >> 24) <= 32 || (compact & 0x007fffff) <= 0xffff));
+    }
+    static constexpr uint64_t compact_word(uint32_t compact, int index)
+    {
+        return shifted_word(compact & 0x007fffff,
+            8 * (static_cast<int>(compact >> 24) - 3) - 64 * index);
+    }
+    // The part of value << offset landing in a word starting at bit 0,
+    // where a negative offset shifts right
+    static constexpr uint64_t shifted_word(uint64_t value, int offset)
+    {
+        return offset >= 64 || offset <= -64 ? 0 :
+            (offset >= 0 ? value << offset : value >> -offset);
+    }
+
+    uint64_t words_[4];
+};
+
+constexpr bool operator==(const uint256& left, const uint256& right)
+{
+    return uint256::compare(left, right) == 0;
+}
+constexpr bool operator!=(const uint256& left, const uint256& right)
+{
+    return uint256::compare(left, right) != 0;
+}
+constexpr bool operator<(const uint256& left, const uint256& right)
+{
+    return uint256::compare(left, right) < 0;
+}
+constexpr bool operator>(const uint256& left, const uint256& right)
+{
+    return uint256::compare(left, right) > 0;
+}
+constexpr bool operator<=(const uint256& left, const uint256& right)
+{
+    return uint256::compare(left, right) <= 0;
+}
+constexpr bool operator>=(const uint256& left, const uint256& right)
+{
+    return uint256::compare(left, right) >= 0;
+}
+
+uint256 operator+(uint256 left, const uint256& right);
+uint256 operator-(uint256 left, const uint256& right);
+uint256 operator/(uint256 left, const uint256& right);
+
+} // libbitcoin
+
+#endif
+
@@ -0,0 +1,113 @@
+#ifndef LIBBITCOIN_UTXO_SET_H
+#define LIBBITCOIN_UTXO_SET_H
+
+#include <boost/utility.hpp>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <bitcoin/messages.hpp>
+#include <bitcoin/types.hpp>
+#include <bitcoin/util/hash_key.hpp>
+
+namespace libbitcoin {
+
+struct output_point
+{
+    hash_digest hash;
+    uint32_t index;
+};
+
+bool operator==(const output_point& point_a, const output_point& point_b);
+
+// Hash maps keyed by output point, salted like hash_digest_hasher
+class output_point_hasher
+  : private hash_digest_hasher
+{
+public:
+    size_t operator()(const output_point& point) const
+    {
+        return mix(tail(point.hash) + point.index);
+    }
+};
+
+struct unspent_output
+{
+    uint64_t value;
+    // save_script() form, only parsed when a script actually runs
+    data_chunk raw_script;
+};
+
+// Unspent outputs held in memory in front of a backing store.
+// The backing store is expected to already hold every output of a block
+// before it connects, as postgresql_storage writes blocks ahead of
+// verifying them. So only spent flags are written back, in batches
+// through flush_handler. Lookups that miss go to load_handler. Once over
+// max_bytes the set flushes and drops entries, which load again on demand.
+// Outputs are held compressed and expanded again by fetch().
+class utxo_set
+  : private boost::noncopyable
+{
+public:
+    typedef std::vector<std::pair<output_point, unspent_output>> undo_list;
+    // (point, spent) pairs to persist
+    typedef std::vector<std::pair<output_point, bool>> change_list;
+
+    typedef std::function<bool (const output_point&, unspent_output&)>
+        load_handler;
+    typedef std::function<void (const change_list&)> flush_handler;
+
+    utxo_set(load_handler handle_load, flush_handler handle_flush,
+        size_t max_bytes=256 * 1024 * 1024);
+
+    bool fetch(const output_point& point, unspent_output& output);
+
+    // Spends the block's inputs and adds its outputs. undo receives the
+    // spent outputs in order. Nothing changes if any input is missing or
+    // already spent.
+    bool connect(const message::block& block, undo_list& undo);
+    void disconnect(const message::block& block, const undo_list& undo);
+
+    void flush();
+
+    size_t size() const;
+    size_t bytes() const;
+    // Flushes and drops entries at once if it is over
+    void set_max_bytes(size_t max_bytes);
+
+private:
+    struct entry
+    {
+        // compress_output() form, which for standard scripts is a
+        // fraction of the size
+        data_chunk output;
+        bool spent;
+        // Spent flag differs from the backing store
+        bool dirty;
+    };
+
+    typedef std::unordered_map<output_point, entry, output_point_hasher>
+        entry_map;
+
+    // Callers hold mutex_
+    entry* find_or_load(const output_point& point);
+    void insert(const output_point& point, entry new_entry);
+    void erase(entry_map::iterator it);
+    void undo_connect(const message::block& block,
+        size_t number_transactions, const undo_list& undo);
+    void flush_changes();
+    void enforce_limit();
+
+    load_handler handle_load_;
+    flush_handler handle_flush_;
+    size_t max_bytes_, bytes_;
+    entry_map entries_;
+    mutable std::mutex mutex_;
+};
+
+} // libbitcoin
+
+#endif
+
@@ -0,0 +1,40 @@
+#ifndef LIBBITCOIN_UTXO_VERIFY_BLOCK_H
+#define LIBBITCOIN_UTXO_VERIFY_BLOCK_H
+
+#include <bitcoin/messages.hpp>
+#include <bitcoin/script_check.hpp>
+#include <bitcoin/types.hpp>
+#include <bitcoin/utxo_set.hpp>
+#include <bitcoin/verify.hpp>
+
+namespace libbitcoin {
+
+// Checks a block and runs every input script against the unspent
+// output it spends. Lookups stay on the calling thread and only the
+// script runs fan out over the pool. Shared by the storage backends.
+// Without run_scripts only the block itself is checked, for blocks
+// buried beneath the assumed valid one.
+class utxo_verify_block
+  : public verify_block
+{
+public:
+    utxo_verify_block(dialect_ptr dialect, thread_pool_ptr pool,
+        utxo_set& unspent, const message::block& current_block,
+        bool run_scripts=true);
+    bool check();
+
+private:
+    bool check_scripts();
+    bool fetch_output_script(const message::transaction_input& input,
+        script& output_script);
+
+    utxo_set& unspent_;
+    script_check_queue script_checks_;
+    const message::block& current_block_;
+    bool run_scripts_;
+};
+
+} // libbitcoin
+
+#endif
+
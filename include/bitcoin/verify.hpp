@@ -4,6 +4,7 @@
 #include <thread>
 #include <memory>
 
+#include <bitcoin/constants.hpp>
 #include <bitcoin/messages.hpp>
 #include <bitcoin/types.hpp>
 #include <bitcoin/util/threaded_service.hpp>
@@ -13,20 +14,34 @@ namespace libbitcoin {
 class verify_block
 {
 protected:
-    verify_block(dialect_ptr dialect, const message::block& current_block);
+    // pool may be null, in which case everything runs on the calling thread
+    verify_block(dialect_ptr dialect, thread_pool_ptr pool,
+        const message::block& current_block);
+    // Returns at once for blocks already checked on arrival
     bool check_block();
 
 private:
-    bool check_proof_of_work(hash_digest hash, uint32_t bits);
-    bool check_transaction(const message::transaction& tx);
-    size_t number_script_operations();
-
     dialect_ptr dialect_;
-    clock_ptr clock_;
+    thread_pool_ptr pool_;
 
     const message::block& current_block_;
 };
 
+// CheckBlock(): size, proof of work, timestamp, coinbase placement,
+// each transaction and the merkle root. None of it needs the chain, so
+// it runs as soon as a block is parsed. A pass is remembered on the
+// block. pool may be null.
+bool check_block_context_free(const message::block& block,
+    thread_pool* pool=nullptr);
+
+// False if a checkpoint at this depth names some other block
+bool check_checkpoints(const checkpoint_list& checkpoints, size_t depth,
+    const hash_digest& block_hash);
+
+// Hash is at or below the target encoded in bits, and that target is
+// within the network limit
+bool check_proof_of_work(hash_digest block_hash, uint32_t bits);
+
 } // libbitcoin
 
 #endif
@@ -1,10 +1,13 @@
 set -x
 test ! -d out && mkdir out
 test ! -d out/py && mkdir out/py
-PY_CFLAGS=`python-config --cflags`
-PY_LIBS=`python-config --libs`
-SWIG_FLAGS="-shared -export-dynamic"
+PY_CFLAGS=`python3-config --includes`
+PY_LIBS=`python3-config --ldflags`
+SWIG_FLAGS="-shared -fPIC"
+# Everything goes into one shared object, so build from clean with this
+OBJS="obj/chain_scanner.o obj/flat_file_storage.o obj/postgresql_storage.o obj/postgresql_blockchain.o obj/caching_storage.o obj/header_index.o obj/mapped_file.o obj/utxo_set.o obj/compressed_output.o obj/utxo_verify_block.o obj/script_check.o obj/verify.o obj/big_number.o obj/uint256.o obj/clock.o obj/constants.o obj/lazy_block.o obj/dialect.o obj/serializer.o obj/block.o obj/transaction.o obj/script.o obj/signature_cache.o obj/sha256.o obj/sha256_portable.o obj/sha256_shani.o obj/sha256_avx2.o obj/ripemd.o obj/logger.o obj/metrics.o obj/trace.o obj/hex.o obj/types.o obj/elliptic_curve_key.o obj/error.o obj/threaded_service.o obj/thread_pool.o"
+make OPTFLAGS="-O2 -fPIC" $OBJS || exit 1
 
-swig2.0 -c++ -python -O -threads -outdir out/py/ -o out/libbitcoin_wrap.cxx -Iinclude include/bindings/libbitcoin.i
+swig -c++ -python -O -outdir out/py/ -o out/libbitcoin_wrap.cxx -Iinclude bindings/libbitcoin.i || exit 1
 
-g++-4.5 bin/test.cpp out/libbitcoin_wrap.cxx src/net/*.cpp src/net/dialects/*.cpp -std=c++0x -lboost_system -lboost_thread -Wall -Wextra -pedantic -Iinclude/ $SWIG_FLAGS $PY_CFLAGS $PY_LIBS -o out/py/_libbitcoin.so
+g++ out/libbitcoin_wrap.cxx $OBJS -std=c++0x -O2 -pthread -Iinclude/ -Iusr/include/ $SWIG_FLAGS $PY_CFLAGS usr/lib/libcppdb.a -lcrypto -lboost_thread -lboost_system -ldl -lpq $PY_LIBS -o out/py/_libbitcoin.so
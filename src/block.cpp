@@ -1,5 +1,6 @@
 #include <bitcoin/block.hpp>
 
+#include <bitcoin/transaction.hpp>
 #include <bitcoin/util/serializer.hpp>
 #include <bitcoin/util/sha256.hpp>
 #include <bitcoin/types.hpp>
@@ -8,14 +9,27 @@ namespace libbitcoin {
 
 hash_digest hash_block_header(const message::block& block)
 {
+    if (block.cached_hash.valid())
+        return block.cached_hash.get();
     serializer key;
+    key.reserve(80);
     key.write_4_bytes(block.version);
     key.write_hash(block.prev_block);
     key.write_hash(block.merkle_root);
     key.write_4_bytes(block.timestamp);
     key.write_4_bytes(block.bits);
     key.write_4_bytes(block.nonce);
-    return generate_sha256_hash(key.get_data());
+    block.cached_hash.set(generate_sha256_hash(key.release_data()));
+    return block.cached_hash.get();
+}
+
+size_t block_size(const message::block& block)
+{
+    // 80 byte header followed by the transaction count
+    size_t size = 80 + variable_uint_size(block.transactions.size());
+    for (const message::transaction& tx: block.transactions)
+        size += transaction_size(tx);
+    return size;
 }
 
 } // libbitcoin
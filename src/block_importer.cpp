@@ -0,0 +1,200 @@
+#include <bitcoin/block_importer.hpp>
+
+#include <algorithm>
+
+#include <bitcoin/constants.hpp>
+#include <bitcoin/lazy_block.hpp>
+#include <bitcoin/verify.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/logger.hpp>
+#include <bitcoin/util/metrics.hpp>
+#include <bitcoin/util/thread_pool.hpp>
+
+namespace libbitcoin {
+
+using std::placeholders::_1;
+
+// Magic and length
+constexpr size_t record_header_size = 4 + 4;
+// The block size limit, so a corrupt length ends the file
+constexpr size_t max_record_size = 1000000;
+
+static uint32_t read_4_bytes(const byte* data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) |
+        (static_cast<uint32_t>(data[3]) << 24);
+}
+
+block_record_list find_block_records(const byte* data, size_t size)
+{
+    block_record_list records;
+    size_t position = 0;
+    while (size - position >= record_header_size)
+    {
+        if (read_4_bytes(data + position) != magic_value)
+            break;
+        const uint32_t length = read_4_bytes(data + position + 4);
+        position += record_header_size;
+        if (length > max_record_size || length > size - position)
+            break;
+        records.push_back(block_record{position, length});
+        position += length;
+    }
+    return records;
+}
+
+block_importer::block_importer(storage_ptr chain, thread_pool_ptr parse_pool,
+    size_t batch_size, thread_pool_ptr executor)
+  : threaded_service(executor), chain_(chain), parse_pool_(parse_pool),
+    batch_size_(std::max<size_t>(batch_size, 1)), next_path_(0),
+    next_record_(0), outstanding_(0), waiting_(false), input_done_(false)
+{
+}
+
+void block_importer::import(const std::vector<std::string>& paths,
+    import_handler handle_import)
+{
+    strand()->post(std::bind(&block_importer::do_import,
+        shared_from_this(), paths, handle_import));
+}
+void block_importer::do_import(const std::vector<std::string>& paths,
+    import_handler handle_import)
+{
+    paths_ = paths;
+    next_path_ = 0;
+    file_.reset();
+    records_.clear();
+    next_record_ = 0;
+    outstanding_ = 0;
+    waiting_ = false;
+    input_done_ = false;
+    statistics_ = import_statistics();
+    handle_import_ = handle_import;
+    continue_import();
+}
+
+void block_importer::continue_import()
+{
+    // One batch with storage and the next right behind it
+    while (outstanding_ <= batch_size_)
+        if (!next_batch())
+        {
+            input_done_ = true;
+            if (outstanding_ == 0)
+                finish();
+            return;
+        }
+    waiting_ = true;
+}
+
+bool block_importer::open_next_file()
+{
+    while (next_path_ < paths_.size())
+    {
+        const std::string& path = paths_[next_path_++];
+        file_ = std::make_shared<mapped_file>(path);
+        records_ = find_block_records(file_->data(), file_->size());
+        next_record_ = 0;
+        ++statistics_.files;
+        log_info() << "Importing " << records_.size() << " blocks from "
+            << path;
+        if (!records_.empty())
+            return true;
+    }
+    file_.reset();
+    return false;
+}
+
+bool block_importer::next_batch()
+{
+    static latency_histogram& parse_time =
+        shared_metrics().get_histogram("importer.parse_batch");
+    if (next_record_ == records_.size() && !open_next_file())
+        return false;
+    const size_t first = next_record_,
+        count = std::min(batch_size_, records_.size() - first);
+    std::vector<message::block_ptr> blocks(count);
+    {
+        scoped_timer timer(parse_time);
+        const byte* data = file_->data();
+        parse_pool_->parallel_for(count, 1,
+            [&](size_t begin, size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    const block_record& record = records_[first + i];
+                    const byte* payload = data + record.offset;
+                    // Walked for bounds before anything is decoded
+                    lazy_block lazy(
+                        data_chunk(payload, payload + record.size));
+                    if (!lazy.valid())
+                        continue;
+                    message::block_ptr block =
+                        std::make_shared<const message::block>(
+                            lazy.decode());
+                    // Already on a worker, so the checks run here
+                    if (check_block_context_free(*block))
+                        blocks[i] = block;
+                }
+            });
+    }
+    next_record_ += count;
+    for (size_t i = 0; i < count; ++i)
+    {
+        ++statistics_.blocks;
+        statistics_.bytes += records_[first + i].size;
+        if (!blocks[i])
+        {
+            ++statistics_.rejected;
+            continue;
+        }
+        ++outstanding_;
+        chain_->store(blocks[i], strand()->wrap(std::bind(
+            &block_importer::handle_store, shared_from_this(), _1)));
+    }
+    // Payloads were copied out, so the mapping can go
+    if (next_record_ == records_.size())
+    {
+        file_.reset();
+        records_.clear();
+        next_record_ = 0;
+    }
+    return true;
+}
+
+void block_importer::handle_store(const std::error_code& ec)
+{
+    BITCOIN_ASSERT(outstanding_ > 0);
+    --outstanding_;
+    if (!ec)
+        ++statistics_.stored;
+    else if (ec == error::object_already_exists)
+        ++statistics_.duplicates;
+    else
+        ++statistics_.rejected;
+    if (input_done_)
+    {
+        if (outstanding_ == 0)
+            finish();
+    }
+    else if (waiting_ && outstanding_ <= batch_size_)
+    {
+        waiting_ = false;
+        continue_import();
+    }
+}
+
+void block_importer::finish()
+{
+    log_info() << "Imported " << statistics_.stored << " of "
+        << statistics_.blocks << " blocks from " << statistics_.files
+        << " files, " << statistics_.duplicates << " already stored and "
+        << statistics_.rejected << " rejected";
+    import_handler handle_import = handle_import_;
+    handle_import_ = nullptr;
+    paths_.clear();
+    handle_import(std::error_code(), statistics_);
+}
+
+} // libbitcoin
+
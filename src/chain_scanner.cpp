@@ -0,0 +1,175 @@
+#include <bitcoin/chain_scanner.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include <bitcoin/dialect.hpp>
+#include <bitcoin/error.hpp>
+#include <bitcoin/lazy_block.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/util/metrics.hpp>
+
+namespace libbitcoin {
+
+// Wire bytes of transaction index, from the payload when there is one
+static data_chunk transaction_bytes(const message::block& block,
+    const lazy_block* lazy, size_t index)
+{
+    if (lazy == nullptr)
+        return original_dialect().to_network(
+            block.transactions[index], false);
+    const data_view view = lazy->transaction_data(index);
+    return data_chunk(view.begin(), view.end());
+}
+
+void fill_transaction_columns(const message::block_list& blocks,
+    size_t first_depth, transaction_columns& columns, thread_pool_ptr pool)
+{
+    // First row of each block, then the end of the last
+    std::vector<size_t> first_rows(1, 0);
+    for (const message::block& block: blocks)
+        first_rows.push_back(first_rows.back() + block.transactions.size());
+    const size_t rows = first_rows.back();
+    columns.depths.resize(rows);
+    columns.positions.resize(rows);
+    columns.versions.resize(rows);
+    columns.locktimes.resize(rows);
+    columns.input_counts.resize(rows);
+    columns.output_counts.resize(rows);
+    columns.output_values.resize(rows);
+    columns.hashes.resize(rows * hash_digest().size());
+    columns.raw_offsets.resize(rows + 1);
+    std::vector<data_chunk> raw_rows(rows);
+    auto fill_blocks =
+        [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                const message::block& block = blocks[i];
+                std::unique_ptr<lazy_block> lazy;
+                if (block.raw_payload)
+                {
+                    lazy.reset(new lazy_block(block.raw_payload));
+                    if (!lazy->valid() || lazy->transactions_size() !=
+                            block.transactions.size())
+                        lazy.reset();
+                }
+                for (size_t j = 0; j < block.transactions.size(); ++j)
+                {
+                    const message::transaction& tx = block.transactions[j];
+                    const size_t row = first_rows[i] + j;
+                    columns.depths[row] = first_depth + i;
+                    columns.positions[row] = j;
+                    columns.versions[row] = tx.version;
+                    columns.locktimes[row] = tx.locktime;
+                    columns.input_counts[row] = tx.inputs.size();
+                    columns.output_counts[row] = tx.outputs.size();
+                    uint64_t value = 0;
+                    for (const message::transaction_output& output:
+                            tx.outputs)
+                        value += output.value;
+                    columns.output_values[row] = value;
+                    const hash_digest tx_hash = hash_transaction(tx);
+                    std::copy(tx_hash.begin(), tx_hash.end(),
+                        columns.hashes.begin() + row * tx_hash.size());
+                    raw_rows[row] = transaction_bytes(block, lazy.get(), j);
+                }
+            }
+        };
+    if (pool)
+        pool->parallel_for(blocks.size(), 1, fill_blocks);
+    else
+        fill_blocks(0, blocks.size());
+    columns.raw_offsets[0] = 0;
+    for (size_t row = 0; row < rows; ++row)
+        columns.raw_offsets[row + 1] =
+            columns.raw_offsets[row] + raw_rows[row].size();
+    columns.raw.resize(columns.raw_offsets[rows]);
+    for (size_t row = 0; row < rows; ++row)
+        if (!raw_rows[row].empty())
+            std::memcpy(columns.raw.data() + columns.raw_offsets[row],
+                raw_rows[row].data(), raw_rows[row].size());
+}
+
+chain_scanner::chain_scanner(storage_ptr chain, size_t begin, size_t end,
+    size_t batch_size, thread_pool_ptr parse_pool)
+  : chain_(chain), next_(begin), end_(end),
+    batch_size_(std::max<size_t>(batch_size, 1)), parse_pool_(parse_pool),
+    requested_end_(begin), done_(begin >= end)
+{
+    if (!done_)
+        request();
+}
+
+bool chain_scanner::done() const
+{
+    return done_;
+}
+
+size_t chain_scanner::position() const
+{
+    return next_;
+}
+
+void chain_scanner::request()
+{
+    typedef std::promise<fetch_result> fetch_promise;
+    shared_ptr<fetch_promise> fetched = std::make_shared<fetch_promise>();
+    fetched_ = fetched->get_future();
+    requested_end_ = std::min(end_, next_ + batch_size_);
+    chain_->fetch_blocks_by_depth_range(next_, requested_end_,
+        [fetched](const std::error_code& ec,
+            const message::block_list& blocks)
+        {
+            fetched->set_value(fetch_result{ec, blocks});
+        });
+}
+
+std::error_code chain_scanner::next_blocks(message::block_list& blocks)
+{
+    blocks.clear();
+    if (done_)
+        return std::error_code();
+    static latency_histogram& wait_time =
+        shared_metrics().get_histogram("scanner.fetch_wait");
+    fetch_result result;
+    {
+        scoped_timer timer(wait_time);
+        result = fetched_.get();
+    }
+    // Nothing at all is the top of the chain
+    if (result.ec == error::object_doesnt_exist)
+    {
+        done_ = true;
+        return std::error_code();
+    }
+    if (result.ec)
+    {
+        done_ = true;
+        return result.ec;
+    }
+    const bool short_batch =
+        result.blocks.size() < requested_end_ - next_;
+    blocks.swap(result.blocks);
+    next_ += blocks.size();
+    done_ = short_batch || next_ >= end_;
+    if (!done_)
+        request();
+    return std::error_code();
+}
+
+std::error_code chain_scanner::next_transactions(
+    transaction_columns& columns)
+{
+    const size_t first_depth = next_;
+    message::block_list blocks;
+    std::error_code ec = next_blocks(blocks);
+    if (ec)
+        return ec;
+    fill_transaction_columns(blocks, first_depth, columns, parse_pool_);
+    return std::error_code();
+}
+
+} // libbitcoin
+
@@ -0,0 +1,230 @@
+#include <bitcoin/compact_block.hpp>
+
+#include <openssl/sha.h>
+#include <algorithm>
+
+#include <bitcoin/block.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/serializer.hpp>
+
+namespace libbitcoin {
+
+constexpr uint64_t short_id_mask = (uint64_t(1) << 48) - 1;
+
+static uint64_t rotate_left(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static void sip_round(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3)
+{
+    v0 += v1;
+    v1 = rotate_left(v1, 13);
+    v1 ^= v0;
+    v0 = rotate_left(v0, 32);
+    v2 += v3;
+    v3 = rotate_left(v3, 16);
+    v3 ^= v2;
+    v0 += v3;
+    v3 = rotate_left(v3, 21);
+    v3 ^= v0;
+    v2 += v1;
+    v1 = rotate_left(v1, 17);
+    v1 ^= v2;
+    v2 = rotate_left(v2, 32);
+}
+
+// Little endian, whatever the host
+static uint64_t read_word(const byte* data)
+{
+    uint64_t word = 0;
+    for (size_t i = 0; i < 8; ++i)
+        word |= static_cast<uint64_t>(data[i]) << (8 * i);
+    return word;
+}
+
+uint64_t siphash_digest(uint64_t k0, uint64_t k1, const hash_digest& hash)
+{
+    uint64_t v0 = 0x736f6d6570736575 ^ k0, v1 = 0x646f72616e646f6d ^ k1,
+        v2 = 0x6c7967656e657261 ^ k0, v3 = 0x7465646279746573 ^ k1;
+    // Digests are kept reversed from the wire
+    hash_digest wire;
+    std::reverse_copy(hash.begin(), hash.end(), wire.begin());
+    for (size_t i = 0; i < wire.size(); i += 8)
+    {
+        const uint64_t word = read_word(wire.data() + i);
+        v3 ^= word;
+        sip_round(v0, v1, v2, v3);
+        sip_round(v0, v1, v2, v3);
+        v0 ^= word;
+    }
+    // The length in the top byte, with no bytes left over
+    const uint64_t last = static_cast<uint64_t>(wire.size()) << 56;
+    v3 ^= last;
+    sip_round(v0, v1, v2, v3);
+    sip_round(v0, v1, v2, v3);
+    v0 ^= last;
+    v2 ^= 0xff;
+    for (size_t i = 0; i < 4; ++i)
+        sip_round(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+short_id_key::short_id_key(const message::block& header, uint64_t nonce)
+{
+    // A single SHA-256 of the wire header and nonce
+    serializer key;
+    key.reserve(80 + 8);
+    key.write_4_bytes(header.version);
+    key.write_hash(header.prev_block);
+    key.write_hash(header.merkle_root);
+    key.write_4_bytes(header.timestamp);
+    key.write_4_bytes(header.bits);
+    key.write_4_bytes(header.nonce);
+    key.write_8_bytes(nonce);
+    const data_chunk data = key.release_data();
+    byte digest[SHA256_DIGEST_LENGTH];
+    SHA256(data.data(), data.size(), digest);
+    k0_ = read_word(digest);
+    k1_ = read_word(digest + 8);
+}
+
+uint64_t short_id_key::operator()(const hash_digest& tx_hash) const
+{
+    return siphash_digest(k0_, k1_, tx_hash) & short_id_mask;
+}
+
+static message::block copy_header(const message::block& block)
+{
+    message::block header;
+    header.version = block.version;
+    header.prev_block = block.prev_block;
+    header.merkle_root = block.merkle_root;
+    header.timestamp = block.timestamp;
+    header.bits = block.bits;
+    header.nonce = block.nonce;
+    header.cached_hash = block.cached_hash;
+    return header;
+}
+
+message::compact_block make_compact_block(const message::block& block,
+    uint64_t nonce)
+{
+    message::compact_block compact;
+    compact.header = copy_header(block);
+    compact.nonce = nonce;
+    if (block.transactions.empty())
+        return compact;
+    compact.prefilled.push_back(
+        message::prefilled_transaction{0, block.transactions[0]});
+    const short_id_key key(compact.header, nonce);
+    compact.short_ids.reserve(block.transactions.size() - 1);
+    for (size_t i = 1; i < block.transactions.size(); ++i)
+        compact.short_ids.push_back(
+            key(hash_transaction(block.transactions[i])));
+    return compact;
+}
+
+partial_block::partial_block(const message::compact_block& compact)
+  : key_(compact.header, compact.nonce), header_(copy_header(compact.header)),
+    hash_(hash_block_header(header_)), filled_(0), valid_(false)
+{
+    const size_t total = compact.short_ids.size() + compact.prefilled.size();
+    transactions_.resize(total);
+    states_.resize(total, slot_state::empty);
+    for (const message::prefilled_transaction& prefilled: compact.prefilled)
+    {
+        if (prefilled.index >= total ||
+                states_[prefilled.index] != slot_state::empty)
+            return;
+        transactions_[prefilled.index] = prefilled.tx;
+        states_[prefilled.index] = slot_state::filled;
+        ++filled_;
+    }
+    // Short ids take the positions left over, in order
+    positions_.reserve(compact.short_ids.size());
+    size_t position = 0;
+    for (uint64_t short_id: compact.short_ids)
+    {
+        while (states_[position] != slot_state::empty)
+            ++position;
+        if (!positions_.insert(std::make_pair(short_id, position)).second)
+            return;
+        ++position;
+    }
+    valid_ = true;
+}
+
+bool partial_block::valid() const
+{
+    return valid_;
+}
+
+const hash_digest& partial_block::hash() const
+{
+    return hash_;
+}
+
+void partial_block::offer(const hash_digest& tx_hash,
+    const message::transaction& tx)
+{
+    auto it = positions_.find(key_(tx_hash));
+    if (it == positions_.end())
+        return;
+    const size_t position = it->second;
+    if (states_[position] == slot_state::empty)
+    {
+        transactions_[position] = tx;
+        states_[position] = slot_state::filled;
+        ++filled_;
+    }
+    else if (states_[position] == slot_state::filled &&
+            hash_transaction(transactions_[position]) != tx_hash)
+    {
+        transactions_[position] = message::transaction();
+        states_[position] = slot_state::ambiguous;
+        --filled_;
+    }
+}
+
+std::vector<uint32_t> partial_block::missing() const
+{
+    std::vector<uint32_t> indexes;
+    indexes.reserve(states_.size() - filled_);
+    for (size_t position = 0; position < states_.size(); ++position)
+        if (states_[position] != slot_state::filled)
+            indexes.push_back(position);
+    return indexes;
+}
+
+bool partial_block::fill(const message::transaction_list& transactions)
+{
+    if (transactions.size() != states_.size() - filled_)
+        return false;
+    auto tx = transactions.begin();
+    for (size_t position = 0; position < states_.size(); ++position)
+        if (states_[position] != slot_state::filled)
+        {
+            transactions_[position] = *tx++;
+            states_[position] = slot_state::filled;
+        }
+    filled_ = states_.size();
+    return true;
+}
+
+bool partial_block::complete() const
+{
+    return valid_ && filled_ == states_.size();
+}
+
+message::block partial_block::block() const
+{
+    BITCOIN_ASSERT(complete());
+    message::block result = header_;
+    result.transactions = transactions_;
+    return result;
+}
+
+} // libbitcoin
+
@@ -0,0 +1,279 @@
+#include <bitcoin/compressed_output.hpp>
+
+#include <openssl/ec.h>
+#include <algorithm>
+#include <limits>
+
+#include <bitcoin/script.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/util/elliptic_curve_key.hpp>
+
+namespace libbitcoin {
+
+enum script_tag : uint8_t
+{
+    pubkey_hash_tag = 0x00,
+    // 0x01 is pay to script hash in the reference client, which we do
+    // not classify. The next two carry the even or odd key prefix.
+    compressed_pubkey_tag = 0x02,
+    uncompressed_pubkey_tag = 0x04
+};
+// Anything else is its length plus this, then the raw bytes
+constexpr uint64_t special_scripts = 6;
+
+constexpr size_t pubkey_hash_size = 20;
+constexpr size_t compressed_pubkey_size = 33;
+constexpr size_t uncompressed_pubkey_size = 65;
+// Push opcodes and the script opcodes they sit between
+constexpr uint8_t op_dup = 0x76, op_hash160 = 0xa9, op_equalverify = 0x88,
+    op_checksig = 0xac;
+
+void write_varint(data_chunk& out, uint64_t value)
+{
+    byte groups[10];
+    size_t length = 0;
+    groups[length] = value & 0x7f;
+    while (value > 0x7f)
+    {
+        value = (value >> 7) - 1;
+        groups[++length] = (value & 0x7f) | 0x80;
+    }
+    for (size_t i = length + 1; i > 0; --i)
+        out.push_back(groups[i - 1]);
+}
+
+bool read_varint(const data_view& in, size_t& position, uint64_t& value)
+{
+    constexpr uint64_t max_value = std::numeric_limits<uint64_t>::max();
+    value = 0;
+    while (position < in.size())
+    {
+        const byte group = in.begin()[position++];
+        if (value > (max_value >> 7))
+            return false;
+        value = (value << 7) | (group & 0x7f);
+        if ((group & 0x80) == 0)
+            return true;
+        if (value == max_value)
+            return false;
+        ++value;
+    }
+    return false;
+}
+
+uint64_t compress_amount(uint64_t value)
+{
+    if (value == 0)
+        return 0;
+    uint64_t exponent = 0;
+    while (value % 10 == 0 && exponent < 9)
+    {
+        value /= 10;
+        ++exponent;
+    }
+    if (exponent == 9)
+        return 1 + (value - 1) * 10 + 9;
+    const uint64_t last_digit = value % 10;
+    value /= 10;
+    return 1 + (value * 9 + last_digit - 1) * 10 + exponent;
+}
+
+uint64_t decompress_amount(uint64_t compressed)
+{
+    if (compressed == 0)
+        return 0;
+    --compressed;
+    uint64_t exponent = compressed % 10;
+    compressed /= 10;
+    uint64_t value;
+    if (exponent < 9)
+    {
+        const uint64_t last_digit = compressed % 9 + 1;
+        compressed /= 9;
+        value = compressed * 10 + last_digit;
+    }
+    else
+        value = compressed + 1;
+    for (; exponent > 0; --exponent)
+        value *= 10;
+    return value;
+}
+
+// Between the uncompressed and compressed forms of a point. False if
+// the bytes are not a point on the curve.
+static bool convert_point(const byte* key, size_t size, byte* out,
+    size_t out_size, point_conversion_form_t form)
+{
+    const EC_GROUP* group = secp256k1_group();
+    EC_POINT* point = EC_POINT_new(group);
+    if (point == nullptr)
+        return false;
+    const bool success =
+        EC_POINT_oct2point(group, point, key, size, nullptr) == 1 &&
+        EC_POINT_point2oct(group, point, form, out, out_size, nullptr) ==
+            out_size;
+    EC_POINT_free(point);
+    return success;
+}
+
+static bool is_pubkey_hash(const data_chunk& raw)
+{
+    return raw.size() == 5 + pubkey_hash_size && raw[0] == op_dup &&
+        raw[1] == op_hash160 && raw[2] == pubkey_hash_size &&
+        raw[23] == op_equalverify && raw[24] == op_checksig;
+}
+
+static bool is_pubkey(const data_chunk& raw, size_t key_size)
+{
+    return raw.size() == 2 + key_size && raw[0] == key_size &&
+        raw[key_size + 1] == op_checksig;
+}
+
+void write_compressed_script(data_chunk& out, const data_chunk& raw_script)
+{
+    // script::type() only compares sizes, so the raw bytes are checked
+    // against the templates instead
+    if (is_pubkey_hash(raw_script))
+    {
+        out.push_back(pubkey_hash_tag);
+        out.insert(out.end(), raw_script.begin() + 3, raw_script.begin() + 23);
+        return;
+    }
+    if (is_pubkey(raw_script, compressed_pubkey_size) &&
+            (raw_script[1] == 0x02 || raw_script[1] == 0x03))
+    {
+        // The prefix is the tag
+        out.insert(out.end(), raw_script.begin() + 1, raw_script.end() - 1);
+        return;
+    }
+    byte compressed[compressed_pubkey_size];
+    if (is_pubkey(raw_script, uncompressed_pubkey_size) &&
+            raw_script[1] == 0x04 &&
+            convert_point(&raw_script[1], uncompressed_pubkey_size,
+                compressed, sizeof(compressed), POINT_CONVERSION_COMPRESSED))
+    {
+        out.push_back(uncompressed_pubkey_tag + compressed[0] - 0x02);
+        out.insert(out.end(), compressed + 1, compressed + sizeof(compressed));
+        return;
+    }
+    write_varint(out, raw_script.size() + special_scripts);
+    extend_data(out, raw_script);
+}
+
+bool read_compressed_script(const data_view& in, size_t& position,
+    data_chunk& raw_script)
+{
+    uint64_t tag;
+    if (!read_varint(in, position, tag))
+        return false;
+    const byte* data = in.begin() + position;
+    const size_t remaining = in.size() - position;
+    if (tag >= special_scripts)
+    {
+        const uint64_t size = tag - special_scripts;
+        if (size > remaining)
+            return false;
+        raw_script.assign(data, data + size);
+        position += size;
+        return true;
+    }
+    if (tag == pubkey_hash_tag)
+    {
+        if (remaining < pubkey_hash_size)
+            return false;
+        raw_script = data_chunk{op_dup, op_hash160, pubkey_hash_size};
+        raw_script.insert(raw_script.end(), data, data + pubkey_hash_size);
+        raw_script.push_back(op_equalverify);
+        raw_script.push_back(op_checksig);
+        position += pubkey_hash_size;
+        return true;
+    }
+    // The rest are a key's x coordinate
+    constexpr size_t coordinate_size = compressed_pubkey_size - 1;
+    if (remaining < coordinate_size)
+        return false;
+    byte compressed[compressed_pubkey_size];
+    std::copy(data, data + coordinate_size, compressed + 1);
+    position += coordinate_size;
+    if (tag == compressed_pubkey_tag || tag == compressed_pubkey_tag + 1)
+    {
+        raw_script = data_chunk{compressed_pubkey_size,
+            static_cast<byte>(tag)};
+        raw_script.insert(raw_script.end(), compressed + 1,
+            compressed + sizeof(compressed));
+        raw_script.push_back(op_checksig);
+        return true;
+    }
+    if (tag != uncompressed_pubkey_tag && tag != uncompressed_pubkey_tag + 1)
+        return false;
+    compressed[0] = 0x02 + tag - uncompressed_pubkey_tag;
+    raw_script.resize(2 + uncompressed_pubkey_size);
+    raw_script[0] = uncompressed_pubkey_size;
+    raw_script.back() = op_checksig;
+    return convert_point(compressed, sizeof(compressed), &raw_script[1],
+        uncompressed_pubkey_size, POINT_CONVERSION_UNCOMPRESSED);
+}
+
+void write_compressed_output(data_chunk& out, const unspent_output& output)
+{
+    write_varint(out, compress_amount(output.value));
+    write_compressed_script(out, output.raw_script);
+}
+
+bool read_compressed_output(const data_view& in, size_t& position,
+    unspent_output& output)
+{
+    uint64_t amount;
+    if (!read_varint(in, position, amount))
+        return false;
+    output.value = decompress_amount(amount);
+    return read_compressed_script(in, position, output.raw_script);
+}
+
+data_chunk compress_output(const unspent_output& output)
+{
+    data_chunk compressed;
+    // Enough for the standard scripts
+    compressed.reserve(10 + 1 + 32);
+    write_compressed_output(compressed, output);
+    return compressed;
+}
+
+bool decompress_output(const data_chunk& compressed, unspent_output& output)
+{
+    size_t position = 0;
+    return read_compressed_output(data_view(compressed), position, output) &&
+        position == compressed.size();
+}
+
+data_chunk compress_undo(const utxo_set::undo_list& undo)
+{
+    data_chunk compressed;
+    compressed.reserve(undo.size() * (10 + 1 + 32));
+    for (const auto& spent: undo)
+        write_compressed_output(compressed, spent.second);
+    return compressed;
+}
+
+bool decompress_undo(const message::block& block,
+    const data_chunk& compressed, utxo_set::undo_list& undo)
+{
+    undo.clear();
+    const data_view in(compressed);
+    size_t position = 0;
+    for (const message::transaction& tx: block.transactions)
+        if (!is_coinbase(tx))
+            for (const message::transaction_input& input: tx.inputs)
+            {
+                unspent_output output;
+                if (!read_compressed_output(in, position, output))
+                    return false;
+                undo.push_back(std::make_pair(
+                    output_point{input.hash, input.index},
+                    std::move(output)));
+            }
+    return position == compressed.size();
+}
+
+} // libbitcoin
+
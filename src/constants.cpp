@@ -1,5 +1,8 @@
 #include <bitcoin/constants.hpp>
 
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/hex.hpp>
+
 namespace libbitcoin {
 
 big_number max_target()
@@ -9,5 +12,37 @@ big_number max_target()
     return max_target;
 }
 
+static checkpoint make_checkpoint(size_t depth, const std::string& pretty)
+{
+    checkpoint result{depth, null_hash};
+    bool success = decode_hex(pretty, result.hash);
+    BITCOIN_ASSERT(success);
+    return result;
+}
+
+chain_checkpoints mainnet_checkpoints()
+{
+    chain_checkpoints result;
+    result.checkpoints = {
+        make_checkpoint(11111,
+    "0000000069e244f73d78e8fd29ba2fd2ed618bd6fa2ee92559f542fdb26e7c1d"),
+        make_checkpoint(33333,
+    "000000002dd5588a74784eaa7ab0507a18ad16a236e7b1ce69f00d7ddfb5d0a6"),
+        make_checkpoint(74000,
+    "0000000000573993a3c9e41ce34471c079dcf5f52a0e824a81e7f953b8661a20"),
+        make_checkpoint(105000,
+    "00000000000291ce28027faea320c8d2b054b2e0fe44a773f3eefb151d6bdc97"),
+        make_checkpoint(134444,
+    "00000000000005b12ffd4cd315cd34ffd4a594f430ac814c91184a0d42d2b0fe"),
+        make_checkpoint(168000,
+    "000000000000099e61ea72015e79632f216fe6cb33d7899acb35b75c8303b763"),
+        make_checkpoint(193000,
+    "000000000000059f452a5f7340de6682a977387c17010ff6e6c3bd83ca8b1317"),
+        make_checkpoint(210000,
+    "000000000000048b95347e83192f69cf0366076336c639f9b7228e9ba171342e")};
+    result.assume_valid = result.checkpoints.back().hash;
+    return result;
+}
+
 } // libbitcoin
 
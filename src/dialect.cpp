@@ -1,62 +1,141 @@
 #include <bitcoin/dialect.hpp>
 
 #include <boost/assert.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
 
 #include <bitcoin/messages.hpp>
+#include <bitcoin/block.hpp>
 #include <bitcoin/constants.hpp>
+#include <bitcoin/lazy_block.hpp>
+#include <bitcoin/transaction.hpp>
 #include <bitcoin/util/assert.hpp>
 #include <bitcoin/util/logger.hpp>
+#include <bitcoin/util/metrics.hpp>
 #include <bitcoin/util/sha256.hpp>
+#include <bitcoin/util/trace.hpp>
 
 namespace libbitcoin {
 
-data_chunk construct_header_from(std::string command, const data_chunk& payload)
+using message::command_type;
+
+// magic + command + length + checksum
+constexpr size_t header_size = 4 + 12 + 4 + 4;
+constexpr size_t command_size = 12;
+
+// In command_type order, after unknown
+constexpr const char* command_names[] = {
+    "version", "verack", "addr", "inv", "getdata", "getblocks",
+    "getheaders", "tx", "block", "headers", "getaddr", "ping", "alert",
+    "sendcmpct", "cmpctblock", "getblocktxn", "blocktxn"
+};
+
+// FNV-1a. As case labels below, any collision fails to compile.
+constexpr uint32_t command_hash(const char* name, uint32_t hash=2166136261u)
+{
+    return *name == 0 ? hash : command_hash(name + 1,
+        (hash ^ static_cast<uint8_t>(*name)) * 16777619u);
+}
+
+command_type decode_command(const uint8_t* field)
+{
+    uint32_t hash = 2166136261u;
+    size_t length = 0;
+    for (; length < command_size && field[length] != 0; ++length)
+        hash = (hash ^ field[length]) * 16777619u;
+    command_type command = command_type::unknown;
+    switch (hash)
+    {
+        case command_hash("version"): command = command_type::version; break;
+        case command_hash("verack"): command = command_type::verack; break;
+        case command_hash("addr"): command = command_type::addr; break;
+        case command_hash("inv"): command = command_type::inv; break;
+        case command_hash("getdata"): command = command_type::getdata; break;
+        case command_hash("getblocks"):
+            command = command_type::getblocks; break;
+        case command_hash("getheaders"):
+            command = command_type::getheaders; break;
+        case command_hash("tx"): command = command_type::tx; break;
+        case command_hash("block"): command = command_type::block; break;
+        case command_hash("headers"): command = command_type::headers; break;
+        case command_hash("getaddr"): command = command_type::getaddr; break;
+        case command_hash("ping"): command = command_type::ping; break;
+        case command_hash("alert"): command = command_type::alert; break;
+        case command_hash("sendcmpct"):
+            command = command_type::sendcmpct; break;
+        case command_hash("cmpctblock"):
+            command = command_type::cmpctblock; break;
+        case command_hash("getblocktxn"):
+            command = command_type::getblocktxn; break;
+        case command_hash("blocktxn"):
+            command = command_type::blocktxn; break;
+        default: return command_type::unknown;
+    }
+    // The hash only picks a candidate. Confirm it and the padding.
+    const char* name = command_name(command);
+    if (std::strlen(name) != length ||
+            !std::equal(field, field + length, name))
+        return command_type::unknown;
+    for (size_t i = length; i < command_size; ++i)
+        if (field[i] != 0)
+            return command_type::unknown;
+    return command;
+}
+
+const char* command_name(command_type command)
+{
+    if (command == command_type::unknown)
+        return "unknown";
+    return command_names[static_cast<size_t>(command) - 1];
+}
+
+data_chunk construct_header_from(command_type command,
+        const data_chunk& payload)
 {
-    log_info() << "s: " << command
+    log_info() << "s: " << command_name(command)
             << " (" << payload.size() << " bytes)";
     serializer header;
+    // Room for the payload which the caller appends afterwards
+    header.reserve(header_size + payload.size());
     // magic
     header.write_4_bytes(magic_value);
     // command
-    header.write_command(command);
+    header.write_command(command_name(command));
     // payload length
     uint32_t length = payload.size();
     header.write_4_bytes(length);
     // checksum is not in verson or verack
-    if (command != "version" && command != "verack")
+    if (command != command_type::version && command != command_type::verack)
     {
         uint32_t checksum = generate_sha256_checksum(payload);
         header.write_4_bytes(checksum);
     }
-    return header.get_data();
+    return header.release_data();
 }
 
-data_chunk assemble_message(std::string command, const serializer& payload,
+data_chunk assemble_message(command_type command, serializer& payload,
         bool include_header)
 {
-    data_chunk msg_body = payload.get_data();
+    data_chunk msg_body = payload.release_data();
     if (!include_header)
         return msg_body;
     data_chunk message = construct_header_from(command, msg_body);
-    // Extend message with actual payload
-    message.reserve(message.size() + distance(msg_body.begin(),
-            msg_body.end()));
-    message.insert(message.end(), msg_body.begin(), msg_body.end());
+    // Extend message with actual payload. Capacity is already reserved.
+    extend_data(message, msg_body);
     return message;
 }
 
-data_chunk header_only_message(std::string command)
+data_chunk header_only_message(command_type command)
 {
-    serializer payload;
-    data_chunk msg_body = payload.get_data();
     // No data
-    data_chunk header = construct_header_from(command, msg_body);
-    return header;
+    return construct_header_from(command, data_chunk());
 }
 
 data_chunk original_dialect::to_network(const message::version& version) const
 {
     serializer payload;
+    payload.reserve(85);
     payload.write_4_bytes(version.version);
     payload.write_8_bytes(version.services);
     payload.write_8_bytes(version.timestamp);
@@ -66,50 +145,104 @@ data_chunk original_dialect::to_network(const message::version& version) const
     // do sub_version_num
     payload.write_byte(0);
     payload.write_4_bytes(version.start_height);
-    return assemble_message("version", payload, true);
+    return assemble_message(command_type::version, payload, true);
 }
 
 data_chunk original_dialect::to_network(const message::verack&) const
 {
-    return header_only_message("verack");
+    return header_only_message(command_type::verack);
 }
 
 data_chunk original_dialect::to_network(const message::getaddr&) const
 {
-    return header_only_message("getaddr");
+    return header_only_message(command_type::getaddr);
 }
 
-data_chunk original_dialect::to_network(
-        const message::getblocks& getblocks) const
+static data_chunk locator_message(command_type command,
+        const message::block_locator& locator, const hash_digest& hash_stop)
 {
     serializer payload;
+    payload.reserve(4 + 9 + 32 * (locator.size() + 1));
     payload.write_4_bytes(31900);
-    payload.write_var_uint(getblocks.locator_start_hashes.size());
-    for (hash_digest start_hash: getblocks.locator_start_hashes)
+    payload.write_var_uint(locator.size());
+    for (const hash_digest& start_hash: locator)
         payload.write_hash(start_hash);
-    payload.write_hash(getblocks.hash_stop);
-    return assemble_message("getblocks", payload, true);
+    payload.write_hash(hash_stop);
+    return assemble_message(command, payload, true);
+}
+
+data_chunk original_dialect::to_network(
+        const message::getblocks& getblocks) const
+{
+    return locator_message(command_type::getblocks,
+        getblocks.locator_start_hashes, getblocks.hash_stop);
+}
+
+data_chunk original_dialect::to_network(
+        const message::getheaders& getheaders) const
+{
+    return locator_message(command_type::getheaders,
+        getheaders.locator_start_hashes, getheaders.hash_stop);
+}
+
+void write_transaction(serializer& payload, const message::transaction& tx)
+{
+    payload.write_4_bytes(tx.version);
+    payload.write_var_uint(tx.inputs.size());
+    for (const message::transaction_input& input: tx.inputs)
+    {
+        payload.write_hash(input.hash);
+        payload.write_4_bytes(input.index);
+        write_script(payload, input.input_script);
+        payload.write_4_bytes(input.sequence);
+    }
+    payload.write_var_uint(tx.outputs.size());
+    for (const message::transaction_output& output: tx.outputs)
+    {
+        payload.write_8_bytes(output.value);
+        write_script(payload, output.output_script);
+    }
+    payload.write_4_bytes(tx.locktime);
 }
 
 data_chunk original_dialect::to_network(const message::block& block, 
         bool include_header) const
 {
     serializer payload;
-    return assemble_message("block", payload, include_header);
+    payload.reserve(block_size(block));
+    payload.write_4_bytes(block.version);
+    payload.write_hash(block.prev_block);
+    payload.write_hash(block.merkle_root);
+    payload.write_4_bytes(block.timestamp);
+    payload.write_4_bytes(block.bits);
+    payload.write_4_bytes(block.nonce);
+    payload.write_var_uint(block.transactions.size());
+    for (const message::transaction& tx: block.transactions)
+        write_transaction(payload, tx);
+    return assemble_message(command_type::block, payload, include_header);
 }
 
 data_chunk original_dialect::to_network(const message::transaction& tx, 
         bool include_header) const
 {
     serializer payload;
-    return assemble_message("tx", payload, include_header);
+    payload.reserve(transaction_size(tx));
+    write_transaction(payload, tx);
+    return assemble_message(command_type::tx, payload, include_header);
 }
 
-data_chunk original_dialect::to_network(const message::getdata& getdata) const
+data_chunk original_dialect::header_to_network(command_type command,
+        const data_chunk& payload) const
 {
-    serializer payload;
-    payload.write_var_uint(getdata.invs.size());
-    for (const message::inv_vect inv: getdata.invs)
+    return construct_header_from(command, payload);
+}
+
+// getdata and inv share a layout
+static void write_inv_list(serializer& payload, const message::inv_list& invs)
+{
+    payload.reserve(9 + (4 + 32) * invs.size());
+    payload.write_var_uint(invs.size());
+    for (const message::inv_vect& inv: invs)
     {
         switch (inv.type)
         {
@@ -119,6 +252,9 @@ data_chunk original_dialect::to_network(const message::getdata& getdata) const
             case message::inv_type::block:
                 payload.write_4_bytes(2);
                 break;
+            case message::inv_type::compact_block:
+                payload.write_4_bytes(4);
+                break;
             case message::inv_type::error:
             case message::inv_type::none:
             default:
@@ -127,7 +263,123 @@ data_chunk original_dialect::to_network(const message::getdata& getdata) const
         }
         payload.write_hash(inv.hash);
     }
-    return assemble_message("getdata", payload, true);
+}
+
+data_chunk original_dialect::to_network(const message::getdata& getdata) const
+{
+    serializer payload;
+    write_inv_list(payload, getdata.invs);
+    return assemble_message(command_type::getdata, payload, true);
+}
+
+data_chunk original_dialect::to_network(const message::inv& inv) const
+{
+    serializer payload;
+    write_inv_list(payload, inv.invs);
+    return assemble_message(command_type::inv, payload, true);
+}
+
+data_chunk original_dialect::to_network(const message::addr& addr) const
+{
+    serializer payload;
+    payload.reserve(9 + (4 + 26) * addr.addr_list.size());
+    payload.write_var_uint(addr.addr_list.size());
+    for (const message::net_addr& net_addr: addr.addr_list)
+    {
+        payload.write_4_bytes(net_addr.timestamp);
+        payload.write_net_addr(net_addr);
+    }
+    return assemble_message(command_type::addr, payload, true);
+}
+
+data_chunk original_dialect::to_network(
+        const message::send_compact& send_compact) const
+{
+    serializer payload;
+    payload.reserve(1 + 8);
+    payload.write_byte(send_compact.announce ? 1 : 0);
+    payload.write_8_bytes(send_compact.version);
+    return assemble_message(command_type::sendcmpct, payload, true);
+}
+
+static void write_block_header(serializer& payload,
+        const message::block& block)
+{
+    payload.write_4_bytes(block.version);
+    payload.write_hash(block.prev_block);
+    payload.write_hash(block.merkle_root);
+    payload.write_4_bytes(block.timestamp);
+    payload.write_4_bytes(block.bits);
+    payload.write_4_bytes(block.nonce);
+}
+
+// Each index is written as its distance past the one before
+static void write_indexes(serializer& payload,
+        const std::vector<uint32_t>& indexes)
+{
+    payload.write_var_uint(indexes.size());
+    uint32_t next = 0;
+    for (uint32_t index: indexes)
+    {
+        BITCOIN_ASSERT(index >= next);
+        payload.write_var_uint(index - next);
+        next = index + 1;
+    }
+}
+
+data_chunk original_dialect::to_network(
+        const message::compact_block& compact) const
+{
+    serializer payload;
+    size_t size = 80 + 8 + 9 + 6 * compact.short_ids.size() + 9;
+    for (const message::prefilled_transaction& prefilled: compact.prefilled)
+        size += 9 + transaction_size(prefilled.tx);
+    payload.reserve(size);
+    write_block_header(payload, compact.header);
+    payload.write_8_bytes(compact.nonce);
+    payload.write_var_uint(compact.short_ids.size());
+    for (uint64_t short_id: compact.short_ids)
+    {
+        // 6 bytes, little endian
+        payload.write_4_bytes(short_id);
+        payload.write_2_bytes(short_id >> 32);
+    }
+    // Index differences interleaved with the transactions
+    payload.write_var_uint(compact.prefilled.size());
+    uint32_t next = 0;
+    for (const message::prefilled_transaction& prefilled: compact.prefilled)
+    {
+        BITCOIN_ASSERT(prefilled.index >= next);
+        payload.write_var_uint(prefilled.index - next);
+        next = prefilled.index + 1;
+        write_transaction(payload, prefilled.tx);
+    }
+    return assemble_message(command_type::cmpctblock, payload, true);
+}
+
+data_chunk original_dialect::to_network(
+        const message::get_block_transactions& request) const
+{
+    serializer payload;
+    payload.reserve(32 + 9 + 3 * request.indexes.size());
+    payload.write_hash(request.block_hash);
+    write_indexes(payload, request.indexes);
+    return assemble_message(command_type::getblocktxn, payload, true);
+}
+
+data_chunk original_dialect::to_network(
+        const message::block_transactions& response) const
+{
+    serializer payload;
+    size_t size = 32 + 9;
+    for (const message::transaction& tx: response.transactions)
+        size += transaction_size(tx);
+    payload.reserve(size);
+    payload.write_hash(response.block_hash);
+    payload.write_var_uint(response.transactions.size());
+    for (const message::transaction& tx: response.transactions)
+        write_transaction(payload, tx);
+    return assemble_message(command_type::blocktxn, payload, true);
 }
 
 message::header original_dialect::header_from_network(
@@ -136,7 +388,7 @@ message::header original_dialect::header_from_network(
     deserializer deserial(stream);
     message::header header;
     header.magic = deserial.read_4_bytes();
-    header.command = deserial.read_fixed_len_str(12);
+    header.command = decode_command(deserial.read_view(command_size).begin());
     header.payload_length = deserial.read_4_bytes();
     header.checksum = 0;
     return header;
@@ -183,6 +435,9 @@ message::addr original_dialect::addr_from_network(
         const message::header& header_msg,
         const data_chunk& stream, bool& ec) const
 {
+    static latency_histogram& parse_time =
+        shared_metrics().get_histogram("dialect.parse_addr");
+    scoped_timer timer(parse_time);
     ec = false;
     message::addr payload;
     if (header_msg.checksum != generate_sha256_checksum(stream))
@@ -212,48 +467,73 @@ message::inv_type inv_type_from_number(uint32_t raw_type)
             return message::inv_type::transaction;
         case 2:
             return message::inv_type::block;
+        case 4:
+            return message::inv_type::compact_block;
         default:
             return message::inv_type::none;
     }
 }
 
-message::inv original_dialect::inv_from_network(
-        const message::header&, const data_chunk& stream, bool& ec) const
+// Shared by inv and getdata, which have the same layout
+static message::inv_list read_inventory(const data_chunk& stream, bool& ec)
 {
+    // Each entry is a 4 byte type and a hash
+    constexpr size_t entry_size = 4 + 32;
     ec = false;
     deserializer deserial(stream);
-    message::inv payload;
+    message::inv_list invs;
     uint64_t count = deserial.read_var_uint();
+    if (count > stream.size() / entry_size)
+    {
+        ec = true;
+        return invs;
+    }
+    invs.reserve(count);
     for (size_t i = 0; i < count; ++i)
     {
         message::inv_vect inv_vect;
         uint32_t raw_type = deserial.read_4_bytes();
         inv_vect.type = inv_type_from_number(raw_type);
         inv_vect.hash = deserial.read_hash();
-        payload.invs.push_back(inv_vect);
+        invs.push_back(inv_vect);
     }
+    return invs;
+}
+
+message::inv original_dialect::inv_from_network(
+        const message::header&, const data_chunk& stream, bool& ec) const
+{
+    static latency_histogram& parse_time =
+        shared_metrics().get_histogram("dialect.parse_inv");
+    scoped_timer timer(parse_time);
+    message::inv payload;
+    payload.invs = read_inventory(stream, ec);
     return payload;
 }
 
-data_chunk read_raw_script(deserializer& deserial)
+message::getdata original_dialect::getdata_from_network(
+        const message::header&, const data_chunk& stream, bool& ec) const
 {
-    data_chunk raw_script;
-    uint64_t script_length = deserial.read_var_uint();
-    return deserial.read_data(script_length);
+    message::getdata payload;
+    payload.invs = read_inventory(stream, ec);
+    return payload;
 }
 
 script read_script(deserializer& deserial)
 {
-    data_chunk raw_script = read_raw_script(deserial);
+    uint64_t script_length = deserial.read_var_uint();
+    // Parse directly from the payload without an intermediate copy.
     // Eventually plan to move parse_script to inside here
-    return parse_script(raw_script);
+    return parse_script(deserial.read_view(script_length));
 }
 
 message::transaction read_transaction(deserializer& deserial)
 {
+    size_t start = deserial.position();
     message::transaction txn;
     txn.version = deserial.read_4_bytes();
     uint64_t txn_in_count = deserial.read_var_uint();
+    txn.inputs.reserve(txn_in_count);
     for (size_t txn_in_i = 0; txn_in_i < txn_in_count; ++txn_in_i)
     {
         message::transaction_input input;
@@ -261,33 +541,40 @@ message::transaction read_transaction(deserializer& deserial)
         input.index = deserial.read_4_bytes();
         input.input_script = read_script(deserial);
         input.sequence = deserial.read_4_bytes();
-        txn.inputs.push_back(input);
+        txn.inputs.push_back(std::move(input));
     }
     uint64_t txn_out_count = deserial.read_var_uint();
+    txn.outputs.reserve(txn_out_count);
     for (size_t txn_out_i = 0; txn_out_i < txn_out_count; ++txn_out_i)
     {
         message::transaction_output output;
         output.value = deserial.read_8_bytes();
         output.output_script = read_script(deserial);
-        txn.outputs.push_back(output);
+        txn.outputs.push_back(std::move(output));
     }
     txn.locktime = deserial.read_4_bytes();
+    // The wire bytes are exactly what hash_transaction() would serialize
+    txn.cached_hash.set(generate_sha256_hash(deserial.view_from(start)));
     return txn;
 }
 
 message::transaction original_dialect::transaction_from_network(
         const message::header&, const data_chunk& stream, bool& ec) const
 {
-    ec = false;
+    static latency_histogram& parse_time =
+        shared_metrics().get_histogram("dialect.parse_transaction");
+    scoped_timer timer(parse_time);
+    ec = !is_whole_transaction(stream);
+    if (ec)
+        return message::transaction();
     deserializer deserial(stream);
     return read_transaction(deserial);
 }
 
-message::block original_dialect::block_from_network(
-        const message::header&, const data_chunk& stream, bool& ec) const
+// The 80 byte header shared by block and headers messages
+message::block read_block_header(deserializer& deserial)
 {
-    ec = false;
-    deserializer deserial(stream);
+    size_t start = deserial.position();
     message::block payload;
     payload.version = deserial.read_4_bytes();
     payload.prev_block = deserial.read_hash();
@@ -295,56 +582,208 @@ message::block original_dialect::block_from_network(
     payload.timestamp = deserial.read_4_bytes();
     payload.bits = deserial.read_4_bytes();
     payload.nonce = deserial.read_4_bytes();
+    payload.cached_hash.set(generate_sha256_hash(deserial.view_from(start)));
+    return payload;
+}
+
+message::block original_dialect::block_from_network(
+        const message::header&, const data_chunk& stream, bool& ec) const
+{
+    static latency_histogram& parse_time =
+        shared_metrics().get_histogram("dialect.parse_block");
+    scoped_timer timer(parse_time);
+    trace_span span("dialect.parse_block");
+    ec = false;
+    deserializer deserial(stream);
+    message::block payload = read_block_header(deserial);
+    span.set_block(hash_block_header(payload));
     uint64_t txn_count = deserial.read_var_uint();
+    payload.transactions.reserve(txn_count);
     for (size_t txn_i = 0; txn_i < txn_count; ++txn_i)
-    {
-        const message::transaction txn = read_transaction(deserial);
-        payload.transactions.push_back(txn);
-    }
+        payload.transactions.push_back(read_transaction(deserial));
     return payload;
 }
 
-bool original_dialect::verify_header(const message::header& header_msg) const
+message::headers original_dialect::headers_from_network(
+        const message::header&, const data_chunk& stream, bool& ec) const
 {
-    if (header_msg.magic != magic_value)
-        return false;
-    if (header_msg.command == "version")
+    static latency_histogram& parse_time =
+        shared_metrics().get_histogram("dialect.parse_headers");
+    scoped_timer timer(parse_time);
+    ec = false;
+    // Each entry is 80 header bytes and a transaction count of zero
+    constexpr size_t entry_size = 80 + 1;
+    deserializer deserial(stream);
+    message::headers payload;
+    uint64_t count = deserial.read_var_uint();
+    if (count > stream.size() / entry_size)
     {
-        if (header_msg.payload_length != 85)
-            return false;
+        ec = true;
+        return payload;
     }
-    else if (header_msg.command == "verack"
-            || header_msg.command == "getaddr"
-            || header_msg.command == "ping")
+    payload.block_headers.reserve(count);
+    for (size_t i = 0; i < count; ++i)
     {
-        if (header_msg.payload_length != 0)
-            return false;
+        payload.block_headers.push_back(read_block_header(deserial));
+        if (deserial.read_var_uint() != 0)
+        {
+            ec = true;
+            return payload;
+        }
     }
-    else if (header_msg.command == "inv"
-            || header_msg.command == "addr"
-            || header_msg.command == "getdata"
-            || header_msg.command == "getblocks"
-            || header_msg.command == "getheaders"
-            || header_msg.command == "tx"
-            || header_msg.command == "block"
-            || header_msg.command == "headers"
-            || header_msg.command == "alert")
+    return payload;
+}
+
+message::send_compact original_dialect::send_compact_from_network(
+        const message::header&, const data_chunk& stream, bool& ec) const
+{
+    message::send_compact payload;
+    ec = stream.size() != 1 + 8;
+    if (ec)
+        return payload;
+    deserializer deserial(stream);
+    payload.announce = deserial.read_byte() != 0;
+    payload.version = deserial.read_8_bytes();
+    return payload;
+}
+
+// Undoes the differences indexes are written as. next starts at 0.
+static bool read_index(deserializer& deserial, const data_chunk& stream,
+        uint64_t& next, uint32_t& index)
+{
+    constexpr uint64_t max_index = std::numeric_limits<uint32_t>::max();
+    uint64_t difference;
+    if (!read_count(deserial, stream, difference) ||
+            difference > max_index || next + difference > max_index)
+        return false;
+    index = next + difference;
+    next = index + 1;
+    return true;
+}
+
+// Walked before it is decoded, since decoding checks no lengths
+static bool read_checked_transaction(deserializer& deserial,
+        const data_chunk& stream, message::transaction& tx)
+{
+    const size_t start = deserial.position();
+    if (!skip_transaction(deserial, stream))
+        return false;
+    deserializer tx_deserial(stream, start);
+    tx = read_transaction(tx_deserial);
+    return true;
+}
+
+message::compact_block original_dialect::compact_block_from_network(
+        const message::header&, const data_chunk& stream, bool& ec) const
+{
+    static latency_histogram& parse_time =
+        shared_metrics().get_histogram("dialect.parse_compact_block");
+    scoped_timer timer(parse_time);
+    ec = true;
+    message::compact_block payload;
+    if (stream.size() < 80 + 8)
+        return payload;
+    deserializer deserial(stream);
+    payload.header = read_block_header(deserial);
+    payload.nonce = deserial.read_8_bytes();
+    uint64_t count;
+    if (!read_count(deserial, stream, count) ||
+            count > (stream.size() - deserial.position()) / 6)
+        return payload;
+    payload.short_ids.reserve(count);
+    for (uint64_t i = 0; i < count; ++i)
     {
-        // Should check if sizes make sense
-        // i.e for addr should be multiple of 30x + 1 byte
-        // Also then add ASSERTS to handlers above.
+        const uint64_t low = deserial.read_4_bytes();
+        const uint64_t high = deserial.read_2_bytes();
+        payload.short_ids.push_back(low | (high << 32));
     }
-    else
-    {
-        // Unknown header
+    // Every prefilled transaction takes more than one byte
+    if (!read_count(deserial, stream, count) ||
+            count > stream.size() - deserial.position())
+        return payload;
+    payload.prefilled.resize(count);
+    uint64_t next = 0;
+    for (message::prefilled_transaction& prefilled: payload.prefilled)
+        if (!read_index(deserial, stream, next, prefilled.index) ||
+                !read_checked_transaction(deserial, stream, prefilled.tx))
+            return payload;
+    ec = deserial.position() != stream.size();
+    return payload;
+}
+
+message::get_block_transactions
+    original_dialect::get_block_transactions_from_network(
+        const message::header&, const data_chunk& stream, bool& ec) const
+{
+    ec = true;
+    message::get_block_transactions payload;
+    if (stream.size() < 32)
+        return payload;
+    deserializer deserial(stream);
+    payload.block_hash = deserial.read_hash();
+    uint64_t count;
+    if (!read_count(deserial, stream, count) ||
+            count > stream.size() - deserial.position())
+        return payload;
+    payload.indexes.resize(count);
+    uint64_t next = 0;
+    for (uint32_t& index: payload.indexes)
+        if (!read_index(deserial, stream, next, index))
+            return payload;
+    ec = deserial.position() != stream.size();
+    return payload;
+}
+
+message::block_transactions
+    original_dialect::block_transactions_from_network(
+        const message::header&, const data_chunk& stream, bool& ec) const
+{
+    ec = true;
+    message::block_transactions payload;
+    if (stream.size() < 32)
+        return payload;
+    deserializer deserial(stream);
+    payload.block_hash = deserial.read_hash();
+    uint64_t count;
+    if (!read_count(deserial, stream, count) ||
+            count > stream.size() - deserial.position())
+        return payload;
+    payload.transactions.resize(count);
+    for (message::transaction& tx: payload.transactions)
+        if (!read_checked_transaction(deserial, stream, tx))
+            return payload;
+    ec = deserial.position() != stream.size();
+    return payload;
+}
+
+bool original_dialect::verify_header(const message::header& header_msg) const
+{
+    if (header_msg.magic != magic_value)
         return false;
+    switch (header_msg.command)
+    {
+        case command_type::version:
+            return header_msg.payload_length == 85;
+        case command_type::verack:
+        case command_type::getaddr:
+        case command_type::ping:
+            return header_msg.payload_length == 0;
+        case command_type::sendcmpct:
+            return header_msg.payload_length == 1 + 8;
+        case command_type::unknown:
+            return false;
+        default:
+            // Should check if sizes make sense
+            // i.e for addr should be multiple of 30x + 1 byte
+            // Also then add ASSERTS to handlers above.
+            return true;
     }
-    return true;
 }
 
 bool original_dialect::checksum_used(const message::header& header_msg) const
 {
-    return header_msg.command != "version" && header_msg.command != "verack";
+    return header_msg.command != command_type::version &&
+        header_msg.command != command_type::verack;
 }
 
 bool original_dialect::verify_checksum(const message::header& header_msg,
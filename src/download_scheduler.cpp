@@ -0,0 +1,233 @@
+#include <bitcoin/download_scheduler.hpp>
+
+#include <algorithm>
+
+#include <bitcoin/block.hpp>
+#include <bitcoin/header_sync.hpp>
+
+namespace libbitcoin {
+
+using boost::posix_time::seconds;
+using boost::posix_time::microseconds;
+
+constexpr size_t download_scheduler::reorder_window;
+constexpr size_t download_scheduler::min_in_flight;
+constexpr size_t download_scheduler::max_in_flight;
+
+// Weight of the newest sample in the smoothed peer figures
+constexpr double ewma_weight = 0.2;
+// Assumed for a new peer until it has sent something
+constexpr double initial_throughput = 2.0;
+// Each peer gets enough in flight to stay busy this long
+constexpr double pipeline_seconds = 4.0;
+const time_duration min_stall_timeout = seconds(20);
+// Bodies held back longer than this are handed on regardless
+const time_duration reorder_timeout = seconds(60);
+
+download_scheduler::download_scheduler(header_sync_ptr headers)
+  : headers_(headers), release_depth_(1)
+{
+}
+
+void download_scheduler::add_peer(channel_handle chandle)
+{
+    peer info;
+    info.throughput = initial_throughput;
+    info.latency = 0;
+    info.score = 0;
+    info.received = 0;
+    info.stalls = 0;
+    info.last_arrival = ptime(boost::posix_time::min_date_time);
+    peers_.insert(std::make_pair(chandle, info));
+}
+
+void download_scheduler::remove_peer(channel_handle chandle)
+{
+    auto it = peers_.find(chandle);
+    if (it == peers_.end())
+        return;
+    release_requests(it->second);
+    peers_.erase(it);
+}
+
+size_t download_scheduler::capacity(const peer& info) const
+{
+    size_t wanted = info.throughput * pipeline_seconds;
+    return std::min(std::max(wanted, min_in_flight), max_in_flight);
+}
+
+time_duration download_scheduler::stall_timeout(const peer& info) const
+{
+    time_duration allowed =
+        microseconds(static_cast<int64_t>(4000000 * info.latency));
+    return std::max(allowed, min_stall_timeout);
+}
+
+void download_scheduler::release_requests(peer& info)
+{
+    message::inv_list invs;
+    for (const request& pending: info.requests)
+        invs.push_back(
+            message::inv_vect{message::inv_type::block, pending.hash});
+    headers_->request_failed(invs);
+    info.requests.clear();
+}
+
+void download_scheduler::set_score(channel_handle chandle, double score)
+{
+    auto it = peers_.find(chandle);
+    if (it != peers_.end())
+        it->second.score = score;
+}
+
+void download_scheduler::schedule(const ptime& now, request_list& requests)
+{
+    std::vector<peer_map::iterator> order;
+    for (auto it = peers_.begin(); it != peers_.end(); ++it)
+        order.push_back(it);
+    std::stable_sort(order.begin(), order.end(),
+        [](peer_map::iterator a, peer_map::iterator b)
+        {
+            if (a->second.score != b->second.score)
+                return a->second.score > b->second.score;
+            return a->second.throughput > b->second.throughput;
+        });
+    const size_t max_depth = release_depth_ + reorder_window;
+    for (peer_map::iterator it: order)
+    {
+        peer& info = it->second;
+        const size_t peer_capacity = capacity(info);
+        // Top up in batches rather than a getdata per arrival
+        if (info.requests.size() > peer_capacity / 2)
+            continue;
+        message::inv_list invs = headers_->next_requests(
+            peer_capacity - info.requests.size(), max_depth);
+        if (invs.empty())
+            break;
+        for (const message::inv_vect& inv: invs)
+            info.requests.push_back(request{inv.hash, now});
+        requests.push_back(std::make_pair(it->first, invs));
+    }
+}
+
+void download_scheduler::arrived(channel_handle chandle, const ptime& now,
+        const hash_digest& block_hash)
+{
+    auto peer_it = peers_.find(chandle);
+    if (peer_it != peers_.end())
+    {
+        peer& info = peer_it->second;
+        auto it = std::find_if(info.requests.begin(), info.requests.end(),
+            [&block_hash](const request& pending)
+            {
+                return pending.hash == block_hash;
+            });
+        if (it != info.requests.end())
+        {
+            // An idle peer is timed from the request instead
+            ptime since = std::max(it->sent, info.last_arrival);
+            double interval = std::max(
+                (now - since).total_microseconds() / 1000000.0, 0.001);
+            double latency =
+                (now - it->sent).total_microseconds() / 1000000.0;
+            info.throughput = (1 - ewma_weight) * info.throughput +
+                ewma_weight / interval;
+            info.latency = info.received == 0 ? latency :
+                (1 - ewma_weight) * info.latency + ewma_weight * latency;
+            ++info.received;
+            info.last_arrival = now;
+            info.requests.erase(it);
+        }
+    }
+    headers_->received(block_hash);
+}
+
+void download_scheduler::received(channel_handle chandle, const ptime& now,
+        message::block_ptr block, std::vector<message::block_ptr>& ready)
+{
+    const hash_digest block_hash = hash_block_header(*block);
+    arrived(chandle, now, block_hash);
+    size_t depth;
+    // Off the best chain, already passed or a second copy at this
+    // depth: storage sorts these out
+    if (!headers_->main_chain_depth(block_hash, depth) ||
+            depth < release_depth_ || reorder_.count(depth))
+    {
+        ready.push_back(block);
+        return;
+    }
+    if (reorder_.empty())
+        last_release_ = now;
+    reorder_.insert(std::make_pair(depth, block));
+    release(now, ready);
+}
+
+void download_scheduler::duplicate(channel_handle chandle, const ptime& now,
+        const hash_digest& block_hash)
+{
+    arrived(chandle, now, block_hash);
+}
+
+void download_scheduler::release(const ptime& now,
+        std::vector<message::block_ptr>& ready)
+{
+    while (!reorder_.empty() && reorder_.begin()->first == release_depth_)
+    {
+        ready.push_back(reorder_.begin()->second);
+        reorder_.erase(reorder_.begin());
+        ++release_depth_;
+        last_release_ = now;
+    }
+}
+
+size_t download_scheduler::check_stalls(const ptime& now,
+        std::vector<message::block_ptr>& ready)
+{
+    // A best chain switch can leave the missing body already handed on
+    // as a side block. Skip the gap and let storage link them.
+    if (!reorder_.empty() && now - last_release_ > reorder_timeout)
+    {
+        release_depth_ = reorder_.begin()->first;
+        release(now, ready);
+    }
+    size_t stalled = 0;
+    for (auto& entry: peers_)
+    {
+        peer& info = entry.second;
+        if (info.requests.empty() ||
+                now - info.requests.front().sent <= stall_timeout(info))
+            continue;
+        release_requests(info);
+        // Start it again from the bottom
+        info.throughput = 0;
+        info.score = 0;
+        ++info.stalls;
+        ++stalled;
+    }
+    return stalled;
+}
+
+bool download_scheduler::statistics(channel_handle chandle,
+        peer_statistics& result) const
+{
+    auto it = peers_.find(chandle);
+    if (it == peers_.end())
+        return false;
+    const peer& info = it->second;
+    result.throughput = info.throughput;
+    result.latency = info.latency;
+    result.score = info.score;
+    result.in_flight = info.requests.size();
+    result.capacity = capacity(info);
+    result.received = info.received;
+    result.stalls = info.stalls;
+    return true;
+}
+
+size_t download_scheduler::release_depth() const
+{
+    return release_depth_;
+}
+
+} // libbitcoin
+
@@ -16,6 +16,26 @@ std::string error_category_impl::message(int ev) const
         return "Object does not exist";
     case error::object_already_exists:
         return "Matching previous object found";
+    case error::snapshot_failed:
+        return "Unable to write snapshot";
+    case error::write_failed:
+        return "Unable to write to storage";
+    case error::unsupported_operation:
+        return "Not supported by this storage";
+    case error::invalid_block:
+        return "Block fails checks that need no context";
+    case error::block_pruned:
+        return "Block data was pruned";
+    case error::invalid_transaction:
+        return "Transaction fails basic checks";
+    case error::double_spend:
+        return "Spends an output already spent in the pool";
+    case error::input_not_found:
+        return "Spends an output that is not available";
+    case error::validate_inputs_failed:
+        return "Input scripts or values do not check out";
+    case error::pool_filled:
+        return "Fee too low for the memory pool";
     default:
         return "Unknown error";
     }
@@ -0,0 +1,74 @@
+#include <bitcoin/getblocks_sync.hpp>
+
+#include <bitcoin/constants.hpp>
+
+namespace libbitcoin {
+
+constexpr size_t getblocks_sync::max_inventory;
+
+getblocks_sync::getblocks_sync(size_t low_water,
+    const time_duration& timeout)
+  : low_water_(low_water), timeout_(timeout), request_pending_(false),
+    last_announced_(null_hash)
+{
+}
+
+bool getblocks_sync::start_request(const ptime& now)
+{
+    // Forgotten, so a lost block cannot hold the sync up for good
+    for (auto it = outstanding_.begin(); it != outstanding_.end(); )
+        if (now - it->second > timeout_)
+            it = outstanding_.erase(it);
+        else
+            ++it;
+    if (request_pending_ && now - request_sent_ <= timeout_)
+        return false;
+    if (outstanding_.size() >= low_water_)
+        return false;
+    request_pending_ = true;
+    request_sent_ = now;
+    return true;
+}
+
+message::getblocks getblocks_sync::make_request(
+    const message::block_locator& stored) const
+{
+    message::getblocks request;
+    if (!outstanding_.empty() && last_announced_ != null_hash)
+        request.locator_start_hashes.push_back(last_announced_);
+    request.locator_start_hashes.insert(request.locator_start_hashes.end(),
+        stored.begin(), stored.end());
+    request.hash_stop = null_hash;
+    return request;
+}
+
+void getblocks_sync::request_failed()
+{
+    request_pending_ = false;
+}
+
+void getblocks_sync::announced(const message::inv_list& block_invs,
+    const ptime& now)
+{
+    bool any_new = false;
+    for (const message::inv_vect& inv: block_invs)
+        any_new |= outstanding_.insert(std::make_pair(inv.hash, now)).second;
+    // Repeats of what we already know are not an answer
+    if (!any_new)
+        return;
+    request_pending_ = false;
+    last_announced_ = block_invs.back().hash;
+}
+
+void getblocks_sync::received(const hash_digest& block_hash)
+{
+    outstanding_.erase(block_hash);
+}
+
+size_t getblocks_sync::outstanding() const
+{
+    return outstanding_.size();
+}
+
+} // libbitcoin
+
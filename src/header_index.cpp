@@ -0,0 +1,307 @@
+#include <bitcoin/header_index.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <bitcoin/constants.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/endian.hpp>
+#include <bitcoin/util/mapped_file.hpp>
+#include <bitcoin/util/serializer.hpp>
+#include <bitcoin/util/sha256.hpp>
+
+namespace libbitcoin {
+
+typedef boost::shared_lock<boost::shared_mutex> read_lock;
+typedef boost::unique_lock<boost::shared_mutex> write_lock;
+
+double block_difficulty(uint32_t bits)
+{
+    // Genesis target is 0x00ffff * 256^(0x1d - 3)
+    uint32_t exponent = bits >> 24, mantissa = bits & 0x00ffffff;
+    if (mantissa == 0)
+        return 0;
+    return std::ldexp(0xffff / static_cast<double>(mantissa),
+        8 * (0x1d - static_cast<int>(exponent)));
+}
+
+uint256 block_work(uint32_t bits)
+{
+    const uint256 target = uint256::from_compact(bits);
+    if (target.is_zero())
+        return uint256();
+    // 2^256 / (target + 1), without needing a 257th bit
+    return ~target / (target + 1) + 1;
+}
+
+header_index::header_index()
+{
+}
+
+bool header_index::add(const hash_digest& hash, const hash_digest& prev_hash,
+    uint32_t bits, bool verified)
+{
+    write_lock lock(mutex_);
+    entry new_entry{hash, prev_hash, bits, nullptr, 0,
+        block_work(bits), false, verified};
+    auto inserted = entries_.insert(std::make_pair(hash, new_entry));
+    if (!inserted.second)
+        return false;
+    entry& child = inserted.first->second;
+    if (prev_hash == null_hash)
+    {
+        link(child);
+        return true;
+    }
+    auto parent = entries_.find(prev_hash);
+    if (parent != entries_.end())
+        child.prev = &parent->second;
+    if (parent != entries_.end() && parent->second.linked)
+        link(child);
+    else
+        waiting_.insert(std::make_pair(prev_hash, &child));
+    return true;
+}
+
+void header_index::link(entry& first)
+{
+    // Iterative since a long run of waiting headers can link at once
+    std::vector<entry*> pending{&first};
+    while (!pending.empty())
+    {
+        entry& child = *pending.back();
+        pending.pop_back();
+        if (child.prev != nullptr)
+        {
+            child.depth = child.prev->depth + 1;
+            child.accumulated_work += child.prev->accumulated_work;
+        }
+        child.linked = true;
+        if (main_chain_.empty() || child.accumulated_work >
+                main_chain_.back()->accumulated_work)
+            update_main_chain(child);
+        auto range = waiting_.equal_range(child.hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            it->second->prev = &child;
+            pending.push_back(it->second);
+        }
+        waiting_.erase(range.first, range.second);
+    }
+}
+
+void header_index::update_main_chain(const entry& tip)
+{
+    // Walk back to where the new branch meets the old main chain
+    std::vector<const entry*> branch;
+    const entry* current = &tip;
+    while (current != nullptr &&
+        !(current->depth < main_chain_.size() &&
+            main_chain_[current->depth] == current))
+    {
+        branch.push_back(current);
+        current = current->prev;
+    }
+    main_chain_.resize(tip.depth + 1 - branch.size());
+    main_chain_.insert(main_chain_.end(), branch.rbegin(), branch.rend());
+    BITCOIN_ASSERT(main_chain_.back() == &tip);
+}
+
+bool header_index::contains(const hash_digest& hash) const
+{
+    read_lock lock(mutex_);
+    return entries_.find(hash) != entries_.end();
+}
+
+bool header_index::find(const hash_digest& hash, entry& result) const
+{
+    read_lock lock(mutex_);
+    auto it = entries_.find(hash);
+    if (it == entries_.end())
+        return false;
+    result = it->second;
+    return true;
+}
+
+size_t header_index::size() const
+{
+    read_lock lock(mutex_);
+    return entries_.size();
+}
+
+size_t header_index::bytes() const
+{
+    read_lock lock(mutex_);
+    // Hash table nodes hold the key and value behind a next pointer and
+    // the cached hash code
+    constexpr size_t node_overhead = 2 * sizeof(void*);
+    return entries_.size() *
+            (sizeof(hash_digest) + sizeof(entry) + node_overhead) +
+        entries_.bucket_count() * sizeof(void*) +
+        waiting_.size() *
+            (sizeof(hash_digest) + sizeof(entry*) + node_overhead) +
+        main_chain_.capacity() * sizeof(const entry*);
+}
+
+size_t header_index::top_depth() const
+{
+    read_lock lock(mutex_);
+    return main_chain_.empty() ? 0 : main_chain_.size() - 1;
+}
+
+bool header_index::main_chain_hash(size_t depth, hash_digest& hash) const
+{
+    read_lock lock(mutex_);
+    if (depth >= main_chain_.size())
+        return false;
+    hash = main_chain_[depth]->hash;
+    return true;
+}
+
+bool header_index::is_main_chain(const hash_digest& hash,
+    size_t& depth) const
+{
+    read_lock lock(mutex_);
+    auto it = entries_.find(hash);
+    if (it == entries_.end() || !it->second.linked)
+        return false;
+    const entry& found = it->second;
+    if (found.depth >= main_chain_.size() ||
+            main_chain_[found.depth] != &found)
+        return false;
+    depth = found.depth;
+    return true;
+}
+
+message::block_locator header_index::locator() const
+{
+    read_lock lock(mutex_);
+    message::block_locator locator;
+    if (main_chain_.empty())
+        return locator;
+    size_t depth = main_chain_.size() - 1, step = 1;
+    // Back one at a time for the first ten, then double the step
+    for (size_t i = 0; depth > 0; ++i)
+    {
+        locator.push_back(main_chain_[depth]->hash);
+        if (i >= 9)
+            step *= 2;
+        depth = depth > step ? depth - step : 0;
+    }
+    locator.push_back(main_chain_[0]->hash);
+    return locator;
+}
+
+// Snapshot layout: magic, version, last block id, entry count, then
+// each entry as hash, previous hash, bits and verified flag. A SHA-256
+// of everything before it closes the file.
+constexpr uint32_t snapshot_magic = 0x49484c42;
+constexpr uint32_t snapshot_version = 1;
+constexpr size_t snapshot_header_size = 4 + 4 + 8 + 8;
+constexpr size_t snapshot_entry_size = 32 + 32 + 4 + 1;
+
+bool header_index::save(const std::string& path,
+    uint64_t last_block_id) const
+{
+    read_lock lock(mutex_);
+    std::vector<const entry*> ordered;
+    ordered.reserve(entries_.size());
+    for (const auto& value: entries_)
+        ordered.push_back(&value.second);
+    // Parents first so replaying the image never has to wait
+    std::sort(ordered.begin(), ordered.end(),
+        [](const entry* entry_a, const entry* entry_b)
+        {
+            if (entry_a->linked != entry_b->linked)
+                return entry_a->linked;
+            return entry_a->depth < entry_b->depth;
+        });
+    serializer image;
+    image.reserve(snapshot_header_size +
+        ordered.size() * snapshot_entry_size + 32);
+    image.write_4_bytes(snapshot_magic);
+    image.write_4_bytes(snapshot_version);
+    image.write_8_bytes(last_block_id);
+    image.write_8_bytes(ordered.size());
+    for (const entry* current: ordered)
+    {
+        image.write_data(current->hash.data(), current->hash.size());
+        image.write_data(current->prev_hash.data(),
+            current->prev_hash.size());
+        image.write_4_bytes(current->bits);
+        image.write_byte(current->verified ? 1 : 0);
+    }
+    lock.unlock();
+    data_chunk data = image.release_data();
+    hash_digest checksum = generate_sha256_hash(data);
+    data.insert(data.end(), checksum.begin(), checksum.end());
+    // Write beside the old image and swap, so a crash midway leaves
+    // the previous snapshot intact
+    const std::string temp_path = path + ".tmp";
+    std::ofstream file(temp_path.c_str(), std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    file.close();
+    if (!file)
+        return false;
+    return std::rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+// Little endian, matching the serializer
+template <typename T>
+static T read_snapshot_int(const byte*& cursor)
+{
+    const T value = from_little_endian<T>(cursor);
+    cursor += sizeof(T);
+    return value;
+}
+
+static hash_digest read_snapshot_hash(const byte*& cursor)
+{
+    hash_digest hash;
+    std::copy(cursor, cursor + hash.size(), hash.begin());
+    cursor += hash.size();
+    return hash;
+}
+
+bool header_index::load(const std::string& path, uint64_t& last_block_id)
+{
+    {
+        write_lock lock(mutex_);
+        entries_.clear();
+        waiting_.clear();
+        main_chain_.clear();
+    }
+    mapped_file mapping(path);
+    if (mapping.size() < snapshot_header_size + 32)
+        return false;
+    const byte* cursor = mapping.data();
+    const byte* body_end = mapping.data() + mapping.size() - 32;
+    if (read_snapshot_int<uint32_t>(cursor) != snapshot_magic ||
+            read_snapshot_int<uint32_t>(cursor) != snapshot_version)
+        return false;
+    last_block_id = read_snapshot_int<uint64_t>(cursor);
+    uint64_t count = read_snapshot_int<uint64_t>(cursor);
+    if (count != (mapping.size() - snapshot_header_size - 32) /
+                snapshot_entry_size ||
+            cursor + count * snapshot_entry_size != body_end)
+        return false;
+    hash_digest checksum = generate_sha256_hash(
+        data_view(mapping.data(), body_end));
+    if (!std::equal(checksum.begin(), checksum.end(), body_end))
+        return false;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        hash_digest hash = read_snapshot_hash(cursor),
+            prev_hash = read_snapshot_hash(cursor);
+        uint32_t bits = read_snapshot_int<uint32_t>(cursor);
+        bool verified = *cursor++ != 0;
+        add(hash, prev_hash, bits, verified);
+    }
+    return true;
+}
+
+} // libbitcoin
+
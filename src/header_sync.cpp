@@ -0,0 +1,115 @@
+#include <bitcoin/header_sync.hpp>
+
+#include <algorithm>
+
+#include <bitcoin/block.hpp>
+#include <bitcoin/constants.hpp>
+#include <bitcoin/verify.hpp>
+
+namespace libbitcoin {
+
+constexpr size_t header_sync::max_headers;
+
+header_sync::header_sync(const hash_digest& start_hash)
+  : requested_depth_(0)
+{
+    // Its body is stored already
+    index_.add(start_hash, null_hash, 0, true);
+    requested_.insert(start_hash);
+}
+
+bool header_sync::accept(const message::headers& packet)
+{
+    for (const message::block& header: packet.block_headers)
+    {
+        hash_digest block_hash = hash_block_header(header);
+        if (!check_proof_of_work(block_hash, header.bits))
+            return false;
+        // Headers not connecting to anything yet wait in the index
+        index_.add(block_hash, header.prev_block, header.bits);
+    }
+    return true;
+}
+
+message::block_locator header_sync::locator() const
+{
+    return index_.locator();
+}
+
+size_t header_sync::top_depth() const
+{
+    return index_.top_depth();
+}
+
+message::inv_list header_sync::next_requests(size_t count, size_t max_depth)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    message::inv_list invs;
+    while (!retry_.empty() && invs.size() < count)
+    {
+        const hash_digest& block_hash = retry_.back();
+        invs.push_back(message::inv_vect{message::inv_type::block, block_hash});
+        outstanding_.insert(block_hash);
+        retry_.pop_back();
+    }
+    // The best chain may have switched branches since. Step back to
+    // where it meets what was already handed out.
+    hash_digest block_hash;
+    while (requested_depth_ > 0 &&
+            !(index_.main_chain_hash(requested_depth_, block_hash) &&
+                requested_.count(block_hash)))
+        --requested_depth_;
+    while (invs.size() < count && requested_depth_ < max_depth &&
+            index_.main_chain_hash(requested_depth_ + 1, block_hash))
+    {
+        ++requested_depth_;
+        if (!requested_.insert(block_hash).second)
+            continue;
+        invs.push_back(message::inv_vect{message::inv_type::block, block_hash});
+        outstanding_.insert(block_hash);
+    }
+    return invs;
+}
+
+bool header_sync::main_chain_depth(
+        const hash_digest& block_hash, size_t& depth) const
+{
+    header_index::entry block_entry;
+    hash_digest main_hash;
+    if (!index_.find(block_hash, block_entry) || !block_entry.linked ||
+            !index_.main_chain_hash(block_entry.depth, main_hash) ||
+            main_hash != block_hash)
+        return false;
+    depth = block_entry.depth;
+    return true;
+}
+
+void header_sync::received(const hash_digest& block_hash)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    outstanding_.erase(block_hash);
+}
+
+bool header_sync::have_body(const hash_digest& block_hash) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return requested_.count(block_hash) && !outstanding_.count(block_hash) &&
+        std::find(retry_.begin(), retry_.end(), block_hash) == retry_.end();
+}
+
+void header_sync::request_failed(const message::inv_list& invs)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const message::inv_vect& inv: invs)
+        if (outstanding_.erase(inv.hash))
+            retry_.push_back(inv.hash);
+}
+
+size_t header_sync::outstanding() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return outstanding_.size();
+}
+
+} // libbitcoin
+
@@ -0,0 +1,68 @@
+#include <bitcoin/inventory_tracker.hpp>
+
+#include <algorithm>
+
+namespace libbitcoin {
+
+inventory_tracker::inventory_tracker(const time_duration& timeout,
+    size_t known_capacity)
+  : timeout_(timeout),
+    generation_capacity_(std::max<size_t>(known_capacity / 2, 1))
+{
+}
+
+bool inventory_tracker::request(const message::inv_vect& inv,
+    channel_handle chandle, const ptime& now)
+{
+    if (known(inv.hash) || requests_.count(inv.hash) > 0)
+        return false;
+    requests_[inv.hash] = request_entry{inv.type, chandle, now};
+    return true;
+}
+
+void inventory_tracker::settle(const hash_digest& hash)
+{
+    requests_.erase(hash);
+    if (known(hash))
+        return;
+    if (known_.size() >= generation_capacity_)
+    {
+        previous_known_.swap(known_);
+        known_.clear();
+    }
+    known_.insert(hash);
+}
+
+bool inventory_tracker::known(const hash_digest& hash) const
+{
+    return known_.count(hash) > 0 || previous_known_.count(hash) > 0;
+}
+
+void inventory_tracker::expire(const ptime& now, message::inv_list& expired)
+{
+    for (auto it = requests_.begin(); it != requests_.end(); )
+        if (now - it->second.sent > timeout_)
+        {
+            expired.push_back(message::inv_vect{it->second.type, it->first});
+            it = requests_.erase(it);
+        }
+        else
+            ++it;
+}
+
+void inventory_tracker::remove_peer(channel_handle chandle)
+{
+    for (auto it = requests_.begin(); it != requests_.end(); )
+        if (it->second.chandle == chandle)
+            it = requests_.erase(it);
+        else
+            ++it;
+}
+
+size_t inventory_tracker::in_flight() const
+{
+    return requests_.size();
+}
+
+} // libbitcoin
+
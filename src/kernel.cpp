@@ -3,12 +3,25 @@
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/bind.hpp>
 #include <algorithm>
-
+#include <random>
+
+#include <bitcoin/block.hpp>
+#include <bitcoin/compact_block.hpp>
+#include <bitcoin/constants.hpp>
+#include <bitcoin/download_scheduler.hpp>
+#include <bitcoin/getblocks_sync.hpp>
+#include <bitcoin/header_sync.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/transaction_pool.hpp>
+#include <bitcoin/verify.hpp>
 #include <bitcoin/util/assert.hpp>
 #include <bitcoin/util/logger.hpp>
+#include <bitcoin/util/metrics.hpp>
+#include <bitcoin/network/connection_manager.hpp>
 #include <bitcoin/network/network.hpp>
 #include <bitcoin/storage/storage.hpp>
 
+using boost::posix_time::ptime;
 using boost::posix_time::seconds;
 using boost::posix_time::minutes;
 using boost::posix_time::time_duration;
@@ -20,18 +33,30 @@ using boost::asio::buffer;
 namespace libbitcoin {
 
 const time_duration poll_inv_timeout = seconds(10);
-
-void null(std::error_code)
+const time_duration stall_check_interval = seconds(5);
+const time_duration inventory_timeout = seconds(30);
+const time_duration relay_trickle_interval = seconds(2);
+// Anything longer answers a getaddr and is not news
+constexpr size_t max_relayed_addresses = 10;
+// Older addresses are passed on only when asked for
+const time_duration relayed_address_age = minutes(10);
+
+ptime now()
 {
+    return boost::posix_time::microsec_clock::universal_time();
 }
 
-kernel::kernel()
+kernel::kernel(thread_pool_ptr executor)
+  : threaded_service(executor), inventory_(inventory_timeout),
+    headers_first_(false), getblocks_peer_(0)
 {
 }
 
 void kernel::register_network(network_ptr net_comp)
 {
     network_component_ = net_comp;
+    relay_timer_.reset(new deadline_timer(*service()));
+    reset_relay_trickle();
 }
 
 network_ptr kernel::get_network()
@@ -51,15 +76,62 @@ void kernel::send_failed(channel_handle, const message::getaddr&)
 {
 }
 
-void kernel::send_failed(channel_handle, const message::inv&)
+// The channel is gone, so whatever else was queued for it can go too
+void kernel::send_failed(channel_handle chandle, const message::inv&)
+{
+    strand()->post(std::bind(
+            &kernel::remove_peer, shared_from_this(), chandle));
+}
+
+void kernel::send_failed(channel_handle chandle, const message::addr&)
 {
+    strand()->post(std::bind(
+            &kernel::remove_peer, shared_from_this(), chandle));
+}
+
+void kernel::send_failed(channel_handle chandle, const message::getdata&)
+{
+    if (!headers_first_)
+        return;
+    // Its requests go back to the scheduler with it
+    strand()->post(std::bind(
+            &kernel::remove_peer, shared_from_this(), chandle));
 }
 
-void kernel::send_failed(channel_handle, const message::getdata&)
+void kernel::send_failed(channel_handle chandle, const message::getblocks&)
 {
+    strand()->post(std::bind(
+            &kernel::getblocks_failed, shared_from_this(), chandle));
 }
 
-void kernel::send_failed(channel_handle, const message::getblocks&)
+void kernel::send_failed(channel_handle chandle, const message::getheaders&)
+{
+    strand()->post(std::bind(
+            &kernel::remove_peer, shared_from_this(), chandle));
+}
+
+void kernel::send_failed(channel_handle, const message::send_compact&)
+{
+}
+
+void kernel::send_failed(channel_handle, const message::compact_block&)
+{
+}
+
+void kernel::send_failed(channel_handle chandle,
+        const message::get_block_transactions&)
+{
+    // The block is asked of someone else
+    strand()->post(std::bind(
+            &kernel::remove_peer, shared_from_this(), chandle));
+}
+
+void kernel::send_failed(channel_handle, const message::block_transactions&)
+{
+}
+
+void kernel::send_failed(channel_handle, message::command_type,
+        data_chunk_ptr)
 {
 }
 
@@ -70,6 +142,8 @@ bool kernel::recv_message(channel_handle chandle,
     log_debug() << "last block is " << message.start_height;
     log_debug() << hexlify(message.addr_you.ip_addr);
     network_component_->send(chandle, message::verack());
+    strand()->post(std::bind(
+            &kernel::add_peer, shared_from_this(), chandle));
     return true;
 }
 
@@ -79,41 +153,259 @@ bool kernel::recv_message(channel_handle, const message::verack&)
     return true;
 }
 
-bool kernel::recv_message(channel_handle, const message::addr& message)
+bool kernel::recv_message(channel_handle chandle,
+        const message::addr& message)
 {
-    for (const message::net_addr addr: message.addr_list)
-        log_debug() << hexlify(addr.ip_addr) << ' ' << addr.port;
+    if (log_enabled(logger_level::debug))
+        for (const message::net_addr addr: message.addr_list)
+            log_debug() << hexlify(addr.ip_addr) << ' ' << addr.port;
+    strand()->post(std::bind(&kernel::handle_addresses,
+            shared_from_this(), chandle, message.addr_list));
     return true;
 }
 
-bool kernel::recv_message(channel_handle, const message::inv& message)
+bool kernel::recv_message(channel_handle chandle,
+        const message::inv& message)
 {
-    message::inv request_invs;
+    message::inv_list block_invs, transaction_invs;
     for (const message::inv_vect curr_inv: message.invs)
     {
         if (curr_inv.type == message::inv_type::none)
             return false;
 
-        if (curr_inv.type == message::inv_type::error)
-            log_debug() << "ERROR";
-        else if (curr_inv.type == message::inv_type::transaction)
-            log_debug() << "MSG_TX";
-        else if (curr_inv.type == message::inv_type::block)
-            log_debug() << "MSG_BLOCK";
-        log_debug() << hexlify(curr_inv.hash);
+        // Spares the hex encoding of every hash when debug is off
+        if (log_enabled(logger_level::debug))
+        {
+            if (curr_inv.type == message::inv_type::error)
+                log_debug() << "ERROR";
+            else if (curr_inv.type == message::inv_type::transaction)
+                log_debug() << "MSG_TX";
+            else if (curr_inv.type == message::inv_type::block)
+                log_debug() << "MSG_BLOCK";
+            log_debug() << hexlify(curr_inv.hash);
+        }
 
-        // Push only block invs to the request queue
         if (curr_inv.type == message::inv_type::block)
-            request_invs.invs.push_back(curr_inv);
+            block_invs.push_back(curr_inv);
+        else if (curr_inv.type == message::inv_type::transaction &&
+                transaction_pool_)
+            transaction_invs.push_back(curr_inv);
+    }
+    strand()->post(std::bind(&kernel::peer_announced,
+            shared_from_this(), chandle, message.invs));
+    if (!transaction_invs.empty())
+        strand()->post(std::bind(&kernel::request_transactions,
+                shared_from_this(), chandle, transaction_invs));
+    if (headers_first_)
+    {
+        // Fetched once their headers check out
+        if (!block_invs.empty())
+            strand()->post(std::bind(
+                    &kernel::request_headers, shared_from_this(), chandle));
+        return true;
     }
-    storage_component_->store(request_invs, null);
-    accept_inventories(std::error_code(), request_invs.invs);
+    if (block_invs.empty())
+        return true;
+    strand()->post(std::bind(&kernel::getblocks_announced,
+            shared_from_this(), block_invs));
+    // One lookup for the whole announcement, then only what we lack
+    storage::hash_list block_hashes;
+    for (const message::inv_vect& curr_inv: block_invs)
+        block_hashes.push_back(curr_inv.hash);
+    storage_component_->blocks_exist(block_hashes,
+            strand()->wrap(std::bind(&kernel::request_missing,
+                shared_from_this(), std::placeholders::_1,
+                    std::placeholders::_2, block_invs, chandle)));
     return true;
 }
 
-bool kernel::recv_message(channel_handle, const message::block& message)
+void kernel::request_missing(const std::error_code& ec,
+        const std::vector<bool>& exists, const message::inv_list& invs,
+        channel_handle chandle)
+{
+    message::getdata request_message;
+    for (size_t i = 0; i < invs.size(); ++i)
+        if (!ec && exists[i])
+        {
+            inventory_.settle(invs[i].hash);
+            getblocks_received(invs[i].hash);
+        }
+        else if (inventory_.request(invs[i], chandle, now()))
+            request_message.invs.push_back(invs[i]);
+    prefer_compact(chandle, request_message);
+    if (!request_message.invs.empty())
+        network_component_->send(chandle, request_message);
+}
+
+void kernel::request_transactions(channel_handle chandle,
+        const message::inv_list& invs)
+{
+    // Transactions come straight from whoever announced them
+    message::getdata request_message;
+    for (const message::inv_vect& curr_inv: invs)
+        if (!transaction_pool_->exists(curr_inv.hash) &&
+                inventory_.request(curr_inv, chandle, now()))
+            request_message.invs.push_back(curr_inv);
+    if (!request_message.invs.empty())
+        network_component_->send(chandle, request_message);
+}
+
+void kernel::settle_inventory(channel_handle chandle,
+        const hash_digest& hash)
+{
+    inventory_.settle(hash);
+    relay_.mark_known(chandle, hash);
+}
+
+bool kernel::recv_message(channel_handle chandle,
+        const message::getdata& message)
+{
+    for (const message::inv_vect& curr_inv: message.invs)
+        if (curr_inv.type == message::inv_type::block)
+            storage_component_->fetch_raw_block_by_hash(curr_inv.hash,
+                    std::bind(&kernel::serve_block, shared_from_this(),
+                        std::placeholders::_1, std::placeholders::_2,
+                            chandle));
+        else if (curr_inv.type == message::inv_type::compact_block)
+            storage_component_->fetch_raw_block_by_hash(curr_inv.hash,
+                    std::bind(&kernel::serve_compact_block,
+                        shared_from_this(), std::placeholders::_1,
+                            std::placeholders::_2, chandle));
+        else if (curr_inv.type == message::inv_type::transaction &&
+                transaction_pool_)
+        {
+            data_chunk_ptr raw_tx = transaction_pool_->fetch_raw(curr_inv.hash);
+            if (raw_tx)
+                network_component_->send_raw(chandle,
+                        message::command_type::tx, raw_tx);
+        }
+    return true;
+}
+
+bool kernel::recv_message(channel_handle chandle,
+        const message::transaction& message)
+{
+    if (!transaction_pool_)
+        return true;
+    message::inv_vect tx_inv{message::inv_type::transaction,
+            hash_transaction(message)};
+    strand()->post(std::bind(&kernel::settle_inventory,
+            shared_from_this(), chandle, tx_inv.hash));
+    transaction_pool_->store(message,
+            std::bind(&kernel::handle_transaction, shared_from_this(),
+                std::placeholders::_1, tx_inv));
+    return true;
+}
+
+bool kernel::recv_message(channel_handle chandle, lazy_block_ptr message)
+{
+    strand()->post(std::bind(&kernel::settle_inventory,
+            shared_from_this(), chandle, message->hash()));
+    // A second copy is settled by its header alone
+    if (headers_first_ && header_sync_ &&
+            header_sync_->have_body(message->hash()))
+    {
+        strand()->post(std::bind(&kernel::handle_duplicate,
+                shared_from_this(), chandle, message->hash()));
+        return true;
+    }
+    // Decoded on the channel's thread rather than on the kernel strand
+    return recv_message(chandle,
+            std::make_shared<const message::block>(message->decode()));
+}
+
+bool kernel::recv_message(channel_handle chandle, message::block_ptr message)
+{
+    static counter& blocks_invalid =
+        shared_metrics().get_counter("kernel.blocks_invalid");
+    // Checked here on the channel's thread, so storage never sees a
+    // block that could be rejected without the chain. Dropping the peer
+    // hands what it was sent to the others.
+    if (!message->context_checked.passed() &&
+            !check_block_context_free(*message))
+    {
+        blocks_invalid.add();
+        log_debug() << "Block " << hexlify(hash_block_header(*message))
+                << " from " << chandle << " is invalid";
+        return false;
+    }
+    // Scheduled bodies are stored in height order
+    if (headers_first_)
+    {
+        strand()->post(std::bind(
+                &kernel::handle_body, shared_from_this(), chandle, message));
+        return true;
+    }
+    strand()->post(std::bind(&kernel::getblocks_received,
+            shared_from_this(), hash_block_header(*message)));
+    store_block(message);
+    return true;
+}
+
+bool kernel::recv_message(channel_handle chandle,
+        const message::headers& message)
 {
-    storage_component_->store(message, null);
+    if (!header_sync_)
+        return true;
+    // Bad proof of work drops the peer
+    if (!header_sync_->accept(message))
+        return false;
+    strand()->post(std::bind(&kernel::handle_headers, shared_from_this(),
+            chandle, message.block_headers.size()));
+    return true;
+}
+
+bool kernel::recv_message(channel_handle chandle,
+        const message::send_compact& message)
+{
+    // Blocks are only sent when asked for, so announce makes no odds
+    if (message.version == compact_block_version)
+        strand()->post(std::bind(
+                &kernel::add_compact_peer, shared_from_this(), chandle));
+    return true;
+}
+
+bool kernel::recv_message(channel_handle chandle,
+        const message::compact_block& message)
+{
+    static counter& compact_blocks =
+        shared_metrics().get_counter("kernel.compact_blocks");
+    // Never asked for without a pool to fill them from
+    if (!transaction_pool_)
+        return true;
+    compact_blocks.add();
+    partial_block_ptr block = std::make_shared<partial_block>(message);
+    if (!block->valid())
+    {
+        strand()->post(std::bind(&kernel::request_whole_block,
+                shared_from_this(), chandle, block->hash()));
+        return true;
+    }
+    // Filled in here on the channel's thread
+    transaction_pool_->for_each(std::bind(&partial_block::offer,
+            block.get(), std::placeholders::_1, std::placeholders::_2));
+    if (block->complete())
+        return finish_compact(chandle, *block);
+    strand()->post(std::bind(&kernel::await_transactions,
+            shared_from_this(), chandle, block));
+    return true;
+}
+
+bool kernel::recv_message(channel_handle chandle,
+        const message::get_block_transactions& message)
+{
+    storage_component_->fetch_raw_block_by_hash(message.block_hash,
+            std::bind(&kernel::serve_block_transactions, shared_from_this(),
+                std::placeholders::_1, std::placeholders::_2, chandle,
+                    message.indexes));
+    return true;
+}
+
+bool kernel::recv_message(channel_handle chandle,
+        const message::block_transactions& message)
+{
+    strand()->post(std::bind(&kernel::handle_block_transactions,
+            shared_from_this(), chandle, message));
     return true;
 }
 
@@ -132,19 +424,24 @@ void kernel::reset_inventory_poll()
 {
     poll_invs_timeout_->cancel();
     poll_invs_timeout_->expires_from_now(poll_inv_timeout);
-    poll_invs_timeout_->async_wait(std::bind(
+    poll_invs_timeout_->async_wait(strand()->wrap(std::bind(
             &kernel::request_inventories, shared_from_this(),
-                std::placeholders::_1));
+                std::placeholders::_1)));
 }
 
 void kernel::request_inventories(const boost::system::error_code& ec)
 {
     if (ec)
         return;
-    storage_component_->fetch_inventories(
-            std::bind(&kernel::accept_inventories,
-                shared_from_this(), 
-                std::placeholders::_1, std::placeholders::_2));
+    // Whoever sat on these too long loses them to a random peer
+    message::inv_list expired;
+    inventory_.expire(now(), expired);
+    if (!expired.empty())
+        network_component_->get_random_handle(strand()->wrap(std::bind(
+                &kernel::retry_requests, shared_from_this(),
+                    std::placeholders::_1, expired)));
+    // Catches getblocks that timed out
+    continue_getblocks_sync();
     reset_inventory_poll();
 }
 
@@ -153,23 +450,476 @@ storage_ptr kernel::get_storage()
     return storage_component_;
 }
 
-void kernel::accept_inventories(const std::error_code& ec, 
+void kernel::register_transaction_pool(transaction_pool_ptr pool)
+{
+    transaction_pool_ = pool;
+}
+
+void kernel::register_connection_manager(
+        connection_manager_ptr connections)
+{
+    connection_manager_ = connections;
+}
+
+void kernel::retry_requests(channel_handle chandle,
         const message::inv_list& invs)
 {
+    message::getdata request_message;
+    for (const message::inv_vect& curr_inv: invs)
+        if (inventory_.request(curr_inv, chandle, now()))
+            request_message.invs.push_back(curr_inv);
+    if (!request_message.invs.empty())
+        network_component_->send(chandle, request_message);
+}
+
+void kernel::serve_block(const std::error_code& ec,
+        data_chunk_ptr raw_block, channel_handle chandle)
+{
+    // Blocks we do not have are simply not sent
     if (ec)
         return;
-    message::getdata request_message;
-    request_message.invs = invs;
-    network_component_->get_random_handle(std::bind(
-            &kernel::send_to_random, shared_from_this(),
-                std::placeholders::_1, request_message));
+    network_component_->send_raw(chandle,
+            message::command_type::block, raw_block);
+}
+
+void kernel::store_block(message::block_ptr block)
+{
+    storage_component_->store(block, std::bind(&kernel::stored_block,
+            shared_from_this(), std::placeholders::_1, block));
+}
+
+void kernel::stored_block(const std::error_code& ec,
+        message::block_ptr block)
+{
+    static counter& blocks_stored =
+        shared_metrics().get_counter("kernel.blocks_stored");
+    static counter& blocks_rejected =
+        shared_metrics().get_counter("kernel.blocks_rejected");
+    if (ec)
+    {
+        blocks_rejected.add();
+        return;
+    }
+    blocks_stored.add();
+    if (transaction_pool_)
+        transaction_pool_->remove_confirmed(block);
+}
+
+void kernel::handle_transaction(const std::error_code& ec,
+        const message::inv_vect& tx_inv)
+{
+    if (ec)
+    {
+        log_debug() << "Transaction " << hexlify(tx_inv.hash)
+                << " not accepted: " << ec.message();
+        return;
+    }
+    // The source was marked as knowing it when it arrived
+    strand()->post(std::bind(
+            &kernel::announce, shared_from_this(), tx_inv));
+}
+
+void kernel::reset_relay_trickle()
+{
+    relay_timer_->expires_from_now(relay_trickle_interval);
+    relay_timer_->async_wait(strand()->wrap(std::bind(
+            &kernel::trickle, shared_from_this(), std::placeholders::_1)));
+}
+
+void kernel::trickle(const boost::system::error_code& ec)
+{
+    if (ec)
+        return;
+    peer_relay::inv_batch_list inv_batches;
+    peer_relay::addr_batch_list addr_batches;
+    relay_.flush(inv_batches, addr_batches);
+    for (const auto& batch: inv_batches)
+        network_component_->send(batch.first, batch.second);
+    for (const auto& batch: addr_batches)
+        network_component_->send(batch.first, batch.second);
+    reset_relay_trickle();
+}
+
+void kernel::peer_announced(channel_handle chandle,
+        const message::inv_list& invs)
+{
+    for (const message::inv_vect& curr_inv: invs)
+        relay_.mark_known(chandle, curr_inv.hash);
 }
 
-void kernel::send_to_random(channel_handle chandle,
-        const message::getdata& request_message)
+void kernel::handle_addresses(channel_handle chandle,
+        const std::vector<message::net_addr>& addresses)
 {
+    for (const message::net_addr& addr: addresses)
+        relay_.mark_known(chandle, addr);
+    if (connection_manager_)
+        connection_manager_->add_addresses(addresses);
+    if (addresses.size() > max_relayed_addresses)
+        return;
+    const ptime epoch(boost::gregorian::date(1970, 1, 1));
+    const uint32_t oldest =
+            (now() - relayed_address_age - epoch).total_seconds();
+    for (const message::net_addr& addr: addresses)
+        if (addr.timestamp >= oldest)
+            relay_.announce(addr);
+}
+
+void kernel::announce(const message::inv_vect& inv)
+{
+    relay_.announce(inv);
+}
+
+void kernel::enable_headers_first()
+{
+    headers_first_ = true;
+    storage_component_->fetch_block_locator(
+            strand()->wrap(std::bind(&kernel::start_headers_sync,
+                shared_from_this(),
+                std::placeholders::_1, std::placeholders::_2)));
+}
+
+void kernel::start_headers_sync(const std::error_code& ec,
+        const message::block_locator& locator)
+{
+    if (ec || locator.empty())
+    {
+        log_error() << "Headers-first sync: no stored chain to start from";
+        return;
+    }
+    header_sync_.reset(new header_sync(locator.front()));
+    scheduler_.reset(new download_scheduler(header_sync_));
+    for (channel_handle chandle: peers_)
+    {
+        scheduler_->add_peer(chandle);
+        request_headers(chandle);
+    }
+    stall_timer_.reset(new deadline_timer(*service()));
+    reset_stall_check();
+}
+
+void kernel::reset_stall_check()
+{
+    stall_timer_->expires_from_now(stall_check_interval);
+    stall_timer_->async_wait(strand()->wrap(std::bind(
+            &kernel::check_stalls, shared_from_this(),
+                std::placeholders::_1)));
+}
+
+void kernel::check_stalls(const boost::system::error_code& ec)
+{
+    if (ec)
+        return;
+    std::vector<message::block_ptr> ready;
+    size_t stalled = scheduler_->check_stalls(now(), ready);
+    if (stalled > 0)
+        log_debug() << stalled << " peers stalled, re-requesting their blocks";
+    for (message::block_ptr block: ready)
+        store_block(block);
+    schedule_bodies();
+    network_component_->fetch_metrics(strand()->wrap(std::bind(
+            &kernel::handle_metrics, shared_from_this(),
+                std::placeholders::_1)));
+    reset_stall_check();
+}
+
+void kernel::handle_metrics(const std::vector<peer_metrics>& metrics)
+{
+    std::set<channel_handle> connected;
+    for (const peer_metrics& peer: metrics)
+    {
+        if (!peers_.count(peer.chandle))
+            continue;
+        if (peer_too_slow(peer, now()))
+        {
+            log_debug() << "Dropping slow peer " << peer.chandle;
+            network_component_->disconnect(peer.chandle);
+            continue;
+        }
+        connected.insert(peer.chandle);
+        scheduler_->set_score(peer.chandle, peer_score(peer, now()));
+    }
+    // Gone or dropped channels hand their work back
+    std::vector<channel_handle> departed;
+    for (channel_handle chandle: peers_)
+        if (!connected.count(chandle))
+            departed.push_back(chandle);
+    for (channel_handle chandle: departed)
+        remove_peer(chandle);
+}
+
+void kernel::add_peer(channel_handle chandle)
+{
+    relay_.add_peer(chandle);
+    peers_.insert(chandle);
+    // Compact blocks are filled in from the pool
+    if (transaction_pool_)
+        network_component_->send(chandle,
+                message::send_compact{false, compact_block_version});
+    if (!headers_first_)
+    {
+        continue_getblocks_sync();
+        return;
+    }
+    if (!scheduler_)
+        return;
+    scheduler_->add_peer(chandle);
+    request_headers(chandle);
+    schedule_bodies();
+}
+
+void kernel::remove_peer(channel_handle chandle)
+{
+    peers_.erase(chandle);
+    header_requests_.erase(chandle);
+    inventory_.remove_peer(chandle);
+    relay_.remove_peer(chandle);
+    compact_peers_.erase(chandle);
+    for (auto it = pending_compacts_.begin(); it != pending_compacts_.end();)
+        if (it->second.chandle == chandle)
+            it = pending_compacts_.erase(it);
+        else
+            ++it;
+    if (!scheduler_)
+        return;
+    // Whatever it was sent goes to the others
+    scheduler_->remove_peer(chandle);
+    schedule_bodies();
+}
+
+void kernel::request_headers(channel_handle chandle)
+{
+    if (!header_sync_ || !header_requests_.insert(chandle).second)
+        return;
+    message::getheaders getheaders;
+    getheaders.locator_start_hashes = header_sync_->locator();
+    getheaders.hash_stop = null_hash;
+    network_component_->send(chandle, getheaders);
+}
+
+void kernel::handle_headers(channel_handle chandle, size_t count)
+{
+    header_requests_.erase(chandle);
+    log_debug() << "Best header chain is " << header_sync_->top_depth()
+            << " blocks past the stored tip";
+    // A full reply means the peer has more
+    if (count == header_sync::max_headers)
+        request_headers(chandle);
+    schedule_bodies();
+}
+
+void kernel::schedule_bodies()
+{
+    download_scheduler::request_list requests;
+    scheduler_->schedule(now(), requests);
+    for (const auto& request: requests)
+    {
+        message::getdata request_message;
+        request_message.invs = request.second;
+        network_component_->send(request.first, request_message);
+    }
+}
+
+void kernel::handle_body(channel_handle chandle, message::block_ptr block)
+{
+    if (!scheduler_)
+    {
+        store_block(block);
+        return;
+    }
+    std::vector<message::block_ptr> ready;
+    scheduler_->received(chandle, now(), block, ready);
+    for (message::block_ptr ready_block: ready)
+        store_block(ready_block);
+    schedule_bodies();
+}
+
+void kernel::handle_duplicate(channel_handle chandle,
+        const hash_digest& block_hash)
+{
+    if (!scheduler_)
+        return;
+    scheduler_->duplicate(chandle, now(), block_hash);
+    schedule_bodies();
+}
+
+void kernel::enable_getblocks_sync()
+{
+    strand()->post(std::bind(
+            &kernel::start_getblocks_sync, shared_from_this()));
+}
+
+void kernel::start_getblocks_sync()
+{
+    getblocks_sync_.reset(new getblocks_sync);
+    continue_getblocks_sync();
+}
+
+void kernel::continue_getblocks_sync()
+{
+    if (!getblocks_sync_ || peers_.empty() ||
+            !getblocks_sync_->start_request(now()))
+        return;
+    // The stores answer this from their header index
+    storage_component_->fetch_block_locator(
+            strand()->wrap(std::bind(&kernel::send_getblocks,
+                shared_from_this(),
+                std::placeholders::_1, std::placeholders::_2)));
+}
+
+void kernel::send_getblocks(const std::error_code& ec,
+        const message::block_locator& locator)
+{
+    if (ec || peers_.empty())
+    {
+        getblocks_sync_->request_failed();
+        return;
+    }
+    auto next = peers_.upper_bound(getblocks_peer_);
+    getblocks_peer_ = next == peers_.end() ? *peers_.begin() : *next;
+    network_component_->send(getblocks_peer_,
+            getblocks_sync_->make_request(locator));
+}
+
+void kernel::getblocks_failed(channel_handle chandle)
+{
+    remove_peer(chandle);
+    if (!getblocks_sync_)
+        return;
+    getblocks_sync_->request_failed();
+    continue_getblocks_sync();
+}
+
+void kernel::getblocks_announced(const message::inv_list& block_invs)
+{
+    if (!getblocks_sync_)
+        return;
+    getblocks_sync_->announced(block_invs, now());
+    continue_getblocks_sync();
+}
+
+void kernel::getblocks_received(const hash_digest& block_hash)
+{
+    if (!getblocks_sync_)
+        return;
+    getblocks_sync_->received(block_hash);
+    continue_getblocks_sync();
+}
+
+// Fresh for every compact block, so nobody can line up collisions for
+// all of our peers at once
+static uint64_t compact_nonce()
+{
+    std::random_device random;
+    return (static_cast<uint64_t>(random()) << 32) | random();
+}
+
+void kernel::add_compact_peer(channel_handle chandle)
+{
+    if (peers_.count(chandle))
+        compact_peers_.insert(chandle);
+}
+
+void kernel::prefer_compact(channel_handle chandle,
+        message::getdata& request)
+{
+    // Runs of blocks are catching up and would mostly miss in the pool
+    if (!transaction_pool_ || request.invs.size() != 1 ||
+            request.invs[0].type != message::inv_type::block ||
+            !compact_peers_.count(chandle))
+        return;
+    request.invs[0].type = message::inv_type::compact_block;
+}
+
+void kernel::await_transactions(channel_handle chandle,
+        partial_block_ptr block)
+{
+    static counter& compact_round_trips =
+        shared_metrics().get_counter("kernel.compact_round_trips");
+    if (!peers_.count(chandle))
+        return;
+    compact_round_trips.add();
+    pending_compacts_[block->hash()] = pending_compact{chandle, block};
+    network_component_->send(chandle,
+            message::get_block_transactions{block->hash(), block->missing()});
+}
+
+void kernel::handle_block_transactions(channel_handle chandle,
+        const message::block_transactions& response)
+{
+    auto it = pending_compacts_.find(response.block_hash);
+    // Unasked, or not from whoever we asked
+    if (it == pending_compacts_.end() || it->second.chandle != chandle)
+        return;
+    partial_block_ptr block = it->second.block;
+    pending_compacts_.erase(it);
+    if (!block->fill(response.transactions))
+        request_whole_block(chandle, block->hash());
+    else if (!finish_compact(chandle, *block))
+        network_component_->disconnect(chandle);
+}
+
+void kernel::request_whole_block(channel_handle chandle,
+        const hash_digest& block_hash)
+{
+    message::getdata request_message;
+    request_message.invs.push_back(
+            message::inv_vect{message::inv_type::block, block_hash});
     network_component_->send(chandle, request_message);
 }
 
+bool kernel::finish_compact(channel_handle chandle, const partial_block& block)
+{
+    static counter& compact_collisions =
+        shared_metrics().get_counter("kernel.compact_collisions");
+    message::block_ptr whole =
+            std::make_shared<const message::block>(block.block());
+    // A short id that matched the wrong transaction is not the peer's
+    // fault, so it is caught here rather than as an invalid block
+    if (generate_merkle_root(whole->transactions) != whole->merkle_root)
+    {
+        compact_collisions.add();
+        strand()->post(std::bind(&kernel::request_whole_block,
+                shared_from_this(), chandle, block.hash()));
+        return true;
+    }
+    strand()->post(std::bind(&kernel::settle_inventory,
+            shared_from_this(), chandle, block.hash()));
+    return recv_message(chandle, whole);
+}
+
+void kernel::serve_compact_block(const std::error_code& ec,
+        data_chunk_ptr raw_block, channel_handle chandle)
+{
+    if (ec)
+        return;
+    lazy_block block(raw_block);
+    if (!block.valid())
+        return;
+    network_component_->send(chandle,
+            make_compact_block(block.decode(), compact_nonce()));
+}
+
+void kernel::serve_block_transactions(const std::error_code& ec,
+        data_chunk_ptr raw_block, channel_handle chandle,
+        const std::vector<uint32_t>& indexes)
+{
+    if (ec)
+        return;
+    lazy_block block(raw_block);
+    if (!block.valid())
+        return;
+    message::block_transactions response;
+    response.block_hash = block.hash();
+    response.transactions.reserve(indexes.size());
+    for (uint32_t index: indexes)
+    {
+        // Nothing is sent for a request that makes no sense
+        if (index >= block.transactions_size())
+            return;
+        response.transactions.push_back(block.transaction(index));
+    }
+    network_component_->send(chandle, response);
+}
+
 } // libbitcoin
 
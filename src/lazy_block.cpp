@@ -0,0 +1,213 @@
+#include <bitcoin/lazy_block.hpp>
+
+#include <bitcoin/block.hpp>
+#include <bitcoin/dialect.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/metrics.hpp>
+#include <bitcoin/util/trace.hpp>
+#include <bitcoin/util/serializer.hpp>
+
+namespace libbitcoin {
+
+constexpr size_t block_header_size = 80;
+// Previous output hash and index
+constexpr size_t outpoint_size = 32 + 4;
+
+// The walkers below check every length against the payload before
+// reading, so a truncated or lying payload fails instead of asserting.
+
+static bool skip(deserializer& deserial, const data_chunk& raw,
+        uint64_t n_bytes)
+{
+    if (raw.size() - deserial.position() < n_bytes)
+        return false;
+    deserial.read_view(n_bytes);
+    return true;
+}
+
+bool read_count(deserializer& deserial, const data_chunk& raw,
+        uint64_t& count)
+{
+    const size_t position = deserial.position();
+    if (position == raw.size())
+        return false;
+    const uint8_t prefix = raw[position];
+    const size_t width = prefix == 0xff ? 9 :
+        prefix == 0xfe ? 5 : prefix == 0xfd ? 3 : 1;
+    if (raw.size() - position < width)
+        return false;
+    count = deserial.read_var_uint();
+    return true;
+}
+
+static bool skip_script(deserializer& deserial, const data_chunk& raw)
+{
+    uint64_t script_length;
+    return read_count(deserial, raw, script_length) &&
+        skip(deserial, raw, script_length);
+}
+
+static bool skip_input(deserializer& deserial, const data_chunk& raw)
+{
+    return skip(deserial, raw, outpoint_size) &&
+        skip_script(deserial, raw) && skip(deserial, raw, 4);
+}
+
+static bool skip_output(deserializer& deserial, const data_chunk& raw)
+{
+    return skip(deserial, raw, 8) && skip_script(deserial, raw);
+}
+
+bool skip_transaction(deserializer& deserial, const data_chunk& raw)
+{
+    uint64_t count;
+    if (!skip(deserial, raw, 4) || !read_count(deserial, raw, count))
+        return false;
+    for (uint64_t i = 0; i < count; ++i)
+        if (!skip_input(deserial, raw))
+            return false;
+    if (!read_count(deserial, raw, count))
+        return false;
+    for (uint64_t i = 0; i < count; ++i)
+        if (!skip_output(deserial, raw))
+            return false;
+    return skip(deserial, raw, 4);
+}
+
+bool is_whole_transaction(const data_chunk& raw)
+{
+    deserializer deserial(raw);
+    return skip_transaction(deserial, raw) && deserial.position() == raw.size();
+}
+
+lazy_block::lazy_block(data_chunk&& raw)
+  : raw_(std::make_shared<const data_chunk>(std::move(raw))), valid_(false)
+{
+    split();
+}
+
+lazy_block::lazy_block(data_chunk_ptr raw)
+  : raw_(raw), valid_(false)
+{
+    split();
+}
+
+void lazy_block::split()
+{
+    if (raw_->size() < block_header_size)
+        return;
+    deserializer deserial(*raw_);
+    header_ = read_block_header(deserial);
+    uint64_t txn_count;
+    // Every transaction takes at least one byte
+    if (!read_count(deserial, *raw_, txn_count) ||
+            txn_count > raw_->size() - deserial.position())
+        return;
+    offsets_.reserve(txn_count + 1);
+    for (uint64_t txn_i = 0; txn_i < txn_count; ++txn_i)
+    {
+        offsets_.push_back(deserial.position());
+        if (!skip_transaction(deserial, *raw_))
+            return;
+    }
+    offsets_.push_back(deserial.position());
+    valid_ = deserial.position() == raw_->size();
+}
+
+bool lazy_block::valid() const
+{
+    return valid_;
+}
+
+const message::block& lazy_block::header() const
+{
+    return header_;
+}
+
+hash_digest lazy_block::hash() const
+{
+    return hash_block_header(header_);
+}
+
+const data_chunk& lazy_block::raw() const
+{
+    return *raw_;
+}
+
+data_chunk_ptr lazy_block::shared_raw() const
+{
+    return raw_;
+}
+
+size_t lazy_block::transactions_size() const
+{
+    return valid_ ? offsets_.size() - 1 : 0;
+}
+
+data_view lazy_block::transaction_data(size_t index) const
+{
+    BITCOIN_ASSERT(index < transactions_size());
+    return data_view(raw_->data() + offsets_[index],
+        raw_->data() + offsets_[index + 1]);
+}
+
+message::transaction lazy_block::transaction(size_t index) const
+{
+    BITCOIN_ASSERT(index < transactions_size());
+    deserializer deserial(*raw_, offsets_[index]);
+    return read_transaction(deserial);
+}
+
+script lazy_block::input_script(size_t index, size_t input_index) const
+{
+    BITCOIN_ASSERT(index < transactions_size());
+    deserializer deserial(*raw_, offsets_[index]);
+    uint64_t count;
+    // Already walked once in the constructor, so these cannot fail
+    skip(deserial, *raw_, 4);
+    read_count(deserial, *raw_, count);
+    if (input_index >= count)
+        return script();
+    for (size_t i = 0; i < input_index; ++i)
+        skip_input(deserial, *raw_);
+    skip(deserial, *raw_, outpoint_size);
+    uint64_t script_length = deserial.read_var_uint();
+    return parse_script(deserial.read_view(script_length));
+}
+
+script lazy_block::output_script(size_t index, size_t output_index) const
+{
+    BITCOIN_ASSERT(index < transactions_size());
+    deserializer deserial(*raw_, offsets_[index]);
+    uint64_t count;
+    skip(deserial, *raw_, 4);
+    read_count(deserial, *raw_, count);
+    for (uint64_t i = 0; i < count; ++i)
+        skip_input(deserial, *raw_);
+    read_count(deserial, *raw_, count);
+    if (output_index >= count)
+        return script();
+    for (size_t i = 0; i < output_index; ++i)
+        skip_output(deserial, *raw_);
+    skip(deserial, *raw_, 8);
+    uint64_t script_length = deserial.read_var_uint();
+    return parse_script(deserial.read_view(script_length));
+}
+
+message::block lazy_block::decode() const
+{
+    static latency_histogram& decode_time =
+        shared_metrics().get_histogram("dialect.decode_block");
+    scoped_timer timer(decode_time);
+    trace_span span("dialect.decode_block", hash());
+    message::block result = header_;
+    result.raw_payload = raw_;
+    const size_t count = transactions_size();
+    result.transactions.reserve(count);
+    for (size_t txn_i = 0; txn_i < count; ++txn_i)
+        result.transactions.push_back(transaction(txn_i));
+    return result;
+}
+
+} // libbitcoin
+
@@ -0,0 +1,243 @@
+#include <bitcoin/network/address_book.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <bitcoin/util/mapped_file.hpp>
+#include <bitcoin/util/serializer.hpp>
+#include <bitcoin/util/sha256.hpp>
+
+namespace libbitcoin {
+
+using boost::posix_time::seconds;
+using boost::posix_time::time_duration;
+
+constexpr uint8_t address_book::max_failures;
+
+// Doubled for every failure after the first
+const time_duration first_retry_delay = seconds(30);
+const time_duration max_retry_delay = seconds(3600);
+// A peer that hung up is worth trying again before long
+const time_duration reconnect_delay = seconds(60);
+// Candidates looked at to find a free one, or one to evict
+constexpr size_t select_attempts = 32;
+constexpr size_t evict_candidates = 8;
+
+size_t address_book::key_hasher::operator()(const address_key& key) const
+{
+    // IPv4 addresses only differ in their last bytes
+    uint64_t head, tail;
+    std::memcpy(&head, key.data() + 2, sizeof(head));
+    std::memcpy(&tail, key.data() + 10, sizeof(tail));
+    return head ^ (tail * 0x9e3779b97f4a7c15);
+}
+
+address_book::address_key address_book::key_of(
+    const message::net_addr& addr)
+{
+    address_key key;
+    std::copy(addr.ip_addr.begin(), addr.ip_addr.end(), key.begin());
+    key[16] = addr.port >> 8;
+    key[17] = addr.port & 0xff;
+    return key;
+}
+
+address_book::address_book(size_t max_addresses)
+  : max_addresses_(std::max<size_t>(max_addresses, 1))
+{
+    std::random_device device;
+    random_.seed(device());
+}
+
+address_book::entry* address_book::find(const message::net_addr& addr)
+{
+    auto it = index_.find(key_of(addr));
+    if (it == index_.end())
+        return nullptr;
+    return &entries_[it->second];
+}
+
+void address_book::add(const message::net_addr& addr)
+{
+    const message::ip_address unset{{0}};
+    if (addr.port == 0 || addr.ip_addr == unset)
+        return;
+    entry* known = find(addr);
+    if (known)
+    {
+        known->addr.timestamp = std::max(known->addr.timestamp,
+            addr.timestamp);
+        known->addr.services |= addr.services;
+        return;
+    }
+    if (entries_.size() >= max_addresses_)
+        evict();
+    insert(entry{addr, 0, false, ptime(boost::posix_time::min_date_time)});
+}
+
+void address_book::insert(const entry& new_entry)
+{
+    index_[key_of(new_entry.addr)] = entries_.size();
+    entries_.push_back(new_entry);
+}
+
+void address_book::erase(size_t position)
+{
+    index_.erase(key_of(entries_[position].addr));
+    if (position + 1 != entries_.size())
+    {
+        entries_[position] = entries_.back();
+        index_[key_of(entries_[position].addr)] = position;
+    }
+    entries_.pop_back();
+}
+
+void address_book::evict()
+{
+    size_t oldest = entries_.size();
+    for (size_t i = 0; i < evict_candidates; ++i)
+    {
+        size_t position = random_() % entries_.size();
+        if (entries_[position].in_use)
+            continue;
+        if (oldest == entries_.size() || entries_[position].addr.timestamp <
+                entries_[oldest].addr.timestamp)
+            oldest = position;
+    }
+    if (oldest != entries_.size())
+        erase(oldest);
+}
+
+bool address_book::select(const ptime& now, message::net_addr& addr)
+{
+    if (entries_.empty())
+        return false;
+    for (size_t i = 0; i < select_attempts; ++i)
+    {
+        entry& candidate = entries_[random_() % entries_.size()];
+        if (candidate.in_use || now < candidate.retry_after)
+            continue;
+        candidate.in_use = true;
+        addr = candidate.addr;
+        return true;
+    }
+    return false;
+}
+
+void address_book::connected(const message::net_addr& addr)
+{
+    entry* known = find(addr);
+    if (known)
+        known->failures = 0;
+}
+
+void address_book::failed(const message::net_addr& addr, const ptime& now)
+{
+    auto it = index_.find(key_of(addr));
+    if (it == index_.end())
+        return;
+    entry& known = entries_[it->second];
+    if (++known.failures >= max_failures)
+    {
+        erase(it->second);
+        return;
+    }
+    time_duration delay = first_retry_delay;
+    for (uint8_t i = 1; i < known.failures && delay < max_retry_delay; ++i)
+        delay *= 2;
+    known.in_use = false;
+    known.retry_after = now + std::min(delay, max_retry_delay);
+}
+
+void address_book::disconnected(const message::net_addr& addr,
+    const ptime& now)
+{
+    entry* known = find(addr);
+    if (!known)
+        return;
+    known->in_use = false;
+    known->retry_after = now + reconnect_delay;
+}
+
+bool address_book::contains(const message::net_addr& addr) const
+{
+    return index_.count(key_of(addr)) > 0;
+}
+
+size_t address_book::size() const
+{
+    return entries_.size();
+}
+
+// Layout: magic, version, entry count, then each entry as timestamp,
+// services, address, port and failures, closed by a SHA-256 of the rest
+constexpr uint32_t book_magic = 0x4b424441;
+constexpr uint32_t book_version = 1;
+constexpr size_t book_header_size = 4 + 4 + 8;
+constexpr size_t book_entry_size = 4 + 8 + 16 + 2 + 1;
+
+bool address_book::save(const std::string& path) const
+{
+    serializer image;
+    image.reserve(book_header_size + entries_.size() * book_entry_size + 32);
+    image.write_4_bytes(book_magic);
+    image.write_4_bytes(book_version);
+    image.write_8_bytes(entries_.size());
+    for (const entry& current: entries_)
+    {
+        image.write_4_bytes(current.addr.timestamp);
+        image.write_net_addr(current.addr);
+        image.write_byte(current.failures);
+    }
+    data_chunk data = image.release_data();
+    hash_digest checksum = generate_sha256_hash(data);
+    data.insert(data.end(), checksum.begin(), checksum.end());
+    // Swapped in whole, like the header_index snapshot
+    const std::string temp_path = path + ".tmp";
+    std::ofstream file(temp_path.c_str(), std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    file.close();
+    if (!file)
+        return false;
+    return std::rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+bool address_book::load(const std::string& path)
+{
+    entries_.clear();
+    index_.clear();
+    mapped_file mapping(path);
+    if (mapping.size() < book_header_size + 32)
+        return false;
+    const byte* body_end = mapping.data() + mapping.size() - 32;
+    hash_digest checksum = generate_sha256_hash(
+        data_view(mapping.data(), body_end));
+    if (!std::equal(checksum.begin(), checksum.end(), body_end))
+        return false;
+    const data_chunk body(mapping.data(), body_end);
+    deserializer deserial(body);
+    if (deserial.read_4_bytes() != book_magic ||
+            deserial.read_4_bytes() != book_version)
+        return false;
+    const uint64_t count = deserial.read_8_bytes();
+    if (count * book_entry_size != body.size() - book_header_size)
+        return false;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        entry loaded;
+        const uint32_t timestamp = deserial.read_4_bytes();
+        loaded.addr = deserial.read_net_addr();
+        loaded.addr.timestamp = timestamp;
+        loaded.failures = deserial.read_byte();
+        loaded.in_use = false;
+        loaded.retry_after = ptime(boost::posix_time::min_date_time);
+        if (entries_.size() < max_addresses_ && !contains(loaded.addr))
+            insert(loaded);
+    }
+    return true;
+}
+
+} // libbitcoin
+
@@ -1,54 +1,93 @@
 #include "channel.hpp"
 
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
 #include <functional>
 #include <iterator>
 #include <ctime>
 
 #include <bitcoin/util/logger.hpp>
 #include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/metrics.hpp>
+#include <bitcoin/util/trace.hpp>
 #include <bitcoin/network/network.hpp>
 #include <bitcoin/dialect.hpp>
+#include <bitcoin/lazy_block.hpp>
 #include <bitcoin/messages.hpp>
 
-#include "shared_const_buffer.hpp"
-
 namespace libbitcoin {
 
+using message::command_type;
 using std::placeholders::_1;
 using std::placeholders::_2;
 using boost::posix_time::seconds;
 using boost::posix_time::minutes;
 using boost::posix_time::time_duration;
+using boost::posix_time::microsec_clock;
 using boost::asio::buffer;
 
 // Connection timeout time
 const time_duration disconnect_timeout = seconds(0) + minutes(90);
+// Weight of the newest sample in the smoothed latencies
+constexpr double latency_weight = 0.2;
+
+std::atomic<channel_handle> channel_pimpl::chan_id_counter(0);
 
-channel_handle channel_pimpl::chan_id_counter = 0;
+// Waiting to be written across every channel, for memory accounting
+static gauge& queued_bytes_total()
+{
+    static gauge& queued_bytes =
+        shared_metrics().get_gauge("network.queued_bytes");
+    return queued_bytes;
+}
 
 channel_pimpl::channel_pimpl(const init_data& dat)
- : socket_(dat.socket), network_(dat.parent_gateway),
-        translator_(dat.translator)
+ : socket_(dat.socket), strand_(*dat.service),
+        network_(dat.parent_gateway), translator_(dat.translator)
 {
     // Unique IDs are assigned to channels by incrementing a shared counter
     // among instances.
-    channel_id_ = chan_id_counter;
-    chan_id_counter++;
+    channel_id_ = chan_id_counter++;
+
+    metrics_.chandle = channel_id_;
+    metrics_.connected = microsec_clock::universal_time();
+    metrics_.bytes_received = 0;
+    metrics_.bytes_sent = 0;
+    metrics_.getdata_latency = -1;
+    metrics_.getblocks_latency = -1;
 
     timeout_.reset(new deadline_timer(*dat.service));
-    read_header();
-    reset_timeout();
+    queued_bytes_ = 0;
+    inbound_buffer_.resize(2 * inbound_chunk_size);
+    inbound_begin_ = inbound_end_ = 0;
+}
+
+channel_pimpl::~channel_pimpl()
+{
+    queued_bytes_total().add(-static_cast<int64_t>(queued_bytes_));
+}
 
+void channel_pimpl::start()
+{
+    strand_.dispatch(std::bind(&channel_pimpl::read_some,
+            shared_from_this()));
+    strand_.dispatch(std::bind(&channel_pimpl::reset_timeout,
+            shared_from_this()));
     send(create_version_message());
 }
 
-channel_pimpl::~channel_pimpl()
+void channel_pimpl::stop()
+{
+    strand_.post(std::bind(&channel_pimpl::do_stop, shared_from_this()));
+}
+
+void channel_pimpl::do_stop()
 {
-    tcp::endpoint remote_endpoint = socket_->remote_endpoint();
-    log_debug() << "Closing channel "
-            << remote_endpoint.address().to_string();
     boost::system::error_code ec;
+    tcp::endpoint remote_endpoint = socket_->remote_endpoint(ec);
+    if (!ec)
+        log_debug() << "Closing channel "
+                << remote_endpoint.address().to_string();
     socket_->shutdown(tcp::socket::shutdown_both, ec);
     socket_->close(ec);
     timeout_->cancel();
@@ -67,8 +106,8 @@ void channel_pimpl::reset_timeout()
 {
     timeout_->cancel();
     timeout_->expires_from_now(disconnect_timeout);
-    timeout_->async_wait(std::bind(
-            &channel_pimpl::handle_timeout, this, _1));
+    timeout_->async_wait(strand_.wrap(std::bind(
+            &channel_pimpl::handle_timeout, shared_from_this(), _1)));
 }
 
 void channel_pimpl::destroy_self()
@@ -91,175 +130,456 @@ bool channel_pimpl::problems_check(const boost::system::error_code& ec)
     return false;
 }
 
-void channel_pimpl::read_header()
+void channel_pimpl::read_some()
 {
-    auto callback = std::bind(
-            &channel_pimpl::handle_read_header, this, _1, _2);
-    async_read(*socket_, buffer(inbound_header_), callback);
+    if (inbound_begin_ == inbound_end_)
+        inbound_begin_ = inbound_end_ = 0;
+    else if (inbound_buffer_.size() - inbound_end_ < inbound_chunk_size)
+    {
+        // Keep the unparsed tail but move it to the front
+        std::copy(inbound_buffer_.begin() + inbound_begin_,
+            inbound_buffer_.begin() + inbound_end_, inbound_buffer_.begin());
+        inbound_end_ -= inbound_begin_;
+        inbound_begin_ = 0;
+    }
+    auto callback = strand_.wrap(std::bind(
+            &channel_pimpl::handle_read_some, shared_from_this(), _1, _2));
+    socket_->async_read_some(buffer(&inbound_buffer_[inbound_end_],
+            inbound_buffer_.size() - inbound_end_), callback);
 }
 
-void channel_pimpl::read_checksum(const message::header& header_msg)
+void channel_pimpl::handle_read_some(const boost::system::error_code& ec,
+        size_t bytes_transferred)
 {
-    auto callback = std::bind(&channel_pimpl::handle_read_checksum, 
-            this, header_msg, _1, _2);
-    async_read(*socket_, buffer(inbound_checksum_), callback);
+    if (problems_check(ec))
+        return;
+    inbound_end_ += bytes_transferred;
+    reset_timeout();
+    if (parse_inbound())
+        read_some();
 }
 
-void channel_pimpl::read_payload(const message::header& header_msg)
+bool channel_pimpl::parse_inbound()
 {
-    auto callback = std::bind(&channel_pimpl::handle_read_payload, 
-            this, header_msg, _1, _2);
-    inbound_payload_.resize(header_msg.payload_length);
-    async_read(*socket_, buffer(inbound_payload_, header_msg.payload_length),
-            callback);
+    // As many whole messages as arrived with this read
+    while (inbound_end_ - inbound_begin_ >= header_chunk_size)
+    {
+        auto begin = inbound_buffer_.begin() + inbound_begin_;
+        message::header header_msg = translator_->header_from_network(
+                data_chunk(begin, begin + header_chunk_size));
+        if (!translator_->verify_header(header_msg) ||
+                header_msg.payload_length > max_payload_size)
+        {
+            log_debug() << "Bad header received.";
+            destroy_self();
+            return false;
+        }
+        size_t header_size = header_chunk_size;
+        if (translator_->checksum_used(header_msg))
+            header_size += header_checksum_size;
+        if (inbound_end_ - inbound_begin_ < header_size)
+            return true;
+        if (header_size > header_chunk_size)
+            header_msg.checksum = translator_->checksum_from_network(
+                    data_chunk(begin + header_chunk_size, begin + header_size));
+        log_info() << "r: " << command_name(header_msg.command)
+                << " (" << header_msg.payload_length << " bytes)";
+        inbound_begin_ += header_size;
+
+        data_chunk payload = acquire_payload();
+        payload.resize(header_msg.payload_length);
+        size_t available = std::min<size_t>(
+                inbound_end_ - inbound_begin_, payload.size());
+        begin = inbound_buffer_.begin() + inbound_begin_;
+        std::copy(begin, begin + available, payload.begin());
+        inbound_begin_ += available;
+        if (available < payload.size())
+        {
+            // The buffer is drained. Read the rest straight into place.
+            read_payload(header_msg, std::move(payload), available);
+            return false;
+        }
+        if (!process_payload(header_msg, payload))
+            return false;
+        release_payload(std::move(payload));
+    }
+    return true;
 }
 
-void channel_pimpl::handle_read_header(const boost::system::error_code& ec,
-        size_t bytes_transferred)
+void channel_pimpl::read_payload(const message::header& header_msg,
+        data_chunk&& payload, size_t filled)
+{
+    inbound_payload_ = std::move(payload);
+    auto callback = strand_.wrap(std::bind(
+            &channel_pimpl::handle_read_payload, shared_from_this(),
+                header_msg, _1, _2));
+    async_read(*socket_, buffer(&inbound_payload_[filled],
+            inbound_payload_.size() - filled), callback);
+}
+
+void channel_pimpl::handle_read_payload(const message::header& header_msg,
+        const boost::system::error_code& ec, size_t)
 {
     if (problems_check(ec))
         return;
-    BITCOIN_ASSERT(bytes_transferred == header_chunk_size);
-    data_chunk header_stream =
-            data_chunk(inbound_header_.begin(), inbound_header_.end());
-    BITCOIN_ASSERT(header_stream.size() == header_chunk_size);
-    message::header header_msg =
-            translator_->header_from_network(header_stream);
-
-    if (!translator_->verify_header(header_msg))
-    {
-        log_debug() << "Bad header received.";
-        destroy_self();
+    reset_timeout();
+    if (!process_payload(header_msg, inbound_payload_))
         return;
-    }
+    release_payload(std::move(inbound_payload_));
+    read_some();
+}
 
-    log_info() << "r: " << header_msg.command
-            << " (" << header_msg.payload_length << " bytes)";
-    if (translator_->checksum_used(header_msg))
-    {
-        // Read checksum
-        read_checksum(header_msg);
-    }
-    else
-    {
-        // Read payload
-        read_payload(header_msg);
-    }
-    reset_timeout();
+data_chunk channel_pimpl::acquire_payload()
+{
+    if (payload_pool_.empty())
+        return data_chunk();
+    data_chunk payload = std::move(payload_pool_.back());
+    payload_pool_.pop_back();
+    return payload;
 }
 
-void channel_pimpl::handle_read_checksum(message::header& header_msg,
-        const boost::system::error_code& ec, size_t bytes_transferred)
+void channel_pimpl::release_payload(data_chunk&& payload)
 {
-    if (problems_check(ec))
+    // Oversized buffers are not worth holding on to, nor ones a block
+    // has taken away
+    if (payload_pool_.size() >= payload_pool_size ||
+            payload.capacity() > max_pooled_payload ||
+            payload.capacity() == 0)
+    {
+        data_chunk().swap(payload);
         return;
-    BITCOIN_ASSERT(bytes_transferred == header_checksum_size);
-    data_chunk checksum_stream = data_chunk(
-            inbound_checksum_.begin(), inbound_checksum_.end());
-    BITCOIN_ASSERT(checksum_stream.size() == header_checksum_size);
-    //header_msg.checksum = cast_stream<uint32_t>(checksum_stream);
-    header_msg.checksum = translator_->checksum_from_network(checksum_stream);
-    read_payload(header_msg);
-    reset_timeout();
+    }
+    payload.clear();
+    payload_pool_.push_back(std::move(payload));
 }
 
-void channel_pimpl::handle_read_payload(const message::header& header_msg,
-        const boost::system::error_code& ec, size_t bytes_transferred)
+bool channel_pimpl::process_payload(const message::header& header_msg,
+        data_chunk& payload_stream)
 {
-    if (problems_check(ec))
-        return;
-    BITCOIN_ASSERT(bytes_transferred == header_msg.payload_length);
-    data_chunk payload_stream = data_chunk(
-            inbound_payload_.begin(), inbound_payload_.end());
-    BITCOIN_ASSERT(payload_stream.size() == header_msg.payload_length);
+    // The dialect may borrow views into the payload while parsing. It
+    // goes back to the pool only once this returns, unless a block
+    // took it over.
+    static latency_histogram& process_time =
+        shared_metrics().get_histogram("network.process_payload");
+    scoped_timer timer(process_time);
     if (!translator_->verify_checksum(header_msg, payload_stream))
     {
         log_warning() << "Bad checksum!";
         destroy_self();
-        return;
+        return false;
     }
+    record_received(header_msg);
     bool ret_errc = false;
-    if (header_msg.command == "version")
-    {
-        message::version payload =
-                translator_->version_from_network(
-                    header_msg, payload_stream, ret_errc);
-        if (!transport_payload(payload, ret_errc))
-            return;
-    }
-    else if (header_msg.command == "verack")
-    {
-        message::verack payload;
-        if (!transport_payload(payload, ret_errc))
-            return;
-    }
-    else if (header_msg.command == "addr")
+    switch (header_msg.command)
     {
-        message::addr payload =
-                translator_->addr_from_network(
-                    header_msg, payload_stream, ret_errc);
-        if (!transport_payload(payload, ret_errc))
-            return;
+        case command_type::version:
+        {
+            message::version payload =
+                    translator_->version_from_network(
+                        header_msg, payload_stream, ret_errc);
+            return transport_payload(payload, ret_errc);
+        }
+        case command_type::verack:
+        {
+            message::verack payload;
+            return transport_payload(payload, ret_errc);
+        }
+        case command_type::addr:
+        {
+            message::addr payload =
+                    translator_->addr_from_network(
+                        header_msg, payload_stream, ret_errc);
+            return transport_payload(payload, ret_errc);
+        }
+        case command_type::inv:
+        {
+            record_reply(getblocks_requests_, metrics_.getblocks_latency);
+            message::inv payload =
+                    translator_->inv_from_network(
+                        header_msg, payload_stream, ret_errc);
+            return transport_payload(payload, ret_errc);
+        }
+        case command_type::getdata:
+        {
+            message::getdata payload =
+                    translator_->getdata_from_network(
+                        header_msg, payload_stream, ret_errc);
+            return transport_payload(payload, ret_errc);
+        }
+        case command_type::block:
+        {
+            record_reply(getdata_requests_, metrics_.getdata_latency);
+            trace_span span("channel.receive_block");
+            // Only the header is decoded here. The receiver decides
+            // whether the transactions are worth parsing.
+            lazy_block_ptr payload =
+                    std::make_shared<lazy_block>(std::move(payload_stream));
+            span.set_block(payload->hash());
+            return transport_payload(payload, !payload->valid());
+        }
+        case command_type::tx:
+        {
+            message::transaction payload =
+                    translator_->transaction_from_network(
+                        header_msg, payload_stream, ret_errc);
+            return transport_payload(payload, ret_errc);
+        }
+        case command_type::headers:
+        {
+            message::headers payload =
+                    translator_->headers_from_network(
+                        header_msg, payload_stream, ret_errc);
+            return transport_payload(payload, ret_errc);
+        }
+        case command_type::sendcmpct:
+        {
+            message::send_compact payload =
+                    translator_->send_compact_from_network(
+                        header_msg, payload_stream, ret_errc);
+            return transport_payload(payload, ret_errc);
+        }
+        case command_type::cmpctblock:
+        {
+            record_reply(getdata_requests_, metrics_.getdata_latency);
+            message::compact_block payload =
+                    translator_->compact_block_from_network(
+                        header_msg, payload_stream, ret_errc);
+            return transport_payload(payload, ret_errc);
+        }
+        case command_type::getblocktxn:
+        {
+            message::get_block_transactions payload =
+                    translator_->get_block_transactions_from_network(
+                        header_msg, payload_stream, ret_errc);
+            return transport_payload(payload, ret_errc);
+        }
+        case command_type::blocktxn:
+        {
+            message::block_transactions payload =
+                    translator_->block_transactions_from_network(
+                        header_msg, payload_stream, ret_errc);
+            return transport_payload(payload, ret_errc);
+        }
+        default:
+            // Nothing handles the rest yet
+            return true;
     }
-    else if (header_msg.command == "inv")
-    {
-        message::inv payload =
-                translator_->inv_from_network(
-                    header_msg, payload_stream, ret_errc);
-        if (!transport_payload(payload, ret_errc))
-            return;
-    }
-    else if (header_msg.command == "block")
+}
+
+void channel_pimpl::write_pending()
+{
+    // Everything queued since the last write goes out in one gather
+    writing_.swap(pending_);
+    std::vector<boost::asio::const_buffer> buffers;
+    for (const outbound_message& msg: writing_)
     {
-        message::block payload =
-                translator_->block_from_network(
-                    header_msg, payload_stream, ret_errc);
-        if (!transport_payload(payload, ret_errc))
-            return;
+        buffers.push_back(buffer(msg.head));
+        if (msg.body)
+            buffers.push_back(buffer(*msg.body));
     }
-    read_header();
-    reset_timeout();
+    async_write(*socket_, buffers, strand_.wrap(std::bind(
+            &channel_pimpl::handle_send, shared_from_this(), _1)));
 }
 
 void channel_pimpl::handle_send(const boost::system::error_code& ec)
 {
     if (problems_check(ec))
         return;
+    size_t written = 0;
+    for (const outbound_message& msg: writing_)
+        written += msg.size();
+    queued_bytes_ -= written;
+    queued_bytes_total().add(-static_cast<int64_t>(written));
+    writing_.clear();
+    if (!pending_.empty())
+        write_pending();
+}
+
+void channel_pimpl::record_received(const message::header& header_msg)
+{
+    static counter& messages_received =
+        shared_metrics().get_counter("network.messages_received");
+    static counter& bytes_received =
+        shared_metrics().get_counter("network.bytes_received");
+    size_t size = header_chunk_size + header_msg.payload_length;
+    if (translator_->checksum_used(header_msg))
+        size += header_checksum_size;
+    messages_received.add();
+    bytes_received.add(size);
+    std::lock_guard<std::mutex> lock(metrics_mutex_);
+    metrics_.bytes_received += size;
+    ++metrics_.messages_received[header_msg.command];
+}
+
+void channel_pimpl::record_sent(const outbound_message& msg)
+{
+    // The command follows the 4 byte magic
+    BITCOIN_ASSERT(msg.head.size() >= 16);
+    command_type command = decode_command(&msg.head[4]);
+    static counter& messages_sent =
+        shared_metrics().get_counter("network.messages_sent");
+    static counter& bytes_sent =
+        shared_metrics().get_counter("network.bytes_sent");
+    messages_sent.add();
+    bytes_sent.add(msg.size());
+    std::lock_guard<std::mutex> lock(metrics_mutex_);
+    metrics_.bytes_sent += msg.size();
+    ++metrics_.messages_sent[command];
+}
+
+void channel_pimpl::record_reply(std::deque<ptime>& requests, double& latency)
+{
+    if (requests.empty())
+        return;
+    ptime now = microsec_clock::universal_time();
+    double sample = (now - requests.front()).total_microseconds() / 1000000.0;
+    std::lock_guard<std::mutex> lock(metrics_mutex_);
+    latency = latency < 0 ? sample :
+        (1 - latency_weight) * latency + latency_weight * sample;
+    requests.pop_front();
+    update_oldest_request();
+}
+
+void channel_pimpl::update_oldest_request()
+{
+    // Callers hold metrics_mutex_
+    metrics_.oldest_request = boost::posix_time::not_a_date_time;
+    if (!getdata_requests_.empty())
+        metrics_.oldest_request = getdata_requests_.front();
+    if (!getblocks_requests_.empty() &&
+            (metrics_.oldest_request.is_not_a_date_time() ||
+                getblocks_requests_.front() < metrics_.oldest_request))
+        metrics_.oldest_request = getblocks_requests_.front();
+}
+
+void channel_pimpl::track_request(const message::getdata& getdata)
+{
+    ptime now = microsec_clock::universal_time();
+    for (const message::inv_vect& inv: getdata.invs)
+        if (inv.type == message::inv_type::block ||
+                inv.type == message::inv_type::compact_block)
+            getdata_requests_.push_back(now);
+    std::lock_guard<std::mutex> lock(metrics_mutex_);
+    update_oldest_request();
+}
+
+void channel_pimpl::track_request(const message::getblocks&)
+{
+    getblocks_requests_.push_back(microsec_clock::universal_time());
+    std::lock_guard<std::mutex> lock(metrics_mutex_);
+    update_oldest_request();
+}
+
+template<typename T>
+void channel_pimpl::post_send(const T& packet)
+{
+    strand_.post(std::bind(
+            &channel_pimpl::do_send<T>, shared_from_this(), packet));
 }
 
 template<typename T>
-void generic_send(const T& message_packet, channel_pimpl* chan_self,
-        socket_ptr socket, dialect_ptr translator)
+void channel_pimpl::do_send(const T& packet)
+{
+    // Moved, so the serialized message is never copied again
+    outbound_message msg{translator_->to_network(packet), data_chunk_ptr()};
+    if (!queue_message(std::move(msg)))
+    {
+        network_->kernel()->send_failed(channel_id_, packet);
+        return;
+    }
+    track_request(packet);
+}
+
+void channel_pimpl::do_send_raw(command_type command, data_chunk_ptr payload)
+{
+    outbound_message msg{
+        translator_->header_to_network(command, *payload), payload};
+    if (!queue_message(std::move(msg)))
+        network_->kernel()->send_failed(channel_id_, command, payload);
+}
+
+bool channel_pimpl::queue_message(outbound_message&& msg)
 {
-    data_chunk msg = translator->to_network(message_packet);
-    shared_const_buffer buffer(msg);
-    async_write(*socket, buffer, std::bind(
-            &channel_pimpl::handle_send, chan_self, std::placeholders::_1));
+    // A peer not reading fast enough gets its messages refused rather
+    // than queued without bound
+    if (queued_bytes_ + msg.size() > max_queued_bytes)
+    {
+        log_warning() << "Send queue full for channel " << channel_id_;
+        return false;
+    }
+    record_sent(msg);
+    queued_bytes_ += msg.size();
+    queued_bytes_total().add(msg.size());
+    pending_.push_back(std::move(msg));
+    if (writing_.empty())
+        write_pending();
+    return true;
 }
 
 void channel_pimpl::send(const message::version& version)
 {
-    generic_send(version, this, socket_, translator_);
+    post_send(version);
 }
 
 void channel_pimpl::send(const message::verack& verack)
 {
-    generic_send(verack, this, socket_, translator_);
+    post_send(verack);
 }
 
 void channel_pimpl::send(const message::getaddr& getaddr)
 {
-    generic_send(getaddr, this, socket_, translator_);
+    post_send(getaddr);
 }
 
 void channel_pimpl::send(const message::getdata& getdata)
 {
-    generic_send(getdata, this, socket_, translator_);
+    post_send(getdata);
+}
+
+void channel_pimpl::send(const message::inv& inv)
+{
+    post_send(inv);
+}
+
+void channel_pimpl::send(const message::addr& addr)
+{
+    post_send(addr);
 }
 
 void channel_pimpl::send(const message::getblocks& getblocks)
 {
-    generic_send(getblocks, this, socket_, translator_);
+    post_send(getblocks);
+}
+
+void channel_pimpl::send(const message::getheaders& getheaders)
+{
+    post_send(getheaders);
+}
+
+void channel_pimpl::send(const message::send_compact& send_compact)
+{
+    post_send(send_compact);
+}
+
+void channel_pimpl::send(const message::compact_block& compact)
+{
+    post_send(compact);
+}
+
+void channel_pimpl::send(const message::get_block_transactions& request)
+{
+    post_send(request);
+}
+
+void channel_pimpl::send(const message::block_transactions& response)
+{
+    post_send(response);
+}
+
+void channel_pimpl::send_raw(command_type command, data_chunk_ptr payload)
+{
+    strand_.post(std::bind(&channel_pimpl::do_send_raw,
+            shared_from_this(), command, payload));
 }
 
 channel_handle channel_pimpl::get_id() const
@@ -267,6 +587,12 @@ channel_handle channel_pimpl::get_id() const
     return channel_id_;
 }
 
+peer_metrics channel_pimpl::metrics() const
+{
+    std::lock_guard<std::mutex> lock(metrics_mutex_);
+    return metrics_;
+}
+
 message::version channel_pimpl::create_version_message()
 {
     message::version version;
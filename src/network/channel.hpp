@@ -2,15 +2,16 @@
 #define LIBBITCOIN_NET_CHANNEL_H
 
 #include <boost/asio.hpp>
-#include <boost/array.hpp>
 #include <boost/utility.hpp>
 #include <boost/asio/streambuf.hpp>
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <mutex>
 #include <deque>
 
 #include <bitcoin/network/network.hpp>
+#include <bitcoin/network/peer_metrics.hpp>
 #include <bitcoin/messages.hpp>
 #include <bitcoin/util/serializer.hpp>
 
@@ -19,8 +20,12 @@ namespace libbitcoin {
 class network;
 class dialect;
 
+// Everything a channel does runs on its own strand, so many peers can
+// be read and parsed at once on a multi-threaded io_service. Pending
+// handlers keep the channel alive until stop() has cancelled them.
 class channel_pimpl
-  : private boost::noncopyable
+  : private boost::noncopyable,
+    public std::enable_shared_from_this<channel_pimpl>
 {
 public:
     struct init_data
@@ -34,30 +39,74 @@ public:
     channel_pimpl(const init_data& dat);
     ~channel_pimpl();
 
+    // Starts reading and sends our version
+    void start();
+    // Closes the socket. Called once the network has forgotten us.
+    void stop();
+
     void send(const message::version& version);
     void send(const message::verack& verack);
     void send(const message::getaddr& getaddr);
     void send(const message::getdata& getdata);
+    void send(const message::inv& inv);
+    void send(const message::addr& addr);
     void send(const message::getblocks& getblocks);
+    void send(const message::getheaders& getheaders);
+    void send(const message::send_compact& send_compact);
+    void send(const message::compact_block& compact);
+    void send(const message::get_block_transactions& request);
+    void send(const message::block_transactions& response);
+    // The payload bytes are shared, never copied or serialized again
+    void send_raw(message::command_type command, data_chunk_ptr payload);
     channel_handle get_id() const;
+    // Safe to call from any thread
+    peer_metrics metrics() const;
 
 private:
-    static channel_handle chan_id_counter;
-    channel_handle channel_id_;
+    // A whole serialized message, or a header ahead of shared payload
+    // bytes that go out as they are
+    struct outbound_message
+    {
+        data_chunk head;
+        data_chunk_ptr body;
+
+        size_t size() const
+        {
+            return head.size() + (body ? body->size() : 0);
+        }
+    };
 
-    void read_header();
-    void read_checksum(const message::header& header_msg);
-    void read_payload(const message::header& header_msg);
+    static std::atomic<channel_handle> chan_id_counter;
+    channel_handle channel_id_;
 
-    void handle_read_header(const boost::system::error_code& ec,
+    template<typename T>
+    void post_send(const T& packet);
+    template<typename T>
+    void do_send(const T& packet);
+    void do_send_raw(message::command_type command, data_chunk_ptr payload);
+    // False if the queue is full
+    bool queue_message(outbound_message&& msg);
+    void do_stop();
+
+    void read_some();
+    void handle_read_some(const boost::system::error_code& ec,
             size_t bytes_transferred);
-    void handle_read_checksum(message::header& header_msg,
-            const boost::system::error_code& ec, size_t bytes_transferred);
+    // False once reading has been handed off or the channel is closing
+    bool parse_inbound();
+    // For payloads larger than what was buffered
+    void read_payload(const message::header& header_msg,
+            data_chunk&& payload, size_t filled);
     void handle_read_payload(const message::header& header_msg,
             const boost::system::error_code& ec, size_t bytes_transferred);
+    // False if the channel is closing. Blocks take the payload over.
+    bool process_payload(const message::header& header_msg,
+            data_chunk& payload_stream);
+
+    data_chunk acquire_payload();
+    void release_payload(data_chunk&& payload);
 
     template<typename P>
-    bool transport_payload(P payload, bool ret_errc)
+    bool transport_payload(const P& payload, bool ret_errc)
     {
         if (ret_errc ||
             !network_->kernel()->recv_message(channel_id_, payload))
@@ -68,8 +117,22 @@ private:
         return true;
     }
 
+    void write_pending();
     void handle_send(const boost::system::error_code& ec);
 
+    void record_received(const message::header& header_msg);
+    void record_sent(const outbound_message& msg);
+    // Remembers requests so their replies can be timed
+    void track_request(const message::getdata& getdata);
+    void track_request(const message::getblocks& getblocks);
+    template<typename T>
+    void track_request(const T&)
+    {
+    }
+    // Replies are matched to the oldest request they could answer
+    void record_reply(std::deque<ptime>& requests, double& latency);
+    void update_oldest_request();
+
     void handle_timeout(const boost::system::error_code& ec);
     void reset_timeout();
 
@@ -81,6 +144,7 @@ private:
     message::version create_version_message();
 
     socket_ptr socket_;
+    io_service::strand strand_;
     network_ptr network_;
     dialect_ptr translator_;
 
@@ -89,10 +153,32 @@ private:
     // Checksum size is 4 bytes
     static constexpr size_t header_checksum_size = 4;
 
-    boost::array<uint8_t, header_chunk_size> inbound_header_;
-    boost::array<uint8_t, header_checksum_size> inbound_checksum_;
-    std::vector<uint8_t> inbound_payload_;
+    // Larger claimed payloads drop the peer
+    static constexpr size_t max_payload_size = 32 * 1024 * 1024;
+    // Most bytes allowed waiting to be written to the peer
+    static constexpr size_t max_queued_bytes = 4 * 1024 * 1024;
+    // Each socket read asks for at least this much
+    static constexpr size_t inbound_chunk_size = 64 * 1024;
+    static constexpr size_t payload_pool_size = 4;
+    static constexpr size_t max_pooled_payload = 2 * 1024 * 1024;
+
+    // Raw bytes read but not yet parsed sit in [begin, end)
+    data_chunk inbound_buffer_;
+    size_t inbound_begin_, inbound_end_;
+    // Payload being read past the end of the buffer
+    data_chunk inbound_payload_;
+    // Recycled payload buffers, which keep their capacity
+    std::vector<data_chunk> payload_pool_;
     deadline_timer_ptr timeout_;
+
+    // Messages waiting for the write in progress, and that write's
+    std::vector<outbound_message> pending_, writing_;
+    size_t queued_bytes_;
+
+    mutable std::mutex metrics_mutex_;
+    peer_metrics metrics_;
+    // One entry per block asked for and per getblocks sent
+    std::deque<ptime> getdata_requests_, getblocks_requests_;
 };
 
 } // libbitcoin
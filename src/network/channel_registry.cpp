@@ -0,0 +1,72 @@
+#include <bitcoin/network/channel_registry.hpp>
+
+#include <boost/thread/locks.hpp>
+#include <cstdlib>
+
+namespace libbitcoin {
+
+typedef boost::shared_lock<boost::shared_mutex> read_lock;
+typedef boost::unique_lock<boost::shared_mutex> write_lock;
+
+bool channel_registry::add(channel_handle chandle, channel_ptr channel_obj)
+{
+    write_lock lock(mutex_);
+    if (!index_.insert(std::make_pair(chandle, channels_.size())).second)
+        return false;
+    channels_.push_back(channel_obj);
+    handles_.push_back(chandle);
+    return true;
+}
+
+channel_ptr channel_registry::find(channel_handle chandle) const
+{
+    read_lock lock(mutex_);
+    auto it = index_.find(chandle);
+    if (it == index_.end())
+        return channel_ptr();
+    return channels_[it->second];
+}
+
+channel_ptr channel_registry::remove(channel_handle chandle)
+{
+    write_lock lock(mutex_);
+    auto it = index_.find(chandle);
+    if (it == index_.end())
+        return channel_ptr();
+    const size_t position = it->second;
+    channel_ptr removed = channels_[position];
+    index_.erase(it);
+    const size_t last = channels_.size() - 1;
+    if (position != last)
+    {
+        channels_[position] = channels_[last];
+        handles_[position] = handles_[last];
+        index_[handles_[position]] = position;
+    }
+    channels_.pop_back();
+    handles_.pop_back();
+    return removed;
+}
+
+size_t channel_registry::size() const
+{
+    read_lock lock(mutex_);
+    return channels_.size();
+}
+
+channel_ptr channel_registry::random() const
+{
+    read_lock lock(mutex_);
+    if (channels_.empty())
+        return channel_ptr();
+    return channels_[rand() % channels_.size()];
+}
+
+channel_list channel_registry::all() const
+{
+    read_lock lock(mutex_);
+    return channels_;
+}
+
+} // libbitcoin
+
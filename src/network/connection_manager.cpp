@@ -0,0 +1,183 @@
+#include <bitcoin/network/connection_manager.hpp>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <set>
+
+#include <bitcoin/util/logger.hpp>
+
+namespace libbitcoin {
+
+using std::placeholders::_1;
+using std::placeholders::_2;
+using boost::posix_time::microsec_clock;
+using boost::posix_time::seconds;
+using boost::posix_time::time_duration;
+
+const time_duration slot_check_interval = seconds(5);
+// About every quarter of an hour
+constexpr size_t ticks_between_saves = 180;
+const time_duration seed_retry_delay = seconds(30);
+
+connection_manager::connection_manager(network_ptr net,
+    const std::string& book_path, size_t outbound_slots,
+    thread_pool_ptr executor)
+  : threaded_service(executor), network_(net), book_path_(book_path), outbound_slots_(outbound_slots),
+    next_seed_(0), next_seed_attempt_(boost::posix_time::min_date_time),
+    ticks_(0), stopped_(false), pending_(0)
+{
+}
+
+// IPv4 addresses travel mapped into IPv6
+static std::string address_string(const message::ip_address& ip_addr)
+{
+    const message::ip_address mapped_prefix{
+        {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff}};
+    if (std::equal(ip_addr.begin(), ip_addr.begin() + 12,
+            mapped_prefix.begin()))
+        return boost::asio::ip::address_v4(boost::asio::ip::address_v4::
+            bytes_type{{ip_addr[12], ip_addr[13], ip_addr[14], ip_addr[15]}}
+                ).to_string();
+    boost::asio::ip::address_v6::bytes_type bytes;
+    std::copy(ip_addr.begin(), ip_addr.end(), bytes.begin());
+    return boost::asio::ip::address_v6(bytes).to_string();
+}
+
+void connection_manager::start()
+{
+    strand()->post(std::bind(
+        &connection_manager::do_start, shared_from_this()));
+}
+void connection_manager::do_start()
+{
+    if (book_.load(book_path_))
+        log_debug() << "Loaded " << book_.size() << " peer addresses";
+    timer_.reset(new deadline_timer(*service()));
+    reset_timer();
+    fill_slots();
+}
+
+void connection_manager::stop()
+{
+    strand()->post(std::bind(
+        &connection_manager::do_stop, shared_from_this()));
+}
+void connection_manager::do_stop()
+{
+    stopped_ = true;
+    if (timer_)
+        timer_->cancel();
+    if (!book_.save(book_path_))
+        log_error() << "Could not save peer addresses to " << book_path_;
+}
+
+void connection_manager::add_seed(const std::string& hostname,
+    unsigned short port)
+{
+    strand()->post(std::bind(&connection_manager::do_add_seed,
+        shared_from_this(), seed(hostname, port)));
+}
+void connection_manager::do_add_seed(const seed& new_seed)
+{
+    seeds_.push_back(new_seed);
+    fill_slots();
+}
+
+void connection_manager::add_addresses(const address_list& addresses)
+{
+    strand()->post(std::bind(&connection_manager::do_add_addresses,
+        shared_from_this(), addresses));
+}
+void connection_manager::do_add_addresses(const address_list& addresses)
+{
+    for (const message::net_addr& addr: addresses)
+        book_.add(addr);
+    fill_slots();
+}
+
+void connection_manager::reset_timer()
+{
+    timer_->expires_from_now(slot_check_interval);
+    timer_->async_wait(strand()->wrap(std::bind(
+        &connection_manager::check_slots, shared_from_this(), _1)));
+}
+
+void connection_manager::check_slots(const boost::system::error_code& ec)
+{
+    if (ec || stopped_)
+        return;
+    if (++ticks_ % ticks_between_saves == 0 && !book_.save(book_path_))
+        log_error() << "Could not save peer addresses to " << book_path_;
+    network_->fetch_metrics(strand()->wrap(std::bind(
+        &connection_manager::handle_metrics, shared_from_this(), _1)));
+    reset_timer();
+}
+
+void connection_manager::handle_metrics(const network::metrics_list& metrics)
+{
+    std::set<channel_handle> connected;
+    for (const peer_metrics& peer: metrics)
+        connected.insert(peer.chandle);
+    // Whoever went away frees their slot
+    const ptime now = microsec_clock::universal_time();
+    for (auto it = outbound_.begin(); it != outbound_.end(); )
+        if (connected.count(it->first) == 0)
+        {
+            if (it->second.from_book)
+                book_.disconnected(it->second.addr, now);
+            it = outbound_.erase(it);
+        }
+        else
+            ++it;
+    fill_slots();
+}
+
+void connection_manager::fill_slots()
+{
+    if (stopped_)
+        return;
+    const ptime now = microsec_clock::universal_time();
+    while (pending_ + outbound_.size() < outbound_slots_)
+    {
+        message::net_addr addr;
+        if (book_.select(now, addr))
+        {
+            ++pending_;
+            network_->connect(address_string(addr.ip_addr), addr.port,
+                strand()->wrap(std::bind(&connection_manager::handle_connect,
+                    shared_from_this(), _1, _2, outbound{true, addr})));
+            continue;
+        }
+        // Nothing usable in the book, so one seed at a time
+        if (seeds_.empty() || now < next_seed_attempt_)
+            return;
+        const size_t index = next_seed_++ % seeds_.size();
+        next_seed_attempt_ = now + seed_retry_delay;
+        ++pending_;
+        network_->connect(seeds_[index].first, seeds_[index].second,
+            strand()->wrap(std::bind(&connection_manager::handle_connect,
+                shared_from_this(), _1, _2,
+                    outbound{false, message::net_addr()})));
+        return;
+    }
+}
+
+void connection_manager::handle_connect(const std::error_code& ec,
+    channel_handle chandle, const outbound& attempt)
+{
+    --pending_;
+    if (ec)
+    {
+        if (attempt.from_book)
+            book_.failed(attempt.addr, microsec_clock::universal_time());
+        fill_slots();
+        return;
+    }
+    if (attempt.from_book)
+        book_.connected(attempt.addr);
+    outbound_[chandle] = attempt;
+    // Their addr reply fills the book through the kernel
+    network_->send(chandle, message::getaddr());
+}
+
+} // libbitcoin
+
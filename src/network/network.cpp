@@ -1,5 +1,6 @@
 #include <bitcoin/network/network.hpp>
 
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/lexical_cast.hpp>
 #include <functional>
 #include <algorithm>
@@ -17,8 +18,19 @@ namespace libbitcoin {
 
 using boost::asio::socket_base;
 
-network_impl::network_impl(kernel_ptr kern)
- : kernel_(kern)
+network_impl::network_impl(kernel_ptr kern, size_t number_threads)
+ : threaded_service(number_threads), kernel_(kern)
+{
+    initialize();
+}
+
+network_impl::network_impl(kernel_ptr kern, thread_pool_ptr executor)
+ : threaded_service(executor), kernel_(kern)
+{
+    initialize();
+}
+
+void network_impl::initialize()
 {
     default_dialect_.reset(new original_dialect);
     our_ip_address_ = message::ip_address{
@@ -41,8 +53,9 @@ channel_handle network_impl::create_channel(socket_ptr socket)
     channel_pimpl::init_data init_data = {
             shared_from_this(), default_dialect_, service(), socket };
 
-    channel_pimpl* channel_obj = new channel_pimpl(init_data);
-    channels_.push_back(channel_obj);
+    channel_ptr channel_obj = std::make_shared<channel_pimpl>(init_data);
+    channels_.add(channel_obj->get_id(), channel_obj);
+    channel_obj->start();
     log_debug() << channels_.size() << " peers connected.";
     return channel_obj->get_id();
 }
@@ -67,81 +80,124 @@ void network_impl::connect(std::string ip_addr, unsigned short port,
     tcp::resolver resolver(*service());
     tcp::resolver::query query(ip_addr,
             boost::lexical_cast<std::string>(port));
-    tcp::endpoint endpoint = *resolver.resolve(query);
-    socket->async_connect(endpoint, std::bind(
+    boost::system::error_code resolve_ec;
+    tcp::resolver::iterator resolved = resolver.resolve(query, resolve_ec);
+    if (resolve_ec)
+    {
+        log_error() << "Resolving peer " << ip_addr << ": "
+                << resolve_ec.message();
+        // Never from inside the caller
+        service()->post(std::bind(
+                handle_connect, error::system_network_error, 0));
+        return;
+    }
+    tcp::endpoint endpoint = *resolved;
+    socket->async_connect(endpoint, strand()->wrap(std::bind(
             &network_impl::handle_connect, shared_from_this(), 
-                _1, socket, ip_addr, handle_connect));
+                _1, socket, ip_addr, handle_connect)));
 }
 
-static void remove_matching_channels(channel_list* channels,
-        channel_handle chandle)
-{
-    auto is_matching =
-            [chandle](channel_pimpl& channel_obj)
-            {
-                return channel_obj.get_id() == chandle;
-            };
-    channels->erase_if(is_matching);
-    log_debug() << channels->size() << " peers remaining.";
-}
 void network_impl::disconnect(channel_handle chandle)
 {
-    strand()->post(
-            std::bind(remove_matching_channels, &channels_, chandle));
+    channel_ptr channel_obj = channels_.remove(chandle);
+    if (!channel_obj)
+        return;
+    channel_obj->stop();
+    log_debug() << channels_.size() << " peers remaining.";
 }
 
+// The channel queues it on its own strand
 template<typename T>
-void perform_send(channel_list* channels, kernel_ptr kern,
-        channel_handle chandle, T message_packet)
-{
-    auto is_matching =
-            [chandle](const channel_pimpl& channel_obj)
-            {
-                return channel_obj.get_id() == chandle;
-            };
-    auto it = std::find_if(channels->begin(), channels->end(), is_matching);
-    if (it == channels->end())
+void generic_send(const T& message_packet, channel_handle chandle,
+        channel_registry& channels, kernel_ptr kern)
+{
+    channel_ptr channel_obj = channels.find(chandle);
+    if (!channel_obj)
     {
         log_error() << "Non existant channel " << chandle << " for send.";
         kern->send_failed(chandle, message_packet);
         return;
     }
-    it->send(message_packet);
-}
-
-template<typename T>
-void generic_send(T message_packet, channel_handle chandle,
-        strand_ptr strand, channel_list* channels,
-        kernel_ptr kernel)
-{
-    strand->post(std::bind(
-            &perform_send<T>, channels, kernel, chandle, message_packet));
+    channel_obj->send(message_packet);
 }
 
 void network_impl::send(channel_handle chandle, const message::version& version)
 {
-    generic_send(version, chandle, strand(), &channels_, kernel_);
+    generic_send(version, chandle, channels_, kernel_);
 }
 
 void network_impl::send(channel_handle chandle, const message::verack& verack)
 {
-    generic_send(verack, chandle, strand(), &channels_, kernel_);
+    generic_send(verack, chandle, channels_, kernel_);
 }
 
 void network_impl::send(channel_handle chandle, const message::getaddr& getaddr)
 {
-    generic_send(getaddr, chandle, strand(), &channels_, kernel_);
+    generic_send(getaddr, chandle, channels_, kernel_);
 }
 
 void network_impl::send(channel_handle chandle, const message::getdata& getdata)
 {
-    generic_send(getdata, chandle, strand(), &channels_, kernel_);
+    generic_send(getdata, chandle, channels_, kernel_);
+}
+
+void network_impl::send(channel_handle chandle, const message::inv& inv)
+{
+    generic_send(inv, chandle, channels_, kernel_);
+}
+
+void network_impl::send(channel_handle chandle, const message::addr& addr)
+{
+    generic_send(addr, chandle, channels_, kernel_);
 }
 
 void network_impl::send(channel_handle chandle, 
         const message::getblocks& getblocks)
 {
-    generic_send(getblocks, chandle, strand(), &channels_, kernel_);
+    generic_send(getblocks, chandle, channels_, kernel_);
+}
+
+void network_impl::send(channel_handle chandle, 
+        const message::getheaders& getheaders)
+{
+    generic_send(getheaders, chandle, channels_, kernel_);
+}
+
+void network_impl::send(channel_handle chandle,
+        const message::send_compact& send_compact)
+{
+    generic_send(send_compact, chandle, channels_, kernel_);
+}
+
+void network_impl::send(channel_handle chandle,
+        const message::compact_block& compact)
+{
+    generic_send(compact, chandle, channels_, kernel_);
+}
+
+void network_impl::send(channel_handle chandle,
+        const message::get_block_transactions& request)
+{
+    generic_send(request, chandle, channels_, kernel_);
+}
+
+void network_impl::send(channel_handle chandle,
+        const message::block_transactions& response)
+{
+    generic_send(response, chandle, channels_, kernel_);
+}
+
+void network_impl::send_raw(channel_handle chandle,
+        message::command_type command, data_chunk_ptr payload)
+{
+    channel_ptr channel_obj = channels_.find(chandle);
+    if (!channel_obj)
+    {
+        log_error() << "Non existant channel " << chandle << " for send.";
+        kernel_->send_failed(chandle, command, payload);
+        return;
+    }
+    channel_obj->send_raw(command, payload);
 }
 
 size_t network_impl::connection_count() const
@@ -151,9 +207,15 @@ size_t network_impl::connection_count() const
 
 void network_impl::do_get_random_handle(accept_random_handle accept_handler)
 {
-    size_t rand_index = rand() % channels_.size();
-    channel_handle rand_chan = channels_[rand_index].get_id();
-    accept_handler(rand_chan);
+    // The better scored of two random picks, which favours fast peers
+    // without ever starving the rest
+    channel_ptr first = channels_.random(), second = channels_.random();
+    if (!first)
+        return;
+    const ptime now = boost::posix_time::microsec_clock::universal_time();
+    if (peer_score(second->metrics(), now) > peer_score(first->metrics(), now))
+        first = second;
+    accept_handler(first->get_id());
 }
 void network_impl::get_random_handle(accept_random_handle accept_handler)
 {
@@ -162,20 +224,34 @@ void network_impl::get_random_handle(accept_random_handle accept_handler)
                 accept_handler));
 }
 
-bool network_impl::start_accept()
+void network_impl::do_fetch_metrics(fetch_metrics_handler handle_fetch)
+{
+    metrics_list metrics;
+    for (channel_ptr channel_obj: channels_.all())
+        metrics.push_back(channel_obj->metrics());
+    handle_fetch(metrics);
+}
+void network_impl::fetch_metrics(fetch_metrics_handler handle_fetch)
+{
+    strand()->post(std::bind(
+            &network_impl::do_fetch_metrics, shared_from_this(),
+                handle_fetch));
+}
+
+bool network_impl::start_accept(unsigned short port)
 {
     acceptor_.reset(new tcp::acceptor(*service()));
     socket_ptr socket(new tcp::socket(*service()));
     try
     {
-        tcp::endpoint endpoint(tcp::v4(), 8333);
+        tcp::endpoint endpoint(tcp::v4(), port);
         acceptor_->open(endpoint.protocol());
         acceptor_->set_option(tcp::acceptor::reuse_address(true));
         acceptor_->bind(endpoint);
         acceptor_->listen(socket_base::max_connections);
-        acceptor_->async_accept(*socket,
+        acceptor_->async_accept(*socket, strand()->wrap(
             std::bind(&network_impl::handle_accept, shared_from_this(), 
-                socket));
+                socket)));
     }
     catch (std::exception& ex)
     {
@@ -193,9 +269,9 @@ void network_impl::handle_accept(socket_ptr socket)
     channel_handle chanid = create_channel(socket);
     kernel_->handle_connect(chanid);
     socket.reset(new tcp::socket(*service()));
-    acceptor_->async_accept(*socket,
+    acceptor_->async_accept(*socket, strand()->wrap(
             std::bind(&network_impl::handle_accept, shared_from_this(), 
-                socket));
+                socket)));
 }
 
 void network_impl::set_ip_address(std::string ip_addr)
@@ -0,0 +1,33 @@
+#include <bitcoin/network/peer_metrics.hpp>
+
+#include <algorithm>
+
+namespace libbitcoin {
+
+using boost::posix_time::minutes;
+using boost::posix_time::time_duration;
+
+// Unanswered for this long and the peer is dropped
+const time_duration max_request_age = minutes(2);
+constexpr double max_latency = 60.0;
+
+double peer_score(const peer_metrics& metrics, const ptime& now)
+{
+    double connected_seconds = std::max(
+        (now - metrics.connected).total_milliseconds() / 1000.0, 1.0);
+    double throughput = metrics.bytes_received / connected_seconds;
+    double latency = std::max(
+        std::max(metrics.getdata_latency, metrics.getblocks_latency), 1.0);
+    return throughput / latency;
+}
+
+bool peer_too_slow(const peer_metrics& metrics, const ptime& now)
+{
+    if (!metrics.oldest_request.is_not_a_date_time() &&
+            now - metrics.oldest_request > max_request_age)
+        return true;
+    return metrics.getdata_latency > max_latency;
+}
+
+} // libbitcoin
+
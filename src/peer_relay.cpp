@@ -0,0 +1,153 @@
+#include <bitcoin/peer_relay.hpp>
+
+#include <algorithm>
+#include <array>
+
+namespace libbitcoin {
+
+constexpr size_t peer_relay::max_inv_batch;
+constexpr size_t peer_relay::max_addr_batch;
+
+typedef std::array<uint8_t, 18> address_key;
+
+// Services and timestamp change as an address is passed around, so
+// only where it points is remembered
+static address_key key_of(const message::net_addr& addr)
+{
+    address_key key;
+    std::copy(addr.ip_addr.begin(), addr.ip_addr.end(), key.begin());
+    key[16] = addr.port >> 8;
+    key[17] = addr.port & 0xff;
+    return key;
+}
+
+peer_relay::peer_filters::peer_filters(size_t known_inventory,
+    size_t known_addresses)
+  : inventory(known_inventory), addresses(known_addresses)
+{
+}
+
+peer_relay::peer_relay(size_t known_inventory, size_t known_addresses,
+    size_t address_fanout)
+  : known_inventory_(known_inventory), known_addresses_(known_addresses),
+    address_fanout_(address_fanout)
+{
+    std::random_device device;
+    random_.seed(device());
+}
+
+void peer_relay::add_peer(channel_handle chandle)
+{
+    if (peers_.count(chandle) == 0)
+        peers_.insert(std::make_pair(chandle,
+            peer_filters(known_inventory_, known_addresses_)));
+}
+
+void peer_relay::remove_peer(channel_handle chandle)
+{
+    peers_.erase(chandle);
+}
+
+bool peer_relay::has_peer(channel_handle chandle) const
+{
+    return peers_.count(chandle) > 0;
+}
+
+size_t peer_relay::peer_count() const
+{
+    return peers_.size();
+}
+
+void peer_relay::mark_known(channel_handle chandle, const hash_digest& hash)
+{
+    auto it = peers_.find(chandle);
+    if (it != peers_.end())
+        it->second.inventory.insert(hash);
+}
+
+void peer_relay::mark_known(channel_handle chandle,
+    const message::net_addr& addr)
+{
+    auto it = peers_.find(chandle);
+    if (it == peers_.end())
+        return;
+    const address_key key = key_of(addr);
+    it->second.addresses.insert(key.data(), key.size());
+}
+
+bool peer_relay::knows(channel_handle chandle, const hash_digest& hash) const
+{
+    auto it = peers_.find(chandle);
+    return it != peers_.end() && it->second.inventory.contains(hash);
+}
+
+bool peer_relay::knows(channel_handle chandle,
+    const message::net_addr& addr) const
+{
+    auto it = peers_.find(chandle);
+    if (it == peers_.end())
+        return false;
+    const address_key key = key_of(addr);
+    return it->second.addresses.contains(key.data(), key.size());
+}
+
+void peer_relay::announce(const message::inv_vect& inv)
+{
+    pending_invs_.push_back(inv);
+}
+
+void peer_relay::announce(const message::net_addr& addr)
+{
+    // Beyond one message worth they are not worth keeping
+    if (pending_addrs_.size() < max_addr_batch)
+        pending_addrs_.push_back(addr);
+}
+
+void peer_relay::flush(inv_batch_list& invs, addr_batch_list& addrs)
+{
+    for (auto& peer: peers_)
+    {
+        message::inv batch;
+        for (const message::inv_vect& inv: pending_invs_)
+        {
+            if (peer.second.inventory.contains(inv.hash))
+                continue;
+            peer.second.inventory.insert(inv.hash);
+            batch.invs.push_back(inv);
+            if (batch.invs.size() == max_inv_batch)
+            {
+                invs.push_back(std::make_pair(peer.first, batch));
+                batch.invs.clear();
+            }
+        }
+        if (!batch.invs.empty())
+            invs.push_back(std::make_pair(peer.first, batch));
+    }
+    pending_invs_.clear();
+
+    std::map<channel_handle, message::addr> outgoing;
+    std::vector<peer_map::iterator> candidates;
+    for (const message::net_addr& addr: pending_addrs_)
+    {
+        const address_key key = key_of(addr);
+        candidates.clear();
+        for (auto it = peers_.begin(); it != peers_.end(); ++it)
+            if (!it->second.addresses.contains(key.data(), key.size()))
+                candidates.push_back(it);
+        // A random few of those that lack it
+        const size_t chosen = std::min(address_fanout_, candidates.size());
+        for (size_t i = 0; i < chosen; ++i)
+        {
+            std::swap(candidates[i], candidates[i +
+                random_() % (candidates.size() - i)]);
+            candidates[i]->second.addresses.insert(key.data(), key.size());
+            outgoing[candidates[i]->first].addr_list.push_back(addr);
+        }
+    }
+    pending_addrs_.clear();
+    for (const auto& batch: outgoing)
+        addrs.push_back(batch);
+}
+
+} // libbitcoin
+
@@ -1,5 +1,6 @@
 #include <bitcoin/script.hpp>
 
+#include <boost/thread/tss.hpp>
 #include <stack>
 
 #include <bitcoin/messages.hpp>
@@ -8,7 +9,9 @@
 #include <bitcoin/util/assert.hpp>
 #include <bitcoin/util/logger.hpp>
 #include <bitcoin/util/ripemd.hpp>
+#include <bitcoin/util/serializer.hpp>
 #include <bitcoin/util/sha256.hpp>
+#include <bitcoin/util/signature_cache.hpp>
 
 namespace libbitcoin {
 
@@ -20,7 +23,12 @@ void script::join(const script& other)
 
 void script::push_operation(operation oper)
 {
-    operations_.push_back(oper);
+    operations_.push_back(std::move(oper));
+}
+
+void script::reserve(size_t number_operations)
+{
+    operations_.reserve(number_operations);
 }
 
 const operation_stack& script::operations() const
@@ -28,13 +36,81 @@ const operation_stack& script::operations() const
     return operations_;
 }
 
-bool script::run(const message::transaction& parent_tx, uint32_t input_index)
+script_context::script_context()
+  : sighash_(nullptr)
+{
+}
+
+void script_context::clear()
 {
     stack_.clear();
-    for (const operation oper: operations_)
+    sighash_ = nullptr;
+}
+bool script_context::empty() const
+{
+    return stack_.empty();
+}
+size_t script_context::size() const
+{
+    return stack_.size();
+}
+
+void script_context::push(data_chunk data)
+{
+    stack_.push_back(std::move(data));
+}
+data_chunk script_context::pop()
+{
+    BITCOIN_ASSERT(!stack_.empty());
+    data_chunk value = std::move(stack_.back());
+    stack_.pop_back();
+    return value;
+}
+const data_chunk& script_context::top() const
+{
+    BITCOIN_ASSERT(!stack_.empty());
+    return stack_.back();
+}
+
+void script_context::set_sighash_template(
+    const signature_hash_template* sighash)
+{
+    sighash_ = sighash;
+}
+const signature_hash_template* script_context::sighash_template() const
+{
+    return sighash_;
+}
+
+script_context& thread_script_context()
+{
+    static boost::thread_specific_ptr<script_context> contexts;
+    if (contexts.get() == nullptr)
+        contexts.reset(new script_context);
+    return *contexts;
+}
+
+bool script::run(const message::transaction& parent_tx,
+    uint32_t input_index) const
+{
+    script_context& context = thread_script_context();
+    context.clear();
+    if (!evaluate(context, parent_tx, input_index))
+        return false;
+    if (!context.empty())
     {
-        log_debug() << "Run: " << opcode_to_string(oper.code);
-        if (!run_operation(oper, parent_tx, input_index))
+        log_error() << "Script left junk on top of the stack";
+        return false;
+    }
+    return true;
+}
+
+bool script::evaluate(script_context& context,
+    const message::transaction& parent_tx, uint32_t input_index) const
+{
+    for (const operation& oper: operations_)
+    {
+        if (!run_operation(oper, context, parent_tx, input_index))
             return false;
         if (oper.data.size() > 0)
         {
@@ -42,72 +118,47 @@ bool script::run(const message::transaction& parent_tx, uint32_t input_index)
                 oper.code == opcode::pushdata1 ||
                 oper.code == opcode::pushdata2 ||
                 oper.code == opcode::pushdata4);
-            stack_.push_back(oper.data);
+            context.push(oper.data);
         }
     }
-    if (stack_.size() != 0)
-    {
-        log_error() << "Script left junk on top of the stack";
-        return false;
-    }
     return true;
 }
 
-data_chunk script::pop_stack()
-{
-    data_chunk value = stack_.back();
-    stack_.pop_back();
-    return value;
-}
-
-bool script::op_dup()
+bool script::op_dup(script_context& context) const
 {
-    if (stack_.size() < 1)
+    if (context.size() < 1)
         return false;
-    stack_.push_back(stack_.back());
+    context.push(context.top());
     return true;
 }
 
-bool script::op_hash160()
+bool script::op_hash160(script_context& context) const
 {
-    if (stack_.size() < 1)
+    if (context.size() < 1)
         return false;
-    data_chunk data = pop_stack();
+    data_chunk data = context.pop();
     short_hash hash = generate_ripemd_hash(data);
-    data_chunk raw_hash(hash.begin(), hash.end());
-    stack_.push_back(raw_hash);
+    context.push(data_chunk(hash.begin(), hash.end()));
     return true;
 }
 
-bool script::op_equalverify()
+bool script::op_equalverify(script_context& context) const
 {
-    if (stack_.size() < 2)
+    if (context.size() < 2)
         return false;
-    return pop_stack() == pop_stack();
+    return context.pop() == context.pop();
 }
 
-bool script::op_checksig(const message::transaction& parent_tx, 
-        uint32_t input_index)
+// Shared by OP_CHECKSIG and the template fast paths
+bool check_signature(data_chunk signature, const data_chunk& pubkey,
+    const script& script_code, const message::transaction& parent_tx,
+    uint32_t input_index, const signature_hash_template* sighash)
 {
-    if (stack_.size() < 2)
+    if (signature.empty())
         return false;
-    data_chunk pubkey = pop_stack(), signature = pop_stack();
-
-    script script_code;
-    for (operation op: operations_)
-    {
-        if (op.data == signature || op.code == opcode::codeseparator)
-            continue;
-        script_code.push_operation(op);
-    }
-
-    elliptic_curve_key key;
-    key.set_public_key(pubkey);
-
     uint32_t hash_type = 0;
     hash_type = signature.back();
     signature.pop_back();
-    BITCOIN_ASSERT(signature.size() == 70);
 
     if (hash_type != 1)
     {
@@ -122,18 +173,41 @@ bool script::op_checksig(const message::transaction& parent_tx,
         return false;
     }
 
-    message::transaction tx_tmp = parent_tx;
-    // Blank all other inputs' signatures
-    for (message::transaction_input& input: tx_tmp.inputs)
-        input.input_script = script();
-    tx_tmp.inputs[input_index].input_script = script_code;
+    // Lone checks build a template just for themselves
+    hash_digest tx_hash = sighash != nullptr ?
+        sighash->digest(input_index, script_code, hash_type) :
+        signature_hash_template(parent_tx).digest(
+            input_index, script_code, hash_type);
+    signature_cache& cache = shared_signature_cache();
+    if (cache.contains(tx_hash, pubkey, signature))
+        return true;
+    elliptic_curve_key_ptr key = shared_public_key_cache().get(pubkey);
+    if (!key || !key->verify(tx_hash, signature))
+        return false;
+    cache.add(tx_hash, pubkey, signature);
+    return true;
+}
+
+bool script::op_checksig(script_context& context,
+    const message::transaction& parent_tx, uint32_t input_index) const
+{
+    if (context.size() < 2)
+        return false;
+    data_chunk pubkey = context.pop(), signature = context.pop();
 
-    hash_digest tx_hash = hash_transaction(tx_tmp, hash_type);
-    return key.verify(tx_hash, signature);
+    script script_code;
+    for (const operation& op: operations_)
+    {
+        if (op.data == signature || op.code == opcode::codeseparator)
+            continue;
+        script_code.push_operation(op);
+    }
+    return check_signature(std::move(signature), pubkey, script_code,
+        parent_tx, input_index, context.sighash_template());
 }
 
-bool script::run_operation(operation op, 
-        const message::transaction& parent_tx, uint32_t input_index)
+bool script::run_operation(const operation& op, script_context& context,
+    const message::transaction& parent_tx, uint32_t input_index) const
 {
     switch (op.code)
     {
@@ -153,16 +227,16 @@ bool script::run_operation(operation op,
             return true;
 
         case opcode::dup:
-            return op_dup();
+            return op_dup(context);
 
         case opcode::hash160:
-            return op_hash160();
+            return op_hash160(context);
 
         case opcode::equalverify:
-            return op_equalverify();
+            return op_equalverify(context);
 
         case opcode::checksig:
-            return op_checksig(parent_tx, input_index);
+            return op_checksig(context, parent_tx, input_index);
 
         default:
             break;
@@ -170,20 +244,103 @@ bool script::run_operation(operation op,
     return false;
 }
 
+// Template push ops give the exact size of data they expect
+const operation_stack pubkey_template_compressed{
+    {opcode::special, data_chunk(33)},
+    {opcode::checksig, data_chunk()}};
+const operation_stack pubkey_template_uncompressed{
+    {opcode::special, data_chunk(65)},
+    {opcode::checksig, data_chunk()}};
+const operation_stack pubkey_hash_template{
+    {opcode::dup, data_chunk()},
+    {opcode::hash160, data_chunk()},
+    {opcode::special, data_chunk(20)},
+    {opcode::equalverify, data_chunk()},
+    {opcode::checksig, data_chunk()}};
+
 transaction_type script::type() const
 {
-    return transaction_type::normal;
+    if (matches_template(pubkey_hash_template))
+        return transaction_type::pubkey_hash;
+    if (matches_template(pubkey_template_uncompressed) ||
+            matches_template(pubkey_template_compressed))
+        return transaction_type::pubkey;
+    return transaction_type::other;
+}
+
+bool script::matches_template(const operation_stack& templ) const
+{
+    if (operations_.size() != templ.size())
+        return false;
+    for (size_t i = 0; i < templ.size(); ++i)
+        if (operations_[i].code != templ[i].code ||
+                operations_[i].data.size() != templ[i].data.size())
+            return false;
+    return true;
 }
 
-bool script::matches_template(operation_stack templ) const
+bool is_push_only(const operation_stack& operations, size_t count)
 {
-    return templ.size() == 0;
+    if (operations.size() != count)
+        return false;
+    for (const operation& op: operations)
+        if (op.code != opcode::special || op.data.empty())
+            return false;
+    return true;
+}
+
+bool verify_input_script(const script& input_script,
+    const script& output_script, const message::transaction& parent_tx,
+    uint32_t input_index, const signature_hash_template* sighash)
+{
+    const operation_stack& input_ops = input_script.operations();
+    const operation_stack& output_ops = output_script.operations();
+    // Signing commits to the output script, which carries no signature
+    // or code separators in either template.
+    switch (output_script.type())
+    {
+        case transaction_type::pubkey:
+            if (!is_push_only(input_ops, 1))
+                break;
+            return check_signature(input_ops[0].data, output_ops[0].data,
+                output_script, parent_tx, input_index, sighash);
+
+        case transaction_type::pubkey_hash:
+        {
+            if (!is_push_only(input_ops, 2))
+                break;
+            const data_chunk& pubkey = input_ops[1].data;
+            short_hash pubkey_hash = generate_ripemd_hash(pubkey);
+            const data_chunk& expected_hash = output_ops[2].data;
+            if (!std::equal(pubkey_hash.begin(), pubkey_hash.end(),
+                    expected_hash.begin()))
+                return false;
+            return check_signature(input_ops[0].data, pubkey,
+                output_script, parent_tx, input_index, sighash);
+        }
+
+        default:
+            break;
+    }
+    // Input pushes are left on the stack for the output script to use
+    script_context& context = thread_script_context();
+    context.clear();
+    context.set_sighash_template(sighash);
+    if (!input_script.evaluate(context, parent_tx, input_index) ||
+            !output_script.evaluate(context, parent_tx, input_index))
+        return false;
+    if (!context.empty())
+    {
+        log_error() << "Script left junk on top of the stack";
+        return false;
+    }
+    return true;
 }
 
 std::string script::string_repr() const
 {
     std::ostringstream ss;
-    for (const operation op: operations_)
+    for (const operation& op: operations_)
     {
         if (op.data.size() == 0)
             ss << opcode_to_string(op.code) << " ";
@@ -248,20 +405,62 @@ opcode string_to_opcode(std::string code_repr)
     return opcode::bad_operation;
 }
 
-size_t number_of_bytes_from_opcode(opcode code, byte raw_byte)
+// Pushdata opcodes carry a little endian length of 1, 2 or 4 bytes
+static size_t push_prefix_size(opcode code)
+{
+    if (code == opcode::pushdata1)
+        return 1;
+    else if (code == opcode::pushdata2)
+        return 2;
+    else if (code == opcode::pushdata4)
+        return 4;
+    return 0;
+}
+
+// Works out how many bytes the operation at it pushes, leaving it on the
+// last byte before the data. False if the script ends inside the length.
+static bool read_push_size(opcode code, byte raw_byte,
+    const byte*& it, const byte* end, size_t& size)
 {
-    if (code == opcode::special)
-        return raw_byte;
-    else if (code == opcode::pushdata1 || code == opcode::pushdata2
-            || code == opcode::pushdata4)
-        return static_cast<size_t>(code);
-    else
-        return 0;
+    size = code == opcode::special ? raw_byte : 0;
+    size_t prefix_size = push_prefix_size(code);
+    if (static_cast<size_t>(end - it - 1) < prefix_size)
+        return false;
+    for (size_t i = 0; i < prefix_size; ++i)
+        size |= static_cast<size_t>(it[1 + i]) << (8 * i);
+    it += prefix_size;
+    return true;
 }
 
 script parse_script(const data_chunk& raw_script)
+{
+    return parse_script(data_view(raw_script));
+}
+
+static size_t count_operations(const data_view& raw_script)
+{
+    size_t count = 0;
+    for (auto it = raw_script.begin(); it != raw_script.end(); ++it, ++count)
+    {
+        byte raw_byte = *it;
+        opcode code = raw_byte <= 75 ?
+            opcode::special : static_cast<opcode>(raw_byte);
+        size_t read_n_bytes;
+        if (!read_push_size(code, raw_byte, it, raw_script.end(),
+                read_n_bytes))
+            break;
+        if (static_cast<size_t>(raw_script.end() - it - 1) < read_n_bytes)
+            break;
+        it += read_n_bytes;
+    }
+    return count;
+}
+
+script parse_script(const data_view& raw_script)
 {
     script script_object;
+    // Size the operations once rather than growing as we go
+    script_object.reserve(count_operations(raw_script));
     for (auto it = raw_script.begin(); it != raw_script.end(); ++it)
     {
         byte raw_byte = *it;
@@ -270,21 +469,19 @@ script parse_script(const data_chunk& raw_script)
         // raw_byte is unsigned so it's always >= 0
         if (raw_byte <= 75)
             op.code = opcode::special;
-        size_t read_n_bytes = number_of_bytes_from_opcode(op.code, raw_byte);
-
-        for (size_t byte_count = 0; byte_count < read_n_bytes; ++byte_count)
+        size_t read_n_bytes;
+        if (!read_push_size(op.code, raw_byte, it, raw_script.end(),
+                read_n_bytes) ||
+            static_cast<size_t>(raw_script.end() - it - 1) < read_n_bytes)
         {
-            ++it;
-            if (it == raw_script.cend())
-            {
-                log_warning() << "Premature end of script.";
-                return script();
-            }
-            op.data.push_back(*it);
+            log_warning() << "Premature end of script.";
+            return script();
         }
+        // Copy the pushed data straight from the source buffer
+        op.data.assign(it + 1, it + 1 + read_n_bytes);
+        it += read_n_bytes;
 
-        script_object.push_operation(op);
-
+        script_object.push_operation(std::move(op));
     }
     return script_object;
 }
@@ -292,16 +489,42 @@ script parse_script(const data_chunk& raw_script)
 data_chunk save_script(const script& scr)
 {
     data_chunk raw_script;
-    for (operation op: scr.operations())
+    raw_script.reserve(script_size(scr));
+    for (const operation& op: scr.operations())
     {
         byte raw_byte = static_cast<byte>(op.code);
         if (op.code == opcode::special)
             raw_byte = op.data.size();
         raw_script.push_back(raw_byte);
+        for (size_t i = 0; i < push_prefix_size(op.code); ++i)
+            raw_script.push_back(op.data.size() >> (8 * i));
         extend_data(raw_script, op.data);
     }
     return raw_script;
 }
 
+size_t script_size(const script& scr)
+{
+    size_t size = 0;
+    for (const operation& op: scr.operations())
+        size += 1 + push_prefix_size(op.code) + op.data.size();
+    return size;
+}
+
+void write_script(serializer& serial, const script& scr)
+{
+    serial.write_var_uint(script_size(scr));
+    for (const operation& op: scr.operations())
+    {
+        byte raw_byte = static_cast<byte>(op.code);
+        if (op.code == opcode::special)
+            raw_byte = op.data.size();
+        serial.write_byte(raw_byte);
+        for (size_t i = 0; i < push_prefix_size(op.code); ++i)
+            serial.write_byte(op.data.size() >> (8 * i));
+        serial.write_data(op.data);
+    }
+}
+
 } // libbitcoin
 
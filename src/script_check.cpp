@@ -0,0 +1,130 @@
+#include <bitcoin/script_check.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/metrics.hpp>
+#include <bitcoin/util/thread_pool.hpp>
+
+namespace libbitcoin {
+
+bool run_script_check(const script_check& check)
+{
+    BITCOIN_ASSERT(check.input_index < check.parent_tx->inputs.size());
+    const message::transaction_input& input =
+        check.parent_tx->inputs[check.input_index];
+    // Scripts are only read and each worker thread evaluates on its own
+    // script_context, so checks can share parsed scripts.
+    return verify_input_script(input.input_script, check.output_script,
+        *check.parent_tx, check.input_index, check.sighash.get());
+}
+
+typedef std::chrono::high_resolution_clock run_clock;
+
+// Shared by every worker running one batch of checks
+struct script_check_run
+{
+    run_clock::time_point started;
+    script_check_list checks;
+    size_t batch_size;
+    std::atomic<size_t> next_check;
+    std::atomic<bool> failed;
+    std::atomic<size_t> running_workers;
+    script_check_queue::completion_handler handle_complete;
+};
+
+typedef shared_ptr<script_check_run> script_check_run_ptr;
+
+void script_check_worker(script_check_run_ptr state)
+{
+    static counter& checks_run = shared_metrics().get_counter("script.checks");
+    while (!state->failed)
+    {
+        size_t begin = state->next_check.fetch_add(state->batch_size);
+        if (begin >= state->checks.size())
+            break;
+        size_t end = std::min(begin + state->batch_size,
+            state->checks.size());
+        size_t i = begin;
+        for (; i < end && !state->failed; ++i)
+            if (!run_script_check(state->checks[i]))
+                state->failed = true;
+        checks_run.add(i - begin);
+    }
+    if (--state->running_workers == 0)
+    {
+        static latency_histogram& run_time =
+            shared_metrics().get_histogram("script.verify_run");
+        run_time.record(std::chrono::duration_cast<std::chrono::microseconds>(
+            run_clock::now() - state->started).count());
+        state->handle_complete(!state->failed);
+    }
+}
+
+script_check_queue::script_check_queue(
+    thread_pool_ptr pool, size_t batch_size)
+  : pool_(pool), batch_size_(std::max<size_t>(batch_size, 1))
+{
+}
+
+script_check_run_ptr start_run(script_check_list& checks, size_t batch_size,
+    size_t number_workers, script_check_queue::completion_handler handler)
+{
+    script_check_run_ptr state(new script_check_run);
+    state->started = run_clock::now();
+    state->checks = std::move(checks);
+    state->batch_size = batch_size;
+    state->next_check = 0;
+    state->failed = false;
+    size_t number_batches =
+        (state->checks.size() + batch_size - 1) / batch_size;
+    // No point waking workers that would find nothing to claim
+    state->running_workers =
+        std::max<size_t>(std::min(number_workers, number_batches), 1);
+    state->handle_complete = handler;
+    return state;
+}
+
+void script_check_queue::async_run(script_check_list checks,
+    completion_handler handle_complete)
+{
+    script_check_run_ptr state = start_run(checks, batch_size_,
+        pool_->size(), handle_complete);
+    // Read the count before posting since workers decrement it
+    const size_t number_workers = state->running_workers;
+    for (size_t i = 0; i < number_workers; ++i)
+        pool_->service()->post(std::bind(script_check_worker, state));
+}
+
+bool script_check_queue::run(script_check_list checks)
+{
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool done = false, success = false;
+    auto handle_complete =
+        [&](bool result)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            success = result;
+            done = true;
+            finished.notify_all();
+        };
+    // The caller counts as one of the workers
+    script_check_run_ptr state = start_run(checks, batch_size_,
+        pool_->size() + 1, handle_complete);
+    const size_t number_workers = state->running_workers;
+    for (size_t i = 1; i < number_workers; ++i)
+        pool_->service()->post(std::bind(script_check_worker, state));
+    script_check_worker(state);
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!done)
+        finished.wait(lock);
+    return success;
+}
+
+} // libbitcoin
+
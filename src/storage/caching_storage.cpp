@@ -0,0 +1,321 @@
+#include <bitcoin/storage/caching_storage.hpp>
+
+#include <vector>
+
+#include <bitcoin/block.hpp>
+#include <bitcoin/transaction.hpp>
+
+namespace libbitcoin {
+
+using std::placeholders::_1;
+using std::placeholders::_2;
+using std::placeholders::_3;
+
+// Parsed scripts take a few times their wire size
+constexpr size_t parsed_overhead = 3;
+
+static size_t block_bytes(const message::block& block)
+{
+    size_t bytes = sizeof(block) + parsed_overhead * block_size(block);
+    if (block.raw_payload)
+        bytes += block.raw_payload->size();
+    return bytes;
+}
+
+static size_t output_bytes(const message::transaction_output& output)
+{
+    return sizeof(output_point) + sizeof(output) + 64 +
+        parsed_overhead * script_size(output.output_script);
+}
+
+double hit_rate(uint64_t hits, uint64_t misses)
+{
+    if (hits + misses == 0)
+        return 0;
+    return hits / static_cast<double>(hits + misses);
+}
+
+caching_storage::caching_storage(storage_ptr backend,
+        size_t max_block_bytes, size_t max_output_bytes,
+        thread_pool_ptr executor)
+  : threaded_service(executor), backend_(backend), blocks_(max_block_bytes), outputs_(max_output_bytes)
+{
+    statistics_ = cache_statistics{0, 0, 0, 0, 0, 0, 0, 0};
+}
+
+void caching_storage::cache_block(message::block_ptr block)
+{
+    // Hashing is the slow part so it stays outside the lock
+    const hash_digest block_hash = hash_block_header(*block);
+    std::vector<hash_digest> tx_hashes;
+    tx_hashes.reserve(block->transactions.size());
+    for (const message::transaction& tx: block->transactions)
+        tx_hashes.push_back(hash_transaction(tx));
+    std::lock_guard<std::mutex> lock(mutex_);
+    blocks_.insert(block_hash, block, block_bytes(*block));
+    for (size_t tx_i = 0; tx_i < tx_hashes.size(); ++tx_i)
+    {
+        const message::transaction& tx = block->transactions[tx_i];
+        for (uint32_t i = 0; i < tx.outputs.size(); ++i)
+            outputs_.insert(output_point{tx_hashes[tx_i], i}, tx.outputs[i],
+                output_bytes(tx.outputs[i]));
+    }
+}
+
+cache_statistics caching_storage::statistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_statistics result = statistics_;
+    result.blocks = blocks_.size();
+    result.block_bytes = blocks_.bytes();
+    result.outputs = outputs_.size();
+    result.output_bytes = outputs_.bytes();
+    return result;
+}
+
+void caching_storage::set_max_block_bytes(size_t max_block_bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    blocks_.set_max_bytes(max_block_bytes);
+}
+
+void caching_storage::set_max_output_bytes(size_t max_output_bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    outputs_.set_max_bytes(max_output_bytes);
+}
+
+void caching_storage::store(const message::inv& inv,
+        store_handler handle_store)
+{
+    backend_->store(inv, handle_store);
+}
+
+void caching_storage::store(const message::transaction& transaction,
+        store_handler handle_store)
+{
+    backend_->store(transaction, handle_store);
+}
+
+void caching_storage::store(message::block_ptr block,
+        store_handler handle_store)
+{
+    backend_->store(block, std::bind(&caching_storage::stored_block,
+        shared_from_this(), _1, block, handle_store));
+}
+void caching_storage::stored_block(const std::error_code& ec,
+        message::block_ptr block, store_handler handle_store)
+{
+    // Either way the backend now has it
+    if (!ec || ec == error::object_already_exists)
+        cache_block(block);
+    handle_store(ec);
+}
+
+void caching_storage::fetch_inventories(
+        fetch_handler_inventories handle_fetch)
+{
+    backend_->fetch_inventories(handle_fetch);
+}
+
+void caching_storage::fetch_block_by_depth(size_t block_number,
+        fetch_handler_block handle_fetch)
+{
+    backend_->fetch_block_by_depth(block_number, handle_fetch);
+}
+
+void caching_storage::fetch_block_by_hash(hash_digest block_hash,
+        fetch_handler_block handle_fetch)
+{
+    message::block_ptr block;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (blocks_.find(block_hash, block))
+            ++statistics_.block_hits;
+        else
+            ++statistics_.block_misses;
+    }
+    if (block)
+        service()->post(
+            [block, handle_fetch]
+            {
+                handle_fetch(std::error_code(), *block);
+            });
+    else
+        backend_->fetch_block_by_hash(block_hash, std::bind(
+            &caching_storage::fetched_block, shared_from_this(),
+                _1, _2, handle_fetch));
+}
+void caching_storage::fetched_block(const std::error_code& ec,
+        const message::block& block, fetch_handler_block handle_fetch)
+{
+    if (!ec)
+        cache_block(std::make_shared<const message::block>(block));
+    handle_fetch(ec, block);
+}
+
+void caching_storage::fetch_raw_block_by_hash(hash_digest block_hash,
+        fetch_handler_raw_block handle_fetch)
+{
+    // Only blocks that arrived from the network still have their payload
+    data_chunk_ptr raw_block;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        message::block_ptr block;
+        if (blocks_.find(block_hash, block) && block->raw_payload)
+        {
+            raw_block = block->raw_payload;
+            ++statistics_.block_hits;
+        }
+        else
+            ++statistics_.block_misses;
+    }
+    if (raw_block)
+        service()->post(std::bind(handle_fetch, std::error_code(), raw_block));
+    else
+        backend_->fetch_raw_block_by_hash(block_hash, handle_fetch);
+}
+
+void caching_storage::fetch_block_locator(
+        fetch_handler_block_locator handle_fetch)
+{
+    backend_->fetch_block_locator(handle_fetch);
+}
+
+void caching_storage::fetch_output_by_hash(hash_digest transaction_hash,
+        uint32_t index, fetch_handler_output handle_fetch)
+{
+    const output_point point{transaction_hash, index};
+    message::transaction_output output;
+    bool found;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        found = outputs_.find(point, output);
+        if (found)
+            ++statistics_.output_hits;
+        else
+            ++statistics_.output_misses;
+    }
+    if (found)
+        service()->post(std::bind(handle_fetch, std::error_code(), output));
+    else
+        backend_->fetch_output_by_hash(transaction_hash, index, std::bind(
+            &caching_storage::fetched_output, shared_from_this(),
+                _1, _2, point, handle_fetch));
+}
+void caching_storage::fetched_output(const std::error_code& ec,
+        const message::transaction_output& output,
+        const output_point& point, fetch_handler_output handle_fetch)
+{
+    if (!ec)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        outputs_.insert(point, output, output_bytes(output));
+    }
+    handle_fetch(ec, output);
+}
+
+void caching_storage::fetch_blocks_by_depth_range(size_t begin, size_t end,
+        fetch_handler_blocks handle_fetch)
+{
+    backend_->fetch_blocks_by_depth_range(begin, end, handle_fetch);
+}
+
+void caching_storage::fetch_outputs(const output_point_list& points,
+        fetch_handler_outputs handle_fetch)
+{
+    message::transaction_output_list outputs(points.size());
+    // Where each point sent to the backend sits in the request
+    std::vector<size_t> positions;
+    output_point_list uncached;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            if (outputs_.find(points[i], outputs[i]))
+                ++statistics_.output_hits;
+            else
+            {
+                ++statistics_.output_misses;
+                positions.push_back(i);
+                uncached.push_back(points[i]);
+            }
+        }
+    }
+    if (uncached.empty())
+        service()->post(std::bind(handle_fetch, std::error_code(),
+            outputs, std::vector<size_t>()));
+    else
+        backend_->fetch_outputs(uncached, std::bind(
+            &caching_storage::fetched_outputs, shared_from_this(),
+                _1, _2, _3, uncached, outputs, positions, handle_fetch));
+}
+void caching_storage::fetched_outputs(const std::error_code& ec,
+        const message::transaction_output_list& fetched,
+        const std::vector<size_t>& fetched_missing,
+        const output_point_list& points,
+        const message::transaction_output_list& outputs,
+        const std::vector<size_t>& positions,
+        fetch_handler_outputs handle_fetch)
+{
+    if (ec)
+    {
+        handle_fetch(ec, outputs, positions);
+        return;
+    }
+    message::transaction_output_list result = outputs;
+    std::vector<bool> found(points.size(), true);
+    std::vector<size_t> missing;
+    for (size_t i: fetched_missing)
+    {
+        found[i] = false;
+        missing.push_back(positions[i]);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < points.size(); ++i)
+            if (found[i])
+            {
+                result[positions[i]] = fetched[i];
+                outputs_.insert(points[i], fetched[i],
+                    output_bytes(fetched[i]));
+            }
+    }
+    handle_fetch(std::error_code(), result, missing);
+}
+
+void caching_storage::fetch_unspent_outputs(const output_point_list& points,
+        fetch_handler_outputs handle_fetch)
+{
+    backend_->fetch_unspent_outputs(points, handle_fetch);
+}
+
+void caching_storage::fetch_outputs_by_pubkey_hash(
+        const short_hash& pubkey_hash,
+        fetch_handler_address_outputs handle_fetch)
+{
+    backend_->fetch_outputs_by_pubkey_hash(pubkey_hash, handle_fetch);
+}
+
+void caching_storage::block_exists_by_hash(hash_digest block_hash,
+        exists_handler handle_exists)
+{
+    bool cached;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cached = blocks_.contains(block_hash);
+    }
+    if (cached)
+        service()->post(std::bind(handle_exists, std::error_code(), true));
+    else
+        backend_->block_exists_by_hash(block_hash, handle_exists);
+}
+
+void caching_storage::blocks_exist(const hash_list& block_hashes,
+        exists_list_handler handle_exists)
+{
+    backend_->blocks_exist(block_hashes, handle_exists);
+}
+
+} // libbitcoin
+
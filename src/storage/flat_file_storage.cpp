@@ -0,0 +1,965 @@
+#include <bitcoin/storage/flat_file_storage.hpp>
+
+#include <algorithm>
+#include <boost/thread/locks.hpp>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <initializer_list>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <bitcoin/block.hpp>
+#include <bitcoin/constants.hpp>
+#include <bitcoin/dialect.hpp>
+#include <bitcoin/header_index.hpp>
+#include <bitcoin/lazy_block.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/endian.hpp>
+#include <bitcoin/util/hex.hpp>
+#include <bitcoin/util/logger.hpp>
+#include <bitcoin/util/serializer.hpp>
+#include <bitcoin/util/thread_pool.hpp>
+#include <bitcoin/utxo_verify_block.hpp>
+
+namespace libbitcoin {
+
+using std::placeholders::_1;
+using std::placeholders::_2;
+
+typedef boost::shared_lock<boost::shared_mutex> read_lock;
+typedef boost::unique_lock<boost::shared_mutex> write_lock;
+
+// Each payload in a block file follows the network magic and its size
+constexpr uint32_t block_file_magic = 0xd9b4bef9;
+constexpr uint64_t max_block_file_size = 128 * 1024 * 1024;
+constexpr size_t block_record_size = 32 + 32 + 4 + 4 + 8 + 4;
+constexpr size_t transaction_record_size = 32 + 4 + 4 + 4;
+constexpr size_t spent_record_size = 1 + 32 + 4 + 1;
+constexpr uint8_t spent_change_record = 0, spent_tip_record = 1;
+
+// Payload of the mainnet genesis block
+static const char genesis_payload[] =
+    "01000000000000000000000000000000000000000000000000000000000000000000"
+    "00003ba3edfd7a7b12b27ac72c3e67768f617fc81bc3888a51323a9fb8aa4b1e5e4a"
+    "29ab5f49ffff001d1dac2b7c01010000000100000000000000000000000000000000"
+    "00000000000000000000000000000000ffffffff4d04ffff001d0104455468652054"
+    "696d65732030332f4a616e2f32303039204368616e63656c6c6f72206f6e20627269"
+    "6e6b206f66207365636f6e64206261696c6f757420666f722062616e6b73ffffffff"
+    "0100f2052a01000000434104678afdb0fe5548271967f1a67130b7105cd6a828e039"
+    "09a67962e0ea1f61deb649f6bc3f4cef38c4f35504e51ec112de5c384df7ba0b8d57"
+    "8a4c702b6bf11d5fac00000000";
+
+// Little endian, matching the serializer
+template <typename T>
+static T read_record_int(const byte*& cursor)
+{
+    const T value = from_little_endian<T>(cursor);
+    cursor += sizeof(T);
+    return value;
+}
+
+static hash_digest read_record_hash(const byte*& cursor)
+{
+    hash_digest hash;
+    std::copy(cursor, cursor + hash.size(), hash.begin());
+    cursor += hash.size();
+    return hash;
+}
+
+static void write_record_hash(serializer& record, const hash_digest& hash)
+{
+    record.write_data(hash.data(), hash.size());
+}
+
+static uint64_t file_size(const std::string& path)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return 0;
+    return info.st_size;
+}
+
+// Cuts off anything past the last whole record
+static void trim_file(const std::string& path, uint64_t valid_size)
+{
+    if (file_size(path) > valid_size &&
+            truncate(path.c_str(), valid_size) != 0)
+        log_error() << "Unable to trim " << path;
+}
+
+// Writes every part, or else cuts the file back to where it was so
+// the next record still starts on a record boundary
+static bool append(int fd, std::initializer_list<data_view> parts)
+{
+    if (fd == -1)
+        return false;
+    const off_t start = lseek(fd, 0, SEEK_END);
+    for (const data_view& part: parts)
+    {
+        const byte* cursor = part.begin();
+        while (cursor != part.end())
+        {
+            ssize_t written = write(fd, cursor, part.end() - cursor);
+            if (written == -1 && errno == EINTR)
+                continue;
+            if (written == -1)
+            {
+                if (ftruncate(fd, start) != 0)
+                    log_fatal() << "Unable to cut back a partial write";
+                return false;
+            }
+            cursor += written;
+        }
+    }
+    return true;
+}
+
+flat_file_storage::flat_file_storage(const std::string& directory,
+        size_t number_readers, thread_pool_ptr executor)
+  : threaded_service(executor), directory_(directory),
+    blocks_index_fd_(-1), transactions_index_fd_(-1),
+    spent_log_fd_(-1), block_file_fd_(-1), block_file_(0),
+    block_file_size_(0), connected_size_(0)
+{
+    if (mkdir(directory_.c_str(), 0755) != 0 && errno != EEXIST)
+        log_error() << "Unable to create " << directory_;
+    headers_.reset(new header_index);
+    dialect_.reset(new original_dialect);
+    verify_pool_.reset(new thread_pool);
+    checkpoints_ = mainnet_checkpoints();
+    unspent_.reset(new utxo_set(
+        std::bind(&flat_file_storage::load_output, this, _1, _2),
+        std::bind(&flat_file_storage::flush_spends, this, _1)));
+    load_blocks();
+    load_transactions();
+    load_spent();
+    open_files();
+    if (records_.empty())
+    {
+        data_chunk genesis_raw;
+        const bool decoded = decode_hex(genesis_payload, genesis_raw);
+        BITCOIN_ASSERT(decoded);
+        lazy_block genesis(std::move(genesis_raw));
+        BITCOIN_ASSERT(genesis.valid());
+        if (!write_block(genesis.hash(), genesis.decode()))
+            log_fatal() << "Unable to store the genesis block in "
+                << directory_;
+    }
+    // Catches up on blocks written after the last flush
+    organize(nullptr);
+    log_info() << "Loaded " << records_.size() << " blocks with "
+        << connected_.size() << " connected from " << directory_;
+    reader_threads_.reset(new thread_pool(number_readers));
+}
+
+flat_file_storage::~flat_file_storage()
+{
+    for (int fd: {blocks_index_fd_, transactions_index_fd_, spent_log_fd_,
+            block_file_fd_})
+        if (fd != -1)
+            close(fd);
+}
+
+std::string flat_file_storage::path(const std::string& name) const
+{
+    return directory_ + "/" + name;
+}
+
+std::string flat_file_storage::block_file_path(uint32_t file) const
+{
+    char name[16];
+    snprintf(name, sizeof(name), "blk%05u.dat", file);
+    return path(name);
+}
+
+void flat_file_storage::load_blocks()
+{
+    uint64_t valid_size = 0;
+    {
+        mapped_file mapping(path("blocks.index"));
+        std::vector<uint64_t> file_sizes;
+        const byte* cursor = mapping.data();
+        const size_t count = mapping.size() / block_record_size;
+        records_.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            block_location location;
+            location.hash = read_record_hash(cursor);
+            hash_digest prev_hash = read_record_hash(cursor);
+            uint32_t bits = read_record_int<uint32_t>(cursor);
+            location.file = read_record_int<uint32_t>(cursor);
+            location.offset = read_record_int<uint64_t>(cursor);
+            location.size = read_record_int<uint32_t>(cursor);
+            while (file_sizes.size() <= location.file)
+                file_sizes.push_back(
+                    file_size(block_file_path(file_sizes.size())));
+            // The payload never reached the disk, so neither did
+            // anything written after it
+            if (location.offset + location.size > file_sizes[location.file])
+                break;
+            blocks_[location.hash] = records_.size();
+            records_.push_back(location);
+            headers_->add(location.hash, prev_hash, bits);
+            valid_size += block_record_size;
+        }
+    }
+    trim_file(path("blocks.index"), valid_size);
+}
+
+void flat_file_storage::load_transactions()
+{
+    uint64_t valid_size = 0;
+    {
+        mapped_file mapping(path("transactions.index"));
+        const byte* cursor = mapping.data();
+        const size_t count = mapping.size() / transaction_record_size;
+        transactions_.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            hash_digest hash = read_record_hash(cursor);
+            transaction_location location;
+            location.block = read_record_int<uint32_t>(cursor);
+            location.offset = read_record_int<uint32_t>(cursor);
+            location.size = read_record_int<uint32_t>(cursor);
+            // Written for a block whose own record was lost
+            if (location.block >= records_.size())
+                break;
+            transactions_.insert(std::make_pair(hash, location));
+            valid_size += transaction_record_size;
+        }
+    }
+    trim_file(path("transactions.index"), valid_size);
+}
+
+void flat_file_storage::load_spent()
+{
+    uint64_t valid_size = 0;
+    hash_digest tip_hash = null_hash;
+    {
+        mapped_file mapping(path("spent.log"));
+        const byte* cursor = mapping.data();
+        const size_t count = mapping.size() / spent_record_size;
+        // Changes only count once the tip they lead up to is written
+        utxo_set::change_list pending;
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint8_t type = *cursor++;
+            output_point point;
+            point.hash = read_record_hash(cursor);
+            point.index = read_record_int<uint32_t>(cursor);
+            bool spent = *cursor++ != 0;
+            if (type == spent_change_record)
+                pending.push_back(std::make_pair(point, spent));
+            else if (type == spent_tip_record)
+            {
+                for (const auto& change: pending)
+                    if (change.second)
+                        spent_.insert(change.first);
+                    else
+                        spent_.erase(change.first);
+                pending.clear();
+                tip_hash = point.hash;
+                valid_size = (i + 1) * spent_record_size;
+            }
+            else
+                break;
+        }
+    }
+    header_index::entry tip;
+    if (tip_hash != null_hash &&
+            (!headers_->find(tip_hash, tip) || !tip.linked))
+    {
+        log_error() << "Connected tip " << hexlify(tip_hash)
+            << " is not stored, connecting from genesis again";
+        spent_.clear();
+        tip_hash = null_hash;
+        valid_size = 0;
+    }
+    trim_file(path("spent.log"), valid_size);
+    if (tip_hash == null_hash)
+        return;
+    connected_.resize(tip.depth + 1);
+    connected_[tip.depth] = tip.hash;
+    for (const header_index::entry* current = tip.prev;
+            current != nullptr; current = current->prev)
+        connected_[current->depth] = current->hash;
+    connected_size_ = connected_.size();
+}
+
+void flat_file_storage::open_files()
+{
+    const int flags = O_WRONLY | O_CREAT | O_APPEND;
+    blocks_index_fd_ = open(path("blocks.index").c_str(), flags, 0644);
+    transactions_index_fd_ =
+        open(path("transactions.index").c_str(), flags, 0644);
+    spent_log_fd_ = open(path("spent.log").c_str(), flags, 0644);
+    block_file_ = records_.empty() ? 0 : records_.back().file;
+    block_file_fd_ = open(block_file_path(block_file_).c_str(), flags, 0644);
+    if (block_file_fd_ != -1)
+        block_file_size_ = lseek(block_file_fd_, 0, SEEK_END);
+    if (blocks_index_fd_ == -1 || transactions_index_fd_ == -1 ||
+            spent_log_fd_ == -1 || block_file_fd_ == -1)
+        log_error() << "Unable to open the block files in " << directory_;
+}
+
+bool flat_file_storage::append_block_payload(const data_chunk& payload,
+        block_location& location)
+{
+    if (block_file_size_ > 0 &&
+            block_file_size_ + 8 + payload.size() > max_block_file_size)
+    {
+        if (block_file_fd_ != -1)
+            close(block_file_fd_);
+        ++block_file_;
+        block_file_fd_ = open(block_file_path(block_file_).c_str(),
+            O_WRONLY | O_CREAT | O_APPEND, 0644);
+        block_file_size_ = block_file_fd_ == -1 ? 0 :
+            lseek(block_file_fd_, 0, SEEK_END);
+    }
+    serializer head;
+    head.write_4_bytes(block_file_magic);
+    head.write_4_bytes(payload.size());
+    const data_chunk head_data = head.release_data();
+    if (!append(block_file_fd_, {data_view(head_data), data_view(payload)}))
+        return false;
+    location.file = block_file_;
+    location.offset = block_file_size_ + head_data.size();
+    location.size = payload.size();
+    block_file_size_ += head_data.size() + payload.size();
+    return true;
+}
+
+bool flat_file_storage::write_block(const hash_digest& block_hash,
+        const message::block& block)
+{
+    // Blocks built locally are serialized once here instead
+    data_chunk_ptr raw_block = block.raw_payload;
+    if (!raw_block)
+        raw_block = std::make_shared<const data_chunk>(
+            dialect_->to_network(block, false));
+    lazy_block lazy(raw_block);
+    if (!lazy.valid() || lazy.transactions_size() != block.transactions.size())
+        return false;
+    block_location location;
+    location.hash = block_hash;
+    if (!append_block_payload(*raw_block, location))
+        return false;
+
+    const uint32_t record = records_.size();
+    std::vector<std::pair<hash_digest, transaction_location>> added;
+    added.reserve(lazy.transactions_size());
+    serializer transaction_records;
+    for (size_t i = 0; i < lazy.transactions_size(); ++i)
+    {
+        const data_view tx_data = lazy.transaction_data(i);
+        const transaction_location tx_location{record,
+            static_cast<uint32_t>(tx_data.begin() - raw_block->data()),
+            static_cast<uint32_t>(tx_data.size())};
+        const hash_digest tx_hash = hash_transaction(block.transactions[i]);
+        write_record_hash(transaction_records, tx_hash);
+        transaction_records.write_4_bytes(tx_location.block);
+        transaction_records.write_4_bytes(tx_location.offset);
+        transaction_records.write_4_bytes(tx_location.size);
+        added.push_back(std::make_pair(tx_hash, tx_location));
+    }
+    serializer block_record;
+    write_record_hash(block_record, block_hash);
+    write_record_hash(block_record, block.prev_block);
+    block_record.write_4_bytes(block.bits);
+    block_record.write_4_bytes(location.file);
+    block_record.write_8_bytes(location.offset);
+    block_record.write_4_bytes(location.size);
+
+    // The block record goes last as it is what makes the rest count
+    const off_t transactions_end = lseek(transactions_index_fd_, 0, SEEK_END);
+    const data_chunk transaction_data = transaction_records.release_data(),
+        block_data = block_record.release_data();
+    if (!append(transactions_index_fd_, {data_view(transaction_data)}))
+        return false;
+    if (!append(blocks_index_fd_, {data_view(block_data)}))
+    {
+        if (ftruncate(transactions_index_fd_, transactions_end) != 0)
+            log_fatal() << "Unable to cut back transactions.index";
+        return false;
+    }
+    {
+        write_lock lock(index_mutex_);
+        blocks_[block_hash] = record;
+        records_.push_back(location);
+        transactions_.insert(added.begin(), added.end());
+    }
+    headers_->add(block_hash, block.prev_block, block.bits);
+    return true;
+}
+
+void flat_file_storage::organize(const message::block* latest)
+{
+    const hash_digest latest_hash =
+        latest == nullptr ? null_hash : hash_block_header(*latest);
+    bool changed = false;
+    hash_digest main_hash;
+    while (!connected_.empty() &&
+        !(headers_->main_chain_hash(connected_.size() - 1, main_hash) &&
+            main_hash == connected_.back()))
+    {
+        disconnect_top();
+        changed = true;
+    }
+    while (headers_->main_chain_hash(connected_.size(), main_hash))
+    {
+        // Genesis outputs can never be spent
+        if (connected_.empty())
+        {
+            connected_.push_back(main_hash);
+            changed = true;
+            continue;
+        }
+        if (failed_.contains(main_hash))
+            break;
+        message::block stored_block;
+        const message::block* current = latest;
+        if (main_hash != latest_hash)
+        {
+            if (!read_block(main_hash, stored_block))
+            {
+                log_error() << "Unable to read block " << hexlify(main_hash);
+                break;
+            }
+            current = &stored_block;
+        }
+        const size_t depth = connected_.size();
+        utxo_verify_block verifier(dialect_, verify_pool_, *unspent_,
+            *current, !assumed_valid(depth));
+        utxo_set::undo_list undo;
+        if (!check_checkpoints(checkpoints_.checkpoints, depth, main_hash) ||
+            !verifier.check() || !unspent_->connect(*current, undo))
+        {
+            log_warning() << "Block " << hexlify(main_hash)
+                << " at depth " << connected_.size() << " failed to verify";
+            failed_.insert(main_hash);
+            break;
+        }
+        connected_.push_back(main_hash);
+        changed = true;
+    }
+    if (!changed)
+        return;
+    unspent_->flush();
+    write_tip();
+    connected_size_ = connected_.size();
+}
+
+bool flat_file_storage::assumed_valid(size_t depth) const
+{
+    size_t assume_valid_depth;
+    return checkpoints_.assume_valid != null_hash &&
+        headers_->is_main_chain(checkpoints_.assume_valid,
+            assume_valid_depth) && depth <= assume_valid_depth;
+}
+
+void flat_file_storage::disconnect_top()
+{
+    const hash_digest top_hash = connected_.back();
+    connected_.pop_back();
+    if (connected_.empty())
+        return;
+    message::block block;
+    if (!read_block(top_hash, block))
+    {
+        log_fatal() << "disconnect_top() failed for block "
+            << hexlify(top_hash);
+        return;
+    }
+    // Same order as utxo_set::connect() recorded them
+    utxo_set::undo_list undo;
+    for (const message::transaction& tx: block.transactions)
+        if (!is_coinbase(tx))
+            for (const message::transaction_input& input: tx.inputs)
+            {
+                output_point point{input.hash, input.index};
+                unspent_output output;
+                if (load_spent_output(point, output))
+                    undo.push_back(std::make_pair(point, std::move(output)));
+            }
+    unspent_->disconnect(block, undo);
+}
+
+void flat_file_storage::write_tip()
+{
+    serializer record;
+    record.write_byte(spent_tip_record);
+    write_record_hash(record,
+        connected_.empty() ? null_hash : connected_.back());
+    record.write_4_bytes(connected_.size());
+    record.write_byte(0);
+    const data_chunk data = record.release_data();
+    if (!append(spent_log_fd_, {data_view(data)}))
+        log_error() << "Unable to write to spent.log";
+}
+
+bool flat_file_storage::find_block(const hash_digest& block_hash,
+        block_location& location) const
+{
+    read_lock lock(index_mutex_);
+    const uint32_t* record = blocks_.find(block_hash);
+    if (record == nullptr)
+        return false;
+    location = records_[*record];
+    return true;
+}
+
+bool flat_file_storage::read_payload(const block_location& location,
+        uint64_t offset, size_t size, data_chunk& payload)
+{
+    if (offset + size > location.size)
+        return false;
+    const uint64_t begin = location.offset + offset, end = begin + size;
+    mapped_file_ptr mapping;
+    {
+        std::lock_guard<std::mutex> lock(mappings_mutex_);
+        if (mappings_.size() <= location.file)
+            mappings_.resize(location.file + 1);
+        mapped_file_ptr& current = mappings_[location.file];
+        // The writer has appended since this file was mapped
+        if (!current || current->size() < end)
+            current = std::make_shared<mapped_file>(
+                block_file_path(location.file));
+        mapping = current;
+    }
+    if (mapping->size() < end)
+        return false;
+    payload.assign(mapping->data() + begin, mapping->data() + end);
+    return true;
+}
+
+bool flat_file_storage::read_block(const hash_digest& block_hash,
+        message::block& block)
+{
+    block_location location;
+    data_chunk payload;
+    if (!find_block(block_hash, location) ||
+            !read_payload(location, 0, location.size, payload))
+        return false;
+    lazy_block lazy(std::move(payload));
+    if (!lazy.valid())
+        return false;
+    block = lazy.decode();
+    return true;
+}
+
+bool flat_file_storage::load_transaction(
+        const transaction_location& location, message::transaction& tx)
+{
+    block_location block;
+    {
+        read_lock lock(index_mutex_);
+        if (location.block >= records_.size())
+            return false;
+        block = records_[location.block];
+    }
+    data_chunk data;
+    if (!read_payload(block, location.offset, location.size, data))
+        return false;
+    deserializer deserial(data);
+    tx = read_transaction(deserial);
+    return true;
+}
+
+bool flat_file_storage::read_output(const transaction_location& location,
+        uint32_t index, unspent_output& output)
+{
+    message::transaction tx;
+    if (!load_transaction(location, tx) || index >= tx.outputs.size())
+        return false;
+    output.value = tx.outputs[index].value;
+    output.raw_script = save_script(tx.outputs[index].output_script);
+    return true;
+}
+
+std::vector<flat_file_storage::transaction_location>
+    flat_file_storage::find_transaction(const hash_digest& tx_hash) const
+{
+    std::vector<transaction_location> locations;
+    read_lock lock(index_mutex_);
+    auto range = transactions_.equal_range(tx_hash);
+    for (auto it = range.first; it != range.second; ++it)
+        locations.push_back(it->second);
+    return locations;
+}
+
+bool flat_file_storage::is_connected(uint32_t record) const
+{
+    hash_digest block_hash;
+    {
+        read_lock lock(index_mutex_);
+        block_hash = records_[record].hash;
+    }
+    header_index::entry block_entry;
+    return headers_->find(block_hash, block_entry) && block_entry.linked &&
+        block_entry.depth < connected_.size() &&
+        connected_[block_entry.depth] == block_hash;
+}
+
+bool flat_file_storage::load_output(
+    const output_point& point, unspent_output& output)
+{
+    // Outputs only count once their transaction is on the connected chain
+    if (spent_.count(point) > 0)
+        return false;
+    for (const transaction_location& location: find_transaction(point.hash))
+        if (is_connected(location.block))
+            return read_output(location, point.index, output);
+    return false;
+}
+
+bool flat_file_storage::load_spent_output(
+    const output_point& point, unspent_output& output)
+{
+    for (const transaction_location& location: find_transaction(point.hash))
+        if (read_output(location, point.index, output))
+            return true;
+    return false;
+}
+
+void flat_file_storage::flush_spends(const utxo_set::change_list& changes)
+{
+    serializer records;
+    for (const auto& change: changes)
+    {
+        records.write_byte(spent_change_record);
+        write_record_hash(records, change.first.hash);
+        records.write_4_bytes(change.first.index);
+        records.write_byte(change.second ? 1 : 0);
+        if (change.second)
+            spent_.insert(change.first);
+        else
+            spent_.erase(change.first);
+    }
+    const data_chunk data = records.release_data();
+    if (!append(spent_log_fd_, {data_view(data)}))
+        log_error() << "Unable to write to spent.log";
+}
+
+size_t flat_file_storage::connected_size() const
+{
+    return connected_size_;
+}
+
+size_t flat_file_storage::unspent_bytes() const
+{
+    return unspent_->bytes();
+}
+
+void flat_file_storage::set_unspent_max_bytes(size_t max_bytes)
+{
+    unspent_->set_max_bytes(max_bytes);
+}
+
+size_t flat_file_storage::headers_bytes() const
+{
+    return headers_->bytes();
+}
+
+void flat_file_storage::set_checkpoints(const chain_checkpoints& checkpoints)
+{
+    strand()->post(std::bind(
+        &flat_file_storage::do_set_checkpoints, shared_from_this(),
+            checkpoints));
+}
+void flat_file_storage::do_set_checkpoints(
+    const chain_checkpoints& checkpoints)
+{
+    checkpoints_ = checkpoints;
+}
+
+void flat_file_storage::store(const message::inv&,
+        store_handler handle_store)
+{
+    // Nothing to keep, peers are asked for what is missing directly
+    strand()->post(std::bind(handle_store, std::error_code()));
+}
+
+void flat_file_storage::store(const message::transaction&,
+        store_handler handle_store)
+{
+    // Loose transactions have no block file to go in
+    strand()->post(std::bind(handle_store, error::unsupported_operation));
+}
+
+void flat_file_storage::store(message::block_ptr block,
+        store_handler handle_store)
+{
+    strand()->post(std::bind(
+        &flat_file_storage::do_store_block, shared_from_this(),
+            block, handle_store));
+}
+void flat_file_storage::do_store_block(message::block_ptr block,
+        store_handler handle_store)
+{
+    const hash_digest block_hash = hash_block_header(*block);
+    if (headers_->contains(block_hash))
+    {
+        handle_store(error::object_already_exists);
+        return;
+    }
+    // Free for blocks the kernel already checked
+    if (!block->context_checked.passed() &&
+            !check_block_context_free(*block, verify_pool_.get()))
+    {
+        handle_store(error::invalid_block);
+        return;
+    }
+    if (!write_block(block_hash, *block))
+    {
+        log_error() << "Unable to write block " << hexlify(block_hash);
+        handle_store(error::write_failed);
+        return;
+    }
+    organize(block.get());
+    handle_store(std::error_code());
+}
+
+void flat_file_storage::fetch_inventories(
+        fetch_handler_inventories handle_fetch)
+{
+    strand()->post(std::bind(handle_fetch,
+        error::object_doesnt_exist, message::inv_list()));
+}
+
+void flat_file_storage::fetch_block_by_depth(size_t block_number,
+        fetch_handler_block handle_fetch)
+{
+    reader_threads_->service()->post(std::bind(
+        &flat_file_storage::do_fetch_block_by_depth, shared_from_this(),
+            block_number, handle_fetch));
+}
+void flat_file_storage::do_fetch_block_by_depth(size_t block_number,
+        fetch_handler_block handle_fetch)
+{
+    hash_digest block_hash;
+    message::block block;
+    if (!headers_->main_chain_hash(block_number, block_hash) ||
+            !read_block(block_hash, block))
+    {
+        handle_fetch(error::object_doesnt_exist, message::block());
+        return;
+    }
+    handle_fetch(std::error_code(), block);
+}
+
+void flat_file_storage::fetch_block_by_hash(hash_digest block_hash,
+        fetch_handler_block handle_fetch)
+{
+    reader_threads_->service()->post(std::bind(
+        &flat_file_storage::do_fetch_block_by_hash, shared_from_this(),
+            block_hash, handle_fetch));
+}
+void flat_file_storage::do_fetch_block_by_hash(hash_digest block_hash,
+        fetch_handler_block handle_fetch)
+{
+    message::block block;
+    if (!read_block(block_hash, block))
+    {
+        handle_fetch(error::object_doesnt_exist, message::block());
+        return;
+    }
+    handle_fetch(std::error_code(), block);
+}
+
+void flat_file_storage::fetch_blocks_by_depth_range(size_t begin,
+        size_t end, fetch_handler_blocks handle_fetch)
+{
+    reader_threads_->service()->post(std::bind(
+        &flat_file_storage::do_fetch_blocks_by_depth_range,
+            shared_from_this(), begin, end, handle_fetch));
+}
+void flat_file_storage::do_fetch_blocks_by_depth_range(size_t begin,
+        size_t end, fetch_handler_blocks handle_fetch)
+{
+    message::block_list blocks;
+    hash_digest block_hash;
+    for (size_t depth = begin; depth < end &&
+            headers_->main_chain_hash(depth, block_hash); ++depth)
+    {
+        message::block block;
+        if (!read_block(block_hash, block))
+            break;
+        blocks.push_back(std::move(block));
+    }
+    if (blocks.empty())
+        handle_fetch(error::object_doesnt_exist, blocks);
+    else
+        handle_fetch(std::error_code(), blocks);
+}
+
+void flat_file_storage::fetch_raw_block_by_hash(hash_digest block_hash,
+        fetch_handler_raw_block handle_fetch)
+{
+    reader_threads_->service()->post(std::bind(
+        &flat_file_storage::do_fetch_raw_block_by_hash, shared_from_this(),
+            block_hash, handle_fetch));
+}
+void flat_file_storage::do_fetch_raw_block_by_hash(hash_digest block_hash,
+        fetch_handler_raw_block handle_fetch)
+{
+    block_location location;
+    data_chunk payload;
+    if (!find_block(block_hash, location) ||
+            !read_payload(location, 0, location.size, payload))
+    {
+        handle_fetch(error::object_doesnt_exist, data_chunk_ptr());
+        return;
+    }
+    handle_fetch(std::error_code(),
+        std::make_shared<const data_chunk>(std::move(payload)));
+}
+
+void flat_file_storage::fetch_block_locator(
+        fetch_handler_block_locator handle_fetch)
+{
+    reader_threads_->service()->post(std::bind(
+        &flat_file_storage::do_fetch_block_locator, shared_from_this(),
+            handle_fetch));
+}
+void flat_file_storage::do_fetch_block_locator(
+        fetch_handler_block_locator handle_fetch)
+{
+    message::block_locator locator = headers_->locator();
+    if (locator.empty())
+    {
+        handle_fetch(error::object_doesnt_exist, locator);
+        return;
+    }
+    handle_fetch(std::error_code(), locator);
+}
+
+void flat_file_storage::fetch_output_by_hash(hash_digest transaction_hash,
+        uint32_t index, fetch_handler_output handle_fetch)
+{
+    reader_threads_->service()->post(std::bind(
+        &flat_file_storage::do_fetch_output_by_hash, shared_from_this(),
+            transaction_hash, index, handle_fetch));
+}
+void flat_file_storage::do_fetch_output_by_hash(hash_digest transaction_hash,
+        uint32_t index, fetch_handler_output handle_fetch)
+{
+    // Every copy of a transaction is the same, so any block will do
+    std::vector<transaction_location> locations =
+        find_transaction(transaction_hash);
+    message::transaction tx;
+    if (locations.empty() || !load_transaction(locations.front(), tx) ||
+            index >= tx.outputs.size())
+    {
+        handle_fetch(error::object_doesnt_exist,
+            message::transaction_output());
+        return;
+    }
+    handle_fetch(std::error_code(), tx.outputs[index]);
+}
+
+void flat_file_storage::fetch_outputs(const output_point_list& points,
+        fetch_handler_outputs handle_fetch)
+{
+    reader_threads_->service()->post(std::bind(
+        &flat_file_storage::do_fetch_outputs, shared_from_this(),
+            points, handle_fetch));
+}
+void flat_file_storage::do_fetch_outputs(const output_point_list& points,
+        fetch_handler_outputs handle_fetch)
+{
+    // Outputs spent together often share a transaction, so each is
+    // read out of its block only once
+    std::unordered_map<hash_digest, message::transaction, hash_digest_hasher> read;
+    message::transaction_output_list outputs(points.size());
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        const output_point& point = points[i];
+        auto it = read.find(point.hash);
+        if (it == read.end())
+        {
+            std::vector<transaction_location> locations =
+                find_transaction(point.hash);
+            message::transaction tx;
+            if (!locations.empty() && load_transaction(locations.front(), tx))
+                it = read.insert(std::make_pair(point.hash, tx)).first;
+        }
+        if (it != read.end() && point.index < it->second.outputs.size())
+            outputs[i] = it->second.outputs[point.index];
+        else
+            missing.push_back(i);
+    }
+    handle_fetch(std::error_code(), outputs, missing);
+}
+
+void flat_file_storage::fetch_unspent_outputs(const output_point_list& points,
+        fetch_handler_outputs handle_fetch)
+{
+    // Spent flags only change on the strand, so read them there
+    strand()->post(std::bind(
+        &flat_file_storage::do_fetch_unspent_outputs, shared_from_this(),
+            points, handle_fetch));
+}
+void flat_file_storage::do_fetch_unspent_outputs(
+        const output_point_list& points, fetch_handler_outputs handle_fetch)
+{
+    message::transaction_output_list outputs(points.size());
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        unspent_output output;
+        if (unspent_->fetch(points[i], output))
+        {
+            outputs[i].value = output.value;
+            outputs[i].output_script = parse_script(output.raw_script);
+        }
+        else
+            missing.push_back(i);
+    }
+    handle_fetch(std::error_code(), outputs, missing);
+}
+
+void flat_file_storage::fetch_outputs_by_pubkey_hash(const short_hash&,
+        fetch_handler_address_outputs handle_fetch)
+{
+    // Block files are only indexed by block and transaction hash
+    strand()->post(std::bind(handle_fetch, error::unsupported_operation,
+        address_output_list()));
+}
+
+void flat_file_storage::block_exists_by_hash(hash_digest block_hash,
+        exists_handler handle_exists)
+{
+    reader_threads_->service()->post(std::bind(
+        &flat_file_storage::do_block_exists_by_hash, shared_from_this(),
+            block_hash, handle_exists));
+}
+void flat_file_storage::do_block_exists_by_hash(hash_digest block_hash,
+        exists_handler handle_exists)
+{
+    handle_exists(std::error_code(), headers_->contains(block_hash));
+}
+
+void flat_file_storage::blocks_exist(const hash_list& block_hashes,
+        exists_list_handler handle_exists)
+{
+    reader_threads_->service()->post(std::bind(
+        &flat_file_storage::do_blocks_exist, shared_from_this(),
+            block_hashes, handle_exists));
+}
+void flat_file_storage::do_blocks_exist(const hash_list& block_hashes,
+        exists_list_handler handle_exists)
+{
+    std::vector<bool> exists;
+    exists.reserve(block_hashes.size());
+    for (const hash_digest& block_hash: block_hashes)
+        exists.push_back(headers_->contains(block_hash));
+    handle_exists(std::error_code(), exists);
+}
+
+} // libbitcoin
+
@@ -1,8 +1,18 @@
 #include "postgresql_blockchain.hpp"
 
+#include <map>
+
+#include <bitcoin/block.hpp>
+#include <bitcoin/compressed_output.hpp>
 #include <bitcoin/dialect.hpp>
+#include <bitcoin/header_index.hpp>
+#include <bitcoin/transaction.hpp>
 #include <bitcoin/util/assert.hpp>
 #include <bitcoin/util/logger.hpp>
+#include <bitcoin/util/metrics.hpp>
+#include <bitcoin/util/ripemd.hpp>
+#include <bitcoin/util/thread_pool.hpp>
+#include <bitcoin/util/trace.hpp>
 
 namespace libbitcoin {
 
@@ -281,103 +291,199 @@ void postgresql_organizer::position_child_branch(
     statement.exec();
 }
 
+postgresql_chain_organizer::postgresql_chain_organizer(cppdb::session sql,
+    header_index_ptr headers)
+  : sql_(sql), headers_(headers)
+{
+    cppdb::result result = sql_ <<
+        "SELECT block_hash, depth \
+        FROM blocks \
+        WHERE space=0 \
+        ORDER BY depth ASC";
+    while (result.next())
+    {
+        BITCOIN_ASSERT(result.get<size_t>("depth") == chain_.size());
+        chain_.push_back(read_hash(result, "block_hash"));
+    }
+}
+
+const header_index& postgresql_chain_organizer::headers() const
+{
+    return *headers_;
+}
+
+bool postgresql_chain_organizer::organize(size_t& fork_depth,
+    std::vector<size_t>& demoted_ids)
+{
+    // Runs on the writer thread, so the index cannot move underneath us.
+    // Orphans wait inside the index keyed by their missing parent and
+    // only reach its main chain once linked, so no scan is needed here.
+    size_t top_depth = headers_->top_depth();
+    if (chain_.empty() || headers_->size() == 0)
+        return false;
+    fork_depth = std::min(chain_.size() - 1, top_depth);
+    hash_digest hash;
+    while (fork_depth > 0 && !(headers_->main_chain_hash(fork_depth, hash)
+            && hash == chain_[fork_depth]))
+        --fork_depth;
+    if (fork_depth == top_depth && fork_depth + 1 == chain_.size())
+        return false;
+    cppdb::transaction guard(sql_);
+    demoted_ids = demote(fork_depth);
+    promote(fork_depth, top_depth);
+    guard.commit();
+    return true;
+}
+
+std::vector<size_t> postgresql_chain_organizer::demote(size_t fork_depth)
+{
+    static cppdb::statement statement = sql_.prepare(
+        "UPDATE blocks \
+        SET \
+            space=nextval('blocks_space_sequence'), \
+            block_status='orphan' \
+        FROM ( \
+            SELECT block_id, block_status \
+            FROM blocks \
+            WHERE block_hash=? \
+        ) AS old \
+        WHERE blocks.block_id=old.block_id \
+        RETURNING old.block_id, old.block_status"
+        );
+    std::vector<size_t> verified_ids;
+    for (size_t depth = chain_.size() - 1; depth > fork_depth; --depth)
+    {
+        statement.reset();
+        binary_parameter hash(chain_[depth]);
+        statement.bind(hash);
+        cppdb::result result = statement.row();
+        BITCOIN_ASSERT(!result.empty());
+        if (!result.empty() && result.get<std::string>(1) == "verified")
+            verified_ids.push_back(result.get<size_t>(0));
+    }
+    chain_.resize(fork_depth + 1);
+    return verified_ids;
+}
+
+void postgresql_chain_organizer::promote(size_t fork_depth, size_t top_depth)
+{
+    std::vector<hash_digest> hashes;
+    hash_digest hash;
+    for (size_t depth = fork_depth + 1;
+            depth <= top_depth && headers_->main_chain_hash(depth, hash);
+            ++depth)
+        hashes.push_back(hash);
+    bulk_execute(sql_,
+        "UPDATE blocks \
+        SET \
+            space=0, \
+            depth=changes.depth, \
+            prev_block_id=( \
+                SELECT parent.block_id \
+                FROM blocks parent \
+                WHERE parent.block_hash=blocks.prev_block_hash \
+            ) \
+        FROM (VALUES ",
+        "(?::bytea, ?::int)",
+        ") AS changes(hash, depth) \
+        WHERE blocks.block_hash=changes.hash",
+        hashes.size(),
+        [&](cppdb::statement& statement, size_t i)
+        {
+            binary_parameter hash(hashes[i]);
+            statement.bind(hash);
+            statement.bind(fork_depth + 1 + i);
+        });
+    chain_.insert(chain_.end(), hashes.begin(), hashes.end());
+}
+
 postgresql_reader::postgresql_reader(cppdb::session sql)
   : sql_(sql)
 {
 }
 
-script postgresql_reader::select_script(size_t script_id)
+// A block loads in three queries, one each for its transactions, inputs
+// and outputs. Rows carry index_in_block so they drop straight into place.
+// Readers are used from several sessions, so statements come from each
+// session's own prepared statement cache rather than function statics.
+
+void postgresql_reader::read_transactions(size_t block_id,
+        message::transaction_list& transactions)
 {
-    static cppdb::statement statement = sql_.prepare(
-        "SELECT \
-            opcode, \
-            data \
-        FROM operations \
-        WHERE script_id=? \
-        ORDER BY operation_id ASC"
+    cppdb::statement statement = sql_.prepare(
+        "SELECT transactions.* \
+        FROM transactions_parents \
+        JOIN transactions \
+        ON transactions.transaction_id=transactions_parents.transaction_id \
+        WHERE block_id=? \
+        ORDER BY index_in_block ASC"
         );
     statement.reset();
-    statement.bind(script_id);
+    statement.bind(block_id);
     cppdb::result result = statement.query();
-    script scr;
     while (result.next())
     {
-        operation op;
-        op.code = string_to_opcode(result.get<std::string>("opcode"));
-        if (!result.is_null("data"))
-            op.data = deserialize_bytes(result.get<std::string>("data"));
-        scr.push_operation(op);
+        message::transaction transaction;
+        transaction.version = result.get<uint32_t>("version");
+        transaction.locktime = result.get<uint32_t>("locktime");
+        transaction.cached_hash.set(read_hash(result, "transaction_hash"));
+        transactions.push_back(std::move(transaction));
     }
-    return scr;
 }
 
-message::transaction_input_list postgresql_reader::select_inputs(
-        size_t transaction_id)
+void postgresql_reader::read_inputs(size_t block_id,
+        message::transaction_list& transactions)
 {
-    static cppdb::statement statement = sql_.prepare(
-        "SELECT * \
-        FROM inputs \
-        WHERE transaction_id=? \
-        ORDER BY index_in_parent ASC"
+    cppdb::statement statement = sql_.prepare(
+        "SELECT inputs.*, index_in_block \
+        FROM transactions_parents \
+        JOIN inputs \
+        ON inputs.transaction_id=transactions_parents.transaction_id \
+        WHERE block_id=? \
+        ORDER BY index_in_block ASC, index_in_parent ASC"
         );
     statement.reset();
-    statement.bind(transaction_id);
+    statement.bind(block_id);
     cppdb::result result = statement.query();
-    message::transaction_input_list inputs;
     while (result.next())
     {
+        size_t index_in_block = result.get<size_t>("index_in_block");
+        BITCOIN_ASSERT(index_in_block < transactions.size());
         message::transaction_input input;
-        input.hash = 
-            deserialize_hash(result.get<std::string>("previous_output_hash"));
+        input.hash = read_hash(result, "previous_output_hash");
         input.index = result.get<uint32_t>("previous_output_index");
-        size_t script_id = result.get<size_t>("script_id");
-        input.input_script = select_script(script_id);
+        input.input_script = parse_script(read_bytes(result, "script"));
         input.sequence = result.get<uint32_t>("sequence");
-        inputs.push_back(input);
+        transactions[index_in_block].inputs.push_back(std::move(input));
     }
-    return inputs;
 }
-message::transaction_output_list postgresql_reader::select_outputs(
-        size_t transaction_id)
+
+void postgresql_reader::read_outputs(size_t block_id,
+        message::transaction_list& transactions)
 {
-    static cppdb::statement statement = sql_.prepare(
+    cppdb::statement statement = sql_.prepare(
         "SELECT \
-            *, \
+            outputs.*, \
+            index_in_block, \
             sql_to_internal(value) internal_value \
-        FROM outputs \
-        WHERE transaction_id=? \
-        ORDER BY index_in_parent ASC"
+        FROM transactions_parents \
+        JOIN outputs \
+        ON outputs.transaction_id=transactions_parents.transaction_id \
+        WHERE block_id=? \
+        ORDER BY index_in_block ASC, index_in_parent ASC"
         );
     statement.reset();
-    statement.bind(transaction_id);
+    statement.bind(block_id);
     cppdb::result result = statement.query();
-    message::transaction_output_list outputs;
     while (result.next())
     {
+        size_t index_in_block = result.get<size_t>("index_in_block");
+        BITCOIN_ASSERT(index_in_block < transactions.size());
         message::transaction_output output;
         output.value = result.get<uint64_t>("internal_value");
-        size_t script_id = result.get<size_t>("script_id");
-        output.output_script = select_script(script_id);
-        outputs.push_back(output);
+        output.output_script = parse_script(read_bytes(result, "script"));
+        transactions[index_in_block].outputs.push_back(std::move(output));
     }
-    return outputs;
-}
-
-message::transaction_list postgresql_reader::read_transactions(
-        cppdb::result result)
-{
-    message::transaction_list transactions;
-    while (result.next())
-    {
-        message::transaction transaction;
-        transaction.version = result.get<uint32_t>("version");
-        transaction.locktime = result.get<uint32_t>("locktime");
-        size_t transaction_id = result.get<size_t>("transaction_id");
-        transaction.inputs = select_inputs(transaction_id);
-        transaction.outputs = select_outputs(transaction_id);
-        transactions.push_back(transaction);
-    }
-    return transactions;
 }
 
 message::block postgresql_reader::read_block(cppdb::result block_result)
@@ -392,25 +498,394 @@ message::block postgresql_reader::read_block(cppdb::result block_result)
     block.nonce = block_result.get<uint32_t>("nonce");
 
     block.prev_block = 
-            deserialize_hash(block_result.get<std::string>("prev_block_hash"));
+            read_hash(block_result, "prev_block_hash");
     block.merkle_root = 
-            deserialize_hash(block_result.get<std::string>("merkle"));
+            read_hash(block_result, "merkle");
+    block.cached_hash.set(read_hash(block_result, "block_hash"));
 
-    static cppdb::statement transactions_statement = sql_.prepare(
-        "SELECT transactions.* \
-        FROM transactions_parents \
-        JOIN transactions \
-        ON transactions.transaction_id=transactions_parents.transaction_id \
-        WHERE block_id=? \
-        ORDER BY index_in_block ASC"
-        );
-    transactions_statement.reset();
-    transactions_statement.bind(block_id);
-    cppdb::result transactions_result = transactions_statement.query();
-    block.transactions = read_transactions(transactions_result);
+    read_transactions(block_id, block.transactions);
+    read_inputs(block_id, block.transactions);
+    read_outputs(block_id, block.transactions);
     return block;
 }
 
+postgresql_background_loop::postgresql_background_loop(
+    round_handler round, time_duration interval)
+  : round_(round), interval_(interval),
+    thread_(std::make_shared<thread_pool>(1)), service_(thread_->service())
+{
+    timer_.reset(new deadline_timer(*service_));
+    wait(seconds(0));
+}
+
+postgresql_background_loop::~postgresql_background_loop()
+{
+    // Stops and joins the thread so no round is running. The timer goes
+    // next, while service_ still keeps the io_service it was built on.
+    thread_.reset();
+}
+
+void postgresql_background_loop::wait(time_duration delay)
+{
+    timer_->expires_from_now(delay);
+    timer_->async_wait(
+        std::bind(&postgresql_background_loop::run, this, _1));
+}
+
+void postgresql_background_loop::run(const boost::system::error_code& ec)
+{
+    if (ec)
+        return;
+    if (round_())
+        wait(seconds(0));
+    else
+        wait(interval_);
+}
+
+constexpr size_t postgresql_pruner::min_keep_blocks;
+// Between rounds once there is nothing left to prune
+const time_duration prune_interval = seconds(10);
+// Blocks looked up per round
+constexpr size_t prune_batch_size = 16;
+
+// Transactions of the block that no other block also includes
+static const std::string owned_transactions =
+    "WITH owned AS ( \
+        SELECT transaction_id \
+        FROM transactions_parents parent \
+        WHERE \
+            block_id=? \
+            AND NOT EXISTS ( \
+                SELECT 1 \
+                FROM transactions_parents other \
+                WHERE \
+                    other.transaction_id=parent.transaction_id \
+                    AND other.block_id<>parent.block_id \
+            ) \
+    ) ";
+
+postgresql_pruner::postgresql_pruner(const std::string& connect_string,
+    size_t keep_blocks, uint64_t byte_budget)
+  : sql_(connect_string),
+    keep_blocks_(std::max(keep_blocks, min_keep_blocks)),
+    byte_budget_(byte_budget),
+    // A full batch means there is probably more
+    loop_([this]() { return prune_batch() == prune_batch_size; },
+        prune_interval)
+{
+}
+
+size_t postgresql_pruner::prune_batch()
+{
+    if (byte_budget_ > 0)
+    {
+        cppdb::result size_result = sql_ <<
+            "SELECT pg_database_size(current_database())" << cppdb::row;
+        if (size_result.get<uint64_t>(0) <= byte_budget_)
+            return 0;
+    }
+    cppdb::statement statement = sql_.prepare(
+        "SELECT block_id \
+        FROM blocks \
+        WHERE \
+            space=0 \
+            AND depth>0 \
+            AND NOT pruned \
+            AND depth + ? <= ( \
+                SELECT COALESCE(MAX(depth), 0) \
+                FROM blocks \
+                WHERE \
+                    space=0 \
+                    AND block_status='verified' \
+            ) \
+        ORDER BY depth ASC \
+        LIMIT ?"
+        );
+    statement.bind(keep_blocks_);
+    statement.bind(prune_batch_size);
+    cppdb::result result = statement.query();
+    std::vector<size_t> block_ids;
+    while (result.next())
+        block_ids.push_back(result.get<size_t>("block_id"));
+    static counter& blocks_pruned =
+        shared_metrics().get_counter("blockchain.blocks_pruned");
+    for (size_t block_id: block_ids)
+    {
+        prune_block(block_id);
+        blocks_pruned.add();
+    }
+    return block_ids.size();
+}
+
+void postgresql_pruner::prune_block(size_t block_id)
+{
+    cppdb::transaction guard(sql_);
+    // Nothing can spend an output again once the input that spent it
+    // is this deep, so those go along with the inputs. Their
+    // transactions may be left with no outputs.
+    std::vector<size_t> candidates;
+    cppdb::statement spent = sql_.prepare(owned_transactions +
+        "DELETE FROM outputs \
+        USING owned, inputs, transactions \
+        WHERE \
+            inputs.transaction_id=owned.transaction_id \
+            AND transactions.transaction_hash=inputs.previous_output_hash \
+            AND outputs.transaction_id=transactions.transaction_id \
+            AND outputs.index_in_parent=inputs.previous_output_index \
+        RETURNING outputs.transaction_id");
+    spent.bind(block_id);
+    cppdb::result spent_result = spent.query();
+    while (spent_result.next())
+        candidates.push_back(spent_result.get<size_t>(0));
+    cppdb::statement inputs = sql_.prepare(owned_transactions +
+        "DELETE FROM inputs \
+        USING owned \
+        WHERE inputs.transaction_id=owned.transaction_id");
+    inputs.bind(block_id);
+    inputs.exec();
+    // Coinbases have no inputs, so take every owned transaction
+    cppdb::statement owned = sql_.prepare(owned_transactions +
+        "SELECT transaction_id FROM owned");
+    owned.bind(block_id);
+    cppdb::result owned_result = owned.query();
+    while (owned_result.next())
+        candidates.push_back(owned_result.get<size_t>(0));
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()),
+        candidates.end());
+    // Transactions with every output gone are not needed any more
+    bulk_execute(sql_,
+        "WITH candidates(transaction_id) AS (VALUES ",
+        "(?::int)",
+        "), emptied AS ( \
+            DELETE FROM transactions \
+            USING candidates \
+            WHERE \
+                transactions.transaction_id=candidates.transaction_id \
+                AND NOT EXISTS ( \
+                    SELECT 1 \
+                    FROM outputs \
+                    WHERE outputs.transaction_id=transactions.transaction_id \
+                ) \
+            RETURNING transactions.transaction_id \
+        ) \
+        DELETE FROM transactions_parents \
+        USING emptied \
+        WHERE transactions_parents.transaction_id=emptied.transaction_id",
+        candidates.size(),
+        [&](cppdb::statement& statement, size_t i)
+        {
+            statement.bind(candidates[i]);
+        });
+    cppdb::statement raw = sql_.prepare(
+        "DELETE FROM raw_blocks WHERE block_id=?");
+    raw.bind(block_id);
+    raw.exec();
+    // Far too deep to be taken off the chain again
+    cppdb::statement undo = sql_.prepare(
+        "DELETE FROM block_undo WHERE block_id=?");
+    undo.bind(block_id);
+    undo.exec();
+    cppdb::statement mark = sql_.prepare(
+        "UPDATE blocks SET pruned=TRUE WHERE block_id=?");
+    mark.bind(block_id);
+    mark.exec();
+    guard.commit();
+}
+
+// Between rounds once the index has caught up
+const time_duration address_index_interval = seconds(5);
+// Blocks indexed per SQL transaction
+constexpr size_t address_index_batch_size = 32;
+
+constexpr size_t pubkey_hash_size = 20;
+constexpr size_t compressed_pubkey_size = 33;
+constexpr size_t uncompressed_pubkey_size = 65;
+constexpr uint8_t op_dup = 0x76, op_hash160 = 0xa9, op_equalverify = 0x88,
+    op_checksig = 0xac;
+
+bool extract_pubkey_hash(const data_chunk& raw_script,
+    short_hash& pubkey_hash)
+{
+    // The bytes are matched exactly, since script::type() only
+    // compares sizes
+    if (raw_script.size() == 5 + pubkey_hash_size &&
+            raw_script[0] == op_dup && raw_script[1] == op_hash160 &&
+            raw_script[2] == pubkey_hash_size &&
+            raw_script[23] == op_equalverify && raw_script[24] == op_checksig)
+    {
+        std::copy(raw_script.begin() + 3, raw_script.begin() + 23,
+            pubkey_hash.begin());
+        return true;
+    }
+    for (size_t key_size: {compressed_pubkey_size, uncompressed_pubkey_size})
+        if (raw_script.size() == 2 + key_size && raw_script[0] == key_size &&
+                raw_script.back() == op_checksig)
+        {
+            pubkey_hash = generate_ripemd_hash(
+                data_chunk(raw_script.begin() + 1, raw_script.end() - 1));
+            return true;
+        }
+    return false;
+}
+
+postgresql_address_indexer::postgresql_address_indexer(
+    const std::string& connect_string)
+  : sql_(connect_string),
+    loop_([this]() { return index_batch() == address_index_batch_size; },
+        address_index_interval)
+{
+}
+
+size_t postgresql_address_indexer::index_batch()
+{
+    cppdb::result cursor = sql_ <<
+        "SELECT depth, block_id FROM address_index_cursor" << cppdb::row;
+    const int cursor_depth = cursor.get<int>("depth");
+    if (!cursor.is_null("block_id"))
+    {
+        cppdb::result on_main = sql_ <<
+            "SELECT 1 FROM blocks WHERE block_id=? AND space=0"
+            << cursor.get<size_t>("block_id") << cppdb::row;
+        if (on_main.empty())
+        {
+            // Keep going straight away until the fork is reached
+            rewind(cursor_depth);
+            return address_index_batch_size;
+        }
+    }
+    cppdb::statement blocks = sql_.prepare(
+        "SELECT block_id, depth \
+        FROM blocks \
+        WHERE \
+            space=0 \
+            AND depth > ? \
+            AND block_status='verified' \
+        ORDER BY depth ASC \
+        LIMIT ?"
+        );
+    blocks.bind(cursor_depth);
+    blocks.bind(address_index_batch_size);
+    cppdb::result blocks_result = blocks.query();
+    std::vector<std::pair<size_t, size_t>> batch;
+    while (blocks_result.next())
+        batch.push_back(std::make_pair(
+            blocks_result.get<size_t>("block_id"),
+            blocks_result.get<size_t>("depth")));
+    if (batch.empty())
+        return 0;
+    // Rows are (hash, output_id, block_id, depth)
+    typedef std::tuple<short_hash, size_t, size_t, size_t> address_row;
+    std::vector<address_row> rows;
+    cppdb::transaction guard(sql_);
+    for (const auto& block: batch)
+    {
+        cppdb::statement outputs = sql_.prepare(
+            "SELECT output_id, script \
+            FROM transactions_parents \
+            JOIN outputs \
+            ON outputs.transaction_id=transactions_parents.transaction_id \
+            WHERE block_id=?"
+            );
+        outputs.bind(block.first);
+        cppdb::result outputs_result = outputs.query();
+        short_hash pubkey_hash;
+        while (outputs_result.next())
+            if (extract_pubkey_hash(read_bytes(outputs_result, "script"),
+                    pubkey_hash))
+                rows.push_back(std::make_tuple(pubkey_hash,
+                    outputs_result.get<size_t>("output_id"),
+                    block.first, block.second));
+    }
+    bulk_insert(sql_,
+        "INSERT INTO address_outputs (pubkey_hash, output_id, block_id, depth)",
+        "(?, ?, ?, ?)",
+        rows.size(),
+        [&](cppdb::statement& statement, size_t i)
+        {
+            binary_parameter hash_repr(std::get<0>(rows[i]));
+            statement.bind(hash_repr);
+            statement.bind(std::get<1>(rows[i]));
+            statement.bind(std::get<2>(rows[i]));
+            statement.bind(std::get<3>(rows[i]));
+        });
+    cppdb::statement advance = sql_.prepare(
+        "UPDATE address_index_cursor SET depth=?, block_id=?");
+    advance.bind(batch.back().second);
+    advance.bind(batch.back().first);
+    advance.exec();
+    guard.commit();
+    static counter& blocks_indexed =
+        shared_metrics().get_counter("blockchain.blocks_indexed");
+    blocks_indexed.add(batch.size());
+    return batch.size();
+}
+
+void postgresql_address_indexer::rewind(size_t depth)
+{
+    cppdb::transaction guard(sql_);
+    cppdb::statement drop = sql_.prepare(
+        "DELETE FROM address_outputs WHERE depth >= ?");
+    drop.bind(depth);
+    drop.exec();
+    // Genesis is never reorganised away, so there is always a block
+    cppdb::statement step = sql_.prepare(
+        "UPDATE address_index_cursor \
+        SET \
+            depth=?, \
+            block_id=( \
+                SELECT block_id \
+                FROM blocks \
+                WHERE \
+                    space=0 \
+                    AND depth=? \
+            )"
+        );
+    step.bind(depth - 1);
+    step.bind(depth - 1);
+    step.exec();
+    guard.commit();
+}
+
+postgresql_reader_pool::postgresql_reader_pool(
+    const std::string& connect_string, size_t number_sessions)
+{
+    BITCOIN_ASSERT(number_sessions > 0);
+    for (size_t i = 0; i < number_sessions; ++i)
+    {
+        sessions_.push_back(cppdb::session(connect_string));
+        readers_.push_back(postgresql_reader(sessions_.back()));
+        free_.push_back(i);
+    }
+}
+
+postgresql_reader_pool::lease::lease(postgresql_reader_pool& pool)
+  : pool_(pool)
+{
+    std::unique_lock<std::mutex> lock(pool_.mutex_);
+    while (pool_.free_.empty())
+        pool_.released_.wait(lock);
+    index_ = pool_.free_.back();
+    pool_.free_.pop_back();
+}
+postgresql_reader_pool::lease::~lease()
+{
+    {
+        std::lock_guard<std::mutex> lock(pool_.mutex_);
+        pool_.free_.push_back(index_);
+    }
+    pool_.released_.notify_one();
+}
+
+cppdb::session& postgresql_reader_pool::lease::sql()
+{
+    return pool_.sessions_[index_];
+}
+postgresql_reader& postgresql_reader_pool::lease::reader()
+{
+    return pool_.readers_[index_];
+}
+
 postgresql_block_info postgresql_reader::read_block_info(
     cppdb::result result)
 {
@@ -424,54 +899,182 @@ postgresql_block_info postgresql_reader::read_block_info(
     };
 }
 
-postgresql_verify_block::postgresql_verify_block(cppdb::session sql, 
-    dialect_ptr dialect, const postgresql_block_info& block_info,
-    const message::block& current_block)
-  : verify_block(dialect, current_block), 
-    sql_(sql), block_info_(block_info), current_block_(current_block)
+postgresql_blockchain::postgresql_blockchain(
+        cppdb::session sql, service_ptr service, strand_ptr strand,
+        header_index_ptr headers)
+  : postgresql_chain_organizer(sql, headers), postgresql_reader(sql),
+    barrier_clearance_level_(2000), barrier_timeout_(milliseconds(500)), 
+    strand_(strand), sql_(sql)
 {
+    timeout_.reset(new deadline_timer(*service));
+    verify_pool_.reset(new thread_pool);
+    checkpoints_ = mainnet_checkpoints();
+    unspent_.reset(new utxo_set(
+        std::bind(&postgresql_blockchain::load_output, this, _1, _2),
+        std::bind(&postgresql_blockchain::flush_spends, this, _1)));
+    cppdb::result result = sql_ <<
+        "SELECT COALESCE(MAX(depth), 0) \
+        FROM blocks \
+        WHERE \
+            space=0 \
+            AND block_status='verified'"
+        << cppdb::row;
+    verified_depth_ = result.get<size_t>(0);
+    failed_depth_ = 0;
+    statistics_ = organizer_statistics{0, 0, 0, 0, 0, 0, 0, 0};
+    reset_state();
+    adapt();
 }
 
-bool postgresql_verify_block::check()
+static bool read_output(cppdb::statement& statement,
+    const output_point& point, unspent_output& output)
 {
-    if (!check_block())
+    statement.reset();
+    binary_parameter hash(point.hash);
+    statement.bind(hash);
+    statement.bind(point.index);
+    cppdb::result result = statement.row();
+    if (result.empty())
         return false;
+    output.value = result.get<uint64_t>("internal_value");
+    output.raw_script = read_bytes(result, "script");
     return true;
 }
 
-postgresql_blockchain::postgresql_blockchain(
-        cppdb::session sql, service_ptr service)
-  : postgresql_organizer(sql), postgresql_reader(sql),
-    barrier_clearance_level_(400), barrier_timeout_(milliseconds(500)), 
-    sql_(sql)
+bool postgresql_blockchain::load_output(
+    const output_point& point, unspent_output& output)
 {
-    timeout_.reset(new deadline_timer(*service));
-    reset_state();
+    // Outputs only count once a verified main chain block holds their
+    // transaction. Those of the block being verified come from connect()
+    // in order, so a block spending an output it creates later fails.
+    cppdb::statement statement = sql_.prepare(
+        "SELECT \
+            script, \
+            sql_to_internal(value) internal_value \
+        FROM transactions \
+        JOIN outputs \
+        ON outputs.transaction_id=transactions.transaction_id \
+        WHERE \
+            transaction_hash=? \
+            AND index_in_parent=? \
+            AND NOT spent \
+            AND EXISTS ( \
+                SELECT 1 \
+                FROM transactions_parents \
+                JOIN blocks \
+                ON blocks.block_id=transactions_parents.block_id \
+                WHERE \
+                    transactions_parents.transaction_id= \
+                        transactions.transaction_id \
+                    AND space=0 \
+                    AND block_status='verified' \
+            )"
+        );
+    return read_output(statement, point, output);
+}
+
+bool postgresql_blockchain::load_spent_output(
+    const output_point& point, unspent_output& output)
+{
+    cppdb::statement statement = sql_.prepare(
+        "SELECT \
+            script, \
+            sql_to_internal(value) internal_value \
+        FROM transactions \
+        JOIN outputs \
+        ON outputs.transaction_id=transactions.transaction_id \
+        WHERE \
+            transaction_hash=? \
+            AND index_in_parent=?"
+        );
+    return read_output(statement, point, output);
+}
+
+bool postgresql_blockchain::fetch_unspent(
+    const output_point& point, unspent_output& output)
+{
+    return unspent_->fetch(point, output);
+}
+
+void postgresql_blockchain::flush_spends(const utxo_set::change_list& changes)
+{
+    cppdb::transaction guard(sql_);
+    bulk_execute(sql_,
+        "UPDATE outputs \
+        SET spent=changes.spent \
+        FROM transactions, (VALUES ",
+        "(?::bytea, ?::bigint, ?::boolean)",
+        ") AS changes(hash, index_in_parent, spent) \
+        WHERE \
+            outputs.transaction_id=transactions.transaction_id \
+            AND transactions.transaction_hash=changes.hash \
+            AND outputs.index_in_parent=changes.index_in_parent",
+        changes.size(),
+        [&](cppdb::statement& statement, size_t i)
+        {
+            binary_parameter hash(changes[i].first.hash);
+            statement.bind(hash);
+            statement.bind(changes[i].first.index);
+            statement.bind(changes[i].second ? 1 : 0);
+        });
+    guard.commit();
 }
 
 void postgresql_blockchain::set_clearance(size_t clearance)
 {
     barrier_clearance_level_ = clearance;
+    adapt();
 }
 void postgresql_blockchain::set_timeout(time_duration timeout)
 {
     barrier_timeout_ = timeout;
+    adapt();
+}
+void postgresql_blockchain::set_checkpoints(
+    const chain_checkpoints& checkpoints)
+{
+    checkpoints_ = checkpoints;
+}
+
+// Running averages lean this far towards the newest sample
+constexpr double statistics_weight = 0.2;
+// Rough processing time one batch should take
+constexpr double batch_budget = 0.25;
+
+static double moving_average(double average, double sample)
+{
+    return average + statistics_weight * (sample - average);
+}
+
+static double elapsed_seconds(const boost::posix_time::ptime& since)
+{
+    return (microsec_clock::universal_time() - since)
+        .total_microseconds() / 1e6;
 }
 
 void postgresql_blockchain::raise_barrier()
 {
+    if (!last_arrival_.is_not_a_date_time())
+    {
+        std::lock_guard<std::mutex> lock(statistics_mutex_);
+        statistics_.arrival_interval = moving_average(
+            statistics_.arrival_interval, elapsed_seconds(last_arrival_));
+    }
+    last_arrival_ = microsec_clock::universal_time();
     barrier_level_++;
-    if (barrier_level_ > barrier_clearance_level_)
+    if (barrier_level_ >= statistics_.clearance)
     {
+        size_t batch_size = barrier_level_;
         reset_state();
-        start();
+        start(batch_size);
     }
     else if (!timer_started_)
     {
         timer_started_ = true;
-        timeout_->expires_from_now(barrier_timeout_);
-        timeout_->async_wait(std::bind( 
-            &postgresql_blockchain::start_exec, shared_from_this(), _1));
+        timeout_->expires_from_now(microseconds(static_cast<int64_t>(
+            statistics_.wait_seconds * 1e6)));
+        timeout_->async_wait(strand_->wrap(std::bind(
+            &postgresql_blockchain::start_exec, shared_from_this(), _1)));
     }
 }
 
@@ -484,23 +1087,157 @@ void postgresql_blockchain::reset_state()
 
 void postgresql_blockchain::start_exec(const boost::system::error_code& ec)
 {
-    reset_state();
+    // A cancelled wait must not reset the batch gathering behind it
     if (ec == boost::asio::error::operation_aborted)
     {
         return;
     }
-    else if (ec)
+    size_t batch_size = barrier_level_;
+    reset_state();
+    if (ec)
     {
         log_fatal() << "Blockchain processing: " << ec.message();
         return;
     }
-    start();
+    start(batch_size);
+}
+
+void postgresql_blockchain::start(size_t batch_size)
+{
+    const boost::posix_time::ptime organize_start =
+        microsec_clock::universal_time();
+    size_t fork_depth;
+    std::vector<size_t> demoted_ids;
+    {
+        // Attaches the whole batch at once, so no one block to name
+        trace_span span("blockchain.organize");
+        if (organize(fork_depth, demoted_ids))
+        {
+            for (size_t block_id: demoted_ids)
+                disconnect(block_id);
+            verified_depth_ = std::min(verified_depth_, fork_depth);
+            if (failed_depth_ > fork_depth)
+                failed_depth_ = 0;
+        }
+    }
+    double organize_seconds = elapsed_seconds(organize_start);
+    const boost::posix_time::ptime verify_start =
+        microsec_clock::universal_time();
+    if (failed_depth_ == 0)
+        verify();
+    double verify_seconds = elapsed_seconds(verify_start);
+    log_debug() << "Organized " << batch_size << " blocks in "
+        << organize_seconds << "s, verified in " << verify_seconds << "s";
+    static latency_histogram& organize_time =
+        shared_metrics().get_histogram("blockchain.organize");
+    static latency_histogram& verify_time =
+        shared_metrics().get_histogram("blockchain.verify");
+    static counter& blocks_processed =
+        shared_metrics().get_counter("blockchain.blocks_processed");
+    organize_time.record(static_cast<uint64_t>(organize_seconds * 1e6));
+    verify_time.record(static_cast<uint64_t>(verify_seconds * 1e6));
+    blocks_processed.add(batch_size);
+
+    batch_size = std::max<size_t>(batch_size, 1);
+    {
+        std::lock_guard<std::mutex> lock(statistics_mutex_);
+        statistics_.batches++;
+        statistics_.blocks += batch_size;
+        statistics_.last_batch_size = batch_size;
+        statistics_.organize_seconds = moving_average(
+            statistics_.organize_seconds, organize_seconds / batch_size);
+        statistics_.verify_seconds = moving_average(
+            statistics_.verify_seconds, verify_seconds / batch_size);
+    }
+    adapt();
+}
+
+void postgresql_blockchain::adapt()
+{
+    std::lock_guard<std::mutex> lock(statistics_mutex_);
+    const double max_wait =
+        barrier_timeout_.total_microseconds() / 1e6;
+    const double block_seconds =
+        statistics_.organize_seconds + statistics_.verify_seconds;
+    size_t clearance = barrier_clearance_level_;
+    if (block_seconds * clearance > batch_budget)
+        clearance = static_cast<size_t>(batch_budget / block_seconds);
+    statistics_.clearance = std::max<size_t>(clearance, 1);
+    // Blocks trickling in slower than we would wait are handled at once
+    const double fill_seconds =
+        statistics_.arrival_interval * statistics_.clearance;
+    if (statistics_.arrival_interval > max_wait)
+        statistics_.wait_seconds = 0;
+    else
+        statistics_.wait_seconds = std::min(fill_seconds, max_wait);
+}
+
+organizer_statistics postgresql_blockchain::statistics() const
+{
+    std::lock_guard<std::mutex> lock(statistics_mutex_);
+    return statistics_;
+}
+
+size_t postgresql_blockchain::unspent_bytes() const
+{
+    return unspent_->bytes();
+}
+
+void postgresql_blockchain::set_unspent_max_bytes(size_t max_bytes)
+{
+    unspent_->set_max_bytes(max_bytes);
+}
+
+void postgresql_blockchain::disconnect(size_t block_id)
+{
+    static cppdb::statement statement = sql_.prepare(
+        "SELECT \
+            *, \
+            EXTRACT(EPOCH FROM when_created) timest \
+        FROM blocks \
+        WHERE block_id=?"
+        );
+    statement.reset();
+    statement.bind(block_id);
+    cppdb::result result = statement.row();
+    if (result.empty())
+    {
+        log_fatal() << "disconnect() failed for block " << block_id;
+        return;
+    }
+    const message::block block = read_block(result);
+    static cppdb::statement load_undo = sql_.prepare(
+        "SELECT undo FROM block_undo WHERE block_id=?");
+    load_undo.reset();
+    load_undo.bind(block_id);
+    cppdb::result undo_result = load_undo.row();
+    utxo_set::undo_list undo;
+    if (undo_result.empty() ||
+        !decompress_undo(block, read_bytes(undo_result, "undo"), undo))
+    {
+        // Verified before undo data was kept, so the spent outputs are
+        // looked up one by one in the order connect() recorded them
+        undo.clear();
+        for (const message::transaction& tx: block.transactions)
+            if (!is_coinbase(tx))
+                for (const message::transaction_input& input: tx.inputs)
+                {
+                    output_point point{input.hash, input.index};
+                    unspent_output output;
+                    if (load_spent_output(point, output))
+                        undo.push_back(
+                            std::make_pair(point, std::move(output)));
+                }
+    }
+    unspent_->disconnect(block, undo);
 }
 
-void postgresql_blockchain::start()
+bool postgresql_blockchain::assumed_valid(size_t depth) const
 {
-    organize();
-    verify();
+    size_t assume_valid_depth;
+    return checkpoints_.assume_valid != null_hash &&
+        headers().is_main_chain(checkpoints_.assume_valid,
+            assume_valid_depth) && depth <= assume_valid_depth;
 }
 
 void postgresql_blockchain::verify()
@@ -512,27 +1249,80 @@ void postgresql_blockchain::verify()
             EXTRACT(EPOCH FROM when_created) timest \
         FROM blocks \
         WHERE \
-            status='orphan' \
-            AND space=0  \
+            space=0 \
+            AND depth > ? \
         ORDER BY depth ASC"
         );
+    // Blocks connected on some chain that were assumed valid still need
+    // their scripts run later, so only full checks count as validated
+    static cppdb::statement mark_verified = sql_.prepare(
+        "UPDATE blocks \
+        SET \
+            block_status='verified', \
+            validated=validated OR ?::boolean \
+        WHERE block_id=?"
+        );
+    // Coming back to the main chain spends the same outputs as before
+    static cppdb::statement save_undo = sql_.prepare(
+        "INSERT INTO block_undo (block_id, undo) \
+        SELECT ?, ? \
+        WHERE NOT EXISTS ( \
+            SELECT 1 \
+            FROM block_undo \
+            WHERE block_id=? \
+        )"
+        );
+    static counter& blocks_reconnected =
+        shared_metrics().get_counter("blockchain.blocks_reconnected");
+    // Only blocks connected since the last pass
     statement.reset();
+    statement.bind(verified_depth_);
     cppdb::result result = statement.query();
-    // foreach unverified block where status = orphan
-    // do verification and set status = verified
     while (result.next())
     {
         const postgresql_block_info block_info = read_block_info(result);
         const message::block current_block = read_block(result);
+        const hash_digest block_hash = hash_block_header(current_block);
+        trace_span span("blockchain.verify_block", block_hash);
 
-        postgresql_verify_block verifier(
-            sql_, dialect_, block_info, current_block);
-        //verifier.start();
-        if (!verifier.check())
+        const bool run_scripts = !assumed_valid(block_info.depth);
+        // Checked in full on a branch it has been on before. Its parent,
+        // depth and the outputs it spends are all the same, so only
+        // whether those are still unspent is left for connect().
+        const bool validated =
+            result.get<std::string>("validated") == "t";
+        bool passed = check_checkpoints(checkpoints_.checkpoints,
+            block_info.depth, block_hash);
+        if (passed && !validated)
+        {
+            utxo_verify_block verifier(dialect_, verify_pool_, *unspent_,
+                current_block, run_scripts);
+            passed = verifier.check();
+        }
+        utxo_set::undo_list undo;
+        if (!passed || !unspent_->connect(current_block, undo))
         {
+            // Nothing above a bad block can be valid
+            log_warning() << "Block " << block_info.block_id
+                << " failed verification";
+            failed_depth_ = block_info.depth;
+            break;
         }
+        if (validated)
+            blocks_reconnected.add();
+        binary_parameter undo_repr(compress_undo(undo));
+        save_undo.reset();
+        save_undo.bind(block_info.block_id);
+        save_undo.bind(undo_repr);
+        save_undo.bind(block_info.block_id);
+        save_undo.exec();
+        mark_verified.reset();
+        mark_verified.bind(run_scripts ? 1 : 0);
+        mark_verified.bind(block_info.block_id);
+        mark_verified.exec();
+        verified_depth_ = block_info.depth;
     }
-    log_debug() << "-------";
+    unspent_->flush();
 }
 
 } // libbitcoin
@@ -1,22 +1,115 @@
 #ifndef LIBBITCOIN_STORAGE_POSTGRESQL_BLOCKCHAIN_H
 #define LIBBITCOIN_STORAGE_POSTGRESQL_BLOCKCHAIN_H
 
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <sstream>
 #include <tuple>
+#include <vector>
+#include <boost/utility.hpp>
 #include <cppdb/frontend.h>
 
+#include <bitcoin/constants.hpp>
 #include <bitcoin/messages.hpp>
+#include <bitcoin/storage/postgresql_storage.hpp>
 #include <bitcoin/types.hpp>
-#include <bitcoin/verify.hpp>
+#include <bitcoin/utxo_set.hpp>
+#include <bitcoin/utxo_verify_block.hpp>
 
 namespace libbitcoin {
 
+using boost::posix_time::microsec_clock;
+using boost::posix_time::microseconds;
 using boost::posix_time::milliseconds;
 using boost::posix_time::seconds;
 using boost::posix_time::time_duration;
 using std::placeholders::_1;
+using std::placeholders::_2;
 
-data_chunk deserialize_bytes(std::string byte_stream);
-hash_digest deserialize_hash(std::string byte_stream);
+// Hashes and script data are stored as raw BYTEA. cppdb hands blobs
+// in and out as streams, so parameters are bound through one of these.
+class binary_parameter
+  : public std::istringstream
+{
+public:
+    template <typename T>
+    explicit binary_parameter(const T& data)
+      : std::istringstream(std::string(data.begin(), data.end()),
+            std::ios_base::in | std::ios_base::binary)
+    {
+    }
+};
+
+// Keeps each multi-row statement well under the 65535 parameter limit
+constexpr size_t bulk_statement_rows = 500;
+
+inline std::string bulk_query_text(const std::string& head,
+    const std::string& row, const std::string& tail, size_t number_rows)
+{
+    std::string query = head;
+    for (size_t i = 0; i < number_rows; ++i)
+    {
+        if (i != 0)
+            query += ", ";
+        query += row;
+    }
+    return query + tail;
+}
+
+// Runs "head row, row, ... tail" statements covering number_rows rows.
+// bind_row(statement, i) binds the parameters of row i in order.
+template <typename BindRow>
+void bulk_execute(cppdb::session& sql, const std::string& head,
+    const std::string& row, const std::string& tail, size_t number_rows,
+    BindRow bind_row)
+{
+    for (size_t begin = 0; begin < number_rows; begin += bulk_statement_rows)
+    {
+        size_t end = std::min(number_rows, begin + bulk_statement_rows);
+        // Full chunks share their text so the prepare gets cached
+        cppdb::statement statement = sql.prepare(
+            bulk_query_text(head, row, tail, end - begin));
+        statement.reset();
+        for (size_t i = begin; i < end; ++i)
+            bind_row(statement, i);
+        statement.exec();
+    }
+}
+
+// The same for queries. read_row(result) sees every returned row.
+template <typename BindRow, typename ReadRow>
+void bulk_select(cppdb::session& sql, const std::string& head,
+    const std::string& row, const std::string& tail, size_t number_rows,
+    BindRow bind_row, ReadRow read_row)
+{
+    for (size_t begin = 0; begin < number_rows; begin += bulk_statement_rows)
+    {
+        size_t end = std::min(number_rows, begin + bulk_statement_rows);
+        cppdb::statement statement = sql.prepare(
+            bulk_query_text(head, row, tail, end - begin));
+        statement.reset();
+        for (size_t i = begin; i < end; ++i)
+            bind_row(statement, i);
+        cppdb::result result = statement.query();
+        while (result.next())
+            read_row(result);
+    }
+}
+
+template <typename BindRow>
+void bulk_insert(cppdb::session& sql, const std::string& head,
+    const std::string& row, size_t number_rows, BindRow bind_row)
+{
+    bulk_execute(sql, head + " VALUES ", row, "", number_rows, bind_row);
+}
+
+data_chunk read_bytes(cppdb::result& result, const std::string& column);
+hash_digest read_hash(cppdb::result& result, const std::string& column);
+hash_digest read_hash(cppdb::result& result, int column);
+// From a row of blocks
+bool read_pruned(cppdb::result& result);
 
 class postgresql_organizer
 {
@@ -44,6 +137,31 @@ private:
     cppdb::session sql_;
 };
 
+// Keeps space 0 equal to the header index's main chain, with each block
+// at its depth and pointing at its parent. A new best chain only touches
+// the blocks between the fork point and the two tips, rather than
+// shifting every nested set span after the fork.
+class postgresql_chain_organizer
+{
+protected:
+    postgresql_chain_organizer(cppdb::session sql, header_index_ptr headers);
+    // False if the main chain is unchanged. Otherwise fork_depth is the
+    // last depth both chains share and demoted_ids holds the verified
+    // blocks taken off the main chain, tip first, so their spends can be
+    // undone.
+    bool organize(size_t& fork_depth, std::vector<size_t>& demoted_ids);
+    const header_index& headers() const;
+
+private:
+    std::vector<size_t> demote(size_t fork_depth);
+    void promote(size_t fork_depth, size_t top_depth);
+
+    cppdb::session sql_;
+    header_index_ptr headers_;
+    // Hashes of the blocks written with space 0, indexed by depth
+    std::vector<hash_digest> chain_;
+};
+
 struct postgresql_block_info
 {
     size_t block_id, depth, span_left, span_right, prev_block_id;
@@ -55,62 +173,196 @@ public:
     postgresql_reader(cppdb::session sql);
 
     message::block read_block(cppdb::result block_result);
-    script select_script(size_t script_id);
-
     postgresql_block_info read_block_info(cppdb::result result);
 
 private:
-    message::transaction_input_list select_inputs(size_t transaction_id);
-    message::transaction_output_list select_outputs(size_t transaction_id);
+    void read_transactions(size_t block_id,
+        message::transaction_list& transactions);
+    void read_inputs(size_t block_id,
+        message::transaction_list& transactions);
+    void read_outputs(size_t block_id,
+        message::transaction_list& transactions);
 
-    message::transaction_list read_transactions(cppdb::result result);
+    cppdb::session sql_;
+};
+
+// Extra sessions so reads run alongside the writer. Each session has its
+// own reader since prepared statements belong to one connection.
+class postgresql_reader_pool
+{
+public:
+    postgresql_reader_pool(const std::string& connect_string,
+        size_t number_sessions);
+
+    // Holds one session exclusively, waiting if they are all taken
+    class lease
+      : private boost::noncopyable
+    {
+    public:
+        lease(postgresql_reader_pool& pool);
+        ~lease();
+        cppdb::session& sql();
+        postgresql_reader& reader();
+    private:
+        postgresql_reader_pool& pool_;
+        size_t index_;
+    };
+
+private:
+    std::vector<cppdb::session> sessions_;
+    std::vector<postgresql_reader> readers_;
+    std::vector<size_t> free_;
+    std::mutex mutex_;
+    std::condition_variable released_;
+};
+
+// Calls round on a thread of its own, straight away again while it
+// reports more to do and after interval otherwise. Destroying the loop
+// waits for a round in progress, so owners declare it last.
+class postgresql_background_loop
+  : private boost::noncopyable
+{
+public:
+    // True if there is probably more to do at once
+    typedef std::function<bool ()> round_handler;
+
+    postgresql_background_loop(round_handler round, time_duration interval);
+    ~postgresql_background_loop();
+
+private:
+    void run(const boost::system::error_code& ec);
+    void wait(time_duration delay);
+
+    round_handler round_;
+    time_duration interval_;
+    thread_pool_ptr thread_;
+    // Outlives the timer, which goes before the pool's service would
+    service_ptr service_;
+    deadline_timer_ptr timer_;
+};
+
+// Deletes the transaction data of main chain blocks more than
+// keep_blocks beneath the verified tip, a block per SQL transaction on
+// a session and thread of its own, so stores carry on meanwhile.
+// Headers and unspent outputs stay. Given a byte_budget, it only prunes
+// while the database is larger than that.
+class postgresql_pruner
+  : private boost::noncopyable
+{
+public:
+    // Never fewer, so ordinary reorganisations find what they undo
+    static constexpr size_t min_keep_blocks = 288;
+
+    postgresql_pruner(const std::string& connect_string,
+        size_t keep_blocks, uint64_t byte_budget);
+
+private:
+    // How many blocks were pruned
+    size_t prune_batch();
+    void prune_block(size_t block_id);
 
     cppdb::session sql_;
+    size_t keep_blocks_;
+    uint64_t byte_budget_;
+    // Goes first, waiting for a block being pruned to finish
+    postgresql_background_loop loop_;
 };
 
-class postgresql_verify_block
-  : public verify_block
+// Fills address_outputs from verified main chain blocks on a session
+// and thread of its own, a batch of blocks per SQL transaction, so
+// stores never wait on it. Where it got to is kept in
+// address_index_cursor, so a restart carries on from there. Blocks a
+// reorganisation took off the main chain are dropped again.
+class postgresql_address_indexer
+  : private boost::noncopyable
 {
 public:
-    postgresql_verify_block(cppdb::session sql, dialect_ptr,
-        const postgresql_block_info& block_info,
-        const message::block& current_block);
-    bool check();
+    postgresql_address_indexer(const std::string& connect_string);
+
 private:
+    // How many blocks were indexed or dropped
+    size_t index_batch();
+    // Steps the cursor back a block, dropping the rows at its depth
+    void rewind(size_t depth);
+
     cppdb::session sql_;
-    const postgresql_block_info& block_info_;
-    const message::block& current_block_;
+    // Goes first, waiting for a batch being indexed to finish
+    postgresql_background_loop loop_;
 };
 
+// The hash an output script pays to, for pubkey hash and pubkey
+// scripts. False for anything else.
+bool extract_pubkey_hash(const data_chunk& raw_script,
+    short_hash& pubkey_hash);
+
 class postgresql_blockchain
-  : public postgresql_organizer,
+  : public postgresql_chain_organizer,
     public postgresql_reader,
     public std::enable_shared_from_this<postgresql_blockchain>
 {
 public:
-    postgresql_blockchain(cppdb::session sql, service_ptr service);
+    // Batches are started on strand, a strand of service that
+    // raise_barrier() callers must also be on
+    postgresql_blockchain(cppdb::session sql, service_ptr service,
+        strand_ptr strand, header_index_ptr headers);
 
+    // Upper bounds for the adaptive batch size and wait
     void set_clearance(size_t clearance);
     void set_timeout(time_duration timeout);
+    // Called on the strand
+    void set_checkpoints(const chain_checkpoints& checkpoints);
 
     void raise_barrier();
+    organizer_statistics statistics() const;
+    size_t unspent_bytes() const;
+    void set_unspent_max_bytes(size_t max_bytes);
+
+    // Spendable by the next block on the main chain
+    bool fetch_unspent(const output_point& point, unspent_output& output);
     
 private: 
     void reset_state();
     void start_exec(const boost::system::error_code& ec);
-    void start();
+    void start(size_t batch_size);
+    // Resizes batches so one takes about a batch_budget to process, and
+    // waits only as long as arrivals would take to fill one
+    void adapt();
 
     void verify();
+    // Buried beneath the assumed valid block on the main header chain
+    bool assumed_valid(size_t depth) const;
+    // Puts back the outputs a block spent and drops the ones it made
+    void disconnect(size_t block_id);
+
+    bool load_output(const output_point& point, unspent_output& output);
+    // Ignores the spent flag, for rebuilding what a block spent
+    bool load_spent_output(const output_point& point,
+        unspent_output& output);
+    void flush_spends(const utxo_set::change_list& changes);
 
     size_t barrier_clearance_level_;
     time_duration barrier_timeout_;
 
+    strand_ptr strand_;
     deadline_timer_ptr timeout_;
     bool timer_started_;
     size_t barrier_level_;
+    boost::posix_time::ptime last_arrival_;
+
+    mutable std::mutex statistics_mutex_;
+    organizer_statistics statistics_;
 
     dialect_ptr dialect_;
+    // Shared by every block we verify
+    thread_pool_ptr verify_pool_;
+    chain_checkpoints checkpoints_;
     cppdb::session sql_;
+    // Outputs spendable by the next block on the main chain
+    utxo_set_ptr unspent_;
+    // Main chain blocks up to here are verified and connected. Nothing
+    // is verified while a block has failed above it, until a reorg
+    // replaces that block. Genesis never fails so 0 means none.
+    size_t verified_depth_, failed_depth_;
 };
 
 } // libbitcoin
@@ -1,48 +1,191 @@
 #include <bitcoin/storage/postgresql_storage.hpp>
 
+#include <algorithm>
+
 #include <bitcoin/block.hpp>
+#include <bitcoin/constants.hpp>
+#include <bitcoin/dialect.hpp>
+#include <bitcoin/header_index.hpp>
 #include <bitcoin/transaction.hpp>
 #include <bitcoin/util/assert.hpp>
 #include <bitcoin/util/logger.hpp>
+#include <bitcoin/util/metrics.hpp>
+#include <bitcoin/util/thread_pool.hpp>
+#include <bitcoin/util/trace.hpp>
+#include <bitcoin/verify.hpp>
 
 #include "postgresql_blockchain.hpp"
 
 namespace libbitcoin {
 
-data_chunk deserialize_bytes(std::string byte_stream)
+data_chunk read_bytes(cppdb::result& result, const std::string& column)
 {
-    std::stringstream ss;
-    ss << std::hex << byte_stream;
-    data_chunk stack;
-    while (ss.good())
-    {
-        int val;
-        ss >> val;
-        stack.push_back(val);
-    }
-    return stack;
+    std::ostringstream stream;
+    result.fetch(column, stream);
+    const std::string raw = stream.str();
+    return data_chunk(raw.begin(), raw.end());
 }
 
-hash_digest deserialize_hash(std::string byte_stream)
+static hash_digest hash_from_raw(const std::string& raw)
 {
-    std::stringstream ss;
-    ss << std::hex << byte_stream;
-    hash_digest hash;
-    for (size_t i = 0; i < hash.size(); ++i)
-    {
-        int val;
-        ss >> val;
-        hash[i] = val;
-    }
+    hash_digest hash = null_hash;
+    BITCOIN_ASSERT(raw.size() == hash.size());
+    std::copy(raw.begin(), raw.begin() + std::min(raw.size(), hash.size()),
+        hash.begin());
     return hash;
 }
+hash_digest read_hash(cppdb::result& result, const std::string& column)
+{
+    std::ostringstream stream;
+    result.fetch(column, stream);
+    return hash_from_raw(stream.str());
+}
+hash_digest read_hash(cppdb::result& result, int column)
+{
+    std::ostringstream stream;
+    result.fetch(column, stream);
+    return hash_from_raw(stream.str());
+}
+bool read_pruned(cppdb::result& result)
+{
+    return result.get<std::string>("pruned") == "t";
+}
+
+// Blocks stored between automatic snapshots
+constexpr size_t snapshot_interval = 2000;
+
+static std::string connect_string(const std::string& database,
+    const std::string& user, const std::string& password)
+{
+    return std::string("postgresql:dbname=") + database + 
+        ";user=" + user + ";password=" + password + ";@blob=bytea";
+}
 
 postgresql_storage::postgresql_storage(std::string database, 
-        std::string user, std::string password)
-  : sql_(std::string("postgresql:dbname=") + database + 
-        ";user=" + user + ";password=" + password)
+        std::string user, std::string password, size_t number_readers,
+        std::string snapshot_path, thread_pool_ptr executor)
+  : threaded_service(executor),
+    sql_(connect_string(database, user, password)),
+    snapshot_path_(snapshot_path), last_block_id_(0),
+    blocks_since_snapshot_(0),
+    connect_string_(connect_string(database, user, password))
+{
+    // The organizer follows the main chain of the loaded headers
+    load_headers();
+    blockchain_.reset(new postgresql_blockchain(sql_, service(),
+        strand(), headers_));
+    readers_.reset(new postgresql_reader_pool(
+        connect_string_, number_readers));
+    reader_threads_.reset(new thread_pool(number_readers));
+}
+
+void postgresql_storage::load_headers()
+{
+    headers_.reset(new header_index);
+    last_block_id_ = 0;
+    if (!snapshot_path_.empty() &&
+            !headers_->load(snapshot_path_, last_block_id_))
+    {
+        log_warning() << "No usable snapshot at " << snapshot_path_
+            << ", reading all headers from the database";
+        last_block_id_ = 0;
+    }
+    size_t snapshot_size = headers_->size();
+    cppdb::result result = sql_ <<
+        "SELECT \
+            block_id, \
+            block_hash, \
+            prev_block_hash, \
+            bits_head, \
+            bits_body, \
+            block_status \
+        FROM blocks \
+        WHERE block_id > ? \
+        ORDER BY block_id ASC"
+        << last_block_id_;
+    while (result.next())
+    {
+        uint32_t bits_head = result.get<uint32_t>("bits_head"),
+            bits_body = result.get<uint32_t>("bits_body");
+        headers_->add(read_hash(result, "block_hash"),
+            read_hash(result, "prev_block_hash"),
+            bits_body + (bits_head << (3*8)),
+            result.get<std::string>("block_status") == "verified");
+        last_block_id_ = result.get<uint64_t>("block_id");
+    }
+    if (snapshot_size > 0)
+        log_info() << "Restored " << snapshot_size
+            << " headers from snapshot and replayed "
+            << headers_->size() - snapshot_size;
+}
+
+void postgresql_storage::snapshot(store_handler handle_snapshot)
+{
+    strand()->post(std::bind(
+        &postgresql_storage::do_snapshot, shared_from_this(),
+            handle_snapshot));
+}
+void postgresql_storage::do_snapshot(store_handler handle_snapshot)
+{
+    if (snapshot_path_.empty() || write_snapshot())
+        handle_snapshot(std::error_code());
+    else
+        handle_snapshot(error::snapshot_failed);
+}
+
+organizer_statistics postgresql_storage::statistics() const
+{
+    return blockchain_->statistics();
+}
+
+size_t postgresql_storage::unspent_bytes() const
+{
+    return blockchain_->unspent_bytes();
+}
+
+void postgresql_storage::set_unspent_max_bytes(size_t max_bytes)
+{
+    blockchain_->set_unspent_max_bytes(max_bytes);
+}
+
+size_t postgresql_storage::headers_bytes() const
+{
+    return headers_->bytes();
+}
+
+void postgresql_storage::set_checkpoints(
+    const chain_checkpoints& checkpoints)
+{
+    strand()->post(std::bind(
+        &postgresql_storage::do_set_checkpoints, shared_from_this(),
+            checkpoints));
+}
+void postgresql_storage::do_set_checkpoints(
+    const chain_checkpoints& checkpoints)
+{
+    blockchain_->set_checkpoints(checkpoints);
+}
+
+void postgresql_storage::set_pruning(size_t keep_blocks,
+    uint64_t byte_budget)
+{
+    pruner_.reset(new postgresql_pruner(connect_string_, keep_blocks,
+        byte_budget));
+}
+
+void postgresql_storage::set_address_index()
+{
+    address_indexer_.reset(new postgresql_address_indexer(connect_string_));
+}
+
+bool postgresql_storage::write_snapshot()
 {
-    blockchain_.reset(new postgresql_blockchain(sql_, service()));
+    // Runs on the writer strand, so last_block_id_ matches the index
+    blocks_since_snapshot_ = 0;
+    if (headers_->save(snapshot_path_, last_block_id_))
+        return true;
+    log_error() << "Unable to write snapshot to " << snapshot_path_;
+    return false;
 }
 
 void postgresql_storage::store(const message::inv& inv,
@@ -55,111 +198,120 @@ void postgresql_storage::store(const message::inv& inv,
 void postgresql_storage::do_store_inv(const message::inv& inv,
         store_handler handle_store)
 {
+    static latency_histogram& latency =
+        shared_metrics().get_histogram("storage.store_inv");
+    scoped_timer timer(latency);
     cppdb::statement stat = sql_ <<
         "INSERT INTO inventory_requests (type, hash) \
         VALUES (?, ?)";
-    for (message::inv_vect ivv: inv.invs)
+    for (const message::inv_vect& ivv: inv.invs)
     {
         stat.reset();
         if (ivv.type == message::inv_type::transaction)
             stat.bind("transaction");
         else if (ivv.type == message::inv_type::block)
             stat.bind("block");
-        std::string byte_stream = hexlify(ivv.hash);
-        stat.bind(byte_stream);
+        binary_parameter hash(ivv.hash);
+        stat.bind(hash);
         stat.exec();
     }
     handle_store(std::error_code());
 }
 
-void postgresql_storage::insert(operation operation, size_t script_id)
+// Reserves count values from a sequence in one round trip
+std::vector<size_t> allocate_ids(cppdb::session& sql,
+    const std::string& sequence, size_t count)
 {
-    std::string opcode_repr = opcode_to_string(operation.code);
-    cppdb::statement stat = sql_ <<
-        "INSERT INTO operations (opcode, script_id, data) \
-        VALUES (?, ?, ?)";
-    stat.bind(opcode_repr);
-    stat.bind(script_id);
-    if (operation.data.size() == 0)
-    {
-        stat.bind_null();
-        stat.exec();
-    }
-    else
-    {
-        // Scoping rules. String needs to stay around for exec
-        std::string byte_stream = hexlify(operation.data);
-        stat.bind(byte_stream);
-        stat.exec();
-    }
+    std::vector<size_t> ids;
+    if (count == 0)
+        return ids;
+    ids.reserve(count);
+    cppdb::statement statement = sql.prepare(
+        "SELECT nextval(?) FROM generate_series(1, ?)");
+    statement.reset();
+    statement.bind(sequence);
+    statement.bind(count);
+    cppdb::result result = statement.query();
+    while (result.next())
+        ids.push_back(result.get<size_t>(0));
+    BITCOIN_ASSERT(ids.size() == count);
+    return ids;
 }
 
-size_t postgresql_storage::insert_script(operation_stack operations)
+std::vector<size_t> postgresql_storage::insert_transactions(
+        const message::transaction_list& transactions)
 {
-    cppdb::result result = sql_ <<
-        "SELECT nextval('script_sequence')" << cppdb::row;
-    size_t script_id = result.get<size_t>(0);
-    for (operation operation: operations)
-        insert(operation, script_id);
-    return script_id;
-}
-
-void postgresql_storage::insert(const message::transaction_input& input,
-        size_t transaction_id, size_t index_in_parent)
-{
-    size_t script_id = insert_script(input.input_script.operations());
-    std::string hash = hexlify(input.hash);
-    sql_ <<
-        "INSERT INTO inputs (input_id, transaction_id, index_in_parent, \
-            script_id, previous_output_id, previous_output_hash, \
-            previous_output_index, sequence) \
-        VALUES (DEFAULT, ?, ?, ?, ?, ?, ?, ?)"
-        << transaction_id
-        << index_in_parent
-        << script_id
-        << cppdb::null
-        << hash
-        << input.index
-        << input.sequence
-        << cppdb::exec;
-}
-
-void postgresql_storage::insert(const message::transaction_output& output,
-        size_t transaction_id, size_t index_in_parent)
-{
-    size_t script_id = insert_script(output.output_script.operations());
-    sql_ <<
-        "INSERT INTO outputs (output_id, transaction_id, index_in_parent, \
-            script_id, value, output_type, address) \
-        VALUES (DEFAULT, ?, ?, ?, internal_to_sql(?), ?, ?)"
-        << transaction_id
-        << index_in_parent
-        << script_id
-        << output.value
-        << "other"
-        << cppdb::null
-        << cppdb::exec;
-}
-
-size_t postgresql_storage::insert(const message::transaction& transaction)
-{
-    hash_digest transaction_hash = hash_transaction(transaction);
-    std::string transaction_hash_repr = hexlify(transaction_hash);
-    cppdb::result result = sql_ <<
+    std::vector<size_t> transaction_ids = allocate_ids(sql_,
+        "transactions_transaction_id_sequence", transactions.size());
+    bulk_insert(sql_,
         "INSERT INTO transactions (transaction_id, transaction_hash, \
-            version, locktime) \
-        VALUES (DEFAULT, ?, ?, ?) \
-        RETURNING transaction_id"
-        << transaction_hash_repr
-        << transaction.version
-        << transaction.locktime
-        << cppdb::row;
-    size_t transaction_id = result.get<size_t>(0);
-    for (size_t i = 0; i < transaction.inputs.size(); ++i)
-        insert(transaction.inputs[i], transaction_id, i);
-    for (size_t i = 0; i < transaction.outputs.size(); ++i)
-        insert(transaction.outputs[i], transaction_id, i);
-    return transaction_id;
+            version, locktime)", "(?, ?, ?, ?)", transactions.size(),
+        [&](cppdb::statement& statement, size_t i)
+        {
+            const message::transaction& transaction = transactions[i];
+            binary_parameter hash(hash_transaction(transaction));
+            statement.bind(transaction_ids[i]);
+            statement.bind(hash);
+            statement.bind(transaction.version);
+            statement.bind(transaction.locktime);
+        });
+
+    // Flatten every input and output so each table is written in a
+    // few statements
+    struct input_row
+    {
+        size_t transaction_id, index_in_parent;
+        const message::transaction_input* input;
+    };
+    struct output_row
+    {
+        size_t transaction_id, index_in_parent;
+        const message::transaction_output* output;
+    };
+    std::vector<input_row> input_rows;
+    std::vector<output_row> output_rows;
+    for (size_t i = 0; i < transactions.size(); ++i)
+    {
+        const message::transaction& transaction = transactions[i];
+        for (size_t j = 0; j < transaction.inputs.size(); ++j)
+            input_rows.push_back(
+                input_row{transaction_ids[i], j, &transaction.inputs[j]});
+        for (size_t j = 0; j < transaction.outputs.size(); ++j)
+            output_rows.push_back(
+                output_row{transaction_ids[i], j, &transaction.outputs[j]});
+    }
+    bulk_insert(sql_,
+        "INSERT INTO inputs (transaction_id, index_in_parent, script, \
+            previous_output_id, previous_output_hash, \
+            previous_output_index, sequence)",
+        "(?, ?, ?, NULL, ?, ?, ?)", input_rows.size(),
+        [&](cppdb::statement& statement, size_t i)
+        {
+            const message::transaction_input& input = *input_rows[i].input;
+            binary_parameter raw_script(save_script(input.input_script)),
+                hash(input.hash);
+            statement.bind(input_rows[i].transaction_id);
+            statement.bind(input_rows[i].index_in_parent);
+            statement.bind(raw_script);
+            statement.bind(hash);
+            statement.bind(input.index);
+            statement.bind(input.sequence);
+        });
+    bulk_insert(sql_,
+        "INSERT INTO outputs (transaction_id, index_in_parent, script, \
+            value, output_type, address)",
+        "(?, ?, ?, internal_to_sql(?), 'other', NULL)", output_rows.size(),
+        [&](cppdb::statement& statement, size_t i)
+        {
+            const message::transaction_output& output =
+                *output_rows[i].output;
+            binary_parameter raw_script(save_script(output.output_script));
+            statement.bind(output_rows[i].transaction_id);
+            statement.bind(output_rows[i].index_in_parent);
+            statement.bind(raw_script);
+            statement.bind(output.value);
+        });
+    return transaction_ids;
 }
 
 void postgresql_storage::store(const message::transaction& transaction,
@@ -172,34 +324,49 @@ void postgresql_storage::store(const message::transaction& transaction,
 void postgresql_storage::do_store_transaction(
         const message::transaction& transaction, store_handler handle_store)
 {
-    insert(transaction);
+    static latency_histogram& latency =
+        shared_metrics().get_histogram("storage.store_transaction");
+    scoped_timer timer(latency);
+    cppdb::transaction guard(sql_);
+    insert_transactions(message::transaction_list(1, transaction));
+    guard.commit();
     handle_store(std::error_code());
 }
 
-void postgresql_storage::store(const message::block& block,
+void postgresql_storage::store(message::block_ptr block,
         store_handler handle_store)
 {
     strand()->post(std::bind(
         &postgresql_storage::do_store_block, shared_from_this(),
             block, handle_store));
 }
-void postgresql_storage::do_store_block(const message::block& block,
+void postgresql_storage::do_store_block(message::block_ptr block_ref,
         store_handler handle_store)
 {
+    static latency_histogram& latency =
+        shared_metrics().get_histogram("storage.store_block");
+    scoped_timer timer(latency);
+    const message::block& block = *block_ref;
     hash_digest block_hash = hash_block_header(block);
-    std::string block_hash_repr = hexlify(block_hash),
-            prev_block_repr = hexlify(block.prev_block),
-            merkle_repr = hexlify(block.merkle_root);
+    trace_span span("storage.store_block", block_hash);
+    binary_parameter block_hash_repr(block_hash),
+            prev_block_repr(block.prev_block),
+            merkle_repr(block.merkle_root);
 
-    cppdb::result result = sql_ <<
-        "SELECT 1 FROM blocks WHERE block_hash=?"
-        << block_hash_repr << cppdb::row;
-    if (!result.empty())
+    if (headers_->contains(block_hash))
     {
         handle_store(error::object_already_exists);
         return;
     }
+    // Free for blocks the kernel already checked
+    if (!block.context_checked.passed() && !check_block_context_free(block))
+    {
+        handle_store(error::invalid_block);
+        return;
+    }
 
+    // The whole block goes in as one unit or not at all
+    cppdb::transaction guard(sql_);
     static cppdb::statement statement = sql_.prepare(
         "INSERT INTO blocks( \
             block_id, \
@@ -249,18 +416,38 @@ void postgresql_storage::do_store_block(const message::block& block,
     statement.bind(bits_body);
     statement.bind(block.nonce);
 
-    result = statement.row();
+    cppdb::result result = statement.row();
     size_t block_id = result.get<size_t>(0);
-    for (size_t i = 0; i < block.transactions.size(); ++i)
-    {
-        message::transaction transaction = block.transactions[i];
-        size_t transaction_id = insert(transaction);
-        // Create block <-> txn mapping
-        sql_ << "INSERT INTO transactions_parents ( \
-                    transaction_id, block_id, index_in_block) \
-                VALUES (?, ?, ?)"
-            << transaction_id << block_id << i << cppdb::exec;
-    }
+    // Blocks built locally are serialized once here instead
+    data_chunk_ptr raw_block = block.raw_payload;
+    if (!raw_block)
+        raw_block = std::make_shared<const data_chunk>(
+            original_dialect().to_network(block, false));
+    static cppdb::statement raw_statement = sql_.prepare(
+        "INSERT INTO raw_blocks (block_id, payload) VALUES (?, ?)");
+    binary_parameter raw_repr(*raw_block);
+    raw_statement.reset();
+    raw_statement.bind(block_id);
+    raw_statement.bind(raw_repr);
+    raw_statement.exec();
+    std::vector<size_t> transaction_ids =
+        insert_transactions(block.transactions);
+    // Create block <-> txn mapping
+    bulk_insert(sql_,
+        "INSERT INTO transactions_parents (transaction_id, block_id, \
+            index_in_block)", "(?, ?, ?)", transaction_ids.size(),
+        [&](cppdb::statement& statement, size_t i)
+        {
+            statement.bind(transaction_ids[i]);
+            statement.bind(block_id);
+            statement.bind(i);
+        });
+    guard.commit();
+    headers_->add(block_hash, block.prev_block, block.bits);
+    last_block_id_ = block_id;
+    if (!snapshot_path_.empty() &&
+            ++blocks_since_snapshot_ >= snapshot_interval)
+        write_snapshot();
     blockchain_->raise_barrier();
     handle_store(std::error_code());
 }
@@ -276,22 +463,26 @@ void postgresql_storage::do_fetch_inventories(fetch_handler_inventories)
 void postgresql_storage::fetch_block_by_depth(size_t block_number,
         fetch_handler_block handle_fetch)
 {
-    strand()->post(std::bind(
+    reader_threads_->service()->post(std::bind(
         &postgresql_storage::do_fetch_block_by_depth, shared_from_this(),
             block_number, handle_fetch));
 }
 void postgresql_storage::do_fetch_block_by_depth(size_t block_number,
         fetch_handler_block handle_fetch)
 {
-    static cppdb::statement block_statement = sql_.prepare(
+    static latency_histogram& latency =
+        shared_metrics().get_histogram("storage.fetch_block_by_depth");
+    scoped_timer timer(latency);
+    postgresql_reader_pool::lease lease(*readers_);
+    cppdb::session& sql = lease.sql();
+    cppdb::statement block_statement = sql.prepare(
         "SELECT \
             *, \
             EXTRACT(EPOCH FROM when_created) timest \
         FROM blocks \
         WHERE \
             depth=? \
-            AND span_left=0 \
-            AND span_right=0"
+            AND space=0"
         );
     block_statement.reset();
     block_statement.bind(block_number);
@@ -301,31 +492,84 @@ void postgresql_storage::do_fetch_block_by_depth(size_t block_number,
         handle_fetch(error::object_doesnt_exist, message::block());
         return;
     }
-    message::block block = blockchain_->read_block(block_result);
+    if (read_pruned(block_result))
+    {
+        handle_fetch(error::block_pruned, message::block());
+        return;
+    }
+    message::block block = lease.reader().read_block(block_result);
     handle_fetch(std::error_code(), block);
 }
 
+void postgresql_storage::fetch_blocks_by_depth_range(size_t begin,
+        size_t end, fetch_handler_blocks handle_fetch)
+{
+    reader_threads_->service()->post(std::bind(
+        &postgresql_storage::do_fetch_blocks_by_depth_range,
+            shared_from_this(), begin, end, handle_fetch));
+}
+void postgresql_storage::do_fetch_blocks_by_depth_range(size_t begin,
+        size_t end, fetch_handler_blocks handle_fetch)
+{
+    static latency_histogram& latency =
+        shared_metrics().get_histogram("storage.fetch_blocks_by_depth_range");
+    scoped_timer timer(latency);
+    postgresql_reader_pool::lease lease(*readers_);
+    cppdb::session& sql = lease.sql();
+    cppdb::statement block_statement = sql.prepare(
+        "SELECT \
+            *, \
+            EXTRACT(EPOCH FROM when_created) timest \
+        FROM blocks \
+        WHERE \
+            space=0 \
+            AND depth>=? \
+            AND depth<? \
+        ORDER BY depth ASC"
+        );
+    block_statement.reset();
+    block_statement.bind(begin);
+    block_statement.bind(end);
+    cppdb::result block_result = block_statement.query();
+    message::block_list blocks;
+    while (block_result.next())
+    {
+        if (read_pruned(block_result))
+        {
+            handle_fetch(error::block_pruned, message::block_list());
+            return;
+        }
+        blocks.push_back(lease.reader().read_block(block_result));
+    }
+    if (blocks.empty())
+        handle_fetch(error::object_doesnt_exist, blocks);
+    else
+        handle_fetch(std::error_code(), blocks);
+}
+
 void postgresql_storage::fetch_block_by_hash(hash_digest block_hash, 
         fetch_handler_block handle_fetch)
 {
-    strand()->post(std::bind(
+    reader_threads_->service()->post(std::bind(
         &postgresql_storage::do_fetch_block_by_hash, shared_from_this(),
             block_hash, handle_fetch));
 }
 void postgresql_storage::do_fetch_block_by_hash(hash_digest block_hash, 
         fetch_handler_block handle_fetch)
 {
-    static cppdb::statement block_statement = sql_.prepare(
+    static latency_histogram& latency =
+        shared_metrics().get_histogram("storage.fetch_block_by_hash");
+    scoped_timer timer(latency);
+    postgresql_reader_pool::lease lease(*readers_);
+    cppdb::session& sql = lease.sql();
+    cppdb::statement block_statement = sql.prepare(
         "SELECT \
             *, \
             EXTRACT(EPOCH FROM when_created) timest \
         FROM blocks \
-        WHERE \
-            block_hash=? \
-            AND span_left=0 \
-            AND span_left=0"
+        WHERE block_hash=?"
         );
-    std::string block_hash_repr = hexlify(block_hash);
+    binary_parameter block_hash_repr(block_hash);
     block_statement.reset();
     block_statement.bind(block_hash_repr);
     cppdb::result block_result = block_statement.row();
@@ -334,72 +578,92 @@ void postgresql_storage::do_fetch_block_by_hash(hash_digest block_hash,
         handle_fetch(error::object_doesnt_exist, message::block());
         return;
     }
-    message::block block = blockchain_->read_block(block_result);
+    if (read_pruned(block_result))
+    {
+        handle_fetch(error::block_pruned, message::block());
+        return;
+    }
+    message::block block = lease.reader().read_block(block_result);
     handle_fetch(std::error_code(), block);
 }
 
-void postgresql_storage::fetch_block_locator(
-        fetch_handler_block_locator handle_fetch)
+void postgresql_storage::fetch_raw_block_by_hash(hash_digest block_hash,
+        fetch_handler_raw_block handle_fetch)
 {
-    strand()->post(std::bind(
-        &postgresql_storage::do_fetch_block_locator, shared_from_this(),
-            handle_fetch));
+    reader_threads_->service()->post(std::bind(
+        &postgresql_storage::do_fetch_raw_block_by_hash, shared_from_this(),
+            block_hash, handle_fetch));
 }
-void postgresql_storage::do_fetch_block_locator(
-        fetch_handler_block_locator handle_fetch)
+void postgresql_storage::do_fetch_raw_block_by_hash(hash_digest block_hash,
+        fetch_handler_raw_block handle_fetch)
 {
-    cppdb::result number_blocks_result = sql_ <<
-        "SELECT MAX(depth) \
-        FROM blocks \
-        WHERE \
-            span_left=0 \
-            AND span_right=0"
-        << cppdb::row;
-    if (number_blocks_result.empty())
+    static latency_histogram& latency =
+        shared_metrics().get_histogram("storage.fetch_raw_block_by_hash");
+    scoped_timer timer(latency);
+    postgresql_reader_pool::lease lease(*readers_);
+    cppdb::session& sql = lease.sql();
+    cppdb::statement raw_statement = sql.prepare(
+        "SELECT payload \
+        FROM raw_blocks \
+        JOIN blocks \
+        ON blocks.block_id=raw_blocks.block_id \
+        WHERE block_hash=?"
+        );
+    binary_parameter block_hash_repr(block_hash);
+    raw_statement.reset();
+    raw_statement.bind(block_hash_repr);
+    cppdb::result raw_result = raw_statement.row();
+    if (!raw_result.empty())
     {
-        handle_fetch(error::object_doesnt_exist, message::block_locator());
+        handle_fetch(std::error_code(), std::make_shared<const data_chunk>(
+            read_bytes(raw_result, "payload")));
         return;
     }
-    // Start at max_depth
-    int current_depth = number_blocks_result.get<size_t>(0);
-    std::vector<size_t> indices;
-    // Push last 10 indices first
-    for (size_t i = 0; i < 10; ++i, --current_depth)
-        indices.push_back(current_depth);
-    size_t step = 1;
-    while (true)
+    // Rows from before payloads were kept, like the genesis block
+    cppdb::statement block_statement = sql.prepare(
+        "SELECT \
+            *, \
+            EXTRACT(EPOCH FROM when_created) timest \
+        FROM blocks \
+        WHERE block_hash=?"
+        );
+    binary_parameter fallback_hash_repr(block_hash);
+    block_statement.reset();
+    block_statement.bind(fallback_hash_repr);
+    cppdb::result block_result = block_statement.row();
+    if (block_result.empty())
     {
-        current_depth -= step;
-        if (current_depth <= 0)
-            break;
-        indices.push_back(current_depth);
-        step *= 2;
+        handle_fetch(error::object_doesnt_exist, data_chunk_ptr());
+        return;
     }
-    indices.push_back(0);
-    // Now actually fetch the hashes for these blocks
-    // TODO: UGLY!! Hack around limitation of cppdb!
-    std::stringstream hack_sql;
-    hack_sql <<
-        "SELECT block_hash \
-        FROM blocks \
-        WHERE \
-            span_left=0 \
-            AND span_right=0 \
-            AND depth IN (";
-    for (size_t i = 0; i < indices.size(); ++i)
+    if (read_pruned(block_result))
     {
-        if (i != 0)
-            hack_sql << ", ";
-        hack_sql << indices[i];
+        handle_fetch(error::block_pruned, data_chunk_ptr());
+        return;
     }
-    hack_sql << ") ORDER BY depth DESC";
-    // ----------------------------------------------
-    cppdb::result block_hashes_result = sql_ << hack_sql.str();
-    message::block_locator locator;
-    while (block_hashes_result.next())
+    message::block block = lease.reader().read_block(block_result);
+    handle_fetch(std::error_code(), std::make_shared<const data_chunk>(
+        original_dialect().to_network(block, false)));
+}
+
+void postgresql_storage::fetch_block_locator(
+        fetch_handler_block_locator handle_fetch)
+{
+    reader_threads_->service()->post(std::bind(
+        &postgresql_storage::do_fetch_block_locator, shared_from_this(),
+            handle_fetch));
+}
+void postgresql_storage::do_fetch_block_locator(
+        fetch_handler_block_locator handle_fetch)
+{
+    static latency_histogram& latency =
+        shared_metrics().get_histogram("storage.fetch_block_locator");
+    scoped_timer timer(latency);
+    message::block_locator locator = headers_->locator();
+    if (locator.empty())
     {
-        std::string block_hash_repr = block_hashes_result.get<std::string>(0);
-        locator.push_back(deserialize_hash(block_hash_repr));
+        handle_fetch(error::object_doesnt_exist, locator);
+        return;
     }
     handle_fetch(std::error_code(), locator);
 }
@@ -407,16 +671,21 @@ void postgresql_storage::do_fetch_block_locator(
 void postgresql_storage::fetch_output_by_hash(hash_digest transaction_hash, 
         uint32_t index, fetch_handler_output handle_fetch)
 {
-    strand()->post(std::bind(
-        &postgresql_storage::fetch_output_by_hash, shared_from_this(),
+    reader_threads_->service()->post(std::bind(
+        &postgresql_storage::do_fetch_output_by_hash, shared_from_this(),
             transaction_hash, index, handle_fetch));
 }
 void postgresql_storage::do_fetch_output_by_hash(hash_digest transaction_hash, 
         uint32_t index, fetch_handler_output handle_fetch)
 {
+    static latency_histogram& latency =
+        shared_metrics().get_histogram("storage.fetch_output_by_hash");
+    scoped_timer timer(latency);
+    postgresql_reader_pool::lease lease(*readers_);
+    cppdb::session& sql = lease.sql();
     message::transaction_output output;
-    std::string transaction_hash_repr = hexlify(transaction_hash);
-    cppdb::result result = sql_ <<
+    binary_parameter transaction_hash_repr(transaction_hash);
+    cppdb::result result = sql <<
         "SELECT \
             *, \
             sql_to_internal(value) internal_value \
@@ -435,35 +704,180 @@ void postgresql_storage::do_fetch_output_by_hash(hash_digest transaction_hash,
         return;
     }
     output.value = result.get<uint64_t>("internal_value");
-    size_t script_id = result.get<size_t>("script_id");
-    output.output_script = blockchain_->select_script(script_id);
+    output.output_script = parse_script(read_bytes(result, "script"));
     handle_fetch(std::error_code(), output);
 }
 
+void postgresql_storage::fetch_outputs(const output_point_list& points,
+        fetch_handler_outputs handle_fetch)
+{
+    reader_threads_->service()->post(std::bind(
+        &postgresql_storage::do_fetch_outputs, shared_from_this(),
+            points, handle_fetch));
+}
+void postgresql_storage::do_fetch_outputs(const output_point_list& points,
+        fetch_handler_outputs handle_fetch)
+{
+    static latency_histogram& latency =
+        shared_metrics().get_histogram("storage.fetch_outputs");
+    scoped_timer timer(latency);
+    postgresql_reader_pool::lease lease(*readers_);
+    message::transaction_output_list outputs(points.size());
+    std::vector<bool> found(points.size(), false);
+    // One round trip per chunk instead of one per output
+    bulk_select(lease.sql(),
+        "SELECT \
+            requests.position, \
+            script, \
+            sql_to_internal(value) internal_value \
+        FROM (VALUES ",
+        "(?::int, ?::bytea, ?::bigint)",
+        ") AS requests(position, hash, index_in_parent) \
+        JOIN transactions \
+        ON transaction_hash=requests.hash \
+        JOIN outputs \
+        ON outputs.transaction_id=transactions.transaction_id \
+            AND outputs.index_in_parent=requests.index_in_parent",
+        points.size(),
+        [&](cppdb::statement& statement, size_t i)
+        {
+            binary_parameter hash_repr(points[i].hash);
+            statement.bind(static_cast<int>(i));
+            statement.bind(hash_repr);
+            statement.bind(points[i].index);
+        },
+        [&](cppdb::result& result)
+        {
+            size_t position = result.get<int>("position");
+            message::transaction_output& output = outputs[position];
+            output.value = result.get<uint64_t>("internal_value");
+            output.output_script = parse_script(read_bytes(result, "script"));
+            found[position] = true;
+        });
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < points.size(); ++i)
+        if (!found[i])
+            missing.push_back(i);
+    handle_fetch(std::error_code(), outputs, missing);
+}
+
+void postgresql_storage::fetch_unspent_outputs(
+        const output_point_list& points, fetch_handler_outputs handle_fetch)
+{
+    // Misses load through the writer session, so stay on its thread
+    strand()->post(std::bind(
+        &postgresql_storage::do_fetch_unspent_outputs, shared_from_this(),
+            points, handle_fetch));
+}
+void postgresql_storage::do_fetch_unspent_outputs(
+        const output_point_list& points, fetch_handler_outputs handle_fetch)
+{
+    static latency_histogram& latency =
+        shared_metrics().get_histogram("storage.fetch_unspent_outputs");
+    scoped_timer timer(latency);
+    message::transaction_output_list outputs(points.size());
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        unspent_output output;
+        if (blockchain_->fetch_unspent(points[i], output))
+        {
+            outputs[i].value = output.value;
+            outputs[i].output_script = parse_script(output.raw_script);
+        }
+        else
+            missing.push_back(i);
+    }
+    handle_fetch(std::error_code(), outputs, missing);
+}
+
+void postgresql_storage::fetch_outputs_by_pubkey_hash(
+        const short_hash& pubkey_hash,
+        fetch_handler_address_outputs handle_fetch)
+{
+    reader_threads_->service()->post(std::bind(
+        &postgresql_storage::do_fetch_outputs_by_pubkey_hash,
+            shared_from_this(), pubkey_hash, handle_fetch));
+}
+void postgresql_storage::do_fetch_outputs_by_pubkey_hash(
+        const short_hash& pubkey_hash,
+        fetch_handler_address_outputs handle_fetch)
+{
+    static latency_histogram& latency =
+        shared_metrics().get_histogram("storage.fetch_outputs_by_pubkey_hash");
+    scoped_timer timer(latency);
+    address_output_list outputs;
+    if (!address_indexer_)
+    {
+        handle_fetch(error::unsupported_operation, outputs);
+        return;
+    }
+    postgresql_reader_pool::lease lease(*readers_);
+    binary_parameter pubkey_hash_repr(pubkey_hash);
+    // Rows of blocks reorganised away linger until the indexer comes
+    // back down to them, so hold them to the main chain here
+    cppdb::statement statement = lease.sql().prepare(
+        "SELECT \
+            transaction_hash, \
+            index_in_parent, \
+            sql_to_internal(value) internal_value, \
+            address_outputs.depth \
+        FROM address_outputs \
+        JOIN blocks \
+        ON blocks.block_id=address_outputs.block_id \
+        JOIN outputs \
+        ON outputs.output_id=address_outputs.output_id \
+        JOIN transactions \
+        ON transactions.transaction_id=outputs.transaction_id \
+        WHERE \
+            pubkey_hash=? \
+            AND space=0 \
+        ORDER BY address_outputs.depth, outputs.output_id"
+        );
+    statement.bind(pubkey_hash_repr);
+    cppdb::result result = statement.query();
+    while (result.next())
+    {
+        const output_point point{read_hash(result, "transaction_hash"),
+            result.get<uint32_t>("index_in_parent")};
+        outputs.push_back(address_output{point,
+            result.get<uint64_t>("internal_value"),
+            result.get<size_t>("depth")});
+    }
+    handle_fetch(std::error_code(), outputs);
+}
+
 void postgresql_storage::block_exists_by_hash(hash_digest block_hash,
         exists_handler handle_exists)
 {
-    strand()->post(std::bind(
+    reader_threads_->service()->post(std::bind(
         &postgresql_storage::do_block_exists_by_hash, shared_from_this(), 
             block_hash, handle_exists));
 }
 void postgresql_storage::do_block_exists_by_hash(hash_digest block_hash,
         exists_handler handle_exists)
 {
-    std::string block_hash_repr = hexlify(block_hash);
-    cppdb::result block_result = sql_ <<
-        "SELECT 1 \
-        FROM blocks \
-        WHERE \
-            block_hash=? \
-            AND span_left=0 \
-            AND span_left=0"
-        << block_hash_repr
-        << cppdb::row;
-    if (block_result.empty())
-        handle_exists(std::error_code(), false);
-    else
-        handle_exists(std::error_code(), true);
+    handle_exists(std::error_code(), headers_->contains(block_hash));
+}
+
+void postgresql_storage::blocks_exist(const hash_list& block_hashes,
+        exists_list_handler handle_exists)
+{
+    reader_threads_->service()->post(std::bind(
+        &postgresql_storage::do_blocks_exist, shared_from_this(),
+            block_hashes, handle_exists));
+}
+void postgresql_storage::do_blocks_exist(const hash_list& block_hashes,
+        exists_list_handler handle_exists)
+{
+    static latency_histogram& latency =
+        shared_metrics().get_histogram("storage.blocks_exist");
+    scoped_timer timer(latency);
+    std::vector<bool> exists;
+    exists.reserve(block_hashes.size());
+    for (const hash_digest& block_hash: block_hashes)
+        exists.push_back(headers_->contains(block_hash));
+    handle_exists(std::error_code(), exists);
 }
 
 } // libbitcoin
@@ -1,7 +1,10 @@
 #include <bitcoin/transaction.hpp>
 
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/endian.hpp>
 #include <bitcoin/util/serializer.hpp>
 #include <bitcoin/util/sha256.hpp>
+#include <bitcoin/util/thread_pool.hpp>
 #include <bitcoin/util/logger.hpp>
 #include <bitcoin/types.hpp>
 #include <bitcoin/constants.hpp>
@@ -14,34 +17,34 @@ hash_digest hash_transaction_impl(const message::transaction& transaction,
         uint32_t* hash_type_code)
 {
     serializer key;
+    key.reserve(transaction_size(transaction) + 4);
     key.write_4_bytes(transaction.version);
     key.write_var_uint(transaction.inputs.size());
-    for (message::transaction_input input: transaction.inputs)
+    for (const message::transaction_input& input: transaction.inputs)
     {
         key.write_hash(input.hash);
         key.write_4_bytes(input.index);
-        data_chunk raw_script = save_script(input.input_script);
-        key.write_var_uint(raw_script.size());
-        key.write_data(raw_script);
+        write_script(key, input.input_script);
         key.write_4_bytes(input.sequence);
     }
     key.write_var_uint(transaction.outputs.size());
-    for (message::transaction_output output: transaction.outputs)
+    for (const message::transaction_output& output: transaction.outputs)
     {
         key.write_8_bytes(output.value);
-        data_chunk raw_script = save_script(output.output_script);
-        key.write_var_uint(raw_script.size());
-        key.write_data(raw_script);
+        write_script(key, output.output_script);
     }
     key.write_4_bytes(transaction.locktime);
     if (hash_type_code != nullptr)
         key.write_4_bytes(*hash_type_code);
-    return generate_sha256_hash(key.get_data());
+    return generate_sha256_hash(key.release_data());
 }
 
 hash_digest hash_transaction(const message::transaction& transaction)
 {
-    return hash_transaction_impl(transaction, nullptr);
+    if (!transaction.cached_hash.valid())
+        transaction.cached_hash.set(
+            hash_transaction_impl(transaction, nullptr));
+    return transaction.cached_hash.get();
 }
 hash_digest hash_transaction(const message::transaction& transaction, 
         uint32_t hash_type_code)
@@ -49,39 +52,146 @@ hash_digest hash_transaction(const message::transaction& transaction,
     return hash_transaction_impl(transaction, &hash_type_code);
 }
 
-hash_digest build_merkle_tree(hash_list& merkle)
+signature_hash_template::signature_hash_template(
+    const message::transaction& tx)
 {
-    if (merkle.empty())
-        return null_hash;
-    else if (merkle.size() == 1)
-        return merkle[0];
+    serializer key;
+    key.reserve(transaction_size(tx));
+    key.write_4_bytes(tx.version);
+    key.write_var_uint(tx.inputs.size());
+    slots_.reserve(tx.inputs.size());
+    for (const message::transaction_input& input: tx.inputs)
+    {
+        key.write_hash(input.hash);
+        key.write_4_bytes(input.index);
+        slots_.push_back(key.size());
+        key.write_var_uint(0);
+        key.write_4_bytes(input.sequence);
+    }
+    key.write_var_uint(tx.outputs.size());
+    for (const message::transaction_output& output: tx.outputs)
+    {
+        key.write_8_bytes(output.value);
+        write_script(key, output.output_script);
+    }
+    key.write_4_bytes(tx.locktime);
+    template_ = key.release_data();
+
+    // One pass over the template covers every prefix
+    prefixes_.reserve(slots_.size());
+    sha256_stream prefix;
+    size_t hashed = 0;
+    for (size_t slot: slots_)
+    {
+        prefix.update(template_.data() + hashed, slot - hashed);
+        hashed = slot;
+        prefixes_.push_back(prefix);
+    }
+}
 
-    if (merkle.size()%2 != 0)
-        merkle.push_back(merkle.back());
+hash_digest signature_hash_template::digest(uint32_t input_index,
+    const script& script_code, uint32_t hash_type_code) const
+{
+    BITCOIN_ASSERT(input_index < slots_.size());
+    serializer code;
+    code.reserve(script_size(script_code) + 9);
+    write_script(code, script_code);
+    const data_chunk code_data = code.release_data();
+    sha256_stream stream = prefixes_[input_index];
+    stream.update(code_data);
+    // Skip the blank script's single length byte
+    const size_t rest = slots_[input_index] + 1;
+    stream.update(template_.data() + rest, template_.size() - rest);
+    byte hash_type[4];
+    to_little_endian(hash_type, hash_type_code);
+    stream.update(hash_type, sizeof(hash_type));
+    return stream.double_hash();
+}
+
+size_t signature_hash_template::inputs_size() const
+{
+    return slots_.size();
+}
 
+size_t transaction_size(const message::transaction& tx)
+{
+    // version + locktime
+    size_t size = 4 + 4;
+    size += variable_uint_size(tx.inputs.size());
+    for (const message::transaction_input& input: tx.inputs)
+    {
+        size_t script_length = script_size(input.input_script);
+        // previous output hash + index + script + sequence
+        size += 32 + 4 + variable_uint_size(script_length) + script_length + 4;
+    }
+    size += variable_uint_size(tx.outputs.size());
+    for (const message::transaction_output& output: tx.outputs)
+    {
+        size_t script_length = script_size(output.output_script);
+        size += 8 + variable_uint_size(script_length) + script_length;
+    }
+    return size;
+}
+
+// Pairs per range when a level is split across a thread pool
+constexpr size_t merkle_pairs_per_range = 512;
+
+// Hashes are flipped to wire order once up front. Each level is then
+// one contiguous run of 64 byte pairs hashed into the front half of the
+// same buffer, and only the root gets flipped back.
+hash_digest build_merkle_tree(hash_list& merkle, thread_pool* pool)
+{
+    static_assert(sizeof(hash_digest) == sha256_length,
+        "merkle levels assume tightly packed digests");
+    if (merkle.empty())
+        return null_hash;
+    for (hash_digest& hash: merkle)
+        std::reverse(hash.begin(), hash.end());
+    hash_list scratch;
     while (merkle.size() > 1)
     {
-        hash_list new_merkle;
-        for (auto it = merkle.begin(); it != merkle.end(); ++it)
+        if (merkle.size() % 2 != 0)
+            merkle.push_back(merkle.back());
+        size_t number_pairs = merkle.size() / 2;
+        byte* level = merkle[0].data();
+        if (pool != nullptr && number_pairs >= 2 * merkle_pairs_per_range)
         {
-            serializer concat;
-            concat.write_hash(*it);
-            ++it;
-            concat.write_hash(*it);
-            hash_digest new_root = generate_sha256_hash(concat.get_data());
-            new_merkle.push_back(new_root);
+            // Ranges would overwrite pairs other threads have yet to read
+            scratch.resize(number_pairs);
+            pool->parallel_for(number_pairs, merkle_pairs_per_range,
+                [&](size_t begin, size_t end)
+                {
+                    generate_sha256d_64(scratch[begin].data(),
+                        level + 2 * sha256_length * begin, end - begin);
+                });
+            std::copy(scratch.begin(), scratch.end(), merkle.begin());
         }
-        merkle = new_merkle;
+        else
+            generate_sha256d_64(level, level, number_pairs);
+        merkle.resize(number_pairs);
     }
+    std::reverse(merkle[0].begin(), merkle[0].end());
     return merkle[0];
 }
 
-hash_digest generate_merkle_root(const message::transaction_list& transactions)
+hash_digest merkle_root_impl(const message::transaction_list& transactions,
+    thread_pool* pool)
 {
     hash_list tx_hashes;
-    for (message::transaction tx: transactions)
+    tx_hashes.reserve(transactions.size() + 1);
+    for (const message::transaction& tx: transactions)
         tx_hashes.push_back(hash_transaction(tx));
-    return build_merkle_tree(tx_hashes);
+    return build_merkle_tree(tx_hashes, pool);
+}
+
+hash_digest generate_merkle_root(const message::transaction_list& transactions)
+{
+    return merkle_root_impl(transactions, nullptr);
+}
+hash_digest generate_merkle_root(const message::transaction_list& transactions,
+    thread_pool& pool)
+{
+    return merkle_root_impl(transactions, &pool);
 }
 
 std::string string_repr(const message::transaction_input& input)
@@ -109,10 +219,10 @@ std::string string_repr(const message::transaction& transaction)
         << "\tversion = " << transaction.version << "\n"
         << "\tlocktime = " << transaction.locktime << "\n"
         << "Inputs:\n";
-    for (message::transaction_input input: transaction.inputs)
+    for (const message::transaction_input& input: transaction.inputs)
         ss << string_repr(input);
     ss << "Outputs:\n";
-    for (message::transaction_output output: transaction.outputs)
+    for (const message::transaction_output& output: transaction.outputs)
         ss << string_repr(output);
     ss << "\n";
     return ss.str();
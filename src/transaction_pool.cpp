@@ -0,0 +1,342 @@
+#include <bitcoin/transaction_pool.hpp>
+
+#include <cstring>
+
+#include <bitcoin/constants.hpp>
+#include <bitcoin/dialect.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/util/assert.hpp>
+
+namespace libbitcoin {
+
+using std::placeholders::_1;
+using std::placeholders::_2;
+using std::placeholders::_3;
+
+constexpr size_t max_transaction_size = 100000;
+// Parsed scripts take a few times their wire size
+constexpr size_t parsed_overhead = 3;
+
+transaction_pool::transaction_pool(storage_ptr chain,
+    thread_pool_ptr verify_pool, size_t max_bytes, thread_pool_ptr executor)
+  : threaded_service(executor), chain_(chain), script_checks_(verify_pool),
+    max_bytes_(max_bytes), bytes_(0)
+{
+}
+
+// Context free, like check_block_context_free() does per transaction
+static bool check_transaction(const message::transaction& tx,
+    size_t tx_size)
+{
+    if (tx.inputs.empty() || tx.outputs.empty() || is_coinbase(tx))
+        return false;
+    if (tx_size > max_transaction_size)
+        return false;
+    uint64_t total_output_value = 0;
+    for (const message::transaction_output& output: tx.outputs)
+    {
+        if (output.value > max_money())
+            return false;
+        total_output_value += output.value;
+        if (total_output_value > max_money())
+            return false;
+    }
+    for (const message::transaction_input& input: tx.inputs)
+        if (previous_output_is_null(input))
+            return false;
+    return true;
+}
+
+void transaction_pool::store(const message::transaction& tx,
+    store_handler handle_store)
+{
+    strand()->post(std::bind(&transaction_pool::do_store,
+        shared_from_this(), std::make_shared<const message::transaction>(tx),
+            handle_store));
+}
+void transaction_pool::do_store(transaction_ptr tx,
+    store_handler handle_store)
+{
+    const hash_digest tx_hash = hash_transaction(*tx);
+    if (!check_transaction(*tx, transaction_size(*tx)))
+    {
+        handle_store(error::invalid_transaction);
+        return;
+    }
+    // Outputs of pool transactions are filled in here and the rest
+    // asked of the chain in one batch
+    message::transaction_output_list pool_outputs(tx->inputs.size());
+    std::vector<size_t> positions;
+    storage::output_point_list chain_points;
+    std::error_code ec;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (entries_.count(tx_hash) > 0)
+            ec = error::object_already_exists;
+        else if (conflicts(*tx))
+            ec = error::double_spend;
+        for (size_t i = 0; !ec && i < tx->inputs.size(); ++i)
+        {
+            const message::transaction_input& input = tx->inputs[i];
+            auto parent = entries_.find(input.hash);
+            if (parent == entries_.end())
+            {
+                positions.push_back(i);
+                chain_points.push_back(output_point{input.hash, input.index});
+            }
+            else if (input.index >= parent->second.tx->outputs.size())
+                ec = error::input_not_found;
+            else
+                pool_outputs[i] = parent->second.tx->outputs[input.index];
+        }
+    }
+    if (ec)
+    {
+        handle_store(ec);
+        return;
+    }
+    if (chain_points.empty())
+    {
+        checked_inputs(std::error_code(), message::transaction_output_list(),
+            std::vector<size_t>(), tx, tx_hash, pool_outputs, positions,
+            handle_store);
+        return;
+    }
+    chain_->fetch_unspent_outputs(chain_points,
+        strand()->wrap(std::bind(&transaction_pool::checked_inputs,
+            shared_from_this(), _1, _2, _3, tx, tx_hash, pool_outputs,
+                positions, handle_store)));
+}
+
+void transaction_pool::checked_inputs(const std::error_code& ec,
+    const message::transaction_output_list& chain_outputs,
+    const std::vector<size_t>& missing, transaction_ptr tx,
+    const hash_digest& tx_hash,
+    const message::transaction_output_list& pool_outputs,
+    const std::vector<size_t>& positions, store_handler handle_store)
+{
+    if (ec || !missing.empty())
+    {
+        handle_store(ec ? ec : error::input_not_found);
+        return;
+    }
+    message::transaction_output_list spent = pool_outputs;
+    std::vector<bool> from_chain(spent.size(), false);
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+        spent[positions[i]] = chain_outputs[i];
+        from_chain[positions[i]] = true;
+    }
+    hash_list parents;
+    for (size_t i = 0; i < spent.size(); ++i)
+        if (!from_chain[i])
+            parents.push_back(tx->inputs[i].hash);
+    uint64_t total_input_value = 0, total_output_value = 0;
+    for (const message::transaction_output& output: spent)
+    {
+        total_input_value += output.value;
+        if (output.value > max_money() || total_input_value > max_money())
+        {
+            handle_store(error::validate_inputs_failed);
+            return;
+        }
+    }
+    for (const message::transaction_output& output: tx->outputs)
+        total_output_value += output.value;
+    if (total_input_value < total_output_value)
+    {
+        handle_store(error::validate_inputs_failed);
+        return;
+    }
+    // The check list borrows the transaction, which the bound handler
+    // keeps alive until every check is done
+    script_check_list checks;
+    signature_hash_template_ptr sighash =
+        std::make_shared<signature_hash_template>(*tx);
+    for (uint32_t i = 0; i < tx->inputs.size(); ++i)
+        checks.push_back(
+            script_check{tx.get(), i, spent[i].output_script, sighash});
+    script_checks_.async_run(std::move(checks),
+        strand()->wrap(std::bind(&transaction_pool::checked_scripts,
+            shared_from_this(), _1, tx, tx_hash, parents,
+                total_input_value - total_output_value, handle_store)));
+}
+
+void transaction_pool::checked_scripts(bool success, transaction_ptr tx,
+    const hash_digest& tx_hash, const hash_list& parents, uint64_t fee,
+    store_handler handle_store)
+{
+    if (!success)
+    {
+        handle_store(error::validate_inputs_failed);
+        return;
+    }
+    data_chunk_ptr raw = std::make_shared<const data_chunk>(
+        original_dialect().to_network(*tx, false));
+    std::error_code ec;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // The pool may have moved on while the scripts ran
+        if (entries_.count(tx_hash) > 0)
+            ec = error::object_already_exists;
+        else if (conflicts(*tx))
+            ec = error::double_spend;
+        for (const hash_digest& parent: parents)
+            if (!ec && entries_.count(parent) == 0)
+                ec = error::input_not_found;
+        if (!ec)
+        {
+            insert(tx_hash, entry{tx, raw, fee,
+                sizeof(entry) + parsed_overhead * raw->size()});
+            enforce_limit();
+            if (entries_.count(tx_hash) == 0)
+                ec = error::pool_filled;
+        }
+    }
+    handle_store(ec);
+}
+
+void transaction_pool::remove_confirmed(message::block_ptr block)
+{
+    strand()->post(std::bind(&transaction_pool::do_remove_confirmed,
+        shared_from_this(), block));
+}
+void transaction_pool::do_remove_confirmed(message::block_ptr block)
+{
+    std::vector<hash_digest> tx_hashes;
+    tx_hashes.reserve(block->transactions.size());
+    for (const message::transaction& tx: block->transactions)
+        tx_hashes.push_back(hash_transaction(tx));
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < tx_hashes.size(); ++i)
+    {
+        // Whatever spends its outputs can stay, as they are now confirmed
+        erase(tx_hashes[i]);
+        const message::transaction& tx = block->transactions[i];
+        if (is_coinbase(tx))
+            continue;
+        for (const message::transaction_input& input: tx.inputs)
+        {
+            auto spend = spends_.find(output_point{input.hash, input.index});
+            if (spend != spends_.end())
+                erase_with_spenders(spend->second);
+        }
+    }
+}
+
+bool transaction_pool::exists(const hash_digest& tx_hash) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.count(tx_hash) > 0;
+}
+
+data_chunk_ptr transaction_pool::fetch_raw(const hash_digest& tx_hash) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(tx_hash);
+    if (it == entries_.end())
+        return data_chunk_ptr();
+    return it->second.raw;
+}
+
+void transaction_pool::for_each(visit_handler visit) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& tx_entry: entries_)
+        visit(tx_entry.first, *tx_entry.second.tx);
+}
+
+size_t transaction_pool::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+size_t transaction_pool::bytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+void transaction_pool::set_max_bytes(size_t max_bytes)
+{
+    strand()->post(std::bind(&transaction_pool::do_set_max_bytes,
+        shared_from_this(), max_bytes));
+}
+void transaction_pool::do_set_max_bytes(size_t max_bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_bytes_ = max_bytes;
+    enforce_limit();
+}
+
+bool transaction_pool::conflicts(const message::transaction& tx) const
+{
+    for (const message::transaction_input& input: tx.inputs)
+        if (spends_.count(output_point{input.hash, input.index}) > 0)
+            return true;
+    return false;
+}
+
+// Satoshis per kilobyte of wire size
+static uint64_t fee_rate(uint64_t fee, size_t tx_size)
+{
+    return fee * 1000 / tx_size;
+}
+
+void transaction_pool::insert(const hash_digest& tx_hash,
+    const entry& new_entry)
+{
+    entries_[tx_hash] = new_entry;
+    for (const message::transaction_input& input: new_entry.tx->inputs)
+        spends_[output_point{input.hash, input.index}] = tx_hash;
+    rates_.insert(std::make_pair(
+        fee_rate(new_entry.fee, new_entry.raw->size()), tx_hash));
+    bytes_ += new_entry.bytes;
+}
+
+void transaction_pool::erase(const hash_digest& tx_hash)
+{
+    auto it = entries_.find(tx_hash);
+    if (it == entries_.end())
+        return;
+    const entry& old_entry = it->second;
+    for (const message::transaction_input& input: old_entry.tx->inputs)
+        spends_.erase(output_point{input.hash, input.index});
+    rates_.erase(std::make_pair(
+        fee_rate(old_entry.fee, old_entry.raw->size()), tx_hash));
+    bytes_ -= old_entry.bytes;
+    entries_.erase(it);
+}
+
+void transaction_pool::erase_with_spenders(const hash_digest& tx_hash)
+{
+    std::vector<hash_digest> pending{tx_hash};
+    while (!pending.empty())
+    {
+        const hash_digest current = pending.back();
+        pending.pop_back();
+        auto it = entries_.find(current);
+        if (it == entries_.end())
+            continue;
+        for (uint32_t i = 0; i < it->second.tx->outputs.size(); ++i)
+        {
+            auto spend = spends_.find(output_point{current, i});
+            if (spend != spends_.end())
+                pending.push_back(spend->second);
+        }
+        erase(current);
+    }
+}
+
+void transaction_pool::enforce_limit()
+{
+    while (bytes_ > max_bytes_)
+    {
+        BITCOIN_ASSERT(!rates_.empty());
+        erase_with_spenders(rates_.begin()->second);
+    }
+}
+
+} // libbitcoin
+
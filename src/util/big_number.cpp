@@ -51,8 +51,9 @@ data_chunk big_number::get_data()
 
 void big_number::set_hash(hash_digest hash)
 {
-    data_chunk hash_data(hash.size());
-    std::copy(hash.begin(), hash.end(), hash_data.begin());
+    // Leading zero keeps the top bit from reading as the MPI sign
+    data_chunk hash_data(hash.size() + 1, 0);
+    std::copy(hash.begin(), hash.end(), hash_data.begin() + 1);
     set_data(hash_data);
 }
 
@@ -7,36 +7,118 @@
 
 namespace libbitcoin {
 
+// Built once and copied into each key, rather than looking the curve up
+// by name and rebuilding it for every signature.
+EC_GROUP* create_secp256k1_group()
+{
+    EC_GROUP* group = EC_GROUP_new_by_curve_name(NID_secp256k1);
+    if (group != nullptr)
+        EC_GROUP_precompute_mult(group, nullptr);
+    return group;
+}
+
+const EC_GROUP* secp256k1_group()
+{
+    static const EC_GROUP* group = create_secp256k1_group();
+    return group;
+}
+
 elliptic_curve_key::elliptic_curve_key()
   : key_(nullptr)
 {
 }
 
-bool elliptic_curve_key::set_public_key(data_chunk pubkey)
+elliptic_curve_key::~elliptic_curve_key()
+{
+    if (key_ != nullptr)
+        EC_KEY_free(key_);
+}
+
+bool elliptic_curve_key::set_public_key(const data_chunk& pubkey)
 {
     if (!initialize())
         return false;
-    const unsigned char* pubkey_bytes = &pubkey[0];
+    const unsigned char* pubkey_bytes = pubkey.data();
     if (!o2i_ECPublicKey(&key_, &pubkey_bytes, pubkey.size()))
         return false;
     return true;
 }
 
-bool elliptic_curve_key::verify(hash_digest hash, data_chunk signature)
+bool elliptic_curve_key::verify(hash_digest hash,
+    const data_chunk& signature) const
 {
+    if (key_ == nullptr)
+        return false;
     // SSL likes a reversed hash
     std::reverse(hash.begin(), hash.end());
     // -1 = error, 0 = bad sig, 1 = good
     if (ECDSA_verify(0, hash.data(), hash.size(), 
-            &signature[0], signature.size(), key_) == 1)
+            signature.data(), signature.size(), key_) == 1)
         return true;
     return false;
 }
 
 bool elliptic_curve_key::initialize()
 {
-    key_ = EC_KEY_new_by_curve_name(NID_secp256k1);
-    return key_ != nullptr;
+    if (key_ != nullptr)
+        return true;
+    const EC_GROUP* group = secp256k1_group();
+    if (group == nullptr)
+        return false;
+    key_ = EC_KEY_new();
+    if (key_ == nullptr)
+        return false;
+    return EC_KEY_set_group(key_, group) == 1;
+}
+
+public_key_cache::public_key_cache(size_t capacity)
+  : capacity_(std::max<size_t>(capacity, 1))
+{
+}
+
+elliptic_curve_key_ptr public_key_cache::get(const data_chunk& pubkey)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = keys_.find(pubkey);
+        if (it != keys_.end())
+            return it->second;
+    }
+    // Parse outside the lock. Two threads may race on the same new key,
+    // in which case the first insert wins and both results are valid.
+    elliptic_curve_key_ptr key(new elliptic_curve_key);
+    if (!key->set_public_key(pubkey))
+        return elliptic_curve_key_ptr();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto inserted = keys_.insert(std::make_pair(pubkey, key));
+    if (!inserted.second)
+        return inserted.first->second;
+    insertion_order_.push_back(inserted.first);
+    if (keys_.size() > capacity_)
+    {
+        keys_.erase(insertion_order_.front());
+        insertion_order_.pop_front();
+    }
+    return key;
+}
+
+public_key_cache& shared_public_key_cache()
+{
+    static public_key_cache cache;
+    return cache;
+}
+
+std::vector<bool> verify_signatures(const signature_check_list& checks,
+    public_key_cache& cache)
+{
+    std::vector<bool> results;
+    results.reserve(checks.size());
+    for (const signature_check& check: checks)
+    {
+        elliptic_curve_key_ptr key = cache.get(check.pubkey);
+        results.push_back(key && key->verify(check.hash, check.signature));
+    }
+    return results;
 }
 
 } // libbitcoin
@@ -0,0 +1,120 @@
+#include <bitcoin/util/hex.hpp>
+
+#include <array>
+
+namespace libbitcoin {
+
+// Each byte's two digits side by side, so encoding is one lookup a byte
+class encode_table
+{
+public:
+    encode_table()
+    {
+        const char digits[] = "0123456789abcdef";
+        for (size_t value = 0; value < 256; ++value)
+        {
+            pairs_[2 * value] = digits[value >> 4];
+            pairs_[2 * value + 1] = digits[value & 0x0f];
+        }
+    }
+    const char* pair(byte value) const
+    {
+        return &pairs_[2 * value];
+    }
+private:
+    std::array<char, 512> pairs_;
+};
+
+// The value of every character, or 0xff for ones that are not digits
+class decode_table
+{
+public:
+    decode_table()
+    {
+        values_.fill(0xff);
+        for (byte digit = 0; digit < 10; ++digit)
+            values_['0' + digit] = digit;
+        for (byte digit = 0; digit < 6; ++digit)
+        {
+            values_['a' + digit] = 10 + digit;
+            values_['A' + digit] = 10 + digit;
+        }
+    }
+    byte value(char digit) const
+    {
+        return values_[static_cast<unsigned char>(digit)];
+    }
+private:
+    std::array<byte, 256> values_;
+};
+
+// Built on first use, so callers during static initialisation are safe
+static const encode_table& encoder()
+{
+    static const encode_table table;
+    return table;
+}
+
+static const decode_table& decoder()
+{
+    static const decode_table table;
+    return table;
+}
+
+void encode_hex(const byte* data, size_t size, char* out)
+{
+    const encode_table& table = encoder();
+    for (size_t i = 0; i < size; ++i)
+    {
+        const char* pair = table.pair(data[i]);
+        out[2 * i] = pair[0];
+        out[2 * i + 1] = pair[1];
+    }
+}
+
+std::string encode_hex(const data_chunk& data)
+{
+    std::string hex(2 * data.size(), '0');
+    encode_hex(data.data(), data.size(), &hex[0]);
+    return hex;
+}
+
+std::string encode_hex(const hash_digest& hash)
+{
+    std::string hex(2 * hash.size(), '0');
+    encode_hex(hash.data(), hash.size(), &hex[0]);
+    return hex;
+}
+
+bool decode_hex(const char* hex, size_t size, byte* out)
+{
+    const decode_table& table = decoder();
+    for (size_t i = 0; i < size; ++i)
+    {
+        const byte high = table.value(hex[2 * i]),
+            low = table.value(hex[2 * i + 1]);
+        // Non-digits read as 0xff, the only values above 0x0f
+        if ((high | low) & 0xf0)
+            return false;
+        out[i] = (high << 4) | low;
+    }
+    return true;
+}
+
+bool decode_hex(const std::string& hex, data_chunk& out)
+{
+    if (hex.size() % 2 != 0)
+        return false;
+    out.resize(hex.size() / 2);
+    return decode_hex(hex.data(), out.size(), out.data());
+}
+
+bool decode_hex(const std::string& hex, hash_digest& out)
+{
+    if (hex.size() != 2 * out.size())
+        return false;
+    return decode_hex(hex.data(), out.size(), out.data());
+}
+
+} // libbitcoin
+
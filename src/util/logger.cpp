@@ -1,48 +1,201 @@
 #include <bitcoin/util/logger.hpp>
 
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 namespace libbitcoin {
 
-logger_wrapper::logger_wrapper(logger_level lev)
-  : lev_(lev)
+std::atomic<int> log_threshold(static_cast<int>(logger_level::debug));
+
+// How long the writer sleeps before looking again if a wake up is missed
+constexpr std::chrono::milliseconds idle_wait(50);
+
+// Multiple producer, single consumer queue after Dmitry Vyukov. Pushing
+// is one atomic exchange. The writer thread starts with the first
+// message and is joined, with everything written, at exit.
+class log_writer
 {
+public:
+    log_writer();
+    ~log_writer();
+
+    void push(logger_level level, const std::string& text);
+    void set_sink(log_sink_handler handle_message);
+    void flush();
+
+private:
+    struct node
+    {
+        std::atomic<node*> next;
+        logger_level level;
+        std::string text;
+    };
+
+    // Only ever called from the writer thread
+    node* pop();
+    void run();
+    void write(logger_level level, const std::string& text);
+    void wake();
+
+    std::atomic<node*> head_;
+    node* tail_;
+    std::atomic<size_t> pushed_, written_;
+    std::atomic<bool> sleeping_, stopping_;
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_, drained_;
+    log_sink_handler handle_message_;
+    std::once_flag started_;
+    std::thread thread_;
+};
+
+log_writer::log_writer()
+  : head_(new node), pushed_(0), written_(0), sleeping_(false),
+    stopping_(false)
+{
+    tail_ = head_.load();
+    tail_->next.store(nullptr);
 }
-logger_wrapper::logger_wrapper(const logger_wrapper& other)
-  : stream(other.stream.str())
+
+log_writer::~log_writer()
 {
+    stopping_.store(true);
+    if (thread_.joinable())
+    {
+        wake();
+        thread_.join();
+    }
+    // The stub left over, or everything if the thread never started
+    while (tail_)
+    {
+        node* next = tail_->next.load();
+        if (next)
+            write(next->level, next->text);
+        delete tail_;
+        tail_ = next;
+    }
 }
-logger_wrapper::~logger_wrapper()
+
+void log_writer::push(logger_level level, const std::string& text)
 {
-    if (lev_ == logger_level::error || lev_ == logger_level::fatal)
-        std::cerr << stream.str() << std::endl;
+    std::call_once(started_,
+        [this]
+        {
+            thread_ = std::thread(&log_writer::run, this);
+        });
+    node* item = new node;
+    item->next.store(nullptr, std::memory_order_relaxed);
+    item->level = level;
+    item->text = text;
+    node* previous = head_.exchange(item, std::memory_order_acq_rel);
+    previous->next.store(item);
+    pushed_.fetch_add(1, std::memory_order_relaxed);
+    // Sequentially consistent against the writer setting sleeping_
+    if (sleeping_.load())
+        wake();
+}
+
+void log_writer::wake()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    wakeup_.notify_one();
+}
+
+log_writer::node* log_writer::pop()
+{
+    node* next = tail_->next.load(std::memory_order_acquire);
+    if (!next)
+        return nullptr;
+    // next becomes the stub, so the old one can go
+    delete tail_;
+    tail_ = next;
+    return next;
+}
+
+void log_writer::run()
+{
+    while (true)
+    {
+        size_t count = 0;
+        for (node* item = pop(); item; item = pop())
+        {
+            write(item->level, item->text);
+            item->text.clear();
+            ++count;
+        }
+        if (count > 0)
+        {
+            std::cout.flush();
+            std::lock_guard<std::mutex> lock(mutex_);
+            written_.fetch_add(count);
+            drained_.notify_all();
+            continue;
+        }
+        if (stopping_.load())
+            return;
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleeping_.store(true);
+        if (!tail_->next.load() && !stopping_.load())
+            wakeup_.wait_for(lock, idle_wait);
+        sleeping_.store(false);
+    }
+}
+
+void log_writer::write(logger_level level, const std::string& text)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (handle_message_)
+        handle_message_(level, text);
+    else if (level == logger_level::error || level == logger_level::fatal)
+        std::cerr << text << '\n';
     else
-        std::cout << stream.str() << std::endl;
+        std::cout << text << '\n';
+}
+
+void log_writer::set_sink(log_sink_handler handle_message)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    handle_message_ = handle_message;
+}
+
+void log_writer::flush()
+{
+    const size_t target = pushed_.load();
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (written_.load() < target && thread_.joinable())
+    {
+        wakeup_.notify_one();
+        drained_.wait_for(lock, idle_wait);
+    }
 }
 
-logger_wrapper log_debug()
+static log_writer& writer()
 {
-    return logger_wrapper(logger_level::debug);
+    static log_writer instance;
+    return instance;
 }
 
-logger_wrapper log_info()
+void set_log_level(logger_level level)
 {
-    return logger_wrapper(logger_level::info);
+    log_threshold.store(static_cast<int>(level));
 }
 
-logger_wrapper log_warning()
+void set_log_sink(log_sink_handler handle_message)
 {
-    return logger_wrapper(logger_level::warning);
+    writer().set_sink(handle_message);
 }
 
-logger_wrapper log_error()
+void flush_log()
 {
-    return logger_wrapper(logger_level::error);
+    writer().flush();
 }
 
-logger_wrapper log_fatal()
+void log_message(logger_level level, const std::string& text)
 {
-    return logger_wrapper(logger_level::fatal);
+    writer().push(level, text);
 }
 
 } // libbitcoin
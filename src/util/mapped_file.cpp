@@ -0,0 +1,47 @@
+#include <bitcoin/util/mapped_file.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace libbitcoin {
+
+mapped_file::mapped_file(const std::string& path)
+  : data_(nullptr), size_(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        void* mapped = mmap(nullptr, info.st_size, PROT_READ,
+            MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED)
+        {
+            data_ = reinterpret_cast<const byte*>(mapped);
+            size_ = info.st_size;
+        }
+    }
+    close(fd);
+}
+
+mapped_file::~mapped_file()
+{
+    if (data_ != nullptr)
+        munmap(const_cast<byte*>(data_), size_);
+}
+
+const byte* mapped_file::data() const
+{
+    return data_;
+}
+
+size_t mapped_file::size() const
+{
+    return size_;
+}
+
+} // libbitcoin
+
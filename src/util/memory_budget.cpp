@@ -0,0 +1,131 @@
+#include <bitcoin/util/memory_budget.hpp>
+
+#include <algorithm>
+
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/metrics.hpp>
+
+namespace libbitcoin {
+
+memory_budget::memory_budget(size_t total_bytes)
+  : total_bytes_(total_bytes)
+{
+}
+
+void memory_budget::add_fixed(const std::string& name, usage_handler usage)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    users_.push_back(user{name, 0, usage, limit_handler(), 0});
+}
+
+void memory_budget::add(const std::string& name, double weight,
+    usage_handler usage, limit_handler set_limit)
+{
+    BITCOIN_ASSERT(weight > 0 && set_limit);
+    std::lock_guard<std::mutex> lock(mutex_);
+    users_.push_back(user{name, weight, usage, set_limit, 0});
+}
+
+void memory_budget::remove(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    users_.erase(std::remove_if(users_.begin(), users_.end(),
+        [&](const user& entry)
+        {
+            return entry.name == name;
+        }), users_.end());
+}
+
+void memory_budget::set_total(size_t total_bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    total_bytes_ = total_bytes;
+}
+
+size_t memory_budget::total() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return total_bytes_;
+}
+
+size_t memory_budget::limit(const std::string& name) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const user& entry: users_)
+        if (entry.name == name)
+            return entry.limit;
+    return 0;
+}
+
+void memory_budget::rebalance()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t count = users_.size();
+    std::vector<size_t> usage(count);
+    size_t fixed = 0, used = 0;
+    double total_weight = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        usage[i] = users_[i].usage();
+        used += usage[i];
+        if (users_[i].set_limit)
+            total_weight += users_[i].weight;
+        else
+            fixed += usage[i];
+    }
+    const size_t available = total_bytes_ > fixed ? total_bytes_ - fixed : 0;
+    // Shares by weight, then whatever those below theirs can spare goes
+    // to the rest, also by weight
+    std::vector<size_t> share(count, 0);
+    std::vector<bool> full(count, false);
+    size_t spare = 0;
+    double full_weight = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        user& entry = users_[i];
+        if (!entry.set_limit)
+            continue;
+        share[i] = available * (entry.weight / total_weight);
+        const size_t grown = usage[i] + usage[i] / 4;
+        if (grown < share[i])
+        {
+            entry.limit = std::max(grown, share[i] / 4);
+            spare += share[i] - entry.limit;
+        }
+        else
+        {
+            entry.limit = share[i];
+            full[i] = true;
+            full_weight += entry.weight;
+        }
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        user& entry = users_[i];
+        if (!entry.set_limit)
+        {
+            // No limit to speak of
+            shared_metrics().get_gauge(
+                "memory." + entry.name + ".bytes").set(usage[i]);
+            continue;
+        }
+        if (full[i])
+            entry.limit += spare * (entry.weight / full_weight);
+        else if (full_weight == 0)
+            // Nobody to lend to
+            entry.limit = share[i];
+        entry.set_limit(entry.limit);
+        publish(entry.name, usage[i], entry.limit);
+    }
+    publish("total", used, total_bytes_);
+}
+
+void memory_budget::publish(const std::string& name, size_t bytes,
+    size_t limit)
+{
+    shared_metrics().get_gauge("memory." + name + ".bytes").set(bytes);
+    shared_metrics().get_gauge("memory." + name + ".limit").set(limit);
+}
+
+} // libbitcoin
+
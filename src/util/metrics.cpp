@@ -0,0 +1,225 @@
+#include <bitcoin/util/metrics.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace libbitcoin {
+
+constexpr size_t latency_histogram::sub_buckets;
+constexpr size_t latency_histogram::bucket_count;
+
+counter::counter()
+  : value_(0)
+{
+}
+
+uint64_t counter::value() const
+{
+    return value_.load(std::memory_order_relaxed);
+}
+
+gauge::gauge()
+  : value_(0)
+{
+}
+
+int64_t gauge::value() const
+{
+    return value_.load(std::memory_order_relaxed);
+}
+
+// Log base 2 of the highest set bit
+static size_t highest_bit(uint64_t value)
+{
+    size_t bit = 0;
+    while (value >>= 1)
+        ++bit;
+    return bit;
+}
+
+static size_t bucket_index(uint64_t value)
+{
+    constexpr size_t sub_bits = 4;
+    if (value < latency_histogram::sub_buckets)
+        return value;
+    const size_t msb = highest_bit(value);
+    const size_t shift = msb - sub_bits;
+    const size_t sub = (value >> shift) & (latency_histogram::sub_buckets - 1);
+    return latency_histogram::sub_buckets * (shift + 1) + sub;
+}
+
+static uint64_t bucket_highest(size_t index)
+{
+    if (index < latency_histogram::sub_buckets)
+        return index;
+    const size_t shift = index / latency_histogram::sub_buckets - 1;
+    const uint64_t sub = index % latency_histogram::sub_buckets;
+    const uint64_t lowest = (latency_histogram::sub_buckets + sub) << shift;
+    return lowest + ((uint64_t(1) << shift) - 1);
+}
+
+latency_histogram::latency_histogram()
+  : count_(0), sum_(0), max_(0)
+{
+    for (std::atomic<uint64_t>& bucket: buckets_)
+        bucket.store(0, std::memory_order_relaxed);
+}
+
+void latency_histogram::record(uint64_t microseconds)
+{
+    buckets_[bucket_index(microseconds)].fetch_add(
+        1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(microseconds, std::memory_order_relaxed);
+    uint64_t highest = max_.load(std::memory_order_relaxed);
+    while (microseconds > highest &&
+        !max_.compare_exchange_weak(highest, microseconds,
+            std::memory_order_relaxed))
+        ;
+}
+
+uint64_t latency_histogram::count() const
+{
+    return count_.load(std::memory_order_relaxed);
+}
+
+uint64_t latency_histogram::sum() const
+{
+    return sum_.load(std::memory_order_relaxed);
+}
+
+uint64_t latency_histogram::max() const
+{
+    return max_.load(std::memory_order_relaxed);
+}
+
+uint64_t latency_histogram::percentile(double q) const
+{
+    // Count from the buckets themselves since count_ may be ahead
+    uint64_t total = 0;
+    for (const std::atomic<uint64_t>& bucket: buckets_)
+        total += bucket.load(std::memory_order_relaxed);
+    if (total == 0)
+        return 0;
+    q = std::min(std::max(q, 0.0), 1.0);
+    const uint64_t rank = std::max<uint64_t>(
+        static_cast<uint64_t>(std::ceil(q * total)), 1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucket_count; ++i)
+    {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return std::min(bucket_highest(i), max());
+    }
+    return max();
+}
+
+scoped_timer::scoped_timer(latency_histogram& histogram)
+  : histogram_(histogram), start_(timer_clock::now())
+{
+}
+
+scoped_timer::~scoped_timer()
+{
+    const timer_clock::duration elapsed = timer_clock::now() - start_;
+    histogram_.record(std::chrono::duration_cast<
+        std::chrono::microseconds>(elapsed).count());
+}
+
+template <typename Metric>
+Metric& find_or_add(std::map<std::string, std::unique_ptr<Metric>>& metrics,
+    const std::string& name)
+{
+    std::unique_ptr<Metric>& metric = metrics[name];
+    if (!metric)
+        metric.reset(new Metric);
+    return *metric;
+}
+
+counter& metrics_registry::get_counter(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return find_or_add(counters_, name);
+}
+
+gauge& metrics_registry::get_gauge(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return find_or_add(gauges_, name);
+}
+
+latency_histogram& metrics_registry::get_histogram(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return find_or_add(histograms_, name);
+}
+
+static uint64_t mean(const latency_histogram& histogram)
+{
+    const uint64_t count = histogram.count();
+    return count == 0 ? 0 : histogram.sum() / count;
+}
+
+std::string metrics_registry::to_text() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ostringstream text;
+    for (const auto& entry: counters_)
+        text << entry.first << ' ' << entry.second->value() << '\n';
+    for (const auto& entry: gauges_)
+        text << entry.first << ' ' << entry.second->value() << '\n';
+    for (const auto& entry: histograms_)
+    {
+        const std::string& name = entry.first;
+        const latency_histogram& histogram = *entry.second;
+        text << name << ".count " << histogram.count() << '\n'
+            << name << ".sum_us " << histogram.sum() << '\n'
+            << name << ".mean_us " << mean(histogram) << '\n'
+            << name << ".p50_us " << histogram.percentile(0.5) << '\n'
+            << name << ".p90_us " << histogram.percentile(0.9) << '\n'
+            << name << ".p99_us " << histogram.percentile(0.99) << '\n'
+            << name << ".max_us " << histogram.max() << '\n';
+    }
+    return text.str();
+}
+
+std::string metrics_registry::to_json() const
+{
+    // Names are our own dotted identifiers and need no escaping
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ostringstream json;
+    json << "{\"counters\":{";
+    for (auto it = counters_.begin(); it != counters_.end(); ++it)
+        json << (it == counters_.begin() ? "" : ",")
+            << '"' << it->first << "\":" << it->second->value();
+    json << "},\"gauges\":{";
+    for (auto it = gauges_.begin(); it != gauges_.end(); ++it)
+        json << (it == gauges_.begin() ? "" : ",")
+            << '"' << it->first << "\":" << it->second->value();
+    json << "},\"histograms\":{";
+    for (auto it = histograms_.begin(); it != histograms_.end(); ++it)
+    {
+        const latency_histogram& histogram = *it->second;
+        json << (it == histograms_.begin() ? "" : ",")
+            << '"' << it->first << "\":{"
+            << "\"count\":" << histogram.count()
+            << ",\"sum_us\":" << histogram.sum()
+            << ",\"mean_us\":" << mean(histogram)
+            << ",\"p50_us\":" << histogram.percentile(0.5)
+            << ",\"p90_us\":" << histogram.percentile(0.9)
+            << ",\"p99_us\":" << histogram.percentile(0.99)
+            << ",\"max_us\":" << histogram.max() << '}';
+    }
+    json << "}}";
+    return json.str();
+}
+
+metrics_registry& shared_metrics()
+{
+    static metrics_registry registry;
+    return registry;
+}
+
+} // libbitcoin
+
@@ -0,0 +1,109 @@
+#include <bitcoin/util/metrics_server.hpp>
+
+#include <functional>
+#include <istream>
+
+#include <bitcoin/util/logger.hpp>
+#include <bitcoin/util/trace.hpp>
+
+using std::placeholders::_1;
+
+namespace libbitcoin {
+
+// Anything longer than this is not a request we would answer
+constexpr size_t max_request_size = 8192;
+
+metrics_server::metrics_server(metrics_registry& registry)
+  : registry_(registry)
+{
+}
+
+metrics_server::~metrics_server()
+{
+    if (acceptor_)
+        acceptor_->close();
+}
+
+bool metrics_server::start(unsigned short port)
+{
+    acceptor_.reset(new tcp::acceptor(*service()));
+    try
+    {
+        tcp::endpoint endpoint(
+            boost::asio::ip::address_v4::loopback(), port);
+        acceptor_->open(endpoint.protocol());
+        acceptor_->set_option(tcp::acceptor::reuse_address(true));
+        acceptor_->bind(endpoint);
+        acceptor_->listen();
+    }
+    catch (std::exception& ex)
+    {
+        log_error() << "Serving metrics: " << ex.what();
+        return false;
+    }
+    strand()->post(std::bind(&metrics_server::accept, shared_from_this()));
+    return true;
+}
+
+void metrics_server::stop()
+{
+    metrics_server_ptr self = shared_from_this();
+    strand()->post(
+        [self]
+        {
+            boost::system::error_code ec;
+            self->acceptor_->close(ec);
+        });
+}
+
+void metrics_server::accept()
+{
+    socket_ptr socket(new tcp::socket(*service()));
+    acceptor_->async_accept(*socket, strand()->wrap(std::bind(
+        &metrics_server::handle_accept, shared_from_this(), _1, socket)));
+}
+
+void metrics_server::handle_accept(const boost::system::error_code& ec,
+    socket_ptr socket)
+{
+    if (ec == boost::asio::error::operation_aborted)
+        return;
+    if (!ec)
+    {
+        streambuf_ptr request(new boost::asio::streambuf(max_request_size));
+        boost::asio::async_read_until(*socket, *request, "\r\n\r\n",
+            strand()->wrap(std::bind(&metrics_server::handle_request,
+                shared_from_this(), _1, socket, request)));
+    }
+    accept();
+}
+
+void metrics_server::handle_request(const boost::system::error_code& ec,
+    socket_ptr socket, streambuf_ptr request)
+{
+    if (ec)
+        return;
+    std::istream stream(request.get());
+    std::string method, path;
+    stream >> method >> path;
+    const bool trace = path == "/trace.json";
+    const bool json = trace || path == "/metrics.json";
+    const std::string body = trace ? trace_to_chrome_json() :
+        json ? registry_.to_json() : registry_.to_text();
+    string_ptr response(new std::string);
+    *response += "HTTP/1.0 200 OK\r\nContent-Type: ";
+    *response += json ? "application/json" : "text/plain";
+    *response += "\r\nContent-Length: ";
+    *response += std::to_string(static_cast<unsigned long long>(body.size()));
+    *response += "\r\nConnection: close\r\n\r\n";
+    *response += body;
+    // The socket closes once the last handle on it goes
+    boost::asio::async_write(*socket, boost::asio::buffer(*response),
+        std::bind(
+            [](const boost::system::error_code&, socket_ptr, string_ptr)
+            {
+            }, _1, socket, response));
+}
+
+} // libbitcoin
+
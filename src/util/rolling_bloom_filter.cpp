@@ -0,0 +1,111 @@
+#include <bitcoin/util/rolling_bloom_filter.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace libbitcoin {
+
+// Finalizer from splitmix64, every input bit reaches every output bit
+static uint64_t mix(uint64_t value)
+{
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111eb;
+    return value ^ (value >> 31);
+}
+
+static uint64_t keyed_hash(const uint8_t* data, size_t size, uint64_t tweak)
+{
+    uint64_t state = mix(tweak ^ size);
+    for (; size >= sizeof(uint64_t); data += sizeof(uint64_t),
+        size -= sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        state = mix(state ^ word);
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, data, size);
+    return mix(state ^ tail);
+}
+
+rolling_bloom_filter::rolling_bloom_filter(size_t capacity,
+    double false_positive_rate)
+  : generation_capacity_(std::max<size_t>(capacity / 2, 1)), inserted_(0)
+{
+    // Optimal sizes for one generation: n * -ln(p) / ln(2)^2 bits and
+    // ln(2) * bits / n hashes
+    const double ln2 = std::log(2.0);
+    const double bits = -std::log(false_positive_rate) *
+        generation_capacity_ / (ln2 * ln2);
+    bit_count_ = std::max<size_t>(static_cast<size_t>(bits), 64);
+    hash_count_ = std::min<size_t>(std::max<size_t>(
+        static_cast<size_t>(ln2 * bit_count_ / generation_capacity_ + 0.5),
+            1), 32);
+    current_.resize((bit_count_ + 63) / 64);
+    previous_.resize(current_.size());
+    std::random_device device;
+    tweak_ = (static_cast<uint64_t>(device()) << 32) | device();
+}
+
+bool rolling_bloom_filter::set_in(const bit_array& bits, uint64_t first,
+    uint64_t second) const
+{
+    for (size_t i = 0; i < hash_count_; ++i)
+    {
+        const uint64_t bit = (first + i * second) % bit_count_;
+        if ((bits[bit / 64] & (uint64_t(1) << (bit % 64))) == 0)
+            return false;
+    }
+    return true;
+}
+
+void rolling_bloom_filter::insert(const uint8_t* data, size_t size)
+{
+    const uint64_t first = keyed_hash(data, size, tweak_),
+        second = mix(first ^ tweak_) | 1;
+    // Repeats would only age the filter faster
+    if (set_in(current_, first, second))
+        return;
+    if (inserted_ >= generation_capacity_)
+    {
+        previous_.swap(current_);
+        std::fill(current_.begin(), current_.end(), 0);
+        inserted_ = 0;
+    }
+    for (size_t i = 0; i < hash_count_; ++i)
+    {
+        const uint64_t bit = (first + i * second) % bit_count_;
+        current_[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+    ++inserted_;
+}
+void rolling_bloom_filter::insert(const hash_digest& hash)
+{
+    insert(hash.data(), hash.size());
+}
+
+bool rolling_bloom_filter::contains(const uint8_t* data, size_t size) const
+{
+    const uint64_t first = keyed_hash(data, size, tweak_),
+        second = mix(first ^ tweak_) | 1;
+    return set_in(current_, first, second) ||
+        set_in(previous_, first, second);
+}
+bool rolling_bloom_filter::contains(const hash_digest& hash) const
+{
+    return contains(hash.data(), hash.size());
+}
+
+void rolling_bloom_filter::clear()
+{
+    std::fill(current_.begin(), current_.end(), 0);
+    std::fill(previous_.begin(), previous_.end(), 0);
+    inserted_ = 0;
+}
+
+} // libbitcoin
+
@@ -1,6 +1,7 @@
 #include <bitcoin/util/serializer.hpp>
 
 #include <algorithm>
+#include <iterator>
 #include <string>
 
 #include <bitcoin/messages.hpp>
@@ -9,36 +10,39 @@
 
 namespace libbitcoin {
 
-inline void copy_data(std::vector<byte> &data,
-        const byte* raw_bytes, size_t len)
+template<typename T>
+void write_little_endian(data_chunk& data, T val)
 {
-    for (size_t i = 0; i < len; i++)
-        data.push_back(raw_bytes[i]);
+    byte raw_bytes[sizeof(T)];
+    to_little_endian(raw_bytes, val);
+    data.insert(data.end(), raw_bytes, raw_bytes + sizeof(T));
 }
 
-inline void copy_data_reverse(std::vector<byte> &data,
-        const byte* raw_bytes, size_t len)
+template<typename T>
+void write_big_endian(data_chunk& data, T val)
 {
-    for (int i = len - 1; i >= 0; i--)
-        data.push_back(raw_bytes[i]);
+    byte raw_bytes[sizeof(T)];
+    to_big_endian(raw_bytes, val);
+    data.insert(data.end(), raw_bytes, raw_bytes + sizeof(T));
 }
 
-template<typename T>
-void write_data_impl(data_chunk &data, T val, size_t len, bool reverse=false)
+serializer::serializer()
 {
-    byte* raw_bytes = reinterpret_cast<byte*>(&val);
-    #ifdef BOOST_LITTLE_ENDIAN
-        // do nothing
-    #elif BOOST_BIG_ENDIAN
-        reverse = true;
-    #else
-        #error "Endian isn't defined!"
-    #endif
+}
 
-    if (reverse)
-        copy_data_reverse(data, raw_bytes, len);
-    else
-        copy_data(data, raw_bytes, len);
+serializer::serializer(data_chunk&& buffer)
+  : data_(std::move(buffer))
+{
+}
+
+void serializer::reserve(size_t size_hint)
+{
+    data_.reserve(data_.size() + size_hint);
+}
+
+size_t serializer::size() const
+{
+    return data_.size();
 }
 
 void serializer::write_byte(uint8_t v)
@@ -48,17 +52,17 @@ void serializer::write_byte(uint8_t v)
 
 void serializer::write_2_bytes(uint16_t v)
 {
-    write_data_impl(data_, v, 2);
+    write_little_endian(data_, v);
 }
 
 void serializer::write_4_bytes(uint32_t v)
 {
-    write_data_impl(data_, v, 4);
+    write_little_endian(data_, v);
 }
 
 void serializer::write_8_bytes(uint64_t v)
 {
-    write_data_impl(data_, v, 8);
+    write_little_endian(data_, v);
 }
 
 void serializer::write_var_uint(uint64_t v)
@@ -89,28 +93,29 @@ void serializer::write_data(const data_chunk& other_data)
     extend_data(data_, other_data);
 }
 
-void serializer::write_net_addr(message::net_addr addr)
+void serializer::write_data(const byte* other_data, size_t size)
+{
+    data_.insert(data_.end(), other_data, other_data + size);
+}
+
+void serializer::write_net_addr(const message::net_addr& addr)
 {
     write_8_bytes(addr.services);
-    for (size_t i = 0; i < 16; i++)
-        data_.push_back(addr.ip_addr[i]);
-    write_data_impl(data_, addr.port, 2, true);
+    data_.insert(data_.end(), addr.ip_addr.begin(), addr.ip_addr.end());
+    write_big_endian(data_, addr.port);
 }
 
-void serializer::write_hash(hash_digest hash)
+void serializer::write_hash(const hash_digest& hash)
 {
-    for (size_t i = hash.size(); i-- > 0;)
-        data_.push_back(hash[i]);
+    data_.insert(data_.end(), hash.rbegin(), hash.rend());
 }
 
-void serializer::write_command(std::string command)
+void serializer::write_command(const std::string& command)
 {
     constexpr size_t comm_len = 12;
     char comm_str[comm_len] = { 0 };
     command.copy(comm_str, comm_len);
-    // should use std::copy
-    for (size_t i = 0; i < comm_len; i++)
-        data_.push_back(comm_str[i]);
+    data_.insert(data_.end(), comm_str, comm_str + comm_len);
 }
 
 data_chunk serializer::get_data() const
@@ -118,21 +123,38 @@ data_chunk serializer::get_data() const
     return data_;
 }
 
+data_chunk serializer::release_data()
+{
+    data_chunk released;
+    released.swap(data_);
+    return released;
+}
+
+size_t variable_uint_size(uint64_t v)
+{
+    if (v < 0xfd)
+        return 1;
+    else if (v <= 0xffff)
+        return 3;
+    else if (v <= 0xffffffff)
+        return 5;
+    return 9;
+}
+
 template<typename T>
-T consume_object(const data_chunk& stream, size_t& pointer)
+T read_little_endian(const data_chunk& data, size_t& pointer)
 {
-    T* val = reinterpret_cast<T*>(&stream[pointer]);
+    BITCOIN_ASSERT(pointer + sizeof(T) <= data.size());
+    const T val = from_little_endian<T>(data.data() + pointer);
     pointer += sizeof(T);
-    return *val;
+    return val;
 }
 
 template<typename T>
-T read_data_impl(const data_chunk& data, size_t& pointer, bool reverse=true)
+T read_big_endian(const data_chunk& data, size_t& pointer)
 {
-    data_chunk chunk(
-            data.begin() + pointer, 
-            data.begin() + pointer + sizeof(T));
-    T val = cast_chunk<T>(chunk, reverse);
+    BITCOIN_ASSERT(pointer + sizeof(T) <= data.size());
+    const T val = from_big_endian<T>(data.data() + pointer);
     pointer += sizeof(T);
     return val;
 }
@@ -142,6 +164,12 @@ deserializer::deserializer(const data_chunk& stream)
 {
 }
 
+deserializer::deserializer(const data_chunk& stream, size_t start)
+ : stream_(stream), pointer_(start)
+{
+    BITCOIN_ASSERT(start <= stream_.size());
+}
+
 uint8_t deserializer::read_byte()
 {
     return stream_[pointer_++];
@@ -149,17 +177,17 @@ uint8_t deserializer::read_byte()
 
 uint16_t deserializer::read_2_bytes()
 {
-    return read_data_impl<uint16_t>(stream_, pointer_);
+    return read_little_endian<uint16_t>(stream_, pointer_);
 }
 
 uint32_t deserializer::read_4_bytes()
 {
-    return read_data_impl<uint32_t>(stream_, pointer_);
+    return read_little_endian<uint32_t>(stream_, pointer_);
 }
 
 uint64_t deserializer::read_8_bytes()
 {
-    return read_data_impl<uint64_t>(stream_, pointer_);
+    return read_little_endian<uint64_t>(stream_, pointer_);
 }
 
 uint64_t deserializer::read_var_uint()
@@ -208,10 +236,16 @@ void read_bytes(const data_chunk& stream, size_t& pointer,
 
 data_chunk deserializer::read_data(uint64_t n_bytes)
 {
-    data_chunk raw_bytes;
-    for (uint64_t i = 0; i < n_bytes; ++i)
-        raw_bytes.push_back(read_byte());
-    return raw_bytes;
+    data_view view = read_view(n_bytes);
+    return data_chunk(view.begin(), view.end());
+}
+
+data_view deserializer::read_view(uint64_t n_bytes)
+{
+    BITCOIN_ASSERT(pointer_ + n_bytes <= stream_.size());
+    const byte* begin = stream_.data() + pointer_;
+    pointer_ += n_bytes;
+    return data_view(begin, begin + n_bytes);
 }
 
 message::net_addr deserializer::read_net_addr()
@@ -220,7 +254,7 @@ message::net_addr deserializer::read_net_addr()
     addr.services = read_8_bytes();
     // Read IP address
     read_bytes<16>(stream_, pointer_, addr.ip_addr);
-    addr.port = read_data_impl<uint16_t>(stream_, pointer_, false);
+    addr.port = read_big_endian<uint16_t>(stream_, pointer_);
     return addr;
 }
 
@@ -233,13 +267,21 @@ hash_digest deserializer::read_hash()
 
 std::string deserializer::read_fixed_len_str(size_t len)
 {
-    BITCOIN_ASSERT(pointer_ + len <= stream_.size());
-    std::string ret(
-            stream_.begin() + pointer_,
-            stream_.begin() + pointer_ + len);
-    pointer_ += len;
-    // Removes trailing 0s... Needed for string comparisons
-    return ret.c_str();
+    data_view view = read_view(len);
+    // Stop at the first 0. Trailing 0s would break string comparisons
+    auto str_end = std::find(view.begin(), view.end(), 0);
+    return std::string(view.begin(), str_end);
+}
+
+size_t deserializer::position() const
+{
+    return pointer_;
+}
+
+data_view deserializer::view_from(size_t start) const
+{
+    BITCOIN_ASSERT(start <= pointer_);
+    return data_view(stream_.data() + start, stream_.data() + pointer_);
 }
 
 } // libbitcoin
@@ -1,31 +1,145 @@
 #include <bitcoin/util/sha256.hpp>
 
 #include <boost/detail/endian.hpp>
+#include <algorithm>
 
 #include <bitcoin/util/logger.hpp>
 
+#include "sha256_engine.hpp"
+
 namespace libbitcoin {
 
+sha256_engine select_sha256_engine()
+{
+    sha256_engine engine;
+    load_sha256_portable(engine);
+    // SHA-NI beats 8 lanes of AVX2 even on 64 byte batches, so AVX2 is
+    // only tried when the SHA extensions are missing.
+    if (!load_sha256_shani(engine))
+        load_sha256_avx2(engine);
+    return engine;
+}
+
+const sha256_engine& selected_engine()
+{
+    static const sha256_engine selected = select_sha256_engine();
+    return selected;
+}
+
+const char* sha256_implementation()
+{
+    return selected_engine().name;
+}
+
+// Single SHA-256 of an arbitrary message with the digest left in state
+void sha256_message(uint32_t* state, const data_view& view)
+{
+    const sha256_engine& sha = selected_engine();
+    std::copy(sha256_initial_state, sha256_initial_state + 8, state);
+    size_t full_blocks = view.size() / 64;
+    sha.transform(state, view.begin(), full_blocks);
+    // Remaining bytes, the 0x80 marker and the 64 bit bit-length
+    byte tail[128] = {0};
+    size_t remainder = view.size() % 64;
+    std::copy(view.begin() + 64 * full_blocks, view.end(), tail);
+    tail[remainder] = 0x80;
+    size_t tail_blocks = remainder < 56 ? 1 : 2;
+    uint64_t bit_length = uint64_t(view.size()) * 8;
+    byte* length = tail + 64 * tail_blocks - 8;
+    write_big_endian_32(length, bit_length >> 32);
+    write_big_endian_32(length + 4, bit_length);
+    sha.transform(state, tail, tail_blocks);
+}
+
 hash_digest generate_sha256_hash(const data_chunk& chunk)
 {
-    SHA256_CTX ctx;
+    return generate_sha256_hash(data_view(chunk));
+}
+
+hash_digest generate_sha256_hash(const data_view& view)
+{
+    uint32_t state[8];
+    sha256_message(state, view);
+    byte first[sha256_length];
+    for (size_t i = 0; i < 8; ++i)
+        write_big_endian_32(first + 4 * i, state[i]);
+    sha256_message(state, data_view(first, first + sha256_length));
+    hash_digest digest;
+    for (size_t i = 0; i < 8; ++i)
+        write_big_endian_32(digest.data() + 4 * i, state[i]);
+    // Digest is produced backwards relative to how we display hashes
+    std::reverse(digest.begin(), digest.end());
+    return digest;
+}
+
+sha256_stream::sha256_stream()
+  : length_(0)
+{
+    std::copy(sha256_initial_state, sha256_initial_state + 8, state_);
+}
+
+void sha256_stream::update(const byte* data, size_t size)
+{
+    const sha256_engine& sha = selected_engine();
+    size_t used = length_ % 64;
+    length_ += size;
+    if (used != 0)
+    {
+        const size_t fill = std::min(size, 64 - used);
+        std::copy(data, data + fill, pending_ + used);
+        data += fill;
+        size -= fill;
+        if (used + fill < 64)
+            return;
+        sha.transform(state_, pending_, 1);
+    }
+    const size_t full_blocks = size / 64;
+    sha.transform(state_, data, full_blocks);
+    std::copy(data + 64 * full_blocks, data + size, pending_);
+}
+
+void sha256_stream::update(const data_chunk& data)
+{
+    update(data.data(), data.size());
+}
+
+hash_digest sha256_stream::double_hash() const
+{
+    uint32_t state[8];
+    std::copy(state_, state_ + 8, state);
+    byte tail[128] = {0};
+    const size_t remainder = length_ % 64;
+    std::copy(pending_, pending_ + remainder, tail);
+    tail[remainder] = 0x80;
+    const size_t tail_blocks = remainder < 56 ? 1 : 2;
+    const uint64_t bit_length = length_ * 8;
+    byte* length = tail + 64 * tail_blocks - 8;
+    write_big_endian_32(length, bit_length >> 32);
+    write_big_endian_32(length + 4, bit_length);
+    selected_engine().transform(state, tail, tail_blocks);
+    byte first[sha256_length];
+    for (size_t i = 0; i < 8; ++i)
+        write_big_endian_32(first + 4 * i, state[i]);
+    sha256_message(state, data_view(first, first + sha256_length));
     hash_digest digest;
-    SHA256_Init(&ctx);
-    SHA256_Update(&ctx, &chunk[0], chunk.size());
-    SHA256_Final(digest.data(), &ctx);
-    SHA256_Init(&ctx);
-    SHA256_Update(&ctx, digest.data(), sha256_length);
-    SHA256_Final(digest.data(), &ctx);
-    // SSL gives us the hash backwards
+    for (size_t i = 0; i < 8; ++i)
+        write_big_endian_32(digest.data() + 4 * i, state[i]);
     std::reverse(digest.begin(), digest.end());
     return digest;
 }
 
+void generate_sha256d_64(byte* output, const byte* input,
+    size_t number_blocks)
+{
+    selected_engine().double_hash_64(output, input, number_blocks);
+}
+
 uint32_t generate_sha256_checksum(const data_chunk& chunk)
 {
     hash_digest hash = generate_sha256_hash(chunk);
-    data_chunk begin_bytes(hash.end() - 4, hash.end());
-    return cast_chunk<uint32_t>(begin_bytes);
+    // First 4 bytes of the raw digest, read as little endian
+    return (uint32_t(hash[28]) << 24) | (uint32_t(hash[29]) << 16) |
+        (uint32_t(hash[30]) << 8) | uint32_t(hash[31]);
 }
 
 } // libbitcoin
@@ -0,0 +1,176 @@
+#include "sha256_engine.hpp"
+
+// Built with -mavx2. Without it this file only provides a loader that
+// reports the backend as unavailable.
+#if defined(__AVX2__)
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+namespace libbitcoin {
+
+// One 32 bit word from each of 8 independent messages
+typedef __m256i lanes;
+
+inline lanes add(lanes x, lanes y)
+{
+    return _mm256_add_epi32(x, y);
+}
+inline lanes rotate_right(lanes x, int n)
+{
+    return _mm256_or_si256(
+        _mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+inline lanes broadcast(uint32_t value)
+{
+    return _mm256_set1_epi32(value);
+}
+
+// Runs one block for each of the 8 lanes. w holds the first 16 schedule
+// words of every lane and is expanded in place.
+void transform_8way(lanes* state, lanes* w)
+{
+    for (size_t i = 16; i < 64; ++i)
+    {
+        lanes s0 = _mm256_xor_si256(_mm256_xor_si256(
+            rotate_right(w[i - 15], 7), rotate_right(w[i - 15], 18)),
+            _mm256_srli_epi32(w[i - 15], 3));
+        lanes s1 = _mm256_xor_si256(_mm256_xor_si256(
+            rotate_right(w[i - 2], 17), rotate_right(w[i - 2], 19)),
+            _mm256_srli_epi32(w[i - 2], 10));
+        w[i] = add(add(w[i - 16], s0), add(w[i - 7], s1));
+    }
+    lanes a = state[0], b = state[1], c = state[2], d = state[3],
+        e = state[4], f = state[5], g = state[6], h = state[7];
+    for (size_t i = 0; i < 64; ++i)
+    {
+        lanes sum1 = _mm256_xor_si256(_mm256_xor_si256(
+            rotate_right(e, 6), rotate_right(e, 11)), rotate_right(e, 25));
+        lanes choose = _mm256_xor_si256(g,
+            _mm256_and_si256(e, _mm256_xor_si256(f, g)));
+        lanes temp1 = add(add(h, sum1),
+            add(choose, add(broadcast(sha256_round_constants[i]), w[i])));
+        lanes sum0 = _mm256_xor_si256(_mm256_xor_si256(
+            rotate_right(a, 2), rotate_right(a, 13)), rotate_right(a, 22));
+        lanes majority = _mm256_or_si256(_mm256_and_si256(a, b),
+            _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        h = g;
+        g = f;
+        f = e;
+        e = add(d, temp1);
+        d = c;
+        c = b;
+        b = a;
+        a = add(temp1, add(sum0, majority));
+    }
+    state[0] = add(state[0], a);
+    state[1] = add(state[1], b);
+    state[2] = add(state[2], c);
+    state[3] = add(state[3], d);
+    state[4] = add(state[4], e);
+    state[5] = add(state[5], f);
+    state[6] = add(state[6], g);
+    state[7] = add(state[7], h);
+}
+
+void initial_state_8way(lanes* state)
+{
+    for (size_t i = 0; i < 8; ++i)
+        state[i] = broadcast(sha256_initial_state[i]);
+}
+
+// Double hashes 8 consecutive 64 byte messages
+void sha256d_64_8way(byte* output, const byte* input)
+{
+    lanes state[8], w[64];
+    for (size_t i = 0; i < 16; ++i)
+    {
+        const byte* word = input + 4 * i;
+        w[i] = _mm256_set_epi32(
+            read_big_endian_32(word + 64 * 7),
+            read_big_endian_32(word + 64 * 6),
+            read_big_endian_32(word + 64 * 5),
+            read_big_endian_32(word + 64 * 4),
+            read_big_endian_32(word + 64 * 3),
+            read_big_endian_32(word + 64 * 2),
+            read_big_endian_32(word + 64 * 1),
+            read_big_endian_32(word));
+    }
+    initial_state_8way(state);
+    transform_8way(state, w);
+    // Padding block for a 512 bit message
+    w[0] = broadcast(0x80000000);
+    for (size_t i = 1; i < 15; ++i)
+        w[i] = broadcast(0);
+    w[15] = broadcast(512);
+    transform_8way(state, w);
+
+    // Second pass over the 256 bit digests
+    for (size_t i = 0; i < 8; ++i)
+        w[i] = state[i];
+    w[8] = broadcast(0x80000000);
+    for (size_t i = 9; i < 15; ++i)
+        w[i] = broadcast(0);
+    w[15] = broadcast(256);
+    initial_state_8way(state);
+    transform_8way(state, w);
+
+    for (size_t i = 0; i < 8; ++i)
+    {
+        uint32_t words[8];
+        _mm256_storeu_si256(reinterpret_cast<lanes*>(words), state[i]);
+        for (size_t lane = 0; lane < 8; ++lane)
+            write_big_endian_32(output + 32 * lane + 4 * i, words[lane]);
+    }
+}
+
+void sha256d_64_avx2(byte* output, const byte* input,
+    size_t number_blocks)
+{
+    // Inputs are all loaded before any digest is stored, and the 8
+    // digests never reach past the 8 inputs, so in place still works.
+    size_t i = 0;
+    for (; i + 8 <= number_blocks; i += 8)
+        sha256d_64_8way(output + 32 * i, input + 64 * i);
+    sha256d_64_with(sha256_transform_portable,
+        output + 32 * i, input + 64 * i, number_blocks - i);
+}
+
+bool load_sha256_avx2(sha256_engine& engine)
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return false;
+    // The OS must save the YMM registers across context switches
+    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX))
+        return false;
+    uint32_t xcr0_low, xcr0_high;
+    __asm__ ("xgetbv" : "=a" (xcr0_low), "=d" (xcr0_high) : "c" (0));
+    if ((xcr0_low & 0x6) != 0x6)
+        return false;
+    if (__get_cpuid_max(0, nullptr) < 7)
+        return false;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    // CPUID.7.0:EBX bit 5
+    if (!(ebx & (1u << 5)))
+        return false;
+    engine.name = "avx2 8-way";
+    engine.double_hash_64 = sha256d_64_avx2;
+    return true;
+}
+
+} // libbitcoin
+
+#else
+
+namespace libbitcoin {
+
+bool load_sha256_avx2(sha256_engine&)
+{
+    return false;
+}
+
+} // libbitcoin
+
+#endif
+
@@ -0,0 +1,60 @@
+#ifndef LIBBITCOIN_SHA256_ENGINE_H
+#define LIBBITCOIN_SHA256_ENGINE_H
+
+#include <cstdint>
+
+#include <bitcoin/types.hpp>
+
+// Internal to the SHA-256 backends. Only src/util/sha256*.cpp use this.
+
+namespace libbitcoin {
+
+// Runs the compression function over consecutive 64 byte blocks
+typedef void (*sha256_transform_function)(
+    uint32_t* state, const byte* blocks, size_t number_blocks);
+// Same contract as generate_sha256d_64()
+typedef void (*sha256d_64_function)(
+    byte* output, const byte* input, size_t number_blocks);
+
+struct sha256_engine
+{
+    const char* name;
+    sha256_transform_function transform;
+    sha256d_64_function double_hash_64;
+};
+
+extern const uint32_t sha256_initial_state[8];
+extern const uint32_t sha256_round_constants[64];
+
+inline uint32_t read_big_endian_32(const byte* data)
+{
+    return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) |
+        (uint32_t(data[2]) << 8) | uint32_t(data[3]);
+}
+inline void write_big_endian_32(byte* data, uint32_t value)
+{
+    data[0] = value >> 24;
+    data[1] = value >> 16;
+    data[2] = value >> 8;
+    data[3] = value;
+}
+
+void sha256_transform_portable(uint32_t* state, const byte* blocks,
+    size_t number_blocks);
+
+// Double hash of 64 byte messages one at a time on top of a transform.
+// Reads each input block fully before writing its digest.
+void sha256d_64_with(sha256_transform_function transform,
+    byte* output, const byte* input, size_t number_blocks);
+
+// Each loader fills in what it accelerates and returns false when the
+// backend was not compiled in or the CPU lacks the instructions.
+// The portable loader always succeeds and sets every field.
+bool load_sha256_portable(sha256_engine& engine);
+bool load_sha256_shani(sha256_engine& engine);
+bool load_sha256_avx2(sha256_engine& engine);
+
+} // libbitcoin
+
+#endif
+
@@ -0,0 +1,123 @@
+#include "sha256_engine.hpp"
+
+#include <algorithm>
+
+namespace libbitcoin {
+
+const uint32_t sha256_initial_state[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+const uint32_t sha256_round_constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+inline uint32_t rotate_right(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+void sha256_transform_portable(uint32_t* state, const byte* blocks,
+    size_t number_blocks)
+{
+    for (size_t block = 0; block < number_blocks; ++block)
+    {
+        const byte* chunk = blocks + 64 * block;
+        uint32_t w[64];
+        for (size_t i = 0; i < 16; ++i)
+            w[i] = read_big_endian_32(chunk + 4 * i);
+        for (size_t i = 16; i < 64; ++i)
+        {
+            uint32_t s0 = rotate_right(w[i - 15], 7) ^
+                rotate_right(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotate_right(w[i - 2], 17) ^
+                rotate_right(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3],
+            e = state[4], f = state[5], g = state[6], h = state[7];
+        for (size_t i = 0; i < 64; ++i)
+        {
+            uint32_t sum1 = rotate_right(e, 6) ^ rotate_right(e, 11) ^
+                rotate_right(e, 25);
+            uint32_t choose = (e & f) ^ (~e & g);
+            uint32_t temp1 = h + sum1 + choose +
+                sha256_round_constants[i] + w[i];
+            uint32_t sum0 = rotate_right(a, 2) ^ rotate_right(a, 13) ^
+                rotate_right(a, 22);
+            uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t temp2 = sum0 + majority;
+            h = g;
+            g = f;
+            f = e;
+            e = d + temp1;
+            d = c;
+            c = b;
+            b = a;
+            a = temp1 + temp2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+void sha256d_64_with(sha256_transform_function transform,
+    byte* output, const byte* input, size_t number_blocks)
+{
+    // Padding blocks are fixed since every message is 64 or 32 bytes
+    byte padding[64] = {0x80};
+    padding[62] = 0x02;
+    for (size_t i = 0; i < number_blocks; ++i)
+    {
+        uint32_t state[8];
+        std::copy(sha256_initial_state, sha256_initial_state + 8, state);
+        transform(state, input + 64 * i, 1);
+        transform(state, padding, 1);
+        byte second[64] = {0};
+        for (size_t j = 0; j < 8; ++j)
+            write_big_endian_32(second + 4 * j, state[j]);
+        second[32] = 0x80;
+        second[62] = 0x01;
+        std::copy(sha256_initial_state, sha256_initial_state + 8, state);
+        transform(state, second, 1);
+        for (size_t j = 0; j < 8; ++j)
+            write_big_endian_32(output + 32 * i + 4 * j, state[j]);
+    }
+}
+
+void sha256d_64_portable(byte* output, const byte* input,
+    size_t number_blocks)
+{
+    sha256d_64_with(sha256_transform_portable, output, input, number_blocks);
+}
+
+bool load_sha256_portable(sha256_engine& engine)
+{
+    engine.name = "portable";
+    engine.transform = sha256_transform_portable;
+    engine.double_hash_64 = sha256d_64_portable;
+    return true;
+}
+
+} // libbitcoin
+
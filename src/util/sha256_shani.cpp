@@ -0,0 +1,107 @@
+#include "sha256_engine.hpp"
+
+// Built with -msse4.1 -msha. Without those flags this file only
+// provides a loader that reports the backend as unavailable.
+#if defined(__SHA__) && defined(__SSE4_1__)
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+namespace libbitcoin {
+
+void sha256_transform_shani(uint32_t* state, const byte* blocks,
+    size_t number_blocks)
+{
+    const __m128i byte_swap = _mm_set_epi64x(
+        0x0c0d0e0f08090a0bull, 0x0405060700010203ull);
+    // The SHA instructions keep the state as ABEF and CDGH
+    __m128i temp = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(state));
+    __m128i state1 = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(state + 4));
+    temp = _mm_shuffle_epi32(temp, 0xb1);
+    state1 = _mm_shuffle_epi32(state1, 0x1b);
+    __m128i state0 = _mm_alignr_epi8(temp, state1, 8);
+    state1 = _mm_blend_epi16(state1, temp, 0xf0);
+
+    for (size_t block = 0; block < number_blocks; ++block)
+    {
+        const byte* chunk = blocks + 64 * block;
+        const __m128i abef_save = state0, cdgh_save = state1;
+        __m128i message[4];
+        for (size_t i = 0; i < 4; ++i)
+            message[i] = _mm_shuffle_epi8(_mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(chunk + 16 * i)),
+                byte_swap);
+        // 16 groups of 4 rounds. Groups past the first 4 expand the
+        // message schedule in place, 4 words at a time.
+        for (size_t group = 0; group < 16; ++group)
+        {
+            __m128i& words = message[group % 4];
+            if (group >= 4)
+            {
+                const __m128i& last = message[(group + 3) % 4];
+                const __m128i& before_last = message[(group + 2) % 4];
+                __m128i expanded = _mm_sha256msg1_epu32(
+                    words, message[(group + 1) % 4]);
+                expanded = _mm_add_epi32(expanded,
+                    _mm_alignr_epi8(last, before_last, 4));
+                words = _mm_sha256msg2_epu32(expanded, last);
+            }
+            __m128i round_input = _mm_add_epi32(words, _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(
+                    sha256_round_constants + 4 * group)));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, round_input);
+            round_input = _mm_shuffle_epi32(round_input, 0x0e);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, round_input);
+        }
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+    }
+
+    temp = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    state0 = _mm_blend_epi16(temp, state1, 0xf0);
+    state1 = _mm_alignr_epi8(state1, temp, 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), state1);
+}
+
+void sha256d_64_shani(byte* output, const byte* input,
+    size_t number_blocks)
+{
+    sha256d_64_with(sha256_transform_shani, output, input, number_blocks);
+}
+
+bool load_sha256_shani(sha256_engine& engine)
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1))
+        return false;
+    if (__get_cpuid_max(0, nullptr) < 7)
+        return false;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    // CPUID.7.0:EBX bit 29
+    if (!(ebx & (1u << 29)))
+        return false;
+    engine.name = "sha-ni";
+    engine.transform = sha256_transform_shani;
+    engine.double_hash_64 = sha256d_64_shani;
+    return true;
+}
+
+} // libbitcoin
+
+#else
+
+namespace libbitcoin {
+
+bool load_sha256_shani(sha256_engine&)
+{
+    return false;
+}
+
+} // libbitcoin
+
+#endif
+
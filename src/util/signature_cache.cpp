@@ -0,0 +1,105 @@
+#include <bitcoin/util/signature_cache.hpp>
+
+#include <boost/thread/locks.hpp>
+
+#include <bitcoin/util/sha256.hpp>
+
+namespace libbitcoin {
+
+// Worst case cost of one entry: the key and its control byte, in a
+// table that has just doubled from seven eighths full
+constexpr size_t signature_cache_entry_size =
+    (sizeof(hash_digest) + 1) * 16 / 7;
+
+signature_cache::signature_cache(size_t max_bytes)
+  : hits_(0), misses_(0)
+{
+    std::random_device device;
+    for (uint8_t& salt_byte: salt_)
+        salt_byte = device();
+    random_.seed(device());
+    set_max_size(max_bytes);
+}
+
+void signature_cache::set_max_size(size_t max_bytes)
+{
+    boost::unique_lock<boost::shared_mutex> lock(mutex_);
+    max_entries_ = std::max<size_t>(
+        max_bytes / signature_cache_entry_size, 1);
+    while (entries_.size() > max_entries_)
+        evict_random_entry();
+}
+
+hash_digest signature_cache::entry_key(const hash_digest& sighash,
+    const data_chunk& pubkey, const data_chunk& signature) const
+{
+    data_chunk preimage;
+    preimage.reserve(salt_.size() + sighash.size() +
+        pubkey.size() + signature.size());
+    preimage.insert(preimage.end(), salt_.begin(), salt_.end());
+    preimage.insert(preimage.end(), sighash.begin(), sighash.end());
+    extend_data(preimage, pubkey);
+    extend_data(preimage, signature);
+    return generate_sha256_hash(preimage);
+}
+
+bool signature_cache::contains(const hash_digest& sighash,
+    const data_chunk& pubkey, const data_chunk& signature)
+{
+    hash_digest key = entry_key(sighash, pubkey, signature);
+    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+    if (entries_.contains(key))
+    {
+        ++hits_;
+        return true;
+    }
+    ++misses_;
+    return false;
+}
+
+void signature_cache::add(const hash_digest& sighash,
+    const data_chunk& pubkey, const data_chunk& signature)
+{
+    hash_digest key = entry_key(sighash, pubkey, signature);
+    boost::unique_lock<boost::shared_mutex> lock(mutex_);
+    if (entries_.size() >= max_entries_)
+        evict_random_entry();
+    entries_.insert(key);
+}
+
+void signature_cache::evict_random_entry()
+{
+    if (entries_.empty())
+        return;
+    // Start at a random slot and take the first entry found
+    const hash_digest victim = entries_.key_near(random_());
+    entries_.erase(victim);
+}
+
+size_t signature_cache::bytes() const
+{
+    return size() * signature_cache_entry_size;
+}
+
+size_t signature_cache::size() const
+{
+    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+    return entries_.size();
+}
+size_t signature_cache::hits() const
+{
+    return hits_;
+}
+size_t signature_cache::misses() const
+{
+    return misses_;
+}
+
+signature_cache& shared_signature_cache()
+{
+    static signature_cache instance;
+    return instance;
+}
+
+} // libbitcoin
+
@@ -0,0 +1,103 @@
+#include <bitcoin/util/thread_pool.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+
+namespace libbitcoin {
+
+void run_pool_service(service_ptr service)
+{
+    service->run();
+}
+
+thread_pool::thread_pool(size_t number_threads)
+{
+    if (number_threads == 0)
+        number_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    service_.reset(new io_service);
+    work_.reset(new io_service::work(*service_));
+    for (size_t i = 0; i < number_threads; ++i)
+        runners_.push_back(std::thread(run_pool_service, service_));
+}
+
+thread_pool::~thread_pool()
+{
+    service_->stop();
+    // The last owner can go away inside one of our own handlers. That
+    // runner holds its own reference to the service and exits once the
+    // handler returns.
+    for (std::thread& runner: runners_)
+        if (runner.get_id() == std::this_thread::get_id())
+            runner.detach();
+        else
+            runner.join();
+}
+
+size_t thread_pool::size() const
+{
+    return runners_.size();
+}
+
+service_ptr thread_pool::service()
+{
+    return service_;
+}
+
+// Tracks the ranges of one parallel_for() still in flight
+struct range_counter
+{
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t remaining;
+};
+
+void run_range(thread_pool::range_handler handle_range,
+    size_t begin, size_t end, range_counter& counter)
+{
+    handle_range(begin, end);
+    std::lock_guard<std::mutex> lock(counter.mutex);
+    if (--counter.remaining == 0)
+        counter.finished.notify_all();
+}
+
+void thread_pool::parallel_for(size_t count, size_t min_range,
+    range_handler handle_range)
+{
+    if (count == 0)
+        return;
+    // Workers plus the calling thread
+    size_t number_ranges = std::min(size() + 1,
+        std::max<size_t>(count / std::max<size_t>(min_range, 1), 1));
+    size_t range_size = (count + number_ranges - 1) / number_ranges;
+    number_ranges = (count + range_size - 1) / range_size;
+    if (number_ranges == 1)
+    {
+        handle_range(0, count);
+        return;
+    }
+    range_counter counter;
+    counter.remaining = number_ranges;
+    for (size_t i = 1; i < number_ranges; ++i)
+    {
+        size_t begin = i * range_size;
+        size_t end = std::min(begin + range_size, count);
+        service_->post(std::bind(run_range, handle_range,
+            begin, end, std::ref(counter)));
+    }
+    run_range(handle_range, 0, range_size, counter);
+    // Help drain the queue rather than idling, in case every worker is
+    // itself blocked inside a parallel_for().
+    while (service_->poll_one())
+    {
+        std::lock_guard<std::mutex> lock(counter.mutex);
+        if (counter.remaining == 0)
+            return;
+    }
+    std::unique_lock<std::mutex> lock(counter.mutex);
+    while (counter.remaining > 0)
+        counter.finished.wait(lock);
+}
+
+} // libbitcoin
+
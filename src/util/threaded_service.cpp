@@ -1,5 +1,9 @@
 #include <bitcoin/util/threaded_service.hpp>
 
+#include <algorithm>
+
+#include <bitcoin/util/thread_pool.hpp>
+
 namespace libbitcoin {
 
 void run_service(service_ptr service)
@@ -7,18 +11,48 @@ void run_service(service_ptr service)
     service->run();
 }
 
-threaded_service::threaded_service()
+threaded_service::threaded_service(size_t number_threads)
+{
+    start(number_threads);
+}
+
+threaded_service::threaded_service(thread_pool_ptr executor)
+  : executor_(executor)
+{
+    if (!executor_)
+    {
+        start(1);
+        return;
+    }
+    service_ = executor_->service();
+    strand_.reset(new io_service::strand(*service_));
+}
+
+void threaded_service::start(size_t number_threads)
 {
+    if (number_threads == 0)
+        number_threads = std::max(std::thread::hardware_concurrency(), 1u);
     service_.reset(new io_service);
     strand_.reset(new io_service::strand(*service_));
     work_.reset(new io_service::work(*service_));
-    runner_ = std::thread(run_service, service_);
+    for (size_t i = 0; i < number_threads; ++i)
+        runners_.push_back(std::thread(run_service, service_));
 }
 
 threaded_service::~threaded_service()
 {
+    // Other components still run on a shared pool
+    if (executor_)
+        return;
     service_->stop();
-    runner_.join();
+    // The last owner can go away inside one of our own handlers. That
+    // runner holds its own reference to the service and exits once the
+    // handler returns.
+    for (std::thread& runner: runners_)
+        if (runner.get_id() == std::this_thread::get_id())
+            runner.detach();
+        else
+            runner.join();
 }
 
 service_ptr threaded_service::service()
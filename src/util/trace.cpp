@@ -0,0 +1,161 @@
+#include <bitcoin/util/trace.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <bitcoin/util/hex.hpp>
+
+namespace libbitcoin {
+
+std::atomic<bool> trace_active(false);
+
+typedef std::chrono::high_resolution_clock trace_clock;
+
+// Spans end at block granularity, a handful per block, so one lock
+// around the ring costs nothing next to the stages being traced
+class trace_buffer
+{
+public:
+    trace_buffer();
+
+    uint64_t now() const;
+    void push(const trace_event& event);
+    trace_event_list events();
+    void clear();
+private:
+    const trace_clock::time_point epoch_;
+    std::mutex mutex_;
+    std::vector<trace_event> ring_;
+    // Total ever pushed, so the oldest is at next_ % capacity once full
+    size_t next_;
+};
+
+trace_buffer::trace_buffer()
+  : epoch_(trace_clock::now()), next_(0)
+{
+}
+
+uint64_t trace_buffer::now() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        trace_clock::now() - epoch_).count();
+}
+
+void trace_buffer::push(const trace_event& event)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ring_.size() < trace_capacity)
+        ring_.push_back(event);
+    else
+        ring_[next_ % trace_capacity] = event;
+    ++next_;
+}
+
+trace_event_list trace_buffer::events()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ring_.size() < trace_capacity)
+        return ring_;
+    trace_event_list ordered;
+    ordered.reserve(ring_.size());
+    const size_t oldest = next_ % trace_capacity;
+    ordered.insert(ordered.end(), ring_.begin() + oldest, ring_.end());
+    ordered.insert(ordered.end(), ring_.begin(), ring_.begin() + oldest);
+    return ordered;
+}
+
+void trace_buffer::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ring_.clear();
+    next_ = 0;
+}
+
+static trace_buffer& buffer()
+{
+    static trace_buffer instance;
+    return instance;
+}
+
+void set_tracing(bool enabled)
+{
+    // Starts the clock before the first span can read it
+    buffer();
+    trace_active.store(enabled);
+}
+
+trace_span::trace_span(const char* name, const hash_digest& block_hash)
+  : name_(name), block_hash_(block_hash), active_(tracing_enabled()),
+    start_(active_ ? buffer().now() : 0)
+{
+}
+
+trace_span::~trace_span()
+{
+    if (!active_)
+        return;
+    trace_buffer& ring = buffer();
+    trace_event event;
+    event.name = name_;
+    event.block_hash = block_hash_;
+    event.thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    event.start = start_;
+    event.duration = ring.now() - start_;
+    ring.push(event);
+}
+
+void trace_span::set_block(const hash_digest& block_hash)
+{
+    block_hash_ = block_hash;
+}
+
+trace_event_list trace_events()
+{
+    return buffer().events();
+}
+
+void clear_trace()
+{
+    buffer().clear();
+}
+
+std::string trace_to_chrome_json()
+{
+    const trace_event_list events = trace_events();
+    std::ostringstream json;
+    json << "{\"traceEvents\":[";
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        const trace_event& event = events[i];
+        json << (i == 0 ? "" : ",")
+            << "{\"name\":\"" << event.name << "\",\"cat\":\"block\""
+            << ",\"ph\":\"X\",\"pid\":1"
+            << ",\"tid\":" << (event.thread & 0xffffffff)
+            << ",\"ts\":" << event.start
+            << ",\"dur\":" << event.duration;
+        if (event.block_hash != hash_digest())
+        {
+            json << ",\"args\":{\"block\":\""
+                << encode_hex(event.block_hash) << "\"}";
+        }
+        json << '}';
+    }
+    json << "]}";
+    return json.str();
+}
+
+bool write_trace(const std::string& path)
+{
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+    file << trace_to_chrome_json();
+    return file.good();
+}
+
+} // libbitcoin
+
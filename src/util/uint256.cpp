@@ -0,0 +1,136 @@
+#include <bitcoin/util/uint256.hpp>
+
+#include <bitcoin/util/endian.hpp>
+
+namespace libbitcoin {
+
+uint256 uint256::from_hash(const hash_digest& hash)
+{
+    uint256 result;
+    for (size_t word = 0; word < 4; ++word)
+        result.words_[3 - word] =
+            from_big_endian<uint64_t>(hash.data() + 8 * word);
+    return result;
+}
+
+hash_digest uint256::to_hash() const
+{
+    hash_digest hash;
+    for (size_t word = 0; word < 4; ++word)
+        to_big_endian(hash.data() + 8 * word, words_[3 - word]);
+    return hash;
+}
+
+size_t uint256::bit_length() const
+{
+    for (size_t word = 4; word-- > 0;)
+        if (words_[word] != 0)
+        {
+            size_t length = 64 * word;
+            for (uint64_t value = words_[word]; value != 0; value >>= 1)
+                ++length;
+            return length;
+        }
+    return 0;
+}
+
+uint256& uint256::operator+=(const uint256& other)
+{
+    uint64_t carry = 0;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        const uint64_t sum = words_[i] + other.words_[i] + carry;
+        carry = sum < words_[i] || (carry && sum == words_[i]);
+        words_[i] = sum;
+    }
+    return *this;
+}
+
+uint256& uint256::operator-=(const uint256& other)
+{
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        const uint64_t difference = words_[i] - other.words_[i] - borrow;
+        borrow = other.words_[i] > words_[i] ||
+            (borrow && other.words_[i] == words_[i]);
+        words_[i] = difference;
+    }
+    return *this;
+}
+
+uint256& uint256::operator<<=(size_t shift)
+{
+    if (shift >= 256)
+        return *this = uint256();
+    const size_t words = shift / 64, bits = shift % 64;
+    for (size_t i = 4; i-- > 0;)
+    {
+        uint64_t value = 0;
+        if (i >= words)
+        {
+            value = words_[i - words] << bits;
+            if (bits != 0 && i > words)
+                value |= words_[i - words - 1] >> (64 - bits);
+        }
+        words_[i] = value;
+    }
+    return *this;
+}
+
+uint256& uint256::operator>>=(size_t shift)
+{
+    if (shift >= 256)
+        return *this = uint256();
+    const size_t words = shift / 64, bits = shift % 64;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        uint64_t value = 0;
+        if (i + words < 4)
+        {
+            value = words_[i + words] >> bits;
+            if (bits != 0 && i + words + 1 < 4)
+                value |= words_[i + words + 1] << (64 - bits);
+        }
+        words_[i] = value;
+    }
+    return *this;
+}
+
+uint256& uint256::operator/=(const uint256& divisor)
+{
+    if (divisor.is_zero() || *this < divisor)
+        return *this = uint256();
+    // Shift and subtract, one quotient bit per step
+    uint256 remainder = *this, quotient, shifted = divisor;
+    size_t shift = bit_length() - divisor.bit_length();
+    shifted <<= shift;
+    for (size_t bit = shift + 1; bit-- > 0;)
+    {
+        if (remainder >= shifted)
+        {
+            remainder -= shifted;
+            quotient.words_[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+        shifted >>= 1;
+    }
+    return *this = quotient;
+}
+
+uint256 operator+(uint256 left, const uint256& right)
+{
+    return left += right;
+}
+
+uint256 operator-(uint256 left, const uint256& right)
+{
+    return left -= right;
+}
+
+uint256 operator/(uint256 left, const uint256& right)
+{
+    return left /= right;
+}
+
+} // libbitcoin
+
@@ -0,0 +1,189 @@
+#include <bitcoin/utxo_set.hpp>
+
+
+#include <bitcoin/compressed_output.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/util/assert.hpp>
+
+namespace libbitcoin {
+
+// Rough cost of one entry, including the hash table node
+static size_t entry_bytes(const output_point& point,
+    const data_chunk& compressed_output)
+{
+    return sizeof(point) + 64 + compressed_output.capacity();
+}
+
+bool operator==(const output_point& point_a, const output_point& point_b)
+{
+    return point_a.index == point_b.index && point_a.hash == point_b.hash;
+}
+
+utxo_set::utxo_set(load_handler handle_load, flush_handler handle_flush,
+    size_t max_bytes)
+  : handle_load_(handle_load), handle_flush_(handle_flush),
+    max_bytes_(max_bytes), bytes_(0)
+{
+}
+
+bool utxo_set::fetch(const output_point& point, unspent_output& output)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    entry* found = find_or_load(point);
+    if (found == nullptr || found->spent)
+        return false;
+    return decompress_output(found->output, output);
+}
+
+bool utxo_set::connect(const message::block& block, undo_list& undo)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    undo.clear();
+    for (size_t i = 0; i < block.transactions.size(); ++i)
+    {
+        const message::transaction& tx = block.transactions[i];
+        if (!is_coinbase(tx))
+            for (const message::transaction_input& input: tx.inputs)
+            {
+                output_point point{input.hash, input.index};
+                entry* spent = find_or_load(point);
+                if (spent == nullptr || spent->spent)
+                {
+                    undo_connect(block, i, undo);
+                    undo.clear();
+                    return false;
+                }
+                unspent_output output;
+                decompress_output(spent->output, output);
+                undo.push_back(std::make_pair(point, std::move(output)));
+                spent->spent = true;
+                spent->dirty = true;
+            }
+        // Backing store has these already, so they start out clean
+        hash_digest tx_hash = hash_transaction(tx);
+        for (uint32_t j = 0; j < tx.outputs.size(); ++j)
+            insert(output_point{tx_hash, j}, entry{compress_output(
+                unspent_output{tx.outputs[j].value,
+                    save_script(tx.outputs[j].output_script)}),
+                false, false});
+    }
+    enforce_limit();
+    return true;
+}
+
+void utxo_set::disconnect(const message::block& block, const undo_list& undo)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    undo_connect(block, block.transactions.size(), undo);
+    enforce_limit();
+}
+
+void utxo_set::undo_connect(const message::block& block,
+    size_t number_transactions, const undo_list& undo)
+{
+    // Restore spends first. Outputs spent within the block are dropped
+    // again below along with the rest of the block's outputs.
+    for (auto it = undo.rbegin(); it != undo.rend(); ++it)
+        insert(it->first, entry{compress_output(it->second), false, true});
+    for (size_t i = 0; i < number_transactions; ++i)
+    {
+        const message::transaction& tx = block.transactions[i];
+        hash_digest tx_hash = hash_transaction(tx);
+        for (uint32_t j = 0; j < tx.outputs.size(); ++j)
+        {
+            auto it = entries_.find(output_point{tx_hash, j});
+            if (it != entries_.end())
+                erase(it);
+        }
+    }
+}
+
+void utxo_set::flush()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    flush_changes();
+}
+
+size_t utxo_set::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+size_t utxo_set::bytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+void utxo_set::set_max_bytes(size_t max_bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_bytes_ = max_bytes;
+    enforce_limit();
+}
+
+utxo_set::entry* utxo_set::find_or_load(const output_point& point)
+{
+    auto it = entries_.find(point);
+    if (it != entries_.end())
+        return &it->second;
+    unspent_output output;
+    if (!handle_load_(point, output))
+        return nullptr;
+    insert(point, entry{compress_output(output), false, false});
+    return &entries_.find(point)->second;
+}
+
+void utxo_set::insert(const output_point& point, entry new_entry)
+{
+    auto it = entries_.find(point);
+    if (it != entries_.end())
+        erase(it);
+    bytes_ += entry_bytes(point, new_entry.output);
+    entries_.insert(std::make_pair(point, std::move(new_entry)));
+}
+
+void utxo_set::erase(entry_map::iterator it)
+{
+    size_t size = entry_bytes(it->first, it->second.output);
+    BITCOIN_ASSERT(bytes_ >= size);
+    bytes_ -= size;
+    entries_.erase(it);
+}
+
+void utxo_set::flush_changes()
+{
+    change_list changes;
+    for (auto& value: entries_)
+        if (value.second.dirty)
+            changes.push_back(
+                std::make_pair(value.first, value.second.spent));
+    if (changes.empty())
+        return;
+    handle_flush_(changes);
+    for (auto it = entries_.begin(); it != entries_.end(); )
+    {
+        it->second.dirty = false;
+        // Spent outputs only stayed to remember the flag
+        if (it->second.spent)
+            erase(it++);
+        else
+            ++it;
+    }
+}
+
+void utxo_set::enforce_limit()
+{
+    if (bytes_ <= max_bytes_)
+        return;
+    // Everything is clean after a flush, so any entry can go. Dropping
+    // down to three quarters stops us flushing on every block.
+    flush_changes();
+    const size_t target_bytes = max_bytes_ / 4 * 3;
+    for (auto it = entries_.begin();
+            it != entries_.end() && bytes_ > target_bytes; )
+        erase(it++);
+}
+
+} // libbitcoin
+
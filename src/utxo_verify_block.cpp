@@ -0,0 +1,73 @@
+#include <bitcoin/utxo_verify_block.hpp>
+
+#include <map>
+
+#include <bitcoin/transaction.hpp>
+
+namespace libbitcoin {
+
+utxo_verify_block::utxo_verify_block(dialect_ptr dialect,
+    thread_pool_ptr pool, utxo_set& unspent,
+    const message::block& current_block, bool run_scripts)
+  : verify_block(dialect, pool, current_block),
+    unspent_(unspent), script_checks_(pool), current_block_(current_block),
+    run_scripts_(run_scripts)
+{
+}
+
+bool utxo_verify_block::check()
+{
+    if (!check_block())
+        return false;
+    // Spends are still checked against the outputs when connecting
+    if (run_scripts_ && !check_scripts())
+        return false;
+    return true;
+}
+
+bool utxo_verify_block::check_scripts()
+{
+    // Outputs can be spent by later transactions in the same block
+    std::map<hash_digest, const message::transaction*> block_transactions;
+    script_check_list checks;
+    for (const message::transaction& tx: current_block_.transactions)
+    {
+        if (!is_coinbase(tx))
+        {
+            signature_hash_template_ptr sighash =
+                std::make_shared<signature_hash_template>(tx);
+            for (uint32_t i = 0; i < tx.inputs.size(); ++i)
+            {
+                const message::transaction_input& input = tx.inputs[i];
+                script_check check{&tx, i, script(), sighash};
+                auto it = block_transactions.find(input.hash);
+                if (it != block_transactions.end())
+                {
+                    const message::transaction& previous_tx = *it->second;
+                    if (input.index >= previous_tx.outputs.size())
+                        return false;
+                    check.output_script =
+                        previous_tx.outputs[input.index].output_script;
+                }
+                else if (!fetch_output_script(input, check.output_script))
+                    return false;
+                checks.push_back(std::move(check));
+            }
+        }
+        block_transactions[hash_transaction(tx)] = &tx;
+    }
+    return script_checks_.run(std::move(checks));
+}
+
+bool utxo_verify_block::fetch_output_script(
+    const message::transaction_input& input, script& output_script)
+{
+    unspent_output output;
+    if (!unspent_.fetch(output_point{input.hash, input.index}, output))
+        return false;
+    output_script = parse_script(output.raw_script);
+    return true;
+}
+
+} // libbitcoin
+
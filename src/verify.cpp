@@ -9,6 +9,7 @@
 #include <bitcoin/util/logger.hpp>
 #include <bitcoin/util/postbind.hpp>
 #include <bitcoin/util/clock.hpp>
+#include <bitcoin/util/thread_pool.hpp>
 
 namespace libbitcoin {
 
@@ -18,78 +19,20 @@ using std::placeholders::_2;
 constexpr size_t max_block_size = 1000000;
 constexpr size_t max_block_script_operations = max_block_size / 50;
 
-verify_block::verify_block(dialect_ptr dialect, 
+verify_block::verify_block(dialect_ptr dialect, thread_pool_ptr pool,
     const message::block& current_block)
-  : dialect_(dialect), current_block_(current_block)
+  : dialect_(dialect), pool_(pool), current_block_(current_block)
 {
-    clock_.reset(new clock);
 }
 
 bool verify_block::check_block()
 {
-    // CheckBlock()
-    // These are checks that are independent of context
-    // that can be verified before saving an orphan block
-    // ...
-
-    // Size limits
-    if (current_block_.transactions.empty() || 
-        current_block_.transactions.size() > max_block_size ||
-        dialect_->to_network(current_block_, false).size() > max_block_size)
-    {
-        return false;
-    }
-
-    const hash_digest current_block_hash = hash_block_header(current_block_);
-    if (!check_proof_of_work(current_block_hash, current_block_.bits))
-        return false;
-
-    const ptime block_time = 
-            boost::posix_time::from_time_t(current_block_.timestamp);
-    if (block_time > clock_->get_time() + hours(2))
-        return false;
-
-    if (!is_coinbase(current_block_.transactions[0]))
-        return false;
-    for (size_t i = 1; i < current_block_.transactions.size(); ++i)
-    {
-        const message::transaction& tx = current_block_.transactions[i];
-        if (is_coinbase(tx))
-            return false;
-    }
-
-    for (message::transaction tx: current_block_.transactions)
-        if (!check_transaction(tx))
-            return false;
-
-    // Check that it's not full of nonstandard transactions
-    if (number_script_operations() > max_block_script_operations)
-        return false;
-
-    if (current_block_.merkle_root != 
-            generate_merkle_root(current_block_.transactions))
-        return false;
-
-    return true;
+    if (current_block_.context_checked.passed())
+        return true;
+    return check_block_context_free(current_block_, pool_.get());
 }
 
-bool verify_block::check_proof_of_work(hash_digest block_hash, uint32_t bits)
-{
-    big_number target;
-    target.set_compact(bits);
-
-    if (target <= 0 || target > max_target())
-        return false;
-    
-    big_number our_value;
-    our_value.set_hash(block_hash);
-    if (our_value > target)
-        return false;
-
-    return true;
-}
-
-bool verify_block::check_transaction(const message::transaction& tx)
+static bool check_transaction(const message::transaction& tx)
 {
     if (tx.inputs.empty() || tx.outputs.empty())
         return false;
@@ -100,7 +43,7 @@ bool verify_block::check_transaction(const message::transaction& tx)
 
     // Check for negative or overflow output values
     uint64_t total_output_value = 0;
-    for (message::transaction_output output: tx.outputs)
+    for (const message::transaction_output& output: tx.outputs)
     {
         if (output.value > max_money())
             return false;
@@ -118,7 +61,7 @@ bool verify_block::check_transaction(const message::transaction& tx)
     }
     else
     {
-        for (message::transaction_input input: tx.inputs)
+        for (const message::transaction_input& input: tx.inputs)
             if (previous_output_is_null(input))
                 return false;
     }
@@ -126,18 +69,80 @@ bool verify_block::check_transaction(const message::transaction& tx)
     return true;
 }
 
-size_t verify_block::number_script_operations()
+static size_t number_script_operations(const message::block& block)
 {
     size_t total_operations = 0;
-    for (message::transaction tx: current_block_.transactions)
+    for (const message::transaction& tx: block.transactions)
     {
-        for (message::transaction_input input: tx.inputs)
+        for (const message::transaction_input& input: tx.inputs)
             total_operations += input.input_script.operations().size();
-        for (message::transaction_output output: tx.outputs)
+        for (const message::transaction_output& output: tx.outputs)
             total_operations += output.output_script.operations().size();
     }
     return total_operations;
 }
 
+bool check_block_context_free(const message::block& block,
+    thread_pool* pool)
+{
+    // Size limits. The serialized size is computed rather than
+    // serializing the whole block again just to measure it.
+    if (block.transactions.empty() || 
+        block.transactions.size() > max_block_size ||
+        block_size(block) > max_block_size)
+    {
+        return false;
+    }
+
+    const hash_digest block_hash = hash_block_header(block);
+    if (!check_proof_of_work(block_hash, block.bits))
+        return false;
+
+    const ptime block_time = boost::posix_time::from_time_t(block.timestamp);
+    if (block_time > clock().get_time() + hours(2))
+        return false;
+
+    if (!is_coinbase(block.transactions[0]))
+        return false;
+    for (size_t i = 1; i < block.transactions.size(); ++i)
+        if (is_coinbase(block.transactions[i]))
+            return false;
+
+    for (const message::transaction& tx: block.transactions)
+        if (!check_transaction(tx))
+            return false;
+
+    // Check that it's not full of nonstandard transactions
+    if (number_script_operations(block) > max_block_script_operations)
+        return false;
+
+    const hash_digest merkle_root = pool != nullptr ?
+        generate_merkle_root(block.transactions, *pool) :
+        generate_merkle_root(block.transactions);
+    if (block.merkle_root != merkle_root)
+        return false;
+
+    block.context_checked.set_passed();
+    return true;
+}
+
+bool check_checkpoints(const checkpoint_list& checkpoints, size_t depth,
+    const hash_digest& block_hash)
+{
+    for (const checkpoint& point: checkpoints)
+        if (point.depth == depth)
+            return point.hash == block_hash;
+    return true;
+}
+
+bool check_proof_of_work(hash_digest block_hash, uint32_t bits)
+{
+    // Out of range encodings decode to zero
+    const uint256 target = uint256::from_compact(bits);
+    if (target.is_zero() || target > proof_of_work_limit)
+        return false;
+    return uint256::from_hash(block_hash) <= target;
+}
+
 } // libbitcoin
 
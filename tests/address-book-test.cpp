@@ -0,0 +1,85 @@
+#include <bitcoin/network/address_book.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <cstdio>
+#include <iostream>
+
+using namespace libbitcoin;
+using boost::posix_time::seconds;
+
+message::net_addr address(uint8_t id, uint32_t timestamp=1000)
+{
+    message::net_addr addr;
+    addr.timestamp = timestamp;
+    addr.services = 1;
+    addr.ip_addr = message::ip_address{{0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0xff, 0xff, 10, 0, 0, id}};
+    addr.port = 8333;
+    return addr;
+}
+
+int main()
+{
+    const ptime start(boost::gregorian::date(2012, 1, 1));
+    address_book book;
+    book.add(address(1));
+    book.add(address(1, 2000));
+    book.add(address(2));
+    // Nowhere to connect to
+    message::net_addr unset = address(3);
+    unset.port = 0;
+    book.add(unset);
+    BITCOIN_ASSERT(book.size() == 2);
+
+    // Each is handed out once while in use
+    message::net_addr first, second, third;
+    BITCOIN_ASSERT(book.select(start, first));
+    BITCOIN_ASSERT(book.select(start, second));
+    BITCOIN_ASSERT(first.ip_addr != second.ip_addr);
+    BITCOIN_ASSERT(!book.select(start, third));
+
+    // Failures back off for twice as long each time
+    book.failed(first, start);
+    BITCOIN_ASSERT(!book.select(start + seconds(29), third));
+    BITCOIN_ASSERT(book.select(start + seconds(30), third));
+    BITCOIN_ASSERT(third.ip_addr == first.ip_addr);
+    book.failed(third, start);
+    BITCOIN_ASSERT(!book.select(start + seconds(59), third));
+    BITCOIN_ASSERT(book.select(start + seconds(60), third));
+    book.connected(third);
+    book.disconnected(third, start);
+    BITCOIN_ASSERT(book.select(start + seconds(60), third));
+
+    // Too many failures in a row and it is dropped
+    for (uint8_t i = 0; i < address_book::max_failures; ++i)
+        book.failed(third, start);
+    BITCOIN_ASSERT(!book.contains(third) && book.size() == 1);
+
+    // Saved and loaded whole, with the newest timestamp kept
+    book.add(address(1, 2000));
+    const std::string path = "address-book-test.dat";
+    BITCOIN_ASSERT(book.save(path));
+    address_book loaded;
+    BITCOIN_ASSERT(loaded.load(path));
+    BITCOIN_ASSERT(loaded.size() == 2);
+    BITCOIN_ASSERT(loaded.contains(address(1)) && loaded.contains(address(2)));
+    message::net_addr any;
+    BITCOIN_ASSERT(loaded.select(start, any));
+    // A damaged file leaves the book empty
+    std::FILE* file = std::fopen(path.c_str(), "r+b");
+    std::fseek(file, 20, SEEK_SET);
+    std::fputc(0x55, file);
+    std::fclose(file);
+    BITCOIN_ASSERT(!loaded.load(path) && loaded.size() == 0);
+    std::remove(path.c_str());
+
+    // A full book makes room
+    address_book small_book(4);
+    for (uint8_t id = 1; id <= 10; ++id)
+        small_book.add(address(id, id));
+    BITCOIN_ASSERT(small_book.size() <= 4);
+    BITCOIN_ASSERT(small_book.contains(address(10)));
+
+    std::cout << "address book: OK" << std::endl;
+    return 0;
+}
+
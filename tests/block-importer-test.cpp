@@ -0,0 +1,118 @@
+#include <bitcoin/block_importer.hpp>
+#include <bitcoin/block.hpp>
+#include <bitcoin/constants.hpp>
+#include <bitcoin/dialect.hpp>
+#include <bitcoin/storage/flat_file_storage.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/thread_pool.hpp>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <string>
+
+#include "block_fixtures.hpp"
+
+using namespace libbitcoin;
+
+void write_4_bytes(data_chunk& out, uint32_t value)
+{
+    for (size_t i = 0; i < 4; ++i)
+        out.push_back(value >> (8 * i));
+}
+
+void append_record(data_chunk& file, const data_chunk& payload)
+{
+    write_4_bytes(file, magic_value);
+    write_4_bytes(file, payload.size());
+    extend_data(file, payload);
+}
+
+void write_file(const std::string& path, const data_chunk& data)
+{
+    std::ofstream(path, std::ios::binary).write(
+        reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+import_statistics run_import(block_importer_ptr importer,
+    const std::vector<std::string>& paths)
+{
+    std::promise<import_statistics> imported;
+    importer->import(paths,
+        [&](const std::error_code& ec, const import_statistics& statistics)
+        {
+            BITCOIN_ASSERT(!ec);
+            imported.set_value(statistics);
+        });
+    return imported.get_future().get();
+}
+
+void test_find_records(const data_chunk& payload)
+{
+    data_chunk file;
+    append_record(file, payload);
+    append_record(file, payload);
+    BITCOIN_ASSERT(find_block_records(file.data(), file.size()).size() == 2);
+    // A cut off record and preallocated zeros are both left out
+    data_chunk truncated(file.begin(), file.end() - 1);
+    block_record_list records =
+        find_block_records(truncated.data(), truncated.size());
+    BITCOIN_ASSERT(records.size() == 1);
+    BITCOIN_ASSERT(records[0].offset == 8 &&
+        records[0].size == payload.size());
+    file.resize(file.size() + 4096, 0);
+    BITCOIN_ASSERT(find_block_records(file.data(), file.size()).size() == 2);
+    BITCOIN_ASSERT(find_block_records(file.data(), 7).empty());
+}
+
+int main()
+{
+    char directory_template[] = "/tmp/block-importer-XXXXXX";
+    const std::string directory = mkdtemp(directory_template);
+    const message::block block_1 = create_block_1();
+    const data_chunk payload = original_dialect().to_network(block_1, false);
+    test_find_records(payload);
+
+    // The block, a second copy, then one with a broken nonce
+    data_chunk file;
+    append_record(file, payload);
+    append_record(file, payload);
+    data_chunk bad_payload = payload;
+    bad_payload[76] ^= 0x01;
+    append_record(file, bad_payload);
+    // Too short to hold the transaction count
+    append_record(file, data_chunk(payload.begin(), payload.begin() + 80));
+    file.resize(file.size() + 1024, 0);
+    const std::string path = directory + "/blk00000.dat";
+    write_file(path, file);
+
+    flat_file_storage_ptr store =
+        std::make_shared<flat_file_storage>(directory + "/store", 2);
+    BITCOIN_ASSERT(store->connected_size() == 1);
+    thread_pool_ptr parse_pool = std::make_shared<thread_pool>(2);
+    // Batches of one keep storage and parsing going at once
+    block_importer_ptr importer =
+        std::make_shared<block_importer>(store, parse_pool, 1);
+    import_statistics statistics = run_import(importer,
+        {path, directory + "/missing.dat"});
+    BITCOIN_ASSERT(statistics.files == 2 && statistics.blocks == 4);
+    BITCOIN_ASSERT(statistics.stored == 1 && statistics.duplicates == 1);
+    BITCOIN_ASSERT(statistics.rejected == 2);
+    BITCOIN_ASSERT(statistics.bytes == 3 * payload.size() + 80);
+    BITCOIN_ASSERT(store->connected_size() == 2);
+
+    // Going over it again stores nothing
+    importer = std::make_shared<block_importer>(store, parse_pool);
+    statistics = run_import(importer, {path});
+    BITCOIN_ASSERT(statistics.stored == 0 && statistics.duplicates == 2);
+    statistics = run_import(importer, {});
+    BITCOIN_ASSERT(statistics.files == 0 && statistics.blocks == 0);
+
+    importer.reset();
+    store.reset();
+    system(("rm -r " + directory).c_str());
+    std::cout << "block importer: OK" << std::endl;
+    return 0;
+}
+
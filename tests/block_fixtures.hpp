@@ -0,0 +1,68 @@
+#ifndef LIBBITCOIN_TESTS_BLOCK_FIXTURES_H
+#define LIBBITCOIN_TESTS_BLOCK_FIXTURES_H
+
+#include <string>
+
+#include <bitcoin/constants.hpp>
+#include <bitcoin/messages.hpp>
+#include <bitcoin/script.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/types.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/hex.hpp>
+
+namespace libbitcoin {
+
+// Test vectors are always well formed hex
+inline data_chunk bytes_from_pretty(const std::string& pretty)
+{
+    data_chunk result;
+    const bool success = decode_hex(pretty, result);
+    BITCOIN_ASSERT(success);
+    return result;
+}
+
+// In the order written, not reversed like block explorers show them
+inline hash_digest hash_from_pretty(const std::string& pretty)
+{
+    hash_digest hash;
+    const bool success = decode_hex(pretty, hash);
+    BITCOIN_ASSERT(success);
+    return hash;
+}
+
+// The first mainnet block after genesis
+inline message::block create_block_1()
+{
+    message::transaction coinbase;
+    coinbase.version = 1;
+    coinbase.locktime = 0;
+    message::transaction_input input;
+    input.hash = null_hash;
+    input.index = 0xffffffff;
+    input.input_script = parse_script(bytes_from_pretty("04ffff001d0104"));
+    input.sequence = 0xffffffff;
+    coinbase.inputs.push_back(input);
+    message::transaction_output output;
+    output.value = 5000000000;
+    output.output_script = parse_script(bytes_from_pretty(
+        "410496b538e853519c726a2c91e61ec11600ae1390813a627c66fb8be7947be63c"
+        "52da7589379515d4e0a604f8141781e62294721166bf621e73a82cbf2342c858eeac"));
+    coinbase.outputs.push_back(output);
+
+    message::block block;
+    block.version = 1;
+    block.prev_block = hash_from_pretty(
+        "000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f");
+    block.timestamp = 1231469665;
+    block.bits = 0x1d00ffff;
+    block.nonce = 2573394689;
+    block.transactions.push_back(coinbase);
+    block.merkle_root = generate_merkle_root(block.transactions);
+    return block;
+}
+
+} // libbitcoin
+
+#endif
+
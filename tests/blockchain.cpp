@@ -1,4 +1,5 @@
 #include "../src/storage/postgresql_blockchain.hpp"
+#include <bitcoin/header_index.hpp>
 #include <bitcoin/util/threaded_service.hpp>
 #include <bitcoin/util/logger.hpp>
 #include <bitcoin/storage/postgresql_storage.hpp>
@@ -26,6 +27,10 @@ public:
         postgresql_organizer::delete_branch(
             space, depth, span_left, span_right);
     }
+    void organize()
+    {
+        postgresql_organizer::organize();
+    }
 };
 
 // Tee hee 
@@ -38,6 +43,7 @@ public:
     void save_nodes();
     void display_nodes();
     void raise_barrier();
+    void organize();
     void delete_branch(std::string name);
 private:
     template<typename Iterator>
@@ -77,7 +83,10 @@ private:
 dummy_psql::dummy_psql()
   : sql_("postgresql:dbname=bitcoin;user=genjix")
 {
-    blockchain_.reset(new postgresql_blockchain(sql_, service()));
+    // Names are not real hashes, so the chain organizer has no headers
+    // and the nested set organizer below lays out the tree
+    blockchain_.reset(new postgresql_blockchain(sql_, service(), strand(),
+        std::make_shared<header_index>()));
     deletor_.reset(new override_delete(sql_));
     blockchain_->set_clearance(4);
 }
@@ -87,6 +96,11 @@ void dummy_psql::raise_barrier()
     blockchain_->raise_barrier();
 }
 
+void dummy_psql::organize()
+{
+    deletor_->organize();
+}
+
 void dummy_psql::create_tree(std::string diagram)
 {
     boost::erase_all(diagram, " ");
@@ -240,6 +254,7 @@ int main()
     dum.raise_barrier();
     dum.raise_barrier();
     dum.raise_barrier();
+    dum.organize();
 
     dum.delete_branch("bills");
     return 0;
@@ -0,0 +1,274 @@
+#include <bitcoin/storage/caching_storage.hpp>
+#include <bitcoin/block.hpp>
+#include <bitcoin/constants.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/thread_pool.hpp>
+#include <future>
+#include <iostream>
+#include <map>
+#include <string>
+
+using namespace libbitcoin;
+
+struct int_hasher
+{
+    size_t operator()(int key) const
+    {
+        return key;
+    }
+};
+
+void test_lru()
+{
+    lru_cache<int, std::string, int_hasher> cache(10);
+    cache.insert(1, "one", 4);
+    cache.insert(2, "two", 4);
+    std::string value;
+    // Touching 1 leaves 2 as the oldest
+    BITCOIN_ASSERT(cache.find(1, value) && value == "one");
+    cache.insert(3, "three", 4);
+    BITCOIN_ASSERT(!cache.contains(2));
+    BITCOIN_ASSERT(cache.contains(1) && cache.contains(3));
+    BITCOIN_ASSERT(cache.bytes() == 8 && cache.size() == 2);
+    cache.insert(3, "THREE", 2);
+    BITCOIN_ASSERT(cache.find(3, value) && value == "THREE");
+    BITCOIN_ASSERT(cache.bytes() == 6);
+    cache.insert(4, "too big", 11);
+    BITCOIN_ASSERT(!cache.contains(4) && cache.size() == 2);
+    cache.erase(1);
+    BITCOIN_ASSERT(!cache.find(1, value) && cache.bytes() == 2);
+}
+
+// Answers straight away and counts what reaches it
+class counting_storage
+  : public storage
+{
+public:
+    size_t block_fetches, output_fetches;
+
+    counting_storage()
+      : block_fetches(0), output_fetches(0)
+    {
+    }
+
+    void store(const message::inv&, store_handler handle_store)
+    {
+        handle_store(std::error_code());
+    }
+    void store(const message::transaction&, store_handler handle_store)
+    {
+        handle_store(error::unsupported_operation);
+    }
+    void store(message::block_ptr block, store_handler handle_store)
+    {
+        blocks_[hash_block_header(*block)] = *block;
+        handle_store(std::error_code());
+    }
+
+    void fetch_inventories(fetch_handler_inventories handle_fetch)
+    {
+        handle_fetch(error::object_doesnt_exist, message::inv_list());
+    }
+    void fetch_block_by_depth(size_t, fetch_handler_block handle_fetch)
+    {
+        handle_fetch(error::object_doesnt_exist, message::block());
+    }
+    void fetch_block_by_hash(hash_digest block_hash,
+        fetch_handler_block handle_fetch)
+    {
+        ++block_fetches;
+        auto it = blocks_.find(block_hash);
+        if (it == blocks_.end())
+            handle_fetch(error::object_doesnt_exist, message::block());
+        else
+            handle_fetch(std::error_code(), it->second);
+    }
+    void fetch_raw_block_by_hash(hash_digest,
+        fetch_handler_raw_block handle_fetch)
+    {
+        ++block_fetches;
+        handle_fetch(error::object_doesnt_exist, data_chunk_ptr());
+    }
+    void fetch_block_locator(fetch_handler_block_locator handle_fetch)
+    {
+        handle_fetch(error::object_doesnt_exist, message::block_locator());
+    }
+    void fetch_output_by_hash(hash_digest, uint32_t,
+        fetch_handler_output handle_fetch)
+    {
+        ++output_fetches;
+        handle_fetch(error::object_doesnt_exist,
+            message::transaction_output());
+    }
+    void fetch_blocks_by_depth_range(size_t, size_t,
+        fetch_handler_blocks handle_fetch)
+    {
+        handle_fetch(error::object_doesnt_exist, message::block_list());
+    }
+    void fetch_outputs(const output_point_list& points,
+        fetch_handler_outputs handle_fetch)
+    {
+        output_fetches += points.size();
+        std::vector<size_t> missing;
+        for (size_t i = 0; i < points.size(); ++i)
+            missing.push_back(i);
+        handle_fetch(std::error_code(),
+            message::transaction_output_list(points.size()), missing);
+    }
+    void fetch_unspent_outputs(const output_point_list& points,
+        fetch_handler_outputs handle_fetch)
+    {
+        fetch_outputs(points, handle_fetch);
+    }
+    void fetch_outputs_by_pubkey_hash(const short_hash&,
+        fetch_handler_address_outputs handle_fetch)
+    {
+        handle_fetch(error::unsupported_operation, address_output_list());
+    }
+    void block_exists_by_hash(hash_digest block_hash,
+        exists_handler handle_exists)
+    {
+        handle_exists(std::error_code(), blocks_.count(block_hash) > 0);
+    }
+    void blocks_exist(const hash_list& block_hashes,
+        exists_list_handler handle_exists)
+    {
+        std::vector<bool> exists;
+        for (const hash_digest& block_hash: block_hashes)
+            exists.push_back(blocks_.count(block_hash) > 0);
+        handle_exists(std::error_code(), exists);
+    }
+
+private:
+    std::map<hash_digest, message::block> blocks_;
+};
+
+message::block_ptr create_block(uint32_t nonce)
+{
+    message::transaction tx;
+    tx.version = 1;
+    tx.locktime = 0;
+    message::transaction_input input;
+    input.hash = null_hash;
+    input.index = 0xffffffff;
+    input.sequence = 0xffffffff;
+    tx.inputs.push_back(input);
+    message::transaction_output output;
+    output.value = 5000000000 + nonce;
+    output.output_script.push_operation(
+        operation{opcode::special, data_chunk(65, nonce)});
+    tx.outputs.push_back(output);
+
+    std::shared_ptr<message::block> block =
+        std::make_shared<message::block>();
+    block->version = 1;
+    block->prev_block = null_hash;
+    block->timestamp = 1231006505;
+    block->bits = 0x1d00ffff;
+    block->nonce = nonce;
+    block->transactions.push_back(tx);
+    block->merkle_root = generate_merkle_root(block->transactions);
+    return block;
+}
+
+bool fetch_block(caching_storage_ptr cache, const hash_digest& hash)
+{
+    std::promise<bool> fetched;
+    cache->fetch_block_by_hash(hash,
+        [&](const std::error_code& ec, const message::block& block)
+        {
+            fetched.set_value(!ec && hash_block_header(block) == hash);
+        });
+    return fetched.get_future().get();
+}
+
+uint64_t fetch_value(caching_storage_ptr cache, const hash_digest& hash)
+{
+    std::promise<uint64_t> fetched;
+    cache->fetch_output_by_hash(hash, 0,
+        [&](const std::error_code& ec,
+            const message::transaction_output& output)
+        {
+            fetched.set_value(ec ? 0 : output.value);
+        });
+    return fetched.get_future().get();
+}
+
+void test_cache(thread_pool_ptr executor)
+{
+    std::shared_ptr<counting_storage> backend =
+        std::make_shared<counting_storage>();
+    // Room for a couple of these blocks at most
+    caching_storage_ptr cache =
+        std::make_shared<caching_storage>(backend, 2000, 100000, executor);
+    std::vector<message::block_ptr> blocks;
+    for (uint32_t nonce = 0; nonce < 4; ++nonce)
+    {
+        blocks.push_back(create_block(nonce));
+        std::promise<std::error_code> stored;
+        cache->store(blocks.back(),
+            [&](const std::error_code& ec)
+            {
+                stored.set_value(ec);
+            });
+        BITCOIN_ASSERT(!stored.get_future().get());
+    }
+
+    // Written through, so the latest comes back without the backend
+    BITCOIN_ASSERT(fetch_block(cache, hash_block_header(*blocks[3])));
+    BITCOIN_ASSERT(backend->block_fetches == 0);
+    // The oldest was evicted and loads again from the backend
+    BITCOIN_ASSERT(fetch_block(cache, hash_block_header(*blocks[0])));
+    BITCOIN_ASSERT(backend->block_fetches == 1);
+    BITCOIN_ASSERT(fetch_block(cache, hash_block_header(*blocks[0])));
+    BITCOIN_ASSERT(backend->block_fetches == 1);
+
+    // Outputs of every stored block are there
+    for (uint32_t nonce = 0; nonce < 4; ++nonce)
+        BITCOIN_ASSERT(fetch_value(cache,
+            hash_transaction(blocks[nonce]->transactions[0])) ==
+                5000000000u + nonce);
+    BITCOIN_ASSERT(backend->output_fetches == 0);
+    BITCOIN_ASSERT(fetch_value(cache, null_hash) == 0);
+    BITCOIN_ASSERT(backend->output_fetches == 1);
+
+    cache_statistics statistics = cache->statistics();
+    BITCOIN_ASSERT(statistics.block_hits == 2);
+    BITCOIN_ASSERT(statistics.block_misses == 1);
+    BITCOIN_ASSERT(statistics.output_hits == 4);
+    BITCOIN_ASSERT(statistics.output_misses == 1);
+    BITCOIN_ASSERT(statistics.block_bytes <= 2000);
+    BITCOIN_ASSERT(hit_rate(statistics.output_hits,
+        statistics.output_misses) == 0.8);
+
+    // Only the uncached point of a batch reaches the backend
+    storage::output_point_list points{
+        output_point{hash_transaction(blocks[1]->transactions[0]), 0},
+        output_point{null_hash, 0},
+        output_point{hash_transaction(blocks[2]->transactions[0]), 0}};
+    std::promise<std::vector<size_t>> batch;
+    cache->fetch_outputs(points,
+        [&](const std::error_code& ec,
+            const message::transaction_output_list& outputs,
+            const std::vector<size_t>& missing)
+        {
+            BITCOIN_ASSERT(!ec && outputs.size() == 3);
+            BITCOIN_ASSERT(outputs[0].value == 5000000001u);
+            BITCOIN_ASSERT(outputs[2].value == 5000000002u);
+            batch.set_value(missing);
+        });
+    BITCOIN_ASSERT(batch.get_future().get() == std::vector<size_t>{1});
+    BITCOIN_ASSERT(backend->output_fetches == 2);
+}
+
+int main()
+{
+    test_lru();
+    test_cache(thread_pool_ptr());
+    // Behaves the same on a shared single thread executor
+    test_cache(std::make_shared<thread_pool>(1));
+    std::cout << "caching storage: OK" << std::endl;
+    return 0;
+}
+
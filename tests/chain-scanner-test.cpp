@@ -0,0 +1,109 @@
+#include <bitcoin/chain_scanner.hpp>
+#include <bitcoin/block.hpp>
+#include <bitcoin/dialect.hpp>
+#include <bitcoin/storage/flat_file_storage.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <string>
+
+#include "block_fixtures.hpp"
+
+using namespace libbitcoin;
+
+void test_columns(const message::block& block_1)
+{
+    // Two blocks built locally, so the raw rows are serialized here
+    message::block_list blocks{block_1, block_1};
+    blocks[1].transactions.push_back(block_1.transactions[0]);
+    blocks[1].transactions[1].locktime = 7;
+    blocks[1].transactions[1].cached_hash.reset();
+    transaction_columns columns;
+    fill_transaction_columns(blocks, 5, columns,
+        std::make_shared<thread_pool>(2));
+    BITCOIN_ASSERT(columns.depths == (std::vector<uint32_t>{5, 6, 6}));
+    BITCOIN_ASSERT(columns.positions == (std::vector<uint32_t>{0, 0, 1}));
+    BITCOIN_ASSERT(columns.locktimes == (std::vector<uint32_t>{0, 0, 7}));
+    BITCOIN_ASSERT(columns.input_counts == (std::vector<uint32_t>{1, 1, 1}));
+    BITCOIN_ASSERT(columns.output_values[2] == 5000000000);
+    BITCOIN_ASSERT(columns.hashes.size() == 3 * 32);
+    const hash_digest last_hash = hash_transaction(blocks[1].transactions[1]);
+    BITCOIN_ASSERT(std::equal(last_hash.begin(), last_hash.end(),
+        columns.hashes.begin() + 2 * 32));
+    const data_chunk last_raw =
+        original_dialect().to_network(blocks[1].transactions[1], false);
+    BITCOIN_ASSERT(columns.raw_offsets.size() == 4);
+    BITCOIN_ASSERT(columns.raw_offsets[3] == columns.raw.size());
+    BITCOIN_ASSERT(data_chunk(columns.raw.begin() + columns.raw_offsets[2],
+        columns.raw.end()) == last_raw);
+
+    // Reused columns are cut down to the new rows
+    fill_transaction_columns(message::block_list(), 0, columns);
+    BITCOIN_ASSERT(columns.depths.empty() && columns.raw.empty());
+    BITCOIN_ASSERT(columns.raw_offsets == (std::vector<uint64_t>{0}));
+}
+
+int main()
+{
+    char directory_template[] = "/tmp/chain-scanner-XXXXXX";
+    const std::string directory = mkdtemp(directory_template);
+    const hash_digest genesis_hash = hash_from_pretty(
+        "000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f");
+    message::block_ptr block_1 =
+        std::make_shared<message::block>(create_block_1());
+    test_columns(*block_1);
+
+    flat_file_storage_ptr store =
+        std::make_shared<flat_file_storage>(directory, 2);
+    std::promise<std::error_code> stored;
+    store->store(block_1,
+        [&](const std::error_code& ec)
+        {
+            stored.set_value(ec);
+        });
+    BITCOIN_ASSERT(!stored.get_future().get());
+
+    // A block a batch, stopping at the top of the chain
+    chain_scanner blocks_scanner(store, 0, 10, 1);
+    message::block_list blocks;
+    BITCOIN_ASSERT(!blocks_scanner.next_blocks(blocks));
+    BITCOIN_ASSERT(blocks.size() == 1);
+    BITCOIN_ASSERT(hash_block_header(blocks[0]) == genesis_hash);
+    BITCOIN_ASSERT(!blocks_scanner.done() && blocks_scanner.position() == 1);
+    BITCOIN_ASSERT(!blocks_scanner.next_blocks(blocks));
+    BITCOIN_ASSERT(blocks.size() == 1);
+    BITCOIN_ASSERT(hash_block_header(blocks[0]) ==
+        hash_block_header(*block_1));
+    BITCOIN_ASSERT(!blocks_scanner.next_blocks(blocks));
+    BITCOIN_ASSERT(blocks.empty() && blocks_scanner.done());
+    BITCOIN_ASSERT(blocks_scanner.position() == 2);
+
+    // Both blocks in one short batch
+    chain_scanner transactions_scanner(store, 0, 10, 5,
+        std::make_shared<thread_pool>(2));
+    transaction_columns columns;
+    BITCOIN_ASSERT(!transactions_scanner.next_transactions(columns));
+    BITCOIN_ASSERT(transactions_scanner.done());
+    BITCOIN_ASSERT(columns.depths == (std::vector<uint32_t>{0, 1}));
+    BITCOIN_ASSERT(columns.output_values[1] == 5000000000);
+    BITCOIN_ASSERT(data_chunk(columns.raw.begin() + columns.raw_offsets[1],
+        columns.raw.end()) ==
+            original_dialect().to_network(block_1->transactions[0], false));
+    BITCOIN_ASSERT(!transactions_scanner.next_transactions(columns));
+    BITCOIN_ASSERT(columns.depths.empty());
+
+    // Nothing to read at all
+    chain_scanner empty_scanner(store, 3, 3);
+    BITCOIN_ASSERT(empty_scanner.done());
+    chain_scanner above_scanner(store, 5, 10);
+    BITCOIN_ASSERT(!above_scanner.next_blocks(blocks));
+    BITCOIN_ASSERT(blocks.empty() && above_scanner.done());
+
+    store.reset();
+    system(("rm -r " + directory).c_str());
+    std::cout << "chain scanner: OK" << std::endl;
+    return 0;
+}
+
@@ -0,0 +1,50 @@
+#include <bitcoin/network/channel_registry.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <iostream>
+#include <set>
+
+using namespace libbitcoin;
+
+// The registry never looks inside a channel, so any distinct pointer
+// stands in for one
+channel_ptr create_channel(std::shared_ptr<int> owner, size_t number)
+{
+    return channel_ptr(owner, reinterpret_cast<channel_pimpl*>(
+        owner.get() + number));
+}
+
+int main()
+{
+    std::shared_ptr<int> owner(new int[100], [](int* ints) { delete[] ints; });
+    channel_registry channels;
+    BITCOIN_ASSERT(!channels.random());
+    for (channel_handle chandle = 0; chandle < 100; ++chandle)
+        BITCOIN_ASSERT(channels.add(chandle, create_channel(owner, chandle)));
+    BITCOIN_ASSERT(!channels.add(5, create_channel(owner, 5)));
+    BITCOIN_ASSERT(channels.size() == 100);
+    BITCOIN_ASSERT(channels.find(42) == create_channel(owner, 42));
+    BITCOIN_ASSERT(!channels.find(100));
+
+    // Removing from the middle keeps every other handle findable
+    BITCOIN_ASSERT(channels.remove(10) == create_channel(owner, 10));
+    BITCOIN_ASSERT(!channels.remove(10));
+    BITCOIN_ASSERT(channels.remove(99) == create_channel(owner, 99));
+    BITCOIN_ASSERT(channels.size() == 98);
+    for (channel_handle chandle = 0; chandle < 99; ++chandle)
+        if (chandle != 10)
+            BITCOIN_ASSERT(channels.find(chandle) ==
+                create_channel(owner, chandle));
+    BITCOIN_ASSERT(channels.all().size() == 98);
+
+    std::set<channel_ptr> picked;
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        channel_ptr channel_obj = channels.random();
+        BITCOIN_ASSERT(channel_obj && channel_obj != create_channel(owner, 10));
+        picked.insert(channel_obj);
+    }
+    BITCOIN_ASSERT(picked.size() > 50);
+    std::cout << "channel registry: OK" << std::endl;
+    return 0;
+}
+
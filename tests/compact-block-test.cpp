@@ -0,0 +1,143 @@
+#include <bitcoin/compact_block.hpp>
+#include <bitcoin/block.hpp>
+#include <bitcoin/dialect.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <iostream>
+
+using namespace libbitcoin;
+
+// magic + command + length + checksum
+constexpr size_t header_size = 4 + 12 + 4 + 4;
+
+message::transaction create_transaction(uint32_t locktime)
+{
+    message::transaction tx;
+    tx.version = 1;
+    tx.locktime = locktime;
+    message::transaction_input input;
+    input.hash = hash_digest{0x39, 0x7f, 0x72, 0x33};
+    input.index = locktime;
+    input.input_script.push_operation(
+        operation{opcode::special, data_chunk(71, 0x30)});
+    input.sequence = 4294967295;
+    tx.inputs.push_back(input);
+    message::transaction_output output;
+    output.value = 50;
+    output.output_script.push_operation(
+        operation{opcode::special, data_chunk(20, locktime)});
+    tx.outputs.push_back(output);
+    return tx;
+}
+
+data_chunk payload_of(const data_chunk& message)
+{
+    return data_chunk(message.begin() + header_size, message.end());
+}
+
+void test_siphash()
+{
+    // The SipHash-2-4 reference vector for bytes 0 to 31, which we keep
+    // reversed
+    hash_digest hash;
+    for (size_t i = 0; i < hash.size(); ++i)
+        hash[i] = hash.size() - 1 - i;
+    BITCOIN_ASSERT(siphash_digest(0x0706050403020100, 0x0f0e0d0c0b0a0908,
+        hash) == 0x7127512f72f27cce);
+}
+
+int main()
+{
+    test_siphash();
+    original_dialect dialect;
+    message::block block;
+    block.version = 1;
+    block.prev_block = hash_digest{0x01};
+    block.timestamp = 1231006505;
+    block.bits = 0x1d00ffff;
+    block.nonce = 2083236893;
+    for (uint32_t locktime = 0; locktime < 4; ++locktime)
+        block.transactions.push_back(create_transaction(locktime));
+    block.merkle_root = generate_merkle_root(block.transactions);
+
+    const message::compact_block compact = make_compact_block(block, 42);
+    BITCOIN_ASSERT(compact.prefilled.size() == 1);
+    BITCOIN_ASSERT(compact.prefilled[0].index == 0);
+    BITCOIN_ASSERT(compact.short_ids.size() == 3);
+    const short_id_key key(block, 42);
+    BITCOIN_ASSERT(compact.short_ids[1] ==
+        key(hash_transaction(block.transactions[2])));
+    BITCOIN_ASSERT(compact.short_ids[1] >> 48 == 0);
+    BITCOIN_ASSERT(short_id_key(block, 43)(hash_transaction(
+        block.transactions[2])) != compact.short_ids[1]);
+
+    // Through the wire and back
+    bool ec;
+    const data_chunk compact_payload = payload_of(dialect.to_network(compact));
+    const message::compact_block parsed = dialect.compact_block_from_network(
+        message::header(), compact_payload, ec);
+    BITCOIN_ASSERT(!ec);
+    BITCOIN_ASSERT(hash_block_header(parsed.header) ==
+        hash_block_header(block));
+    BITCOIN_ASSERT(parsed.nonce == 42 && parsed.short_ids == compact.short_ids);
+    BITCOIN_ASSERT(parsed.prefilled.size() == 1 &&
+        parsed.prefilled[0].index == 0);
+    BITCOIN_ASSERT(hash_transaction(parsed.prefilled[0].tx) ==
+        hash_transaction(block.transactions[0]));
+    data_chunk truncated(compact_payload.begin(), compact_payload.end() - 1);
+    dialect.compact_block_from_network(message::header(), truncated, ec);
+    BITCOIN_ASSERT(ec);
+
+    // The pool has one of the three, so the other two are asked for
+    partial_block partial(parsed);
+    BITCOIN_ASSERT(partial.valid() && !partial.complete());
+    BITCOIN_ASSERT(partial.hash() == hash_block_header(block));
+    partial.offer(hash_transaction(block.transactions[2]),
+        block.transactions[2]);
+    const message::transaction stranger = create_transaction(9);
+    partial.offer(hash_transaction(stranger), stranger);
+    BITCOIN_ASSERT(partial.missing() == (std::vector<uint32_t>{1, 3}));
+    BITCOIN_ASSERT(!partial.fill(message::transaction_list(1)));
+
+    const message::get_block_transactions request{partial.hash(),
+        partial.missing()};
+    const message::get_block_transactions parsed_request =
+        dialect.get_block_transactions_from_network(message::header(),
+            payload_of(dialect.to_network(request)), ec);
+    BITCOIN_ASSERT(!ec && parsed_request.block_hash == request.block_hash);
+    BITCOIN_ASSERT(parsed_request.indexes == request.indexes);
+
+    message::block_transactions response;
+    response.block_hash = request.block_hash;
+    response.transactions.push_back(block.transactions[1]);
+    response.transactions.push_back(block.transactions[3]);
+    const message::block_transactions parsed_response =
+        dialect.block_transactions_from_network(message::header(),
+            payload_of(dialect.to_network(response)), ec);
+    BITCOIN_ASSERT(!ec && parsed_response.transactions.size() == 2);
+
+    BITCOIN_ASSERT(partial.fill(parsed_response.transactions));
+    BITCOIN_ASSERT(partial.complete() && partial.missing().empty());
+    const message::block rebuilt = partial.block();
+    BITCOIN_ASSERT(rebuilt.transactions.size() == 4);
+    BITCOIN_ASSERT(generate_merkle_root(rebuilt.transactions) ==
+        block.merkle_root);
+
+    // Two transactions with the same short id mean the whole block
+    message::compact_block duplicated = compact;
+    duplicated.short_ids[2] = duplicated.short_ids[0];
+    BITCOIN_ASSERT(!partial_block(duplicated).valid());
+    message::compact_block misplaced = compact;
+    misplaced.prefilled[0].index = 4;
+    BITCOIN_ASSERT(!partial_block(misplaced).valid());
+
+    const message::send_compact send_compact{false, compact_block_version};
+    const message::send_compact parsed_send =
+        dialect.send_compact_from_network(message::header(),
+            payload_of(dialect.to_network(send_compact)), ec);
+    BITCOIN_ASSERT(!ec && !parsed_send.announce &&
+        parsed_send.version == compact_block_version);
+    std::cout << "compact block: OK" << std::endl;
+    return 0;
+}
+
@@ -0,0 +1,140 @@
+#include <bitcoin/compressed_output.hpp>
+#include <bitcoin/constants.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/hex.hpp>
+#include <iostream>
+
+using namespace libbitcoin;
+
+data_chunk from_hex(const std::string& hex)
+{
+    data_chunk data;
+    BITCOIN_ASSERT(decode_hex(hex, data));
+    return data;
+}
+
+void test_varint()
+{
+    const uint64_t values[] = {0, 0x7f, 0x80, 0x1234, 0xffff, 0x123456,
+        0xffffffffffffffff};
+    const char* encoded[] = {"00", "7f", "8000", "a334", "82fe7f", "c7e756",
+        "80fefefefefefefefe7f"};
+    for (size_t i = 0; i < 7; ++i)
+    {
+        data_chunk out;
+        write_varint(out, values[i]);
+        BITCOIN_ASSERT(encode_hex(out) == encoded[i]);
+        size_t position = 0;
+        uint64_t value;
+        BITCOIN_ASSERT(read_varint(data_view(out), position, value));
+        BITCOIN_ASSERT(value == values[i] && position == out.size());
+    }
+    size_t position = 0;
+    uint64_t value;
+    BITCOIN_ASSERT(!read_varint(data_view(from_hex("80")), position, value));
+    position = 0;
+    BITCOIN_ASSERT(!read_varint(data_view(from_hex("ffffffffffffffffff7f")),
+        position, value));
+}
+
+void test_amounts()
+{
+    const uint64_t coin = 100000000;
+    BITCOIN_ASSERT(compress_amount(0) == 0);
+    BITCOIN_ASSERT(compress_amount(1) == 1);
+    BITCOIN_ASSERT(compress_amount(coin / 100) == 7);
+    BITCOIN_ASSERT(compress_amount(coin) == 9);
+    BITCOIN_ASSERT(compress_amount(50 * coin) == 0x32);
+    BITCOIN_ASSERT(compress_amount(21000000 * coin) == 0x1406f40);
+    for (uint64_t value: {uint64_t(0), uint64_t(1), uint64_t(12345678),
+            50 * coin, 21000000 * coin, uint64_t(999999999999)})
+        BITCOIN_ASSERT(decompress_amount(compress_amount(value)) == value);
+}
+
+// Compresses to size bytes and comes back as it was
+void check_script(const std::string& hex, size_t size)
+{
+    const unspent_output output{50, from_hex(hex)};
+    const data_chunk compressed = compress_output(output);
+    BITCOIN_ASSERT(compressed.size() == size);
+    unspent_output restored;
+    BITCOIN_ASSERT(decompress_output(compressed, restored));
+    BITCOIN_ASSERT(restored.value == 50);
+    BITCOIN_ASSERT(restored.raw_script == output.raw_script);
+    const data_chunk truncated(compressed.begin(), compressed.end() - 1);
+    BITCOIN_ASSERT(!decompress_output(truncated, restored));
+}
+
+void test_scripts()
+{
+    const std::string pubkey_hash = "76a91400112233445566778899aabbccddeeff"
+        "0011223388ac";
+    check_script(pubkey_hash, 1 + 1 + 20);
+    // The generator point, compressed and not
+    const std::string x = "79be667ef9dcbbac55a06295ce870b07029bfcdb2dce28d9"
+        "59f2815b16f81798";
+    const std::string y = "483ada7726a3c4655da4fbfc0e1108a8fd17b448a6855419"
+        "9c47d08ffb10d4b8";
+    check_script("2102" + x + "ac", 1 + 1 + 32);
+    check_script("4104" + x + y + "ac", 1 + 1 + 32);
+    // Not on the curve, so kept whole
+    check_script("4104" + x + x + "ac", 1 + 1 + 67);
+    // Same size as a pubkey hash script but a different push
+    check_script("76a94c14" + pubkey_hash.substr(6, 40) + "88", 1 + 1 + 25);
+    check_script("", 1 + 1);
+}
+
+void test_undo()
+{
+    message::block block;
+    // A coinbase spends nothing, so only the second transaction counts
+    message::transaction coinbase;
+    message::transaction_input coinbase_input;
+    coinbase_input.hash = null_hash;
+    coinbase_input.index = 0xffffffff;
+    coinbase_input.sequence = 0xffffffff;
+    coinbase.inputs.push_back(coinbase_input);
+    block.transactions.push_back(coinbase);
+    message::transaction tx;
+    message::transaction_input input;
+    input.hash = hash_digest{1, 2, 3};
+    input.index = 0;
+    input.sequence = 0xffffffff;
+    tx.inputs.push_back(input);
+    input.index = 5;
+    tx.inputs.push_back(input);
+    block.transactions.push_back(tx);
+
+    utxo_set::undo_list undo;
+    undo.push_back(std::make_pair(output_point{input.hash, 0},
+        unspent_output{5000000000, from_hex("76a91400112233445566778899aabb"
+            "ccddeeff0011223388ac")}));
+    undo.push_back(std::make_pair(output_point{input.hash, 5},
+        unspent_output{1, data_chunk{0x51}}));
+    const data_chunk compressed = compress_undo(undo);
+    utxo_set::undo_list restored;
+    BITCOIN_ASSERT(decompress_undo(block, compressed, restored));
+    BITCOIN_ASSERT(restored.size() == 2);
+    BITCOIN_ASSERT(restored[1].first == undo[1].first);
+    BITCOIN_ASSERT(restored[0].second.value == 5000000000);
+    BITCOIN_ASSERT(restored[0].second.raw_script == undo[0].second.raw_script);
+    BITCOIN_ASSERT(restored[1].second.raw_script == data_chunk{0x51});
+    // One output short, or one too many
+    undo.pop_back();
+    BITCOIN_ASSERT(!decompress_undo(block, compress_undo(undo), restored));
+    data_chunk extra = compressed;
+    extend_data(extra, compress_output(unspent_output{1, data_chunk()}));
+    BITCOIN_ASSERT(!decompress_undo(block, extra, restored));
+}
+
+int main()
+{
+    test_varint();
+    test_amounts();
+    test_scripts();
+    test_undo();
+    std::cout << "compressed output: OK" << std::endl;
+    return 0;
+}
+
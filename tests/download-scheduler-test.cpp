@@ -0,0 +1,125 @@
+#include <bitcoin/download_scheduler.hpp>
+#include <bitcoin/header_sync.hpp>
+#include <bitcoin/block.hpp>
+#include <bitcoin/constants.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace libbitcoin;
+using boost::posix_time::seconds;
+
+hash_digest hash_from_pretty(const std::string& pretty)
+{
+    hash_digest hash;
+    for (size_t i = 0; i < hash.size(); ++i)
+        hash[i] = strtoul(pretty.substr(i * 2, 2).c_str(), nullptr, 16);
+    return hash;
+}
+
+message::block_ptr create_header(const hash_digest& prev_block,
+        const std::string& merkle_root, uint32_t timestamp, uint32_t nonce)
+{
+    std::shared_ptr<message::block> header =
+        std::make_shared<message::block>();
+    header->version = 1;
+    header->prev_block = prev_block;
+    header->merkle_root = hash_from_pretty(merkle_root);
+    header->timestamp = timestamp;
+    header->bits = 0x1d00ffff;
+    header->nonce = nonce;
+    return header;
+}
+
+int main()
+{
+    // The first mainnet blocks after genesis
+    std::vector<message::block_ptr> blocks;
+    blocks.push_back(create_header(hash_from_pretty(
+        "000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f"),
+        "0e3e2357e806b6cdb1f70b54c3a3a17b6714ee1f0e68bebb44a74b1efd512098",
+        1231469665, 2573394689));
+    blocks.push_back(create_header(hash_block_header(*blocks.back()),
+        "9b0fc92260312ce44e74ef369f5c66bbb85848f2eddd5a7a1cde251e54ccfdd5",
+        1231469744, 1639830024));
+    blocks.push_back(create_header(hash_block_header(*blocks.back()),
+        "999e1c837c76a1b7fbb7e57baf87b309960f5ffefbf2a9b95dd890602272f644",
+        1231470173, 1844305925));
+    blocks.push_back(create_header(hash_block_header(*blocks.back()),
+        "df2b060fa2e5e9c8ed5eaf6a45c13753ec8c63282b2688322eba40cd98ea067a",
+        1231470988, 2850094635));
+
+    header_sync_ptr headers = std::make_shared<header_sync>(
+        blocks.front()->prev_block);
+    message::headers packet;
+    for (message::block_ptr block: blocks)
+        packet.block_headers.push_back(*block);
+    BITCOIN_ASSERT(headers->accept(packet));
+    BITCOIN_ASSERT(headers->top_depth() == 4);
+
+    download_scheduler scheduler(headers);
+    scheduler.add_peer(1);
+    scheduler.add_peer(2);
+    scheduler.set_score(2, 500);
+    const ptime start(boost::gregorian::date(2012, 1, 1));
+    download_scheduler::request_list requests;
+    scheduler.schedule(start, requests);
+    // The better scored peer has room for everything
+    BITCOIN_ASSERT(requests.size() == 1);
+    BITCOIN_ASSERT(requests[0].first == 2);
+    BITCOIN_ASSERT(requests[0].second.size() == 4);
+
+    // Held back until the lower one arrives
+    std::vector<message::block_ptr> ready;
+    scheduler.received(2, start + seconds(1), blocks[1], ready);
+    BITCOIN_ASSERT(ready.empty());
+    scheduler.received(2, start + seconds(2), blocks[0], ready);
+    BITCOIN_ASSERT(ready.size() == 2);
+    BITCOIN_ASSERT(ready[0] == blocks[0] && ready[1] == blocks[1]);
+    BITCOIN_ASSERT(scheduler.release_depth() == 3);
+    download_scheduler::peer_statistics stats;
+    BITCOIN_ASSERT(scheduler.statistics(2, stats));
+    BITCOIN_ASSERT(stats.received == 2 && stats.in_flight == 2);
+    BITCOIN_ASSERT(stats.latency > 0);
+
+    // Sitting on the rest loses them to the other peer
+    ready.clear();
+    BITCOIN_ASSERT(scheduler.check_stalls(start + seconds(10), ready) == 0);
+    BITCOIN_ASSERT(scheduler.check_stalls(start + seconds(60), ready) == 1);
+    BITCOIN_ASSERT(scheduler.statistics(2, stats));
+    BITCOIN_ASSERT(stats.stalls == 1 && stats.in_flight == 0);
+    BITCOIN_ASSERT(stats.score == 0);
+    BITCOIN_ASSERT(stats.capacity == download_scheduler::min_in_flight);
+    requests.clear();
+    scheduler.schedule(start + seconds(60), requests);
+    BITCOIN_ASSERT(requests.size() == 1);
+    BITCOIN_ASSERT(requests[0].first == 1);
+    BITCOIN_ASSERT(requests[0].second.size() == 2);
+
+    // Dropping a peer does the same
+    scheduler.remove_peer(1);
+    BITCOIN_ASSERT(!scheduler.statistics(1, stats));
+    requests.clear();
+    scheduler.schedule(start + seconds(61), requests);
+    BITCOIN_ASSERT(requests.size() == 1);
+    BITCOIN_ASSERT(requests[0].first == 2);
+    BITCOIN_ASSERT(requests[0].second.size() == 2);
+    scheduler.received(2, start + seconds(62), blocks[3], ready);
+    BITCOIN_ASSERT(ready.empty());
+    scheduler.received(2, start + seconds(63), blocks[2], ready);
+    BITCOIN_ASSERT(ready.size() == 2 && ready[0] == blocks[2]);
+    BITCOIN_ASSERT(headers->outstanding() == 0);
+
+    // Nothing to do with the header chain, so straight through
+    ready.clear();
+    message::block_ptr stranger = create_header(null_hash,
+        "df2b060fa2e5e9c8ed5eaf6a45c13753ec8c63282b2688322eba40cd98ea067a",
+        1231470988, 1);
+    scheduler.received(2, start + seconds(64), stranger, ready);
+    BITCOIN_ASSERT(ready.size() == 1 && ready[0] == stranger);
+    std::cout << "download scheduler: OK" << std::endl;
+    return 0;
+}
+
@@ -112,6 +112,22 @@ int main()
     }
 
     log_info() << "checksig returns: " << (key.verify(tx_hash, signature) ? "true" : "false");
+    BITCOIN_ASSERT(key.verify(tx_hash, signature));
+
+    // Batch API caches the parsed key across checks with the same pubkey
+    libbitcoin::public_key_cache cache(8);
+    hash_digest wrong_hash = tx_hash;
+    wrong_hash[0] ^= 0x01;
+    data_chunk bad_pubkey{0x04, 0x01, 0x02};
+    libbitcoin::signature_check_list checks{
+        {tx_hash, signature, pubkey},
+        {wrong_hash, signature, pubkey},
+        {tx_hash, signature, bad_pubkey},
+        {tx_hash, signature, pubkey}};
+    std::vector<bool> results = libbitcoin::verify_signatures(checks, cache);
+    BITCOIN_ASSERT((results == std::vector<bool>{true, false, false, true}));
+    BITCOIN_ASSERT(cache.get(pubkey) == cache.get(pubkey));
+    BITCOIN_ASSERT(!cache.get(bad_pubkey));
     return 0;
 }
 
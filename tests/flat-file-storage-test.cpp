@@ -0,0 +1,190 @@
+#include <bitcoin/storage/flat_file_storage.hpp>
+#include <bitcoin/block.hpp>
+#include <bitcoin/constants.hpp>
+#include <bitcoin/dialect.hpp>
+#include <bitcoin/lazy_block.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/verify.hpp>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <string>
+
+#include "block_fixtures.hpp"
+
+using namespace libbitcoin;
+
+std::error_code store_block(flat_file_storage_ptr store,
+    message::block_ptr block)
+{
+    std::promise<std::error_code> stored;
+    store->store(block,
+        [&](const std::error_code& ec)
+        {
+            stored.set_value(ec);
+        });
+    return stored.get_future().get();
+}
+
+data_chunk fetch_raw(flat_file_storage_ptr store, const hash_digest& hash)
+{
+    std::promise<data_chunk> fetched;
+    store->fetch_raw_block_by_hash(hash,
+        [&](const std::error_code& ec, data_chunk_ptr raw)
+        {
+            fetched.set_value(ec ? data_chunk() : *raw);
+        });
+    return fetched.get_future().get();
+}
+
+hash_digest fetch_hash_by_depth(flat_file_storage_ptr store, size_t depth)
+{
+    std::promise<hash_digest> fetched;
+    store->fetch_block_by_depth(depth,
+        [&](const std::error_code& ec, const message::block& block)
+        {
+            fetched.set_value(ec ? null_hash : hash_block_header(block));
+        });
+    return fetched.get_future().get();
+}
+
+int main()
+{
+    char directory_template[] = "/tmp/flat-file-storage-XXXXXX";
+    const std::string directory = mkdtemp(directory_template);
+    const hash_digest genesis_hash = hash_from_pretty(
+        "000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f");
+    message::block_ptr block_1 =
+        std::make_shared<message::block>(create_block_1());
+    BITCOIN_ASSERT(block_1->merkle_root == hash_from_pretty(
+        "0e3e2357e806b6cdb1f70b54c3a3a17b6714ee1f0e68bebb44a74b1efd512098"));
+    const hash_digest block_1_hash = hash_block_header(*block_1);
+    BITCOIN_ASSERT(block_1_hash == hash_from_pretty(
+        "00000000839a8e6886ab5951d76f411475428afc90947ee320161bbf18eb6048"));
+    const hash_digest coinbase_hash =
+        hash_transaction(block_1->transactions[0]);
+
+    // A new directory starts out with the genesis block connected
+    flat_file_storage_ptr store =
+        std::make_shared<flat_file_storage>(directory, 2);
+    BITCOIN_ASSERT(store->connected_size() == 1);
+    data_chunk genesis_payload = fetch_raw(store, genesis_hash);
+    lazy_block genesis(std::move(genesis_payload));
+    BITCOIN_ASSERT(genesis.valid() && genesis.hash() == genesis_hash);
+    BITCOIN_ASSERT(fetch_hash_by_depth(store, 0) == genesis_hash);
+
+    // Refused before anything is written when the merkle root is wrong
+    message::block bad_block = *block_1;
+    bad_block.transactions[0].outputs[0].value = 1;
+    bad_block.transactions[0].cached_hash.reset();
+    BITCOIN_ASSERT(store_block(store,
+        std::make_shared<const message::block>(bad_block)) ==
+            error::invalid_block);
+    BITCOIN_ASSERT(!block_1->context_checked.passed());
+    BITCOIN_ASSERT(!store_block(store, block_1));
+    // Remembered, so verification after the store skips those checks
+    BITCOIN_ASSERT(block_1->context_checked.passed());
+    BITCOIN_ASSERT(store_block(store, block_1) ==
+        error::object_already_exists);
+    BITCOIN_ASSERT(store->connected_size() == 2);
+    BITCOIN_ASSERT(fetch_hash_by_depth(store, 1) == block_1_hash);
+    BITCOIN_ASSERT(fetch_hash_by_depth(store, 2) == null_hash);
+    BITCOIN_ASSERT(fetch_raw(store, block_1_hash) ==
+        original_dialect().to_network(*block_1, false));
+    std::promise<uint64_t> output_value;
+    store->fetch_output_by_hash(coinbase_hash, 0,
+        [&](const std::error_code& ec,
+            const message::transaction_output& output)
+        {
+            output_value.set_value(ec ? 0 : output.value);
+        });
+    BITCOIN_ASSERT(output_value.get_future().get() == 5000000000);
+    std::promise<std::error_code> transaction_stored;
+    store->store(message::transaction(),
+        [&](const std::error_code& ec)
+        {
+            transaction_stored.set_value(ec);
+        });
+    BITCOIN_ASSERT(transaction_stored.get_future().get() ==
+        error::unsupported_operation);
+    store.reset();
+
+    // A partial record left by a crash is cut off on reopening
+    std::ofstream(directory + "/blocks.index",
+        std::ios::binary | std::ios::app) << "partial";
+    store = std::make_shared<flat_file_storage>(directory, 2);
+    BITCOIN_ASSERT(store->connected_size() == 2);
+    BITCOIN_ASSERT(fetch_hash_by_depth(store, 1) == block_1_hash);
+    BITCOIN_ASSERT(fetch_raw(store, block_1_hash) ==
+        original_dialect().to_network(*block_1, false));
+    std::promise<bool> exists;
+    store->block_exists_by_hash(block_1_hash,
+        [&](const std::error_code&, bool block_exists)
+        {
+            exists.set_value(block_exists);
+        });
+    BITCOIN_ASSERT(exists.get_future().get());
+
+    // Batched lookups answer per item in request order
+    std::promise<std::vector<size_t>> batch;
+    store->fetch_outputs(
+        storage::output_point_list{
+            output_point{null_hash, 0}, output_point{coinbase_hash, 0}},
+        [&](const std::error_code& ec,
+            const message::transaction_output_list& outputs,
+            const std::vector<size_t>& missing)
+        {
+            BITCOIN_ASSERT(!ec && outputs.size() == 2);
+            BITCOIN_ASSERT(outputs[1].value == 5000000000);
+            batch.set_value(missing);
+        });
+    BITCOIN_ASSERT(batch.get_future().get() == std::vector<size_t>{0});
+    std::promise<std::vector<bool>> batch_exists;
+    store->blocks_exist(
+        storage::hash_list{block_1_hash, null_hash, genesis_hash},
+        [&](const std::error_code&, const std::vector<bool>& blocks_exist)
+        {
+            batch_exists.set_value(blocks_exist);
+        });
+    BITCOIN_ASSERT(batch_exists.get_future().get() ==
+        (std::vector<bool>{true, false, true}));
+    // Cut short at the top of the chain
+    std::promise<std::vector<hash_digest>> range;
+    store->fetch_blocks_by_depth_range(0, 5,
+        [&](const std::error_code& ec, const message::block_list& blocks)
+        {
+            std::vector<hash_digest> hashes;
+            for (const message::block& block: blocks)
+                hashes.push_back(hash_block_header(block));
+            range.set_value(ec ? std::vector<hash_digest>() : hashes);
+        });
+    BITCOIN_ASSERT(range.get_future().get() ==
+        (std::vector<hash_digest>{genesis_hash, block_1_hash}));
+    store.reset();
+    system(("rm -r " + directory).c_str());
+
+    // Stored but never connected when a checkpoint names another block
+    char checkpoint_template[] = "/tmp/flat-file-storage-XXXXXX";
+    const std::string checkpoint_directory = mkdtemp(checkpoint_template);
+    store = std::make_shared<flat_file_storage>(checkpoint_directory, 2);
+    chain_checkpoints checkpoints = mainnet_checkpoints();
+    checkpoints.checkpoints.insert(checkpoints.checkpoints.begin(),
+        checkpoint{1, genesis_hash});
+    store->set_checkpoints(checkpoints);
+    BITCOIN_ASSERT(!store_block(store, block_1));
+    BITCOIN_ASSERT(store->connected_size() == 1);
+    BITCOIN_ASSERT(check_checkpoints(checkpoints.checkpoints, 1,
+        genesis_hash));
+    BITCOIN_ASSERT(!check_checkpoints(checkpoints.checkpoints, 11111,
+        genesis_hash));
+    BITCOIN_ASSERT(check_checkpoints(checkpoints.checkpoints, 2,
+        block_1_hash));
+    store.reset();
+
+    system(("rm -r " + checkpoint_directory).c_str());
+    std::cout << "flat file storage: OK" << std::endl;
+    return 0;
+}
+
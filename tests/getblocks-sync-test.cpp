@@ -0,0 +1,69 @@
+#include <bitcoin/getblocks_sync.hpp>
+#include <bitcoin/constants.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <iostream>
+
+using namespace libbitcoin;
+using boost::posix_time::seconds;
+
+hash_digest create_hash(size_t number)
+{
+    hash_digest hash = null_hash;
+    hash[30] = number >> 8;
+    hash[31] = number & 0xff;
+    return hash;
+}
+
+message::inv_list create_invs(size_t begin, size_t end)
+{
+    message::inv_list invs;
+    for (size_t number = begin; number < end; ++number)
+        invs.push_back(message::inv_vect{
+            message::inv_type::block, create_hash(number)});
+    return invs;
+}
+
+int main()
+{
+    const ptime start(boost::gregorian::date(2012, 1, 1));
+    getblocks_sync sync(4, seconds(30));
+    const message::block_locator stored{create_hash(1000)};
+
+    BITCOIN_ASSERT(sync.start_request(start));
+    // Only one in flight until it is answered
+    BITCOIN_ASSERT(!sync.start_request(start));
+    message::getblocks request = sync.make_request(stored);
+    BITCOIN_ASSERT(request.locator_start_hashes == stored);
+    BITCOIN_ASSERT(request.hash_stop == null_hash);
+
+    // A full reply holds the next one back until it runs low
+    sync.announced(create_invs(0, 10), start);
+    BITCOIN_ASSERT(sync.outstanding() == 10);
+    BITCOIN_ASSERT(!sync.start_request(start));
+    for (size_t number = 0; number < 6; ++number)
+        sync.received(create_hash(number));
+    BITCOIN_ASSERT(!sync.start_request(start));
+    sync.received(create_hash(6));
+    BITCOIN_ASSERT(sync.outstanding() == 3);
+    BITCOIN_ASSERT(sync.start_request(start));
+    // Starts past the blocks still on their way
+    request = sync.make_request(stored);
+    BITCOIN_ASSERT(request.locator_start_hashes.size() == 2);
+    BITCOIN_ASSERT(request.locator_start_hashes[0] == create_hash(9));
+    BITCOIN_ASSERT(request.locator_start_hashes[1] == create_hash(1000));
+
+    // Hearing again of what is outstanding is no answer
+    sync.announced(create_invs(8, 10), start);
+    BITCOIN_ASSERT(!sync.start_request(start));
+    sync.request_failed();
+    BITCOIN_ASSERT(sync.start_request(start));
+
+    // Unanswered requests and blocks that never come are let go
+    BITCOIN_ASSERT(!sync.start_request(start + seconds(10)));
+    BITCOIN_ASSERT(sync.start_request(start + seconds(31)));
+    BITCOIN_ASSERT(sync.outstanding() == 0);
+    BITCOIN_ASSERT(sync.make_request(stored).locator_start_hashes == stored);
+    std::cout << "getblocks sync: OK" << std::endl;
+    return 0;
+}
+
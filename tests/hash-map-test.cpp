@@ -0,0 +1,98 @@
+#include <bitcoin/constants.hpp>
+#include <bitcoin/util/hash_map.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <iostream>
+
+using namespace libbitcoin;
+
+hash_digest numbered_hash(uint32_t number)
+{
+    // Leading zeros and varying tail, like block hashes in display order
+    hash_digest hash = null_hash;
+    for (size_t i = 0; i < 4; ++i)
+        hash[31 - i] = number >> (8 * i);
+    return hash;
+}
+
+void test_hasher()
+{
+    hash_digest_hasher hasher;
+    BITCOIN_ASSERT(hasher(numbered_hash(1)) != hasher(numbered_hash(2)));
+    // Every instance shares the process salt
+    BITCOIN_ASSERT(hash_digest_hasher()(numbered_hash(7)) ==
+        hasher(numbered_hash(7)));
+    BITCOIN_ASSERT(hash_digest_equal(numbered_hash(3), numbered_hash(3)));
+    hash_digest first_byte = numbered_hash(3);
+    first_byte[0] = 1;
+    BITCOIN_ASSERT(!hash_digest_equal(first_byte, numbered_hash(3)));
+    BITCOIN_ASSERT(!hash_digest_equal(numbered_hash(3), numbered_hash(4)));
+}
+
+void test_map()
+{
+    hash_flat_map<uint32_t> map;
+    BITCOIN_ASSERT(map.empty() && map.find(numbered_hash(1)) == nullptr);
+    const uint32_t count = 1000;
+    for (uint32_t number = 0; number < count; ++number)
+        BITCOIN_ASSERT(map.insert(numbered_hash(number), number).second);
+    BITCOIN_ASSERT(map.size() == count);
+    BITCOIN_ASSERT(map.size() * 8 <= map.capacity() * 7);
+    // Inserting again keeps the old value
+    auto existing = map.insert(numbered_hash(5), 99);
+    BITCOIN_ASSERT(!existing.second && *existing.first == 5);
+    map[numbered_hash(6)] = 66;
+    BITCOIN_ASSERT(*map.find(numbered_hash(6)) == 66);
+    BITCOIN_ASSERT(map[numbered_hash(count)] == 0);
+    BITCOIN_ASSERT(map.size() == count + 1);
+
+    // Erase every other key, then check the rest are still reachable
+    // after the backward shifts
+    for (uint32_t number = 0; number < count; number += 2)
+        BITCOIN_ASSERT(map.erase(numbered_hash(number)));
+    BITCOIN_ASSERT(!map.erase(numbered_hash(0)));
+    for (uint32_t number = 0; number < count; ++number)
+    {
+        const uint32_t* value = map.find(numbered_hash(number));
+        if (number % 2 == 0)
+            BITCOIN_ASSERT(value == nullptr);
+        else if (number != 5 && number != 6)
+            BITCOIN_ASSERT(value != nullptr && *value == number);
+    }
+    size_t visited = 0;
+    map.for_each([&visited](const hash_digest&, uint32_t) { ++visited; });
+    BITCOIN_ASSERT(visited == map.size());
+
+    const hash_digest& near = map.key_near(12345);
+    BITCOIN_ASSERT(map.contains(near));
+    map.clear();
+    BITCOIN_ASSERT(map.empty() && !map.contains(numbered_hash(1)));
+
+    hash_flat_map<uint32_t> reserved(100);
+    const size_t capacity = reserved.capacity();
+    for (uint32_t number = 0; number < 100; ++number)
+        reserved.insert(numbered_hash(number), number);
+    BITCOIN_ASSERT(reserved.capacity() == capacity);
+}
+
+void test_set()
+{
+    hash_flat_set set;
+    BITCOIN_ASSERT(set.insert(numbered_hash(1)));
+    BITCOIN_ASSERT(!set.insert(numbered_hash(1)));
+    BITCOIN_ASSERT(set.insert(numbered_hash(2)));
+    BITCOIN_ASSERT(set.contains(numbered_hash(2)) && set.size() == 2);
+    // Draining through key_near empties it
+    while (!set.empty())
+        BITCOIN_ASSERT(set.erase(hash_digest(set.key_near(7))));
+    BITCOIN_ASSERT(!set.contains(numbered_hash(1)));
+}
+
+int main()
+{
+    test_hasher();
+    test_map();
+    test_set();
+    std::cout << "hash map: OK" << std::endl;
+    return 0;
+}
+
@@ -0,0 +1,101 @@
+#include <bitcoin/header_index.hpp>
+#include <bitcoin/constants.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+using namespace libbitcoin;
+
+hash_digest create_hash(size_t number, uint8_t branch=0)
+{
+    hash_digest hash = null_hash;
+    hash[0] = number & 0xff;
+    hash[1] = number >> 8;
+    hash[2] = branch;
+    hash[31] = 1;
+    return hash;
+}
+
+int main()
+{
+    const uint32_t genesis_bits = 0x1d00ffff;
+    BITCOIN_ASSERT(block_difficulty(genesis_bits) == 1.0);
+    BITCOIN_ASSERT(block_difficulty(0x1b0404cb) > 16000.0);
+
+    header_index headers;
+    BITCOIN_ASSERT(headers.locator().empty());
+    BITCOIN_ASSERT(headers.add(create_hash(0), null_hash, genesis_bits, true));
+    // Children arriving before their parent wait to be linked
+    BITCOIN_ASSERT(headers.add(create_hash(2), create_hash(1), genesis_bits));
+    header_index::entry waiting;
+    BITCOIN_ASSERT(headers.find(create_hash(2), waiting));
+    BITCOIN_ASSERT(!waiting.linked);
+    BITCOIN_ASSERT(headers.top_depth() == 0);
+    for (size_t i = 1; i < 100; ++i)
+        if (i != 2)
+            BITCOIN_ASSERT(headers.add(
+                create_hash(i), create_hash(i - 1), genesis_bits));
+    BITCOIN_ASSERT(!headers.add(create_hash(5), create_hash(4), genesis_bits));
+    BITCOIN_ASSERT(headers.size() == 100);
+    BITCOIN_ASSERT(headers.top_depth() == 99);
+    BITCOIN_ASSERT(headers.find(create_hash(2), waiting));
+    BITCOIN_ASSERT(waiting.linked && waiting.depth == 2);
+    BITCOIN_ASSERT(headers.contains(create_hash(50)));
+    BITCOIN_ASSERT(!headers.contains(create_hash(500)));
+
+    message::block_locator locator = headers.locator();
+    BITCOIN_ASSERT(locator.front() == create_hash(99));
+    BITCOIN_ASSERT(locator[9] == create_hash(90));
+    BITCOIN_ASSERT(locator[10] == create_hash(88));
+    BITCOIN_ASSERT(locator.back() == create_hash(0));
+
+    // A harder branch from depth 97 takes over the main chain
+    BITCOIN_ASSERT(headers.add(create_hash(98, 1), create_hash(97),
+        0x1c00ffff));
+    BITCOIN_ASSERT(headers.top_depth() == 98);
+    hash_digest hash;
+    BITCOIN_ASSERT(headers.main_chain_hash(98, hash));
+    BITCOIN_ASSERT(hash == create_hash(98, 1));
+    BITCOIN_ASSERT(headers.main_chain_hash(97, hash));
+    BITCOIN_ASSERT(hash == create_hash(97));
+    BITCOIN_ASSERT(!headers.main_chain_hash(99, hash));
+    size_t depth = 0;
+    BITCOIN_ASSERT(headers.is_main_chain(create_hash(98, 1), depth));
+    BITCOIN_ASSERT(depth == 98);
+    // Left behind on the weaker branch
+    BITCOIN_ASSERT(!headers.is_main_chain(create_hash(99), depth));
+    BITCOIN_ASSERT(!headers.is_main_chain(create_hash(500), depth));
+
+    // Snapshot round trip restores the same chain
+    const std::string path = "header-index-test.snapshot";
+    BITCOIN_ASSERT(headers.add(create_hash(200), create_hash(199),
+        genesis_bits));
+    BITCOIN_ASSERT(headers.save(path, 1234));
+    header_index restored;
+    uint64_t last_block_id = 0;
+    BITCOIN_ASSERT(restored.load(path, last_block_id));
+    BITCOIN_ASSERT(last_block_id == 1234);
+    BITCOIN_ASSERT(restored.size() == headers.size());
+    BITCOIN_ASSERT(restored.top_depth() == 98);
+    BITCOIN_ASSERT(restored.locator() == headers.locator());
+    BITCOIN_ASSERT(restored.find(create_hash(200), waiting));
+    BITCOIN_ASSERT(!waiting.linked);
+    BITCOIN_ASSERT(restored.find(create_hash(0), waiting));
+    BITCOIN_ASSERT(waiting.verified && waiting.bits == genesis_bits);
+
+    // A flipped byte fails the checksum and leaves the index empty
+    {
+        std::fstream file(path.c_str(),
+            std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(100);
+        file.put(0x55);
+    }
+    BITCOIN_ASSERT(!restored.load(path, last_block_id));
+    BITCOIN_ASSERT(restored.size() == 0);
+    std::remove(path.c_str());
+    BITCOIN_ASSERT(!restored.load(path, last_block_id));
+    std::cout << "header index tests passed.\n";
+    return 0;
+}
+
@@ -0,0 +1,91 @@
+#include <bitcoin/header_sync.hpp>
+#include <bitcoin/block.hpp>
+#include <bitcoin/constants.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace libbitcoin;
+
+hash_digest hash_from_pretty(const std::string& pretty)
+{
+    hash_digest hash;
+    for (size_t i = 0; i < hash.size(); ++i)
+        hash[i] = strtoul(pretty.substr(i * 2, 2).c_str(), nullptr, 16);
+    return hash;
+}
+
+message::block create_header(const hash_digest& prev_block,
+        const std::string& merkle_root, uint32_t timestamp, uint32_t nonce)
+{
+    message::block header;
+    header.version = 1;
+    header.prev_block = prev_block;
+    header.merkle_root = hash_from_pretty(merkle_root);
+    header.timestamp = timestamp;
+    header.bits = 0x1d00ffff;
+    header.nonce = nonce;
+    return header;
+}
+
+int main()
+{
+    const hash_digest genesis_hash = hash_from_pretty(
+        "000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f");
+    message::block block1 = create_header(genesis_hash,
+        "0e3e2357e806b6cdb1f70b54c3a3a17b6714ee1f0e68bebb44a74b1efd512098",
+        1231469665, 2573394689);
+    const hash_digest block1_hash = hash_block_header(block1);
+    BITCOIN_ASSERT(block1_hash == hash_from_pretty(
+        "00000000839a8e6886ab5951d76f411475428afc90947ee320161bbf18eb6048"));
+    message::block block2 = create_header(block1_hash,
+        "9b0fc92260312ce44e74ef369f5c66bbb85848f2eddd5a7a1cde251e54ccfdd5",
+        1231469744, 1639830024);
+    const hash_digest block2_hash = hash_block_header(block2);
+
+    header_sync sync(genesis_hash);
+    BITCOIN_ASSERT(sync.top_depth() == 0);
+    BITCOIN_ASSERT(sync.locator().front() == genesis_hash);
+    BITCOIN_ASSERT(sync.next_requests(10).empty());
+
+    // Bad proof of work rejects the whole batch
+    message::headers packet;
+    message::block forged = create_header(block1_hash,
+        "9b0fc92260312ce44e74ef369f5c66bbb85848f2eddd5a7a1cde251e54ccfdd5",
+        1231469744, 1639830025);
+    packet.block_headers.push_back(block1);
+    packet.block_headers.push_back(forged);
+    BITCOIN_ASSERT(!sync.accept(packet));
+
+    packet.block_headers.back() = block2;
+    BITCOIN_ASSERT(sync.accept(packet));
+    BITCOIN_ASSERT(sync.top_depth() == 2);
+    BITCOIN_ASSERT(sync.locator().front() == block2_hash);
+
+    message::inv_list invs = sync.next_requests(1);
+    BITCOIN_ASSERT(invs.size() == 1);
+    BITCOIN_ASSERT(invs[0].type == message::inv_type::block);
+    BITCOIN_ASSERT(invs[0].hash == block1_hash);
+    invs = sync.next_requests(10);
+    BITCOIN_ASSERT(invs.size() == 1 && invs[0].hash == block2_hash);
+    BITCOIN_ASSERT(sync.next_requests(10).empty());
+    BITCOIN_ASSERT(sync.outstanding() == 2);
+
+    // Unanswered requests get handed out again
+    sync.request_failed(invs);
+    BITCOIN_ASSERT(!sync.have_body(block2_hash));
+    invs = sync.next_requests(10);
+    BITCOIN_ASSERT(invs.size() == 1 && invs[0].hash == block2_hash);
+    sync.received(block1_hash);
+    BITCOIN_ASSERT(sync.have_body(block1_hash));
+    BITCOIN_ASSERT(!sync.have_body(block2_hash));
+    sync.received(block2_hash);
+    BITCOIN_ASSERT(sync.outstanding() == 0);
+    // Only outstanding requests can fail
+    sync.request_failed(invs);
+    BITCOIN_ASSERT(sync.next_requests(10).empty());
+    std::cout << "header sync: OK" << std::endl;
+    return 0;
+}
+
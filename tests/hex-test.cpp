@@ -0,0 +1,38 @@
+#include <bitcoin/util/hex.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <iostream>
+
+using namespace libbitcoin;
+
+int main()
+{
+    const data_chunk data{0x00, 0x01, 0x7f, 0x80, 0xab, 0xff};
+    BITCOIN_ASSERT(encode_hex(data) == "00017f80abff");
+    BITCOIN_ASSERT(encode_hex(data_chunk()).empty());
+    data_chunk decoded;
+    BITCOIN_ASSERT(decode_hex("00017F80abFF", decoded) && decoded == data);
+    BITCOIN_ASSERT(decode_hex("", decoded) && decoded.empty());
+    BITCOIN_ASSERT(!decode_hex("abc", decoded));
+    BITCOIN_ASSERT(!decode_hex("0g", decoded));
+    BITCOIN_ASSERT(!decode_hex("-1", decoded));
+    BITCOIN_ASSERT(!decode_hex(std::string("\xff" "0"), decoded));
+
+    const std::string genesis =
+        "000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f";
+    hash_digest hash;
+    BITCOIN_ASSERT(decode_hex(genesis, hash));
+    BITCOIN_ASSERT(hash[5] == 0x19 && hash[31] == 0x6f);
+    BITCOIN_ASSERT(encode_hex(hash) == genesis);
+    BITCOIN_ASSERT(!decode_hex(genesis.substr(2), hash));
+
+    // Into a caller's buffer, without a terminator
+    char buffer[5] = {'x', 'x', 'x', 'x', 'x'};
+    encode_hex(data.data() + 4, 2, buffer);
+    BITCOIN_ASSERT(std::string(buffer, 5) == "abffx");
+
+    BITCOIN_ASSERT(hexlify(data) == "00 01 7f 80 ab ff");
+    BITCOIN_ASSERT(hexlify(data_chunk()).empty());
+    std::cout << "hex: OK" << std::endl;
+    return 0;
+}
+
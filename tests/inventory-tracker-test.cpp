@@ -0,0 +1,55 @@
+#include <bitcoin/inventory_tracker.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <iostream>
+
+using namespace libbitcoin;
+using boost::posix_time::seconds;
+
+message::inv_vect block_inv(uint8_t id)
+{
+    return message::inv_vect{message::inv_type::block, hash_digest{{id}}};
+}
+
+int main()
+{
+    const ptime start(boost::gregorian::date(2012, 1, 1));
+    inventory_tracker tracker(seconds(30), 4);
+
+    // Announced by two peers, asked of the first only
+    BITCOIN_ASSERT(tracker.request(block_inv(1), 1, start));
+    BITCOIN_ASSERT(!tracker.request(block_inv(1), 2, start));
+    BITCOIN_ASSERT(tracker.request(block_inv(2), 2, start));
+    BITCOIN_ASSERT(tracker.in_flight() == 2);
+
+    // Arrived, so never asked again
+    tracker.settle(block_inv(1).hash);
+    BITCOIN_ASSERT(tracker.known(block_inv(1).hash));
+    BITCOIN_ASSERT(!tracker.request(block_inv(1), 3, start + seconds(60)));
+    BITCOIN_ASSERT(tracker.in_flight() == 1);
+
+    // Timed out requests go back to be asked of anyone
+    message::inv_list expired;
+    tracker.expire(start + seconds(10), expired);
+    BITCOIN_ASSERT(expired.empty());
+    tracker.expire(start + seconds(31), expired);
+    BITCOIN_ASSERT(expired.size() == 1);
+    BITCOIN_ASSERT(expired[0].hash == block_inv(2).hash);
+    BITCOIN_ASSERT(expired[0].type == message::inv_type::block);
+    BITCOIN_ASSERT(tracker.request(block_inv(2), 3, start + seconds(31)));
+
+    // A departed peer's requests are free again straight away
+    tracker.remove_peer(3);
+    BITCOIN_ASSERT(tracker.in_flight() == 0);
+    BITCOIN_ASSERT(tracker.request(block_inv(2), 1, start + seconds(32)));
+
+    // Two generations of two: the oldest is forgotten first
+    for (uint8_t id = 2; id <= 5; ++id)
+        tracker.settle(block_inv(id).hash);
+    BITCOIN_ASSERT(!tracker.known(block_inv(1).hash));
+    BITCOIN_ASSERT(tracker.known(block_inv(4).hash));
+    BITCOIN_ASSERT(tracker.known(block_inv(5).hash));
+
+    std::cout << "inventory tracker: OK" << std::endl;
+    return 0;
+}
+
@@ -0,0 +1,92 @@
+#include <bitcoin/lazy_block.hpp>
+#include <bitcoin/block.hpp>
+#include <bitcoin/dialect.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <iostream>
+
+using namespace libbitcoin;
+
+message::transaction create_transaction(uint32_t locktime)
+{
+    message::transaction tx;
+    tx.version = 1;
+    tx.locktime = locktime;
+    for (uint32_t index = 0; index < 2; ++index)
+    {
+        message::transaction_input input;
+        input.hash = hash_digest{0x39, 0x7f, 0x72, 0x33};
+        input.index = index;
+        input.input_script.push_operation(
+            operation{opcode::special, data_chunk(71, 0x30 + index)});
+        input.sequence = 4294967295;
+        tx.inputs.push_back(input);
+    }
+    for (uint64_t value = 1; value <= 3; ++value)
+    {
+        message::transaction_output output;
+        output.value = value;
+        output.output_script.push_operation(
+            operation{opcode::dup, data_chunk()});
+        output.output_script.push_operation(
+            operation{opcode::special, data_chunk(20, value)});
+        tx.outputs.push_back(output);
+    }
+    return tx;
+}
+
+int main()
+{
+    original_dialect dialect;
+    message::block block;
+    block.version = 1;
+    block.prev_block = hash_digest{0x01};
+    block.timestamp = 1231006505;
+    block.bits = 0x1d00ffff;
+    block.nonce = 2083236893;
+    block.transactions.push_back(create_transaction(0));
+    block.transactions.push_back(create_transaction(7));
+    block.merkle_root = generate_merkle_root(block.transactions);
+    const data_chunk raw_block = dialect.to_network(block, false);
+
+    data_chunk payload = raw_block;
+    lazy_block lazy(std::move(payload));
+    BITCOIN_ASSERT(lazy.valid());
+    BITCOIN_ASSERT(lazy.hash() == hash_block_header(block));
+    BITCOIN_ASSERT(lazy.header().transactions.empty());
+    BITCOIN_ASSERT(lazy.transactions_size() == 2);
+    const data_view second = lazy.transaction_data(1);
+    BITCOIN_ASSERT(second.end() == lazy.raw().data() + raw_block.size());
+    BITCOIN_ASSERT(second.size() == transaction_size(block.transactions[1]));
+    BITCOIN_ASSERT(hash_transaction(lazy.transaction(1)) ==
+        hash_transaction(block.transactions[1]));
+
+    // Single scripts come out without the rest of the transaction
+    const script input = lazy.input_script(1, 1);
+    BITCOIN_ASSERT(input.operations().size() == 1);
+    BITCOIN_ASSERT(input.operations()[0].data == data_chunk(71, 0x31));
+    const script output = lazy.output_script(0, 2);
+    BITCOIN_ASSERT(output.operations().size() == 2);
+    BITCOIN_ASSERT(output.operations()[1].data == data_chunk(20, 3));
+    BITCOIN_ASSERT(lazy.output_script(0, 3).operations().empty());
+
+    const message::block decoded = lazy.decode();
+    BITCOIN_ASSERT(decoded.transactions.size() == 2);
+    BITCOIN_ASSERT(decoded.raw_payload == lazy.shared_raw());
+    BITCOIN_ASSERT(generate_merkle_root(decoded.transactions) ==
+        block.merkle_root);
+
+    // Payloads that do not frame exactly are refused
+    data_chunk truncated(raw_block.begin(), raw_block.end() - 1);
+    BITCOIN_ASSERT(!lazy_block(std::move(truncated)).valid());
+    data_chunk trailing = raw_block;
+    trailing.push_back(0);
+    BITCOIN_ASSERT(!lazy_block(std::move(trailing)).valid());
+    data_chunk overcounted = raw_block;
+    overcounted[80] = 3;
+    BITCOIN_ASSERT(!lazy_block(std::move(overcounted)).valid());
+    BITCOIN_ASSERT(!lazy_block(data_chunk(79)).valid());
+    std::cout << "lazy block: OK" << std::endl;
+    return 0;
+}
+
@@ -0,0 +1,76 @@
+#include <bitcoin/util/logger.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace libbitcoin;
+
+// Counts how often it is formatted
+struct counted
+{
+};
+size_t formatted = 0;
+std::ostream& operator<<(std::ostream& stream, const counted&)
+{
+    ++formatted;
+    return stream << "counted";
+}
+
+std::mutex mutex;
+std::vector<std::pair<logger_level, std::string>> written;
+
+void capture(logger_level level, const std::string& text)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    written.push_back(std::make_pair(level, text));
+}
+
+int main()
+{
+    set_log_sink(capture);
+    set_log_level(logger_level::info);
+
+    // Levels that are off never format anything
+    log_debug() << counted();
+    BITCOIN_ASSERT(formatted == 0);
+    BITCOIN_ASSERT(!log_enabled(logger_level::debug));
+    BITCOIN_ASSERT(log_enabled(logger_level::warning));
+    log_info() << "first " << counted();
+    log_error() << "second " << 2;
+    BITCOIN_ASSERT(formatted == 1);
+    flush_log();
+    BITCOIN_ASSERT(written.size() == 2);
+    BITCOIN_ASSERT(written[0].first == logger_level::info);
+    BITCOIN_ASSERT(written[0].second == "first counted");
+    BITCOIN_ASSERT(written[1].second == "second 2");
+
+    // Each thread's messages arrive whole and in its own order
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 4; ++i)
+        threads.push_back(std::thread(
+            [i]
+            {
+                for (size_t j = 0; j < 1000; ++j)
+                    log_warning() << i << ' ' << j;
+            }));
+    for (std::thread& thread: threads)
+        thread.join();
+    flush_log();
+    BITCOIN_ASSERT(written.size() == 4002);
+    std::vector<size_t> next(4, 0);
+    for (size_t k = 2; k < written.size(); ++k)
+    {
+        size_t i = written[k].second[0] - '0';
+        std::ostringstream expected;
+        expected << i << ' ' << next[i]++;
+        BITCOIN_ASSERT(written[k].second == expected.str());
+    }
+
+    set_log_sink(nullptr);
+    set_log_level(logger_level::debug);
+    std::cout << "logger: OK" << std::endl;
+    return 0;
+}
+
@@ -0,0 +1,87 @@
+#include <bitcoin/util/memory_budget.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/metrics.hpp>
+#include <iostream>
+
+using namespace libbitcoin;
+
+struct fake_cache
+{
+    size_t bytes, limit;
+};
+
+void add_cache(memory_budget& memory, const std::string& name, double weight,
+    fake_cache& cache)
+{
+    memory.add(name, weight,
+        [&cache]()
+        {
+            return cache.bytes;
+        },
+        [&cache](size_t limit)
+        {
+            cache.limit = limit;
+        });
+}
+
+int64_t gauge_value(const std::string& name)
+{
+    return shared_metrics().get_gauge(name).value();
+}
+
+int main()
+{
+    memory_budget memory(400);
+    size_t headers = 100;
+    memory.add_fixed("headers",
+        [&headers]()
+        {
+            return headers;
+        });
+    fake_cache small{10, 0}, large{300, 0};
+    add_cache(memory, "small", 1, small);
+    add_cache(memory, "large", 3, large);
+
+    // 300 left after the headers, so shares of 75 and 225. The small
+    // one keeps a quarter of its share and lends the rest.
+    memory.rebalance();
+    BITCOIN_ASSERT(small.limit == 18 && memory.limit("small") == 18);
+    BITCOIN_ASSERT(large.limit == 225 + 57);
+    BITCOIN_ASSERT(memory.limit("headers") == 0);
+    BITCOIN_ASSERT(gauge_value("memory.large.bytes") == 300);
+    BITCOIN_ASSERT(gauge_value("memory.large.limit") == 282);
+    BITCOIN_ASSERT(gauge_value("memory.headers.bytes") == 100);
+    BITCOIN_ASSERT(gauge_value("memory.total.bytes") == 410);
+    BITCOIN_ASSERT(gauge_value("memory.total.limit") == 400);
+
+    // Growing takes it a quarter further each round, up to its share
+    small.bytes = 40;
+    memory.rebalance();
+    BITCOIN_ASSERT(small.limit == 50 && large.limit == 225 + 25);
+    small.bytes = 70;
+    memory.rebalance();
+    BITCOIN_ASSERT(small.limit == 75 && large.limit == 225);
+
+    // Nobody at their limit, so everyone gets their share
+    large.bytes = 0;
+    small.bytes = 0;
+    memory.rebalance();
+    BITCOIN_ASSERT(small.limit == 75 && large.limit == 225);
+
+    // Fixed usage past the total leaves nothing to share
+    headers = 500;
+    memory.rebalance();
+    BITCOIN_ASSERT(small.limit == 0 && large.limit == 0);
+
+    headers = 0;
+    memory.set_total(1000);
+    BITCOIN_ASSERT(memory.total() == 1000);
+    memory.remove("small");
+    large.bytes = 900;
+    memory.rebalance();
+    BITCOIN_ASSERT(large.limit == 1000);
+    BITCOIN_ASSERT(memory.limit("small") == 0);
+    std::cout << "memory budget: OK" << std::endl;
+    return 0;
+}
+
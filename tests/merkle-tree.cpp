@@ -0,0 +1,78 @@
+#include <bitcoin/constants.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/serializer.hpp>
+#include <bitcoin/util/sha256.hpp>
+#include <bitcoin/util/thread_pool.hpp>
+#include <atomic>
+#include <iostream>
+
+using namespace libbitcoin;
+
+// Straightforward tree duplicating the odd hash out at every level
+hash_digest reference_merkle_root(std::vector<hash_digest> level)
+{
+    while (level.size() > 1)
+    {
+        if (level.size() % 2 != 0)
+            level.push_back(level.back());
+        std::vector<hash_digest> next;
+        for (size_t i = 0; i < level.size(); i += 2)
+        {
+            serializer concat;
+            concat.write_hash(level[i]);
+            concat.write_hash(level[i + 1]);
+            next.push_back(generate_sha256_hash(concat.get_data()));
+        }
+        level = next;
+    }
+    return level[0];
+}
+
+message::transaction_list create_transactions(size_t count)
+{
+    message::transaction_list transactions;
+    for (size_t i = 0; i < count; ++i)
+    {
+        message::transaction tx;
+        tx.version = 1;
+        tx.locktime = i;
+        transactions.push_back(tx);
+    }
+    return transactions;
+}
+
+void test_parallel_for(thread_pool& pool)
+{
+    std::vector<std::atomic<int>> visits(10007);
+    for (std::atomic<int>& visit: visits)
+        visit = 0;
+    pool.parallel_for(visits.size(), 100,
+        [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                ++visits[i];
+        });
+    for (std::atomic<int>& visit: visits)
+        BITCOIN_ASSERT(visit == 1);
+}
+
+int main()
+{
+    thread_pool pool(3);
+    test_parallel_for(pool);
+    for (size_t count: {1, 2, 3, 5, 6, 7, 11, 1500, 3001})
+    {
+        message::transaction_list transactions = create_transactions(count);
+        std::vector<hash_digest> tx_hashes;
+        for (const message::transaction& tx: transactions)
+            tx_hashes.push_back(hash_transaction(tx));
+        hash_digest expected = reference_merkle_root(tx_hashes);
+        BITCOIN_ASSERT(generate_merkle_root(transactions) == expected);
+        BITCOIN_ASSERT(generate_merkle_root(transactions, pool) == expected);
+    }
+    BITCOIN_ASSERT(generate_merkle_root(create_transactions(0)) == null_hash);
+    std::cout << "merkle tree tests passed.\n";
+    return 0;
+}
+
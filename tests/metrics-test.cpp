@@ -0,0 +1,114 @@
+#include <bitcoin/util/metrics.hpp>
+#include <bitcoin/util/metrics_server.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace libbitcoin;
+
+// Within the 1/16 a bucket can be off by
+bool close_to(uint64_t value, uint64_t expected)
+{
+    return value >= expected && value <= expected + expected / 16;
+}
+
+std::string fetch(unsigned short port, const std::string& path)
+{
+    io_service service;
+    tcp::socket socket(service);
+    socket.connect(tcp::endpoint(
+        boost::asio::ip::address_v4::loopback(), port));
+    const std::string request = "GET " + path + " HTTP/1.0\r\n\r\n";
+    boost::asio::write(socket, boost::asio::buffer(request));
+    boost::asio::streambuf response;
+    boost::system::error_code ec;
+    boost::asio::read(socket, response, ec);
+    BITCOIN_ASSERT(ec == boost::asio::error::eof);
+    return std::string(boost::asio::buffers_begin(response.data()),
+        boost::asio::buffers_end(response.data()));
+}
+
+int main()
+{
+    metrics_registry registry;
+    counter& messages = registry.get_counter("test.messages");
+    BITCOIN_ASSERT(&messages == &registry.get_counter("test.messages"));
+    messages.add();
+    messages.add(4);
+    BITCOIN_ASSERT(messages.value() == 5);
+    gauge& queued = registry.get_gauge("test.queued");
+    queued.set(10);
+    queued.add(-3);
+    BITCOIN_ASSERT(queued.value() == 7);
+
+    latency_histogram& latency = registry.get_histogram("test.latency");
+    BITCOIN_ASSERT(latency.percentile(0.5) == 0);
+    for (uint64_t i = 1; i <= 1000; ++i)
+        latency.record(i);
+    BITCOIN_ASSERT(latency.count() == 1000);
+    BITCOIN_ASSERT(latency.sum() == 500500);
+    BITCOIN_ASSERT(latency.max() == 1000);
+    BITCOIN_ASSERT(close_to(latency.percentile(0.5), 500));
+    BITCOIN_ASSERT(close_to(latency.percentile(0.99), 990));
+    BITCOIN_ASSERT(latency.percentile(1) == 1000);
+    // Small values are exact and huge ones still land somewhere
+    latency_histogram exact;
+    exact.record(3);
+    BITCOIN_ASSERT(exact.percentile(0.5) == 3);
+    exact.record(uint64_t(-1));
+    BITCOIN_ASSERT(exact.percentile(1) == uint64_t(-1));
+
+    // Nothing is lost between threads
+    latency_histogram shared;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 4; ++i)
+        threads.push_back(std::thread(
+            [&]
+            {
+                for (uint64_t j = 0; j < 10000; ++j)
+                {
+                    messages.add();
+                    shared.record(j);
+                }
+            }));
+    for (std::thread& thread: threads)
+        thread.join();
+    BITCOIN_ASSERT(messages.value() == 40005);
+    BITCOIN_ASSERT(shared.count() == 40000);
+    BITCOIN_ASSERT(shared.max() == 9999);
+
+    {
+        scoped_timer timer(registry.get_histogram("test.timed"));
+    }
+    BITCOIN_ASSERT(registry.get_histogram("test.timed").count() == 1);
+
+    const std::string text = registry.to_text();
+    BITCOIN_ASSERT(text.find("test.messages 40005\n") != std::string::npos);
+    BITCOIN_ASSERT(text.find("test.queued 7\n") != std::string::npos);
+    BITCOIN_ASSERT(text.find("test.latency.count 1000\n") != std::string::npos);
+    BITCOIN_ASSERT(text.find("test.latency.max_us 1000\n") !=
+        std::string::npos);
+    const std::string json = registry.to_json();
+    BITCOIN_ASSERT(json.find("\"counters\":{\"test.messages\":40005}") !=
+        std::string::npos);
+    BITCOIN_ASSERT(json.find("\"test.latency\":{\"count\":1000,") !=
+        std::string::npos);
+
+    // Served over loopback
+    const unsigned short port = 18334;
+    metrics_server_ptr server = std::make_shared<metrics_server>(registry);
+    BITCOIN_ASSERT(server->start(port));
+    const std::string plain = fetch(port, "/metrics");
+    BITCOIN_ASSERT(plain.find("HTTP/1.0 200 OK\r\n") == 0);
+    BITCOIN_ASSERT(plain.find("text/plain") != std::string::npos);
+    BITCOIN_ASSERT(plain.find("\r\n\r\n" + text) != std::string::npos);
+    const std::string served = fetch(port, "/metrics.json");
+    BITCOIN_ASSERT(served.find("application/json") != std::string::npos);
+    BITCOIN_ASSERT(served.find("\r\n\r\n{\"counters\"") != std::string::npos);
+    server->stop();
+
+    std::cout << "metrics: OK" << std::endl;
+    return 0;
+}
+
@@ -0,0 +1,408 @@
+// Microbenchmarks for the hot paths of block handling. Prints one JSON
+// object per line so runs can be diffed across commits:
+//
+//   make bench OPTFLAGS=-O2     (writes bench.jsonl)
+//
+// Any arguments are files holding raw block payloads, as stored on disk
+// or received in a block message, which are then parsed as well.
+#include <bitcoin/block.hpp>
+#include <bitcoin/constants.hpp>
+#include <bitcoin/dialect.hpp>
+#include <bitcoin/messages.hpp>
+#include <bitcoin/script.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/elliptic_curve_key.hpp>
+#include <bitcoin/util/hex.hpp>
+#include <bitcoin/util/ripemd.hpp>
+#include <bitcoin/util/serializer.hpp>
+#include <bitcoin/util/sha256.hpp>
+#include <bitcoin/util/signature_cache.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <openssl/ecdsa.h>
+#include <openssl/obj_mac.h>
+#include <string>
+#include <vector>
+
+using namespace libbitcoin;
+
+typedef std::chrono::high_resolution_clock bench_clock;
+
+// Each sample runs for at least this long, and the median is reported
+constexpr double min_sample_seconds = 0.05;
+constexpr size_t number_samples = 5;
+
+// Results are folded in here so no benchmarked call can be optimised away
+volatile uint8_t sink = 0;
+
+template <typename Function>
+double time_iterations(Function& run, size_t iterations)
+{
+    const bench_clock::time_point start = bench_clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+        run();
+    return std::chrono::duration_cast<std::chrono::duration<double>>(
+        bench_clock::now() - start).count();
+}
+
+template <typename Function>
+void measure(const std::string& name, size_t bytes_per_op, Function run)
+{
+    size_t iterations = 1;
+    while (time_iterations(run, iterations) < min_sample_seconds)
+        iterations *= 2;
+    std::vector<double> samples;
+    for (size_t i = 0; i < number_samples; ++i)
+        samples.push_back(time_iterations(run, iterations) / iterations);
+    std::sort(samples.begin(), samples.end());
+    const double seconds_per_op = samples[number_samples / 2];
+    std::cout << "{\"benchmark\":\"" << name << "\""
+        << ",\"iterations\":" << iterations
+        << ",\"samples\":" << number_samples
+        << ",\"ns_per_op\":" << seconds_per_op * 1e9
+        << ",\"min_ns_per_op\":" << samples.front() * 1e9;
+    if (bytes_per_op > 0)
+        std::cout << ",\"bytes_per_op\":" << bytes_per_op
+            << ",\"mb_per_s\":" << bytes_per_op / seconds_per_op / 1e6;
+    std::cout << "}" << std::endl;
+}
+
+data_chunk bytes_from_pretty(const std::string& pretty)
+{
+    data_chunk result;
+    for (size_t i = 0; i + 1 < pretty.size(); i += 2)
+        result.push_back(strtoul(pretty.substr(i, 2).c_str(), nullptr, 16));
+    return result;
+}
+
+// The mainnet genesis block payload
+const std::string genesis_pretty =
+    "0100000000000000000000000000000000000000000000000000000000000000"
+    "000000003ba3edfd7a7b12b27ac72c3e67768f617fc81bc3888a51323a9fb8aa"
+    "4b1e5e4a29ab5f49ffff001d1dac2b7c01010000000100000000000000000000"
+    "00000000000000000000000000000000000000000000ffffffff4d04ffff001d"
+    "0104455468652054696d65732030332f4a616e2f32303039204368616e63656c"
+    "6c6f72206f6e206272696e6b206f66207365636f6e64206261696c6f75742066"
+    "6f722062616e6b73ffffffff0100f2052a01000000434104678afdb0fe554827"
+    "1967f1a67130b7105cd6a828e03909a67962e0ea1f61deb649f6bc3f4cef38c4"
+    "f35504e51ec112de5c384df7ba0b8d578a4c702b6bf11d5fac00000000";
+
+data_chunk push_data(const data_chunk& data)
+{
+    BITCOIN_ASSERT(data.size() < 76);
+    data_chunk raw{static_cast<uint8_t>(data.size())};
+    extend_data(raw, data);
+    return raw;
+}
+
+// A freshly generated key signing a one input, one output spend
+class spend_signer
+{
+public:
+    spend_signer()
+      : key_(EC_KEY_new_by_curve_name(NID_secp256k1))
+    {
+        EC_KEY_generate_key(key_);
+        pubkey_.resize(i2o_ECPublicKey(key_, nullptr));
+        uint8_t* out = pubkey_.data();
+        i2o_ECPublicKey(key_, &out);
+    }
+    ~spend_signer()
+    {
+        EC_KEY_free(key_);
+    }
+
+    const data_chunk& pubkey() const
+    {
+        return pubkey_;
+    }
+
+    script pubkey_hash_script() const
+    {
+        const short_hash hash = generate_ripemd_hash(pubkey_);
+        // Sized up front, so appending the hash never reallocates
+        data_chunk raw;
+        raw.reserve(3 + hash.size() + 2);
+        raw.push_back(0x76);
+        raw.push_back(0xa9);
+        raw.push_back(0x14);
+        raw.insert(raw.end(), hash.begin(), hash.end());
+        raw.push_back(0x88);
+        raw.push_back(0xac);
+        return parse_script(raw);
+    }
+
+    message::transaction unsigned_spend(uint32_t locktime) const
+    {
+        message::transaction tx;
+        tx.version = 1;
+        tx.locktime = locktime;
+        message::transaction_input input;
+        input.hash = generate_sha256_hash(data_chunk{'s', 'p', 'e', 'n', 't'});
+        input.index = 0;
+        input.sequence = 0xffffffff;
+        tx.inputs.push_back(input);
+        message::transaction_output output;
+        output.value = 5000000000;
+        output.output_script = pubkey_hash_script();
+        tx.outputs.push_back(output);
+        return tx;
+    }
+
+    // SIGHASH_ALL over tx with script_code standing in for the input
+    data_chunk sign(const message::transaction& tx,
+        const script& script_code) const
+    {
+        message::transaction signed_tx = tx;
+        signed_tx.inputs[0].input_script = script_code;
+        hash_digest hash = hash_transaction(signed_tx, 1);
+        std::reverse(hash.begin(), hash.end());
+        data_chunk signature(ECDSA_size(key_));
+        unsigned int length = 0;
+        ECDSA_sign(0, hash.data(), hash.size(), signature.data(), &length,
+            key_);
+        signature.resize(length);
+        signature.push_back(1);
+        return signature;
+    }
+
+    script input_script(const data_chunk& signature) const
+    {
+        data_chunk raw = push_data(signature);
+        extend_data(raw, push_data(pubkey_));
+        return parse_script(raw);
+    }
+
+private:
+    EC_KEY* key_;
+    data_chunk pubkey_;
+};
+
+void bench_sha256()
+{
+    for (size_t size: {64, 1024, 1024 * 1024})
+    {
+        const data_chunk data(size, 0x5a);
+        std::ostringstream name;
+        name << "sha256." << size;
+        measure(name.str(), size,
+            [&]
+            {
+                sink ^= generate_sha256_hash(data)[0];
+            });
+    }
+}
+
+void bench_merkle(const message::transaction_list& transactions)
+{
+    std::ostringstream name;
+    name << "merkle_root." << transactions.size();
+    measure(name.str(), 0,
+        [&]
+        {
+            sink ^= generate_merkle_root(transactions)[0];
+        });
+}
+
+void bench_hex()
+{
+    const hash_digest hash = generate_sha256_hash(data_chunk{1, 2, 3});
+    measure("hex.encode_hash", hash.size(),
+        [&]
+        {
+            sink ^= encode_hex(hash)[0];
+        });
+    const std::string hex = encode_hex(hash);
+    measure("hex.decode_hash", hash.size(),
+        [&]
+        {
+            hash_digest decoded;
+            sink ^= decode_hex(hex, decoded) ? decoded[0] : 1;
+        });
+}
+
+void bench_serializer()
+{
+    // Shaped like a run of outpoints and amounts
+    constexpr size_t entries = 1000;
+    const hash_digest hash = generate_sha256_hash(data_chunk{1, 2, 3});
+    measure("serializer.round_trip", entries * (32 + 4 + 8 + 1),
+        [&]
+        {
+            serializer serial;
+            for (size_t i = 0; i < entries; ++i)
+            {
+                serial.write_hash(hash);
+                serial.write_4_bytes(i);
+                serial.write_8_bytes(i * 1000);
+                serial.write_var_uint(i % 200);
+            }
+            const data_chunk raw = serial.get_data();
+            deserializer deserial(raw);
+            uint64_t total = 0;
+            for (size_t i = 0; i < entries; ++i)
+            {
+                total += deserial.read_hash()[0];
+                total += deserial.read_4_bytes();
+                total += deserial.read_8_bytes();
+                total += deserial.read_var_uint();
+            }
+            sink ^= static_cast<uint8_t>(total);
+        });
+}
+
+void bench_block_parse(const std::string& name, const data_chunk& payload)
+{
+    original_dialect dialect;
+    message::header header;
+    measure("block_from_network." + name, payload.size(),
+        [&]
+        {
+            bool ec = false;
+            message::block block =
+                dialect.block_from_network(header, payload, ec);
+            sink ^= static_cast<uint8_t>(block.transactions.size());
+        });
+}
+
+data_chunk block_payload(const message::transaction_list& transactions)
+{
+    message::block block;
+    block.version = 1;
+    block.prev_block = null_hash;
+    block.merkle_root = generate_merkle_root(transactions);
+    block.timestamp = 1231006505;
+    block.bits = 0x1d00ffff;
+    block.nonce = 0;
+    block.transactions = transactions;
+    return original_dialect().to_network(block, false);
+}
+
+// Every input's SIGHASH_ALL digest for one wide transaction
+void bench_sighash(const message::transaction_list& transactions,
+    const script& output_script)
+{
+    message::transaction wide = transactions[0];
+    for (size_t i = 1; i < 200; ++i)
+        wide.inputs.push_back(transactions[i].inputs[0]);
+    measure("sighash.all_inputs_200", transaction_size(wide),
+        [&]
+        {
+            const signature_hash_template sighash(wide);
+            for (uint32_t i = 0; i < wide.inputs.size(); ++i)
+                sink ^= sighash.digest(i, output_script, 1)[0];
+        });
+}
+
+void bench_scripts(const spend_signer& signer)
+{
+    const script output_script = signer.pubkey_hash_script();
+    // Two spends alternate through a one entry signature cache, so every
+    // check does the full ECDSA verification
+    shared_signature_cache().set_max_size(1);
+    std::vector<message::transaction> template_spends, interpreted_spends;
+    std::vector<script> joined_scripts;
+    for (uint32_t locktime = 0; locktime < 2; ++locktime)
+    {
+        // The template path signs over the output script
+        message::transaction tx = signer.unsigned_spend(locktime);
+        tx.inputs[0].input_script = signer.input_script(
+            signer.sign(tx, output_script));
+        BITCOIN_ASSERT(verify_input_script(tx.inputs[0].input_script,
+            output_script, tx, 0));
+        template_spends.push_back(tx);
+
+        // The interpreter signs over the joined script less the signature
+        message::transaction interpreted = signer.unsigned_spend(locktime);
+        script script_code;
+        script_code.push_operation(
+            signer.input_script(data_chunk{0}).operations()[1]);
+        script_code.join(output_script);
+        script joined = signer.input_script(
+            signer.sign(interpreted, script_code));
+        joined.join(output_script);
+        BITCOIN_ASSERT(joined.run(interpreted, 0));
+        interpreted_spends.push_back(interpreted);
+        joined_scripts.push_back(joined);
+    }
+    size_t turn = 0;
+    measure("script.verify_p2pkh", 0,
+        [&]
+        {
+            const message::transaction& tx = template_spends[++turn % 2];
+            sink ^= verify_input_script(tx.inputs[0].input_script,
+                output_script, tx, 0);
+        });
+    measure("script.run_p2pkh", 0,
+        [&]
+        {
+            ++turn;
+            sink ^= joined_scripts[turn % 2].run(
+                interpreted_spends[turn % 2], 0);
+        });
+
+    // The bare signature check underneath both
+    elliptic_curve_key key;
+    BITCOIN_ASSERT(key.set_public_key(signer.pubkey()));
+    const message::transaction& tx = template_spends[0];
+    message::transaction signed_tx = tx;
+    signed_tx.inputs[0].input_script = output_script;
+    const hash_digest sighash = hash_transaction(signed_tx, 1);
+    data_chunk signature = tx.inputs[0].input_script.operations()[0].data;
+    signature.pop_back();
+    BITCOIN_ASSERT(key.verify(sighash, signature));
+    measure("elliptic_curve_key.verify", 0,
+        [&]
+        {
+            sink ^= key.verify(sighash, signature);
+        });
+}
+
+int main(int argc, char** argv)
+{
+    spend_signer signer;
+    message::transaction_list transactions;
+    const script output_script = signer.pubkey_hash_script();
+    for (uint32_t i = 0; i < 2000; ++i)
+    {
+        message::transaction tx = signer.unsigned_spend(i);
+        tx.inputs[0].input_script = signer.input_script(
+            signer.sign(tx, output_script));
+        transactions.push_back(tx);
+    }
+
+    bench_sha256();
+    bench_merkle(transactions);
+    bench_serializer();
+    bench_hex();
+
+    const data_chunk genesis = bytes_from_pretty(genesis_pretty);
+    const hash_digest genesis_hash{0, 0, 0, 0, 0, 0x19, 0xd6, 0x68, 0x9c,
+        0x08, 0x5a, 0xe1, 0x65, 0x83, 0x1e, 0x93, 0x4f, 0xf7, 0x63, 0xae,
+        0x46, 0xa2, 0xa6, 0xc1, 0x72, 0xb3, 0xf1, 0xb6, 0x0a, 0x8c, 0xe2,
+        0x6f};
+    bool ec = false;
+    BITCOIN_ASSERT(hash_block_header(original_dialect().block_from_network(
+        message::header(), genesis, ec)) == genesis_hash);
+    bench_block_parse("genesis", genesis);
+    // Sized like a full block of ordinary pay-to-pubkey-hash spends
+    bench_block_parse("p2pkh_2000", block_payload(transactions));
+    for (int i = 1; i < argc; ++i)
+    {
+        std::ifstream file(argv[i], std::ios::binary);
+        const data_chunk payload((std::istreambuf_iterator<char>(file)),
+            std::istreambuf_iterator<char>());
+        std::string name = argv[i];
+        name = name.substr(name.find_last_of('/') + 1);
+        bench_block_parse(name, payload);
+    }
+
+    bench_sighash(transactions, output_script);
+    bench_scripts(signer);
+    return 0;
+}
+
@@ -0,0 +1,46 @@
+#include <bitcoin/network/peer_metrics.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <iostream>
+
+using namespace libbitcoin;
+using boost::posix_time::seconds;
+using boost::posix_time::minutes;
+
+peer_metrics create_metrics(const ptime& connected, uint64_t bytes_received)
+{
+    peer_metrics metrics;
+    metrics.chandle = 0;
+    metrics.connected = connected;
+    metrics.bytes_received = bytes_received;
+    metrics.bytes_sent = 0;
+    metrics.getdata_latency = -1;
+    metrics.getblocks_latency = -1;
+    return metrics;
+}
+
+int main()
+{
+    const ptime start(boost::gregorian::date(2012, 1, 1));
+    const ptime now = start + seconds(100);
+    peer_metrics fresh = create_metrics(now, 0);
+    BITCOIN_ASSERT(peer_score(fresh, now) == 0);
+    BITCOIN_ASSERT(!peer_too_slow(fresh, now));
+
+    peer_metrics fast = create_metrics(start, 100000);
+    fast.getdata_latency = 0.5;
+    peer_metrics slow = create_metrics(start, 100000);
+    slow.getdata_latency = 4;
+    BITCOIN_ASSERT(peer_score(fast, now) == 1000);
+    BITCOIN_ASSERT(peer_score(slow, now) == 250);
+
+    // Answers slower than a minute or a request left hanging
+    slow.getdata_latency = 90;
+    BITCOIN_ASSERT(peer_too_slow(slow, now));
+    fast.oldest_request = now - seconds(30);
+    BITCOIN_ASSERT(!peer_too_slow(fast, now));
+    fast.oldest_request = now - minutes(3);
+    BITCOIN_ASSERT(peer_too_slow(fast, now));
+    std::cout << "peer metrics: OK" << std::endl;
+    return 0;
+}
+
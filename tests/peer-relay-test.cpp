@@ -0,0 +1,115 @@
+#include <bitcoin/peer_relay.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <iostream>
+
+using namespace libbitcoin;
+
+message::inv_vect tx_inv(uint8_t id)
+{
+    return message::inv_vect{message::inv_type::transaction,
+        hash_digest{{id}}};
+}
+
+message::net_addr address(uint8_t id)
+{
+    message::net_addr addr;
+    addr.timestamp = 0;
+    addr.services = 1;
+    addr.ip_addr = message::ip_address{{0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0xff, 0xff, 10, 0, 0, id}};
+    addr.port = 8333;
+    return addr;
+}
+
+size_t batch_size(const peer_relay::inv_batch_list& batches,
+    channel_handle chandle)
+{
+    size_t total = 0;
+    for (const auto& batch: batches)
+        if (batch.first == chandle)
+            total += batch.second.invs.size();
+    return total;
+}
+
+int main()
+{
+    // Recent insertions are always found, and false positives are rare
+    rolling_bloom_filter filter(1000);
+    for (uint32_t i = 0; i < 500; ++i)
+        filter.insert(reinterpret_cast<const uint8_t*>(&i), sizeof(i));
+    size_t false_positives = 0;
+    for (uint32_t i = 0; i < 10000; ++i)
+    {
+        const bool found =
+            filter.contains(reinterpret_cast<const uint8_t*>(&i), sizeof(i));
+        if (i < 500)
+            BITCOIN_ASSERT(found);
+        else if (found)
+            ++false_positives;
+    }
+    BITCOIN_ASSERT(false_positives < 10);
+    // Two generations later the first are gone
+    for (uint32_t i = 500; i < 1500; ++i)
+        filter.insert(reinterpret_cast<const uint8_t*>(&i), sizeof(i));
+    uint32_t oldest = 0, newest = 1499;
+    BITCOIN_ASSERT(!filter.contains(
+        reinterpret_cast<const uint8_t*>(&oldest), sizeof(oldest)));
+    BITCOIN_ASSERT(filter.contains(
+        reinterpret_cast<const uint8_t*>(&newest), sizeof(newest)));
+    filter.clear();
+    BITCOIN_ASSERT(!filter.contains(
+        reinterpret_cast<const uint8_t*>(&newest), sizeof(newest)));
+
+    peer_relay relay;
+    relay.add_peer(1);
+    relay.add_peer(2);
+    relay.add_peer(3);
+
+    // Nothing goes back to the peer it came from, and everything that
+    // piled up leaves in one message per peer
+    relay.mark_known(1, tx_inv(1).hash);
+    relay.announce(tx_inv(1));
+    relay.announce(tx_inv(2));
+    relay.announce(tx_inv(2));
+    peer_relay::inv_batch_list invs;
+    peer_relay::addr_batch_list addrs;
+    relay.flush(invs, addrs);
+    BITCOIN_ASSERT(invs.size() == 3 && addrs.empty());
+    BITCOIN_ASSERT(batch_size(invs, 1) == 1);
+    BITCOIN_ASSERT(batch_size(invs, 2) == 2);
+    BITCOIN_ASSERT(batch_size(invs, 3) == 2);
+    BITCOIN_ASSERT(relay.knows(3, tx_inv(2).hash));
+
+    // Announced already, so never again
+    invs.clear();
+    relay.announce(tx_inv(2));
+    relay.flush(invs, addrs);
+    BITCOIN_ASSERT(invs.empty());
+
+    // Addresses reach a couple of peers that lack them
+    relay.add_peer(4);
+    relay.mark_known(4, address(1));
+    relay.announce(address(1));
+    relay.flush(invs, addrs);
+    BITCOIN_ASSERT(addrs.size() == 2);
+    for (const auto& batch: addrs)
+    {
+        BITCOIN_ASSERT(batch.first != 4);
+        BITCOIN_ASSERT(batch.second.addr_list.size() == 1);
+        BITCOIN_ASSERT(relay.knows(batch.first, address(1)));
+    }
+    BITCOIN_ASSERT(!relay.knows(1, address(2)));
+
+    // Departed peers are forgotten
+    relay.remove_peer(2);
+    BITCOIN_ASSERT(!relay.has_peer(2) && relay.peer_count() == 3);
+    BITCOIN_ASSERT(!relay.knows(2, tx_inv(2).hash));
+    invs.clear();
+    relay.announce(tx_inv(3));
+    relay.flush(invs, addrs);
+    BITCOIN_ASSERT(invs.size() == 3 && batch_size(invs, 2) == 0);
+
+    std::cout << "peer relay: OK" << std::endl;
+    return 0;
+}
+
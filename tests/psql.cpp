@@ -88,7 +88,7 @@ void create_fake_stuff(psql_ptr psql)
     blk.bits = 0x1b0404cb;
     blk.nonce = 2;
     blk.transactions.push_back(tx);
-    psql->store(blk, null);
+    psql->store(std::make_shared<block>(blk), null);
 }
 
 void recv_block(std::error_code ec, libbitcoin::message::block block, psql_ptr psql, size_t block_depth)
@@ -0,0 +1,176 @@
+#include <bitcoin/script_check.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/thread_pool.hpp>
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+using namespace libbitcoin;
+
+// Empty scripts pass. An input that pushes data against an empty output
+// leaves junk on the stack and fails.
+message::transaction create_transaction(size_t number_inputs,
+    size_t failing_input)
+{
+    message::transaction tx;
+    tx.version = 1;
+    tx.locktime = 0;
+    for (size_t i = 0; i < number_inputs; ++i)
+    {
+        message::transaction_input input;
+        input.index = 0;
+        input.sequence = 0;
+        if (i == failing_input)
+            input.input_script.push_operation(
+                operation{opcode::special, data_chunk{0x01}});
+        tx.inputs.push_back(input);
+    }
+    return tx;
+}
+
+script_check_list create_checks(const message::transaction& tx)
+{
+    script_check_list checks;
+    for (uint32_t i = 0; i < tx.inputs.size(); ++i)
+        checks.push_back(script_check{&tx, i, script(), nullptr});
+    return checks;
+}
+
+// Block 170, transaction 1, spending the block 9 coinbase
+message::transaction create_block_170_transaction(script& spent_script)
+{
+    message::transaction tx;
+    tx.version = 1;
+    tx.locktime = 0;
+    message::transaction_input input;
+    input.hash = hash_digest{
+        0x04, 0x37, 0xcd, 0x7f, 0x85, 0x25, 0xce, 0xed, 0x23, 0x24, 0x35,
+        0x9c, 0x2d, 0x0b, 0xa2, 0x60, 0x06, 0xd9, 0x2d, 0x85, 0x6a, 0x9c,
+        0x20, 0xfa, 0x02, 0x41, 0x10, 0x6e, 0xe5, 0xa5, 0x97, 0xc9};
+    input.index = 0;
+    input.input_script = parse_script(data_chunk{0x47,
+        0x30, 0x44, 0x02, 0x20, 0x4e, 0x45, 0xe1, 0x69, 0x32, 0xb8, 0xaf,
+        0x51, 0x49, 0x61, 0xa1, 0xd3, 0xa1, 0xa2, 0x5f, 0xdf, 0x3f, 0x4f,
+        0x77, 0x32, 0xe9, 0xd6, 0x24, 0xc6, 0xc6, 0x15, 0x48, 0xab, 0x5f,
+        0xb8, 0xcd, 0x41, 0x02, 0x20, 0x18, 0x15, 0x22, 0xec, 0x8e, 0xca,
+        0x07, 0xde, 0x48, 0x60, 0xa4, 0xac, 0xdd, 0x12, 0x90, 0x9d, 0x83,
+        0x1c, 0xc5, 0x6c, 0xbb, 0xac, 0x46, 0x22, 0x08, 0x22, 0x21, 0xa8,
+        0x76, 0x8d, 0x1d, 0x09, 0x01});
+    input.sequence = 0xffffffff;
+    tx.inputs.push_back(input);
+    message::transaction_output output;
+    output.value = 1000000000;
+    output.output_script = parse_script(data_chunk{
+        0x41, 0x04, 0xae, 0x1a, 0x62, 0xfe, 0x09, 0xc5, 0xf5, 0x1b, 0x13,
+        0x90, 0x5f, 0x07, 0xf0, 0x6b, 0x99, 0xa2, 0xf7, 0x15, 0x9b, 0x22,
+        0x25, 0xf3, 0x74, 0xcd, 0x37, 0x8d, 0x71, 0x30, 0x2f, 0xa2, 0x84,
+        0x14, 0xe7, 0xaa, 0xb3, 0x73, 0x97, 0xf5, 0x54, 0xa7, 0xdf, 0x5f,
+        0x14, 0x2c, 0x21, 0xc1, 0xb7, 0x30, 0x3b, 0x8a, 0x06, 0x26, 0xf1,
+        0xba, 0xde, 0xd5, 0xc7, 0x2a, 0x70, 0x4f, 0x7e, 0x6c, 0xd8, 0x4c,
+        0xac});
+    tx.outputs.push_back(output);
+    output.value = 4000000000;
+    spent_script = parse_script(data_chunk{
+        0x41, 0x04, 0x11, 0xdb, 0x93, 0xe1, 0xdc, 0xdb, 0x8a, 0x01, 0x6b,
+        0x49, 0x84, 0x0f, 0x8c, 0x53, 0xbc, 0x1e, 0xb6, 0x8a, 0x38, 0x2e,
+        0x97, 0xb1, 0x48, 0x2e, 0xca, 0xd7, 0xb1, 0x48, 0xa6, 0x90, 0x9a,
+        0x5c, 0xb2, 0xe0, 0xea, 0xdd, 0xfb, 0x84, 0xcc, 0xf9, 0x74, 0x44,
+        0x64, 0xf8, 0x2e, 0x16, 0x0b, 0xfa, 0x9b, 0x8b, 0x64, 0xf9, 0xd4,
+        0xc0, 0x3f, 0x99, 0x9b, 0x86, 0x43, 0xf6, 0x56, 0xb4, 0x12, 0xa3,
+        0xac});
+    output.output_script = spent_script;
+    tx.outputs.push_back(output);
+    return tx;
+}
+
+void test_pubkey_fast_path()
+{
+    script spent_script;
+    message::transaction tx = create_block_170_transaction(spent_script);
+    BITCOIN_ASSERT(spent_script.type() == transaction_type::pubkey);
+    const script& input_script = tx.inputs[0].input_script;
+    BITCOIN_ASSERT(verify_input_script(input_script, spent_script, tx, 0));
+    // The general interpreter agrees with the fast path
+    script combined = input_script;
+    combined.join(spent_script);
+    BITCOIN_ASSERT(combined.run(tx, 0));
+    // Evaluating on an explicit context leaves the signature check result
+    script_context context;
+    BITCOIN_ASSERT(input_script.evaluate(context, tx, 0));
+    BITCOIN_ASSERT(context.size() == 1);
+    BITCOIN_ASSERT(spent_script.evaluate(context, tx, 0));
+    BITCOIN_ASSERT(context.empty());
+
+    message::transaction tampered_tx = tx;
+    tampered_tx.locktime = 1;
+    BITCOIN_ASSERT(!verify_input_script(
+        input_script, spent_script, tampered_tx, 0));
+}
+
+// Digests from one template match hashing a blanked copy per input
+void test_sighash_template()
+{
+    script spent_script;
+    message::transaction tx = create_block_170_transaction(spent_script);
+    for (size_t i = 0; i < 3; ++i)
+    {
+        message::transaction_input input = tx.inputs[0];
+        input.index = i + 1;
+        tx.inputs.push_back(input);
+    }
+    signature_hash_template sighash(tx);
+    BITCOIN_ASSERT(sighash.inputs_size() == tx.inputs.size());
+    for (uint32_t i = 0; i < tx.inputs.size(); ++i)
+    {
+        message::transaction blanked = tx;
+        for (message::transaction_input& input: blanked.inputs)
+            input.input_script = script();
+        blanked.inputs[i].input_script = spent_script;
+        BITCOIN_ASSERT(sighash.digest(i, spent_script, 1) ==
+            hash_transaction(blanked, 1));
+    }
+
+    // Signed checks that share it still pass and fail as before
+    message::transaction signed_tx =
+        create_block_170_transaction(spent_script);
+    signature_hash_template_ptr shared =
+        std::make_shared<signature_hash_template>(signed_tx);
+    BITCOIN_ASSERT(run_script_check(
+        script_check{&signed_tx, 0, spent_script, shared}));
+    script bad_output = spent_script;
+    bad_output.push_operation(operation{opcode::dup, data_chunk()});
+    BITCOIN_ASSERT(!run_script_check(
+        script_check{&signed_tx, 0, bad_output, shared}));
+}
+
+int main()
+{
+    test_pubkey_fast_path();
+    test_sighash_template();
+    thread_pool_ptr pool(new thread_pool(3));
+    script_check_queue queue(pool, 4);
+
+    message::transaction valid_tx = create_transaction(101, 101);
+    BITCOIN_ASSERT(queue.run(create_checks(valid_tx)));
+    BITCOIN_ASSERT(queue.run(script_check_list()));
+
+    message::transaction invalid_tx = create_transaction(101, 77);
+    BITCOIN_ASSERT(!queue.run(create_checks(invalid_tx)));
+
+    // Async completion fires once per run
+    std::atomic<int> completions(0), successes(0);
+    for (size_t i = 0; i < 10; ++i)
+        queue.async_run(create_checks(i % 2 ? valid_tx : invalid_tx),
+            [&](bool success)
+            {
+                if (success)
+                    ++successes;
+                ++completions;
+            });
+    while (completions < 10)
+        std::this_thread::yield();
+    BITCOIN_ASSERT(successes == 5);
+    std::cout << "script check tests passed.\n";
+    return 0;
+}
+
@@ -0,0 +1,275 @@
+#include <bitcoin/util/serializer.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/block.hpp>
+#include <bitcoin/dialect.hpp>
+#include <bitcoin/transaction.hpp>
+#include <iostream>
+
+using namespace libbitcoin;
+
+void test_integers()
+{
+    serializer ss;
+    ss.write_byte(0xab);
+    ss.write_2_bytes(0x0102);
+    ss.write_4_bytes(0x01020304);
+    ss.write_8_bytes(0x0102030405060708);
+    data_chunk expected{0xab, 0x02, 0x01, 0x04, 0x03, 0x02, 0x01,
+        0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01};
+    BITCOIN_ASSERT(ss.get_data() == expected);
+
+    deserializer deserial(expected);
+    BITCOIN_ASSERT(deserial.read_byte() == 0xab);
+    BITCOIN_ASSERT(deserial.read_2_bytes() == 0x0102);
+    BITCOIN_ASSERT(deserial.read_4_bytes() == 0x01020304);
+    BITCOIN_ASSERT(deserial.read_8_bytes() == 0x0102030405060708);
+}
+
+static_assert(byte_swap(uint32_t(0x01020304)) == 0x04030201,
+    "byte swaps are usable at compile time");
+
+void test_byte_order()
+{
+    byte raw[8];
+    to_little_endian(raw, uint32_t(0x01020304));
+    BITCOIN_ASSERT(raw[0] == 0x04 && raw[3] == 0x01);
+    BITCOIN_ASSERT(from_little_endian<uint32_t>(raw) == 0x01020304);
+    BITCOIN_ASSERT(from_big_endian<uint32_t>(raw) == 0x04030201);
+    to_big_endian(raw, uint64_t(0x0102030405060708));
+    BITCOIN_ASSERT(raw[0] == 0x01 && raw[7] == 0x08);
+    BITCOIN_ASSERT(from_big_endian<uint64_t>(raw) == 0x0102030405060708);
+
+    const data_chunk chunk{0x00, 0xf2, 0x05, 0x2a, 0x01, 0x00, 0x00, 0x00};
+    BITCOIN_ASSERT(cast_chunk<uint64_t>(chunk, true) == 5000000000);
+    BITCOIN_ASSERT(cast_chunk<uint16_t>(chunk) == 0x00f2);
+    BITCOIN_ASSERT(uncast_type<uint64_t>(5000000000) == chunk);
+
+    // Ports go out in network byte order
+    message::net_addr addr;
+    addr.services = 1;
+    addr.ip_addr.fill(0);
+    addr.port = 8333;
+    serializer ss;
+    ss.write_net_addr(addr);
+    const data_chunk raw_addr = ss.get_data();
+    BITCOIN_ASSERT(raw_addr.size() == 26);
+    BITCOIN_ASSERT(raw_addr[24] == 0x20 && raw_addr[25] == 0x8d);
+    deserializer deserial(raw_addr);
+    BITCOIN_ASSERT(deserial.read_net_addr().port == 8333);
+}
+
+void test_var_uint()
+{
+    for (uint64_t value: {0ull, 0xfcull, 0xfdull, 0xffffull, 0x10000ull,
+            0xffffffffull, 0x100000000ull})
+    {
+        serializer ss;
+        ss.write_var_uint(value);
+        BITCOIN_ASSERT(ss.size() == variable_uint_size(value));
+        data_chunk raw = ss.get_data();
+        deserializer deserial(raw);
+        BITCOIN_ASSERT(deserial.read_var_uint() == value);
+    }
+}
+
+void test_buffer_handover()
+{
+    data_chunk buffer{1, 2, 3};
+    buffer.reserve(64);
+    const byte* original_storage = buffer.data();
+    serializer ss(std::move(buffer));
+    ss.reserve(8);
+    ss.write_4_bytes(0x07060504);
+    data_chunk released = ss.release_data();
+    // Same allocation came back out with our bytes appended
+    BITCOIN_ASSERT(released.data() == original_storage);
+    BITCOIN_ASSERT((released == data_chunk{1, 2, 3, 4, 5, 6, 7}));
+    BITCOIN_ASSERT(ss.size() == 0);
+}
+
+void test_views()
+{
+    data_chunk stream{'v', 'e', 'r', 's', 'i', 'o', 'n', 0, 0, 0, 0, 0,
+        0x03, 0x02, 0xaa, 0xbb};
+    deserializer deserial(stream);
+    BITCOIN_ASSERT(deserial.read_fixed_len_str(12) == "version");
+    uint64_t script_length = deserial.read_var_uint();
+    data_view view = deserial.read_view(script_length);
+    // Borrowed straight from the stream
+    BITCOIN_ASSERT(view.begin() == stream.data() + 13);
+    BITCOIN_ASSERT(view.size() == 3);
+    script scr = parse_script(view);
+    BITCOIN_ASSERT(scr.operations().size() == 1);
+    BITCOIN_ASSERT((scr.operations()[0].data == data_chunk{0xaa, 0xbb}));
+    BITCOIN_ASSERT(save_script(scr) == data_chunk(view.begin(), view.end()));
+
+    // Truncated push gives back an empty script
+    data_chunk truncated{0x05, 0x01, 0x02};
+    BITCOIN_ASSERT(parse_script(truncated).operations().empty());
+
+    // Pushdata opcodes carry their length ahead of the data
+    data_chunk pushdata{0x4c, 0x02, 0xaa, 0xbb, 0x4d, 0x01, 0x00, 0xcc, 0x76};
+    script pushes = parse_script(pushdata);
+    BITCOIN_ASSERT(pushes.operations().size() == 3);
+    BITCOIN_ASSERT((pushes.operations()[0].data == data_chunk{0xaa, 0xbb}));
+    BITCOIN_ASSERT((pushes.operations()[1].data == data_chunk{0xcc}));
+    BITCOIN_ASSERT(pushes.operations()[2].code == opcode::dup);
+    BITCOIN_ASSERT(save_script(pushes) == pushdata);
+    BITCOIN_ASSERT(script_size(pushes) == pushdata.size());
+    data_chunk short_length{0x4d, 0x01};
+    BITCOIN_ASSERT(parse_script(short_length).operations().empty());
+}
+
+message::transaction create_transaction()
+{
+    message::transaction tx;
+    tx.version = 1;
+    tx.locktime = 0;
+    message::transaction_input input;
+    input.hash = hash_digest{0x39, 0x7f, 0x72, 0x33, 0x34, 0xe2, 0x85, 0x9f,
+        0x00, 0x87, 0xb5, 0x64, 0xd8, 0xfb, 0xac, 0x8b, 0x2e, 0x22, 0xa2, 0xdb,
+        0xfc, 0x60, 0xc2, 0xdf, 0x35, 0x8d, 0x8e, 0xb4, 0xf9, 0xbe, 0xb3, 0x97};
+    input.index = 0;
+    input.input_script.push_operation(
+        operation{opcode::special, data_chunk(71, 0x30)});
+    input.input_script.push_operation(
+        operation{opcode::special, data_chunk(65, 0x04)});
+    input.sequence = 4294967295;
+    tx.inputs.push_back(input);
+    message::transaction_output output;
+    output.value = 2188570650000;
+    output.output_script.push_operation(operation{opcode::dup, data_chunk()});
+    output.output_script.push_operation(
+        operation{opcode::hash160, data_chunk()});
+    output.output_script.push_operation(
+        operation{opcode::special, data_chunk(20, 0xff)});
+    output.output_script.push_operation(
+        operation{opcode::equalverify, data_chunk()});
+    output.output_script.push_operation(
+        operation{opcode::checksig, data_chunk()});
+    tx.outputs.push_back(output);
+    return tx;
+}
+
+void test_dialect_round_trip()
+{
+    original_dialect dialect;
+    message::transaction tx = create_transaction();
+    data_chunk raw_tx = dialect.to_network(tx, false);
+    BITCOIN_ASSERT(raw_tx.size() == transaction_size(tx));
+    bool ec = false;
+    message::transaction parsed_tx =
+        dialect.transaction_from_network(message::header(), raw_tx, ec);
+    BITCOIN_ASSERT(!ec);
+    BITCOIN_ASSERT(parsed_tx.cached_hash.valid());
+    BITCOIN_ASSERT(hash_transaction(parsed_tx) == hash_transaction(tx));
+    // Cache must be reset after a mutation
+    hash_digest original_hash = hash_transaction(parsed_tx);
+    parsed_tx.locktime = 1;
+    parsed_tx.cached_hash.reset();
+    BITCOIN_ASSERT(hash_transaction(parsed_tx) != original_hash);
+
+    message::block block;
+    block.version = 1;
+    block.prev_block = tx.inputs[0].hash;
+    block.timestamp = 1231006505;
+    block.bits = 0x1d00ffff;
+    block.nonce = 2083236893;
+    block.transactions.push_back(tx);
+    block.transactions.push_back(tx);
+    block.merkle_root = generate_merkle_root(block.transactions);
+    data_chunk raw_block = dialect.to_network(block, false);
+    BITCOIN_ASSERT(raw_block.size() == block_size(block));
+    message::block parsed_block =
+        dialect.block_from_network(message::header(), raw_block, ec);
+    BITCOIN_ASSERT(!ec);
+    BITCOIN_ASSERT(hash_block_header(parsed_block) == hash_block_header(block));
+    // Parsed messages come back with their hashes already filled in
+    BITCOIN_ASSERT(parsed_block.cached_hash.valid());
+    BITCOIN_ASSERT(parsed_block.transactions[1].cached_hash.valid());
+    BITCOIN_ASSERT(parsed_block.transactions.size() == 2);
+    // Containers come back sized exactly to the wire counts
+    const message::transaction& parsed_first = parsed_block.transactions[0];
+    BITCOIN_ASSERT(parsed_first.inputs.capacity() == 1);
+    BITCOIN_ASSERT(parsed_first.outputs.capacity() == 1);
+    BITCOIN_ASSERT(parsed_first.outputs[0].output_script.operations().capacity()
+        == 5);
+    BITCOIN_ASSERT(generate_merkle_root(parsed_block.transactions) ==
+        block.merkle_root);
+
+    // Checksummed messages carry a 24 byte header before the payload
+    data_chunk full_message = dialect.to_network(block, true);
+    BITCOIN_ASSERT(full_message.size() == 24 + raw_block.size());
+    BITCOIN_ASSERT(std::equal(raw_block.begin(), raw_block.end(),
+        full_message.begin() + 24));
+    // Stored payloads go out behind a header made for them alone
+    data_chunk raw_header = dialect.header_to_network(
+        message::command_type::block, raw_block);
+    BITCOIN_ASSERT(std::equal(raw_header.begin(), raw_header.end(),
+        full_message.begin()));
+
+    message::getdata getdata;
+    getdata.invs.push_back(
+        message::inv_vect{message::inv_type::block, block.prev_block});
+    data_chunk raw_getdata = dialect.to_network(getdata);
+    raw_getdata.erase(raw_getdata.begin(), raw_getdata.begin() + 24);
+    message::getdata parsed_getdata =
+        dialect.getdata_from_network(message::header(), raw_getdata, ec);
+    BITCOIN_ASSERT(!ec && parsed_getdata.invs.size() == 1);
+    BITCOIN_ASSERT(parsed_getdata.invs[0].hash == block.prev_block);
+    // A count the payload cannot hold is refused before reading on
+    raw_getdata[0] = 0xfc;
+    dialect.getdata_from_network(message::header(), raw_getdata, ec);
+    BITCOIN_ASSERT(ec);
+
+    message::addr addr;
+    addr.addr_list.push_back(message::net_addr{1355000000, 1,
+        message::ip_address{{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff,
+            10, 0, 0, 1}}, 8333});
+    data_chunk raw_addr = dialect.to_network(addr);
+    message::header addr_header = dialect.header_from_network(
+        data_chunk(raw_addr.begin(), raw_addr.begin() + 20));
+    addr_header.checksum = dialect.checksum_from_network(
+        data_chunk(raw_addr.begin() + 20, raw_addr.begin() + 24));
+    raw_addr.erase(raw_addr.begin(), raw_addr.begin() + 24);
+    BITCOIN_ASSERT(raw_addr.size() == 1 + 30);
+    message::addr parsed_addr =
+        dialect.addr_from_network(addr_header, raw_addr, ec);
+    BITCOIN_ASSERT(!ec && parsed_addr.addr_list.size() == 1);
+    BITCOIN_ASSERT(parsed_addr.addr_list[0].timestamp == 1355000000);
+    BITCOIN_ASSERT(parsed_addr.addr_list[0].ip_addr ==
+        addr.addr_list[0].ip_addr);
+    BITCOIN_ASSERT(parsed_addr.addr_list[0].port == 8333);
+}
+
+void test_commands()
+{
+    original_dialect dialect;
+    data_chunk verack = dialect.to_network(message::verack());
+    BITCOIN_ASSERT(dialect.header_from_network(verack).command ==
+        message::command_type::verack);
+    BITCOIN_ASSERT(decode_command(&verack[4]) == message::command_type::verack);
+    // Exact matches only, nulls padding the rest of the field
+    uint8_t field[12] = {'v', 'e', 'r', 's', 'i', 'o', 'n'};
+    BITCOIN_ASSERT(decode_command(field) == message::command_type::version);
+    field[7] = 'x';
+    BITCOIN_ASSERT(decode_command(field) == message::command_type::unknown);
+    uint8_t prefix[12] = {'v', 'e', 'r', 's'};
+    BITCOIN_ASSERT(decode_command(prefix) == message::command_type::unknown);
+    BITCOIN_ASSERT(std::string(command_name(message::command_type::headers))
+        == "headers");
+}
+
+int main()
+{
+    test_integers();
+    test_byte_order();
+    test_var_uint();
+    test_buffer_handover();
+    test_views();
+    test_dialect_round_trip();
+    test_commands();
+    std::cout << "serializer tests passed.\n";
+    return 0;
+}
+
@@ -0,0 +1,107 @@
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/sha256.hpp>
+#include <openssl/sha.h>
+#include <algorithm>
+#include <iostream>
+
+#include "../src/util/sha256_engine.hpp"
+
+using namespace libbitcoin;
+
+hash_digest openssl_double_hash(const data_chunk& chunk)
+{
+    hash_digest digest;
+    SHA256(chunk.data(), chunk.size(), digest.data());
+    SHA256(digest.data(), digest.size(), digest.data());
+    std::reverse(digest.begin(), digest.end());
+    return digest;
+}
+
+data_chunk create_message(size_t size)
+{
+    data_chunk message(size);
+    for (size_t i = 0; i < size; ++i)
+        message[i] = (i * 131 + 7) & 0xff;
+    return message;
+}
+
+// Every length across the one and two padding block boundaries
+void test_messages()
+{
+    for (size_t size = 0; size < 300; ++size)
+    {
+        data_chunk message = create_message(size);
+        BITCOIN_ASSERT(generate_sha256_hash(message) ==
+            openssl_double_hash(message));
+    }
+}
+
+// Fed in uneven pieces, and resumed from a copy part way through
+void test_stream()
+{
+    const data_chunk message = create_message(300);
+    for (size_t piece = 1; piece < 130; piece += 7)
+    {
+        sha256_stream stream, halfway;
+        for (size_t start = 0; start < message.size(); start += piece)
+        {
+            if (start <= message.size() / 2)
+                halfway = stream;
+            stream.update(message.data() + start,
+                std::min(piece, message.size() - start));
+        }
+        BITCOIN_ASSERT(stream.double_hash() ==
+            openssl_double_hash(message));
+        // Finishing leaves the stream usable
+        BITCOIN_ASSERT(stream.double_hash() ==
+            openssl_double_hash(message));
+        BITCOIN_ASSERT(halfway.double_hash() != stream.double_hash());
+    }
+    BITCOIN_ASSERT(sha256_stream().double_hash() ==
+        openssl_double_hash(data_chunk()));
+}
+
+void test_backend(const sha256_engine& engine)
+{
+    constexpr size_t number_blocks = 19;
+    data_chunk input = create_message(64 * number_blocks);
+    data_chunk output(32 * number_blocks);
+    engine.double_hash_64(output.data(), input.data(), number_blocks);
+    for (size_t i = 0; i < number_blocks; ++i)
+    {
+        data_chunk block(input.begin() + 64 * i, input.begin() + 64 * i + 64);
+        hash_digest expected = openssl_double_hash(block);
+        std::reverse(expected.begin(), expected.end());
+        BITCOIN_ASSERT(std::equal(expected.begin(), expected.end(),
+            output.begin() + 32 * i));
+    }
+    // Hashing into the front half of the input gives the same digests
+    engine.double_hash_64(input.data(), input.data(), number_blocks);
+    BITCOIN_ASSERT(std::equal(output.begin(), output.end(), input.begin()));
+
+    uint32_t state[8], expected_state[8];
+    std::copy(sha256_initial_state, sha256_initial_state + 8, state);
+    std::copy(state, state + 8, expected_state);
+    data_chunk blocks = create_message(64 * 3);
+    engine.transform(state, blocks.data(), 3);
+    sha256_transform_portable(expected_state, blocks.data(), 3);
+    BITCOIN_ASSERT(std::equal(state, state + 8, expected_state));
+}
+
+int main()
+{
+    test_messages();
+    test_stream();
+    sha256_engine engine;
+    load_sha256_portable(engine);
+    test_backend(engine);
+    if (load_sha256_shani(engine))
+        test_backend(engine);
+    load_sha256_portable(engine);
+    if (load_sha256_avx2(engine))
+        test_backend(engine);
+    std::cout << "sha256 tests passed using "
+        << sha256_implementation() << ".\n";
+    return 0;
+}
+
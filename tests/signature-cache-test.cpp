@@ -0,0 +1,32 @@
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/signature_cache.hpp>
+#include <iostream>
+
+using namespace libbitcoin;
+
+int main()
+{
+    // Room for roughly 100 entries
+    signature_cache cache(100 * 64);
+    data_chunk pubkey{0x04, 0x01}, signature{0x30, 0x02};
+    hash_digest sighash{0x01};
+    BITCOIN_ASSERT(!cache.contains(sighash, pubkey, signature));
+    cache.add(sighash, pubkey, signature);
+    BITCOIN_ASSERT(cache.contains(sighash, pubkey, signature));
+    // Any field changing gives a different entry
+    BITCOIN_ASSERT(!cache.contains(sighash, signature, pubkey));
+    BITCOIN_ASSERT(cache.hits() == 1 && cache.misses() == 2);
+
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        hash_digest other{0x02, uint8_t(i), uint8_t(i >> 8)};
+        cache.add(other, pubkey, signature);
+    }
+    size_t bounded_size = cache.size();
+    BITCOIN_ASSERT(bounded_size > 0 && bounded_size <= 100);
+    cache.set_max_size(10 * 64);
+    BITCOIN_ASSERT(cache.size() <= 10);
+    std::cout << "signature cache tests passed.\n";
+    return 0;
+}
+
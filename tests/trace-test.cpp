@@ -0,0 +1,70 @@
+#include <bitcoin/util/trace.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+using namespace libbitcoin;
+
+int main()
+{
+    hash_digest block_hash = hash_digest();
+    block_hash[0] = 0xab;
+    block_hash[31] = 0x01;
+
+    // Nothing is kept while tracing is off
+    {
+        trace_span span("test.off", block_hash);
+    }
+    BITCOIN_ASSERT(trace_events().empty());
+
+    set_tracing(true);
+    {
+        trace_span outer("test.outer");
+        trace_span inner("test.inner");
+        inner.set_block(block_hash);
+    }
+    trace_event_list events = trace_events();
+    BITCOIN_ASSERT(events.size() == 2);
+    // Inner ends first
+    BITCOIN_ASSERT(std::string(events[0].name) == "test.inner");
+    BITCOIN_ASSERT(events[0].block_hash == block_hash);
+    BITCOIN_ASSERT(events[1].block_hash == hash_digest());
+    BITCOIN_ASSERT(events[1].start <= events[0].start);
+    BITCOIN_ASSERT(events[1].duration >= events[0].duration);
+    BITCOIN_ASSERT(events[0].thread == events[1].thread);
+
+    const std::string json = trace_to_chrome_json();
+    BITCOIN_ASSERT(
+        json.find("{\"traceEvents\":[{\"name\":\"test.inner\"") == 0);
+    BITCOIN_ASSERT(json.find("\"ph\":\"X\"") != std::string::npos);
+    BITCOIN_ASSERT(json.find("\"args\":{\"block\":\"ab000000") !=
+        std::string::npos);
+    BITCOIN_ASSERT(json.find("000001\"}") != std::string::npos);
+    const std::string path = "trace-test.json";
+    BITCOIN_ASSERT(write_trace(path));
+    std::ifstream file(path.c_str());
+    std::string written((std::istreambuf_iterator<char>(file)),
+        std::istreambuf_iterator<char>());
+    BITCOIN_ASSERT(written == json);
+    std::remove(path.c_str());
+
+    // A full ring keeps the newest
+    clear_trace();
+    for (size_t i = 0; i < trace_capacity + 10; ++i)
+    {
+        trace_span span(i < 10 ? "test.old" : "test.new");
+    }
+    events = trace_events();
+    BITCOIN_ASSERT(events.size() == trace_capacity);
+    for (const trace_event& event: events)
+        BITCOIN_ASSERT(std::string(event.name) == "test.new");
+    for (size_t i = 1; i < events.size(); ++i)
+        BITCOIN_ASSERT(events[i - 1].start <= events[i].start);
+
+    set_tracing(false);
+    clear_trace();
+    std::cout << "trace: OK" << std::endl;
+    return 0;
+}
+
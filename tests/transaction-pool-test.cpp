@@ -0,0 +1,213 @@
+#include <bitcoin/transaction_pool.hpp>
+#include <bitcoin/constants.hpp>
+#include <bitcoin/dialect.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/thread_pool.hpp>
+#include <future>
+#include <iostream>
+#include <map>
+
+using namespace libbitcoin;
+
+// Unspent outputs held in a map, answered straight away
+class chain_storage
+  : public storage
+{
+public:
+    void add_output(const hash_digest& tx_hash, uint64_t value)
+    {
+        message::transaction_output output;
+        output.value = value;
+        outputs_[std::make_pair(tx_hash, 0)] = output;
+    }
+
+    void store(const message::inv&, store_handler handle_store)
+    {
+        handle_store(std::error_code());
+    }
+    void store(const message::transaction&, store_handler handle_store)
+    {
+        handle_store(error::unsupported_operation);
+    }
+    void store(message::block_ptr, store_handler handle_store)
+    {
+        handle_store(error::unsupported_operation);
+    }
+
+    void fetch_inventories(fetch_handler_inventories handle_fetch)
+    {
+        handle_fetch(error::object_doesnt_exist, message::inv_list());
+    }
+    void fetch_block_by_depth(size_t, fetch_handler_block handle_fetch)
+    {
+        handle_fetch(error::object_doesnt_exist, message::block());
+    }
+    void fetch_block_by_hash(hash_digest, fetch_handler_block handle_fetch)
+    {
+        handle_fetch(error::object_doesnt_exist, message::block());
+    }
+    void fetch_blocks_by_depth_range(size_t, size_t,
+        fetch_handler_blocks handle_fetch)
+    {
+        handle_fetch(error::object_doesnt_exist, message::block_list());
+    }
+    void fetch_raw_block_by_hash(hash_digest,
+        fetch_handler_raw_block handle_fetch)
+    {
+        handle_fetch(error::object_doesnt_exist, data_chunk_ptr());
+    }
+    void fetch_block_locator(fetch_handler_block_locator handle_fetch)
+    {
+        handle_fetch(error::object_doesnt_exist, message::block_locator());
+    }
+    void fetch_output_by_hash(hash_digest, uint32_t,
+        fetch_handler_output handle_fetch)
+    {
+        handle_fetch(error::object_doesnt_exist,
+            message::transaction_output());
+    }
+    void fetch_outputs(const output_point_list& points,
+        fetch_handler_outputs handle_fetch)
+    {
+        fetch_unspent_outputs(points, handle_fetch);
+    }
+    void fetch_unspent_outputs(const output_point_list& points,
+        fetch_handler_outputs handle_fetch)
+    {
+        message::transaction_output_list outputs(points.size());
+        std::vector<size_t> missing;
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            auto it = outputs_.find(
+                std::make_pair(points[i].hash, points[i].index));
+            if (it == outputs_.end())
+                missing.push_back(i);
+            else
+                outputs[i] = it->second;
+        }
+        handle_fetch(std::error_code(), outputs, missing);
+    }
+    void fetch_outputs_by_pubkey_hash(const short_hash&,
+        fetch_handler_address_outputs handle_fetch)
+    {
+        handle_fetch(error::unsupported_operation, address_output_list());
+    }
+    void block_exists_by_hash(hash_digest, exists_handler handle_exists)
+    {
+        handle_exists(std::error_code(), false);
+    }
+    void blocks_exist(const hash_list& block_hashes,
+        exists_list_handler handle_exists)
+    {
+        handle_exists(std::error_code(),
+            std::vector<bool>(block_hashes.size(), false));
+    }
+
+private:
+    std::map<std::pair<hash_digest, uint32_t>,
+        message::transaction_output> outputs_;
+};
+
+// Empty scripts pass, so only the values matter. A pushed input
+// script leaves junk on the stack and fails.
+message::transaction create_spend(const hash_digest& previous,
+    uint32_t index, uint64_t value, bool failing=false)
+{
+    message::transaction tx;
+    tx.version = 1;
+    tx.locktime = 0;
+    message::transaction_input input;
+    input.hash = previous;
+    input.index = index;
+    input.sequence = 0xffffffff;
+    if (failing)
+        input.input_script.push_operation(
+            operation{opcode::special, data_chunk{0x01}});
+    tx.inputs.push_back(input);
+    message::transaction_output output;
+    output.value = value;
+    tx.outputs.push_back(output);
+    return tx;
+}
+
+std::error_code store(transaction_pool_ptr pool,
+    const message::transaction& tx)
+{
+    std::promise<std::error_code> stored;
+    pool->store(tx,
+        [&](const std::error_code& ec)
+        {
+            stored.set_value(ec);
+        });
+    return stored.get_future().get();
+}
+
+message::block_ptr create_block(const message::transaction& tx)
+{
+    std::shared_ptr<message::block> block =
+        std::make_shared<message::block>();
+    block->transactions.push_back(tx);
+    return block;
+}
+
+int main()
+{
+    const hash_digest funding_a{{1}}, funding_b{{2}}, funding_c{{3}};
+    std::shared_ptr<chain_storage> chain = std::make_shared<chain_storage>();
+    chain->add_output(funding_a, 100);
+    chain->add_output(funding_b, 50);
+    chain->add_output(funding_c, 50);
+    thread_pool_ptr verify_pool(new thread_pool(2));
+    transaction_pool_ptr pool =
+        std::make_shared<transaction_pool>(chain, verify_pool);
+
+    const message::transaction parent = create_spend(funding_a, 0, 90);
+    const hash_digest parent_hash = hash_transaction(parent);
+    BITCOIN_ASSERT(!store(pool, parent));
+    BITCOIN_ASSERT(store(pool, parent) == error::object_already_exists);
+    BITCOIN_ASSERT(pool->exists(parent_hash));
+    BITCOIN_ASSERT(*pool->fetch_raw(parent_hash) ==
+        original_dialect().to_network(parent, false));
+
+    // Spends of pool transactions are checked against the pool
+    const message::transaction child = create_spend(parent_hash, 0, 80);
+    BITCOIN_ASSERT(!store(pool, child));
+    BITCOIN_ASSERT(store(pool, create_spend(parent_hash, 1, 1)) ==
+        error::input_not_found);
+    BITCOIN_ASSERT(store(pool, create_spend(funding_a, 0, 10)) ==
+        error::double_spend);
+    BITCOIN_ASSERT(store(pool, create_spend(null_hash, 5, 10)) ==
+        error::input_not_found);
+    BITCOIN_ASSERT(store(pool, create_spend(funding_b, 0, 51)) ==
+        error::validate_inputs_failed);
+    BITCOIN_ASSERT(store(pool, create_spend(funding_b, 0, 40, true)) ==
+        error::validate_inputs_failed);
+    BITCOIN_ASSERT(store(pool, message::transaction()) ==
+        error::invalid_transaction);
+    BITCOIN_ASSERT(pool->size() == 2);
+
+    // A confirmed conflict takes the child with it, and the parent
+    // leaves as it is confirmed itself
+    pool->remove_confirmed(create_block(create_spend(parent_hash, 0, 85)));
+    BITCOIN_ASSERT(store(pool, message::transaction()));
+    BITCOIN_ASSERT(pool->size() == 1 && pool->exists(parent_hash));
+    pool->remove_confirmed(create_block(parent));
+    BITCOIN_ASSERT(store(pool, message::transaction()));
+    BITCOIN_ASSERT(pool->size() == 0 && pool->bytes() == 0);
+
+    // Room for one: the lower fee rate goes
+    const message::transaction cheap = create_spend(funding_b, 0, 49),
+        generous = create_spend(funding_c, 0, 10);
+    transaction_pool_ptr small_pool =
+        std::make_shared<transaction_pool>(chain, verify_pool, 400);
+    BITCOIN_ASSERT(!store(small_pool, cheap));
+    BITCOIN_ASSERT(!store(small_pool, generous));
+    BITCOIN_ASSERT(small_pool->size() == 1);
+    BITCOIN_ASSERT(small_pool->exists(hash_transaction(generous)));
+    BITCOIN_ASSERT(store(small_pool, cheap) == error::pool_filled);
+
+    std::cout << "transaction pool: OK" << std::endl;
+    return 0;
+}
+
@@ -0,0 +1,73 @@
+#include <bitcoin/util/uint256.hpp>
+#include <bitcoin/constants.hpp>
+#include <bitcoin/header_index.hpp>
+#include <bitcoin/verify.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <bitcoin/util/big_number.hpp>
+#include <iostream>
+
+using namespace libbitcoin;
+
+// Decoding happens at compile time
+static_assert(uint256::from_compact(0x1d00ffff) ==
+    uint256(0, 0, 0, 0x00000000ffff0000), "genesis target");
+static_assert(uint256::from_compact(0x03123456) == uint256(0x123456),
+    "no shift");
+static_assert(uint256::from_compact(0x01123456) == uint256(0x12),
+    "right shift");
+static_assert(uint256::from_compact(0x04923456).is_zero(), "negative");
+static_assert(uint256::from_compact(0xff123456).is_zero(), "overflow");
+
+void check_against_big_number(uint32_t bits)
+{
+    big_number reference;
+    reference.set_compact(bits);
+    BITCOIN_ASSERT(uint256::from_compact(bits).to_hash() ==
+        reference.get_hash());
+}
+
+int main()
+{
+    check_against_big_number(0x1d00ffff);
+    check_against_big_number(0x1b0404cb);
+    check_against_big_number(0x181bc330);
+    check_against_big_number(0x2100ffff);
+
+    const hash_digest genesis_hash{
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x19, 0xd6, 0x68,
+        0x9c, 0x08, 0x5a, 0xe1, 0x65, 0x83, 0x1e, 0x93,
+        0x4f, 0xf7, 0x63, 0xae, 0x46, 0xa2, 0xa6, 0xc1,
+        0x72, 0xb3, 0xf1, 0xb6, 0x0a, 0x8c, 0xe2, 0x6f};
+    const uint256 genesis_value = uint256::from_hash(genesis_hash);
+    BITCOIN_ASSERT(genesis_value.to_hash() == genesis_hash);
+    BITCOIN_ASSERT(genesis_value < proof_of_work_limit);
+    BITCOIN_ASSERT(check_proof_of_work(genesis_hash, 0x1d00ffff));
+    BITCOIN_ASSERT(!check_proof_of_work(genesis_hash, 0x1b0404cb));
+    // Easier than the network allows
+    BITCOIN_ASSERT(!check_proof_of_work(null_hash, 0x1e00ffff));
+    BITCOIN_ASSERT(!check_proof_of_work(null_hash, 0x04923456));
+
+    // Carries and borrows cross every word
+    const uint256 all_ones = ~uint256();
+    BITCOIN_ASSERT((all_ones + 1).is_zero());
+    BITCOIN_ASSERT(uint256() - 1 == all_ones);
+    BITCOIN_ASSERT(uint256(0, 0, 0, 1) - 1 ==
+        uint256(~uint64_t(0), ~uint64_t(0), ~uint64_t(0), 0));
+    uint256 shifted = 1;
+    shifted <<= 200;
+    BITCOIN_ASSERT(shifted == uint256(0, 0, 0, uint64_t(1) << 8));
+    BITCOIN_ASSERT(shifted.bit_length() == 201);
+    shifted >>= 137;
+    BITCOIN_ASSERT(shifted == uint256(uint64_t(1) << 63));
+    BITCOIN_ASSERT(uint256(1000) / 7 == uint256(142));
+    BITCOIN_ASSERT((uint256(5) / uint256()).is_zero());
+    BITCOIN_ASSERT(all_ones / all_ones == uint256(1));
+
+    // Work at the genesis target is 2^32 + 2^16 + 1 hashes
+    BITCOIN_ASSERT(block_work(0x1d00ffff) == uint256(0x100010001));
+    BITCOIN_ASSERT(block_work(0x1b0404cb) > block_work(0x1d00ffff));
+    BITCOIN_ASSERT(block_work(0x04923456).is_zero());
+    std::cout << "uint256: OK" << std::endl;
+    return 0;
+}
+
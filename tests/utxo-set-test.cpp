@@ -0,0 +1,132 @@
+#include <bitcoin/utxo_set.hpp>
+#include <bitcoin/transaction.hpp>
+#include <bitcoin/util/assert.hpp>
+#include <iostream>
+#include <map>
+
+using namespace libbitcoin;
+
+// Stands in for the database: outputs of verified blocks plus spent flags
+struct backing_store
+{
+    std::map<std::pair<hash_digest, uint32_t>, unspent_output> outputs;
+    std::map<std::pair<hash_digest, uint32_t>, bool> spent;
+    size_t loads = 0, flushes = 0;
+
+    bool load(const output_point& point, unspent_output& output)
+    {
+        ++loads;
+        auto key = std::make_pair(point.hash, point.index);
+        auto it = outputs.find(key);
+        if (it == outputs.end() || spent[key])
+            return false;
+        output = it->second;
+        return true;
+    }
+    void flush(const utxo_set::change_list& changes)
+    {
+        ++flushes;
+        for (const auto& change: changes)
+            spent[std::make_pair(change.first.hash, change.first.index)] =
+                change.second;
+    }
+};
+
+message::transaction create_transaction(const hash_digest& previous_hash,
+    uint32_t previous_index, uint64_t value)
+{
+    message::transaction tx;
+    tx.version = 1;
+    tx.locktime = 0;
+    message::transaction_input input;
+    input.hash = previous_hash;
+    input.index = previous_index;
+    input.sequence = 0xffffffff;
+    tx.inputs.push_back(input);
+    message::transaction_output output;
+    output.value = value;
+    output.output_script.push_operation(operation{opcode::dup, data_chunk()});
+    tx.outputs.push_back(output);
+    return tx;
+}
+
+int main()
+{
+    backing_store store;
+    hash_digest funding_hash{1, 2, 3};
+    store.outputs[std::make_pair(funding_hash, 0u)] =
+        unspent_output{5000, data_chunk{0x76}};
+    utxo_set unspent(
+        [&](const output_point& point, unspent_output& output)
+            { return store.load(point, output); },
+        [&](const utxo_set::change_list& changes)
+            { store.flush(changes); });
+
+    unspent_output output;
+    BITCOIN_ASSERT(unspent.fetch(output_point{funding_hash, 0}, output));
+    BITCOIN_ASSERT(output.value == 5000);
+    // Second probe is answered from memory
+    BITCOIN_ASSERT(unspent.fetch(output_point{funding_hash, 0}, output));
+    BITCOIN_ASSERT(store.loads == 1);
+    BITCOIN_ASSERT(!unspent.fetch(output_point{funding_hash, 1}, output));
+
+    // Second transaction spends the first within the same block
+    message::block block;
+    block.transactions.push_back(create_transaction(funding_hash, 0, 4000));
+    hash_digest first_hash = hash_transaction(block.transactions[0]);
+    block.transactions.push_back(create_transaction(first_hash, 0, 3000));
+    hash_digest second_hash = hash_transaction(block.transactions[1]);
+
+    utxo_set::undo_list undo;
+    BITCOIN_ASSERT(unspent.connect(block, undo));
+    BITCOIN_ASSERT(undo.size() == 2);
+    BITCOIN_ASSERT(!unspent.fetch(output_point{funding_hash, 0}, output));
+    BITCOIN_ASSERT(!unspent.fetch(output_point{first_hash, 0}, output));
+    BITCOIN_ASSERT(unspent.fetch(output_point{second_hash, 0}, output));
+    BITCOIN_ASSERT(output.value == 3000);
+
+    // Double spend is refused and leaves the set untouched
+    utxo_set::undo_list rejected_undo;
+    BITCOIN_ASSERT(!unspent.connect(block, rejected_undo));
+    BITCOIN_ASSERT(rejected_undo.empty());
+    BITCOIN_ASSERT(unspent.fetch(output_point{second_hash, 0}, output));
+
+    unspent.flush();
+    BITCOIN_ASSERT(store.flushes == 1);
+    BITCOIN_ASSERT(store.spent[std::make_pair(funding_hash, 0u)]);
+
+    unspent.disconnect(block, undo);
+    BITCOIN_ASSERT(unspent.fetch(output_point{funding_hash, 0}, output));
+    BITCOIN_ASSERT(output.value == 5000);
+    BITCOIN_ASSERT(!unspent.fetch(output_point{second_hash, 0}, output));
+    unspent.flush();
+    BITCOIN_ASSERT(!store.spent[std::make_pair(funding_hash, 0u)]);
+
+    // Spending a later transaction's output in the same block is refused,
+    // since the store does not hand out outputs of unverified blocks
+    message::block forward_block;
+    message::transaction funding_spend =
+        create_transaction(funding_hash, 0, 4000);
+    forward_block.transactions.push_back(create_transaction(
+        hash_transaction(funding_spend), 0, 3000));
+    forward_block.transactions.push_back(funding_spend);
+    utxo_set::undo_list forward_undo;
+    BITCOIN_ASSERT(!unspent.connect(forward_block, forward_undo));
+    BITCOIN_ASSERT(forward_undo.empty());
+    BITCOIN_ASSERT(unspent.fetch(output_point{funding_hash, 0}, output));
+
+    // Over budget the set writes back and drops what it holds
+    utxo_set small(
+        [&](const output_point& point, unspent_output& output)
+            { return store.load(point, output); },
+        [&](const utxo_set::change_list& changes)
+            { store.flush(changes); }, 1);
+    size_t flushes_before = store.flushes;
+    BITCOIN_ASSERT(small.connect(block, undo));
+    BITCOIN_ASSERT(store.flushes == flushes_before + 1);
+    BITCOIN_ASSERT(small.size() == 0);
+    BITCOIN_ASSERT(store.spent[std::make_pair(funding_hash, 0u)]);
+    std::cout << "utxo set tests passed.\n";
+    return 0;
+}
+